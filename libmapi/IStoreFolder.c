@@ -28,6 +28,71 @@
 */
 
 
+/**
+   \details Attach the data returned by OpenMessage to a message object
+
+   The subject and the recipients are cached in the object private
+   data. This is shared by OpenMessage and the batching API.
+
+   \param session pointer to the MAPI session
+   \param obj_message the message object the data belongs to
+   \param reply pointer to the OpenMessage reply
+
+   \sa OpenMessage, mapi_batch_OpenMessage
+ */
+void OpenMessage_set_private_data(struct mapi_session *session,
+				  mapi_object_t *obj_message,
+				  struct OpenMessage_repl *reply)
+{
+	mapi_object_message_t		*message;
+	struct SPropValue		lpProp;
+	const char			*tstring;
+	uint32_t			i = 0;
+
+	message = talloc_zero((TALLOC_CTX *)session, mapi_object_message_t);
+
+	tstring = get_TypedString(&reply->SubjectPrefix);
+	if (tstring) {
+		message->SubjectPrefix = talloc_strdup((TALLOC_CTX *)message, tstring);
+	}
+
+	tstring = get_TypedString(&reply->NormalizedSubject);
+	if (tstring) {
+		message->NormalizedSubject = talloc_strdup((TALLOC_CTX *)message, tstring);
+	}
+	
+
+	message->cValues = reply->RecipientColumns.cValues;
+	message->SRowSet.cRows = reply->RowCount;
+	message->SRowSet.aRow = talloc_array((TALLOC_CTX *)message, struct SRow, reply->RowCount + 1);
+
+	message->SPropTagArray.cValues = reply->RecipientColumns.cValues;
+	message->SPropTagArray.aulPropTag = talloc_steal(message, reply->RecipientColumns.aulPropTag);
+
+	for (i = 0; i < reply->RowCount; i++) {
+		emsmdb_get_SRow((TALLOC_CTX *)message,
+				&(message->SRowSet.aRow[i]), &message->SPropTagArray, 
+				reply->RecipientRows[i].RecipientRow.prop_count,
+				&reply->RecipientRows[i].RecipientRow.prop_values,
+				reply->RecipientRows[i].RecipientRow.layout, 1);
+
+		lpProp.ulPropTag = PR_RECIPIENT_TYPE;
+		lpProp.value.l = reply->RecipientRows[i].RecipientType;
+		SRow_addprop(&(message->SRowSet.aRow[i]), lpProp);
+
+		lpProp.ulPropTag = PR_INTERNET_CPID;
+		lpProp.value.l = reply->RecipientRows[i].CodePageId;
+		SRow_addprop(&(message->SRowSet.aRow[i]), lpProp);
+	}
+
+	/* add SPropTagArray elements we automatically append to SRow */
+	SPropTagArray_add((TALLOC_CTX *)message, &message->SPropTagArray, PR_RECIPIENT_TYPE);
+	SPropTagArray_add((TALLOC_CTX *)message, &message->SPropTagArray, PR_INTERNET_CPID);
+
+	obj_message->private_data = (void *) message;
+}
+
+
 /**
    \details Opens a specific message and retrieves a MAPI object that
    can be used to get or set message properties.
@@ -70,16 +135,11 @@ _PUBLIC_ enum MAPISTATUS OpenMessage(mapi_object_t *obj_store,
 	struct mapi_response		*mapi_response;
 	struct EcDoRpc_MAPI_REQ		*mapi_req;
 	struct OpenMessage_req		request;
-	struct OpenMessage_repl		*reply;
 	struct mapi_session		*session;
-	mapi_object_message_t		*message;
-	struct SPropValue		lpProp;
-	const char			*tstring;
 	NTSTATUS			status;
 	enum MAPISTATUS			retval;
 	uint32_t			size = 0;
 	TALLOC_CTX			*mem_ctx;
-	uint32_t			i = 0;
 	uint8_t				logon_id;
 
 	/* Sanity checks */
@@ -134,49 +194,7 @@ _PUBLIC_ enum MAPISTATUS OpenMessage(mapi_object_t *obj_store,
 	mapi_object_set_logon_id(obj_message, logon_id);
 
 	/* Store OpenMessage reply data */
-	reply = &mapi_response->mapi_repl->u.mapi_OpenMessage;
-
-	message = talloc_zero((TALLOC_CTX *)session, mapi_object_message_t);
-
-	tstring = get_TypedString(&reply->SubjectPrefix);
-	if (tstring) {
-		message->SubjectPrefix = talloc_strdup((TALLOC_CTX *)message, tstring);
-	}
-
-	tstring = get_TypedString(&reply->NormalizedSubject);
-	if (tstring) {
-		message->NormalizedSubject = talloc_strdup((TALLOC_CTX *)message, tstring);
-	}
-	
-
-	message->cValues = reply->RecipientColumns.cValues;
-	message->SRowSet.cRows = reply->RowCount;
-	message->SRowSet.aRow = talloc_array((TALLOC_CTX *)message, struct SRow, reply->RowCount + 1);
-
-	message->SPropTagArray.cValues = reply->RecipientColumns.cValues;
-	message->SPropTagArray.aulPropTag = talloc_steal(message, reply->RecipientColumns.aulPropTag);
-
-	for (i = 0; i < reply->RowCount; i++) {
-		emsmdb_get_SRow((TALLOC_CTX *)message,
-				&(message->SRowSet.aRow[i]), &message->SPropTagArray, 
-				reply->RecipientRows[i].RecipientRow.prop_count,
-				&reply->RecipientRows[i].RecipientRow.prop_values,
-				reply->RecipientRows[i].RecipientRow.layout, 1);
-
-		lpProp.ulPropTag = PR_RECIPIENT_TYPE;
-		lpProp.value.l = reply->RecipientRows[i].RecipientType;
-		SRow_addprop(&(message->SRowSet.aRow[i]), lpProp);
-
-		lpProp.ulPropTag = PR_INTERNET_CPID;
-		lpProp.value.l = reply->RecipientRows[i].CodePageId;
-		SRow_addprop(&(message->SRowSet.aRow[i]), lpProp);
-	}
-
-	/* add SPropTagArray elements we automatically append to SRow */
-	SPropTagArray_add((TALLOC_CTX *)message, &message->SPropTagArray, PR_RECIPIENT_TYPE);
-	SPropTagArray_add((TALLOC_CTX *)message, &message->SPropTagArray, PR_INTERNET_CPID);
-
-	obj_message->private_data = (void *) message;
+	OpenMessage_set_private_data(session, obj_message, &mapi_response->mapi_repl->u.mapi_OpenMessage);
 
 	talloc_free(mapi_response);
 	talloc_free(mem_ctx);
@@ -431,12 +431,15 @@ start:
 			multi_req[i] = *emsmdb_ctx->cache_requests[i];
 		}
 		multi_req[i] = req->mapi_req[0];
+		multi_req[i+1].opnum = 0;
 		req->mapi_req = multi_req;
+	} else if (talloc_array_length(req->mapi_req) < 2) {
+		/* Single ROP requests come unterminated, batched ones
+		   (see mapi_batch.c) already carry their terminator */
+		req->mapi_req = talloc_realloc(mem_ctx, req->mapi_req, struct EcDoRpc_MAPI_REQ, 2);
+		req->mapi_req[1].opnum = 0;
 	}
 
-	req->mapi_req = talloc_realloc(mem_ctx, req->mapi_req, struct EcDoRpc_MAPI_REQ, emsmdb_ctx->cache_count + 2);
-	req->mapi_req[i+1].opnum = 0;
-
 	r.in.mapi_request = req;
 	r.in.mapi_request->mapi_len += emsmdb_ctx->cache_size;
 	r.in.mapi_request->length += emsmdb_ctx->cache_size;
@@ -462,7 +465,9 @@ start:
 	}
 	emsmdb_ctx->cache_size = emsmdb_ctx->cache_count = 0;
 
-	if (r.out.mapi_response->mapi_repl && r.out.mapi_response->mapi_repl->error_code) {
+	/* Batched responses keep their handles: later ROPs may have succeeded */
+	if (r.out.mapi_response->mapi_repl && r.out.mapi_response->mapi_repl->error_code &&
+	    !r.out.mapi_response->mapi_repl[1].opnum) {
 		talloc_set_destructor((void *)mapi_response, NULL);
 		r.out.mapi_response->handles = NULL;
 	}
@@ -473,6 +478,75 @@ start:
 }
 
 
+/**
+   \details Build the rgbIn buffer of an EcDoRpcExt2 request
+
+   The MAPI request is always obfuscated. When compress is set and the
+   request is large enough, it is LZXPRESS compressed first, unless
+   compression does not make it smaller.
+
+   \param mem_ctx pointer to the memory context
+   \param req pointer to the MAPI request to pack
+   \param compress whether the request may be compressed
+
+   \return pointer to the rgbIn buffer (RPC_HEADER_EXT and payload) on
+   success, otherwise NULL
+ */
+_PUBLIC_ struct ndr_push *emsmdb_ext2_rgbIn(TALLOC_CTX *mem_ctx,
+					    struct mapi_request *req,
+					    bool compress)
+{
+	struct ndr_push		*ndr_uncomp_rgbIn;
+	struct ndr_push		*ndr_comp_rgbIn = NULL;
+	struct ndr_push		*ndr_payload;
+	struct ndr_push		*ndr_rgbIn;
+	struct RPC_HEADER_EXT	RPC_HEADER_EXT;
+
+	/* Step 1. Push mapi_request in a data blob */
+	ndr_uncomp_rgbIn = ndr_push_init_ctx(mem_ctx);
+	if (!ndr_uncomp_rgbIn) return NULL;
+	ndr_set_flags(&ndr_uncomp_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
+	ndr_push_mapi_request(ndr_uncomp_rgbIn, NDR_SCALARS|NDR_BUFFERS, req);
+
+	RPC_HEADER_EXT.Version = 0x0000;
+	RPC_HEADER_EXT.Flags = RHEF_XorMagic|RHEF_Last;
+	RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset;
+	ndr_payload = ndr_uncomp_rgbIn;
+
+	/* Step 2. Compress the blob if it pays off */
+	if (compress && ndr_uncomp_rgbIn->offset >= EMSMDB_COMPRESSION_THRESHOLD) {
+		ndr_comp_rgbIn = ndr_push_init_ctx(mem_ctx);
+		if (ndr_comp_rgbIn) {
+			ndr_set_flags(&ndr_comp_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
+			if (ndr_push_lzxpress_compress(ndr_comp_rgbIn, ndr_uncomp_rgbIn) == NDR_ERR_SUCCESS &&
+			    ndr_comp_rgbIn->offset < ndr_uncomp_rgbIn->offset) {
+				RPC_HEADER_EXT.Flags |= RHEF_Compressed;
+				ndr_payload = ndr_comp_rgbIn;
+			}
+		}
+	}
+	OC_DEBUG(6, "EcDoRpcExt2 request: %u bytes, %u on the wire%s",
+		 ndr_uncomp_rgbIn->offset, ndr_payload->offset,
+		 (RPC_HEADER_EXT.Flags & RHEF_Compressed) ? " (compressed)" : "");
+
+	/* Step 3. Obfuscate it and prepend the header */
+	obfuscate_data(ndr_payload->data, ndr_payload->offset, 0xA5);
+	RPC_HEADER_EXT.Size = ndr_payload->offset;
+
+	ndr_rgbIn = ndr_push_init_ctx(mem_ctx);
+	if (ndr_rgbIn) {
+		ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
+		ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
+		ndr_push_bytes(ndr_rgbIn, ndr_payload->data, ndr_payload->offset);
+	}
+
+	talloc_free(ndr_comp_rgbIn);
+	talloc_free(ndr_uncomp_rgbIn);
+
+	return ndr_rgbIn;
+}
+
+
 /**
    \details Make a EMSMDB EXT2 transaction.
 
@@ -492,8 +566,6 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_ext2(struct emsmdb_context *emsmdb_ctx,
 	NTSTATUS		status;
 	struct EcDoRpcExt2	r;
 	struct mapi2k7_response	mapi2k7_response;
-	struct ndr_push		*ndr_uncomp_rgbIn;
-	struct ndr_push		*ndr_comp_rgbIn;
 	struct ndr_push		*ndr_rgbIn;
 	struct ndr_pull		*ndr_pull = NULL;
 	uint32_t		pulFlags = 0x0;
@@ -501,60 +573,15 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_ext2(struct emsmdb_context *emsmdb_ctx,
 	uint32_t		pcbAuxOut = 0x1008;
 	uint32_t		pulTransTime = 0;
 	DATA_BLOB		rgbOut;
-	struct RPC_HEADER_EXT	RPC_HEADER_EXT;
 	enum ndr_err_code ndr_err;
 
 	r.in.handle = r.out.handle = &emsmdb_ctx->handle;
 	r.in.pulFlags = r.out.pulFlags = &pulFlags;
 
-	/* Step 1. Push mapi_request in a data blob */
-	ndr_uncomp_rgbIn = ndr_push_init_ctx(mem_ctx);
-	ndr_set_flags(&ndr_uncomp_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_mapi_request(ndr_uncomp_rgbIn, NDR_SCALARS|NDR_BUFFERS, req);
-
-	/* Step 2. Compress the blob */
-	/* 	ndr_comp_rgbIn = ndr_push_init_ctx(mem_ctx); */
-	/* 	ndr_push_lzxpress_compress(ndr_comp_rgbIn, ndr_uncomp_rgbIn); */
-
-	/* If the compressed blob is larger than the uncompressed one, use obfuscation */
-	/* 	if (ndr_comp_rgbIn->offset > ndr_uncomp_rgbIn->offset) { */
-	/* 		talloc_free(ndr_comp_rgbIn); */
-	ndr_comp_rgbIn = ndr_uncomp_rgbIn;
-	obfuscate_data(ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset, 0xA5);
-		
-	RPC_HEADER_EXT.Version = 0x0000;
-	RPC_HEADER_EXT.Flags = RHEF_XorMagic|RHEF_Last;
-	RPC_HEADER_EXT.Size = ndr_comp_rgbIn->offset;
-	RPC_HEADER_EXT.SizeActual = ndr_comp_rgbIn->offset;
-
-	ndr_rgbIn = ndr_push_init_ctx(mem_ctx);
-	ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
-	ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset);
-		/* 	} else { */
-		/* 		RPC_HEADER_EXT.Version = 0x0000; */
-		/* 		RPC_HEADER_EXT.Flags = RHEF_Compressed|RHEF_Last; */
-		/* 		RPC_HEADER_EXT.Size = ndr_comp_rgbIn->offset; */
-		/* 		RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset; */
-
-		/* 		ndr_rgbIn = ndr_push_init_ctx(mem_ctx); */
-		/* 		ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN); */
-		/* 		ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT); */
-		/* 		ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset); */
-		/* 	} */
-
-		/* Plain request (no obfuscation or compression) */
-		/* ndr_comp_rgbIn = ndr_uncomp_rgbIn; */
-		/* RPC_HEADER_EXT.Version = 0x0000; */
-		/* RPC_HEADER_EXT.Flags = RHEF_Last; */
-		/* RPC_HEADER_EXT.Size = ndr_uncomp_rgbIn->offset; */
-		/* RPC_HEADER_EXT.SizeActual = ndr_uncomp_rgbIn->offset; */
-
-		/* Pull the complete rgbIn */
-		/* ndr_rgbIn = ndr_push_init_ctx(mem_ctx); */
-		/* ndr_set_flags(&ndr_rgbIn->flags, LIBNDR_FLAG_NOALIGN); */
-		/* ndr_push_RPC_HEADER_EXT(ndr_rgbIn, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT); */
-		/* ndr_push_bytes(ndr_rgbIn, ndr_comp_rgbIn->data, ndr_comp_rgbIn->offset); */
+	ndr_rgbIn = emsmdb_ext2_rgbIn(mem_ctx, req, emsmdb_ctx->compress_requests);
+	if (!ndr_rgbIn) {
+		return NT_STATUS_NO_MEMORY;
+	}
 
 	r.in.rgbIn = ndr_rgbIn->data;
 	r.in.cbIn = ndr_rgbIn->offset;
@@ -569,7 +596,6 @@ _PUBLIC_ NTSTATUS emsmdb_transaction_ext2(struct emsmdb_context *emsmdb_ctx,
 
 	status = dcerpc_EcDoRpcExt2_r(emsmdb_ctx->rpc_connection->binding_handle, mem_ctx, &r);
 	talloc_free(ndr_rgbIn);
-	talloc_free(ndr_comp_rgbIn);
 
 	if (!NT_STATUS_IS_OK(status)) {
 		return status;
@@ -758,6 +784,28 @@ _PUBLIC_ struct emsmdb_info *emsmdb_get_info(struct mapi_session *session)
 }
 
 
+/**
+   \details Enable or disable the compression of the requests sent on a
+   session
+
+   Compression only applies to EcDoRpcExt2 transactions, and requests
+   are only compressed when it makes them smaller.
+
+   \param session pointer to the MAPI session context
+   \param enable whether requests should be compressed
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_INITIALIZED
+ */
+_PUBLIC_ enum MAPISTATUS emsmdb_set_request_compression(struct mapi_session *session, bool enable)
+{
+	OPENCHANGE_RETVAL_IF(!session || !session->emsmdb || !session->emsmdb->ctx, MAPI_E_NOT_INITIALIZED, NULL);
+
+	((struct emsmdb_context *)session->emsmdb->ctx)->compress_requests = enable;
+
+	return MAPI_E_SUCCESS;
+}
+
+
 /**
    \details Free property values retrieved with pull_emsmdb_property
 
@@ -953,7 +1001,8 @@ const void *pull_emsmdb_property(TALLOC_CTX *mem_ctx,
 
 
 /**
-   \details Get a SPropValue array from a DATA blob
+   \details Get a SPropValue array from a DATA blob and report how
+   many bytes of the blob it spans
 
    \param mem_ctx pointer to the memory context
    \param content pointer to the DATA blob content
@@ -961,15 +1010,17 @@ const void *pull_emsmdb_property(TALLOC_CTX *mem_ctx,
    \param propvals pointer on pointer to the returned SPropValues
    \param cn_propvals pointer to the number of propvals
    \param flag describes the type data
+   \param consumed pointer to the number of bytes read from content
 
    \return MAPI_E_SUCCESS on success
  */
-enum MAPISTATUS emsmdb_get_SPropValue(TALLOC_CTX *mem_ctx,
-				      DATA_BLOB *content,
-				      struct SPropTagArray *tags,
-				      struct SPropValue **propvals, 
-				      uint32_t *cn_propvals,
-				      uint8_t flag)
+enum MAPISTATUS emsmdb_get_SPropValue_consumed(TALLOC_CTX *mem_ctx,
+					       DATA_BLOB *content,
+					       struct SPropTagArray *tags,
+					       struct SPropValue **propvals,
+					       uint32_t *cn_propvals,
+					       uint8_t flag,
+					       uint32_t *consumed)
 {
 	struct SPropValue	*p_propval;
 	uint32_t		i_propval;
@@ -1010,10 +1061,36 @@ enum MAPISTATUS emsmdb_get_SPropValue(TALLOC_CTX *mem_ctx,
 
 	(*propvals)[i_propval].ulPropTag = (enum MAPITAGS) 0x0;
 	*cn_propvals = i_propval;
+	*consumed = offset;
 	return MAPI_E_SUCCESS;
 }
 
 
+/**
+   \details Get a SPropValue array from a DATA blob
+
+   \param mem_ctx pointer to the memory context
+   \param content pointer to the DATA blob content
+   \param tags pointer to a list of property tags to lookup
+   \param propvals pointer on pointer to the returned SPropValues
+   \param cn_propvals pointer to the number of propvals
+   \param flag describes the type data
+
+   \return MAPI_E_SUCCESS on success
+ */
+enum MAPISTATUS emsmdb_get_SPropValue(TALLOC_CTX *mem_ctx,
+				      DATA_BLOB *content,
+				      struct SPropTagArray *tags,
+				      struct SPropValue **propvals, 
+				      uint32_t *cn_propvals,
+				      uint8_t flag)
+{
+	uint32_t	consumed;
+
+	return emsmdb_get_SPropValue_consumed(mem_ctx, content, tags, propvals, cn_propvals, flag, &consumed);
+}
+
+
 /**
    \details Get a SPropValue array from a DATA blob
 
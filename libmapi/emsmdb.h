@@ -47,8 +47,12 @@ struct emsmdb_context {
 	struct emsmdb_info	info;
 	struct policy_handle	async_handle; ///< The handle to use for Async notification requests
 	struct dcerpc_pipe	*async_rpc_connection;
+	bool			compress_requests; ///< LZXPRESS compress EcDoRpcExt2 requests
 };
 
+/* EcDoRpcExt2 requests smaller than this are never compressed */
+#define	EMSMDB_COMPRESSION_THRESHOLD	0x100
+
 #define	MAILBOX_PATH	"/o=%s/ou=%s/cn=Recipients/cn=%s"
 
 #endif /* __EMSMDB_H__ */
@@ -41,7 +41,8 @@ struct GLOBSET_parser {
 	uint8_t				total_stack_size;
 	bool				error;
 	uint32_t			range_count;
-	struct globset_range	*ranges;
+	uint32_t			range_size;
+	struct globset_range		*ranges;
 };
 
 /**
@@ -61,6 +62,26 @@ static inline bool GLOBSET_parser_do_push(struct GLOBSET_parser *parser, uint8_t
 static inline bool GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser);
 static void GLOBSET_parser_do_pop(struct GLOBSET_parser *parser);
 static bool GLOBSET_parser_do_range(struct GLOBSET_parser *parser);
+static void IDSET_reorder_ranges(struct idset *idset);
+static void IDSET_compact_ranges(struct idset *idset);
+
+/* Returns true on an allocation error */
+static bool GLOBSET_parser_add_range(struct GLOBSET_parser *parser, uint64_t low, uint64_t high)
+{
+	if (parser->range_count == parser->range_size) {
+		parser->range_size = parser->range_size ? parser->range_size * 2 : 8;
+		parser->ranges = talloc_realloc(parser, parser->ranges, struct globset_range, parser->range_size);
+		if (!parser->ranges) {
+			OC_DEBUG(3, "Impossible to allocate ranges");
+			return true;
+		}
+	}
+	parser->ranges[parser->range_count].low = low;
+	parser->ranges[parser->range_count].high = high;
+	parser->range_count++;
+
+	return false;
+}
 
 /* Returns true on an error on parsing */
 static inline bool GLOBSET_parser_do_push(struct GLOBSET_parser *parser, uint8_t count)
@@ -154,21 +175,16 @@ static uint64_t GLOBSET_parser_range_value(DATA_BLOB *combined)
 static bool GLOBSET_parser_do_range(struct GLOBSET_parser *parser)
 {
 	uint8_t count;
-	struct globset_range *range;
+	uint64_t low, high;
 	DATA_BLOB *combined, *additional;
 	void *mem_ctx;
+	bool error;
 
 	mem_ctx = talloc_new(NULL);
 	if (!mem_ctx) {
 		OC_DEBUG(3, "Impossible to allocate memory context");
 		return true;
 	}
-	range = talloc_zero(parser, struct globset_range);
-	if (!range) {
-		OC_DEBUG(3, "Impossible to allocate a range");
-		talloc_free(mem_ctx);
-		return true;
-	}
 
 	count = 6 - parser->total_stack_size;
 
@@ -197,10 +213,10 @@ static bool GLOBSET_parser_do_range(struct GLOBSET_parser *parser)
 		talloc_free(mem_ctx);
 		return true;
 	}
-	range->low = GLOBSET_parser_range_value(combined);
+	low = GLOBSET_parser_range_value(combined);
 
 	if (count == 0) {
-		range->high = range->low;
+		high = low;
 	}
 	else if (count > 0) {
 		memcpy(additional->data, parser->buffer.data + parser->buffer_position, count);
@@ -210,16 +226,15 @@ static bool GLOBSET_parser_do_range(struct GLOBSET_parser *parser)
 			talloc_free(mem_ctx);
 			return true;
 		}
-		range->high = GLOBSET_parser_range_value(combined);
+		high = GLOBSET_parser_range_value(combined);
 	}
 
-	DLIST_ADD_END(parser->ranges, range, void);
-	/* OC_DEBUG(5, "  added range: [%.16"PRIx64":%.16"PRIx64"] %p  %p %p", range->low, range->high, range, range->prev, range->next); */
-	parser->range_count++;
+	error = GLOBSET_parser_add_range(parser, low, high);
+	/* OC_DEBUG(5, "  added range: [%.16"PRIx64":%.16"PRIx64"]", low, high); */
 
 	talloc_free(mem_ctx);
 
-	return false;
+	return error;
 }
 
 /* Return true if there was a parsing error */
@@ -228,7 +243,6 @@ static inline bool GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser)
 	uint8_t mask, bit, i;
 	DATA_BLOB *combined, additional;
 	uint64_t baseValue, lowValue, highValue;
-	struct globset_range *range;
 	bool blank = false;
 
 	mask = parser->buffer.data[parser->buffer_position+1];
@@ -257,15 +271,9 @@ static inline bool GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser)
 			}
 		} else {
 			if ((mask & bit) == 0) {
-				range = talloc_zero(parser, struct globset_range);
-				if (!range) {
-					OC_DEBUG(3, "Impossible to allocate range");
+				if (GLOBSET_parser_add_range(parser, lowValue, highValue)) {
 					return true;
 				}
-				range->low = lowValue;
-				range->high = highValue;
-				DLIST_ADD_END(parser->ranges, range, void);
-				parser->range_count++;
 				blank = true;
 			} else {
 				highValue = baseValue + ((uint64_t) (i + 1) << 40);
@@ -274,15 +282,7 @@ static inline bool GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser)
 	}
 
 	if (!blank) {
-		range = talloc_zero(parser, struct globset_range);
-		if (!range) {
-			OC_DEBUG(3, "Impossible to allocate range");
-			return true;
-		}
-		range->low = lowValue;
-		range->high = highValue;
-		DLIST_ADD_END(parser->ranges, range, void);
-		parser->range_count++;
+		return GLOBSET_parser_add_range(parser, lowValue, highValue);
 	}
 
 	return false;
@@ -290,11 +290,13 @@ static inline bool GLOBSET_parser_do_bitmask(struct GLOBSET_parser *parser)
 
 /**
   \details deserialize a GLOBSET following the format described in [OXCFXICS - 2.2.2.5]
+
+  \return a talloc array of *countP ranges in wire order, or NULL on error
 */
 _PUBLIC_ struct globset_range *GLOBSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buffer, uint32_t *countP, uint32_t *byte_countP)
 {
 	struct GLOBSET_parser *parser;
-	struct globset_range *ranges, *range;
+	struct globset_range *ranges;
 	bool end = false;
 	uint8_t command;
 
@@ -355,20 +357,17 @@ _PUBLIC_ struct globset_range *GLOBSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buff
 		ranges = NULL;
 		/* abort(); */
 	} else {
-		ranges = parser->ranges;
+		ranges = NULL;
+		if (parser->range_count > 0) {
+			ranges = talloc_realloc(parser, parser->ranges, struct globset_range, parser->range_count);
+			ranges = talloc_steal(mem_ctx, ranges);
+		}
 		if (countP) {
 			*countP = parser->range_count;
 		}
 		if (byte_countP) {
 			*byte_countP = parser->buffer_position;
 		}
-		if (ranges) {
-			range = ranges;
-			while (range) {
-				(void) talloc_reference(mem_ctx, range);
-				range = range->next;
-			}
-		}
 	}
 	talloc_free(parser);
 
@@ -379,7 +378,6 @@ _PUBLIC_ struct globset_range *GLOBSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buff
 static void check_idset(const struct idset *idset)
 {
 	uint32_t i;
-	struct globset_range *range, *last_range;
 
 	while (idset) {
 		if (!idset->idbased && GUID_all_zero(&idset->repl.guid)) {
@@ -387,29 +385,17 @@ static void check_idset(const struct idset *idset)
 			abort();
 		}
 
-		i = 0;
-		if (idset->ranges) {
-			range = idset->ranges;
-			while (range) {
-				/* OC_DEBUG(5, ("range %d: [%.16Lx:%.16Lx] prev: %p; next: %p", i, range->low, range->high, range->prev, range->next)); */
-				if (range->prev == NULL) {
-					OC_DEBUG(5, "range %d has a NULL prev", i);
-					abort();
-				}
-				i++;
-				last_range = range;
-				range = range->next;
-			}
-			
-			if (idset->ranges->prev != last_range) {
-				OC_DEBUG(5, "idset: last element of linked list is not the expected one");
-				abort();
-			}
+		if (talloc_array_length(idset->ranges) < idset->range_count) {
+			OC_DEBUG(5, "idset: elements count does not match the reported value (%d and %d)",
+				 (int) talloc_array_length(idset->ranges), idset->range_count);
+			abort();
 		}
 
-		if (i != idset->range_count) {
-			OC_DEBUG(5, "idset: elements count does not match the reported value (%d and %d)", i, idset->range_count);
-			abort();
+		for (i = 1; i < idset->range_count; i++) {
+			if (exchange_globcnt(idset->ranges[i-1].high) >= exchange_globcnt(idset->ranges[i].low)) {
+				OC_DEBUG(5, "idset: range %d is not sorted", i);
+				abort();
+			}
 		}
 		idset = idset->next;
 	}
@@ -418,6 +404,31 @@ static void check_idset(const struct idset *idset)
 #define check_idset(x) {}
 #endif
 
+/**
+  \details sort and compact freshly parsed ranges unless they already
+  are in the ascending and disjoint order the lookups rely on. Invalid
+  ranges are left untouched so IDSET_check_ranges can report them.
+*/
+static void IDSET_normalize_ranges(struct idset *idset)
+{
+	bool		sorted = true;
+	uint32_t	i;
+
+	for (i = 0; i < idset->range_count; i++) {
+		if (exchange_globcnt(idset->ranges[i].low) > exchange_globcnt(idset->ranges[i].high)) {
+			return;
+		}
+		if (i > 0 && exchange_globcnt(idset->ranges[i-1].high) >= exchange_globcnt(idset->ranges[i].low)) {
+			sorted = false;
+		}
+	}
+
+	if (!sorted) {
+		IDSET_reorder_ranges(idset);
+		IDSET_compact_ranges(idset);
+	}
+}
+
 /**
   \details deserialize an IDSET following the format described in [OXCFXICS - 2.2.2.4]
 
@@ -456,6 +467,7 @@ _PUBLIC_ struct idset *IDSET_parse(TALLOC_CTX *mem_ctx, DATA_BLOB buffer, bool i
 		idset->ranges = GLOBSET_parse(idset, globset, &idset->range_count, &byte_count);
 		if (idset->ranges != NULL) {
 			total_bytes += byte_count;
+			IDSET_normalize_ranges(idset);
 			check_idset(idset);
 			prev_idset = idset;
 		} else {
@@ -530,8 +542,8 @@ static int IDSET_range_compar(const void *vap, const void *vbp)
 {
 	const struct globset_range *ap, *bp;
 
-	ap = *(const struct globset_range **) vap;
-	bp = *(const struct globset_range **) vbp;
+	ap = (const struct globset_range *) vap;
+	bp = (const struct globset_range *) vbp;
 
 	return IDSET_globcnt_compar(&ap->low, &bp->low);
 }
@@ -557,9 +569,9 @@ static struct idset *IDSET_make(TALLOC_CTX *mem_ctx, bool idbased, uint16_t base
 	}
 	idset->single = single;
 
-	current_globset = talloc_zero(idset, struct globset_range);
-	DLIST_ADD_END(idset->ranges, current_globset, end);
+	idset->ranges = talloc_zero_array(idset, struct globset_range, (length > 0 && !single) ? length : 1);
 	idset->range_count = 1;
+	current_globset = idset->ranges;
 
 	if (length == 0) {
 		return idset;
@@ -584,14 +596,16 @@ static struct idset *IDSET_make(TALLOC_CTX *mem_ctx, bool idbased, uint16_t base
 		for (i = 1; i < length; i++) {
 			if ((exchange_globcnt(work_array[i]) != last_consequent) && (exchange_globcnt(work_array[i]) != (last_consequent + 1))) {
 				current_globset->high = exchange_globcnt(last_consequent);
-				current_globset = talloc_zero(idset, struct globset_range);
-				DLIST_ADD_END(idset->ranges, current_globset, void);
+				current_globset++;
 				idset->range_count++;
 				current_globset->low = work_array[i];
 			}
 			last_consequent = exchange_globcnt(work_array[i]);
 		}
 		current_globset->high = exchange_globcnt(last_consequent);
+		if (idset->range_count < length) {
+			idset->ranges = talloc_realloc(idset, idset->ranges, struct globset_range, idset->range_count);
+		}
 	}
 
 	talloc_free(work_array);
@@ -613,7 +627,7 @@ static void GLOBSET_ndr_push_shifted_id(struct ndr_push *ndr, uint64_t range_id,
 	}
 }
 
-static void GLOBSET_ndr_push_globset_range(struct ndr_push *ndr, struct globset_range *range)
+static void GLOBSET_ndr_push_globset_range(struct ndr_push *ndr, const struct globset_range *range)
 {
 	uint8_t i;
 	uint64_t mask;
@@ -703,32 +717,11 @@ static void IDSET_reorder_idset(struct idset **idsetP)
 
 static void IDSET_reorder_ranges(struct idset *idset)
 {
-	struct globset_range *range;
-	struct globset_range **ranges;
-	uint32_t i;
-
 	if (!idset || idset->range_count < 2) return;
 
-	ranges = talloc_array(NULL, struct globset_range *, idset->range_count);
-	range = idset->ranges;
-	for (i = 0; i < idset->range_count; i++) {
-		ranges[i] = range;
-		range = range->next;
-	}
-
-	qsort(ranges, idset->range_count, sizeof(struct globset_range *), IDSET_range_compar);
-
-	idset->ranges = ranges[0];
-	ranges[0]->prev = ranges[idset->range_count-1];
-	for (i = 0; i < idset->range_count - 1; i++) {
-		ranges[i]->next = ranges[i+1];
-		ranges[i+1]->prev = ranges[i];
-	}
-	ranges[idset->range_count-1]->next = NULL;
+	qsort(idset->ranges, idset->range_count, sizeof(struct globset_range), IDSET_range_compar);
 
 	check_idset(idset);
-
-	talloc_free(ranges);
 }
 
 /* Compact already sorted ranges from an idset.
@@ -749,73 +742,95 @@ static void IDSET_reorder_ranges(struct idset *idset)
 */
 static void IDSET_compact_ranges(struct idset *idset)
 {
-	bool compact = false;
-	struct globset_range *range, *next_range, *prev_range;
+	struct globset_range	*ranges;
+	uint32_t		i, last;
 
 	if (!idset || idset->range_count < 2) return;
 
+	ranges = idset->ranges;
 	if (idset->single) {
-		range = idset->ranges;
-		next_range = range->next;
-		while (next_range) {
-			if (exchange_globcnt(next_range->low) < exchange_globcnt(range->low)) {
-				range->low = next_range->low;
+		for (i = 1; i < idset->range_count; i++) {
+			if (exchange_globcnt(ranges[i].low) < exchange_globcnt(ranges[0].low)) {
+				ranges[0].low = ranges[i].low;
 			}
-			if (exchange_globcnt(next_range->high) > exchange_globcnt(range->high)) {
-				range->high = next_range->high;
+			if (exchange_globcnt(ranges[i].high) > exchange_globcnt(ranges[0].high)) {
+				ranges[0].high = ranges[i].high;
 			}
-			prev_range = next_range;
-			next_range = next_range->next;
-			talloc_free(prev_range);
 		}
-		range->next = NULL;
-		range->prev = range;
 		idset->range_count = 1;
 	} else {
-		range = idset->ranges;
-		while (range) {
-			next_range = range->next;
-			while (next_range) {
-				compact = false;
-				if (exchange_globcnt(next_range->low) >= exchange_globcnt(range->low)
-				    && exchange_globcnt(next_range->low) <= exchange_globcnt(range->high)) {		/* A[  B[...  ]A */
-					if (exchange_globcnt(next_range->high) > exchange_globcnt(range->high)) {	/* A[  B[  ]A  ]B -> A[	 B[  ]AB */
-						range->high = next_range->high;
-					}
-					compact = true;
-				} else if (exchange_globcnt(next_range->low) >= exchange_globcnt(range->low)
-					   && exchange_globcnt(range->high) + 1 == exchange_globcnt(next_range->low)) { /* A[ ... ]AB[ ... ]B */
-					range->high = next_range->high;
-					compact = true;
-				} else {
-					next_range = NULL;
-				}
-				if (compact) {
-					range->next = next_range->next;
-					if (range->next) {
-						range->next->prev = range;
-					}
-					if (idset->ranges->prev == next_range) {
-						idset->ranges->prev = range;
-					}
-					idset->range_count--;
-					talloc_free(next_range);
-					next_range = range->next;
+		last = 0;
+		for (i = 1; i < idset->range_count; i++) {
+			if (exchange_globcnt(ranges[i].low) <= exchange_globcnt(ranges[last].high) + 1) {
+				/* A[ B[ ... ]A or A[ ... ]AB[ ... ]B */
+				if (exchange_globcnt(ranges[i].high) > exchange_globcnt(ranges[last].high)) {
+					ranges[last].high = ranges[i].high;
 				}
+			} else {
+				last++;
+				ranges[last] = ranges[i];
 			}
-			range = range->next;
 		}
+		idset->range_count = last + 1;
 	}
 
+	idset->ranges = talloc_realloc(idset, ranges, struct globset_range, idset->range_count);
+
 	check_idset(idset);
 }
 
+/**
+  \details merge two sorted and compacted range arrays into a new one
+  in a single pass, compacting overlapping and consecutive ranges on
+  the way.
+
+  \param mem_ctx pointer to the memory context where the array is allocated
+  \param left the left ranges
+  \param left_count the number of left ranges
+  \param right the right ranges
+  \param right_count the number of right ranges
+  \param countP pointer to the number of merged ranges
+
+  \return the merged range array or NULL on allocation error
+*/
+static struct globset_range *IDSET_merge_ranges(TALLOC_CTX *mem_ctx,
+						const struct globset_range *left, uint32_t left_count,
+						const struct globset_range *right, uint32_t right_count,
+						uint32_t *countP)
+{
+	struct globset_range		*ranges;
+	const struct globset_range	*range;
+	uint32_t			i = 0, j = 0, count = 0;
+
+	ranges = talloc_array(mem_ctx, struct globset_range, left_count + right_count);
+	if (!ranges) return NULL;
+
+	while (i < left_count || j < right_count) {
+		if (j == right_count
+		    || (i < left_count && exchange_globcnt(left[i].low) <= exchange_globcnt(right[j].low))) {
+			range = &left[i++];
+		} else {
+			range = &right[j++];
+		}
+
+		if (count > 0 && exchange_globcnt(range->low) <= exchange_globcnt(ranges[count-1].high) + 1) {
+			if (exchange_globcnt(range->high) > exchange_globcnt(ranges[count-1].high)) {
+				ranges[count-1].high = range->high;
+			}
+		} else {
+			ranges[count++] = *range;
+		}
+	}
+
+	*countP = count;
+	return talloc_realloc(mem_ctx, ranges, struct globset_range, count);
+}
+
 /**
   \details returns an exact but totally distinct copy of an idset structure
 */
 static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source_idset)
 {
-	struct globset_range *range, *clone;
 	struct idset *idset = NULL, *head_idset = NULL, *tail_idset;
 
 	if (!source_idset) return NULL;
@@ -834,14 +849,9 @@ static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source
 		}
 		idset->single = source_idset->single;
 		idset->range_count = source_idset->range_count;
-
-		range = source_idset->ranges;
-		while (range) {
-			clone = talloc_zero(idset, struct globset_range);
-			clone->low = range->low;
-			clone->high = range->high;
-			DLIST_ADD_END(idset->ranges, clone, void);
-			range = range->next;
+		if (source_idset->range_count > 0) {
+			idset->ranges = talloc_memdup(idset, source_idset->ranges,
+						      sizeof(struct globset_range) * source_idset->range_count);
 		}
 
 		if (!head_idset) {
@@ -860,8 +870,8 @@ static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source
 
 /**
   \details merge two idsets structures into a third one. That is,
-  putting the GLOBSET ranges from the same REPLID/REPLGUID in the same
-  subset to, afterwards, reorder and compact ranges.
+  merging the sorted GLOBSET ranges from the same REPLID/REPLGUID in
+  the same subset in a single pass and compacting them.
 
   \param mem_ctx pointer to the memory context where merged idset is allocated
   \param left the left idset to merge
@@ -876,10 +886,9 @@ static struct idset *IDSET_clone(TALLOC_CTX *mem_ctx, const struct idset *source
 _PUBLIC_ struct idset *IDSET_merge_idsets(TALLOC_CTX *mem_ctx, const struct idset *left, const struct idset *right)
 {
 	struct idset *merged_idset, *clone_right, *current, *next;
-	uint16_t current_id = 0, next_id;
-	struct GUID *current_guid = NULL, *next_guid;
-	bool added_ranges = false, same_id, idbased;
-	struct globset_range *range;
+	struct globset_range *ranges;
+	uint32_t range_count;
+	bool same_id;
 
 	if (!left || left->range_count == 0
 	    || (IDSET_check_ranges(left) != MAPI_E_SUCCESS)) {
@@ -902,31 +911,23 @@ _PUBLIC_ struct idset *IDSET_merge_idsets(TALLOC_CTX *mem_ctx, const struct idse
 	IDSET_reorder_idset(&merged_idset);
 
 	current = merged_idset;
-	idbased = current->idbased;
-	if (idbased) {
-		current_id = current->repl.id;
-	} else {
-		current_guid = &current->repl.guid;
-	}
 	while (current->next) {
 		next = current->next;
 
-		if (idbased) {
-			next_id = next->repl.id;
-			same_id = (current_id == next_id);
+		if (current->idbased) {
+			same_id = (current->repl.id == next->repl.id);
 		} else {
-			next_guid = &next->repl.guid;
-			same_id = GUID_equal(current_guid, next_guid);
+			same_id = GUID_equal(&current->repl.guid, &next->repl.guid);
 		}
-		
+
 		if (same_id) {
-			added_ranges = true;
-			current->range_count += next->range_count;
-			range = next->ranges;
-			current->ranges->prev->next = range;
-			while (range) {
-				(void) talloc_reference(current, range);
-				range = range->next;
+			ranges = IDSET_merge_ranges(current, current->ranges, current->range_count,
+						    next->ranges, next->range_count, &range_count);
+			if (ranges) {
+				talloc_free(current->ranges);
+				current->ranges = ranges;
+				current->range_count = range_count;
+				IDSET_compact_ranges(current);
 			}
 			current->next = next->next;
 			talloc_free(next);
@@ -936,14 +937,7 @@ _PUBLIC_ struct idset *IDSET_merge_idsets(TALLOC_CTX *mem_ctx, const struct idse
 		}
 	}
 
-	if (added_ranges) {
-		current = merged_idset;
-		while (current) {
-			IDSET_reorder_ranges(current);
-			IDSET_compact_ranges(current);
-			current = current->next;
-		}
-	}
+	check_idset(merged_idset);
 
 	return merged_idset;
 }
@@ -954,8 +948,8 @@ _PUBLIC_ struct idset *IDSET_merge_idsets(TALLOC_CTX *mem_ctx, const struct idse
 _PUBLIC_ struct Binary_r *IDSET_serialize(TALLOC_CTX *mem_ctx, const struct idset *idset)
 {
 	struct ndr_push	*ndr;
-	struct globset_range *current_range;
 	struct Binary_r *data;
+	uint32_t	i;
 
 	check_idset(idset);
 
@@ -970,10 +964,8 @@ _PUBLIC_ struct Binary_r *IDSET_serialize(TALLOC_CTX *mem_ctx, const struct idse
 			ndr_push_GUID(ndr, NDR_SCALARS, &idset->repl.guid);
 		}
 
-		current_range = idset->ranges;
-		while (current_range) {
-			GLOBSET_ndr_push_globset_range(ndr, current_range);
-			current_range = current_range->next;
+		for (i = 0; i < idset->range_count; i++) {
+			GLOBSET_ndr_push_globset_range(ndr, &idset->ranges[i]);
 		}
 		ndr_push_uint8(ndr, NDR_SCALARS, 0x00); /* end */
 		idset = idset->next;
@@ -988,12 +980,46 @@ _PUBLIC_ struct Binary_r *IDSET_serialize(TALLOC_CTX *mem_ctx, const struct idse
 	return data;
 }
 
+/**
+  \details binary search the sorted ranges of an idset for the one
+  including a given globcnt
+
+  \param idset pointer to the idset structure to search
+  \param globcnt the globcnt to look for, as stored in the ranges
+
+  \return the index of the range including globcnt or -1 if none
+*/
+static int32_t IDSET_ranges_lookup(const struct idset *idset, uint64_t globcnt)
+{
+	uint64_t	key;
+	uint32_t	low, high, mid;
+
+	key = exchange_globcnt(globcnt);
+
+	/* Find the first range whose low value is above key */
+	low = 0;
+	high = idset->range_count;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (exchange_globcnt(idset->ranges[mid].low) <= key) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	if (low == 0 || exchange_globcnt(idset->ranges[low-1].high) < key) {
+		return -1;
+	}
+
+	return low - 1;
+}
+
 /**
   \details tests the presence of a specific id in the ranges of a ReplID-based idset structure
 */
 _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 {
-	struct globset_range *range;
 	uint16_t eid_id;
 	uint64_t eid_globcnt;
 
@@ -1005,15 +1031,8 @@ _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 	eid_globcnt = eid >> 16;
 
 	while (idset) {
-		if (idset->repl.id == eid_id) {
-			range = idset->ranges;
-			while (range) {
-				if (exchange_globcnt(range->low) <= exchange_globcnt(eid_globcnt)
-				    && exchange_globcnt(range->high) >= exchange_globcnt(eid_globcnt)) {
-					return true;
-				}
-				range = range->next;
-			}
+		if (idset->repl.id == eid_id && IDSET_ranges_lookup(idset, eid_globcnt) >= 0) {
+			return true;
 		}
 		idset = idset->next;
 	}
@@ -1026,8 +1045,6 @@ _PUBLIC_ bool IDSET_includes_eid(const struct idset *idset, uint64_t eid)
 */
 _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *replica_guid, uint64_t id)
 {
-	struct globset_range *range;
-
 	if (!idset || idset->idbased) {
 		return false;
 	}
@@ -1036,14 +1053,8 @@ _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *r
 	}
 
 	while (idset) {
-		if (GUID_equal(&idset->repl.guid, replica_guid)) {
-			range = idset->ranges;
-			while (range) {
-				if (exchange_globcnt(range->low) <= exchange_globcnt(id) && exchange_globcnt(range->high) >= exchange_globcnt(id)) {
-					return true;
-				}
-				range = range->next;
-			}
+		if (GUID_equal(&idset->repl.guid, replica_guid) && IDSET_ranges_lookup(idset, id) >= 0) {
+			return true;
 		}
 		idset = idset->next;
 	}
@@ -1052,45 +1063,44 @@ _PUBLIC_ bool IDSET_includes_guid_glob(const struct idset *idset, struct GUID *r
 }
 
 static void IDSET_ranges_remove_globcnt(struct idset *idset, uint64_t eid) {
-	struct globset_range *range, *new_range;
-	bool done = false;
+	struct globset_range *range, *ranges;
+	int32_t index;
 	uint64_t work_eid;
 
-	work_eid = exchange_globcnt(eid);
+	index = IDSET_ranges_lookup(idset, eid);
+	if (index < 0) {
+		return;
+	}
 
-	range = idset->ranges;
-	while (!done && range) {
-		if (range->low == eid) {
-			if (range->high == eid) {
-				DLIST_REMOVE(idset->ranges, range);
-				idset->range_count--;
-				if (range->next == NULL && idset->ranges != NULL) {
-					idset->ranges->prev = range->prev;
-				}
-				talloc_free(range);
-			}
-			else {
-				range->low = exchange_globcnt(work_eid + 1);
-			}
-			done = true;
-		}
-		else if (range->high == eid) {
-			range->high = exchange_globcnt(work_eid - 1);
-			done = true;
-		}
-		else if ((exchange_globcnt(range->low) < work_eid) && (exchange_globcnt(range->high) > work_eid)) {
-			new_range = talloc_zero(idset, struct globset_range);
-			new_range->low = exchange_globcnt(work_eid + 1);
-			new_range->high = range->high;
-			range->high = exchange_globcnt(work_eid - 1);
-			DLIST_ADD_AFTER(idset->ranges, new_range, range);
-			idset->range_count++;
-			done = true;
+	work_eid = exchange_globcnt(eid);
+	range = &idset->ranges[index];
+	if (range->low == eid) {
+		if (range->high == eid) {
+			memmove(range, range + 1, sizeof(struct globset_range) * (idset->range_count - index - 1));
+			idset->range_count--;
 		}
 		else {
-			range = range->next;
+			range->low = exchange_globcnt(work_eid + 1);
 		}
 	}
+	else if (range->high == eid) {
+		range->high = exchange_globcnt(work_eid - 1);
+	}
+	else {
+		/* Split the range in two around eid */
+		ranges = talloc_realloc(idset, idset->ranges, struct globset_range, idset->range_count + 1);
+		if (!ranges) {
+			OC_DEBUG(3, "Impossible to allocate ranges");
+			return;
+		}
+		idset->ranges = ranges;
+		range = &ranges[index];
+		memmove(range + 2, range + 1, sizeof(struct globset_range) * (idset->range_count - index - 1));
+		range[1].low = exchange_globcnt(work_eid + 1);
+		range[1].high = range->high;
+		range->high = exchange_globcnt(work_eid - 1);
+		idset->range_count++;
+	}
 }
 
 _PUBLIC_ void IDSET_remove_rawidset(struct idset *idset, const struct rawidset *rawidset)
@@ -1143,7 +1153,7 @@ _PUBLIC_ void IDSET_remove_rawidset(struct idset *idset, const struct rawidset *
 */
 _PUBLIC_ void IDSET_dump(const struct idset *idset, const char *label)
 {
-	struct globset_range *range;
+	const struct globset_range *range;
 	uint32_t i;
 	char *guid_str;
 
@@ -1164,7 +1174,7 @@ _PUBLIC_ void IDSET_dump(const struct idset *idset, const char *label)
 			if (exchange_globcnt(range->low) > exchange_globcnt(range->high)) {
 				oc_log(OC_LOG_ERROR, "Incorrect GLOBCNT range as high value is larger than low value");
 			}
-			range = range->next;
+			range++;
 		}
 
 		idset = idset->next;
@@ -1181,19 +1191,16 @@ _PUBLIC_ void IDSET_dump(const struct idset *idset, const char *label)
 */
 _PUBLIC_ enum MAPISTATUS IDSET_check_ranges(const struct idset *idset)
 {
-	struct globset_range *range;
 	uint32_t	     i;
 
 	OPENCHANGE_RETVAL_IF(!idset, ecRpcFormat, NULL);
 
 	while (idset) {
-		range = idset->ranges;
+		OPENCHANGE_RETVAL_IF(idset->range_count && !idset->ranges, ecRpcFormat, NULL);
 		for (i = 0; i < idset->range_count; i++) {
-			OPENCHANGE_RETVAL_IF(!range, ecRpcFormat, NULL);
-			if (exchange_globcnt(range->low) > exchange_globcnt(range->high)) {
+			if (exchange_globcnt(idset->ranges[i].low) > exchange_globcnt(idset->ranges[i].high)) {
 				return ecRpcFormat;
 			}
-			range = range->next;
 		}
 		idset = idset->next;
 	}
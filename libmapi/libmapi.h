@@ -114,7 +114,9 @@ NTSTATUS		emsmdb_transaction_null(struct emsmdb_context *, struct mapi_response
 NTSTATUS		emsmdb_transaction(struct emsmdb_context *, TALLOC_CTX *, struct mapi_request *, struct mapi_response **);
 NTSTATUS		emsmdb_transaction_ext2(struct emsmdb_context *, TALLOC_CTX *, struct mapi_request *, struct mapi_response **);
 NTSTATUS		emsmdb_transaction_wrapper(struct mapi_session *, TALLOC_CTX *, struct mapi_request *, struct mapi_response **);
+struct ndr_push		*emsmdb_ext2_rgbIn(TALLOC_CTX *, struct mapi_request *, bool);
 struct emsmdb_info	*emsmdb_get_info(struct mapi_session *);
+enum MAPISTATUS		emsmdb_set_request_compression(struct mapi_session *, bool);
 void			emsmdb_get_SRowSet(TALLOC_CTX *, struct SRowSet *, struct SPropTagArray *, DATA_BLOB *);
 
 /* The following public definitions come from libmapi/cdo_mapi.c */
@@ -209,6 +211,14 @@ void			mapi_object_debug(mapi_object_t *);
 enum MAPISTATUS		mapi_object_bookmark_get_count(mapi_object_t *, uint32_t *);
 enum MAPISTATUS		mapi_object_bookmark_debug(mapi_object_t *);
 
+/* The following public definitions come from libmapi/mapi_batch.c */
+struct mapi_batch;
+enum MAPISTATUS		mapi_batch_begin(mapi_object_t *, struct mapi_batch **);
+enum MAPISTATUS		mapi_batch_OpenMessage(struct mapi_batch *, mapi_object_t *, mapi_id_t, mapi_id_t, mapi_object_t *, uint8_t, enum MAPISTATUS *);
+enum MAPISTATUS		mapi_batch_GetProps(struct mapi_batch *, mapi_object_t *, uint32_t, struct SPropTagArray *, struct SPropValue **, uint32_t *, enum MAPISTATUS *);
+enum MAPISTATUS		mapi_batch_Release(struct mapi_batch *, mapi_object_t *, enum MAPISTATUS *);
+enum MAPISTATUS		mapi_batch_commit(struct mapi_batch *);
+
 /* The following public definitions come from libmapi/mapi_id_array.c */
 enum MAPISTATUS		mapi_id_array_init(TALLOC_CTX *, mapi_id_array_t *);
 enum MAPISTATUS		mapi_id_array_release(mapi_id_array_t *);
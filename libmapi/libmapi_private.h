@@ -88,6 +88,7 @@ NTSTATUS		emsmdb_register_notification(struct mapi_session *, struct NOTIFKEY *)
 void			free_emsmdb_property(struct SPropValue *, void *);
 const void		*pull_emsmdb_property(TALLOC_CTX *, uint32_t *, enum MAPITAGS, DATA_BLOB *);
 enum MAPISTATUS		emsmdb_get_SPropValue(TALLOC_CTX *, DATA_BLOB *, struct SPropTagArray *, struct SPropValue **, uint32_t *, uint8_t);
+enum MAPISTATUS		emsmdb_get_SPropValue_consumed(TALLOC_CTX *, DATA_BLOB *, struct SPropTagArray *, struct SPropValue **, uint32_t *, uint8_t, uint32_t *);
 enum MAPISTATUS		emsmdb_get_SPropValue_offset(TALLOC_CTX *, DATA_BLOB *, struct SPropTagArray *, struct SPropValue **, uint32_t *, uint32_t *);
 void			emsmdb_get_SRow(TALLOC_CTX *, struct SRow *, struct SPropTagArray *, uint16_t, DATA_BLOB *, uint8_t, uint8_t);
 enum MAPISTATUS		emsmdb_async_connect(struct emsmdb_context *);
@@ -114,6 +115,9 @@ enum MAPISTATUS		mapi_object_bookmark_find(mapi_object_t *, uint32_t,struct SBin
 enum MAPITAGS		*get_MAPITAGS_SRow(TALLOC_CTX *, struct SRow *, uint32_t *);
 uint32_t		MAPITAGS_delete_entries(enum MAPITAGS *, uint32_t, uint32_t, ...);
 size_t			get_utf8_utf16_conv_length(const char *);
+uint32_t		mapi_phash_proptag(uint32_t, uint32_t);
+uint32_t		mapi_phash_string(uint32_t, const char *);
+uint32_t		mapi_phash_nameid(uint32_t, uint16_t, const char *, const char *);
 
 /* The following private definitions come from libmapi/IProfAdmin.c */
 enum MAPISTATUS		OpenProfileStore(TALLOC_CTX *, struct ldb_context **, const char *);
@@ -128,6 +132,9 @@ uint32_t		get_mapi_SRestriction_size(struct mapi_SRestriction *);
 enum MAPISTATUS		Logon(struct mapi_session *, struct mapi_provider *, enum PROVIDER_ID);
 enum MAPISTATUS		GetNewLogonId(struct mapi_session *, uint8_t *);
 
+/* The following private definitions come from libmapi/IStoreFolder.c */
+void			OpenMessage_set_private_data(struct mapi_session *, mapi_object_t *, struct OpenMessage_repl *);
+
 /* The following private definitions come from libmapi/IMessage.c */
 uint8_t			mapi_recipients_get_org_length(struct mapi_profile *);
 uint16_t		mapi_recipients_RecipientFlags(struct SRow *);
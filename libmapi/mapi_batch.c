@@ -0,0 +1,645 @@
+/*
+   OpenChange MAPI implementation.
+
+   Copyright (C) OpenChange Project 2015.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+
+/**
+   \file mapi_batch.c
+
+   \brief Send several ROPs in a single EMSMDB round-trip
+
+   Operations queued on a batch are only sent when the batch is
+   committed. Objects opened by a queued operation can be used by the
+   following ones: they are chained through the handle table of the
+   request, as Outlook does.
+
+   A batch is split in as many requests as needed so neither the ROP
+   request nor the expected ROP response exceeds what a single
+   EcDoRpc/EcDoRpcExt2 call can carry. Operations the server did not
+   process (RopBufferTooSmall) are sent again with the next request.
+ */
+
+
+/* Room left for ROPs in a request or a response buffer (MS-OXCRPC 3.1.4.2) */
+#define	MAPI_BATCH_MAX_BUFFER		0x7F00
+/* The handle table is indexed by 8 bits, 0xFF is reserved */
+#define	MAPI_BATCH_MAX_HANDLES		0xFF
+/* Response estimates */
+#define	MAPI_BATCH_OPENMESSAGE_REPL	0x400
+#define	MAPI_BATCH_VARIABLE_PROP	0x200
+
+enum mapi_batch_op_type {
+	MAPI_BATCH_OPENMESSAGE,
+	MAPI_BATCH_GETPROPS,
+	MAPI_BATCH_RELEASE
+};
+
+struct mapi_batch_op {
+	enum mapi_batch_op_type		type;
+	struct EcDoRpc_MAPI_REQ		req;
+	uint32_t			req_size;	/* ROP size in the request */
+	uint32_t			repl_size;	/* estimated ROP size in the response */
+	mapi_object_t			*obj;		/* object the ROP applies to */
+	int32_t				producer;	/* queued operation opening obj, -1 if none */
+	mapi_object_t			*obj_message;	/* OpenMessage result */
+	struct SPropTagArray		properties;	/* GetProps tags */
+	struct SPropValue		**lpProps;
+	uint32_t			*PropCount;
+	enum MAPISTATUS			*retval;
+	bool				done;
+	bool				in_round;
+	uint8_t				out_idx;	/* handle index of obj_message */
+};
+
+struct mapi_batch {
+	struct mapi_session		*session;
+	struct mapi_batch_op		*ops;
+	uint32_t			count;
+};
+
+
+/**
+   \details Start a new batch of ROPs
+
+   \param obj any object opened on the session the batch is for,
+   usually the message store
+   \param batch pointer on pointer to the returned batch. It must be
+   released with talloc_free once committed
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa mapi_batch_commit
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_begin(mapi_object_t *obj, struct mapi_batch **batch)
+{
+	struct mapi_session	*session;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!obj, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_INVALID_PARAMETER, NULL);
+	session = mapi_object_get_session(obj);
+	OPENCHANGE_RETVAL_IF(!session, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!session->mapi_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+
+	*batch = talloc_zero(session, struct mapi_batch);
+	OPENCHANGE_RETVAL_IF(!*batch, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	(*batch)->session = session;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Append an operation on obj to the batch
+
+   If obj is opened by an operation already queued, the new operation
+   refers to it and inherits its logon identifier.
+
+   \param batch pointer to the batch
+   \param type the operation type
+   \param obj the object the operation applies to
+   \param retval pointer to the status to report, may be NULL
+
+   \return pointer to the new operation on success, otherwise NULL
+ */
+static struct mapi_batch_op *mapi_batch_add(struct mapi_batch *batch,
+					    enum mapi_batch_op_type type,
+					    mapi_object_t *obj,
+					    enum MAPISTATUS *retval)
+{
+	struct mapi_batch_op	*op;
+	int32_t			producer = -1;
+	uint8_t			logon_id;
+	int32_t			i;
+
+	for (i = batch->count - 1; i >= 0; i--) {
+		if (batch->ops[i].type == MAPI_BATCH_OPENMESSAGE && batch->ops[i].obj_message == obj) {
+			producer = i;
+			break;
+		}
+	}
+
+	if (producer >= 0) {
+		logon_id = batch->ops[producer].req.logon_id;
+	} else if (mapi_object_get_session(obj) != batch->session ||
+		   mapi_object_get_logon_id(obj, &logon_id) != MAPI_E_SUCCESS) {
+		return NULL;
+	}
+
+	batch->ops = talloc_realloc(batch, batch->ops, struct mapi_batch_op, batch->count + 1);
+	if (!batch->ops) return NULL;
+
+	op = &batch->ops[batch->count++];
+	memset(op, 0, sizeof (struct mapi_batch_op));
+	op->type = type;
+	op->obj = obj;
+	op->producer = producer;
+	op->retval = retval;
+	op->req.logon_id = logon_id;
+	op->req_size = 5 - sizeof (uint16_t);
+	op->repl_size = sizeof (uint8_t) + sizeof (uint8_t) + sizeof (uint32_t);
+	if (retval) {
+		*retval = MAPI_E_UNABLE_TO_COMPLETE;
+	}
+
+	return op;
+}
+
+
+/**
+   \details Queue an OpenMessage operation
+
+   obj_message is only usable once the batch is committed, but it may
+   already be passed to the following operations of the same batch.
+
+   \param batch pointer to the batch
+   \param obj_store the store to open the message from
+   \param id_folder the folder ID
+   \param id_message the message ID
+   \param obj_message the resulting message object
+   \param ulFlags the open mode, see OpenMessage
+   \param retval pointer to the status of the operation, set by
+   mapi_batch_commit. May be NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa OpenMessage
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_OpenMessage(struct mapi_batch *batch,
+						mapi_object_t *obj_store,
+						mapi_id_t id_folder,
+						mapi_id_t id_message,
+						mapi_object_t *obj_message,
+						uint8_t ulFlags,
+						enum MAPISTATUS *retval)
+{
+	struct mapi_batch_op	*op;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!obj_store || !obj_message, MAPI_E_INVALID_PARAMETER, NULL);
+
+	op = mapi_batch_add(batch, MAPI_BATCH_OPENMESSAGE, obj_store, retval);
+	OPENCHANGE_RETVAL_IF(!op, MAPI_E_INVALID_PARAMETER, NULL);
+
+	op->obj_message = obj_message;
+	op->req.opnum = op_MAPI_OpenMessage;
+	op->req.u.mapi_OpenMessage.CodePageId = 0xfff;
+	op->req.u.mapi_OpenMessage.FolderId = id_folder;
+	op->req.u.mapi_OpenMessage.OpenModeFlags = (enum OpenMessage_OpenModeFlags)ulFlags;
+	op->req.u.mapi_OpenMessage.MessageId = id_message;
+	op->req_size += sizeof (uint8_t) + sizeof(uint16_t) + sizeof(mapi_id_t) + sizeof(uint8_t) + sizeof(mapi_id_t);
+	op->repl_size += MAPI_BATCH_OPENMESSAGE_REPL;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue a GetProps operation
+
+   Unlike GetProps, named properties are not resolved: SPropTagArray
+   must only hold tags already mapped for the store.
+
+   \param batch pointer to the batch
+   \param obj the object to retrieve properties from
+   \param flags MAPI_UNICODE to request Unicode strings
+   \param SPropTagArray the properties to retrieve
+   \param lpProps pointer on pointer to the returned properties, set
+   by mapi_batch_commit
+   \param PropCount pointer to the number of returned properties
+   \param retval pointer to the status of the operation, set by
+   mapi_batch_commit. May be NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa GetProps
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_GetProps(struct mapi_batch *batch,
+					     mapi_object_t *obj,
+					     uint32_t flags,
+					     struct SPropTagArray *SPropTagArray,
+					     struct SPropValue **lpProps,
+					     uint32_t *PropCount,
+					     enum MAPISTATUS *retval)
+{
+	struct mapi_batch_op	*op;
+	uint32_t		i;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!obj || !SPropTagArray, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!lpProps || !PropCount, MAPI_E_INVALID_PARAMETER, NULL);
+
+	op = mapi_batch_add(batch, MAPI_BATCH_GETPROPS, obj, retval);
+	OPENCHANGE_RETVAL_IF(!op, MAPI_E_INVALID_PARAMETER, NULL);
+
+	*lpProps = NULL;
+	*PropCount = 0;
+	op->lpProps = lpProps;
+	op->PropCount = PropCount;
+
+	op->properties.cValues = SPropTagArray->cValues;
+	op->properties.aulPropTag = talloc_memdup(batch->ops, SPropTagArray->aulPropTag,
+						  SPropTagArray->cValues * sizeof(enum MAPITAGS));
+
+	op->req.opnum = op_MAPI_GetProps;
+	op->req.u.mapi_GetProps.PropertySizeLimit = 0x0;
+	op->req.u.mapi_GetProps.WantUnicode = (flags & MAPI_UNICODE) != 0 ? true : 0x0;
+	op->req.u.mapi_GetProps.prop_count = (uint16_t) SPropTagArray->cValues;
+	op->req.u.mapi_GetProps.properties = op->properties.aulPropTag;
+	op->req_size += sizeof (uint16_t) * 3 + SPropTagArray->cValues * sizeof (uint32_t);
+
+	/* layout, then a flag and a value per property */
+	op->repl_size += sizeof (uint8_t);
+	for (i = 0; i < SPropTagArray->cValues; i++) {
+		switch (SPropTagArray->aulPropTag[i] & 0xFFFF) {
+		case PT_BOOLEAN:
+			op->repl_size += 1 + sizeof (uint8_t);
+			break;
+		case PT_SHORT:
+			op->repl_size += 1 + sizeof (uint16_t);
+			break;
+		case PT_LONG:
+		case PT_ERROR:
+		case PT_FLOAT:
+			op->repl_size += 1 + sizeof (uint32_t);
+			break;
+		case PT_I8:
+		case PT_DOUBLE:
+		case PT_SYSTIME:
+			op->repl_size += 1 + sizeof (uint64_t);
+			break;
+		default:
+			op->repl_size += 1 + MAPI_BATCH_VARIABLE_PROP;
+			break;
+		}
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Queue the release of an object
+
+   Once the batch is committed, obj is reset as mapi_object_release
+   would do.
+
+   \param batch pointer to the batch
+   \param obj the object to release
+   \param retval pointer to the status of the operation, set by
+   mapi_batch_commit. May be NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error.
+
+   \sa Release, mapi_object_release
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_Release(struct mapi_batch *batch,
+					    mapi_object_t *obj,
+					    enum MAPISTATUS *retval)
+{
+	struct mapi_batch_op	*op;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!obj, MAPI_E_INVALID_PARAMETER, NULL);
+
+	op = mapi_batch_add(batch, MAPI_BATCH_RELEASE, obj, retval);
+	OPENCHANGE_RETVAL_IF(!op, MAPI_E_INVALID_PARAMETER, NULL);
+
+	op->req.opnum = op_MAPI_Release;
+	/* Release has no response */
+	op->repl_size = 0;
+
+	return MAPI_E_SUCCESS;
+}
+
+
+/**
+   \details Record the outcome of an operation
+ */
+static void mapi_batch_op_done(struct mapi_batch_op *op, enum MAPISTATUS retval)
+{
+	op->done = true;
+	if (op->retval) {
+		*op->retval = retval;
+	}
+}
+
+
+/**
+   \details Build the next request out of the pending operations
+
+   Operations are taken in order until the request, the estimated
+   response or the handle table is full. The first pending operation
+   is always taken so oversized operations still go through.
+
+   \param batch pointer to the batch
+   \param mem_ctx memory context to allocate the request with
+   \param first index of the first pending operation
+   \param request pointer on pointer to the returned request
+
+   \return the number of operations in the request, 0 if none could
+   be sent
+ */
+static uint32_t mapi_batch_build(struct mapi_batch *batch, TALLOC_CTX *mem_ctx,
+				 uint32_t first, struct mapi_request **request)
+{
+	struct mapi_request	*mapi_request;
+	struct mapi_batch_op	*op;
+	struct mapi_batch_op	*producer;
+	uint32_t		*handles;
+	uint32_t		handle_count = 0;
+	uint32_t		req_size = sizeof (uint16_t);
+	uint32_t		repl_size = sizeof (uint16_t);
+	uint32_t		count = 0;
+	uint32_t		new_handles;
+	mapi_handle_t		handle = INVALID_HANDLE_VALUE;
+	uint32_t		idx;
+	uint32_t		i;
+
+	handles = talloc_array(mem_ctx, uint32_t, MAPI_BATCH_MAX_HANDLES);
+	mapi_request = talloc_zero(mem_ctx, struct mapi_request);
+	mapi_request->mapi_req = talloc_zero_array(mem_ctx, struct EcDoRpc_MAPI_REQ, 2);
+
+	for (i = first; i < batch->count; i++) {
+		op = &batch->ops[i];
+		if (op->done) continue;
+
+		/* Resolve the handle index of the object */
+		producer = (op->producer >= 0) ? &batch->ops[op->producer] : NULL;
+		if (producer && producer->in_round) {
+			idx = producer->out_idx;
+			new_handles = 0;
+		} else {
+			handle = mapi_object_get_handle(op->obj);
+			if (handle == INVALID_HANDLE_VALUE) {
+				mapi_batch_op_done(op, MAPI_E_INVALID_OBJECT);
+				continue;
+			}
+			for (idx = 0; idx < handle_count && handles[idx] != handle; idx++);
+			new_handles = (idx == handle_count) ? 1 : 0;
+		}
+		if (op->type == MAPI_BATCH_OPENMESSAGE) {
+			new_handles++;
+		}
+
+		if (count && ((req_size + op->req_size + (handle_count + new_handles) * sizeof (uint32_t) > MAPI_BATCH_MAX_BUFFER) ||
+			      (repl_size + op->repl_size + (handle_count + new_handles) * sizeof (uint32_t) > MAPI_BATCH_MAX_BUFFER) ||
+			      (handle_count + new_handles > MAPI_BATCH_MAX_HANDLES))) {
+			break;
+		}
+
+		if (idx == handle_count) {
+			handles[handle_count++] = handle;
+		}
+		op->req.handle_idx = idx;
+		if (op->type == MAPI_BATCH_OPENMESSAGE) {
+			op->out_idx = handle_count;
+			op->req.u.mapi_OpenMessage.handle_idx = handle_count;
+			handles[handle_count++] = 0xffffffff;
+		}
+		op->in_round = true;
+
+		mapi_request->mapi_req = talloc_realloc(mem_ctx, mapi_request->mapi_req, struct EcDoRpc_MAPI_REQ, count + 2);
+		mapi_request->mapi_req[count++] = op->req;
+		req_size += op->req_size;
+		repl_size += op->repl_size;
+	}
+
+	if (!count) {
+		talloc_free(mapi_request);
+		talloc_free(handles);
+		return 0;
+	}
+
+	mapi_request->mapi_req[count].opnum = 0;
+	mapi_request->length = req_size;
+	mapi_request->mapi_len = req_size + handle_count * sizeof (uint32_t);
+	mapi_request->handles = handles;
+	*request = mapi_request;
+
+	return count;
+}
+
+
+/**
+   \details Pull the responses following a GetProps response
+
+   GetProps responses span the end of the ROP buffer, so the
+   responses of the following ROPs are parsed out of its tail.
+
+   \return pointer to the responses terminated by a null opnum,
+   otherwise NULL
+ */
+static struct EcDoRpc_MAPI_REPL *mapi_batch_pull_tail(TALLOC_CTX *mem_ctx, DATA_BLOB *prop_data, uint32_t offset)
+{
+	struct EcDoRpc_MAPI_REPL	*repl;
+	struct ndr_pull			*ndr;
+	DATA_BLOB			tail;
+	uint32_t			count = 0;
+
+	tail.data = prop_data->data + offset;
+	tail.length = prop_data->length - offset;
+
+	ndr = ndr_pull_init_blob(&tail, mem_ctx);
+	if (!ndr) return NULL;
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
+
+	repl = talloc_zero_array(mem_ctx, struct EcDoRpc_MAPI_REPL, 1);
+	while (repl && ndr->offset < ndr->data_size) {
+		repl = talloc_realloc(mem_ctx, repl, struct EcDoRpc_MAPI_REPL, count + 2);
+		if (!repl) break;
+		memset(&repl[count], 0, 2 * sizeof (struct EcDoRpc_MAPI_REPL));
+		if (ndr_pull_EcDoRpc_MAPI_REPL(ndr, NDR_SCALARS, &repl[count]) != NDR_ERR_SUCCESS) {
+			repl[count].opnum = 0;
+			break;
+		}
+		count++;
+	}
+
+	return repl;
+}
+
+
+/**
+   \details Dispatch the responses of a request to its operations
+
+   Responses are matched in order, Release excepted as it has none.
+   Operations following a RopBufferTooSmall response were not
+   processed by the server and are left pending.
+
+   \param batch pointer to the batch
+   \param mem_ctx memory context for temporary allocations
+   \param first index of the first pending operation
+   \param mapi_response pointer to the response
+
+   \return the number of operations completed
+ */
+static uint32_t mapi_batch_process(struct mapi_batch *batch, TALLOC_CTX *mem_ctx,
+				   uint32_t first, struct mapi_response *mapi_response)
+{
+	struct mapi_batch_op		*op;
+	struct EcDoRpc_MAPI_REPL	*repl = mapi_response->mapi_repl;
+	struct GetProps_repl		*reply;
+	enum MAPISTATUS			retval;
+	bool				stopped = false;
+	bool				failed = false;
+	uint32_t			completed = 0;
+	uint32_t			consumed;
+	uint32_t			i;
+
+	for (i = first; i < batch->count; i++) {
+		op = &batch->ops[i];
+		if (!op->in_round) continue;
+		op->in_round = false;
+		if (stopped) continue;
+
+		/* The response stream can no longer be trusted */
+		if (failed) {
+			mapi_batch_op_done(op, MAPI_E_CALL_FAILED);
+			completed++;
+			continue;
+		}
+
+		if (op->type == MAPI_BATCH_RELEASE) {
+			if (op->obj->private_data) {
+				talloc_free(op->obj->private_data);
+			}
+			mapi_object_init(op->obj);
+			mapi_batch_op_done(op, MAPI_E_SUCCESS);
+			completed++;
+			continue;
+		}
+
+		while (repl && (repl->opnum == op_MAPI_Notify || repl->opnum == op_MAPI_Pending)) {
+			repl++;
+		}
+		if (!repl || !repl->opnum || repl->opnum == op_MAPI_BufferTooSmall) {
+			stopped = true;
+			continue;
+		}
+		if (repl->opnum != op->req.opnum) {
+			OC_DEBUG(1, "Unexpected response 0x%x to ROP 0x%x", repl->opnum, op->req.opnum);
+			failed = true;
+			mapi_batch_op_done(op, MAPI_E_CALL_FAILED);
+			completed++;
+			continue;
+		}
+
+		retval = repl->error_code;
+		if (op->type == MAPI_BATCH_OPENMESSAGE) {
+			if (retval == MAPI_E_SUCCESS && !mapi_response->handles) {
+				retval = MAPI_E_CALL_FAILED;
+			}
+			if (retval == MAPI_E_SUCCESS) {
+				mapi_object_set_session(op->obj_message, batch->session);
+				mapi_object_set_handle(op->obj_message, mapi_response->handles[op->out_idx]);
+				mapi_object_set_logon_id(op->obj_message, op->req.logon_id);
+				OpenMessage_set_private_data(batch->session, op->obj_message, &repl->u.mapi_OpenMessage);
+			}
+			repl++;
+		} else if (retval != MAPI_E_SUCCESS) {
+			repl++;
+		} else {
+			reply = &repl->u.mapi_GetProps;
+			emsmdb_get_SPropValue_consumed((TALLOC_CTX *)batch->session, &reply->prop_data,
+						       &op->properties, op->lpProps, op->PropCount,
+						       reply->layout, &consumed);
+			if (consumed < reply->prop_data.length) {
+				repl = mapi_batch_pull_tail(mem_ctx, &reply->prop_data, consumed);
+			} else {
+				repl = NULL;
+			}
+		}
+		mapi_batch_op_done(op, retval);
+		completed++;
+	}
+
+	return completed;
+}
+
+
+/**
+   \details Send the operations queued on a batch
+
+   Operations are sent in as few requests as possible. The status of
+   each operation is reported through the retval pointer given when it
+   was queued.
+
+   \param batch pointer to the batch
+
+   \return MAPI_E_SUCCESS when every operation was sent, otherwise
+   MAPI_E_CALL_FAILED if a network problem was encountered. Operations
+   not sent are reported as MAPI_E_UNABLE_TO_COMPLETE.
+
+   \sa mapi_batch_begin
+ */
+_PUBLIC_ enum MAPISTATUS mapi_batch_commit(struct mapi_batch *batch)
+{
+	struct mapi_request	*mapi_request;
+	struct mapi_response	*mapi_response;
+	NTSTATUS		status;
+	TALLOC_CTX		*mem_ctx;
+	uint32_t		first = 0;
+	uint32_t		completed;
+	uint32_t		i;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!batch, MAPI_E_INVALID_PARAMETER, NULL);
+
+	while (first < batch->count) {
+		if (batch->ops[first].done) {
+			first++;
+			continue;
+		}
+
+		mem_ctx = talloc_named(batch, 0, "mapi_batch_commit");
+		if (!mapi_batch_build(batch, mem_ctx, first, &mapi_request)) {
+			talloc_free(mem_ctx);
+			continue;
+		}
+
+		status = emsmdb_transaction_wrapper(batch->session, mem_ctx, mapi_request, &mapi_response);
+		if (!NT_STATUS_IS_OK(status)) {
+			for (i = first; i < batch->count; i++) {
+				batch->ops[i].in_round = false;
+			}
+			talloc_free(mem_ctx);
+			return MAPI_E_CALL_FAILED;
+		}
+
+		if (mapi_response->mapi_repl) {
+			OPENCHANGE_CHECK_NOTIFICATION(batch->session, mapi_response);
+		}
+
+		completed = mapi_batch_process(batch, mem_ctx, first, mapi_response);
+		talloc_free(mapi_response);
+		talloc_free(mem_ctx);
+
+		/* The server did not process a single ROP, retrying would loop */
+		OPENCHANGE_RETVAL_IF(!completed, MAPI_E_CALL_FAILED, NULL);
+	}
+
+	errno = 0;
+	return MAPI_E_SUCCESS;
+}
@@ -30,6 +30,128 @@
 */
 
 
+/*
+  Lookups into mapi_nameid_tags and mapi_nameid_names go through the
+  perfect hash tables generated by script/makepropslist.py. Each table
+  only holds the first entry for a given key, so these helpers return
+  the same entry a linear scan of the arrays would.
+ */
+
+static const struct mapi_nameid_tags *mapi_nameid_find_tag(uint32_t proptag)
+{
+	const struct mapi_nameid_tags	*entry;
+	int32_t				d;
+	uint32_t			slot;
+
+	d = mapi_nameid_tags_tag_displace[mapi_phash_proptag(0, proptag) % MAPI_NAMEID_TAGS_TAG_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_proptag(d, proptag) % MAPI_NAMEID_TAGS_TAG_SIZE;
+	entry = &mapi_nameid_tags[mapi_nameid_tags_tag_slots[slot]];
+
+	return (entry->proptag == proptag) ? entry : NULL;
+}
+
+static const struct mapi_nameid_tags *mapi_nameid_find_lid(uint16_t lid, const char *OLEGUID)
+{
+	const struct mapi_nameid_tags	*entry;
+	int32_t				d;
+	uint32_t			slot;
+
+	d = mapi_nameid_tags_lid_displace[mapi_phash_nameid(0, lid, NULL, OLEGUID) % MAPI_NAMEID_TAGS_LID_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_nameid(d, lid, NULL, OLEGUID) % MAPI_NAMEID_TAGS_LID_SIZE;
+	entry = &mapi_nameid_tags[mapi_nameid_tags_lid_slots[slot]];
+
+	return (entry->lid == lid && !strcmp(entry->OLEGUID, OLEGUID)) ? entry : NULL;
+}
+
+static const struct mapi_nameid_tags *mapi_nameid_find_OOM(const char *OOM, const char *OLEGUID)
+{
+	const struct mapi_nameid_tags	*entry;
+	int32_t				d;
+	uint32_t			slot;
+
+	d = mapi_nameid_tags_OOM_displace[mapi_phash_nameid(0, 0, OOM, OLEGUID) % MAPI_NAMEID_TAGS_OOM_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_nameid(d, 0, OOM, OLEGUID) % MAPI_NAMEID_TAGS_OOM_SIZE;
+	entry = &mapi_nameid_tags[mapi_nameid_tags_OOM_slots[slot]];
+
+	return (entry->OOM && !strcmp(entry->OOM, OOM) &&
+		!strcmp(entry->OLEGUID, OLEGUID)) ? entry : NULL;
+}
+
+static const struct mapi_nameid_tags *mapi_nameid_find_Name(const char *Name, const char *OLEGUID)
+{
+	const struct mapi_nameid_tags	*entry;
+	int32_t				d;
+	uint32_t			slot;
+
+	d = mapi_nameid_tags_Name_displace[mapi_phash_nameid(0, 0, Name, OLEGUID) % MAPI_NAMEID_TAGS_NAME_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_nameid(d, 0, Name, OLEGUID) % MAPI_NAMEID_TAGS_NAME_SIZE;
+	entry = &mapi_nameid_tags[mapi_nameid_tags_Name_slots[slot]];
+
+	return (entry->Name && !strcmp(entry->Name, Name) &&
+		!strcmp(entry->OLEGUID, OLEGUID)) ? entry : NULL;
+}
+
+static const struct mapi_nameid_names *mapi_nameid_names_find_tag(uint32_t proptag)
+{
+	const struct mapi_nameid_names	*entry;
+	int32_t				d;
+	uint32_t			slot;
+
+	d = mapi_nameid_names_tag_displace[mapi_phash_proptag(0, proptag) % MAPI_NAMEID_NAMES_TAG_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_proptag(d, proptag) % MAPI_NAMEID_NAMES_TAG_SIZE;
+	entry = &mapi_nameid_names[mapi_nameid_names_tag_slots[slot]];
+
+	return (entry->proptag == proptag) ? entry : NULL;
+}
+
+static const struct mapi_nameid_names *mapi_nameid_names_find_name(const char *propname)
+{
+	const struct mapi_nameid_names	*entry;
+	int32_t				d;
+	uint32_t			slot;
+
+	d = mapi_nameid_names_name_displace[mapi_phash_string(0, propname) % MAPI_NAMEID_NAMES_NAME_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_string(d, propname) % MAPI_NAMEID_NAMES_NAME_SIZE;
+	entry = &mapi_nameid_names[mapi_nameid_names_name_slots[slot]];
+
+	return strcmp(entry->propname, propname) ? NULL : entry;
+}
+
+/*
+  Append a copy of a mapi_nameid_tags entry to a mapi_nameid structure
+ */
+static enum MAPISTATUS mapi_nameid_add_entry(struct mapi_nameid *mapi_nameid,
+					     const struct mapi_nameid_tags *entry)
+{
+	uint16_t	count;
+
+	mapi_nameid->nameid = talloc_realloc(mapi_nameid,
+					     mapi_nameid->nameid, struct MAPINAMEID,
+					     mapi_nameid->count + 1);
+	mapi_nameid->entries = talloc_realloc(mapi_nameid,
+					      mapi_nameid->entries, struct mapi_nameid_tags,
+					      mapi_nameid->count + 1);
+	count = mapi_nameid->count;
+
+	mapi_nameid->entries[count] = *entry;
+
+	mapi_nameid->nameid[count].ulKind = (enum ulKind) entry->ulKind;
+	GUID_from_string(entry->OLEGUID, &(mapi_nameid->nameid[count].lpguid));
+	switch (entry->ulKind) {
+	case MNID_ID:
+		mapi_nameid->nameid[count].kind.lid = entry->lid;
+		break;
+	case MNID_STRING:
+		mapi_nameid->nameid[count].kind.lpwstr.Name = entry->Name;
+		mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(entry->Name);
+		break;
+	}
+	mapi_nameid->count++;
+
+	return MAPI_E_SUCCESS;
+}
+
+
 /**
    \details Create a new mapi_nameid structure
 
@@ -81,46 +203,19 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_add(struct mapi_nameid *mapi_nameid,
 					     const char *OOM,
 					     const char *OLEGUID)
 {
-	uint32_t		i;
-	uint16_t		count;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!OOM, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].OOM &&
-		    !strcmp(OOM, mapi_nameid_tags[i].OOM) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind)mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_find_OOM(OOM, OLEGUID);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	return mapi_nameid_add_entry(mapi_nameid, entry);
 }
 
 
@@ -147,45 +242,19 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_add(struct mapi_nameid *mapi_nameid,
 _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_add(struct mapi_nameid *mapi_nameid,
 					     uint16_t lid, const char *OLEGUID)
 {
-	uint32_t		i;
-	uint16_t		count;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if ((lid == mapi_nameid_tags[i].lid) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_find_lid(lid, OLEGUID);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	return mapi_nameid_add_entry(mapi_nameid, entry);
 }
 
 
@@ -213,46 +282,19 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_add(struct mapi_nameid *mapi_nameid,
 						const char *Name,
 						const char *OLEGUID)
 {
-	uint32_t		i;
-	uint16_t		count;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity check */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(Name, mapi_nameid_tags[i].Name) &&
-		    !strcmp(OLEGUID, mapi_nameid_tags[i].OLEGUID)) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							    mapi_nameid->entries, struct mapi_nameid_tags,
-							    mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_find_Name(Name, OLEGUID);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	return mapi_nameid_add_entry(mapi_nameid, entry);
 }
 
 /**
@@ -380,43 +422,18 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_custom_string_add(struct mapi_nameid *mapi_
 _PUBLIC_ enum MAPISTATUS mapi_nameid_canonical_add(struct mapi_nameid *mapi_nameid,
 						   uint32_t proptag)
 {
-	uint32_t	i;
-	uint16_t	count;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!mapi_nameid, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!proptag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].proptag == proptag) {
-			mapi_nameid->nameid = talloc_realloc(mapi_nameid,
-							     mapi_nameid->nameid, struct MAPINAMEID,
-							     mapi_nameid->count + 1);
-			mapi_nameid->entries = talloc_realloc(mapi_nameid,
-							      mapi_nameid->entries, struct mapi_nameid_tags,
-							      mapi_nameid->count + 1);
-			count = mapi_nameid->count;
-
-			mapi_nameid->entries[count] = mapi_nameid_tags[i];
-
-			mapi_nameid->nameid[count].ulKind = (enum ulKind) mapi_nameid_tags[i].ulKind;
-			GUID_from_string(mapi_nameid_tags[i].OLEGUID,
-					 &(mapi_nameid->nameid[count].lpguid));
-			switch (mapi_nameid_tags[i].ulKind) {
-			case MNID_ID:
-				mapi_nameid->nameid[count].kind.lid = mapi_nameid_tags[i].lid;
-				break;
-			case MNID_STRING:
-				mapi_nameid->nameid[count].kind.lpwstr.Name = mapi_nameid_tags[i].Name;
-				mapi_nameid->nameid[count].kind.lpwstr.NameSize = get_utf8_utf16_conv_length(mapi_nameid_tags[i].Name);
-				break;
-			}
-			mapi_nameid->count++;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_find_tag(proptag);
+	if (!entry) {
+		return MAPI_E_NOT_FOUND;
 	}
 
-	return MAPI_E_NOT_FOUND;
+	return mapi_nameid_add_entry(mapi_nameid, entry);
 }
 
 
@@ -430,12 +447,8 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_canonical_add(struct mapi_nameid *mapi_name
  */
 _PUBLIC_ enum MAPISTATUS mapi_nameid_property_lookup(uint32_t proptag)
 {
-	uint32_t	i;
-
-	for (i = 0; mapi_nameid_tags[i].proptag; i++) {
-		if (mapi_nameid_tags[i].proptag == proptag) {
-			return MAPI_E_SUCCESS;
-		}
+	if (proptag && mapi_nameid_find_tag(proptag)) {
+		return MAPI_E_SUCCESS;
 	}
 
 	return MAPI_E_NOT_FOUND;
@@ -460,19 +473,16 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_property_lookup(uint32_t proptag)
 _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_lookup(const char *OOM, const char *OLEGUID,
 						uint16_t *propType)
 {
-	uint32_t	i;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!OOM, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].OOM &&
-		    !strcmp(mapi_nameid_tags[i].OOM, OOM) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_find_OOM(OOM, OLEGUID);
+	if (entry) {
+		*propType = entry->propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -497,18 +507,16 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_OOM_lookup(const char *OOM, const char *OLE
 _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup(uint16_t lid, const char *OLEGUID,
 						uint16_t *propType)
 {
-	uint32_t	i;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].lid == lid &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_find_lid(lid, OLEGUID);
+	if (entry) {
+		*propType = entry->propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -533,19 +541,17 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup(uint16_t lid, const char *OLEGUI
 _PUBLIC_ enum MAPISTATUS mapi_nameid_lid_lookup_canonical(uint16_t lid, const char *OLEGUID,
 							  uint32_t *propTag)
 {
-	uint32_t	i;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!lid, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!propTag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].lid == lid &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propTag = mapi_nameid_tags[i].proptag;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_find_lid(lid, OLEGUID);
+	if (entry) {
+		*propTag = entry->proptag;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -571,19 +577,16 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_lookup(const char *Name,
 						   const char *OLEGUID,
 						   uint16_t *propType)
 {
-	uint32_t	i;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(mapi_nameid_tags[i].Name, Name) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propType = mapi_nameid_tags[i].propType;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_find_Name(Name, OLEGUID);
+	if (entry) {
+		*propType = entry->propType;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -609,20 +612,17 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_string_lookup_canonical(const char *Name,
 							     const char *OLEGUID,
 							     uint32_t *propTag)
 {
-	uint32_t	i;
+	const struct mapi_nameid_tags	*entry;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!Name, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!OLEGUID, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!propTag, MAPI_E_INVALID_PARAMETER, NULL);
 
-	for (i = 0; mapi_nameid_tags[i].OLEGUID; i++) {
-		if (mapi_nameid_tags[i].Name &&
-		    !strcmp(mapi_nameid_tags[i].Name, Name) &&
-		    !strcmp(mapi_nameid_tags[i].OLEGUID, OLEGUID)) {
-			*propTag = mapi_nameid_tags[i].proptag;
-			return MAPI_E_SUCCESS;
-		}
+	entry = mapi_nameid_find_Name(Name, OLEGUID);
+	if (entry) {
+		*propTag = entry->proptag;
+		return MAPI_E_SUCCESS;
 	}
 
 	OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, NULL);
@@ -968,20 +968,19 @@ _PUBLIC_ enum MAPISTATUS mapi_nameid_GetIDsFromNames(struct mapi_nameid *mapi_na
 
 _PUBLIC_ const char *get_namedid_name(uint32_t proptag)
 {
-	uint32_t idx;
+	const struct mapi_nameid_names	*entry;
 
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (mapi_nameid_names[idx].proptag == proptag) {
-			return mapi_nameid_names[idx].propname;
-		}
+	if (!proptag) return NULL;
+
+	entry = mapi_nameid_names_find_tag(proptag);
+	if (entry) {
+		return entry->propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
-		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (mapi_nameid_names[idx].proptag == proptag) {
-			return mapi_nameid_names[idx].propname;
+		entry = mapi_nameid_names_find_tag(proptag + 1); /* try as _UNICODE variant */
+		if (entry) {
+			return entry->propname;
 		}
 	}
 	return NULL;
@@ -989,15 +988,13 @@ _PUBLIC_ const char *get_namedid_name(uint32_t proptag)
 
 _PUBLIC_ uint32_t get_namedid_value(const char *propname)
 {
-	uint32_t idx;
+	const struct mapi_nameid_names	*entry;
 
-	for (idx = 0; mapi_nameid_names[idx].proptag; idx++) {
-		if (!strcmp(mapi_nameid_names[idx].propname, propname)) {
-			return mapi_nameid_names[idx].proptag;
-		}
-	}
+	if (!propname) return 0;
 
-	return 0;
+	entry = mapi_nameid_names_find_name(propname);
+
+	return entry ? entry->proptag : 0;
 }
 
 _PUBLIC_ uint16_t get_namedid_type(uint16_t untypedtag)
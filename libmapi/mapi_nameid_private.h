@@ -1002,4 +1002,450 @@ static struct mapi_nameid_names mapi_nameid_names[] = {
 
 };
 
+#define MAPI_NAMEID_TAGS_TAG_SIZE 495
+
+static const int16_t mapi_nameid_tags_tag_displace[MAPI_NAMEID_TAGS_TAG_SIZE] = {
+	0, -1, 3, -5, -6, 4, 0, 3, 0, -10, 0, 0,
+	0, -12, 0, -14, 0, 2, -15, 1, 1, -18, 0, 2,
+	-19, -20, -21, 2, -27, 0, -29, -30, 1, 3, 0, 0,
+	-31, -33, -34, 0, 0, -36, 0, -39, 3, 0, 0, -40,
+	2, 0, 0, 3, -45, 1, -46, -50, 1, 1, 0, -55,
+	0, 0, -57, 1, 0, 0, 0, 0, -60, 2, 1, 1,
+	0, -61, -64, 0, 2, 0, -69, 3, 0, 0, 0, 8,
+	-71, 0, -84, -85, -87, 1, -88, 0, 0, 1, -90, -93,
+	-96, -101, -102, 0, 1, 1, 0, -103, 1, 2, 0, 5,
+	0, 1, 0, 0, 3, 0, 3, -106, 0, 0, 0, -107,
+	-109, 0, 4, -112, 0, 0, 2, 0, -115, 0, 1, 1,
+	-118, 0, 0, -119, 0, 1, 3, -120, 0, 1, 0, 0,
+	-121, -124, 4, -127, -132, 0, 1, -138, 0, -144, -145, 1,
+	-146, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0,
+	0, 1, -156, -158, 2, -159, -160, -162, 1, -163, 0, -166,
+	0, 0, -169, 0, 0, -170, 1, 2, 2, 0, 0, 1,
+	1, 1, -171, -174, 4, 0, -177, 1, 0, 4, 10, 5,
+	0, 0, -179, 0, 3, -180, -181, 1, 3, 2, 0, 2,
+	0, -182, 0, 0, 7, 1, 0, 1, -184, 0, 0, 0,
+	3, -192, 4, 0, 1, 2, 0, -193, 0, -204, 0, 0,
+	13, 4, 0, -209, 0, 0, 0, 7, -210, 1, 0, -212,
+	1, 0, 0, 0, 5, -215, 3, 0, -219, -220, 3, 0,
+	0, -221, 0, -224, 1, -226, 3, -228, 2, 2, -233, -234,
+	-235, 0, -236, -239, -243, 0, 0, 0, -245, -246, 13, 1,
+	6, 11, 0, -250, -252, 0, -261, 0, 0, -264, -266, 0,
+	1, 0, 2, 2, 4, 0, 0, 0, -270, 1, 0, 0,
+	-271, 0, 1, -275, -280, 0, 3, 0, -283, 3, 1, 8,
+	-286, 2, -287, 0, 3, -293, 11, 0, 0, 0, -294, -295,
+	0, -304, 0, -307, -315, -317, 3, -319, -320, 0, 12, 0,
+	1, -324, 0, -333, -334, -343, 0, 0, 0, 0, -344, -347,
+	2, 0, 2, -351, 0, -356, 0, 14, 0, 0, -364, -367,
+	0, 0, 17, 0, 0, -368, 0, -372, 0, -373, -376, -378,
+	-391, 0, -392, -395, 0, 0, 0, -396, -397, 0, -400, -401,
+	16, 0, -405, 1, 0, 0, 2, -407, -410, 0, 0, 0,
+	0, -417, -418, 0, 1, -419, -423, 0, 0, 0, -424, 11,
+	-426, 9, 0, 0, -427, -428, -431, 5, -432, -438, 0, 0,
+	0, 2, 0, 0, 1, 0, 1, 0, 0, 0, -439, -442,
+	0, 0, 1, 1, 0, -444, -445, 7, 2, 0, -447, 1,
+	0, 8, -451, 0, 1, 4, 2, 0, 8, -454, -460, -471,
+	0, 1, -474, -477, -478, 3, -479, -481, 0, 0, 0, 2,
+	-482, 0, 0, 0, -484, 0, 2, 0, -486, -492, 0, 1,
+	7, -495, 2,
+};
+
+static const uint16_t mapi_nameid_tags_tag_slots[MAPI_NAMEID_TAGS_TAG_SIZE] = {
+	259, 279, 128, 353, 7, 41, 199, 473, 367, 291, 13, 171,
+	160, 283, 168, 337, 474, 281, 263, 480, 91, 365, 35, 43,
+	50, 135, 175, 355, 248, 138, 397, 275, 90, 277, 115, 233,
+	203, 28, 98, 32, 378, 443, 251, 347, 247, 82, 67, 253,
+	246, 152, 158, 224, 142, 341, 210, 37, 144, 222, 298, 379,
+	196, 475, 245, 134, 237, 30, 408, 459, 114, 312, 33, 207,
+	412, 352, 141, 327, 478, 269, 257, 393, 182, 151, 303, 429,
+	446, 94, 262, 167, 74, 161, 362, 349, 470, 243, 194, 206,
+	492, 417, 113, 345, 24, 366, 440, 44, 188, 87, 487, 304,
+	323, 176, 319, 444, 411, 54, 221, 5, 469, 4, 49, 244,
+	92, 422, 285, 375, 59, 315, 184, 389, 364, 398, 3, 295,
+	358, 318, 448, 79, 16, 301, 164, 81, 68, 406, 110, 198,
+	104, 48, 78, 185, 226, 240, 25, 103, 270, 254, 165, 360,
+	0, 369, 287, 453, 60, 294, 239, 95, 217, 174, 143, 288,
+	107, 231, 431, 2, 424, 388, 252, 145, 55, 148, 132, 195,
+	234, 162, 10, 442, 427, 306, 66, 19, 359, 460, 356, 163,
+	363, 414, 273, 452, 85, 438, 153, 112, 477, 86, 88, 380,
+	486, 65, 385, 228, 180, 297, 481, 73, 384, 96, 451, 8,
+	436, 293, 332, 11, 267, 340, 36, 126, 284, 193, 334, 93,
+	330, 329, 14, 204, 401, 213, 464, 186, 461, 166, 89, 350,
+	420, 463, 404, 155, 99, 368, 235, 215, 316, 338, 173, 449,
+	309, 382, 370, 220, 439, 308, 209, 428, 402, 488, 123, 425,
+	242, 238, 434, 361, 343, 328, 326, 197, 38, 371, 120, 419,
+	456, 320, 249, 223, 131, 202, 409, 268, 192, 454, 437, 191,
+	121, 433, 314, 310, 177, 232, 211, 292, 236, 467, 447, 274,
+	416, 51, 381, 471, 140, 342, 426, 100, 133, 56, 241, 374,
+	83, 286, 278, 61, 84, 137, 40, 391, 170, 218, 491, 325,
+	219, 62, 154, 149, 472, 201, 432, 109, 230, 410, 27, 354,
+	80, 336, 462, 300, 72, 97, 484, 181, 313, 272, 255, 178,
+	17, 482, 455, 396, 418, 6, 296, 34, 299, 22, 139, 136,
+	276, 307, 225, 70, 339, 489, 322, 76, 179, 119, 457, 125,
+	71, 494, 118, 450, 321, 205, 280, 258, 216, 122, 266, 372,
+	413, 357, 124, 405, 483, 183, 129, 150, 435, 441, 9, 26,
+	111, 105, 130, 256, 116, 146, 1, 324, 430, 261, 75, 423,
+	403, 479, 45, 31, 77, 394, 157, 29, 346, 392, 400, 387,
+	106, 415, 317, 58, 227, 169, 260, 20, 407, 476, 390, 23,
+	12, 490, 485, 386, 47, 465, 156, 376, 335, 200, 172, 250,
+	15, 302, 39, 311, 344, 57, 395, 468, 377, 147, 63, 348,
+	189, 383, 466, 229, 331, 102, 46, 212, 373, 289, 290, 214,
+	399, 271, 208, 52, 159, 493, 445, 18, 69, 421, 42, 264,
+	282, 64, 265, 21, 53, 458, 108, 190, 187, 305, 117, 127,
+	101, 351, 333,
+};
+
+#define MAPI_NAMEID_TAGS_LID_SIZE 371
+
+static const int16_t mapi_nameid_tags_lid_displace[MAPI_NAMEID_TAGS_LID_SIZE] = {
+	-3, -4, 0, -5, 1, 1, -7, -12, 0, -19, 0, 1,
+	0, 0, 0, -21, 0, 1, 0, 1, -24, 0, 0, 0,
+	0, 0, 0, -31, 0, -33, -36, -40, 3, -42, 0, -43,
+	0, -52, 0, 0, -55, 3, 0, 0, -59, -62, 0, 0,
+	0, 0, -67, 0, 0, 0, 1, 0, 1, -72, 0, 0,
+	0, 3, -77, -81, 0, -85, 1, -90, -91, -96, 4, 3,
+	5, -99, 0, 0, -101, -107, 1, 0, 2, 0, -108, -109,
+	1, 1, 0, -112, -125, 0, -129, 0, -130, 1, 0, 0,
+	0, -133, 1, 0, 0, 0, 0, 5, 0, 1, 4, 8,
+	0, -136, 4, -137, 0, -142, -145, -146, -151, 4, 0, 1,
+	4, 1, 2, 0, 0, 0, -153, 0, -157, -160, -166, -169,
+	0, -171, -173, 1, 1, 17, 1, 0, 0, 3, 0, -174,
+	-185, 1, 1, 1, -186, 0, -188, 0, 2, 0, -189, 0,
+	-199, 0, -202, 1, 0, 0, 0, 1, -203, 1, -204, -205,
+	-206, 0, 1, -207, 3, 0, 0, -211, -213, -214, -217, 0,
+	0, 2, 0, -219, 4, 1, 0, 0, 0, 0, -221, -225,
+	-226, 3, -229, 3, -234, 12, 4, 2, 1, 0, -236, 0,
+	0, 0, 0, -237, 0, 1, -241, -243, 0, 0, 3, 0,
+	18, 4, 5, 1, 1, 1, 1, 0, 0, 0, 1, 0,
+	2, -244, 0, 0, -245, 0, 0, 0, 0, 1, -251, 0,
+	0, -254, -255, -256, 0, -257, 0, 0, -258, 0, -262, 0,
+	0, 0, 1, 0, -267, 0, -270, -271, -273, 0, -274, -275,
+	0, 0, 7, 0, 0, -283, 1, -290, 8, -293, 0, 0,
+	0, 4, -299, 1, -306, 7, 1, 0, 1, 1, 0, -308,
+	1, 20, 1, 0, -309, 0, -315, 1, 3, 1, -322, 1,
+	0, 0, -323, 0, 0, 15, 0, -326, 1, 0, -328, 9,
+	0, 0, 0, -329, 0, -331, 4, 0, -335, -338, 0, 2,
+	1, -339, -340, -342, -343, 0, 0, 0, 4, -345, 0, 4,
+	-346, -347, 0, -350, 0, 0, 2, 1, -351, 1, -354, 0,
+	0, 0, 1, 1, 0, 4, 0, 0, 10, 0, 0, -361,
+	0, 16, -362, -364, 0, -370, 1, 5, 1, -371, 0,
+};
+
+static const uint16_t mapi_nameid_tags_lid_slots[MAPI_NAMEID_TAGS_LID_SIZE] = {
+	331, 18, 337, 336, 20, 181, 138, 330, 187, 161, 46, 185,
+	279, 272, 314, 5, 262, 191, 228, 146, 114, 293, 35, 277,
+	340, 99, 85, 328, 102, 42, 339, 364, 250, 90, 186, 264,
+	494, 245, 322, 220, 163, 132, 127, 294, 72, 59, 137, 271,
+	288, 240, 70, 124, 39, 98, 243, 80, 312, 200, 92, 283,
+	219, 159, 31, 203, 24, 212, 365, 182, 232, 165, 351, 54,
+	60, 118, 84, 175, 140, 107, 116, 215, 316, 125, 194, 300,
+	148, 3, 172, 346, 178, 121, 174, 110, 117, 267, 40, 273,
+	32, 74, 19, 363, 342, 95, 105, 214, 122, 152, 299, 344,
+	145, 67, 22, 33, 241, 37, 6, 79, 197, 160, 325, 157,
+	236, 226, 284, 166, 343, 213, 341, 227, 289, 231, 349, 16,
+	76, 150, 128, 292, 274, 192, 225, 66, 234, 126, 255, 208,
+	112, 164, 89, 189, 190, 361, 257, 53, 376, 2, 338, 205,
+	280, 320, 253, 162, 290, 216, 47, 106, 315, 308, 303, 265,
+	123, 133, 317, 362, 143, 251, 355, 36, 326, 56, 302, 193,
+	286, 275, 209, 204, 353, 313, 93, 306, 52, 142, 149, 246,
+	29, 350, 129, 358, 43, 73, 156, 254, 10, 305, 230, 136,
+	224, 233, 167, 104, 345, 57, 154, 260, 69, 13, 88, 211,
+	285, 334, 319, 327, 201, 210, 238, 111, 183, 8, 287, 81,
+	1, 196, 256, 82, 249, 51, 94, 49, 141, 130, 335, 247,
+	354, 158, 173, 235, 170, 139, 244, 97, 75, 9, 0, 332,
+	153, 359, 333, 26, 38, 23, 307, 151, 180, 34, 298, 168,
+	223, 155, 278, 357, 229, 169, 109, 71, 176, 301, 103, 17,
+	48, 101, 356, 195, 217, 296, 30, 248, 352, 258, 65, 304,
+	282, 64, 11, 27, 144, 207, 222, 21, 347, 177, 113, 360,
+	239, 206, 87, 45, 78, 221, 348, 86, 147, 318, 96, 44,
+	310, 329, 323, 171, 15, 405, 188, 281, 61, 295, 218, 179,
+	237, 297, 108, 269, 263, 184, 199, 198, 115, 58, 242, 100,
+	261, 14, 252, 62, 120, 41, 25, 83, 324, 134, 309, 367,
+	28, 63, 259, 55, 266, 291, 91, 12, 369, 50, 119, 268,
+	321, 4, 131, 202, 135, 270, 311, 68, 276, 77, 7,
+};
+
+#define MAPI_NAMEID_TAGS_OOM_SIZE 362
+
+static const int16_t mapi_nameid_tags_OOM_displace[MAPI_NAMEID_TAGS_OOM_SIZE] = {
+	0, 0, 0, 1, -1, 1, 0, 0, 1, -2, 1, 1,
+	-4, 0, -5, 1, 0, 5, 0, -7, 0, -10, -12, -13,
+	0, -17, 0, -19, -23, -25, 1, 1, 1, 1, 1, 0,
+	-30, 1, 0, 5, -31, -33, 0, 0, -35, 1, 0, 2,
+	-37, 0, 1, 0, -38, 2, -50, 3, 1, -51, 1, 0,
+	0, -52, 1, 2, 0, -53, -55, -56, 0, 1, -60, 0,
+	0, 0, -61, 1, 2, 2, 0, 0, -62, -63, -69, 1,
+	-71, -72, 0, 0, -78, 1, -82, -84, -87, 7, 0, 0,
+	-88, -91, -92, 3, 1, 1, 0, 0, 0, -97, -98, -99,
+	0, 1, 1, 0, 0, 0, -104, -105, 0, -109, 0, 6,
+	-111, -116, -118, -119, -120, 0, 3, 1, 1, 0, -122, 2,
+	1, -123, 0, 1, 2, 0, 0, 1, 0, -127, -128, -129,
+	0, 0, -131, 0, 0, 1, 0, 1, 4, 0, -134, 2,
+	-136, 0, -137, 0, 1, -138, 0, 0, -143, 2, 3, -146,
+	0, 0, -148, 0, 0, -155, -157, 0, 1, 2, 0, 0,
+	-159, 0, 4, -160, 5, 0, -166, -169, 0, -181, -183, 4,
+	0, 11, 1, 1, 0, 0, 0, -184, 0, 0, 0, -187,
+	1, -188, 19, -190, 0, -191, 0, -196, -202, 0, 2, 0,
+	0, 0, -204, 4, -205, 0, -206, -207, 0, -221, -224, 5,
+	0, 1, 0, 1, 9, -226, 0, -227, -228, -234, -237, 0,
+	1, 1, -238, 0, 8, -241, -249, -250, -251, 0, 0, 1,
+	-252, 0, -253, -254, 1, 0, -255, -258, 2, 0, 0, 0,
+	1, -259, -260, 3, 0, -261, 0, 2, 0, 8, 1, -266,
+	2, -268, -269, -270, 1, 0, 3, 1, 2, -274, 0, -275,
+	-276, 0, 1, -282, -294, 4, -297, -299, 1, -302, -303, 0,
+	4, -305, 1, -308, 0, 0, -311, 0, 4, -312, 0, -314,
+	-315, -322, 0, -323, -330, 0, -332, -333, -335, -336, 1, 0,
+	0, 4, 0, 0, 0, 0, -339, 0, -340, 9, -342, 0,
+	1, 0, -343, 0, 0, -346, 1, 0, 0, 3, -351, -352,
+	6, -353, 0, -354, -355, 0, 0, 8, -359, 0, 0, -360,
+	28, 0,
+};
+
+static const uint16_t mapi_nameid_tags_OOM_slots[MAPI_NAMEID_TAGS_OOM_SIZE] = {
+	354, 190, 305, 284, 319, 295, 328, 311, 292, 318, 50, 201,
+	317, 314, 178, 238, 37, 82, 121, 171, 181, 111, 105, 11,
+	114, 188, 132, 107, 263, 217, 176, 272, 16, 322, 144, 70,
+	360, 56, 47, 210, 308, 158, 17, 299, 362, 41, 247, 334,
+	134, 356, 46, 20, 218, 4, 100, 306, 108, 103, 351, 249,
+	204, 209, 269, 229, 62, 6, 197, 350, 157, 51, 2, 38,
+	348, 191, 243, 48, 262, 106, 260, 257, 148, 312, 133, 296,
+	307, 289, 271, 97, 43, 344, 1, 23, 128, 65, 332, 152,
+	24, 94, 297, 31, 55, 69, 300, 45, 264, 165, 278, 279,
+	28, 78, 166, 88, 30, 44, 323, 141, 167, 159, 75, 282,
+	126, 199, 131, 275, 170, 8, 337, 235, 149, 93, 194, 49,
+	54, 214, 156, 230, 200, 182, 252, 225, 251, 160, 163, 338,
+	172, 59, 341, 68, 363, 25, 119, 246, 268, 89, 234, 80,
+	130, 301, 124, 313, 242, 73, 494, 138, 309, 211, 302, 265,
+	52, 173, 85, 286, 180, 273, 92, 231, 67, 186, 339, 13,
+	184, 331, 150, 208, 254, 241, 143, 83, 12, 239, 315, 196,
+	117, 112, 64, 95, 104, 81, 346, 53, 333, 267, 71, 320,
+	142, 237, 298, 291, 15, 155, 118, 342, 113, 248, 203, 280,
+	0, 151, 340, 343, 91, 236, 79, 224, 361, 9, 21, 161,
+	26, 125, 345, 206, 261, 202, 349, 255, 294, 77, 357, 115,
+	303, 245, 168, 66, 140, 353, 74, 216, 195, 27, 175, 324,
+	123, 277, 42, 259, 329, 129, 99, 347, 61, 179, 32, 109,
+	139, 3, 207, 285, 183, 110, 153, 228, 10, 90, 36, 240,
+	76, 219, 57, 147, 232, 33, 101, 40, 330, 14, 213, 250,
+	84, 335, 137, 7, 364, 19, 135, 226, 154, 127, 327, 169,
+	227, 187, 223, 287, 205, 193, 310, 60, 220, 116, 58, 18,
+	87, 321, 352, 304, 136, 253, 358, 96, 293, 120, 276, 29,
+	355, 146, 325, 63, 221, 336, 290, 215, 72, 86, 122, 359,
+	34, 22, 192, 98, 198, 316, 270, 233, 326, 274, 281, 164,
+	102, 288, 145, 283, 162, 39, 256, 35, 244, 212, 5, 258,
+	266, 222,
+};
+
+#define MAPI_NAMEID_TAGS_NAME_SIZE 129
+
+static const int16_t mapi_nameid_tags_Name_displace[MAPI_NAMEID_TAGS_NAME_SIZE] = {
+	-1, 1, 1, -3, 0, 2, 3, -4, 2, 0, 1, 0,
+	-6, 0, 1, -10, 1, -11, 0, 1, -17, 0, -18, 1,
+	0, -24, 0, -35, -36, 2, -37, 1, 0, -42, 0, -45,
+	1, -47, -51, 0, -52, 0, -55, 0, 3, -58, 3, -59,
+	0, 1, -64, 0, 0, -65, 1, -68, 0, 1, 0, 1,
+	2, -70, 4, 5, 0, 0, -71, -72, 1, 9, 0, 0,
+	0, -74, 0, -75, 0, 0, 0, 1, -79, -81, -84, -88,
+	0, 0, -93, 3, 0, 0, 0, 11, -96, 0, -98, -102,
+	0, -103, -104, -106, -112, 1, -114, 0, 0, -116, -118, 0,
+	0, 0, 0, -119, 1, 0, 9, 0, 8, 0, -120, 2,
+	6, -121, -122, 1, 1, -128, 0, 0, -129,
+};
+
+static const uint16_t mapi_nameid_tags_Name_slots[MAPI_NAMEID_TAGS_NAME_SIZE] = {
+	369, 458, 446, 481, 366, 492, 435, 379, 407, 478, 395, 438,
+	375, 401, 371, 374, 434, 377, 416, 404, 397, 490, 461, 454,
+	466, 470, 367, 392, 378, 456, 451, 399, 417, 370, 442, 406,
+	437, 450, 396, 373, 426, 429, 479, 393, 372, 463, 464, 439,
+	398, 474, 449, 388, 411, 422, 365, 440, 394, 420, 475, 443,
+	436, 414, 476, 432, 493, 491, 460, 409, 467, 488, 471, 462,
+	465, 455, 408, 403, 445, 413, 419, 384, 380, 447, 431, 423,
+	391, 473, 386, 368, 387, 433, 469, 428, 485, 489, 389, 457,
+	421, 480, 482, 486, 425, 472, 424, 382, 383, 412, 444, 468,
+	483, 427, 418, 402, 415, 477, 453, 430, 441, 405, 448, 385,
+	484, 452, 410, 400, 487, 459, 381, 390, 376,
+};
+
+#define MAPI_NAMEID_NAMES_NAME_SIZE 494
+
+static const int16_t mapi_nameid_names_name_displace[MAPI_NAMEID_NAMES_NAME_SIZE] = {
+	0, -1, 0, 0, 3, 3, 0, 0, 0, 0, -2, 0,
+	1, 0, -3, 0, -5, 2, -9, -12, -13, -14, 0, -17,
+	0, 1, -23, 0, 3, 0, 1, 0, -26, 0, 0, 0,
+	-28, 0, -29, -30, -31, 0, -34, -35, 3, 3, 0, -39,
+	-40, 0, 2, 0, 0, -50, 0, -52, -53, -54, 0, 1,
+	-56, 1, 0, -59, -64, 0, -65, 1, -66, 0, 1, 2,
+	1, 4, 0, 1, 1, -68, 0, -70, 1, 1, -71, 0,
+	0, -73, -74, 1, -75, 5, 1, 1, 0, 0, 1, -77,
+	0, 1, 7, 1, 2, 0, -86, 1, 0, -93, 2, -94,
+	0, 0, -97, 0, 0, 2, -99, 0, 0, 0, 0, 2,
+	-101, -103, 2, -106, 0, -108, 6, 2, 0, 0, -114, 0,
+	0, -117, -119, -121, 0, -123, -124, 0, 0, 0, -127, -130,
+	0, 1, 0, 0, -131, 0, 0, -134, 0, 0, 2, 6,
+	0, -137, 0, -140, 0, -141, -142, 1, -143, -144, 7, 2,
+	0, -145, 0, -146, 0, -147, -148, -149, 0, -151, 1, 2,
+	0, -152, 0, -153, -154, -157, 0, -160, 0, 5, -162, 0,
+	1, -164, 0, 0, -165, -169, -170, 0, 0, 0, 1, 0,
+	0, -171, 0, 0, -174, -186, 1, 0, 1, -188, 0, -189,
+	-197, -205, -207, -210, -213, -215, 0, -221, -225, 0, 3, -230,
+	5, -231, 0, -232, -234, -237, 0, 0, -239, 1, 9, -242,
+	-246, -250, 2, -252, -254, 1, 0, -262, 0, 1, 1, -264,
+	-266, -274, 0, 0, 2, 0, 1, 0, 0, -275, 0, 0,
+	-276, 4, 0, 0, 0, -278, 0, -281, -284, 0, 5, 0,
+	0, 1, 3, -285, 1, 2, 0, 2, -286, 2, 0, 7,
+	10, 2, 0, 0, -287, 0, 2, -288, -291, -292, 3, -297,
+	1, -299, -301, -302, 0, -303, 7, 0, 0, 0, 1, 0,
+	-304, -305, -307, 1, 1, 0, -312, 0, 4, -313, -316, -317,
+	-318, 1, 1, 0, 0, -320, 0, 0, 18, 3, -322, 0,
+	1, 6, 0, 0, 0, 1, 0, 0, 5, 0, 0, 1,
+	-323, 5, 1, 0, 0, -324, -325, -333, -336, -340, 0, 0,
+	-343, 0, 0, 4, -350, 0, -353, 0, 4, -354, 11, 0,
+	-364, 0, -370, 0, -376, -378, 0, -379, -382, 0, 0, 0,
+	10, 2, 11, 1, 6, -384, 0, -385, 1, 1, 0, 2,
+	6, -388, 0, 0, -389, 0, -391, 2, 1, -392, 0, 0,
+	-393, -394, -400, 1, 0, -401, 0, 6, -405, -410, 0, 0,
+	0, 0, -416, 3, 3, -418, 0, 6, 0, 0, -419, -424,
+	12, 5, 0, 6, 0, 0, 0, -426, -430, 1, 2, 0,
+	6, -432, 0, -433, -435, 0, -438, 0, -442, 15, -444, 0,
+	-446, 0, -448, 0, 16, 0, 11, -451, 33, 0, 0, -453,
+	-458, 6, -461, 0, 0, 12, 0, -466, 0, -471, 2, 0,
+	2, 1, 1, -474, -475, -479, -481, -482, -486, -487, -492, 0,
+	0, 7,
+};
+
+static const uint16_t mapi_nameid_names_name_slots[MAPI_NAMEID_NAMES_NAME_SIZE] = {
+	321, 436, 273, 261, 247, 139, 56, 166, 31, 145, 381, 339,
+	286, 164, 474, 410, 409, 231, 114, 482, 59, 399, 324, 383,
+	466, 186, 140, 329, 18, 262, 91, 283, 124, 412, 46, 39,
+	53, 306, 486, 380, 362, 176, 330, 377, 363, 147, 100, 58,
+	397, 1, 90, 307, 101, 75, 447, 272, 241, 203, 25, 211,
+	405, 202, 278, 279, 347, 129, 168, 408, 353, 128, 40, 473,
+	201, 302, 7, 323, 131, 443, 437, 269, 142, 411, 33, 490,
+	233, 248, 356, 301, 464, 108, 82, 469, 224, 260, 350, 458,
+	299, 378, 221, 170, 11, 456, 30, 26, 449, 120, 434, 115,
+	424, 441, 253, 476, 385, 51, 387, 288, 325, 491, 390, 485,
+	341, 205, 415, 74, 407, 6, 226, 371, 326, 212, 463, 79,
+	435, 80, 303, 355, 289, 372, 35, 354, 200, 388, 214, 117,
+	237, 433, 84, 144, 319, 64, 232, 62, 169, 360, 450, 20,
+	17, 209, 57, 183, 44, 275, 351, 182, 150, 393, 453, 133,
+	125, 406, 218, 459, 316, 161, 220, 67, 87, 457, 156, 187,
+	38, 78, 213, 264, 225, 402, 217, 487, 126, 366, 70, 395,
+	155, 268, 37, 68, 94, 365, 291, 136, 484, 12, 184, 180,
+	105, 311, 467, 48, 234, 392, 243, 451, 230, 190, 342, 429,
+	481, 238, 448, 465, 462, 195, 236, 312, 431, 297, 314, 130,
+	271, 204, 331, 0, 492, 197, 427, 42, 382, 328, 172, 116,
+	386, 102, 418, 235, 198, 229, 414, 86, 336, 419, 282, 73,
+	112, 348, 95, 127, 36, 308, 428, 317, 239, 54, 489, 296,
+	343, 8, 60, 15, 162, 188, 446, 420, 426, 178, 259, 440,
+	379, 335, 99, 400, 327, 122, 252, 280, 148, 337, 257, 267,
+	438, 49, 345, 369, 89, 284, 32, 193, 320, 294, 398, 404,
+	270, 83, 432, 263, 373, 149, 274, 391, 349, 322, 199, 34,
+	277, 471, 196, 14, 249, 113, 160, 422, 111, 470, 346, 475,
+	442, 479, 5, 152, 10, 121, 159, 27, 480, 137, 72, 255,
+	423, 401, 244, 22, 240, 219, 472, 119, 332, 138, 468, 9,
+	157, 50, 444, 185, 254, 389, 4, 477, 245, 171, 143, 189,
+	384, 460, 151, 163, 298, 107, 47, 357, 29, 52, 403, 374,
+	295, 338, 210, 208, 222, 123, 318, 358, 285, 417, 192, 256,
+	104, 21, 300, 340, 77, 93, 96, 216, 146, 368, 71, 41,
+	179, 206, 23, 246, 359, 228, 69, 461, 81, 132, 24, 174,
+	352, 110, 61, 158, 85, 141, 304, 19, 290, 13, 173, 281,
+	394, 165, 293, 2, 439, 43, 227, 97, 454, 315, 376, 413,
+	452, 103, 313, 66, 154, 375, 488, 118, 16, 258, 153, 175,
+	45, 416, 215, 134, 3, 483, 88, 478, 305, 194, 65, 396,
+	333, 191, 292, 63, 76, 106, 98, 334, 207, 430, 455, 181,
+	250, 266, 109, 310, 135, 28, 425, 223, 493, 177, 364, 367,
+	167, 265, 344, 421, 251, 309, 55, 242, 361, 287, 445, 92,
+	276, 370,
+};
+
+#define MAPI_NAMEID_NAMES_TAG_SIZE 494
+
+static const int16_t mapi_nameid_names_tag_displace[MAPI_NAMEID_NAMES_TAG_SIZE] = {
+	0, 2, 1, -1, 1, -3, 0, 0, 1, 0, -5, 1,
+	0, -6, -7, 2, 2, 1, 1, 2, 0, 1, -8, -11,
+	-13, -15, -16, -18, 0, 0, -23, 0, -24, -27, 0, -28,
+	1, -29, 0, 0, -31, 1, 0, -32, 0, -33, -34, 0,
+	1, -35, 1, -37, 0, 3, 0, 0, -38, 1, 2, -39,
+	-41, -43, -44, -47, 0, -50, 0, -51, -53, 0, -54, -57,
+	-65, 0, 2, 3, -69, -70, 1, 0, -71, -74, -79, -80,
+	1, 0, 0, 0, 0, 1, 1, -85, 0, -86, 0, -91,
+	-94, 0, 2, 0, -97, 0, 2, -98, 5, -100, 0, 1,
+	0, -102, 3, 0, 0, -103, -105, -106, -107, -119, -123, 8,
+	0, -125, -126, 1, 0, -135, 0, -136, -139, 0, -148, -149,
+	1, 1, 0, 0, 3, -155, 7, 4, 0, -160, 0, -162,
+	1, 0, 2, -163, 0, -164, -167, -175, 0, -182, -184, -185,
+	2, 3, -190, 0, 0, 1, -193, -196, 0, 1, 1, 0,
+	6, 7, 1, 0, -202, -203, -205, 0, 1, 0, -209, 0,
+	0, -211, 0, -215, 4, -220, 0, 6, 0, -222, 0, 0,
+	0, -224, -231, 1, 0, -233, 0, 4, 0, 2, 0, 2,
+	-241, 0, 0, -246, -248, 0, 1, 3, -252, 0, -253, 0,
+	-254, -256, 1, 0, -259, -260, 0, 0, -261, 1, -263, 0,
+	0, 1, 0, 0, 0, 3, 4, -268, 0, -275, 0, -276,
+	3, -277, 0, 2, 0, -281, 1, 0, -282, -283, -284, 1,
+	3, 0, -285, 1, -291, -294, 2, -295, 1, -297, 1, -299,
+	0, 0, 0, -303, -307, 1, 0, 0, 0, -309, 0, 0,
+	6, 0, -312, -316, 0, 0, -318, 1, 0, 0, -326, 0,
+	0, 2, -328, -331, 1, -334, 0, 0, 5, 0, 1, 1,
+	0, -337, -341, 0, 6, 0, 0, 0, 2, -344, 1, -350,
+	-352, 0, 0, -357, 1, 3, 4, -360, 0, 2, 0, -362,
+	-364, 1, 0, 0, 0, -366, -370, 1, 0, -372, -373, 0,
+	0, 1, -374, 0, -376, -379, 0, 9, -382, 0, 0, -385,
+	-386, 7, 2, 0, 2, 0, -387, -389, 5, 0, -390, 0,
+	-391, 0, 0, 0, -395, 4, 0, 0, 0, -398, 6, 0,
+	2, -400, 0, -401, 0, -402, 0, 0, 0, 0, -405, 0,
+	3, -406, -407, -410, 7, -411, 0, -413, 10, 13, 0, 0,
+	-415, 5, -417, 29, 0, -423, 5, 0, 0, 5, 0, 0,
+	0, -425, 0, -427, -428, 0, -429, -434, -436, -439, 1, 0,
+	7, -441, 3, 0, 5, 1, -444, -447, 0, -450, 4, 0,
+	4, 2, -451, 0, 3, -452, -453, -457, 0, 2, -458, -460,
+	0, 0, 0, -461, 4, -462, -463, 2, 1, 4, 0, 0,
+	-465, 0, 11, -466, -467, 0, 4, 2, -469, -472, -473, 0,
+	0, 14, 1, -476, 1, -477, -481, -483, 0, 0, -488, 0,
+	0, -489, 0, 0, -490, 1, 0, 1, -492, -494, 0, 0,
+	0, 0,
+};
+
+static const uint16_t mapi_nameid_names_tag_slots[MAPI_NAMEID_NAMES_TAG_SIZE] = {
+	325, 435, 457, 98, 84, 237, 157, 407, 42, 145, 80, 382,
+	403, 173, 412, 207, 436, 227, 404, 170, 448, 449, 144, 323,
+	428, 489, 470, 361, 465, 129, 5, 384, 430, 158, 141, 194,
+	298, 483, 169, 91, 6, 176, 189, 10, 259, 178, 293, 68,
+	439, 66, 147, 163, 423, 263, 345, 326, 358, 451, 229, 296,
+	209, 399, 478, 462, 130, 112, 445, 480, 438, 119, 340, 300,
+	0, 286, 354, 92, 89, 11, 333, 67, 351, 99, 377, 492,
+	366, 258, 30, 218, 197, 251, 315, 142, 164, 85, 82, 349,
+	134, 248, 184, 390, 135, 122, 226, 215, 285, 95, 414, 200,
+	187, 322, 380, 359, 34, 117, 426, 212, 400, 389, 484, 336,
+	63, 174, 306, 225, 301, 396, 304, 94, 352, 474, 214, 330,
+	14, 320, 179, 289, 180, 471, 109, 308, 211, 255, 183, 41,
+	108, 159, 7, 132, 199, 261, 76, 136, 75, 368, 12, 271,
+	297, 443, 105, 128, 59, 246, 422, 256, 447, 288, 356, 466,
+	312, 281, 346, 252, 149, 150, 461, 401, 454, 268, 208, 232,
+	453, 123, 307, 55, 73, 198, 257, 266, 234, 482, 35, 29,
+	28, 238, 196, 357, 192, 339, 314, 446, 133, 282, 397, 317,
+	69, 235, 213, 490, 15, 160, 398, 162, 37, 460, 60, 291,
+	427, 431, 283, 70, 318, 182, 272, 2, 155, 329, 485, 486,
+	143, 4, 413, 411, 203, 206, 350, 107, 274, 452, 83, 71,
+	172, 476, 177, 32, 481, 9, 153, 362, 193, 221, 244, 311,
+	467, 264, 86, 114, 247, 188, 347, 185, 216, 54, 72, 243,
+	175, 53, 131, 479, 463, 406, 273, 102, 278, 475, 100, 418,
+	415, 410, 313, 305, 242, 355, 417, 295, 367, 373, 370, 20,
+	455, 27, 61, 337, 442, 341, 44, 23, 186, 168, 231, 101,
+	24, 327, 250, 47, 49, 31, 348, 402, 294, 385, 104, 21,
+	125, 342, 3, 267, 450, 17, 381, 228, 433, 50, 429, 165,
+	120, 364, 152, 279, 421, 321, 290, 270, 254, 161, 473, 375,
+	386, 8, 388, 43, 79, 236, 365, 491, 249, 303, 363, 284,
+	25, 64, 378, 383, 65, 148, 437, 62, 245, 379, 262, 444,
+	472, 408, 52, 253, 39, 416, 115, 265, 222, 1, 204, 90,
+	103, 372, 292, 26, 338, 387, 493, 166, 126, 419, 106, 22,
+	392, 230, 96, 331, 240, 138, 287, 127, 77, 219, 195, 137,
+	233, 343, 201, 310, 88, 371, 280, 395, 432, 56, 223, 93,
+	16, 45, 420, 324, 374, 391, 167, 48, 424, 205, 434, 140,
+	121, 353, 18, 191, 111, 113, 464, 87, 19, 110, 81, 441,
+	57, 241, 181, 393, 139, 38, 124, 477, 335, 154, 276, 190,
+	239, 309, 440, 275, 46, 334, 469, 217, 58, 13, 369, 51,
+	394, 468, 156, 260, 36, 269, 344, 409, 458, 33, 302, 487,
+	146, 328, 332, 74, 376, 118, 277, 151, 116, 405, 319, 488,
+	459, 456, 316, 299, 40, 78, 97, 171, 220, 360, 202, 224,
+	210, 425,
+};
+
 #endif /* !MAPI_NAMEID_PRIVATE_H__ */
@@ -36,9 +36,6 @@ void oc_logv(enum oc_log_level level, const char *fmt_string, va_list ap)
 	int samba_level;
 	int nwritten;
 
-	nwritten = vsnprintf(line, sizeof(line), fmt_string, ap);
-	if (nwritten < 0) return;
-
 	if (level >= 0) {
 		samba_level = level;
 	} else {
@@ -47,6 +44,12 @@ void oc_logv(enum oc_log_level level, const char *fmt_string, va_list ap)
 		samba_level = 0;
 	}
 
+	/* Do not format messages that would be discarded anyway */
+	if (!CHECK_DEBUGLVL(samba_level)) return;
+
+	nwritten = vsnprintf(line, sizeof(line), fmt_string, ap);
+	if (nwritten < 0) return;
+
 	/* Add a trailing newline if one is not already present */
 	if (line[strlen(line)-1] == '\n') {
 		DEBUG(samba_level, ("%s", line));
@@ -24,6 +24,7 @@
 #include <gen_ndr/ndr_exchange.h>
 #include <gen_ndr/ndr_property.h>
 #include <param.h>
+#include <ctype.h>
 
 /**
    \file property.c
@@ -362,6 +363,105 @@ uint32_t MAPITAGS_delete_entries(enum MAPITAGS *mapitags, uint32_t final_count,
 	return final_count;
 }
 
+/*
+  Hash functions backing the perfect hash tables emitted by
+  script/makepropslist.py. They must produce exactly the same values
+  as the phash_* helpers of the script: FNV-1a over the key bytes,
+  seeded by the table displacement and finalized with a murmur3 mix.
+*/
+
+static uint32_t mapi_phash_init(uint32_t seed)
+{
+	return 0x811c9dc5 ^ (seed * 0x9e3779b9);
+}
+
+static uint32_t mapi_phash_byte(uint32_t h, uint8_t c)
+{
+	return (h ^ c) * 0x01000193;
+}
+
+static uint32_t mapi_phash_uint32(uint32_t h, uint32_t value)
+{
+	h = mapi_phash_byte(h, value & 0xFF);
+	h = mapi_phash_byte(h, (value >> 8) & 0xFF);
+	h = mapi_phash_byte(h, (value >> 16) & 0xFF);
+	return mapi_phash_byte(h, (value >> 24) & 0xFF);
+}
+
+static uint32_t mapi_phash_final(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/**
+   \details Hash a property tag for a generated perfect hash table
+
+   \param seed the table displacement (0 for the first level)
+   \param proptag the property tag (or untyped property id) to hash
+
+   \return the hash value
+ */
+uint32_t mapi_phash_proptag(uint32_t seed, uint32_t proptag)
+{
+	return mapi_phash_final(mapi_phash_uint32(mapi_phash_init(seed), proptag));
+}
+
+/**
+   \details Hash a property name for a generated perfect hash table
+
+   \param seed the table displacement (0 for the first level)
+   \param str the NULL terminated string to hash
+
+   \return the hash value
+ */
+uint32_t mapi_phash_string(uint32_t seed, const char *str)
+{
+	uint32_t	h;
+
+	h = mapi_phash_init(seed);
+	while (*str) {
+		h = mapi_phash_byte(h, (uint8_t)*str++);
+	}
+
+	return mapi_phash_final(h);
+}
+
+/**
+   \details Hash a named property key for a generated perfect hash
+   table. Only the hexadecimal digits of the OLEGUID contribute to the
+   hash, case-folded, so the value does not depend on how the GUID
+   string is spelled.
+
+   \param seed the table displacement (0 for the first level)
+   \param lid the named property light ID, or 0 if unused
+   \param name the OOM or string name, or NULL if unused
+   \param OLEGUID the named property GUID string
+
+   \return the hash value
+ */
+uint32_t mapi_phash_nameid(uint32_t seed, uint16_t lid, const char *name, const char *OLEGUID)
+{
+	uint32_t	h;
+
+	h = mapi_phash_uint32(mapi_phash_init(seed), lid);
+	while (name && *name) {
+		h = mapi_phash_byte(h, (uint8_t)*name++);
+	}
+	for (; *OLEGUID; OLEGUID++) {
+		if (isxdigit((unsigned char)*OLEGUID)) {
+			h = mapi_phash_byte(h, (uint8_t)tolower((unsigned char)*OLEGUID));
+		}
+	}
+
+	return mapi_phash_final(h);
+}
+
 _PUBLIC_ const void *find_SPropValue_data(struct SRow *aRow, uint32_t mapitag)
 {
 	uint32_t i;
@@ -1189,22 +1189,538 @@ static struct mapi_proptags canonical_property_tags[] = {
 	{ 0,                                                                  0,            "NULL"                                                              }
 };
 
+#define CANONICAL_PROPERTY_TAGS_TAG_SIZE 1138
+
+static const int16_t canonical_property_tags_tag_displace[CANONICAL_PROPERTY_TAGS_TAG_SIZE] = {
+	0, 4, -1, 0, -2, 0, 2, 0, -3, 0, 0, 0,
+	0, 1, 0, 0, 1, 0, -5, -6, -8, 2, 0, 3,
+	0, -9, 0, 1, -12, -13, 1, 0, 0, -19, -22, -24,
+	2, 2, 1, 3, 3, -27, 1, -33, 2, -37, -42, 3,
+	1, 0, -43, -45, -46, 3, -49, 0, 0, 1, -50, -52,
+	-55, 0, 0, 0, -58, 0, 2, -61, 2, 0, 0, -62,
+	0, 2, 0, -66, 0, 4, 3, -71, 0, -72, 1, 1,
+	-73, -75, -76, -77, 0, 0, 0, 0, 0, 0, -78, -88,
+	0, -92, 1, 0, 1, 0, -96, 1, 0, -97, 1, 0,
+	0, -106, 1, -107, 0, 0, -109, 0, -110, 3, -111, 1,
+	0, 0, -122, 0, 0, -124, 7, 0, -126, -127, 0, 0,
+	3, 0, -132, 2, 0, 0, 3, -135, 0, -136, 0, 3,
+	-141, 0, 0, 2, -146, -151, 0, 0, -154, 0, -165, 0,
+	0, -167, 0, 0, -171, 0, 0, 1, -172, -176, -177, -178,
+	-179, 0, 0, 1, -181, 0, -184, 0, -194, -195, -196, 1,
+	0, -199, -201, 2, 0, -203, 1, -206, 0, 3, -210, -213,
+	-217, -222, -223, 0, 0, 0, 0, -225, -226, 2, 0, 0,
+	0, 0, 0, -227, -231, 0, 1, -232, -233, -236, 1, -237,
+	0, 0, 0, 2, 0, 0, -239, 2, -240, 0, -242, 3,
+	0, 1, -243, 1, 0, -244, 0, 0, 0, 3, 1, -247,
+	-253, -259, -260, 0, 2, -261, -265, 0, 3, 1, 2, 1,
+	5, -266, 1, 3, 2, 0, 0, 1, 1, 0, 0, 3,
+	0, 0, 0, 0, 2, 0, 1, 0, -267, -269, -270, -273,
+	-274, 2, 0, 0, 1, 0, 0, 0, -275, -276, 0, 4,
+	-278, -288, -289, 4, 0, -294, 0, 0, 2, -302, 1, -303,
+	-308, -313, 0, -314, -315, 1, -317, -319, -322, 2, -324, 0,
+	1, 0, 0, -327, -328, 3, 1, -330, 0, -331, 1, 4,
+	0, 0, 0, 1, 0, 1, -333, 0, -337, 0, -342, 1,
+	4, -346, 5, 1, 2, 1, -350, -351, 0, -353, 0, 0,
+	-356, 0, 2, 1, -357, -359, 1, -360, 0, 1, -361, 0,
+	0, 0, 0, -365, 2, -371, 0, 2, 1, -373, 0, -380,
+	8, 0, 0, -382, 0, -384, 12, 0, 1, -389, -390, -394,
+	1, 0, 0, 0, 1, -399, -402, 0, 0, -403, -404, 4,
+	0, 0, 0, 0, 5, -406, 0, 0, 1, -410, 1, 0,
+	0, -412, 0, -416, 0, 0, 0, 0, -419, -420, 1, -422,
+	0, 0, 0, -428, 0, 0, 0, 0, -431, 0, 1, 0,
+	0, 0, -434, 0, -438, -441, -442, 2, 0, -445, 0, -446,
+	1, 0, 0, -448, 1, 0, 1, 0, 0, 0, -450, 2,
+	0, -456, 3, 2, -457, -459, -462, 0, -466, 3, -470, -475,
+	-476, 1, -478, -479, 0, 0, 5, 0, -481, -482, 2, 1,
+	-484, 0, 1, 1, 0, -486, 0, 3, 1, -487, -488, 4,
+	-491, 0, -493, -497, -500, -502, 6, 0, 0, -507, 2, 0,
+	0, 0, 1, 0, 0, 0, 0, -510, -511, -512, 0, 0,
+	-514, -515, 3, -516, -517, 0, -518, 1, 0, 0, 0, -519,
+	0, -520, 2, -521, 1, 1, 0, -525, -527, 0, 2, 0,
+	-533, 0, 11, 4, 0, -534, 0, -538, 0, -539, 6, 0,
+	2, 7, -540, 10, 0, -543, -545, 4, 1, -547, -549, 0,
+	-551, -558, -561, 9, -566, -568, 2, 0, 1, -569, 0, 0,
+	0, 4, 0, 10, 0, 0, 0, 2, -570, -571, 2, 0,
+	4, 0, -573, 1, 0, 6, 1, 0, 0, 0, 0, -575,
+	0, -583, 1, -588, 0, -589, 6, 3, 7, 0, 0, -591,
+	7, -593, 1, -594, -595, -599, 4, 0, 0, 4, -602, -604,
+	0, -605, 0, 0, 0, -609, 0, 1, 0, -610, 0, 0,
+	-612, -616, 0, 1, 0, -621, 3, 0, 5, -622, 0, -627,
+	0, 0, 0, -630, 0, 12, -631, -634, 2, 0, 5, 8,
+	-638, 1, -640, -641, -643, 0, 0, 4, -652, 1, 0, 0,
+	2, 1, 2, 0, 0, 0, -655, 1, 0, -658, -661, -662,
+	0, 6, 0, -663, 0, -673, -676, -677, 2, 0, 0, 3,
+	-681, 0, 0, 0, -682, -685, 0, 1, -689, 0, 0, 14,
+	1, 0, -695, 1, 0, 0, -698, -703, -708, 2, -710, 0,
+	0, -717, -721, 1, 0, 0, -722, 2, -732, -735, -736, -740,
+	0, 3, 13, -742, 8, -743, 0, 0, 0, 0, 0, 7,
+	0, 0, 0, -750, -756, -758, 0, 0, -760, 1, 1, -761,
+	-762, 2, -763, 0, 1, -772, 0, 2, -775, 0, 3, 0,
+	5, -785, -786, -790, -791, 4, 0, 0, -794, -796, 1, -799,
+	-801, 0, -811, 0, 0, 2, 5, 4, -813, 5, -815, 5,
+	0, -816, -817, 0, 0, -822, 1, 4, 0, -823, -825, 0,
+	-826, 1, 1, 8, 2, 0, 1, 1, -828, 0, -830, 0,
+	0, -833, 2, 5, 2, 0, 0, 0, 0, -834, -835, 0,
+	3, -846, 0, 0, 0, 5, 1, 0, 0, -849, -850, 14,
+	-851, 0, 0, 0, 4, 0, 1, 0, -854, -855, 1, -857,
+	0, 5, -859, 0, -860, 5, 1, 0, -863, -865, 0, -871,
+	0, 0, 5, 0, -873, 19, 0, 2, -874, -879, 0, -882,
+	-883, 0, 1, 2, -885, -889, 4, 0, 0, 4, -890, 0,
+	-891, 0, 0, 0, -900, 4, 2, -902, 3, 0, 2, 1,
+	1, 3, 0, -905, 0, 0, -906, 0, 5, -907, -910, 0,
+	25, -912, 0, 3, 4, 10, 3, 0, 0, -913, 0, 0,
+	2, 4, -916, -920, 19, 10, -922, 0, 4, -928, 1, -929,
+	3, -931, 1, 3, -932, 1, -935, -936, 0, 0, -937, -940,
+	0, -944, -947, 6, -948, -950, -952, 0, 0, 0, -959, -960,
+	-963, -964, 0, 8, 9, -967, 0, -971, 0, 6, 1, 0,
+	0, 2, 0, -974, -975, 0, 0, -976, 8, 11, 1, 2,
+	0, -977, -980, -982, 2, -983, 5, 0, 9, 0, 4, 0,
+	-987, -988, 0, -990, 0, 0, -994, 0, -999, -1002, 0, 0,
+	0, 0, -1007, -1009, -1010, 9, -1015, -1016, 0, -1017, 0, 0,
+	7, 0, 0, 0, -1018, -1022, 8, 12, 0, 0, 0, 0,
+	0, 1, -1027, 4, -1028, 31, -1032, 0, -1033, -1041, 0, -1045,
+	-1046, 0, 0, 0, 1, 0, 0, -1047, 0, -1052, 0, -1054,
+	-1058, 0, 0, 2, 4, 0, -1060, 0, 12, 0, 0, -1063,
+	-1064, 0, 0, -1068, 0, 0, -1072, -1075, 0, 5, 3, 1,
+	0, -1076, -1077, 1, -1078, 0, -1079, 10, 0, 0, -1085, 0,
+	0, 4, -1086, -1087, -1089, -1091, 0, 3, 0, -1092, 7, 0,
+	17, 1, 0, 0, 2, -1093, 0, -1097, -1098, 13, 2, 0,
+	0, -1102, -1103, 9, 0, -1107, 4, 0, 0, -1117, -1119, -1122,
+	-1134, -1136, 1, 0, 0, -1137, -1138, 0, 0, 3,
+};
+
+static const uint16_t canonical_property_tags_tag_slots[CANONICAL_PROPERTY_TAGS_TAG_SIZE] = {
+	8, 872, 177, 995, 1119, 186, 440, 729, 1076, 65, 422, 806,
+	128, 15, 597, 705, 1090, 55, 1009, 373, 851, 948, 205, 895,
+	1096, 6, 125, 1146, 881, 149, 1144, 1166, 925, 1022, 201, 276,
+	1028, 1162, 861, 260, 630, 1160, 551, 1159, 720, 684, 610, 649,
+	371, 580, 884, 269, 444, 1084, 1008, 408, 1006, 450, 1131, 691,
+	1048, 1035, 407, 958, 784, 500, 678, 368, 883, 1091, 118, 28,
+	395, 350, 44, 1036, 679, 446, 35, 1069, 320, 759, 234, 200,
+	22, 945, 956, 902, 949, 629, 122, 1154, 381, 550, 398, 467,
+	357, 348, 954, 495, 821, 545, 699, 421, 1148, 601, 384, 172,
+	238, 344, 319, 97, 1097, 494, 383, 875, 743, 809, 336, 401,
+	1137, 380, 769, 838, 121, 49, 596, 74, 456, 920, 491, 1002,
+	829, 1061, 866, 1147, 879, 503, 352, 414, 569, 1039, 338, 225,
+	643, 1023, 1167, 796, 45, 364, 154, 702, 515, 779, 140, 716,
+	290, 565, 988, 982, 959, 797, 1088, 708, 723, 235, 639, 992,
+	717, 488, 143, 991, 277, 813, 1141, 438, 1099, 815, 880, 448,
+	243, 1019, 675, 360, 662, 359, 776, 1165, 498, 222, 1080, 502,
+	953, 470, 858, 1032, 165, 465, 655, 4, 835, 612, 291, 756,
+	85, 590, 411, 289, 688, 934, 654, 78, 120, 24, 773, 1127,
+	985, 586, 369, 537, 507, 127, 1037, 599, 115, 657, 146, 190,
+	1109, 3, 148, 781, 765, 250, 484, 64, 389, 873, 966, 1041,
+	588, 833, 888, 1072, 124, 266, 1068, 163, 1021, 387, 139, 837,
+	267, 182, 308, 329, 935, 778, 882, 944, 973, 492, 940, 183,
+	306, 1087, 1083, 196, 1001, 404, 170, 894, 399, 652, 785, 7,
+	600, 199, 79, 567, 211, 459, 294, 1116, 1163, 980, 832, 1145,
+	930, 300, 752, 987, 1034, 375, 116, 477, 209, 660, 56, 810,
+	280, 82, 1155, 463, 301, 642, 672, 653, 48, 434, 561, 593,
+	917, 926, 840, 957, 281, 161, 321, 693, 984, 845, 429, 1105,
+	31, 220, 563, 144, 728, 951, 102, 252, 365, 194, 1049, 155,
+	863, 435, 474, 405, 70, 508, 1045, 1050, 471, 173, 473, 447,
+	397, 339, 312, 669, 927, 609, 20, 472, 1158, 303, 622, 877,
+	1005, 787, 696, 761, 994, 892, 417, 117, 402, 650, 478, 73,
+	457, 853, 13, 224, 167, 493, 458, 560, 1121, 258, 75, 455,
+	898, 41, 737, 326, 896, 687, 50, 803, 777, 658, 363, 1055,
+	725, 137, 856, 753, 72, 1010, 218, 240, 168, 256, 1173, 489,
+	318, 506, 1074, 1094, 10, 774, 1153, 772, 801, 1064, 1051, 442,
+	430, 393, 942, 842, 476, 1033, 439, 304, 427, 377, 431, 969,
+	1058, 132, 332, 379, 1086, 783, 852, 1152, 80, 931, 786, 210,
+	509, 740, 791, 1117, 996, 392, 1052, 119, 9, 191, 998, 1011,
+	46, 636, 536, 1047, 790, 43, 34, 314, 855, 762, 562, 394,
+	413, 246, 1123, 1157, 739, 979, 334, 26, 273, 1043, 871, 480,
+	1082, 1070, 812, 103, 169, 611, 771, 1081, 885, 680, 208, 330,
+	432, 656, 749, 712, 335, 1093, 232, 726, 181, 544, 632, 23,
+	887, 644, 228, 461, 406, 296, 29, 870, 1115, 1092, 91, 367,
+	257, 5, 1100, 604, 53, 2, 378, 514, 441, 952, 798, 738,
+	1170, 42, 834, 557, 409, 830, 512, 758, 443, 261, 113, 614,
+	39, 859, 497, 713, 104, 993, 462, 626, 513, 682, 87, 577,
+	910, 347, 150, 933, 914, 1132, 1060, 606, 1112, 965, 929, 241,
+	911, 587, 683, 19, 731, 575, 937, 1129, 690, 487, 32, 1098,
+	420, 846, 919, 1134, 819, 554, 323, 187, 816, 868, 317, 485,
+	735, 700, 130, 615, 111, 986, 519, 811, 361, 483, 857, 324,
+	744, 793, 795, 623, 1016, 185, 188, 745, 764, 946, 134, 464,
+	768, 1063, 788, 722, 848, 160, 206, 255, 47, 527, 355, 595,
+	721, 525, 40, 1107, 891, 505, 270, 396, 1017, 453, 517, 305,
+	1013, 179, 805, 1111, 1025, 941, 640, 233, 1031, 223, 469, 192,
+	1042, 76, 94, 646, 123, 152, 961, 570, 876, 166, 518, 627,
+	703, 1054, 212, 1150, 711, 90, 244, 295, 686, 145, 807, 638,
+	598, 275, 676, 714, 928, 428, 748, 415, 754, 286, 585, 204,
+	981, 521, 594, 591, 932, 799, 742, 1062, 849, 701, 1133, 353,
+	214, 909, 1014, 1026, 151, 860, 1024, 804, 62, 346, 184, 825,
+	178, 390, 903, 1149, 251, 25, 101, 376, 878, 524, 254, 157,
+	605, 342, 445, 971, 382, 665, 715, 770, 901, 16, 697, 1140,
+	217, 302, 84, 298, 999, 333, 624, 763, 1020, 673, 410, 668,
+	203, 197, 939, 528, 897, 451, 106, 734, 147, 1079, 841, 531,
+	839, 247, 77, 1059, 573, 328, 424, 789, 226, 1108, 133, 823,
+	890, 175, 86, 30, 854, 61, 827, 138, 603, 538, 68, 468,
+	69, 322, 1143, 54, 664, 51, 340, 666, 607, 96, 794, 767,
+	231, 540, 316, 496, 67, 412, 81, 1012, 1095, 265, 1029, 559,
+	63, 908, 907, 239, 530, 1053, 1040, 416, 727, 274, 1075, 1125,
+	292, 523, 750, 592, 817, 213, 1118, 263, 564, 1172, 354, 131,
+	1038, 215, 641, 583, 576, 924, 193, 667, 216, 677, 918, 608,
+	552, 681, 112, 584, 634, 327, 313, 724, 356, 921, 366, 1073,
+	418, 555, 526, 947, 800, 732, 309, 516, 520, 1161, 867, 541,
+	370, 159, 195, 11, 865, 437, 824, 757, 299, 236, 808, 1156,
+	566, 71, 386, 955, 219, 27, 249, 423, 1007, 227, 692, 1139,
+	613, 129, 1046, 198, 1000, 535, 645, 230, 1164, 449, 271, 142,
+	285, 52, 828, 568, 760, 621, 694, 831, 110, 746, 242, 482,
+	325, 162, 1169, 539, 481, 174, 59, 400, 37, 741, 88, 100,
+	922, 1065, 33, 710, 534, 912, 136, 950, 943, 862, 158, 475,
+	1067, 628, 343, 822, 572, 1168, 114, 1018, 820, 625, 886, 970,
+	98, 331, 18, 997, 670, 337, 1089, 58, 547, 511, 156, 704,
+	180, 906, 938, 345, 372, 189, 1071, 755, 21, 589, 57, 1030,
+	207, 899, 635, 1, 14, 663, 362, 403, 706, 695, 659, 164,
+	556, 135, 1003, 486, 105, 548, 671, 426, 637, 990, 631, 633,
+	108, 1066, 107, 391, 278, 425, 814, 66, 780, 989, 490, 698,
+	253, 1171, 874, 685, 109, 619, 92, 893, 718, 99, 661, 479,
+	36, 264, 284, 850, 153, 543, 581, 460, 707, 983, 792, 719,
+	433, 351, 279, 95, 1151, 651, 229, 1015, 915, 1078, 689, 936,
+	1113, 385, 579, 93, 388, 836, 864, 202, 558, 126, 1101, 83,
+	532, 0, 141, 287, 259, 847, 1057, 574, 341, 542, 529, 775,
+	1077, 358, 38, 522, 272, 553, 349, 967, 923, 648, 709, 905,
+	674, 176, 268, 315, 297, 499, 546, 310, 283, 869, 913, 733,
+	245, 826, 288, 262, 12, 501, 647, 60, 1056, 17, 578, 282,
+	307, 1027, 751, 221, 747, 549, 1085, 533, 617, 248, 900, 510,
+	504, 616, 620, 374, 843, 736, 766, 889, 311, 1044, 466, 452,
+	818, 904, 730, 602, 802, 782, 293, 419, 571, 844,
+};
+
+#define CANONICAL_PROPERTY_TAGS_NAME_SIZE 1174
+
+static const int16_t canonical_property_tags_name_displace[CANONICAL_PROPERTY_TAGS_NAME_SIZE] = {
+	-7, 0, 1, 3, -9, 5, 0, 1, 0, -11, 1, 0,
+	1, -12, 0, -14, -15, -17, 3, -20, 0, 0, 1, -22,
+	-23, 0, -31, -35, 0, -36, -43, 0, -44, 0, 1, 0,
+	0, -47, 0, 0, -50, 0, 4, 0, 0, -51, -52, -53,
+	2, 0, 1, -58, 0, -62, 3, 0, 0, -63, 0, -64,
+	0, 0, -65, -67, -68, 0, 2, -71, -72, 6, 0, 0,
+	2, -77, 3, -79, 2, 0, -80, -84, 1, -87, 1, 5,
+	0, -88, 0, -89, -93, -99, 0, 2, 4, -102, 0, 1,
+	-106, -108, -109, -111, 4, -112, -113, 0, -114, -117, -119, 0,
+	0, 0, 1, -121, 2, 1, -122, 1, 1, -133, -135, -137,
+	0, 0, 0, 1, 0, 0, -139, -140, -141, 1, 0, 0,
+	-143, 0, 0, 0, -145, 0, -147, 6, 0, 0, 3, -151,
+	0, -156, 2, -157, -158, 0, -161, -163, -164, 3, 0, -168,
+	0, 0, -170, 5, 0, 0, 0, -173, 1, -176, 0, 1,
+	0, 2, 0, 1, 0, 2, 0, 1, -178, 0, 1, 1,
+	-179, -184, 1, -186, 1, 0, 2, 0, -188, 0, -189, 0,
+	0, -191, 0, 3, 2, 0, 4, -193, -195, 1, 2, -197,
+	0, -198, -205, 2, 0, -209, 0, 0, -211, 2, 1, 0,
+	-213, 0, 2, 1, 0, 0, -217, 0, 4, 0, -222, 0,
+	-223, 1, 0, 1, 0, 0, 0, 0, -228, 0, 0, -231,
+	-232, -235, -237, -238, 0, 1, 0, -241, 3, 0, 0, 0,
+	3, 0, -242, -244, 0, -245, 0, -248, 0, 6, 0, -251,
+	-252, 2, -254, 2, 0, 0, 1, 1, -257, 0, -261, -264,
+	-265, -267, 0, 1, 0, 0, -272, -274, -275, -276, -279, -282,
+	0, 0, 0, 0, -283, 0, 0, 0, 1, 3, 7, 1,
+	0, 0, -285, 0, 0, -286, 0, 1, -287, 1, 1, 0,
+	-290, -291, 0, 1, 0, 0, -293, 0, -297, -298, 1, -299,
+	0, 1, -301, -302, -309, 1, -310, -311, -312, -313, -318, 0,
+	4, 9, 0, 0, -319, 1, 0, 1, 0, 1, -320, 0,
+	0, 0, 1, -321, -322, 1, 0, -330, 5, -331, 2, 0,
+	0, 0, -332, 0, 1, 3, -333, 0, -336, -340, -342, 3,
+	-343, 0, -347, -354, -355, 2, -356, 0, 4, -358, -359, 0,
+	2, 3, 0, 1, 1, -360, 0, 2, 0, 1, 0, 0,
+	0, 2, 0, 6, 0, -361, -362, 3, 0, 0, -370, -373,
+	0, 0, 0, -375, 0, -382, -384, -386, 0, -387, -389, -390,
+	-391, -396, 2, 0, -401, -409, -410, 3, 4, -412, 0, 0,
+	1, 0, 0, 0, -418, -420, -422, -423, 1, -424, 0, -427,
+	0, 0, -429, 3, -430, 1, 0, -431, -435, -438, -440, 3,
+	3, 0, -446, 6, -447, -448, -451, 2, 2, 4, 0, 0,
+	-452, -457, 0, -460, 0, 0, 0, 3, -462, 0, 4, 0,
+	1, 4, 1, -467, 0, -468, 10, -470, -472, 0, 0, 0,
+	2, 0, -474, -475, -476, -478, 0, -480, 2, 0, 0, -482,
+	4, -484, 0, 0, 0, 1, -485, 2, 1, -486, -488, -493,
+	-494, 0, 3, -498, 0, 0, -501, -505, 0, -506, -511, -513,
+	-516, 3, -520, -521, -522, 0, -525, 0, 0, -526, -528, 0,
+	-532, 0, 0, 0, 4, 0, 4, 3, 0, 1, -536, -541,
+	-543, 0, 0, -544, 0, 1, 0, 0, -548, 2, -549, -551,
+	-553, 0, 0, 0, -554, -555, -558, 2, 1, 2, 1, -560,
+	1, 0, 0, 3, -563, -565, 1, 0, -571, -576, -577, 0,
+	-583, 2, 1, 0, -589, -590, 0, 2, 1, 2, 0, -593,
+	-595, 0, -596, 0, -597, -602, -607, 0, -608, 0, 0, -614,
+	-616, 4, -617, 2, -618, 0, 0, 0, 0, 0, -623, -626,
+	0, 4, 0, 4, -630, 0, 1, -631, 2, -633, -634, 0,
+	0, 2, 0, -638, 1, 1, 2, 0, 1, 0, 0, 1,
+	-643, 0, 4, 0, -645, 0, 0, 7, 3, 0, 0, 0,
+	-652, 0, 1, 0, 1, 1, 2, -656, 0, 0, 1, -658,
+	0, -659, 2, 0, 0, 5, 7, 7, -662, 0, 0, 9,
+	-663, 0, -668, -671, -676, -677, 1, -683, -685, 2, 4, -687,
+	0, 0, -690, 7, 0, 1, 0, 1, 1, -692, 5, 6,
+	-695, 7, 1, 0, 0, -696, -697, 2, 0, -699, 1, 2,
+	0, 1, 2, 2, 2, 2, 0, -703, 1, 0, -707, 0,
+	0, 2, 5, 0, 0, -713, -714, 2, -720, -721, -725, 2,
+	0, 2, -728, 1, -732, 1, 3, -736, 0, -737, 4, 0,
+	4, -743, 2, 0, 0, -745, 2, 0, 3, -749, 0, -750,
+	0, -751, 0, 0, -752, -754, 3, 0, 3, 0, -755, -756,
+	-758, 1, 7, -761, 1, -765, 0, 0, 2, 3, 8, 4,
+	16, 1, 0, -766, 1, -769, 2, 1, -774, 1, -776, -778,
+	-779, 0, 0, 1, 0, -780, -781, 3, 1, -787, 0, 0,
+	0, -788, 1, -789, 0, -793, 0, 0, -795, 0, -800, 0,
+	0, 0, 0, -805, 0, -807, 2, 0, -810, 3, 8, 2,
+	2, -811, 8, 0, 0, -812, 1, -816, -818, -828, -829, 0,
+	1, -830, 0, 0, -834, 3, 0, 0, 5, 0, 0, -835,
+	0, -838, -843, -846, 0, -847, -856, 0, -860, 0, 0, 0,
+	-861, -863, -866, 0, 1, -870, -874, -875, 1, 0, 0, 0,
+	0, 0, 0, -876, 0, -877, 0, -879, 0, 0, 2, 3,
+	0, -883, 0, 0, 0, -885, 1, -893, -894, -897, 0, 0,
+	-899, 0, -900, -902, 2, 1, -905, 1, -906, -908, -910, 0,
+	-913, 0, -919, 0, -924, 0, 1, 0, 0, -928, 0, 2,
+	5, 1, 0, -929, 0, -932, 0, 10, -933, 0, 0, -939,
+	-943, -948, -952, 1, 0, 0, 0, -955, 0, 1, 0, 0,
+	0, -958, 0, 0, 0, 0, 0, 17, 0, 0, -961, 9,
+	5, -962, -971, 0, 5, 0, -972, 0, -974, -978, 5, -982,
+	-985, 0, -987, 0, 0, 1, -989, 0, -991, 0, -992, 0,
+	2, 0, 0, 0, 0, -994, 6, -996, -1002, 0, 0, 0,
+	-1005, -1006, -1009, 0, 3, -1010, 2, -1014, -1015, 2, -1016, 0,
+	-1028, 3, -1029, 3, 1, -1030, 0, -1033, 1, 1, -1037, -1041,
+	17, 0, 15, -1043, 8, 0, 0, 0, 2, -1044, -1046, 8,
+	0, 0, -1048, 0, -1049, 0, 2, 0, 5, -1051, -1054, 0,
+	9, 0, 0, 0, 1, 1, -1061, -1064, 1, 0, 0, 0,
+	0, 0, 0, -1067, 1, -1068, 0, 0, -1072, 0, -1073, 1,
+	0, 0, 2, -1075, 0, 6, 1, -1080, 4, 1, -1082, -1084,
+	1, -1086, -1089, -1090, 0, 0, -1093, 0, -1095, 1, 0, 4,
+	-1096, 0, 0, 5, 0, 14, 0, -1099, 0, -1100, -1105, -1106,
+	-1108, -1112, 0, 0, -1114, 1, -1119, 5, 3, 2, 3, 0,
+	1, 14, 0, 0, -1123, 0, 4, -1125, 0, -1132, 9, 7,
+	-1133, 0, -1134, 0, -1137, 1, 5, 0, 15, 0, 1, 0,
+	-1140, 7, 0, 0, -1143, -1145, -1151, 1, 1, -1152, 0, 0,
+	-1157, -1158, 0, 8, 0, -1164, -1166, -1168, 5, -1174,
+};
+
+static const uint16_t canonical_property_tags_name_slots[CANONICAL_PROPERTY_TAGS_NAME_SIZE] = {
+	1081, 952, 426, 776, 249, 663, 1109, 385, 644, 962, 238, 455,
+	1158, 6, 313, 720, 702, 195, 1110, 968, 977, 242, 1062, 413,
+	664, 589, 1139, 91, 1126, 866, 101, 180, 1037, 497, 1061, 887,
+	391, 712, 604, 1016, 461, 226, 172, 561, 673, 364, 517, 155,
+	844, 47, 498, 1072, 77, 343, 856, 361, 757, 802, 351, 76,
+	398, 1161, 102, 1116, 609, 1073, 353, 41, 787, 1170, 281, 66,
+	1083, 901, 93, 795, 515, 470, 826, 1135, 569, 825, 786, 723,
+	308, 471, 50, 237, 900, 523, 665, 500, 791, 293, 503, 950,
+	549, 984, 269, 219, 404, 201, 891, 278, 833, 285, 1086, 208,
+	851, 607, 1070, 320, 797, 1044, 356, 204, 164, 160, 1040, 87,
+	1003, 514, 191, 850, 319, 932, 923, 718, 520, 1017, 669, 1064,
+	18, 751, 251, 292, 519, 766, 428, 1103, 725, 286, 405, 1,
+	516, 112, 334, 605, 1029, 1147, 760, 542, 709, 1087, 396, 97,
+	555, 484, 318, 274, 309, 1008, 217, 698, 859, 1068, 462, 841,
+	263, 666, 439, 136, 234, 626, 824, 634, 225, 256, 23, 785,
+	703, 951, 1012, 387, 1030, 467, 538, 443, 579, 52, 1035, 280,
+	255, 1039, 997, 409, 262, 203, 124, 127, 935, 34, 728, 463,
+	690, 206, 412, 726, 1150, 289, 486, 521, 465, 1036, 966, 1014,
+	934, 1111, 946, 1120, 19, 677, 927, 778, 360, 332, 896, 1154,
+	580, 469, 367, 316, 713, 595, 248, 26, 899, 600, 157, 205,
+	20, 734, 982, 646, 377, 231, 598, 813, 394, 530, 745, 1074,
+	907, 1019, 828, 379, 936, 1118, 949, 889, 684, 222, 879, 275,
+	911, 810, 740, 365, 307, 721, 771, 811, 287, 832, 637, 161,
+	442, 306, 906, 1125, 988, 668, 419, 733, 632, 1104, 1090, 430,
+	843, 197, 487, 28, 905, 1112, 930, 921, 1100, 1115, 735, 858,
+	358, 271, 355, 878, 148, 1031, 399, 653, 341, 1114, 135, 1049,
+	807, 192, 629, 114, 245, 12, 90, 547, 119, 236, 1051, 1157,
+	454, 806, 317, 940, 57, 15, 730, 510, 73, 352, 541, 748,
+	1171, 898, 126, 695, 794, 1117, 253, 1133, 1172, 1020, 504, 620,
+	994, 212, 846, 502, 624, 434, 910, 796, 822, 99, 839, 1159,
+	335, 575, 967, 522, 96, 998, 980, 972, 1011, 975, 149, 1098,
+	1043, 902, 1028, 103, 959, 741, 973, 659, 568, 827, 918, 492,
+	276, 1032, 92, 1042, 885, 374, 279, 689, 171, 628, 732, 1143,
+	870, 1146, 70, 834, 327, 553, 139, 617, 389, 864, 1089, 1075,
+	24, 759, 863, 710, 816, 1113, 501, 325, 110, 72, 886, 707,
+	1063, 370, 565, 928, 775, 990, 140, 438, 1137, 163, 622, 1168,
+	337, 384, 199, 291, 924, 246, 482, 473, 177, 1055, 576, 154,
+	400, 642, 173, 701, 584, 1142, 349, 80, 1144, 22, 819, 1156,
+	526, 585, 799, 288, 767, 104, 453, 48, 958, 586, 987, 1099,
+	746, 348, 422, 111, 31, 916, 85, 429, 892, 117, 51, 706,
+	282, 495, 35, 1119, 1102, 146, 578, 363, 130, 456, 295, 693,
+	964, 270, 742, 882, 895, 877, 411, 480, 1167, 815, 1045, 460,
+	323, 1002, 840, 1097, 183, 247, 401, 835, 1048, 675, 310, 582,
+	266, 499, 232, 312, 953, 402, 122, 347, 425, 1169, 1033, 314,
+	1096, 330, 627, 804, 590, 623, 302, 21, 777, 1056, 594, 0,
+	1047, 692, 566, 207, 1151, 630, 809, 433, 223, 803, 25, 346,
+	62, 631, 1080, 258, 37, 107, 635, 509, 683, 71, 56, 372,
+	214, 376, 414, 845, 1145, 481, 200, 1046, 532, 801, 1076, 599,
+	1026, 543, 65, 540, 535, 1069, 937, 403, 527, 386, 781, 770,
+	933, 121, 989, 1106, 564, 43, 431, 239, 682, 872, 603, 817,
+	793, 406, 606, 329, 613, 963, 84, 875, 321, 475, 769, 354,
+	938, 694, 491, 597, 655, 722, 596, 169, 747, 922, 534, 903,
+	539, 261, 1013, 284, 512, 608, 449, 645, 874, 774, 369, 407,
+	468, 711, 298, 780, 855, 125, 299, 1124, 152, 755, 483, 362,
+	678, 691, 68, 368, 546, 658, 821, 133, 528, 947, 447, 131,
+	533, 505, 45, 331, 397, 81, 758, 772, 993, 240, 466, 943,
+	472, 1067, 304, 227, 823, 39, 451, 685, 700, 854, 1034, 764,
+	230, 699, 983, 1093, 731, 490, 168, 229, 544, 724, 945, 185,
+	920, 593, 120, 42, 1153, 507, 441, 529, 166, 1166, 1173, 13,
+	670, 151, 714, 1121, 158, 556, 176, 808, 150, 1129, 220, 464,
+	592, 768, 738, 128, 619, 340, 390, 252, 1105, 1054, 67, 359,
+	1050, 1009, 789, 61, 393, 981, 999, 1001, 880, 336, 763, 830,
+	897, 493, 1060, 221, 1085, 1095, 357, 829, 60, 1007, 557, 708,
+	743, 842, 716, 640, 1108, 1015, 63, 904, 551, 1148, 11, 610,
+	974, 300, 410, 857, 383, 1165, 657, 427, 612, 805, 303, 415,
+	16, 537, 328, 995, 1127, 687, 1041, 213, 773, 277, 144, 162,
+	488, 14, 1132, 978, 616, 366, 17, 437, 812, 1065, 233, 32,
+	881, 82, 8, 639, 74, 1066, 676, 202, 445, 643, 474, 382,
+	100, 424, 1123, 1163, 792, 1155, 965, 563, 134, 518, 1131, 567,
+	436, 494, 753, 1000, 1078, 729, 496, 654, 944, 272, 985, 167,
+	113, 193, 782, 876, 849, 862, 970, 381, 294, 572, 915, 956,
+	554, 1004, 996, 46, 869, 647, 392, 926, 955, 64, 861, 961,
+	524, 408, 324, 601, 9, 109, 717, 719, 992, 273, 681, 446,
+	525, 941, 1101, 571, 912, 979, 78, 591, 761, 1071, 1164, 649,
+	179, 44, 588, 94, 38, 736, 1022, 7, 1084, 479, 739, 211,
+	976, 705, 98, 674, 156, 209, 679, 315, 957, 1136, 744, 283,
+	265, 1130, 417, 296, 33, 573, 88, 395, 333, 143, 1052, 198,
+	123, 969, 871, 145, 908, 290, 602, 459, 917, 241, 153, 187,
+	868, 672, 485, 115, 853, 86, 894, 583, 1010, 1091, 215, 548,
+	216, 1162, 235, 818, 1092, 190, 621, 836, 1027, 883, 189, 697,
+	108, 184, 224, 53, 749, 925, 550, 873, 1160, 552, 141, 181,
+	418, 615, 508, 852, 254, 1025, 83, 750, 178, 948, 971, 831,
+	696, 1082, 558, 641, 765, 838, 893, 860, 147, 929, 182, 1134,
+	752, 350, 218, 648, 322, 378, 444, 165, 1122, 55, 656, 560,
+	814, 570, 196, 1005, 452, 132, 1058, 784, 478, 420, 727, 476,
+	531, 671, 75, 54, 186, 448, 651, 457, 30, 58, 913, 942,
+	865, 380, 581, 59, 536, 1057, 477, 704, 788, 228, 625, 27,
+	388, 867, 2, 260, 89, 1140, 633, 577, 264, 688, 1077, 29,
+	888, 662, 194, 1021, 344, 1053, 667, 636, 1141, 715, 1152, 1024,
+	1138, 931, 489, 244, 40, 435, 960, 919, 762, 5, 1018, 174,
+	798, 909, 373, 159, 423, 513, 342, 847, 49, 259, 1107, 660,
+	339, 1128, 188, 848, 450, 267, 1149, 138, 105, 432, 142, 69,
+	800, 611, 1079, 416, 1088, 837, 338, 440, 986, 754, 890, 301,
+	783, 116, 305, 257, 118, 345, 652, 587, 297, 268, 4, 3,
+	106, 79, 1023, 506, 170, 790, 756, 614, 1059, 737, 311, 939,
+	421, 326, 545, 686, 680, 375, 210, 371, 650, 137, 243, 954,
+	991, 661, 10, 574, 1006, 559, 36, 95, 129, 1094, 175, 618,
+	458, 884, 562, 511, 914, 1038, 820, 779, 250, 638,
+};
+
+#define CANONICAL_PROPERTY_TAGS_ID_SIZE 569
+
+static const int16_t canonical_property_tags_id_displace[CANONICAL_PROPERTY_TAGS_ID_SIZE] = {
+	1, -1, 0, 0, 0, 3, -3, 0, 1, 1, -5, 0,
+	3, 0, 0, 0, -7, -10, 0, 1, 0, 0, 3, -11,
+	1, 0, -13, -19, -20, -23, 2, -25, -27, 0, -29, 0,
+	-31, 0, 0, -40, 0, 0, 5, 1, 0, 0, 1, -41,
+	0, 0, -42, 0, -47, -53, -59, 0, 0, 0, 0, 1,
+	0, 0, 1, 0, 4, 0, -60, 0, -61, 0, 2, 0,
+	1, -62, 0, 0, 0, 3, 3, 0, -68, 2, 2, 0,
+	0, 0, 0, 0, 0, 0, -72, 2, -75, -78, 0, 0,
+	1, 5, -79, 3, -83, 3, -85, 0, 0, -89, 0, 3,
+	-93, 5, -95, 0, -99, 0, -101, 0, -103, 0, 1, 0,
+	1, 0, 0, -108, -112, -113, 0, 1, 1, -115, 5, -126,
+	0, 0, 1, 0, 0, 0, 2, 4, 0, 0, -127, 0,
+	-131, 0, 0, 0, 0, 0, 1, 4, -132, 0, -133, 0,
+	0, -137, 0, -138, -139, -140, 0, 4, 3, 1, -142, 1,
+	1, 2, -143, 0, -145, -148, -149, 0, 0, -150, -152, 4,
+	3, -156, -158, 0, -159, 0, -165, -167, 0, -173, 1, 5,
+	1, -176, 0, -178, 1, 0, 2, -181, -184, 0, 0, -185,
+	0, 0, 1, -188, 6, 0, 0, 0, -190, 0, 0, 0,
+	1, -193, -195, -200, 0, 1, 0, 0, -207, -210, 0, 0,
+	0, 1, 1, 0, 0, 1, -213, -214, 0, -217, -224, -225,
+	0, 0, 2, -226, -227, 0, 1, -232, 0, 0, 5, -241,
+	-245, 0, -253, 0, -254, 0, 0, 2, 7, -255, -258, 0,
+	0, 2, -263, -265, 5, -266, 3, 1, 1, 2, -269, 0,
+	0, 0, -271, 0, 0, -272, 0, 2, -276, 0, -277, -280,
+	0, 0, -282, 4, -286, -287, 1, -288, -289, 0, 0, -292,
+	-293, 0, 1, 4, -295, 0, -296, -298, 1, -299, -301, -302,
+	0, -306, 2, -308, 0, -309, 0, 3, -310, 1, 0, 1,
+	0, -315, -319, 0, 11, -322, 1, -323, 0, 1, -324, -326,
+	1, 1, 4, 0, 3, -327, -328, 1, 1, -329, 0, 0,
+	0, 0, 0, -331, -336, 1, 4, -337, 0, -338, -340, 0,
+	-343, -348, -350, -351, 0, 1, -353, 0, 0, -357, 1, 0,
+	2, 0, 0, -358, 0, 0, -363, 0, 3, 0, 0, -369,
+	-377, 0, 0, 1, 0, -380, 2, 0, 0, 1, 1, 0,
+	0, -381, -383, 0, -384, 5, 3, 2, 1, 0, 5, 0,
+	0, -389, 2, -393, 4, -398, 0, -399, -400, -403, -406, 1,
+	-407, 2, -409, 1, -410, -411, -415, -416, 9, -419, -422, 13,
+	0, -425, 5, -427, 2, -430, 1, 0, 10, -432, 5, -433,
+	5, 0, -436, -444, 0, 0, 0, 3, -447, 7, -451, 0,
+	-454, 0, 0, 0, 0, -460, 0, 0, 0, 6, -461, 0,
+	-466, 0, -467, 2, 5, -468, -472, -475, -478, -479, 0, 0,
+	0, -480, 5, -484, 1, 2, 1, -488, 0, 0, 14, 0,
+	2, 0, 0, 0, 0, 15, 9, 1, 1, -491, 11, -492,
+	0, 0, -497, -501, 2, 0, -502, 16, 0, 0, 0, 1,
+	0, 1, 0, 1, 0, 0, -504, 1, -506, 0, 5, -508,
+	0, -510, -511, 0, 8, 0, 0, -513, 20, -515, -519, 1,
+	0, 0, -520, -524, 10, -529, 0, 0, 2, 1, -547, 9,
+	0, -548, -549, 0, 0, -550, 10, -554, -555, -556, -557, 14,
+	-564, -565, 33, -569, 0,
+};
+
+static const uint16_t canonical_property_tags_id_slots[CANONICAL_PROPERTY_TAGS_ID_SIZE] = {
+	138, 401, 372, 242, 370, 28, 120, 248, 415, 993, 250, 390,
+	493, 699, 39, 43, 348, 1065, 709, 340, 364, 100, 134, 1165,
+	1083, 531, 298, 302, 667, 1001, 130, 58, 1057, 885, 184, 1173,
+	196, 763, 1069, 178, 791, 1033, 515, 1063, 227, 979, 785, 601,
+	92, 1021, 938, 16, 691, 433, 689, 461, 511, 575, 742, 140,
+	18, 769, 671, 859, 52, 457, 342, 1009, 291, 649, 701, 264,
+	1089, 989, 837, 877, 937, 334, 933, 723, 208, 987, 969, 1131,
+	825, 260, 903, 362, 875, 322, 132, 66, 725, 599, 607, 499,
+	497, 651, 455, 360, 653, 1150, 1007, 685, 366, 525, 555, 475,
+	282, 923, 192, 565, 48, 809, 927, 983, 641, 3, 532, 517,
+	703, 673, 593, 947, 473, 240, 921, 368, 122, 1047, 312, 451,
+	212, 80, 1167, 677, 1017, 386, 833, 489, 338, 750, 663, 182,
+	22, 294, 485, 30, 105, 1093, 90, 657, 1029, 1039, 705, 737,
+	229, 477, 1147, 509, 35, 266, 905, 26, 741, 14, 746, 427,
+	296, 811, 631, 1075, 957, 204, 202, 216, 1117, 186, 214, 906,
+	585, 752, 567, 1059, 382, 483, 1025, 871, 991, 403, 1050, 826,
+	853, 669, 817, 879, 126, 397, 529, 711, 519, 779, 108, 523,
+	503, 845, 589, 781, 773, 803, 505, 635, 721, 328, 731, 815,
+	693, 557, 481, 942, 116, 495, 805, 695, 1148, 1043, 867, 551,
+	855, 300, 727, 605, 748, 276, 717, 819, 12, 891, 577, 767,
+	316, 459, 799, 831, 70, 627, 41, 851, 625, 54, 573, 909,
+	713, 1081, 1144, 1170, 128, 104, 849, 765, 200, 231, 775, 643,
+	949, 1061, 234, 847, 733, 857, 955, 659, 304, 288, 757, 1055,
+	1152, 883, 1157, 449, 739, 1172, 924, 1037, 409, 419, 873, 324,
+	744, 8, 6, 1161, 579, 471, 68, 807, 224, 411, 889, 354,
+	787, 754, 655, 280, 513, 164, 172, 62, 467, 463, 465, 0,
+	675, 1091, 114, 154, 901, 190, 144, 919, 1169, 310, 443, 547,
+	268, 1097, 1079, 425, 571, 56, 1041, 715, 1115, 679, 595, 102,
+	521, 391, 1023, 429, 1168, 1077, 647, 447, 861, 1027, 940, 148,
+	158, 194, 735, 445, 278, 1158, 20, 76, 563, 835, 1049, 1160,
+	252, 439, 64, 539, 683, 603, 537, 545, 378, 553, 160, 917,
+	777, 343, 1095, 1154, 1019, 637, 951, 800, 1071, 894, 1013, 166,
+	1107, 1087, 270, 72, 931, 180, 124, 881, 797, 611, 633, 771,
+	284, 174, 352, 346, 1031, 50, 935, 286, 915, 1099, 829, 1015,
+	1163, 1005, 629, 176, 413, 336, 437, 527, 541, 1153, 399, 136,
+	865, 1034, 150, 162, 112, 32, 262, 591, 613, 417, 238, 60,
+	661, 479, 405, 609, 152, 1162, 1164, 94, 469, 487, 953, 332,
+	290, 621, 823, 569, 349, 549, 86, 899, 645, 421, 1133, 543,
+	1067, 587, 246, 210, 561, 222, 256, 155, 1073, 272, 168, 380,
+	395, 1159, 1155, 1171, 1149, 981, 356, 501, 759, 320, 843, 393,
+	841, 913, 792, 326, 441, 719, 944, 384, 729, 274, 789, 1156,
+	407, 839, 794, 1045, 1145, 226, 142, 559, 98, 330, 1151, 376,
+	45, 388, 1139, 707, 37, 1146, 911, 995, 507, 84, 34, 318,
+	1143, 1, 258, 220, 681, 218, 314, 1166, 761, 206, 244, 623,
+	897, 821, 431, 118, 813, 965, 1085, 306, 308, 146, 535, 997,
+	96, 869, 985, 863, 491, 110, 597, 358, 254, 188, 929, 687,
+	1111, 783, 697, 619, 583, 639, 665, 24, 374, 423, 893, 887,
+	999, 1053, 198, 1011, 9,
+};
+
+static const struct mapi_proptags *canonical_property_tags_find_tag(uint32_t proptag)
+{
+	const struct mapi_proptags	*entry;
+	int32_t				d;
+	uint32_t			slot;
+
+	d = canonical_property_tags_tag_displace[mapi_phash_proptag(0, proptag) % CANONICAL_PROPERTY_TAGS_TAG_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_proptag(d, proptag) % CANONICAL_PROPERTY_TAGS_TAG_SIZE;
+	entry = &canonical_property_tags[canonical_property_tags_tag_slots[slot]];
+
+	return (entry->proptag == proptag) ? entry : NULL;
+}
+
 _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 {
-	uint32_t idx;
+	const struct mapi_proptags	*entry;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+	entry = canonical_property_tags_find_tag(proptag);
+	if (entry) {
+		return entry->propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
-		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
+		entry = canonical_property_tags_find_tag(proptag + 1); /* try as _UNICODE variant */
+		if (entry) {
+			return entry->propname;
 		}
 	}
 	return NULL;
@@ -1212,29 +1728,30 @@ _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 
 _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 {
-	uint32_t idx;
+	const struct mapi_proptags	*entry;
+	int32_t				d;
+	uint32_t			slot;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (!strcmp(canonical_property_tags[idx].propname, propname)) { 
-			return canonical_property_tags[idx].proptag;
-		}
-	}
+	if (!propname) return 0;
 
-	return 0;
+	d = canonical_property_tags_name_displace[mapi_phash_string(0, propname) % CANONICAL_PROPERTY_TAGS_NAME_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_string(d, propname) % CANONICAL_PROPERTY_TAGS_NAME_SIZE;
+	entry = &canonical_property_tags[canonical_property_tags_name_slots[slot]];
+
+	return strcmp(entry->propname, propname) ? 0 : entry->proptag;
 }
 
 _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 {
-	uint32_t	idx;
-	uint16_t	current_type;
+	const struct mapi_proptags	*entry;
+	int32_t				d;
+	uint32_t			slot;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if ((canonical_property_tags[idx].proptag >> 16) == untypedtag) {
-			current_type = canonical_property_tags[idx].proptype;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
-		}
+	d = canonical_property_tags_id_displace[mapi_phash_proptag(0, untypedtag) % CANONICAL_PROPERTY_TAGS_ID_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_proptag(d, untypedtag) % CANONICAL_PROPERTY_TAGS_ID_SIZE;
+	entry = &canonical_property_tags[canonical_property_tags_id_slots[slot]];
+	if ((entry->proptag >> 16) == untypedtag) {
+		return entry->proptype;
 	}
 
 	OC_DEBUG(5, "type for property '%x' could not be deduced", untypedtag);
@@ -31,6 +31,7 @@ struct openchangedb_context {
 	enum MAPISTATUS (*get_new_changeNumber)(struct openchangedb_context *, const char *, uint64_t *);
 	enum MAPISTATUS (*get_new_changeNumbers)(struct openchangedb_context *, TALLOC_CTX *, const char *, uint64_t, struct UI8Array_r **);
 	enum MAPISTATUS (*get_next_changeNumber)(struct openchangedb_context *, const char *, uint64_t *);
+	enum MAPISTATUS (*release_changeNumbers)(struct openchangedb_context *, const char *, uint64_t, uint64_t);
 	enum MAPISTATUS (*get_SpecialFolderID)(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
 	enum MAPISTATUS (*get_SystemFolderID)(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
 	enum MAPISTATUS (*get_PublicFolderID)(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
@@ -67,6 +68,7 @@ struct openchangedb_context {
 	enum MAPISTATUS (*table_set_sort_order)(struct openchangedb_context *, void *, struct SSortOrderSet *);
 	enum MAPISTATUS (*table_set_restrictions)(struct openchangedb_context *, void *, struct mapi_SRestriction *);
 	enum MAPISTATUS (*table_get_property)(TALLOC_CTX *, struct openchangedb_context *, void *, enum MAPITAGS, uint32_t, bool, void **);
+	enum MAPISTATUS (*table_get_properties)(TALLOC_CTX *, struct openchangedb_context *, void *, struct SPropTagArray *, uint32_t, uint32_t, bool, void ***, enum MAPISTATUS **);
 
 	enum MAPISTATUS (*message_create)(TALLOC_CTX *, struct openchangedb_context *, const char *, uint64_t, uint64_t, bool, void **);
 	enum MAPISTATUS (*message_save)(struct openchangedb_context *, void *, uint8_t);
@@ -92,6 +94,9 @@ struct openchangedb_context {
 
 	const char *backend_type;
 	void *data;
+
+	/* Change numbers leased by this process, see openchangedb.c */
+	struct openchangedb_cn_allocator *cn_allocator;
 };
 
 const char *nil_string;
@@ -0,0 +1,1214 @@
+/*
+   OpenChange Server implementation
+
+   OpenChangeDB read-through cache backend
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file openchangedb_cache.c
+
+   \brief Read-through cache decorator for OpenChangeDB backends
+
+   Folder identifiers, mailbox GUIDs and replicas, mapistore URIs,
+   parent folders and folder properties are kept in memory once the
+   decorated backend returned them. Every other call goes straight to
+   the backend.
+
+   Writes are forwarded to the backend and invalidate what they may
+   change. Folder writes stamp the folder so that older entries about
+   it are ignored, message writes do the same for every folder
+   property, and structural changes (mailbox or folder creation and
+   deletion, system index changes) drop the whole cache.
+ */
+
+#include "openchangedb_cache.h"
+
+#include "../libmapiproxy.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+
+#include <inttypes.h>
+
+/* Number of lookups between two statistics reports */
+#define	OCDB_CACHE_REPORT_INTERVAL	10000
+
+enum ocdb_cache_kind {
+	OCDB_CACHE_SYSTEM_FOLDER_ID = 1,
+	OCDB_CACHE_SPECIAL_FOLDER_ID,
+	OCDB_CACHE_PUBLIC_FOLDER_ID,
+	OCDB_CACHE_MAILBOX_GUID,
+	OCDB_CACHE_MAILBOX_REPLICA,
+	OCDB_CACHE_MAPISTORE_URI,
+	OCDB_CACHE_PARENT_FID,
+	OCDB_CACHE_FOLDER_PROPERTY
+};
+
+struct ocdb_cache_key {
+	enum ocdb_cache_kind	kind;
+	const char		*username;
+	uint64_t		fid;
+	uint32_t		arg;
+};
+
+struct ocdb_cache_entry {
+	struct ocdb_cache_key	key;
+	uint64_t		stamp;
+	union {
+		uint64_t	id;
+		struct GUID	guid;
+		struct {
+			uint16_t	replid;
+			struct GUID	guid;
+		} replica;
+		char		*uri;
+		void		*data;
+	} value;
+};
+
+struct ocdb_cache_folder {
+	uint64_t		fid;
+	uint64_t		stamp;
+};
+
+struct ocdb_cache_data {
+	struct openchangedb_context	*backend;
+	TALLOC_CTX			*entries_ctx;
+	struct htable			entries;
+	struct htable			folders;
+	uint32_t			max_entries;
+	uint64_t			stamp;
+	uint64_t			properties_stamp;
+	struct openchangedb_cache_stats	stats;
+};
+
+static struct ocdb_cache_data * _ocdb_cache_data_get(struct openchangedb_context *self)
+{
+	return talloc_get_type(self->data, struct ocdb_cache_data);
+}
+
+// v cache entries ------------------------------------------------------------
+
+static size_t ocdb_cache_hash_fid(uint64_t fid)
+{
+	return (uint32_t)(fid >> 32) * 31 + (uint32_t)fid;
+}
+
+static size_t ocdb_cache_hash_key(const struct ocdb_cache_key *key)
+{
+	size_t	h;
+
+	h = key->username ? hash_string(key->username) : 0;
+	h = h * 31 + key->kind;
+	h = h * 31 + key->arg;
+	return h * 31 + ocdb_cache_hash_fid(key->fid);
+}
+
+/* Rehash function for the entries table */
+static size_t _entries_rehash(const void *e, void *unused)
+{
+	return ocdb_cache_hash_key(&((const struct ocdb_cache_entry *)e)->key);
+}
+
+/* Comparison function to get entries from the entries table */
+static bool _entries_cmp(const void *e, void *k)
+{
+	const struct ocdb_cache_key *a = &((const struct ocdb_cache_entry *)e)->key;
+	const struct ocdb_cache_key *b = (const struct ocdb_cache_key *)k;
+
+	if (a->kind != b->kind || a->fid != b->fid || a->arg != b->arg) {
+		return false;
+	}
+	if (!a->username || !b->username) {
+		return a->username == b->username;
+	}
+	return strcmp(a->username, b->username) == 0;
+}
+
+/* Rehash function for the folders table */
+static size_t _folders_rehash(const void *e, void *unused)
+{
+	return ocdb_cache_hash_fid(((const struct ocdb_cache_folder *)e)->fid);
+}
+
+/* Comparison function to get folders from the folders table */
+static bool _folders_cmp(const void *e, void *fid)
+{
+	return ((const struct ocdb_cache_folder *)e)->fid == *(const uint64_t *)fid;
+}
+
+/**
+   \details Drop every cached entry
+
+   \param priv_data pointer to the cache private data
+ */
+static void ocdb_cache_flush(struct ocdb_cache_data *priv_data)
+{
+	htable_clear(&priv_data->entries);
+	htable_clear(&priv_data->folders);
+	talloc_free(priv_data->entries_ctx);
+	priv_data->entries_ctx = talloc_named(priv_data, 0, "ocdb_cache_entries");
+	priv_data->stats.entries = 0;
+	priv_data->stats.flushes++;
+}
+
+/**
+   \details Mark every cached entry about a folder as stale
+
+   \param priv_data pointer to the cache private data
+   \param fid the folder identifier
+ */
+static void ocdb_cache_invalidate_folder(struct ocdb_cache_data *priv_data, uint64_t fid)
+{
+	struct ocdb_cache_folder	*folder;
+
+	priv_data->stamp++;
+	priv_data->stats.invalidations++;
+
+	folder = htable_get(&priv_data->folders, ocdb_cache_hash_fid(fid), _folders_cmp, &fid);
+	if (folder) {
+		folder->stamp = priv_data->stamp;
+		return;
+	}
+
+	folder = talloc_zero(priv_data->entries_ctx, struct ocdb_cache_folder);
+	if (!folder || !htable_add(&priv_data->folders, ocdb_cache_hash_fid(fid), folder)) {
+		talloc_free(folder);
+		ocdb_cache_flush(priv_data);
+		return;
+	}
+	folder->fid = fid;
+	folder->stamp = priv_data->stamp;
+}
+
+/**
+   \details Mark every cached folder property as stale
+
+   \param priv_data pointer to the cache private data
+ */
+static void ocdb_cache_invalidate_properties(struct ocdb_cache_data *priv_data)
+{
+	priv_data->stamp++;
+	priv_data->stats.invalidations++;
+	priv_data->properties_stamp = priv_data->stamp;
+}
+
+static void ocdb_cache_remove(struct ocdb_cache_data *priv_data, struct ocdb_cache_entry *entry)
+{
+	htable_del(&priv_data->entries, ocdb_cache_hash_key(&entry->key), entry);
+	talloc_free(entry);
+	priv_data->stats.entries--;
+}
+
+static bool ocdb_cache_is_stale(struct ocdb_cache_data *priv_data, struct ocdb_cache_entry *entry)
+{
+	struct ocdb_cache_folder	*folder;
+
+	switch (entry->key.kind) {
+	case OCDB_CACHE_FOLDER_PROPERTY:
+		if (entry->stamp < priv_data->properties_stamp) {
+			return true;
+		}
+		/* fall through */
+	case OCDB_CACHE_MAPISTORE_URI:
+	case OCDB_CACHE_PARENT_FID:
+		folder = htable_get(&priv_data->folders, ocdb_cache_hash_fid(entry->key.fid),
+				    _folders_cmp, &entry->key.fid);
+		return folder && entry->stamp < folder->stamp;
+	default:
+		return false;
+	}
+}
+
+static void ocdb_cache_report(struct ocdb_cache_data *priv_data)
+{
+	OC_DEBUG(3, "openchangedb cache: %"PRIu64" hits, %"PRIu64" misses, %"PRIu32" entries, "
+		 "%"PRIu64" invalidations, %"PRIu64" flushes",
+		 priv_data->stats.hits, priv_data->stats.misses, priv_data->stats.entries,
+		 priv_data->stats.invalidations, priv_data->stats.flushes);
+}
+
+/**
+   \details Look up a valid cache entry
+
+   \param priv_data pointer to the cache private data
+   \param key the key to look up
+
+   \return the cache entry on hit, otherwise NULL
+ */
+static struct ocdb_cache_entry *ocdb_cache_lookup(struct ocdb_cache_data *priv_data,
+						  const struct ocdb_cache_key *key)
+{
+	struct ocdb_cache_entry	*entry;
+
+	entry = htable_get(&priv_data->entries, ocdb_cache_hash_key(key), _entries_cmp, key);
+	if (entry && ocdb_cache_is_stale(priv_data, entry)) {
+		ocdb_cache_remove(priv_data, entry);
+		entry = NULL;
+	}
+
+	if (entry) {
+		priv_data->stats.hits++;
+	} else {
+		priv_data->stats.misses++;
+	}
+	if ((priv_data->stats.hits + priv_data->stats.misses) % OCDB_CACHE_REPORT_INTERVAL == 0) {
+		ocdb_cache_report(priv_data);
+	}
+
+	return entry;
+}
+
+/**
+   \details Add an entry to the cache
+
+   The whole cache is dropped when it reaches its maximum size.
+
+   \param priv_data pointer to the cache private data
+   \param key the key of the new entry
+
+   \return the new entry to fill in on success, otherwise NULL
+ */
+static struct ocdb_cache_entry *ocdb_cache_insert(struct ocdb_cache_data *priv_data,
+						  const struct ocdb_cache_key *key)
+{
+	struct ocdb_cache_entry	*entry;
+
+	if (priv_data->stats.entries >= priv_data->max_entries) {
+		ocdb_cache_flush(priv_data);
+	}
+
+	entry = talloc_zero(priv_data->entries_ctx, struct ocdb_cache_entry);
+	if (!entry) return NULL;
+
+	entry->key = *key;
+	if (key->username) {
+		entry->key.username = talloc_strdup(entry, key->username);
+		if (!entry->key.username) {
+			talloc_free(entry);
+			return NULL;
+		}
+	}
+	entry->stamp = priv_data->stamp;
+
+	if (!htable_add(&priv_data->entries, ocdb_cache_hash_key(&entry->key), entry)) {
+		talloc_free(entry);
+		return NULL;
+	}
+	priv_data->stats.entries++;
+
+	return entry;
+}
+
+static bool ocdb_cache_property_cacheable(uint32_t proptag)
+{
+	switch (proptag & 0xFFFF) {
+	case PT_BOOLEAN:
+	case PT_SHORT:
+	case PT_LONG:
+	case PT_I8:
+	case PT_DOUBLE:
+	case PT_SYSTIME:
+	case PT_STRING8:
+	case PT_UNICODE:
+	case PT_BINARY:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+   \details Duplicate a folder property value as returned by a backend
+
+   \param mem_ctx pointer to the memory context
+   \param proptag the property tag
+   \param data pointer to the property value
+
+   \return the duplicated value on success, otherwise NULL
+ */
+static void *ocdb_cache_copy_property(TALLOC_CTX *mem_ctx, uint32_t proptag, const void *data)
+{
+	const struct Binary_r	*bin;
+	struct Binary_r		*copy;
+
+	switch (proptag & 0xFFFF) {
+	case PT_STRING8:
+	case PT_UNICODE:
+		return talloc_strdup(mem_ctx, (const char *) data);
+	case PT_BINARY:
+		bin = (const struct Binary_r *) data;
+		copy = talloc_zero(mem_ctx, struct Binary_r);
+		if (!copy) return NULL;
+		copy->cb = bin->cb;
+		copy->lpb = talloc_memdup(copy, bin->lpb, bin->cb);
+		if (!copy->lpb) {
+			talloc_free(copy);
+			return NULL;
+		}
+		return copy;
+	default:
+		/* Fixed size values, backends disagree on PT_BOOLEAN size */
+		return talloc_memdup(mem_ctx, data, talloc_get_size(data));
+	}
+}
+
+// ^ cache entries ------------------------------------------------------------
+
+// v cached lookups -----------------------------------------------------------
+
+static enum MAPISTATUS get_folder_id(struct openchangedb_context *self,
+				     enum ocdb_cache_kind kind,
+				     const char *username, uint32_t system_idx,
+				     uint64_t *folder_id)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_entry	*entry;
+	struct ocdb_cache_key	key = { kind, username, 0, system_idx };
+
+	entry = ocdb_cache_lookup(priv_data, &key);
+	if (entry) {
+		*folder_id = entry->value.id;
+		return MAPI_E_SUCCESS;
+	}
+
+	switch (kind) {
+	case OCDB_CACHE_SYSTEM_FOLDER_ID:
+		retval = priv_data->backend->get_SystemFolderID(priv_data->backend, username, system_idx, folder_id);
+		break;
+	case OCDB_CACHE_SPECIAL_FOLDER_ID:
+		retval = priv_data->backend->get_SpecialFolderID(priv_data->backend, username, system_idx, folder_id);
+		break;
+	default:
+		retval = priv_data->backend->get_PublicFolderID(priv_data->backend, username, system_idx, folder_id);
+		break;
+	}
+	if (retval != MAPI_E_SUCCESS) {
+		return retval;
+	}
+
+	entry = ocdb_cache_insert(priv_data, &key);
+	if (entry) {
+		entry->value.id = *folder_id;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_SpecialFolderID(struct openchangedb_context *self,
+					   const char *recipient, uint32_t system_idx,
+					   uint64_t *folder_id)
+{
+	return get_folder_id(self, OCDB_CACHE_SPECIAL_FOLDER_ID, recipient, system_idx, folder_id);
+}
+
+static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
+					  const char *recipient, uint32_t SystemIdx,
+					  uint64_t *FolderId)
+{
+	return get_folder_id(self, OCDB_CACHE_SYSTEM_FOLDER_ID, recipient, SystemIdx, FolderId);
+}
+
+static enum MAPISTATUS get_PublicFolderID(struct openchangedb_context *self,
+					  const char *username,
+					  uint32_t SystemIdx,
+					  uint64_t *FolderId)
+{
+	return get_folder_id(self, OCDB_CACHE_PUBLIC_FOLDER_ID, username, SystemIdx, FolderId);
+}
+
+static enum MAPISTATUS get_MailboxGuid(struct openchangedb_context *self,
+				       const char *recipient,
+				       struct GUID *MailboxGUID)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_entry	*entry;
+	struct ocdb_cache_key	key = { OCDB_CACHE_MAILBOX_GUID, recipient, 0, 0 };
+
+	entry = ocdb_cache_lookup(priv_data, &key);
+	if (entry) {
+		*MailboxGUID = entry->value.guid;
+		return MAPI_E_SUCCESS;
+	}
+
+	retval = priv_data->backend->get_MailboxGuid(priv_data->backend, recipient, MailboxGUID);
+	if (retval != MAPI_E_SUCCESS) {
+		return retval;
+	}
+
+	entry = ocdb_cache_insert(priv_data, &key);
+	if (entry) {
+		entry->value.guid = *MailboxGUID;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_MailboxReplica(struct openchangedb_context *self,
+					  const char *recipient, uint16_t *ReplID,
+					  struct GUID *ReplGUID)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_entry	*entry;
+	struct ocdb_cache_key	key = { OCDB_CACHE_MAILBOX_REPLICA, recipient, 0, 0 };
+	uint16_t		replid;
+	struct GUID		guid;
+
+	entry = ocdb_cache_lookup(priv_data, &key);
+	if (!entry) {
+		/* Always fetch both values so either can be served later */
+		retval = priv_data->backend->get_MailboxReplica(priv_data->backend, recipient, &replid, &guid);
+		if (retval != MAPI_E_SUCCESS) {
+			return retval;
+		}
+
+		entry = ocdb_cache_insert(priv_data, &key);
+		if (!entry) {
+			if (ReplID) *ReplID = replid;
+			if (ReplGUID) *ReplGUID = guid;
+			return MAPI_E_SUCCESS;
+		}
+		entry->value.replica.replid = replid;
+		entry->value.replica.guid = guid;
+	}
+
+	if (ReplID) *ReplID = entry->value.replica.replid;
+	if (ReplGUID) *ReplGUID = entry->value.replica.guid;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_mapistoreURI(TALLOC_CTX *parent_ctx,
+					struct openchangedb_context *self,
+					const char *username,
+					uint64_t fid, char **mapistoreURL,
+					bool mailboxstore)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_entry	*entry;
+	struct ocdb_cache_key	key = { OCDB_CACHE_MAPISTORE_URI, username, fid, mailboxstore };
+
+	entry = ocdb_cache_lookup(priv_data, &key);
+	if (entry) {
+		*mapistoreURL = talloc_strdup(parent_ctx, entry->value.uri);
+		OPENCHANGE_RETVAL_IF(!*mapistoreURL, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		return MAPI_E_SUCCESS;
+	}
+
+	retval = priv_data->backend->get_mapistoreURI(parent_ctx, priv_data->backend, username, fid, mapistoreURL, mailboxstore);
+	if (retval != MAPI_E_SUCCESS || !*mapistoreURL) {
+		return retval;
+	}
+
+	entry = ocdb_cache_insert(priv_data, &key);
+	if (entry) {
+		entry->value.uri = talloc_strdup(entry, *mapistoreURL);
+		if (!entry->value.uri) {
+			ocdb_cache_remove(priv_data, entry);
+		}
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_parent_fid(struct openchangedb_context *self,
+				      const char *username, uint64_t fid,
+				      uint64_t *parent_fidp, bool mailboxstore)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_entry	*entry;
+	struct ocdb_cache_key	key = { OCDB_CACHE_PARENT_FID, username, fid, mailboxstore };
+
+	entry = ocdb_cache_lookup(priv_data, &key);
+	if (entry) {
+		*parent_fidp = entry->value.id;
+		return MAPI_E_SUCCESS;
+	}
+
+	retval = priv_data->backend->get_parent_fid(priv_data->backend, username, fid, parent_fidp, mailboxstore);
+	if (retval != MAPI_E_SUCCESS) {
+		return retval;
+	}
+
+	entry = ocdb_cache_insert(priv_data, &key);
+	if (entry) {
+		entry->value.id = *parent_fidp;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
+					   struct openchangedb_context *self,
+					   const char *username,
+					   uint32_t proptag, uint64_t fid,
+					   void **data)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+	struct ocdb_cache_entry	*entry;
+	struct ocdb_cache_key	key = { OCDB_CACHE_FOLDER_PROPERTY, username, fid, proptag };
+
+	if (!ocdb_cache_property_cacheable(proptag)) {
+		return priv_data->backend->get_folder_property(parent_ctx, priv_data->backend, username, proptag, fid, data);
+	}
+
+	entry = ocdb_cache_lookup(priv_data, &key);
+	if (entry) {
+		*data = ocdb_cache_copy_property(parent_ctx, proptag, entry->value.data);
+		OPENCHANGE_RETVAL_IF(!*data, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		return MAPI_E_SUCCESS;
+	}
+
+	retval = priv_data->backend->get_folder_property(parent_ctx, priv_data->backend, username, proptag, fid, data);
+	if (retval != MAPI_E_SUCCESS || !*data) {
+		return retval;
+	}
+
+	entry = ocdb_cache_insert(priv_data, &key);
+	if (entry) {
+		entry->value.data = ocdb_cache_copy_property(entry, proptag, *data);
+		if (!entry->value.data) {
+			ocdb_cache_remove(priv_data, entry);
+		}
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+// ^ cached lookups -----------------------------------------------------------
+
+// v invalidating writes ------------------------------------------------------
+
+static enum MAPISTATUS set_mapistoreURI(struct openchangedb_context *self,
+					const char *username, uint64_t fid,
+					const char *mapistoreURL)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+
+	retval = priv_data->backend->set_mapistoreURI(priv_data->backend, username, fid, mapistoreURL);
+	ocdb_cache_invalidate_folder(priv_data, fid);
+
+	return retval;
+}
+
+static enum MAPISTATUS set_folder_properties(struct openchangedb_context *self,
+					     const char *username, uint64_t fid,
+					     struct SRow *row)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+
+	retval = priv_data->backend->set_folder_properties(priv_data->backend, username, fid, row);
+	ocdb_cache_invalidate_folder(priv_data, fid);
+
+	return retval;
+}
+
+static enum MAPISTATUS create_mailbox(struct openchangedb_context *self,
+				      const char *username,
+				      const char *organization_name,
+				      const char *groupo_name,
+				      int systemIdx, uint64_t fid,
+				      const char *display_name)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+
+	retval = priv_data->backend->create_mailbox(priv_data->backend, username,
+						    organization_name, groupo_name,
+						    systemIdx, fid, display_name);
+	ocdb_cache_flush(priv_data);
+
+	return retval;
+}
+
+static enum MAPISTATUS create_folder(struct openchangedb_context *self,
+				     const char *username,
+				     uint64_t parentFolderID, uint64_t fid,
+				     uint64_t changeNumber,
+				     const char *MAPIStoreURI, int systemIdx)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+
+	retval = priv_data->backend->create_folder(priv_data->backend, username, parentFolderID, fid, changeNumber, MAPIStoreURI, systemIdx);
+	ocdb_cache_flush(priv_data);
+
+	return retval;
+}
+
+static enum MAPISTATUS delete_folder(struct openchangedb_context *self,
+				     const char *username, uint64_t fid)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+
+	retval = priv_data->backend->delete_folder(priv_data->backend, username, fid);
+	ocdb_cache_flush(priv_data);
+
+	return retval;
+}
+
+static enum MAPISTATUS set_system_idx(struct openchangedb_context *self,
+				      const char *username, uint64_t fid,
+				      int system_idx)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+
+	retval = priv_data->backend->set_system_idx(priv_data->backend, username, fid, system_idx);
+	ocdb_cache_flush(priv_data);
+
+	return retval;
+}
+
+static enum MAPISTATUS message_save(struct openchangedb_context *self,
+				    void *_msg, uint8_t SaveFlags)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+
+	retval = priv_data->backend->message_save(priv_data->backend, _msg, SaveFlags);
+	ocdb_cache_invalidate_properties(priv_data);
+
+	return retval;
+}
+
+static enum MAPISTATUS message_set_properties(TALLOC_CTX *mem_ctx,
+					      struct openchangedb_context *self,
+					      void *message_object,
+					      struct SRow *row)
+{
+	enum MAPISTATUS		retval;
+	struct ocdb_cache_data	*priv_data = _ocdb_cache_data_get(self);
+
+	retval = priv_data->backend->message_set_properties(mem_ctx, priv_data->backend, message_object, row);
+	ocdb_cache_invalidate_properties(priv_data);
+
+	return retval;
+}
+
+// ^ invalidating writes ------------------------------------------------------
+
+// v pass-through -------------------------------------------------------------
+
+static enum MAPISTATUS get_distinguishedName(TALLOC_CTX *parent_ctx,
+					     struct openchangedb_context *self,
+					     uint64_t fid,
+					     char **distinguishedName)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_distinguishedName(parent_ctx, priv_data->backend, fid, distinguishedName);
+}
+
+static enum MAPISTATUS get_PublicFolderReplica(struct openchangedb_context *self,
+					       const char *username,
+					       uint16_t *ReplID,
+					       struct GUID *ReplGUID)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_PublicFolderReplica(priv_data->backend, username, ReplID, ReplGUID);
+}
+
+static enum MAPISTATUS get_fid(struct openchangedb_context *self,
+			       const char *mapistoreURL, uint64_t *fidp)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_fid(priv_data->backend, mapistoreURL, fidp);
+}
+
+static enum MAPISTATUS get_MAPIStoreURIs(struct openchangedb_context *self,
+					 const char *username,
+					 TALLOC_CTX *mem_ctx,
+					 struct StringArrayW_r **urisP)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_MAPIStoreURIs(priv_data->backend, username, mem_ctx, urisP);
+}
+
+static enum MAPISTATUS get_ReceiveFolder(TALLOC_CTX *parent_ctx,
+					 struct openchangedb_context *self,
+					 const char *recipient,
+					 const char *MessageClass,
+					 uint64_t *fid,
+					 const char **ExplicitMessageClass)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_ReceiveFolder(parent_ctx, priv_data->backend, recipient, MessageClass, fid, ExplicitMessageClass);
+}
+
+static enum MAPISTATUS get_ReceiveFolderTable(TALLOC_CTX *parent_ctx,
+					      struct openchangedb_context *self,
+					      const char *recipient,
+					      uint32_t *cValues,
+					      struct ReceiveFolder **entries)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_ReceiveFolderTable(parent_ctx, priv_data->backend, recipient, cValues, entries);
+}
+
+static enum MAPISTATUS get_TransportFolder(struct openchangedb_context *self,
+					   const char *recipient,
+					   uint64_t *FolderId)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_TransportFolder(priv_data->backend, recipient, FolderId);
+}
+
+static enum MAPISTATUS get_folder_count(struct openchangedb_context *self,
+					const char *username, uint64_t fid,
+					uint32_t *RowCount)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_folder_count(priv_data->backend, username, fid, RowCount);
+}
+
+static enum MAPISTATUS lookup_folder_property(struct openchangedb_context *self,
+					      uint32_t proptag, uint64_t fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->lookup_folder_property(priv_data->backend, proptag, fid);
+}
+
+static enum MAPISTATUS get_new_changeNumber(struct openchangedb_context *self,
+					    const char *username, uint64_t *cn)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_new_changeNumber(priv_data->backend, username, cn);
+}
+
+static enum MAPISTATUS get_new_changeNumbers(struct openchangedb_context *self,
+					     TALLOC_CTX *mem_ctx,
+					     const char *username,
+					     uint64_t max,
+					     struct UI8Array_r **cns_p)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_new_changeNumbers(priv_data->backend, mem_ctx, username, max, cns_p);
+}
+
+static enum MAPISTATUS get_next_changeNumber(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t *cn)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_next_changeNumber(priv_data->backend, username, cn);
+}
+
+static enum MAPISTATUS release_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t first, uint64_t end)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->release_changeNumbers(priv_data->backend, username, first, end);
+}
+
+static enum MAPISTATUS get_table_property(TALLOC_CTX *parent_ctx,
+					  struct openchangedb_context *self,
+					  const char *ldb_filter,
+					  uint32_t proptag, uint32_t pos,
+					  void **data)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_table_property(parent_ctx, priv_data->backend, ldb_filter, proptag, pos, data);
+}
+
+static enum MAPISTATUS get_fid_by_name(struct openchangedb_context *self,
+				       const char *username,
+				       uint64_t parent_fid,
+				       const char* foldername, uint64_t *fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_fid_by_name(priv_data->backend, username, parent_fid, foldername, fid);
+}
+
+static enum MAPISTATUS get_mid_by_subject(struct openchangedb_context *self,
+					  const char *username,
+					  uint64_t parent_fid,
+					  const char *subject,
+					  bool mailboxstore, uint64_t *mid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_mid_by_subject(priv_data->backend, username, parent_fid, subject, mailboxstore, mid);
+}
+
+static enum MAPISTATUS set_ReceiveFolder(struct openchangedb_context *self,
+					 const char *recipient,
+					 const char *MessageClass, uint64_t fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->set_ReceiveFolder(priv_data->backend, recipient, MessageClass, fid);
+}
+
+static enum MAPISTATUS get_fid_from_partial_uri(struct openchangedb_context *self,
+						const char *partialURI, uint64_t *fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_fid_from_partial_uri(priv_data->backend, partialURI, fid);
+}
+
+static enum MAPISTATUS get_users_from_partial_uri(TALLOC_CTX *parent_ctx,
+						  struct openchangedb_context *self,
+						  const char *partialURI,
+						  uint32_t *count,
+						  char ***MAPIStoreURI,
+						  char ***users)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_users_from_partial_uri(parent_ctx, priv_data->backend, partialURI, count, MAPIStoreURI, users);
+}
+
+static enum MAPISTATUS get_message_count(struct openchangedb_context *self,
+					 const char *username, uint64_t fid,
+					 uint32_t *RowCount, bool fai)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_message_count(priv_data->backend, username, fid, RowCount, fai);
+}
+
+static enum MAPISTATUS get_system_idx(struct openchangedb_context *self,
+				      const char *username, uint64_t fid,
+				      int *system_idx_p)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_system_idx(priv_data->backend, username, fid, system_idx_p);
+}
+
+static enum MAPISTATUS transaction_start(struct openchangedb_context *self)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->transaction_start(priv_data->backend);
+}
+
+static enum MAPISTATUS transaction_commit(struct openchangedb_context *self)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->transaction_commit(priv_data->backend);
+}
+
+static enum MAPISTATUS get_new_public_folderID(struct openchangedb_context *self,
+					       const char *username,
+					       uint64_t *fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_new_public_folderID(priv_data->backend, username, fid);
+}
+
+static bool is_public_folder_id(struct openchangedb_context *self, uint64_t fid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->is_public_folder_id(priv_data->backend, fid);
+}
+
+static enum MAPISTATUS get_indexing_url(struct openchangedb_context *self,
+					const char *username,
+					const char **indexing_url)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_indexing_url(priv_data->backend, username, indexing_url);
+}
+
+static bool set_locale(struct openchangedb_context *self, const char *username, uint32_t lcid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->set_locale(priv_data->backend, username, lcid);
+}
+
+static const char **get_folders_names(TALLOC_CTX *mem_ctx, struct openchangedb_context *self, const char *locale, const char *type)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->get_folders_names(mem_ctx, priv_data->backend, locale, type);
+}
+
+static enum MAPISTATUS replica_mapping_guid_to_replid(struct openchangedb_context *self, const char *username, const struct GUID *guid, uint16_t *replid_p)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->replica_mapping_guid_to_replid(priv_data->backend, username, guid, replid_p);
+}
+
+static enum MAPISTATUS replica_mapping_replid_to_guid(struct openchangedb_context *self, const char *username, uint16_t replid, struct GUID *guid)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->replica_mapping_replid_to_guid(priv_data->backend, username, replid, guid);
+}
+
+static enum MAPISTATUS table_init(TALLOC_CTX *mem_ctx,
+				  struct openchangedb_context *self,
+				  const char *username,
+				  uint8_t table_type, uint64_t folderID,
+				  void **table_object)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->table_init(mem_ctx, priv_data->backend, username, table_type, folderID, table_object);
+}
+
+static enum MAPISTATUS table_set_sort_order(struct openchangedb_context *self,
+					    void *table_object,
+					    struct SSortOrderSet *lpSortCriteria)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->table_set_sort_order(priv_data->backend, table_object, lpSortCriteria);
+}
+
+static enum MAPISTATUS table_set_restrictions(struct openchangedb_context *self,
+					      void *table_object,
+					      struct mapi_SRestriction *res)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->table_set_restrictions(priv_data->backend, table_object, res);
+}
+
+static enum MAPISTATUS table_get_property(TALLOC_CTX *mem_ctx,
+					  struct openchangedb_context *self,
+					  void *table_object,
+					  enum MAPITAGS proptag, uint32_t pos,
+					  bool live_filtered, void **data)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->table_get_property(mem_ctx, priv_data->backend, table_object, proptag, pos, live_filtered, data);
+}
+
+static enum MAPISTATUS message_create(TALLOC_CTX *mem_ctx,
+				      struct openchangedb_context *self,
+				      const char *username,
+				      uint64_t messageID, uint64_t folderID,
+				      bool fai, void **message_object)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->message_create(mem_ctx, priv_data->backend, username, messageID, folderID, fai, message_object);
+}
+
+static enum MAPISTATUS message_open(TALLOC_CTX *mem_ctx,
+				    struct openchangedb_context *self,
+				    const char *username,
+				    uint64_t messageID, uint64_t folderID,
+				    void **message_object, void **msgp)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->message_open(mem_ctx, priv_data->backend, username, messageID, folderID, message_object, msgp);
+}
+
+static enum MAPISTATUS message_get_property(TALLOC_CTX *mem_ctx,
+					    struct openchangedb_context *self,
+					    void *message_object,
+					    uint32_t proptag, void **data)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return priv_data->backend->message_get_property(mem_ctx, priv_data->backend, message_object, proptag, data);
+}
+
+static enum MAPISTATUS table_get_properties(TALLOC_CTX *mem_ctx,
+					    struct openchangedb_context *self,
+					    void *table_object,
+					    struct SPropTagArray *proptags,
+					    uint32_t pos, uint32_t count,
+					    bool live_filtered, void ***data,
+					    enum MAPISTATUS **retvals)
+{
+	struct ocdb_cache_data *priv_data = _ocdb_cache_data_get(self);
+
+	return openchangedb_table_get_properties(mem_ctx, priv_data->backend, table_object, proptags, pos, count, live_filtered, data, retvals);
+}
+
+// ^ pass-through -------------------------------------------------------------
+
+static int ocdb_cache_destructor(struct ocdb_cache_data *priv_data)
+{
+	ocdb_cache_report(priv_data);
+	htable_clear(&priv_data->entries);
+	htable_clear(&priv_data->folders);
+
+	return 0;
+}
+
+/**
+   \details Initialize a caching OpenChangeDB context on top of
+   another backend
+
+   \param mem_ctx pointer to the memory context
+   \param max_entries number of entries after which the cache is emptied
+   \param backend the OpenChangeDB context to cache
+   \param ctx pointer to the OpenChangeDB context the function returns
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_cache_initialize(TALLOC_CTX *mem_ctx,
+						       uint32_t max_entries,
+						       struct openchangedb_context *backend,
+						       struct openchangedb_context **ctx)
+{
+	struct openchangedb_context	*oc_ctx;
+	struct ocdb_cache_data		*data;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!backend, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!ctx, MAPI_E_INVALID_PARAMETER, NULL);
+
+	oc_ctx = talloc_zero(mem_ctx, struct openchangedb_context);
+	OPENCHANGE_RETVAL_IF(oc_ctx == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+	data = talloc_zero(oc_ctx, struct ocdb_cache_data);
+	OPENCHANGE_RETVAL_IF(data == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+
+	data->backend = backend;
+	data->max_entries = max_entries ? max_entries : OPENCHANGEDB_CACHE_MAX_ENTRIES;
+	data->entries_ctx = talloc_named(data, 0, "ocdb_cache_entries");
+	OPENCHANGE_RETVAL_IF(data->entries_ctx == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+	htable_init(&data->entries, _entries_rehash, NULL);
+	htable_init(&data->folders, _folders_rehash, NULL);
+	talloc_set_destructor(data, ocdb_cache_destructor);
+
+	oc_ctx->data = data;
+
+	// Initialize struct with function pointers
+	oc_ctx->backend_type = talloc_strdup(oc_ctx, "cache_module");
+	OPENCHANGE_RETVAL_IF(oc_ctx->backend_type == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+
+	oc_ctx->get_new_changeNumber = get_new_changeNumber;
+	oc_ctx->get_new_changeNumbers = get_new_changeNumbers;
+	oc_ctx->get_next_changeNumber = get_next_changeNumber;
+	oc_ctx->release_changeNumbers = release_changeNumbers;
+	oc_ctx->get_SystemFolderID = get_SystemFolderID;
+	oc_ctx->get_SpecialFolderID = get_SpecialFolderID;
+	oc_ctx->get_PublicFolderID = get_PublicFolderID;
+	oc_ctx->get_distinguishedName = get_distinguishedName;
+	oc_ctx->get_MailboxGuid = get_MailboxGuid;
+	oc_ctx->get_MailboxReplica = get_MailboxReplica;
+	oc_ctx->get_PublicFolderReplica = get_PublicFolderReplica;
+	oc_ctx->get_parent_fid = get_parent_fid;
+	oc_ctx->get_MAPIStoreURIs = get_MAPIStoreURIs;
+	oc_ctx->get_mapistoreURI = get_mapistoreURI;
+	oc_ctx->set_mapistoreURI = set_mapistoreURI;
+	oc_ctx->get_fid = get_fid;
+	oc_ctx->get_ReceiveFolder = get_ReceiveFolder;
+	oc_ctx->get_ReceiveFolderTable = get_ReceiveFolderTable;
+	oc_ctx->get_TransportFolder = get_TransportFolder;
+	oc_ctx->lookup_folder_property = lookup_folder_property;
+	oc_ctx->set_folder_properties = set_folder_properties;
+	oc_ctx->get_folder_property = get_folder_property;
+	oc_ctx->get_folder_count = get_folder_count;
+	oc_ctx->get_message_count = get_message_count;
+	oc_ctx->get_system_idx = get_system_idx;
+	oc_ctx->set_system_idx = set_system_idx;
+	oc_ctx->get_table_property = get_table_property;
+	oc_ctx->get_fid_by_name = get_fid_by_name;
+	oc_ctx->get_mid_by_subject = get_mid_by_subject;
+	oc_ctx->set_ReceiveFolder = set_ReceiveFolder;
+	oc_ctx->create_mailbox = create_mailbox;
+	oc_ctx->create_folder = create_folder;
+	oc_ctx->delete_folder = delete_folder;
+	oc_ctx->get_fid_from_partial_uri = get_fid_from_partial_uri;
+	oc_ctx->get_users_from_partial_uri = get_users_from_partial_uri;
+
+	oc_ctx->table_init = table_init;
+	oc_ctx->table_set_sort_order = table_set_sort_order;
+	oc_ctx->table_set_restrictions = table_set_restrictions;
+	oc_ctx->table_get_property = table_get_property;
+	oc_ctx->table_get_properties = table_get_properties;
+
+	oc_ctx->message_create = message_create;
+	oc_ctx->message_save = message_save;
+	oc_ctx->message_open = message_open;
+	oc_ctx->message_get_property = message_get_property;
+	oc_ctx->message_set_properties = message_set_properties;
+
+	oc_ctx->transaction_start = transaction_start;
+	oc_ctx->transaction_commit = transaction_commit;
+
+	oc_ctx->get_new_public_folderID = get_new_public_folderID;
+	oc_ctx->is_public_folder_id = is_public_folder_id;
+
+	oc_ctx->get_indexing_url = get_indexing_url;
+	oc_ctx->set_locale = set_locale;
+	oc_ctx->get_folders_names = get_folders_names;
+
+	oc_ctx->replica_mapping_guid_to_replid = replica_mapping_guid_to_replid;
+	oc_ctx->replica_mapping_replid_to_guid = replica_mapping_replid_to_guid;
+
+	*ctx = oc_ctx;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Retrieve the statistics of a caching OpenChangeDB context
+
+   \param oc_ctx pointer to the OpenChangeDB context
+   \param stats pointer to the statistics the function returns
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_INVALID_PARAMETER if
+   oc_ctx is not a cache context
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_cache_get_stats(struct openchangedb_context *oc_ctx,
+						      struct openchangedb_cache_stats *stats)
+{
+	struct ocdb_cache_data	*priv_data;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!oc_ctx || !stats, MAPI_E_INVALID_PARAMETER, NULL);
+	priv_data = talloc_get_type(oc_ctx->data, struct ocdb_cache_data);
+	OPENCHANGE_RETVAL_IF(!priv_data, MAPI_E_INVALID_PARAMETER, NULL);
+
+	*stats = priv_data->stats;
+
+	return MAPI_E_SUCCESS;
+}
@@ -952,32 +952,71 @@ static enum MAPISTATUS get_ReceiveFolderTable(TALLOC_CTX *mem_ctx,
 	return MAPI_E_SUCCESS;
 }
 
-static enum MAPISTATUS get_new_changeNumber(struct openchangedb_context *self, const char *username, uint64_t *cn)
+/**
+   \details Atomically reserve a range of change numbers
+
+   The GlobalCount is read and updated within a single ldb transaction
+   so concurrent writers cannot be handed the same range.
+
+   \param ldb_ctx pointer to the openchange LDB context
+   \param count number of change numbers to reserve
+   \param first pointer to the first reserved counter value
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS reserve_server_change_numbers(struct ldb_context *ldb_ctx,
+						     uint64_t count,
+						     uint64_t *first)
 {
 	TALLOC_CTX		*mem_ctx;
 	int			ret;
 	struct ldb_result	*res;
 	struct ldb_message	*msg;
 	const char * const	attrs[] = { "*", NULL };
-	struct ldb_context	*ldb_ctx = ((struct ldb_backend_contexts *)self->data)->ldb_ctx;;
+
+	OPENCHANGE_RETVAL_IF(!count, MAPI_E_INVALID_PARAMETER, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "reserve_server_change_numbers");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	ret = ldb_transaction_start(ldb_ctx);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_CALL_FAILED, mem_ctx);
 
 	/* Get the current GlobalCount */
-	mem_ctx = talloc_named(NULL, 0, "get_next_changeNumber");
 	ret = ldb_search(ldb_ctx, mem_ctx, &res, ldb_get_root_basedn(ldb_ctx),
 			 LDB_SCOPE_SUBTREE, attrs, "(objectClass=server)");
-	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || !res->count, MAPI_E_NOT_FOUND, mem_ctx);
+	if (ret != LDB_SUCCESS || !res->count) {
+		ldb_transaction_cancel(ldb_ctx);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, mem_ctx);
+	}
 
-	*cn = ldb_msg_find_attr_as_uint64(res->msgs[0], "ChangeNumber", 1);
+	*first = ldb_msg_find_attr_as_uint64(res->msgs[0], "ChangeNumber", 1);
 
 	/* Update GlobalCount value */
 	msg = ldb_msg_new(mem_ctx);
 	msg->dn = ldb_dn_copy(msg, ldb_msg_find_attr_as_dn(ldb_ctx, mem_ctx, res->msgs[0], "distinguishedName"));
-	ldb_msg_add_fmt(msg, "ChangeNumber", "%"PRIu64, ((*cn) + 1));
+	ldb_msg_add_fmt(msg, "ChangeNumber", "%"PRIu64, (*first + count));
 	msg->elements[0].flags = LDB_FLAG_MOD_REPLACE;
 	ret = ldb_modify(ldb_ctx, msg);
-	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_NO_SUPPORT, mem_ctx);
+	if (ret != LDB_SUCCESS) {
+		ldb_transaction_cancel(ldb_ctx);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NO_SUPPORT, mem_ctx);
+	}
+
+	ret = ldb_transaction_commit(ldb_ctx);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_CALL_FAILED, mem_ctx);
 
 	talloc_free(mem_ctx);
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_new_changeNumber(struct openchangedb_context *self, const char *username, uint64_t *cn)
+{
+	enum MAPISTATUS		retval;
+	struct ldb_context	*ldb_ctx = ((struct ldb_backend_contexts *)self->data)->ldb_ctx;
+
+	retval = reserve_server_change_numbers(ldb_ctx, 1, cn);
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
 	*cn = (exchange_globcnt(*cn) << 16) | 0x0001;
 
@@ -990,42 +1029,25 @@ static enum MAPISTATUS get_new_changeNumbers(struct openchangedb_context *self,
 					     uint64_t max,
 					     struct UI8Array_r **cns_p)
 {
-	TALLOC_CTX		*local_mem_ctx;
-	int			ret;
-	struct ldb_result	*res;
-	struct ldb_message	*msg;
-	const char * const	attrs[] = { "*", NULL };
+	enum MAPISTATUS		retval;
 	uint64_t		cn, count;
 	struct UI8Array_r	*cns;
-	struct ldb_context	*ldb_ctx = ((struct ldb_backend_contexts *)self->data)->ldb_ctx;;
-
-	/* Get the current GlobalCount */
-	local_mem_ctx = talloc_named(NULL, 0, "get_new_changeNumber");
-	ret = ldb_search(ldb_ctx, local_mem_ctx, &res, ldb_get_root_basedn(ldb_ctx),
-			 LDB_SCOPE_SUBTREE, attrs, "(objectClass=server)");
-	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || !res->count, MAPI_E_NOT_FOUND, local_mem_ctx);
+	struct ldb_context	*ldb_ctx = ((struct ldb_backend_contexts *)self->data)->ldb_ctx;
 
-	cn = ldb_msg_find_attr_as_uint64(res->msgs[0], "ChangeNumber", 1);
+	retval = reserve_server_change_numbers(ldb_ctx, max, &cn);
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
-	cns = talloc_zero(local_mem_ctx, struct UI8Array_r);
+	cns = talloc_zero(mem_ctx, struct UI8Array_r);
+	OPENCHANGE_RETVAL_IF(!cns, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	cns->cValues = max;
 	cns->lpui8 = talloc_array(cns, uint64_t, max);
+	OPENCHANGE_RETVAL_IF(!cns->lpui8, MAPI_E_NOT_ENOUGH_MEMORY, cns);
 
 	for (count = 0; count < max; count++) {
 		cns->lpui8[count] = (exchange_globcnt(cn + count) << 16) | 0x0001;
 	}
 
-	/* Update GlobalCount value */
-	msg = ldb_msg_new(local_mem_ctx);
-	msg->dn = ldb_dn_copy(msg, ldb_msg_find_attr_as_dn(ldb_ctx, local_mem_ctx, res->msgs[0], "distinguishedName"));
-	ldb_msg_add_fmt(msg, "ChangeNumber", "%"PRIu64, (cn + max));
-	msg->elements[0].flags = LDB_FLAG_MOD_REPLACE;
-	ret = ldb_modify(ldb_ctx, msg);
-	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_NO_SUPPORT, local_mem_ctx);
-
 	*cns_p = cns;
-	(void) talloc_reference(mem_ctx, cns);
-	talloc_free(local_mem_ctx);
 
 	return MAPI_E_SUCCESS;
 }
@@ -1054,6 +1076,50 @@ static enum MAPISTATUS get_next_changeNumber(struct openchangedb_context *self,
 	return MAPI_E_SUCCESS;
 }
 
+static enum MAPISTATUS release_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t first, uint64_t end)
+{
+	TALLOC_CTX		*mem_ctx;
+	int			ret;
+	struct ldb_result	*res;
+	struct ldb_message	*msg;
+	const char * const	attrs[] = { "*", NULL };
+	struct ldb_context	*ldb_ctx = ((struct ldb_backend_contexts *)self->data)->ldb_ctx;
+
+	mem_ctx = talloc_named(NULL, 0, "release_changeNumbers");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	ret = ldb_transaction_start(ldb_ctx);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_CALL_FAILED, mem_ctx);
+
+	ret = ldb_search(ldb_ctx, mem_ctx, &res, ldb_get_root_basedn(ldb_ctx),
+			 LDB_SCOPE_SUBTREE, attrs, "(objectClass=server)");
+	if (ret != LDB_SUCCESS || !res->count) {
+		ldb_transaction_cancel(ldb_ctx);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_FOUND, mem_ctx);
+	}
+
+	/* Only rewind the GlobalCount if nobody reserved numbers since */
+	if (ldb_msg_find_attr_as_uint64(res->msgs[0], "ChangeNumber", 1) == exchange_globcnt(end >> 16)) {
+		msg = ldb_msg_new(mem_ctx);
+		msg->dn = ldb_dn_copy(msg, ldb_msg_find_attr_as_dn(ldb_ctx, mem_ctx, res->msgs[0], "distinguishedName"));
+		ldb_msg_add_fmt(msg, "ChangeNumber", "%"PRIu64, exchange_globcnt(first >> 16));
+		msg->elements[0].flags = LDB_FLAG_MOD_REPLACE;
+		ret = ldb_modify(ldb_ctx, msg);
+		if (ret != LDB_SUCCESS) {
+			ldb_transaction_cancel(ldb_ctx);
+			OPENCHANGE_RETVAL_ERR(MAPI_E_NO_SUPPORT, mem_ctx);
+		}
+	}
+
+	ret = ldb_transaction_commit(ldb_ctx);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS, MAPI_E_CALL_FAILED, mem_ctx);
+
+	talloc_free(mem_ctx);
+	return MAPI_E_SUCCESS;
+}
+
 static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 					   struct openchangedb_context *self,
 					   const char *username,
@@ -2671,6 +2737,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_ldb_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->get_new_changeNumber = get_new_changeNumber;
 	oc_ctx->get_new_changeNumbers = get_new_changeNumbers;
 	oc_ctx->get_next_changeNumber = get_next_changeNumber;
+	oc_ctx->release_changeNumbers = release_changeNumbers;
 	oc_ctx->get_SystemFolderID = get_SystemFolderID;
 	oc_ctx->get_SpecialFolderID = get_SpecialFolderID;
 	oc_ctx->get_PublicFolderID = get_PublicFolderID;
@@ -372,6 +372,22 @@ static enum MAPISTATUS get_next_changeNumber(struct openchangedb_context *self,
 	return retval;
 }
 
+static enum MAPISTATUS release_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t first, uint64_t end)
+{
+	enum MAPISTATUS retval;
+	struct ocdb_logger_data *priv_data = _ocdb_logger_data_get(self);
+
+	OC_DEBUG(priv_data->log_level, "%s[in]: username=[%s], first=[0x%016"PRIx64"], end=[0x%016"PRIx64"]",
+				     priv_data->log_prefix, username, first, end);
+	retval = priv_data->backend->release_changeNumbers(priv_data->backend, username, first, end);
+	OC_DEBUG(priv_data->log_level, "%s[out]: retval=[%s]",
+				     priv_data->log_prefix, mapi_get_errstr(retval));
+
+	return retval;
+}
+
 static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 					   struct openchangedb_context *self,
 					   const char *username,
@@ -796,6 +812,22 @@ static enum MAPISTATUS table_get_property(TALLOC_CTX *mem_ctx,
 	return retval;
 }
 
+static enum MAPISTATUS table_get_properties(TALLOC_CTX *mem_ctx,
+					    struct openchangedb_context *self,
+					    void *table_object,
+					    struct SPropTagArray *proptags,
+					    uint32_t pos, uint32_t count,
+					    bool live_filtered, void ***data,
+					    enum MAPISTATUS **retvals)
+{
+	enum MAPISTATUS retval;
+	struct ocdb_logger_data *priv_data = _ocdb_logger_data_get(self);
+
+	retval = openchangedb_table_get_properties(mem_ctx, priv_data->backend, table_object, proptags, pos, count, live_filtered, data, retvals);
+
+	return retval;
+}
+
 // ^ openchangedb table -------------------------------------------------------
 
 // v openchangedb message -----------------------------------------------------
@@ -905,6 +937,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_logger_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->get_new_changeNumber = get_new_changeNumber;
 	oc_ctx->get_new_changeNumbers = get_new_changeNumbers;
 	oc_ctx->get_next_changeNumber = get_next_changeNumber;
+	oc_ctx->release_changeNumbers = release_changeNumbers;
 	oc_ctx->get_SystemFolderID = get_SystemFolderID;
 	oc_ctx->get_SpecialFolderID = get_SpecialFolderID;
 	oc_ctx->get_PublicFolderID = get_PublicFolderID;
@@ -941,6 +974,7 @@ _PUBLIC_ enum MAPISTATUS openchangedb_logger_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->table_set_sort_order = table_set_sort_order;
 	oc_ctx->table_set_restrictions = table_set_restrictions;
 	oc_ctx->table_get_property = table_get_property;
+	oc_ctx->table_get_properties = table_get_properties;
 
 	oc_ctx->message_create = message_create;
 	oc_ctx->message_save = message_save;
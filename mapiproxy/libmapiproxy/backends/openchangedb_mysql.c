@@ -655,11 +655,10 @@ static enum MAPISTATUS get_mailbox_ids_by_name(MYSQL *conn,
 					       uint64_t *mailbox_folder_id,
 					       uint64_t *ou_id)
 {
-	TALLOC_CTX	*mem_ctx;
-	enum MAPISTATUS	retval;
-	char		*sql;
-	MYSQL_RES	*res;
-	MYSQL_ROW	row;
+	TALLOC_CTX		*mem_ctx;
+	enum MAPISTATUS		retval = MAPI_E_SUCCESS;
+	struct stmt_params	params;
+	const char		*row[3];
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_INVALID_PARAMETER, NULL);
@@ -668,20 +667,12 @@ static enum MAPISTATUS get_mailbox_ids_by_name(MYSQL *conn,
 	mem_ctx = talloc_named(NULL, 0, "get_mailbox_ids_by_name");
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 
-	sql = talloc_asprintf(mem_ctx,
+	stmt_params_init(&params);
+	stmt_bind_string(&params, username);
+	retval = status(stmt_select_row(mem_ctx, conn,
 		"SELECT m.id, m.folder_id, m.ou_id FROM mailboxes m "
-		"WHERE m.name = '%s'", _sql(mem_ctx, username));
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-
-	retval = status(select_without_fetch(conn, sql, &res));
+		"WHERE m.name = ?", &params, 3, row));
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
-	row = mysql_fetch_row(res);
-	if (row == NULL) {
-		OC_DEBUG(0, "Error getting user's mailbox `%s`: %s", sql,
-			  mysql_error(conn));
-		retval = MAPI_E_NOT_FOUND;
-		goto end;
-	}
 
 	if (mailbox_id) {
 		if (!convert_string_to_ull(row[0], mailbox_id)) {
@@ -702,7 +693,6 @@ static enum MAPISTATUS get_mailbox_ids_by_name(MYSQL *conn,
 		}
 	}
 end:
-	mysql_free_result(res);
 	talloc_free(mem_ctx);
 	return retval;
 }
@@ -807,11 +797,24 @@ static enum MAPISTATUS get_server_change_number(MYSQL *conn,
 }
 
 /**
-   \details Set the current change number field
+   \details Atomically reserve a range of change numbers
+
+   The counter is incremented and read back in a single statement:
+   LAST_INSERT_ID(expr) makes mysql_insert_id() return the new value
+   for this connection, so concurrent sessions can never be handed
+   the same range.
+
+   \param conn pointer to the MySQL connection
+   \param username the mailbox owner, used to find its server
+   \param count number of change numbers to reserve
+   \param first pointer to the first reserved counter value
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
  */
-static enum MAPISTATUS set_server_change_number(MYSQL *conn,
-						const char *username,
-						uint64_t change_number)
+static enum MAPISTATUS reserve_server_change_numbers(MYSQL *conn,
+						     const char *username,
+						     uint64_t count,
+						     uint64_t *first)
 {
 	TALLOC_CTX	*mem_ctx;
 	enum MAPISTATUS	retval;
@@ -820,22 +823,27 @@ static enum MAPISTATUS set_server_change_number(MYSQL *conn,
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
-	OPENCHANGE_RETVAL_IF(!change_number, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!count, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!first, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "set_server_change_number");
+	mem_ctx = talloc_named(NULL, 0, "reserve_server_change_numbers");
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 
 	sql = talloc_asprintf(mem_ctx,
 		"UPDATE servers s "
 		"JOIN mailboxes m ON m.ou_id = s.ou_id AND m.name = '%s' "
-		"SET s.change_number=%"PRIu64,
-		_sql(mem_ctx, username), change_number);
+		"SET s.change_number=LAST_INSERT_ID(s.change_number+%"PRIu64")",
+		_sql(mem_ctx, username), count);
 	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
 
 	retval = status(execute_query(conn, sql));
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
+	OPENCHANGE_RETVAL_IF(mysql_affected_rows(conn) == 0, MAPI_E_NOT_FOUND, mem_ctx);
+
+	*first = mysql_insert_id(conn) - count;
 
 	talloc_free(mem_ctx);
-	return retval;
+	return MAPI_E_SUCCESS;
 }
 
 static enum MAPISTATUS get_new_changeNumber(struct openchangedb_context *self,
@@ -848,10 +856,7 @@ static enum MAPISTATUS get_new_changeNumber(struct openchangedb_context *self,
 	conn = self->data;
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
-	retval = get_server_change_number(conn, username, cn);
-	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
-
-	retval = set_server_change_number(conn, username, (*cn) + 1);
+	retval = reserve_server_change_numbers(conn, username, 1, cn);
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
 	// Transform the number the way exchange protocol likes it
@@ -875,21 +880,20 @@ static enum MAPISTATUS get_new_changeNumbers(struct openchangedb_context *self,
 	conn = self->data;
 	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
 
-	retval = get_server_change_number(conn, username, &cn);
+	retval = reserve_server_change_numbers(conn, username, max, &cn);
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
 
 	// Transform the numbers the way exchange protocol likes it
 	cns = talloc_zero(mem_ctx, struct UI8Array_r);
+	OPENCHANGE_RETVAL_IF(!cns, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	cns->cValues = max;
 	cns->lpui8 = talloc_array(cns, uint64_t, max);
+	OPENCHANGE_RETVAL_IF(!cns->lpui8, MAPI_E_NOT_ENOUGH_MEMORY, cns);
 
 	for (count = 0; count < max; count++) {
 		cns->lpui8[count] = (exchange_globcnt(cn + count) << 16) | 0x0001;
 	}
 
-	retval = set_server_change_number(conn, username, cn + max);
-	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
-
 	*cns_p = cns;
 
 	return retval;
@@ -913,6 +917,37 @@ static enum MAPISTATUS get_next_changeNumber(struct openchangedb_context *self,
 	return retval;
 }
 
+static enum MAPISTATUS release_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t first, uint64_t end)
+{
+	TALLOC_CTX	*mem_ctx;
+	MYSQL		*conn;
+	enum MAPISTATUS	retval;
+	char		*sql;
+
+	conn = self->data;
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
+	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
+
+	mem_ctx = talloc_named(NULL, 0, "release_changeNumbers");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	/* Only rewind the counter if nobody reserved numbers since */
+	sql = talloc_asprintf(mem_ctx,
+		"UPDATE servers s "
+		"JOIN mailboxes m ON m.ou_id = s.ou_id AND m.name = '%s' "
+		"SET s.change_number=%"PRIu64" WHERE s.change_number=%"PRIu64,
+		_sql(mem_ctx, username),
+		exchange_globcnt(first >> 16), exchange_globcnt(end >> 16));
+	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	retval = status(execute_query(conn, sql));
+
+	talloc_free(mem_ctx);
+	return retval;
+}
+
 static char *_unknown_property(TALLOC_CTX *mem_ctx, uint32_t proptag)
 {
 	return talloc_asprintf(mem_ctx, "Unknown%.8x", proptag);
@@ -1114,12 +1149,14 @@ static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 {
 	TALLOC_CTX	*mem_ctx;
 	MYSQL		*conn;
-	enum MAPISTATUS	retval = MAPI_E_SUCCESS;
-	char		*sql = NULL;
-	uint64_t	mailbox_id = 0, mailbox_folder_id = 0;
-	uint64_t	*n = NULL;
-	const char	*attr, *value;
-
+	enum MAPISTATUS		retval = MAPI_E_SUCCESS;
+	const char		*sql = NULL;
+	struct stmt_params	params;
+	uint64_t		mailbox_id = 0, mailbox_folder_id = 0;
+	uint64_t		*n = NULL;
+	const char		*attr, *value;
+
+	stmt_params_init(&params);
 	mem_ctx = talloc_named(NULL, 0, "get_folder_property");
 	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 	conn = self->data;
@@ -1151,25 +1188,26 @@ static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 			goto end;
 		}
 
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT fp.value FROM folders_properties fp "
-			"JOIN folders f ON f.id = fp.folder_id "
-			"  AND f.folder_class = '"PUBLIC_FOLDER"'"
-			"  AND f.folder_id = %"PRIu64" "
-			"JOIN mailboxes m ON m.ou_id = f.ou_id"
-			"  AND m.name = '%s' "
-			"WHERE fp.name = '%s'",
-			fid, _sql(mem_ctx, username), _sql(mem_ctx, attr));
+		sql = "SELECT fp.value FROM folders_properties fp "
+		      "JOIN folders f ON f.id = fp.folder_id "
+		      "  AND f.folder_class = '"PUBLIC_FOLDER"'"
+		      "  AND f.folder_id = ? "
+		      "JOIN mailboxes m ON m.ou_id = f.ou_id"
+		      "  AND m.name = ? "
+		      "WHERE fp.name = ?";
+		stmt_bind_u64(&params, fid);
+		stmt_bind_string(&params, username);
+		stmt_bind_string(&params, attr);
 	} else {
 		// system folder
 		retval = get_mailbox_ids_by_name(conn, username, &mailbox_id, &mailbox_folder_id, NULL);
 		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 
 		if (mailbox_folder_id == fid) {
-			sql = talloc_asprintf(mem_ctx,
-				"SELECT mp.value FROM mailboxes_properties mp "
-				"WHERE mp.mailbox_id = %"PRIu64" AND mp.name = '%s'",
-				mailbox_id, _sql(mem_ctx, attr));
+			sql = "SELECT mp.value FROM mailboxes_properties mp "
+			      "WHERE mp.mailbox_id = ? AND mp.name = ?";
+			stmt_bind_u64(&params, mailbox_id);
+			stmt_bind_string(&params, attr);
 		} else if (proptag == PidTagParentFolderId) {
 			n = talloc_zero(parent_ctx, uint64_t);
 			OPENCHANGE_RETVAL_IF(!n, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
@@ -1178,17 +1216,17 @@ static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
 			*data = (void *) n;
 			goto end;
 		} else {
-			sql = talloc_asprintf(mem_ctx,
-				"SELECT fp.value FROM folders_properties fp "
-				"JOIN folders f ON f.id = fp.folder_id "
-				"  AND f.mailbox_id = %"PRIu64" "
-				"  AND f.folder_id = %"PRIu64" "
-				"WHERE fp.name = '%s'",
-				mailbox_id, fid, _sql(mem_ctx, attr));
+			sql = "SELECT fp.value FROM folders_properties fp "
+			      "JOIN folders f ON f.id = fp.folder_id "
+			      "  AND f.mailbox_id = ? "
+			      "  AND f.folder_id = ? "
+			      "WHERE fp.name = ?";
+			stmt_bind_u64(&params, mailbox_id);
+			stmt_bind_u64(&params, fid);
+			stmt_bind_string(&params, attr);
 		}
 	}
-	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-	retval = status(select_first_string(mem_ctx, conn, sql, &value));
+	retval = status(stmt_select_first_string(mem_ctx, conn, sql, &params, &value));
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 	// Transform string into the expected data type
 	*data = get_property_data(parent_ctx, proptag, value);
@@ -2412,15 +2450,26 @@ static enum MAPISTATUS replica_mapping_replid_to_guid(struct openchangedb_contex
 
 // v openchangedb table -------------------------------------------------------
 
+/* Properties of a row fetched in batch by table_get_properties */
+struct openchangedb_table_row_properties {
+	const char	**attrs;
+	size_t		attrs_count;
+	const char	**names;
+	const char	**values;
+	size_t		count;
+};
+
 struct openchangedb_table_message_row {
-	uint64_t	id;
-	uint64_t	mid;
-	char		*normalized_subject;
+	uint64_t					id;
+	uint64_t					mid;
+	char						*normalized_subject;
+	struct openchangedb_table_row_properties	*prefetched;
 };
 
 struct openchangedb_table_folder_row {
-	uint64_t	id;
-	uint64_t	fid;
+	uint64_t					id;
+	uint64_t					fid;
+	struct openchangedb_table_row_properties	*prefetched;
 };
 
 struct openchangedb_table_results {
@@ -3091,6 +3140,44 @@ static bool _table_check_match_restrictions(MYSQL *conn,
 	}
 }
 
+/**
+   \details Look up an attribute among the properties of a row fetched
+   in batch
+
+   \param props pointer to the prefetched row properties, may be NULL
+   \param attr the attribute name to look up
+   \param value pointer on the value to return, NULL if the row has no
+   such attribute
+
+   \return true if the attribute was part of the batch, otherwise false
+ */
+static bool _table_lookup_prefetched(struct openchangedb_table_row_properties *props,
+				     const char *attr, const char **value)
+{
+	size_t	i;
+	bool	requested = false;
+
+	if (!props) return false;
+
+	for (i = 0; i < props->attrs_count; i++) {
+		if (strcmp(props->attrs[i], attr) == 0) {
+			requested = true;
+			break;
+		}
+	}
+	if (!requested) return false;
+
+	*value = NULL;
+	for (i = 0; i < props->count; i++) {
+		if (strcmp(props->names[i], attr) == 0) {
+			*value = props->values[i];
+			break;
+		}
+	}
+
+	return true;
+}
+
 static const char *_table_fetch_message_attribute(MYSQL *conn,
 						  struct openchangedb_table *table,
 						  uint32_t pos,
@@ -3109,18 +3196,21 @@ static const char *_table_fetch_message_attribute(MYSQL *conn,
 	} else if (proptag == PidTagNormalizedSubject) {
 		value = talloc_strdup(table->res, row->normalized_subject);
 	} else {
-		const char	*attr;
-		char		*sql;
+		const char		*attr;
+		struct stmt_params	params;
 
 		attr = openchangedb_property_get_attribute(proptag);
 		if (!attr) return NULL;
-		sql = talloc_asprintf(NULL,
+		if (_table_lookup_prefetched(row->prefetched, attr, &value)) {
+			return value ? talloc_strdup(table->res, value) : NULL;
+		}
+		stmt_params_init(&params);
+		stmt_bind_u64(&params, row->id);
+		stmt_bind_string(&params, attr);
+		stmt_select_first_string(table->res, conn,
 			"SELECT mp.value FROM messages_properties mp "
-			"WHERE mp.message_id = %"PRIu64" AND mp.name = '%s'",
-			row->id, attr);
-		if (!sql) return NULL;
-		select_first_string(table->res, conn, sql, &value);
-		talloc_free(sql);
+			"WHERE mp.message_id = ? AND mp.name = ?",
+			&params, &value);
 	}
 
 	if (value) {
@@ -3146,18 +3236,21 @@ static const char *_table_fetch_folder_attribute(MYSQL *conn,
 	if (proptag == PidTagFolderId) {
 		value = talloc_asprintf(table->res, "%"PRIu64, row->fid);
 	} else {
-		const char	*attr;
-		char		*sql;
+		const char		*attr;
+		struct stmt_params	params;
 
 		attr = openchangedb_property_get_attribute(proptag);
 		if (!attr) return NULL;
-		sql = talloc_asprintf(NULL,
+		if (_table_lookup_prefetched(row->prefetched, attr, &value)) {
+			return value ? talloc_strdup(table->res, value) : NULL;
+		}
+		stmt_params_init(&params);
+		stmt_bind_u64(&params, row->id);
+		stmt_bind_string(&params, attr);
+		stmt_select_first_string(table->res, conn,
 			"SELECT fp.value FROM folders_properties fp "
-			"WHERE fp.folder_id = %"PRIu64" AND fp.name = '%s'",
-			row->id, attr);
-		if (!sql) return NULL;
-		select_first_string(table->res, conn, sql, &value);
-		talloc_free(sql);
+			"WHERE fp.folder_id = ? AND fp.name = ?",
+			&params, &value);
 	}
 
 	if (value) {
@@ -3248,6 +3341,233 @@ end:
 	return MAPI_E_SUCCESS;
 }
 
+/**
+   \details Fetch in a single query the properties of a window of
+   rows and store them in each row prefetched properties.
+
+   The prefetched properties are allocated on props_ctx and are only
+   meant to be used for the duration of a table_get_properties call:
+   the caller must release them with _table_release_prefetched.
+
+   \param props_ctx pointer to the memory context to allocate the
+   prefetched properties with
+   \param conn pointer to the MySQL connection
+   \param table pointer to the openchangedb table with fetched results
+   \param proptags pointer to the list of columns to fetch
+   \param pos position of the first row of the window
+   \param count number of rows in the window
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS _table_prefetch_rows(TALLOC_CTX *props_ctx,
+					    MYSQL *conn,
+					    struct openchangedb_table *table,
+					    struct SPropTagArray *proptags,
+					    uint32_t pos, uint32_t count)
+{
+	TALLOC_CTX					*mem_ctx;
+	struct openchangedb_table_results		*results = table->res;
+	struct openchangedb_table_row_properties	**props;
+	const char					**attrs;
+	size_t						attrs_count = 0;
+	const char					*attr;
+	char						*sql, *ids_sql, *names_sql;
+	MYSQL_RES					*res = NULL;
+	MYSQL_ROW					row;
+	enum MAPISTATUS					retval = MAPI_E_SUCCESS;
+	uint64_t					id, *ids;
+	uint32_t					i, j;
+	bool						is_message;
+
+	if (!count) return MAPI_E_SUCCESS;
+
+	mem_ctx = talloc_named(NULL, 0, "_table_prefetch_rows");
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	is_message = table->table_type == 0x3 || table->table_type == 0x2;
+
+	/* Step 1. Build the list of attributes stored in properties tables */
+	attrs = talloc_zero_array(props_ctx, const char *, proptags->cValues);
+	OPENCHANGE_RETVAL_IF(!attrs, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	names_sql = talloc_strdup(mem_ctx, "");
+	OPENCHANGE_RETVAL_IF(!names_sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	for (i = 0; i < proptags->cValues; i++) {
+		attr = openchangedb_property_get_attribute(proptags->aulPropTag[i]);
+		if (!attr) continue;
+		for (j = 0; j < attrs_count; j++) {
+			if (strcmp(attrs[j], attr) == 0) break;
+		}
+		if (j < attrs_count) continue;
+		attrs[attrs_count] = attr;
+		names_sql = talloc_asprintf_append(names_sql, "%s'%s'", attrs_count ? "," : "",
+						   _sql(mem_ctx, attr));
+		OPENCHANGE_RETVAL_IF(!names_sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+		attrs_count++;
+	}
+	if (!attrs_count) {
+		talloc_free(mem_ctx);
+		return MAPI_E_SUCCESS;
+	}
+
+	/* Step 2. Build the list of row ids and attach their properties */
+	ids = talloc_array(mem_ctx, uint64_t, count);
+	OPENCHANGE_RETVAL_IF(!ids, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	props = talloc_array(mem_ctx, struct openchangedb_table_row_properties *, count);
+	OPENCHANGE_RETVAL_IF(!props, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	ids_sql = talloc_strdup(mem_ctx, "");
+	OPENCHANGE_RETVAL_IF(!ids_sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	for (i = 0; i < count; i++) {
+		props[i] = talloc_zero(props_ctx, struct openchangedb_table_row_properties);
+		OPENCHANGE_RETVAL_IF(!props[i], MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+		props[i]->attrs = attrs;
+		props[i]->attrs_count = attrs_count;
+		if (is_message) {
+			ids[i] = results->messages[pos + i]->id;
+			results->messages[pos + i]->prefetched = props[i];
+		} else {
+			ids[i] = results->folders[pos + i]->id;
+			results->folders[pos + i]->prefetched = props[i];
+		}
+		ids_sql = talloc_asprintf_append(ids_sql, "%s%"PRIu64, i ? "," : "", ids[i]);
+		OPENCHANGE_RETVAL_IF(!ids_sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	}
+
+	/* Step 3. Fetch rows x columns in one query */
+	if (is_message) {
+		sql = talloc_asprintf(mem_ctx,
+			"SELECT mp.message_id, mp.name, mp.value FROM messages_properties mp "
+			"WHERE mp.message_id IN (%s) AND mp.name IN (%s)",
+			ids_sql, names_sql);
+	} else {
+		sql = talloc_asprintf(mem_ctx,
+			"SELECT fp.folder_id, fp.name, fp.value FROM folders_properties fp "
+			"WHERE fp.folder_id IN (%s) AND fp.name IN (%s)",
+			ids_sql, names_sql);
+	}
+	OPENCHANGE_RETVAL_IF(!sql, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	retval = status(select_without_fetch(conn, sql, &res));
+	if (retval == MAPI_E_NOT_FOUND) {
+		/* None of the rows has any of the columns */
+		talloc_free(mem_ctx);
+		return MAPI_E_SUCCESS;
+	}
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
+
+	/* Step 4. Dispatch values to their row */
+	while ((row = mysql_fetch_row(res)) != NULL) {
+		if (!convert_string_to_ull(row[0], &id)) {
+			OC_DEBUG(0, "Error converting id of prefetched row");
+			continue;
+		}
+		for (i = 0; i < count; i++) {
+			if (ids[i] == id) break;
+		}
+		if (i == count) continue;
+
+		props[i]->names = talloc_realloc(props[i], props[i]->names, const char *, props[i]->count + 1);
+		props[i]->values = talloc_realloc(props[i], props[i]->values, const char *, props[i]->count + 1);
+		if (!props[i]->names || !props[i]->values) {
+			retval = MAPI_E_NOT_ENOUGH_MEMORY;
+			goto end;
+		}
+		props[i]->names[props[i]->count] = talloc_strdup(props[i], row[1]);
+		props[i]->values[props[i]->count] = talloc_strdup(props[i], row[2] ? row[2] : "");
+		props[i]->count++;
+	}
+end:
+	mysql_free_result(res);
+	talloc_free(mem_ctx);
+	return retval;
+}
+
+/**
+   \details Detach the prefetched properties of a window of rows so
+   later lookups go back to the database and never see stale values
+
+   \param table pointer to the openchangedb table with fetched results
+   \param pos position of the first row of the window
+   \param count number of rows in the window
+ */
+static void _table_release_prefetched(struct openchangedb_table *table,
+				      uint32_t pos, uint32_t count)
+{
+	struct openchangedb_table_results	*results = table->res;
+	uint32_t				i;
+
+	for (i = 0; i < count; i++) {
+		if (table->table_type == 0x3 || table->table_type == 0x2) {
+			results->messages[pos + i]->prefetched = NULL;
+		} else {
+			results->folders[pos + i]->prefetched = NULL;
+		}
+	}
+}
+
+static enum MAPISTATUS table_get_properties(TALLOC_CTX *mem_ctx,
+					    struct openchangedb_context *self,
+					    void *_table,
+					    struct SPropTagArray *proptags,
+					    uint32_t pos, uint32_t count,
+					    bool live_filtered, void ***datap,
+					    enum MAPISTATUS **retvalsp)
+{
+	struct openchangedb_table	*table = (struct openchangedb_table *)_table;
+	enum MAPISTATUS			retval;
+	MYSQL				*conn;
+	TALLOC_CTX			*props_ctx;
+	void				**data;
+	enum MAPISTATUS			*retvals;
+	uint32_t			i, j;
+
+	conn = self->data;
+	OPENCHANGE_RETVAL_IF(!conn, MAPI_E_BAD_VALUE, NULL);
+
+	/* Fetch results */
+	if (!table->res) {
+		retval = _table_fetch_results(conn, table, live_filtered);
+		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
+	}
+
+	// Ensure the window is within search results range
+	OPENCHANGE_RETVAL_IF(pos >= table->res->count, MAPI_E_INVALID_OBJECT, NULL);
+	if (count > table->res->count - pos) {
+		count = table->res->count - pos;
+	}
+
+	props_ctx = talloc_named(NULL, 0, "table_get_properties");
+	OPENCHANGE_RETVAL_IF(!props_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	retval = _table_prefetch_rows(props_ctx, conn, table, proptags, pos, count);
+	if (retval != MAPI_E_SUCCESS) goto end;
+
+	data = talloc_zero_array(mem_ctx, void *, count * proptags->cValues);
+	retvals = talloc_zero_array(data, enum MAPISTATUS, count * proptags->cValues);
+	if (!data || !retvals) {
+		talloc_free(data);
+		retval = MAPI_E_NOT_ENOUGH_MEMORY;
+		goto end;
+	}
+
+	/* Cells are served from the prefetched row properties */
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < proptags->cValues; j++) {
+			retvals[i * proptags->cValues + j] =
+				table_get_property(data, self, table, proptags->aulPropTag[j], pos + i,
+						   live_filtered, &data[i * proptags->cValues + j]);
+		}
+	}
+
+	*datap = data;
+	*retvalsp = retvals;
+
+end:
+	_table_release_prefetched(table, pos, count);
+	talloc_free(props_ctx);
+
+	return retval;
+}
+
 // ^ openchangedb table -------------------------------------------------------
 
 // v openchangedb message -----------------------------------------------------
@@ -3867,6 +4187,7 @@ enum MAPISTATUS openchangedb_mysql_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->get_new_changeNumber = get_new_changeNumber;
 	oc_ctx->get_new_changeNumbers = get_new_changeNumbers;
 	oc_ctx->get_next_changeNumber = get_next_changeNumber;
+	oc_ctx->release_changeNumbers = release_changeNumbers;
 	oc_ctx->get_SystemFolderID = get_SystemFolderID;
 	oc_ctx->get_SpecialFolderID = get_SpecialFolderID;
 	oc_ctx->get_PublicFolderID = get_PublicFolderID;
@@ -3903,6 +4224,7 @@ enum MAPISTATUS openchangedb_mysql_initialize(TALLOC_CTX *mem_ctx,
 	oc_ctx->table_set_sort_order = table_set_sort_order;
 	oc_ctx->table_set_restrictions = table_set_restrictions;
 	oc_ctx->table_get_property = table_get_property;
+	oc_ctx->table_get_properties = table_get_properties;
 
 	oc_ctx->message_create = message_create;
 	oc_ctx->message_save = message_save;
@@ -0,0 +1,1461 @@
+/*
+   OpenChange Server implementation
+
+   OpenChangeDB latency profiling backend
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file openchangedb_profiler.c
+
+   \brief Latency profiling decorator for OpenChangeDB backends
+
+   Every call is forwarded to the decorated backend and its latency
+   recorded in a per operation histogram. Buckets are log-linear: each
+   power of two is split in OCDB_PROFILER_SUB_BUCKETS linear buckets,
+   which bounds the relative error of the reported percentiles to
+   12.5% whatever the magnitude.
+
+   Histograms are written as a JSON document to
+   <prefix>.<pid>.json every dump_interval seconds, when the context
+   is released and on demand with openchangedb_profiler_snapshot().
+   Running processes also write one when the modification time of the
+   <prefix>.snapshot control file changes (e.g. after touching it),
+   which is checked at most once per second.
+ */
+
+#include "openchangedb_profiler.h"
+
+#include "../libmapiproxy.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define	OCDB_PROFILER_SUB_BITS		3
+#define	OCDB_PROFILER_SUB_BUCKETS	(1 << OCDB_PROFILER_SUB_BITS)
+/* Latencies above 2^40 ns (about 18 minutes) go to the last bucket */
+#define	OCDB_PROFILER_MAX_BITS		40
+#define	OCDB_PROFILER_BUCKETS		((OCDB_PROFILER_MAX_BITS - OCDB_PROFILER_SUB_BITS + 2) * OCDB_PROFILER_SUB_BUCKETS)
+
+enum ocdb_profiler_op {
+	OCDB_PROFILER_GET_NEW_CHANGENUMBER = 0,
+	OCDB_PROFILER_GET_NEW_CHANGENUMBERS,
+	OCDB_PROFILER_GET_NEXT_CHANGENUMBER,
+	OCDB_PROFILER_RELEASE_CHANGENUMBERS,
+	OCDB_PROFILER_GET_SPECIALFOLDERID,
+	OCDB_PROFILER_GET_SYSTEMFOLDERID,
+	OCDB_PROFILER_GET_PUBLICFOLDERID,
+	OCDB_PROFILER_GET_DISTINGUISHEDNAME,
+	OCDB_PROFILER_GET_MAILBOXGUID,
+	OCDB_PROFILER_GET_MAILBOXREPLICA,
+	OCDB_PROFILER_GET_PUBLICFOLDERREPLICA,
+	OCDB_PROFILER_GET_PARENT_FID,
+	OCDB_PROFILER_GET_MAPISTOREURIS,
+	OCDB_PROFILER_GET_MAPISTOREURI,
+	OCDB_PROFILER_SET_MAPISTOREURI,
+	OCDB_PROFILER_GET_FID,
+	OCDB_PROFILER_GET_RECEIVEFOLDER,
+	OCDB_PROFILER_GET_RECEIVEFOLDERTABLE,
+	OCDB_PROFILER_GET_TRANSPORTFOLDER,
+	OCDB_PROFILER_LOOKUP_FOLDER_PROPERTY,
+	OCDB_PROFILER_SET_FOLDER_PROPERTIES,
+	OCDB_PROFILER_GET_FOLDER_PROPERTY,
+	OCDB_PROFILER_GET_FOLDER_COUNT,
+	OCDB_PROFILER_GET_MESSAGE_COUNT,
+	OCDB_PROFILER_GET_SYSTEM_IDX,
+	OCDB_PROFILER_SET_SYSTEM_IDX,
+	OCDB_PROFILER_GET_TABLE_PROPERTY,
+	OCDB_PROFILER_GET_FID_BY_NAME,
+	OCDB_PROFILER_GET_MID_BY_SUBJECT,
+	OCDB_PROFILER_SET_RECEIVEFOLDER,
+	OCDB_PROFILER_CREATE_MAILBOX,
+	OCDB_PROFILER_CREATE_FOLDER,
+	OCDB_PROFILER_DELETE_FOLDER,
+	OCDB_PROFILER_GET_FID_FROM_PARTIAL_URI,
+	OCDB_PROFILER_GET_USERS_FROM_PARTIAL_URI,
+	OCDB_PROFILER_TABLE_INIT,
+	OCDB_PROFILER_TABLE_SET_SORT_ORDER,
+	OCDB_PROFILER_TABLE_SET_RESTRICTIONS,
+	OCDB_PROFILER_TABLE_GET_PROPERTY,
+	OCDB_PROFILER_TABLE_GET_PROPERTIES,
+	OCDB_PROFILER_MESSAGE_CREATE,
+	OCDB_PROFILER_MESSAGE_SAVE,
+	OCDB_PROFILER_MESSAGE_OPEN,
+	OCDB_PROFILER_MESSAGE_GET_PROPERTY,
+	OCDB_PROFILER_MESSAGE_SET_PROPERTIES,
+	OCDB_PROFILER_TRANSACTION_START,
+	OCDB_PROFILER_TRANSACTION_COMMIT,
+	OCDB_PROFILER_GET_NEW_PUBLIC_FOLDERID,
+	OCDB_PROFILER_IS_PUBLIC_FOLDER_ID,
+	OCDB_PROFILER_GET_INDEXING_URL,
+	OCDB_PROFILER_SET_LOCALE,
+	OCDB_PROFILER_GET_FOLDERS_NAMES,
+	OCDB_PROFILER_REPLICA_MAPPING_GUID_TO_REPLID,
+	OCDB_PROFILER_REPLICA_MAPPING_REPLID_TO_GUID,
+	OCDB_PROFILER_OPERATIONS
+};
+
+static const char *ocdb_profiler_op_names[OCDB_PROFILER_OPERATIONS] = {
+	"get_new_changeNumber",
+	"get_new_changeNumbers",
+	"get_next_changeNumber",
+	"release_changeNumbers",
+	"get_SpecialFolderID",
+	"get_SystemFolderID",
+	"get_PublicFolderID",
+	"get_distinguishedName",
+	"get_MailboxGuid",
+	"get_MailboxReplica",
+	"get_PublicFolderReplica",
+	"get_parent_fid",
+	"get_MAPIStoreURIs",
+	"get_mapistoreURI",
+	"set_mapistoreURI",
+	"get_fid",
+	"get_ReceiveFolder",
+	"get_ReceiveFolderTable",
+	"get_TransportFolder",
+	"lookup_folder_property",
+	"set_folder_properties",
+	"get_folder_property",
+	"get_folder_count",
+	"get_message_count",
+	"get_system_idx",
+	"set_system_idx",
+	"get_table_property",
+	"get_fid_by_name",
+	"get_mid_by_subject",
+	"set_ReceiveFolder",
+	"create_mailbox",
+	"create_folder",
+	"delete_folder",
+	"get_fid_from_partial_uri",
+	"get_users_from_partial_uri",
+	"table_init",
+	"table_set_sort_order",
+	"table_set_restrictions",
+	"table_get_property",
+	"table_get_properties",
+	"message_create",
+	"message_save",
+	"message_open",
+	"message_get_property",
+	"message_set_properties",
+	"transaction_start",
+	"transaction_commit",
+	"get_new_public_folderID",
+	"is_public_folder_id",
+	"get_indexing_url",
+	"set_locale",
+	"get_folders_names",
+	"replica_mapping_guid_to_replid",
+	"replica_mapping_replid_to_guid",
+};
+
+struct ocdb_profiler_histogram {
+	struct openchangedb_profiler_stats	stats;
+	uint64_t				buckets[OCDB_PROFILER_BUCKETS];
+};
+
+struct ocdb_profiler_data {
+	struct openchangedb_context	*backend;
+	const char			*dump_prefix;
+	uint32_t			dump_interval;
+	time_t				last_dump;	/* CLOCK_MONOTONIC seconds */
+	const char			*trigger_path;
+	time_t				trigger_mtime;
+	time_t				last_trigger_check;	/* CLOCK_MONOTONIC seconds */
+	struct ocdb_profiler_histogram	histograms[OCDB_PROFILER_OPERATIONS];
+};
+
+static struct ocdb_profiler_data * _ocdb_profiler_data_get(struct openchangedb_context *self)
+{
+	return talloc_get_type(self->data, struct ocdb_profiler_data);
+}
+
+// v histograms ---------------------------------------------------------------
+
+static uint32_t ocdb_profiler_bucket(uint64_t ns)
+{
+	uint32_t	msb;
+
+	if (ns < OCDB_PROFILER_SUB_BUCKETS) {
+		return ns;
+	}
+
+	msb = 63 - __builtin_clzll(ns);
+	if (msb > OCDB_PROFILER_MAX_BITS) {
+		return OCDB_PROFILER_BUCKETS - 1;
+	}
+
+	return (msb - OCDB_PROFILER_SUB_BITS + 1) * OCDB_PROFILER_SUB_BUCKETS +
+		((ns >> (msb - OCDB_PROFILER_SUB_BITS)) & (OCDB_PROFILER_SUB_BUCKETS - 1));
+}
+
+/* Lowest latency, in nanoseconds, recorded in a bucket */
+static uint64_t ocdb_profiler_bucket_low(uint32_t bucket)
+{
+	uint32_t	shift;
+
+	if (bucket < OCDB_PROFILER_SUB_BUCKETS) {
+		return bucket;
+	}
+
+	shift = bucket / OCDB_PROFILER_SUB_BUCKETS - 1;
+	return (uint64_t)(OCDB_PROFILER_SUB_BUCKETS + bucket % OCDB_PROFILER_SUB_BUCKETS) << shift;
+}
+
+/**
+   \details Retrieve a percentile from a histogram
+
+   \param histogram pointer to the histogram
+   \param percentile the percentile to compute, between 0 and 100
+
+   \return the lower bound in nanoseconds of the bucket holding the
+   percentile, 0 if the histogram is empty
+ */
+static uint64_t ocdb_profiler_percentile(const struct ocdb_profiler_histogram *histogram, double percentile)
+{
+	uint64_t	rank;
+	uint64_t	seen = 0;
+	uint32_t	i;
+
+	if (!histogram->stats.count) {
+		return 0;
+	}
+
+	rank = (uint64_t)(histogram->stats.count * percentile / 100.0);
+	if (rank >= histogram->stats.count) {
+		rank = histogram->stats.count - 1;
+	}
+
+	for (i = 0; i < OCDB_PROFILER_BUCKETS; i++) {
+		seen += histogram->buckets[i];
+		if (seen > rank) {
+			return ocdb_profiler_bucket_low(i);
+		}
+	}
+
+	return histogram->stats.max_ns;
+}
+
+/**
+   \details Write the histograms as a JSON document
+
+   \param priv_data pointer to the profiler private data
+   \param stream the stream to write to
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_CALL_FAILED
+ */
+static enum MAPISTATUS ocdb_profiler_write(struct ocdb_profiler_data *priv_data, FILE *stream)
+{
+	const struct ocdb_profiler_histogram	*histogram;
+	bool					first = true;
+	bool					first_bucket;
+	uint32_t				op;
+	uint32_t				i;
+
+	fprintf(stream, "{\n  \"pid\": %d,\n  \"timestamp\": %ld,\n  \"operations\": {",
+		(int) getpid(), (long) time(NULL));
+
+	for (op = 0; op < OCDB_PROFILER_OPERATIONS; op++) {
+		histogram = &priv_data->histograms[op];
+		if (!histogram->stats.count) continue;
+
+		fprintf(stream, "%s\n    \"%s\": {\"count\": %"PRIu64", \"errors\": %"PRIu64
+			", \"total_ns\": %"PRIu64", \"p50_ns\": %"PRIu64", \"p90_ns\": %"PRIu64
+			", \"p99_ns\": %"PRIu64", \"max_ns\": %"PRIu64", \"buckets\": [",
+			first ? "" : ",", ocdb_profiler_op_names[op],
+			histogram->stats.count, histogram->stats.errors, histogram->stats.total_ns,
+			ocdb_profiler_percentile(histogram, 50), ocdb_profiler_percentile(histogram, 90),
+			ocdb_profiler_percentile(histogram, 99), histogram->stats.max_ns);
+		first = false;
+
+		first_bucket = true;
+		for (i = 0; i < OCDB_PROFILER_BUCKETS; i++) {
+			if (!histogram->buckets[i]) continue;
+			fprintf(stream, "%s[%"PRIu64", %"PRIu64"]", first_bucket ? "" : ", ",
+				ocdb_profiler_bucket_low(i), histogram->buckets[i]);
+			first_bucket = false;
+		}
+		fprintf(stream, "]}");
+	}
+	fprintf(stream, "\n  }\n}\n");
+
+	return ferror(stream) ? MAPI_E_CALL_FAILED : MAPI_E_SUCCESS;
+}
+
+/**
+   \details Write a snapshot of the histograms to <prefix>.<pid>.json
+
+   The snapshot is written to a temporary file first and renamed, so
+   readers never see a partial document.
+
+   \param priv_data pointer to the profiler private data
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS ocdb_profiler_snapshot(struct ocdb_profiler_data *priv_data)
+{
+	enum MAPISTATUS	retval;
+	TALLOC_CTX	*mem_ctx;
+	char		*path;
+	char		*tmp_path;
+	FILE		*stream;
+	struct timespec	now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	priv_data->last_dump = now.tv_sec;
+	if (!priv_data->dump_prefix) {
+		return MAPI_E_NOT_INITIALIZED;
+	}
+
+	mem_ctx = talloc_new(NULL);
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	path = talloc_asprintf(mem_ctx, "%s.%d.json", priv_data->dump_prefix, (int) getpid());
+	OPENCHANGE_RETVAL_IF(!path, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	tmp_path = talloc_asprintf(mem_ctx, "%s.tmp", path);
+	OPENCHANGE_RETVAL_IF(!tmp_path, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	stream = fopen(tmp_path, "w");
+	if (!stream) {
+		OC_DEBUG(1, "Unable to write openchangedb profile %s: %s", tmp_path, strerror(errno));
+		talloc_free(mem_ctx);
+		return MAPI_E_CALL_FAILED;
+	}
+	retval = ocdb_profiler_write(priv_data, stream);
+	if (fclose(stream) != 0 && retval == MAPI_E_SUCCESS) {
+		retval = MAPI_E_CALL_FAILED;
+	}
+
+	if (retval == MAPI_E_SUCCESS && rename(tmp_path, path) != 0) {
+		retval = MAPI_E_CALL_FAILED;
+	}
+	if (retval != MAPI_E_SUCCESS) {
+		OC_DEBUG(1, "Unable to write openchangedb profile %s", path);
+		unlink(tmp_path);
+	}
+
+	talloc_free(mem_ctx);
+	return retval;
+}
+
+/**
+   \details Check whether the snapshot control file was touched since
+   the last check
+
+   \param priv_data pointer to the profiler private data
+   \param now the current CLOCK_MONOTONIC seconds
+
+   \return true if a snapshot was requested, false otherwise
+ */
+static bool ocdb_profiler_triggered(struct ocdb_profiler_data *priv_data, time_t now)
+{
+	struct stat	st;
+
+	if (!priv_data->trigger_path || now == priv_data->last_trigger_check) {
+		return false;
+	}
+	priv_data->last_trigger_check = now;
+
+	if (stat(priv_data->trigger_path, &st) != 0 || st.st_mtime == priv_data->trigger_mtime) {
+		return false;
+	}
+	priv_data->trigger_mtime = st.st_mtime;
+
+	return true;
+}
+
+/**
+   \details Account for a call which started at start
+
+   \param priv_data pointer to the profiler private data
+   \param op the profiled operation
+   \param start the time the call started at
+   \param error whether the call failed
+ */
+static void ocdb_profiler_record(struct ocdb_profiler_data *priv_data, enum ocdb_profiler_op op,
+				 const struct timespec *start, bool error)
+{
+	struct ocdb_profiler_histogram	*histogram = &priv_data->histograms[op];
+	struct timespec			end;
+	uint64_t			ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ns = (uint64_t)(end.tv_sec - start->tv_sec) * 1000000000 + end.tv_nsec - start->tv_nsec;
+
+	histogram->stats.count++;
+	histogram->stats.total_ns += ns;
+	if (ns > histogram->stats.max_ns) {
+		histogram->stats.max_ns = ns;
+	}
+	if (error) {
+		histogram->stats.errors++;
+	}
+	histogram->buckets[ocdb_profiler_bucket(ns)]++;
+
+	if ((priv_data->dump_interval &&
+	     end.tv_sec - priv_data->last_dump >= priv_data->dump_interval) ||
+	    ocdb_profiler_triggered(priv_data, end.tv_sec)) {
+		ocdb_profiler_snapshot(priv_data);
+	}
+}
+
+// ^ histograms ---------------------------------------------------------------
+
+// v profiled calls -----------------------------------------------------------
+
+static enum MAPISTATUS get_new_changeNumber(struct openchangedb_context *self,
+					    const char *username, uint64_t *cn)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_new_changeNumber(priv_data->backend, username, cn);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_NEW_CHANGENUMBER, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_new_changeNumbers(struct openchangedb_context *self,
+					     TALLOC_CTX *mem_ctx,
+					     const char *username,
+					     uint64_t max,
+					     struct UI8Array_r **cns_p)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_new_changeNumbers(priv_data->backend, mem_ctx, username, max, cns_p);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_NEW_CHANGENUMBERS, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_next_changeNumber(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t *cn)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_next_changeNumber(priv_data->backend, username, cn);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_NEXT_CHANGENUMBER, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS release_changeNumbers(struct openchangedb_context *self,
+					     const char *username,
+					     uint64_t first, uint64_t end)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->release_changeNumbers(priv_data->backend, username, first, end);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_RELEASE_CHANGENUMBERS, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_SpecialFolderID(struct openchangedb_context *self,
+					  const char *recipient, uint32_t system_idx,
+					  uint64_t *folder_id)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_SpecialFolderID(priv_data->backend, recipient, system_idx, folder_id);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_SPECIALFOLDERID, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
+					  const char *recipient, uint32_t SystemIdx,
+					  uint64_t *FolderId)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_SystemFolderID(priv_data->backend, recipient, SystemIdx, FolderId);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_SYSTEMFOLDERID, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_PublicFolderID(struct openchangedb_context *self,
+					  const char *username,
+					  uint32_t SystemIdx,
+					  uint64_t *FolderId)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_PublicFolderID(priv_data->backend, username, SystemIdx, FolderId);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_PUBLICFOLDERID, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_distinguishedName(TALLOC_CTX *parent_ctx,
+					     struct openchangedb_context *self,
+					     uint64_t fid,
+					     char **distinguishedName)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_distinguishedName(parent_ctx, priv_data->backend, fid, distinguishedName);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_DISTINGUISHEDNAME, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_MailboxGuid(struct openchangedb_context *self,
+				       const char *recipient,
+				       struct GUID *MailboxGUID)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_MailboxGuid(priv_data->backend, recipient, MailboxGUID);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_MAILBOXGUID, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_MailboxReplica(struct openchangedb_context *self,
+					  const char *recipient, uint16_t *ReplID,
+				  	  struct GUID *ReplGUID)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_MailboxReplica(priv_data->backend, recipient, ReplID, ReplGUID);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_MAILBOXREPLICA, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_PublicFolderReplica(struct openchangedb_context *self,
+					       const char *username,
+					       uint16_t *ReplID,
+					       struct GUID *ReplGUID)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_PublicFolderReplica(priv_data->backend, username, ReplID, ReplGUID);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_PUBLICFOLDERREPLICA, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_parent_fid(struct openchangedb_context *self,
+				      const char *username, uint64_t fid,
+				      uint64_t *parent_fidp, bool mailboxstore)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_parent_fid(priv_data->backend, username, fid, parent_fidp, mailboxstore);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_PARENT_FID, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_MAPIStoreURIs(struct openchangedb_context *self,
+					 const char *username,
+					 TALLOC_CTX *mem_ctx,
+					 struct StringArrayW_r **urisP)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_MAPIStoreURIs(priv_data->backend, username, mem_ctx, urisP);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_MAPISTOREURIS, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_mapistoreURI(TALLOC_CTX *parent_ctx,
+				        struct openchangedb_context *self,
+				        const char *username,
+				        uint64_t fid, char **mapistoreURL,
+				        bool mailboxstore)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_mapistoreURI(parent_ctx, priv_data->backend, username, fid, mapistoreURL, mailboxstore);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_MAPISTOREURI, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS set_mapistoreURI(struct openchangedb_context *self,
+					const char *username, uint64_t fid,
+					const char *mapistoreURL)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->set_mapistoreURI(priv_data->backend, username, fid, mapistoreURL);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_SET_MAPISTOREURI, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_fid(struct openchangedb_context *self,
+			       const char *mapistoreURL, uint64_t *fidp)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_fid(priv_data->backend, mapistoreURL, fidp);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_FID, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_ReceiveFolder(TALLOC_CTX *parent_ctx,
+					 struct openchangedb_context *self,
+					 const char *recipient,
+					 const char *MessageClass,
+					 uint64_t *fid,
+					 const char **ExplicitMessageClass)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_ReceiveFolder(parent_ctx, priv_data->backend, recipient, MessageClass, fid, ExplicitMessageClass);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_RECEIVEFOLDER, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_ReceiveFolderTable(TALLOC_CTX *parent_ctx,
+					      struct openchangedb_context *self,
+					      const char *recipient,
+					      uint32_t *cValues,
+					      struct ReceiveFolder **entries)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_ReceiveFolderTable(parent_ctx, priv_data->backend, recipient, cValues, entries);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_RECEIVEFOLDERTABLE, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_TransportFolder(struct openchangedb_context *self,
+					   const char *recipient,
+					   uint64_t *FolderId)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_TransportFolder(priv_data->backend, recipient, FolderId);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_TRANSPORTFOLDER, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS lookup_folder_property(struct openchangedb_context *self,
+					      uint32_t proptag, uint64_t fid)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->lookup_folder_property(priv_data->backend, proptag, fid);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_LOOKUP_FOLDER_PROPERTY, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS set_folder_properties(struct openchangedb_context *self,
+					     const char *username, uint64_t fid,
+					     struct SRow *row)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->set_folder_properties(priv_data->backend, username, fid, row);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_SET_FOLDER_PROPERTIES, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
+					   struct openchangedb_context *self,
+					   const char *username,
+					   uint32_t proptag, uint64_t fid,
+					   void **data)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_folder_property(parent_ctx, priv_data->backend, username, proptag, fid, data);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_FOLDER_PROPERTY, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_folder_count(struct openchangedb_context *self,
+					const char *username, uint64_t fid,
+					uint32_t *RowCount)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_folder_count(priv_data->backend, username, fid, RowCount);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_FOLDER_COUNT, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_message_count(struct openchangedb_context *self,
+					 const char *username, uint64_t fid,
+					 uint32_t *RowCount, bool fai)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_message_count(priv_data->backend, username, fid, RowCount, fai);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_MESSAGE_COUNT, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_system_idx(struct openchangedb_context *self,
+				      const char *username, uint64_t fid,
+				      int *system_idx_p)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_system_idx(priv_data->backend, username, fid, system_idx_p);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_SYSTEM_IDX, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS set_system_idx(struct openchangedb_context *self,
+				      const char *username, uint64_t fid,
+				      int system_idx)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->set_system_idx(priv_data->backend, username, fid, system_idx);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_SET_SYSTEM_IDX, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_table_property(TALLOC_CTX *parent_ctx,
+					  struct openchangedb_context *self,
+					  const char *ldb_filter,
+					  uint32_t proptag, uint32_t pos,
+					  void **data)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_table_property(parent_ctx, priv_data->backend, ldb_filter, proptag, pos, data);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_TABLE_PROPERTY, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_fid_by_name(struct openchangedb_context *self,
+				       const char *username,
+				       uint64_t parent_fid,
+				       const char* foldername, uint64_t *fid)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_fid_by_name(priv_data->backend, username, parent_fid, foldername, fid);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_FID_BY_NAME, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_mid_by_subject(struct openchangedb_context *self,
+					  const char *username,
+					  uint64_t parent_fid,
+					  const char *subject,
+					  bool mailboxstore, uint64_t *mid)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_mid_by_subject(priv_data->backend, username, parent_fid, subject, mailboxstore, mid);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_MID_BY_SUBJECT, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS set_ReceiveFolder(struct openchangedb_context *self,
+					 const char *recipient,
+					 const char *MessageClass, uint64_t fid)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->set_ReceiveFolder(priv_data->backend, recipient, MessageClass, fid);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_SET_RECEIVEFOLDER, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS create_mailbox(struct openchangedb_context *self,
+				      const char *username,
+				      const char *organization_name,
+				      const char *groupo_name,
+				      int systemIdx, uint64_t fid,
+				      const char *display_name)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->create_mailbox(priv_data->backend, username, organization_name, groupo_name, systemIdx, fid, display_name);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_CREATE_MAILBOX, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS create_folder(struct openchangedb_context *self,
+				     const char *username,
+				     uint64_t parentFolderID, uint64_t fid,
+				     uint64_t changeNumber,
+				     const char *MAPIStoreURI, int systemIdx)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->create_folder(priv_data->backend, username, parentFolderID, fid, changeNumber, MAPIStoreURI, systemIdx);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_CREATE_FOLDER, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS delete_folder(struct openchangedb_context *self,
+				     const char *username, uint64_t fid)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->delete_folder(priv_data->backend, username, fid);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_DELETE_FOLDER, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_fid_from_partial_uri(struct openchangedb_context *self,
+						const char *partialURI, uint64_t *fid)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_fid_from_partial_uri(priv_data->backend, partialURI, fid);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_FID_FROM_PARTIAL_URI, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_users_from_partial_uri(TALLOC_CTX *parent_ctx,
+						  struct openchangedb_context *self,
+						  const char *partialURI,
+						  uint32_t *count,
+						  char ***MAPIStoreURI,
+						  char ***users)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_users_from_partial_uri(parent_ctx, priv_data->backend, partialURI, count, MAPIStoreURI, users);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_USERS_FROM_PARTIAL_URI, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS table_init(TALLOC_CTX *mem_ctx,
+				  struct openchangedb_context *self,
+				  const char *username,
+				  uint8_t table_type, uint64_t folderID,
+				  void **table_object)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->table_init(mem_ctx, priv_data->backend, username, table_type, folderID, table_object);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_TABLE_INIT, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS table_set_sort_order(struct openchangedb_context *self,
+					    void *table_object,
+					    struct SSortOrderSet *lpSortCriteria)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->table_set_sort_order(priv_data->backend, table_object, lpSortCriteria);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_TABLE_SET_SORT_ORDER, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS table_set_restrictions(struct openchangedb_context *self,
+					      void *table_object,
+					      struct mapi_SRestriction *res)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->table_set_restrictions(priv_data->backend, table_object, res);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_TABLE_SET_RESTRICTIONS, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS table_get_property(TALLOC_CTX *mem_ctx,
+					  struct openchangedb_context *self,
+					  void *table_object,
+					  enum MAPITAGS proptag, uint32_t pos,
+					  bool live_filtered, void **data)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->table_get_property(mem_ctx, priv_data->backend, table_object, proptag, pos, live_filtered, data);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_TABLE_GET_PROPERTY, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS table_get_properties(TALLOC_CTX *mem_ctx,
+					    struct openchangedb_context *self,
+					    void *table_object,
+					    struct SPropTagArray *proptags,
+					    uint32_t pos, uint32_t count,
+					    bool live_filtered, void ***data,
+					    enum MAPISTATUS **retvals)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = openchangedb_table_get_properties(mem_ctx, priv_data->backend, table_object, proptags, pos, count, live_filtered, data, retvals);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_TABLE_GET_PROPERTIES, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS message_create(TALLOC_CTX *mem_ctx,
+				      struct openchangedb_context *self,
+				      const char *username,
+				      uint64_t messageID, uint64_t folderID,
+				      bool fai, void **message_object)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->message_create(mem_ctx, priv_data->backend, username, messageID, folderID, fai, message_object);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_MESSAGE_CREATE, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS message_save(struct openchangedb_context *self,
+				    void *_msg, uint8_t SaveFlags)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->message_save(priv_data->backend, _msg, SaveFlags);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_MESSAGE_SAVE, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS message_open(TALLOC_CTX *mem_ctx,
+				    struct openchangedb_context *self,
+				    const char *username,
+				    uint64_t messageID, uint64_t folderID,
+				    void **message_object, void **msgp)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->message_open(mem_ctx, priv_data->backend, username, messageID, folderID, message_object, msgp);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_MESSAGE_OPEN, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS message_get_property(TALLOC_CTX *mem_ctx,
+					    struct openchangedb_context *self,
+					    void *message_object,
+					    uint32_t proptag, void **data)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->message_get_property(mem_ctx, priv_data->backend, message_object, proptag, data);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_MESSAGE_GET_PROPERTY, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS message_set_properties(TALLOC_CTX *mem_ctx,
+					      struct openchangedb_context *self,
+					      void *message_object,
+					      struct SRow *row)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->message_set_properties(mem_ctx, priv_data->backend, message_object, row);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_MESSAGE_SET_PROPERTIES, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS transaction_start(struct openchangedb_context *self)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->transaction_start(priv_data->backend);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_TRANSACTION_START, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS transaction_commit(struct openchangedb_context *self)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->transaction_commit(priv_data->backend);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_TRANSACTION_COMMIT, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_new_public_folderID(struct openchangedb_context *self,
+					       const char *username,
+					       uint64_t *fid)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_new_public_folderID(priv_data->backend, username, fid);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_NEW_PUBLIC_FOLDERID, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static bool is_public_folder_id(struct openchangedb_context *self, uint64_t fid)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	bool				retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->is_public_folder_id(priv_data->backend, fid);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_IS_PUBLIC_FOLDER_ID, &start, false);
+
+	return retval;
+}
+
+static enum MAPISTATUS get_indexing_url(struct openchangedb_context *self,
+					const char *username,
+					const char **indexing_url)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_indexing_url(priv_data->backend, username, indexing_url);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_INDEXING_URL, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static bool set_locale(struct openchangedb_context *self, const char *username, uint32_t lcid)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	bool				retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->set_locale(priv_data->backend, username, lcid);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_SET_LOCALE, &start, false);
+
+	return retval;
+}
+
+static const char **get_folders_names(TALLOC_CTX *mem_ctx, struct openchangedb_context *self, const char *locale, const char *type)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	const char			**retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->get_folders_names(mem_ctx, priv_data->backend, locale, type);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_GET_FOLDERS_NAMES, &start, retval == NULL);
+
+	return retval;
+}
+
+static enum MAPISTATUS replica_mapping_guid_to_replid(struct openchangedb_context *self, const char *username, const struct GUID *guid, uint16_t *replid_p)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->replica_mapping_guid_to_replid(priv_data->backend, username, guid, replid_p);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_REPLICA_MAPPING_GUID_TO_REPLID, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+
+static enum MAPISTATUS replica_mapping_replid_to_guid(struct openchangedb_context *self, const char *username, uint16_t replid, struct GUID *guid)
+{
+	struct ocdb_profiler_data	*priv_data = _ocdb_profiler_data_get(self);
+	struct timespec			start;
+	enum MAPISTATUS			retval;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	retval = priv_data->backend->replica_mapping_replid_to_guid(priv_data->backend, username, replid, guid);
+	ocdb_profiler_record(priv_data, OCDB_PROFILER_REPLICA_MAPPING_REPLID_TO_GUID, &start, retval != MAPI_E_SUCCESS);
+
+	return retval;
+}
+// ^ profiled calls -----------------------------------------------------------
+
+static int ocdb_profiler_destructor(struct ocdb_profiler_data *priv_data)
+{
+	ocdb_profiler_snapshot(priv_data);
+
+	return 0;
+}
+
+/**
+   \details Initialize a profiling OpenChangeDB context on top of
+   another backend
+
+   \param mem_ctx pointer to the memory context
+   \param dump_prefix path prefix of the JSON snapshots and of the
+   <prefix>.snapshot control file, NULL to only collect the histograms
+   in memory
+   \param dump_interval number of seconds between two automatic
+   snapshots, 0 to disable them
+   \param backend the OpenChangeDB context to profile
+   \param ctx pointer to the OpenChangeDB context the function returns
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_profiler_initialize(TALLOC_CTX *mem_ctx,
+							  const char *dump_prefix,
+							  uint32_t dump_interval,
+							  struct openchangedb_context *backend,
+							  struct openchangedb_context **ctx)
+{
+	struct openchangedb_context	*oc_ctx;
+	struct ocdb_profiler_data	*data;
+	struct timespec			now;
+	struct stat			st;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!backend, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!ctx, MAPI_E_INVALID_PARAMETER, NULL);
+
+	oc_ctx = talloc_zero(mem_ctx, struct openchangedb_context);
+	OPENCHANGE_RETVAL_IF(oc_ctx == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+	data = talloc_zero(oc_ctx, struct ocdb_profiler_data);
+	OPENCHANGE_RETVAL_IF(data == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+
+	data->backend = backend;
+	if (dump_prefix) {
+		data->dump_prefix = talloc_strdup(data, dump_prefix);
+		OPENCHANGE_RETVAL_IF(data->dump_prefix == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+		data->dump_interval = dump_interval;
+		data->trigger_path = talloc_asprintf(data, "%s.snapshot", dump_prefix);
+		OPENCHANGE_RETVAL_IF(data->trigger_path == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+		/* Only later changes of the control file request a snapshot */
+		if (stat(data->trigger_path, &st) == 0) {
+			data->trigger_mtime = st.st_mtime;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	data->last_dump = now.tv_sec;
+	talloc_set_destructor(data, ocdb_profiler_destructor);
+
+	oc_ctx->data = data;
+
+	// Initialize struct with function pointers
+	oc_ctx->backend_type = talloc_strdup(oc_ctx, "profiler_module");
+	OPENCHANGE_RETVAL_IF(oc_ctx->backend_type == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+
+	oc_ctx->get_new_changeNumber = get_new_changeNumber;
+	oc_ctx->get_new_changeNumbers = get_new_changeNumbers;
+	oc_ctx->get_next_changeNumber = get_next_changeNumber;
+	oc_ctx->release_changeNumbers = release_changeNumbers;
+	oc_ctx->get_SpecialFolderID = get_SpecialFolderID;
+	oc_ctx->get_SystemFolderID = get_SystemFolderID;
+	oc_ctx->get_PublicFolderID = get_PublicFolderID;
+	oc_ctx->get_distinguishedName = get_distinguishedName;
+	oc_ctx->get_MailboxGuid = get_MailboxGuid;
+	oc_ctx->get_MailboxReplica = get_MailboxReplica;
+	oc_ctx->get_PublicFolderReplica = get_PublicFolderReplica;
+	oc_ctx->get_parent_fid = get_parent_fid;
+	oc_ctx->get_MAPIStoreURIs = get_MAPIStoreURIs;
+	oc_ctx->get_mapistoreURI = get_mapistoreURI;
+	oc_ctx->set_mapistoreURI = set_mapistoreURI;
+	oc_ctx->get_fid = get_fid;
+	oc_ctx->get_ReceiveFolder = get_ReceiveFolder;
+	oc_ctx->get_ReceiveFolderTable = get_ReceiveFolderTable;
+	oc_ctx->get_TransportFolder = get_TransportFolder;
+	oc_ctx->lookup_folder_property = lookup_folder_property;
+	oc_ctx->set_folder_properties = set_folder_properties;
+	oc_ctx->get_folder_property = get_folder_property;
+	oc_ctx->get_folder_count = get_folder_count;
+	oc_ctx->get_message_count = get_message_count;
+	oc_ctx->get_system_idx = get_system_idx;
+	oc_ctx->set_system_idx = set_system_idx;
+	oc_ctx->get_table_property = get_table_property;
+	oc_ctx->get_fid_by_name = get_fid_by_name;
+	oc_ctx->get_mid_by_subject = get_mid_by_subject;
+	oc_ctx->set_ReceiveFolder = set_ReceiveFolder;
+	oc_ctx->create_mailbox = create_mailbox;
+	oc_ctx->create_folder = create_folder;
+	oc_ctx->delete_folder = delete_folder;
+	oc_ctx->get_fid_from_partial_uri = get_fid_from_partial_uri;
+	oc_ctx->get_users_from_partial_uri = get_users_from_partial_uri;
+	oc_ctx->table_init = table_init;
+	oc_ctx->table_set_sort_order = table_set_sort_order;
+	oc_ctx->table_set_restrictions = table_set_restrictions;
+	oc_ctx->table_get_property = table_get_property;
+	oc_ctx->table_get_properties = table_get_properties;
+	oc_ctx->message_create = message_create;
+	oc_ctx->message_save = message_save;
+	oc_ctx->message_open = message_open;
+	oc_ctx->message_get_property = message_get_property;
+	oc_ctx->message_set_properties = message_set_properties;
+	oc_ctx->transaction_start = transaction_start;
+	oc_ctx->transaction_commit = transaction_commit;
+	oc_ctx->get_new_public_folderID = get_new_public_folderID;
+	oc_ctx->is_public_folder_id = is_public_folder_id;
+	oc_ctx->get_indexing_url = get_indexing_url;
+	oc_ctx->set_locale = set_locale;
+	oc_ctx->get_folders_names = get_folders_names;
+	oc_ctx->replica_mapping_guid_to_replid = replica_mapping_guid_to_replid;
+	oc_ctx->replica_mapping_replid_to_guid = replica_mapping_replid_to_guid;
+
+	*ctx = oc_ctx;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Retrieve the statistics of an operation profiled by an
+   OpenChangeDB profiling context
+
+   \param oc_ctx pointer to the OpenChangeDB context
+   \param operation name of the operation, as in struct
+   openchangedb_context
+   \param stats pointer to the statistics the function returns
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_NOT_FOUND if the operation
+   is unknown, MAPI_E_INVALID_PARAMETER if oc_ctx is not a profiling
+   context
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_profiler_get_stats(struct openchangedb_context *oc_ctx,
+							 const char *operation,
+							 struct openchangedb_profiler_stats *stats)
+{
+	struct ocdb_profiler_data	*priv_data;
+	uint32_t			op;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!oc_ctx || !operation || !stats, MAPI_E_INVALID_PARAMETER, NULL);
+	priv_data = talloc_get_type(oc_ctx->data, struct ocdb_profiler_data);
+	OPENCHANGE_RETVAL_IF(!priv_data, MAPI_E_INVALID_PARAMETER, NULL);
+
+	for (op = 0; op < OCDB_PROFILER_OPERATIONS; op++) {
+		if (strcmp(ocdb_profiler_op_names[op], operation) == 0) {
+			*stats = priv_data->histograms[op].stats;
+			return MAPI_E_SUCCESS;
+		}
+	}
+
+	return MAPI_E_NOT_FOUND;
+}
+
+/**
+   \details Write the histograms of an OpenChangeDB profiling context
+   as a JSON document
+
+   \param oc_ctx pointer to the OpenChangeDB context
+   \param stream the stream to write to
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_profiler_dump(struct openchangedb_context *oc_ctx, FILE *stream)
+{
+	struct ocdb_profiler_data	*priv_data;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!oc_ctx || !stream, MAPI_E_INVALID_PARAMETER, NULL);
+	priv_data = talloc_get_type(oc_ctx->data, struct ocdb_profiler_data);
+	OPENCHANGE_RETVAL_IF(!priv_data, MAPI_E_INVALID_PARAMETER, NULL);
+
+	return ocdb_profiler_write(priv_data, stream);
+}
+
+/**
+   \details Write the histograms of an OpenChangeDB profiling context
+   to <prefix>.<pid>.json now
+
+   \param oc_ctx pointer to the OpenChangeDB context
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_NOT_INITIALIZED if the
+   context was created without a dump prefix, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_profiler_snapshot(struct openchangedb_context *oc_ctx)
+{
+	struct ocdb_profiler_data	*priv_data;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_INVALID_PARAMETER, NULL);
+	priv_data = talloc_get_type(oc_ctx->data, struct ocdb_profiler_data);
+	OPENCHANGE_RETVAL_IF(!priv_data, MAPI_E_INVALID_PARAMETER, NULL);
+
+	return ocdb_profiler_snapshot(priv_data);
+}
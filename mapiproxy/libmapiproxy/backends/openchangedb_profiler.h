@@ -0,0 +1,47 @@
+/*
+   OpenChange Server implementation
+
+   OpenChangeDB latency profiling backend
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __OPENCHANGEDB_PROFILER_H__
+#define __OPENCHANGEDB_PROFILER_H__
+
+#include <stdio.h>
+
+#include "openchangedb_backends.h"
+
+struct openchangedb_profiler_stats {
+	uint64_t	count;
+	uint64_t	errors;
+	uint64_t	total_ns;
+	uint64_t	max_ns;
+};
+
+enum MAPISTATUS openchangedb_profiler_initialize(TALLOC_CTX *mem_ctx,
+						 const char *dump_prefix,
+						 uint32_t dump_interval,
+						 struct openchangedb_context *backend,
+						 struct openchangedb_context **ctx);
+enum MAPISTATUS openchangedb_profiler_get_stats(struct openchangedb_context *oc_ctx,
+						const char *operation,
+						struct openchangedb_profiler_stats *stats);
+enum MAPISTATUS openchangedb_profiler_dump(struct openchangedb_context *oc_ctx, FILE *stream);
+enum MAPISTATUS openchangedb_profiler_snapshot(struct openchangedb_context *oc_ctx);
+
+#endif /* __OPENCHANGEDB_PROFILER_H__ */
@@ -24,6 +24,7 @@
 #include "libmapiproxy.h"
 #include "libmapi/libmapi.h"
 #include "utils/dlinklist.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
 
 /**
    \file dcesrv_mapiproxy_session.c
@@ -33,30 +34,58 @@
 
 static struct mpm_session	*mpm_sessions = NULL;
 
+/* Hash function on session UUID */
+static size_t mpm_session_hash_uuid(const struct GUID *uuid)
+{
+	return uuid->time_low ^
+		(((uint32_t)uuid->time_mid << 16) | uuid->time_hi_and_version) ^
+		(((uint32_t)uuid->clock_seq[0] << 24) | ((uint32_t)uuid->clock_seq[1] << 16) |
+		 ((uint32_t)uuid->node[0] << 8) | uuid->node[1]) ^
+		(((uint32_t)uuid->node[2] << 24) | ((uint32_t)uuid->node[3] << 16) |
+		 ((uint32_t)uuid->node[4] << 8) | uuid->node[5]);
+}
+
+/* Rehash function for mpm_sessions_ht table */
+static size_t _ht_rehash(const void *e, void *unused)
+{
+	return mpm_session_hash_uuid(&((const struct mpm_session *)e)->uuid);
+}
+
+/* Comparison function to get sessions from mpm_sessions_ht table */
+static bool _ht_cmp(const void *e, void *uuid)
+{
+	return GUID_equal(&((const struct mpm_session *)e)->uuid, (const struct GUID *)uuid);
+}
+
+/* This is an index [uuid] -> [struct mpm_session *] on sessions with a non-zero UUID */
+static struct htable mpm_sessions_ht = HTABLE_INITIALIZER(mpm_sessions_ht, _ht_rehash, NULL);
+
 
 /**
    \details Create and return an allocated pointer to a mpm session
 
-   \param dce_call pointer to the session context
+   \param server_id the server_id of the connection
+   \param context_id the connection context id
+   \param username account name of the session
    \param uuid session
 
    \return Pointer to an allocated mpm_session structure on success,
    otherwise NULL
  */
-struct mpm_session *mpm_session_init(struct dcesrv_call_state *dce_call,
-				     struct GUID *uuid)
+struct mpm_session *mpm_session_init_sub(struct server_id server_id,
+					 uint32_t context_id,
+					 const char *username,
+					 struct GUID *uuid)
 {
 	struct mpm_session	*session = NULL;
 
-	if (!dce_call) return NULL;
-	if (!dce_call->conn) return NULL;
-	if (!dce_call->context) return NULL;
+	if (!username) return NULL;
 
 	session = talloc_zero(NULL, struct mpm_session);
 	if (!session) return NULL;
 
-	session->server_id = dce_call->conn->server_id;
-	session->context_id = dce_call->context->context_id;
+	session->server_id = server_id;
+	session->context_id = context_id;
 	if (uuid) {
 		session->uuid = *uuid;
 	}
@@ -66,14 +95,52 @@ struct mpm_session *mpm_session_init(struct dcesrv_call_state *dce_call,
 	/* Released RPC connection, session may be kept to avoid premature release
 	of private_data, that will be cleared when all user sessions are released */
 	session->released = false;
-	session->username = talloc_strdup(session, dcesrv_call_account_name(dce_call));
-	if (!session->username) return NULL;
+	session->username = talloc_strdup(session, username);
+	if (!session->username) {
+		talloc_free(session);
+		return NULL;
+	}
+
+	if (!GUID_all_zero(&session->uuid)) {
+		if (!htable_add(&mpm_sessions_ht, mpm_session_hash_uuid(&session->uuid), session)) {
+			OC_DEBUG(3, "Error adding session to the sessions index");
+			talloc_free(session);
+			return NULL;
+		}
+	}
 	DLIST_ADD(mpm_sessions, session);
 
 	return session;
 }
 
 
+/**
+   \details Create and return an allocated pointer to a mpm session
+
+   This function is a wrapper on mpm_session_init_sub
+
+   \param dce_call pointer to the session context
+   \param uuid session
+
+   \return Pointer to an allocated mpm_session structure on success,
+   otherwise NULL
+
+   \sa mpm_session_init_sub
+ */
+struct mpm_session *mpm_session_init(struct dcesrv_call_state *dce_call,
+				     struct GUID *uuid)
+{
+	if (!dce_call) return NULL;
+	if (!dce_call->conn) return NULL;
+	if (!dce_call->context) return NULL;
+
+	return mpm_session_init_sub(dce_call->conn->server_id,
+				    dce_call->context->context_id,
+				    dcesrv_call_account_name(dce_call),
+				    uuid);
+}
+
+
 /**
    \details Free session private data
 
@@ -178,6 +245,9 @@ bool mpm_session_unbind(struct server_id *server_id, uint32_t context_id)
 
 				/* Remove and free session entry */
 				next = current->next;
+				if (!GUID_all_zero(&current->uuid)) {
+					htable_del(&mpm_sessions_ht, mpm_session_hash_uuid(&current->uuid), current);
+				}
 				DLIST_REMOVE(mpm_sessions, current);
 				talloc_free(current);
 				current = next;
@@ -203,6 +273,11 @@ struct mpm_session *mpm_session_find_by_uuid(struct GUID *uuid)
 
 	if (!uuid) return NULL;
 
+	if (!GUID_all_zero(uuid)) {
+		return htable_get(&mpm_sessions_ht, mpm_session_hash_uuid(uuid), _ht_cmp, uuid);
+	}
+
+	/* Sessions without UUID are not indexed */
 	for (session = mpm_sessions; session; session = session->next) {
 		if (GUID_equal(uuid, &session->uuid)) {
 			return session;
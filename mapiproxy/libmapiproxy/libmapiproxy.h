@@ -121,21 +121,40 @@ struct mapi_handles {
 	uint32_t	       	handle;
 	uint32_t		parent_handle;
 	void		       	*private_data;
+	struct mapi_handles	*parent;
+	struct mapi_handles	*children;
 	struct mapi_handles	*prev;
 	struct mapi_handles	*next;
 };
 
 
+struct mapi_handles_slot {
+	struct mapi_handles	*rec;
+	uint32_t		generation;
+	uint32_t		next_free;
+};
+
+
 struct mapi_handles_context {
-	TDB_CONTEXT	       	*tdb_ctx;
-	uint32_t		last_handle;
-	struct mapi_handles    	*handles;
+	struct mapi_handles_slot	*slots;
+	uint32_t			slots_count;
+	uint32_t			last_handle;
+	uint32_t			free_slot;
+	uint32_t			handles_count;
+	struct mapi_handles    		*handles;
 };
 
 
-#define	MAPI_HANDLES_RESERVED	0xFFFFFFFF
-#define	MAPI_HANDLES_ROOT	"root"
-#define	MAPI_HANDLES_NULL	"null"
+#define	MAPI_HANDLES_RESERVED		0xFFFFFFFF
+#define	MAPI_HANDLES_INDEX_BITS		24
+#define	MAPI_HANDLES_INDEX_MASK		((1 << MAPI_HANDLES_INDEX_BITS) - 1)
+#define	MAPI_HANDLES_GENERATION_MASK	0xFF
+#define	MAPI_HANDLES_MAX_INDEX		(MAPI_HANDLES_INDEX_MASK - 1)
+#define	MAPI_HANDLES_SLOTS_CHUNK	64
+
+#define	MAPI_HANDLES_INDEX(h)		((h) & MAPI_HANDLES_INDEX_MASK)
+#define	MAPI_HANDLES_GENERATION(h)	(((h) >> MAPI_HANDLES_INDEX_BITS) & MAPI_HANDLES_GENERATION_MASK)
+#define	MAPI_HANDLES_MAKE(i,g)		(((((uint32_t)(g)) & MAPI_HANDLES_GENERATION_MASK) << MAPI_HANDLES_INDEX_BITS) | (((uint32_t)(i)) & MAPI_HANDLES_INDEX_MASK))
 
 
 /**
@@ -190,6 +209,7 @@ void *mapiproxy_server_openchangedb_init(struct loadparm_context *);
 
 /* definitions from dcesrv_mapiproxy_session. c */
 struct mpm_session *mpm_session_init(struct dcesrv_call_state *, struct GUID *);
+struct mpm_session *mpm_session_init_sub(struct server_id, uint32_t, const char *, struct GUID *);
 bool mpm_session_set_destructor(struct mpm_session *, bool (*destructor)(void *));
 bool mpm_session_release(struct mpm_session *);
 bool mpm_session_set_private_data(struct mpm_session *, void *);
@@ -205,6 +225,8 @@ enum MAPISTATUS openchangedb_initialize(TALLOC_CTX *, struct loadparm_context *,
 enum MAPISTATUS openchangedb_get_new_changeNumber(struct openchangedb_context *, const char *, uint64_t *);
 enum MAPISTATUS openchangedb_get_new_changeNumbers(struct openchangedb_context *, TALLOC_CTX *, const char *, uint64_t, struct UI8Array_r **);
 enum MAPISTATUS openchangedb_get_next_changeNumber(struct openchangedb_context *, const char *, uint64_t *);
+enum MAPISTATUS openchangedb_set_changeNumber_lease(struct openchangedb_context *, uint32_t);
+enum MAPISTATUS openchangedb_release_changeNumbers(struct openchangedb_context *);
 enum MAPISTATUS openchangedb_get_SystemFolderID(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
 enum MAPISTATUS openchangedb_get_SpecialFolderID(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
 enum MAPISTATUS openchangedb_get_PublicFolderID(struct openchangedb_context *, const char *, uint32_t, uint64_t *);
@@ -256,6 +278,7 @@ enum MAPISTATUS openchangedb_table_init(TALLOC_CTX *, struct openchangedb_contex
 enum MAPISTATUS openchangedb_table_set_sort_order(struct openchangedb_context *, void *, struct SSortOrderSet *);
 enum MAPISTATUS openchangedb_table_set_restrictions(struct openchangedb_context *, void *, struct mapi_SRestriction *);
 enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *, struct openchangedb_context *, void *, enum MAPITAGS, uint32_t, bool, void **);
+enum MAPISTATUS openchangedb_table_get_properties(TALLOC_CTX *, struct openchangedb_context *, void *, struct SPropTagArray *, uint32_t, uint32_t, bool, void ***, enum MAPISTATUS **);
 
 /* definitions from openchangedb_message.c */
 enum MAPISTATUS openchangedb_message_open(TALLOC_CTX *, struct openchangedb_context *, const char *, uint64_t, uint64_t, void **, void **);
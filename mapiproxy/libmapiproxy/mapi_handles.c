@@ -23,6 +23,14 @@
    \file mapi_handles.c
 
    \brief API for MAPI handles management
+
+   MAPI handles are stored in a dense array of slots indexed by the
+   lower MAPI_HANDLES_INDEX_BITS bits of the handle value. The upper
+   bits hold a generation counter incremented each time a slot is
+   released, so stale handles sent by clients are detected instead of
+   resolving to a recycled object. Released slots are chained in an
+   intrusive free list and each record keeps the list of its children
+   so the hierarchy can be released without scanning the whole table.
  */
 
 #include "mapiproxy/dcesrv_mapiproxy.h"
@@ -45,10 +53,17 @@ _PUBLIC_ struct mapi_handles_context *mapi_handles_init(TALLOC_CTX *mem_ctx)
 	handles_ctx = talloc_zero(mem_ctx, struct mapi_handles_context);
 	if (!handles_ctx) return NULL;
 
-	/* Step 2. Initialize the TDB context */
-	handles_ctx->tdb_ctx = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0600);
+	/* Step 2. Initialize the slots array */
+	handles_ctx->slots = talloc_zero_array(handles_ctx, struct mapi_handles_slot, MAPI_HANDLES_SLOTS_CHUNK);
+	if (!handles_ctx->slots) {
+		talloc_free(handles_ctx);
+		return NULL;
+	}
+	handles_ctx->slots_count = MAPI_HANDLES_SLOTS_CHUNK;
+	handles_ctx->free_slot = 0;
+	handles_ctx->handles_count = 0;
 
-	/* Step 3. Initialize the handles list */
+	/* Step 3. Initialize the root handles list */
 	handles_ctx->handles = NULL;
 
 	/* Step 4. Set last_handle to the first valid value */
@@ -70,7 +85,6 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 
-	tdb_close(handles_ctx->tdb_ctx);
 	talloc_free(handles_ctx);
 
 	return MAPI_E_SUCCESS;
@@ -78,7 +92,7 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 
 
 /**
-   \details Search for a record in the TDB database
+   \details Search for a MAPI handle record
 
    \param handles_ctx pointer to the MAPI handles context
    \param handle MAPI handle to lookup
@@ -90,168 +104,96 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_release(struct mapi_handles_context *handl
 _PUBLIC_ enum MAPISTATUS mapi_handles_search(struct mapi_handles_context *handles_ctx,
 					     uint32_t handle, struct mapi_handles **rec)
 {
-	TALLOC_CTX		*mem_ctx;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	struct mapi_handles	*el;
+	struct mapi_handles_slot	*slot;
+	uint32_t			idx;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_search");
+	/* Step 1. Ensure the index refers to an allocated slot */
+	idx = MAPI_HANDLES_INDEX(handle);
+	OPENCHANGE_RETVAL_IF(!idx || idx >= handles_ctx->last_handle, MAPI_E_NOT_FOUND, NULL);
 
-	/* Step 1. Search for the handle within TDB database */
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
+	/* Step 2. Ensure this is not a free'd or recycled slot */
+	slot = &handles_ctx->slots[idx];
+	OPENCHANGE_RETVAL_IF(!slot->rec, MAPI_E_NOT_FOUND, NULL);
+	OPENCHANGE_RETVAL_IF(slot->generation != MAPI_HANDLES_GENERATION(handle), MAPI_E_NOT_FOUND, NULL);
 
-	dbuf = tdb_fetch(handles_ctx->tdb_ctx, key);
-	talloc_free(key.dptr);
-	OPENCHANGE_RETVAL_IF(!dbuf.dptr, MAPI_E_NOT_FOUND, mem_ctx);
-	OPENCHANGE_RETVAL_IF(!dbuf.dsize, MAPI_E_NOT_FOUND, mem_ctx);
-
-	talloc_free(mem_ctx);
-	/* Ensure this is not a free'd record */
-	if (dbuf.dsize == (sizeof(MAPI_HANDLES_NULL) - 1) && !strncmp((char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize)) {
-		free(dbuf.dptr);
-		return MAPI_E_NOT_FOUND;
-	}
-	free(dbuf.dptr);
+	/* This case should never occur */
+	OPENCHANGE_RETVAL_IF(slot->rec->handle != handle, MAPI_E_CORRUPT_STORE, NULL);
 
-	/* Step 2. Return the record within the double chained list */
-	for (el = handles_ctx->handles; el; el = el->next) {
-		if (el->handle == handle) {
-			*rec = el;
-			return MAPI_E_SUCCESS;
-		}
-	}
+	*rec = slot->rec;
 
-	return MAPI_E_CORRUPT_STORE;
+	return MAPI_E_SUCCESS;
 }
 
 
 /**
-   \details Set a TDB record data as null meaning it can be reused in
-   the future.
+   \details Retrieve a free slot index, either from the free list or
+   by growing the slots array.
 
    \param handles_ctx pointer to the MAPI handles context
-   \param handle handle key value to free
+   \param idx pointer to the slot index the function returns
 
    \return MAPI_E_SUCCESS on success, otherwise MAPI error
  */
-static enum MAPISTATUS mapi_handles_tdb_free(struct mapi_handles_context *handles_ctx,
-					     uint32_t handle)
+static enum MAPISTATUS mapi_handles_slot_get(struct mapi_handles_context *handles_ctx,
+					     uint32_t *idx)
 {
-	TALLOC_CTX		*mem_ctx;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	int			ret;
-
-	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
+	struct mapi_handles_slot	*slots;
+	uint32_t			slots_count;
+
+	/* Step 1. Reuse the first free slot if any */
+	if (handles_ctx->free_slot) {
+		*idx = handles_ctx->free_slot;
+		handles_ctx->free_slot = handles_ctx->slots[*idx].next_free;
+		handles_ctx->slots[*idx].next_free = 0;
+		OC_DEBUG(5, "We have found free slot 0x%x", *idx);
+		return MAPI_E_SUCCESS;
+	}
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_tdb_free");
-	
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	/* Step 1. Makes sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Update existing record */
-	dbuf.dptr = (unsigned char *)MAPI_HANDLES_NULL;
-	dbuf.dsize = sizeof(MAPI_HANDLES_NULL) - 1;
-
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_MODIFY);
-	talloc_free(mem_ctx);
-	if (ret == -1) {
-		OC_DEBUG(3, "Unable to create 0x%x record: %s\n",
-			  handle, tdb_errorstr(handles_ctx->tdb_ctx));
-		return MAPI_E_CORRUPT_STORE;
+	/* Step 2. Otherwise use a never-allocated slot */
+	OPENCHANGE_RETVAL_IF(handles_ctx->last_handle > MAPI_HANDLES_MAX_INDEX, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+	if (handles_ctx->last_handle >= handles_ctx->slots_count) {
+		slots_count = handles_ctx->slots_count * 2;
+		if (slots_count > MAPI_HANDLES_MAX_INDEX + 1) {
+			slots_count = MAPI_HANDLES_MAX_INDEX + 1;
+		}
+		slots = talloc_realloc(handles_ctx, handles_ctx->slots, struct mapi_handles_slot, slots_count);
+		OPENCHANGE_RETVAL_IF(!slots, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+		memset(&slots[handles_ctx->slots_count], 0,
+		       (slots_count - handles_ctx->slots_count) * sizeof (struct mapi_handles_slot));
+		handles_ctx->slots = slots;
+		handles_ctx->slots_count = slots_count;
 	}
 
+	*idx = handles_ctx->last_handle;
+	handles_ctx->last_handle += 1;
+
 	return MAPI_E_SUCCESS;
 }
 
 
 /**
-   \details Update a TDB record
+   \details Mark a slot as free meaning it can be reused in the
+   future. The slot generation is bumped so any outstanding handle
+   referring to it becomes invalid.
 
-   
+   \param handles_ctx pointer to the MAPI handles context
+   \param idx slot index to free
  */
-static enum MAPISTATUS mapi_handles_tdb_update(struct mapi_handles_context *handles_ctx,
-					       uint32_t handle, uint32_t container_handle)
+static void mapi_handles_slot_free(struct mapi_handles_context *handles_ctx,
+				   uint32_t idx)
 {
-	TALLOC_CTX	*mem_ctx;
-	TDB_DATA	key;
-	TDB_DATA	dbuf;
-	int		ret;
-
-	/* Sanity checks */
-	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handle, MAPI_E_INVALID_PARAMETER, NULL);
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_tdb_update");
-
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	/* Step 1. Makes sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Update record */
-	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", container_handle);
-	dbuf.dsize = strlen((const char *)dbuf.dptr);
+	struct mapi_handles_slot	*slot = &handles_ctx->slots[idx];
 
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_MODIFY);
-	talloc_free(mem_ctx);
-	if (ret == -1) {
-		OC_DEBUG(3, "Unable to update 0x%x record: %s\n",
-			  handle, tdb_errorstr(handles_ctx->tdb_ctx));
-
-		return MAPI_E_CORRUPT_STORE;
-	}
-
-	return MAPI_E_SUCCESS;
-}
-
-
-/**
-   \details Traverse TDB database and search for the first record
-   which dbuf value is "null" string.
- 
-   \param tdb_ctx pointer to the TDB context
-   \param key the current TDB key
-   \param dbuf the current TDB value
-   \param state pointer on private data
-
-   \return 1 when a free record is found, otherwise 0
-*/
-static int mapi_handles_traverse_null(TDB_CONTEXT *tdb_ctx,
-				      TDB_DATA key, TDB_DATA dbuf,
-				      void *state)
-{
-	TALLOC_CTX	*mem_ctx;
-	uint32_t	*handle = (uint32_t *) state;
-	char		*handle_str = NULL;
-
-	if (dbuf.dptr && (dbuf.dsize == sizeof(MAPI_HANDLES_NULL) - 1) && strncmp((const char *)dbuf.dptr, MAPI_HANDLES_NULL, dbuf.dsize) == 0) {
-		mem_ctx = talloc_named(NULL, 0, "mapi_handles_traverse_null");
-		handle_str = talloc_strndup(mem_ctx, (char *)key.dptr, key.dsize);
-		*handle = strtol((const char *) handle_str, NULL, 16);
-		talloc_free(mem_ctx);
-
-		return 1;
-	}
-
-	return 0;
+	slot->rec = NULL;
+	slot->generation = (slot->generation + 1) & MAPI_HANDLES_GENERATION_MASK;
+	slot->next_free = handles_ctx->free_slot;
+	handles_ctx->free_slot = idx;
 }
 
 
@@ -269,84 +211,57 @@ static int mapi_handles_traverse_null(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ enum MAPISTATUS mapi_handles_add(struct mapi_handles_context *handles_ctx,
 					  uint32_t container_handle, struct mapi_handles **rec)
 {
-	TALLOC_CTX		*mem_ctx;
 	enum MAPISTATUS		retval;
-	TDB_DATA		key;
-	TDB_DATA		dbuf;
-	uint32_t		handle = 0;
+	struct mapi_handles	*parent = NULL;
 	struct mapi_handles	*el;
-	int			ret;
+	uint32_t		idx;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!rec, MAPI_E_INVALID_PARAMETER, NULL);
 
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_add");
-
-	/* Step 1. Seek the TDB database for the first free record */
-	ret = tdb_traverse(handles_ctx->tdb_ctx, mapi_handles_traverse_null, (void *)&handle);
-	if (ret > -1 && handle > 0) {
-		OC_DEBUG(5, "We have found free record 0x%x", handle);
-		retval = mapi_handles_tdb_update(handles_ctx, handle, container_handle);
-		OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
-		
-		el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
-		if (!el) {
-			mapi_handles_tdb_free(handles_ctx, handle);
-			talloc_free(mem_ctx);
-			return MAPI_E_NOT_ENOUGH_RESOURCES;
+	/* Step 1. Resolve the container record if any */
+	if (container_handle && container_handle != MAPI_HANDLES_RESERVED) {
+		retval = mapi_handles_search(handles_ctx, container_handle, &parent);
+		if (retval) {
+			OC_DEBUG(5, "container handle 0x%x not found, adding handle as root", container_handle);
+			parent = NULL;
 		}
-
-		el->handle = handle;
-		el->parent_handle = container_handle;
-		el->private_data = NULL;
-		*rec = el;
-		DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
-
-		talloc_free(mem_ctx);
-
-		return MAPI_E_SUCCESS;
-	}
-
-	/* Step 2. If no record is available, create a new one */
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handles_ctx->last_handle);
-	key.dsize = strlen((const char *)key.dptr);
-
-	if (container_handle) {
-		dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", container_handle);
-		dbuf.dsize = strlen((const char *)dbuf.dptr);
-	} else {
-		dbuf.dptr = (unsigned char *) MAPI_HANDLES_ROOT;
-		dbuf.dsize = strlen(MAPI_HANDLES_ROOT);
 	}
 
-	ret = tdb_store(handles_ctx->tdb_ctx, key, dbuf, TDB_INSERT);
-	if (ret == -1) {
-		OC_DEBUG(3, "Unable to create 0x%x record: %s",
-			  handles_ctx->last_handle, tdb_errorstr(handles_ctx->tdb_ctx));
-		talloc_free(mem_ctx);
-
-		return MAPI_E_CORRUPT_STORE;
-	}
+	/* Step 2. Retrieve a free slot */
+	retval = mapi_handles_slot_get(handles_ctx, &idx);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
 
 	el = talloc_zero((TALLOC_CTX *)handles_ctx, struct mapi_handles);
 	if (!el) {
-		mapi_handles_tdb_free(handles_ctx, handles_ctx->last_handle);
-		talloc_free(mem_ctx);
+		mapi_handles_slot_free(handles_ctx, idx);
 		return MAPI_E_NOT_ENOUGH_RESOURCES;
 	}
 
-	el->handle = handles_ctx->last_handle;
+	el->handle = MAPI_HANDLES_MAKE(idx, handles_ctx->slots[idx].generation);
 	el->parent_handle = container_handle;
 	el->private_data = NULL;
+	el->parent = parent;
+	el->children = NULL;
+	handles_ctx->slots[idx].rec = el;
+	handles_ctx->handles_count += 1;
+
+	/* Step 3. Link the record to its container or to the root list */
+	if (parent) {
+		DLIST_ADD_END(parent->children, el, struct mapi_handles *);
+	} else {
+		DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
+	}
+
 	*rec = el;
-	DLIST_ADD_END(handles_ctx->handles, el, struct mapi_handles *);
 
-	OC_DEBUG(5, "handle 0x%.2x is a father of 0x%.2x", container_handle, el->handle);
-	handles_ctx->last_handle += 1;
-	talloc_free(mem_ctx);
+	if (parent) {
+		OC_DEBUG(5, "handle 0x%.2x is a father of 0x%.2x", container_handle, el->handle);
+	} else {
+		OC_DEBUG(5, "handle 0x%.2x added as root", el->handle);
+	}
 
 	return MAPI_E_SUCCESS;
 }
@@ -354,7 +269,6 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_add(struct mapi_handles_context *handles_c
 
 /**
    \details Get the private data associated to a MAPI handle
-
    \param handle pointer to the MAPI handle structure
    \param private_data pointer on pointer to the private data the
    function returns
@@ -395,55 +309,41 @@ _PUBLIC_ enum MAPISTATUS mapi_handles_set_private_data(struct mapi_handles *hand
 }
 
 
-struct mapi_handles_private {
-	struct mapi_handles_context	*handles_ctx;
-	uint32_t			container_handle;
-};
-
 /**
-   \details Traverse TDB database and search for records
-   which dbuf value is set to state.
- 
-   \param tdb_ctx pointer to the TDB context
-   \param key the current TDB key (potential child handle)
-   \param dbuf the current TDB value (parent handle)
-   \param state pointer on private data
-
-   \return 1 when a free record is found, otherwise 0
-*/
-static int mapi_handles_traverse_delete(TDB_CONTEXT *tdb_ctx,
-					TDB_DATA key, TDB_DATA dbuf,
-					void *state)
+   \details Release a MAPI handle record and, recursively, the
+   records of its children. The record must already be unlinked from
+   its container or root list.
+
+   \param handles_ctx pointer to the MAPI handles context
+   \param el pointer to the MAPI handle record to release
+ */
+static void mapi_handles_destroy(struct mapi_handles_context *handles_ctx,
+				 struct mapi_handles *el)
 {
-	TALLOC_CTX			*mem_ctx;
-	struct mapi_handles_private	*handles_private = (struct mapi_handles_private *) state;
-	uint32_t			handle;
-	char				*container_handle_str = NULL;
-	char				*handle_str = NULL;
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_traverse_delete");
-	container_handle_str = talloc_asprintf(mem_ctx, "0x%x", handles_private->container_handle);
-
-	if (dbuf.dptr && strlen(container_handle_str) == dbuf.dsize && strncmp((const char *)dbuf.dptr, container_handle_str, dbuf.dsize) == 0) {
-		handle_str = talloc_strndup(mem_ctx, (char *)key.dptr, key.dsize);
-		OC_DEBUG(5, "handles being released must NOT have child handles attached to them (%s is a child of %s)", handle_str, container_handle_str);
-		handle = strtol((const char *) handle_str, NULL, 16);
-		/* abort(); */
-		/* DEBUG(5, ("deleting child handle: %d, %s\n", handle, handle_str)); */
-		mapi_handles_delete(handles_private->handles_ctx, handle);
+	struct mapi_handles	*children;
+	struct mapi_handles	*child;
+
+	children = el->children;
+	el->children = NULL;
+
+	mapi_handles_slot_free(handles_ctx, MAPI_HANDLES_INDEX(el->handle));
+	handles_ctx->handles_count -= 1;
+	talloc_free(el);
+
+	/* Delete hierarchy of children */
+	while ((child = children) != NULL) {
+		OC_DEBUG(5, "handles being released must NOT have child handles attached to them (0x%x is a child of 0x%x)",
+			 child->handle, child->parent_handle);
+		DLIST_REMOVE(children, child);
+		child->parent = NULL;
+		mapi_handles_destroy(handles_ctx, child);
 	}
-
-	talloc_free(mem_ctx);
-
-	return 0;
 }
 
 
-
 /**
    \details Remove the MAPI handle referenced by the handle parameter
-   from the double chained list and mark its associated TDB record as
-   null
+   from the handles table and release its children
 
    \param handles_ctx pointer to the MAPI handles context
    \param handle the handle to delete
@@ -453,56 +353,30 @@ static int mapi_handles_traverse_delete(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ enum MAPISTATUS mapi_handles_delete(struct mapi_handles_context *handles_ctx, 
 					     uint32_t handle)
 {
-	TALLOC_CTX			*mem_ctx;
 	enum MAPISTATUS			retval;
-	TDB_DATA			key;
-	struct mapi_handles		*el;
-	struct mapi_handles_private	handles_private;
-	int				ret;
-	bool				found = false;
+	struct mapi_handles		*el = NULL;
 
 	/* Sanity checks */
 	OPENCHANGE_RETVAL_IF(!handles_ctx, MAPI_E_NOT_INITIALIZED, NULL);
-	OPENCHANGE_RETVAL_IF(!handles_ctx->tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!handles_ctx->slots, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(handle == MAPI_HANDLES_RESERVED, MAPI_E_INVALID_PARAMETER, NULL);
 
-	OC_DEBUG(4, "Deleting MAPI handle 0x%x (handles_ctx: %p, tdb_ctx: %p)",
-		  handle, handles_ctx, handles_ctx->tdb_ctx);
-
-	mem_ctx = talloc_named(NULL, 0, "mapi_handles_delete");
-
-	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", handle);
-	key.dsize = strlen((const char *)key.dptr);
+	OC_DEBUG(4, "Deleting MAPI handle 0x%x (handles_ctx: %p)", handle, handles_ctx);
 
 	/* Step 1. Make sure the record exists */
-	ret = tdb_exists(handles_ctx->tdb_ctx, key);
-	OPENCHANGE_RETVAL_IF(!ret, MAPI_E_NOT_FOUND, mem_ctx);
-
-	/* Step 2. Delete this record from the double chained list */
-	for (el = handles_ctx->handles; el; el = el->next) {
-		if (el->handle == handle) {
-			DLIST_REMOVE(handles_ctx->handles, el);
-			talloc_free(el);
-			found = true;
-			break;
-		}
-	}
-	/* This case should never occur */
-	OPENCHANGE_RETVAL_IF(found == false, MAPI_E_CORRUPT_STORE, mem_ctx);
-
-	/* Step 3. Free this record within the TDB database */
-	retval = mapi_handles_tdb_free(handles_ctx, handle);
-	/* if (retval) { */
-	/* 	abort(); */
-	/* } */
-	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+	retval = mapi_handles_search(handles_ctx, handle, &el);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
 
-	/* Step 4. Delete hierarchy of children */
-	handles_private.handles_ctx = handles_ctx;
-	handles_private.container_handle = handle;
-	ret = tdb_traverse(handles_ctx->tdb_ctx, mapi_handles_traverse_delete, (void *)&handles_private);
+	/* Step 2. Unlink this record from its container or the root list */
+	if (el->parent) {
+		DLIST_REMOVE(el->parent->children, el);
+	} else {
+		DLIST_REMOVE(handles_ctx->handles, el);
+	}
+	el->parent = NULL;
 
-	talloc_free(mem_ctx);
+	/* Step 3. Free this record and its hierarchy of children */
+	mapi_handles_destroy(handles_ctx, el);
 
 	OC_DEBUG(4, "Deleting MAPI handle 0x%x COMPLETE", handle);
 
@@ -27,6 +27,8 @@
  */
 
 #include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include "mapiproxy/dcesrv_mapiproxy.h"
 #include "mapiproxy/libmapiproxy/libmapiproxy.h"
@@ -37,15 +39,20 @@
 #include "mapiproxy/libmapiproxy/backends/openchangedb_mysql.h"
 #include "mapiproxy/libmapiproxy/backends/openchangedb_ldb.h"
 #include "mapiproxy/libmapiproxy/backends/openchangedb_logger.h"
+#include "mapiproxy/libmapiproxy/backends/openchangedb_cache.h"
+#include "mapiproxy/libmapiproxy/backends/openchangedb_profiler.h"
 
 const char *nil_string = "<nil>";
 
+static enum MAPISTATUS openchangedb_cn_lease_lock(struct openchangedb_context *, const char *);
+
 
 _PUBLIC_ enum MAPISTATUS openchangedb_initialize(TALLOC_CTX *mem_ctx,
 						 struct loadparm_context *lp_ctx,
 						 struct openchangedb_context **oc_ctx)
 {
 	enum MAPISTATUS retval;
+	int lease;
 	const char *openchangedb_backend = lpcfg_parm_string(lp_ctx, NULL, "mapiproxy",
 							     "openchangedb");
 
@@ -69,11 +76,59 @@ _PUBLIC_ enum MAPISTATUS openchangedb_initialize(TALLOC_CTX *mem_ctx,
 		return retval;
 	}
 
+	if (lpcfg_parm_bool(lp_ctx, NULL, "mapiproxy", "openchangedb_cache", false)) {
+		OC_DEBUG(0, "Loading OpenchangeDB cache module\n");
+		retval = openchangedb_cache_initialize(mem_ctx,
+						       lpcfg_parm_int(lp_ctx, NULL, "mapiproxy", "openchangedb_cache_size",
+								      OPENCHANGEDB_CACHE_MAX_ENTRIES),
+						       *oc_ctx, oc_ctx);
+		if (retval != MAPI_E_SUCCESS) {
+			return retval;
+		}
+	}
+
+	if (lpcfg_parm_bool(lp_ctx, NULL, "mapiproxy", "openchangedb_profiler", false)) {
+		const char *prefix = lpcfg_parm_string(lp_ctx, NULL, "mapiproxy",
+						       "openchangedb_profiler_prefix");
+		char *default_prefix = NULL;
+
+		if (!prefix) {
+			default_prefix = talloc_asprintf(mem_ctx, "%s/openchangedb_profiler",
+							 lpcfg_private_dir(lp_ctx));
+			prefix = default_prefix;
+		}
+		OC_DEBUG(0, "Loading OpenchangeDB profiler module\n");
+		retval = openchangedb_profiler_initialize(mem_ctx, prefix,
+							  lpcfg_parm_int(lp_ctx, NULL, "mapiproxy",
+									 "openchangedb_profiler_interval", 0),
+							  *oc_ctx, oc_ctx);
+		talloc_free(default_prefix);
+		if (retval != MAPI_E_SUCCESS) {
+			return retval;
+		}
+	}
+
 	if (lpcfg_parm_bool(lp_ctx, NULL, "mapiproxy", "openchangedb_logger", false)) {
 		const char *prefix = lpcfg_parm_string(lp_ctx, NULL, "mapiproxy",
 						       "openchangedb_logger_prefix");
 		OC_DEBUG(0, "Loading OpenchangeDB logger module\n");
 		retval = openchangedb_logger_initialize(mem_ctx, 0, prefix, *oc_ctx, oc_ctx);
+		if (retval != MAPI_E_SUCCESS) {
+			return retval;
+		}
+	}
+
+	lease = lpcfg_parm_int(lp_ctx, NULL, "mapiproxy", "openchangedb_cn_lease", 0);
+	if (lease > 1) {
+		char *lock_path = talloc_asprintf(mem_ctx, "%s/openchangedb_cn_lease.lock",
+						  lpcfg_private_dir(lp_ctx));
+
+		OC_DEBUG(0, "Leasing OpenchangeDB change numbers by blocks of %d\n", lease);
+		retval = openchangedb_set_changeNumber_lease(*oc_ctx, lease);
+		if (retval == MAPI_E_SUCCESS) {
+			retval = openchangedb_cn_lease_lock(*oc_ctx, lock_path);
+		}
+		talloc_free(lock_path);
 	}
 
 	return retval;
@@ -567,6 +622,310 @@ _PUBLIC_ char *openchangedb_set_folder_property_data(TALLOC_CTX *mem_ctx,
 	return data;
 }
 
+/* Range of change numbers reserved in the database for a mailbox
+ * owner, next_cn and end are raw GlobalCount values */
+struct openchangedb_cn_lease {
+	struct openchangedb_cn_lease		*prev;
+	struct openchangedb_cn_lease		*next;
+	char					*username;
+	uint64_t				next_cn;
+	uint64_t				end;
+};
+
+struct openchangedb_cn_allocator {
+	struct openchangedb_cn_allocator	*prev;
+	struct openchangedb_cn_allocator	*next;
+	struct openchangedb_context		*oc_ctx;
+	uint32_t				size;
+	pid_t					pid;
+	int					lock_fd;
+	struct openchangedb_cn_lease		*leases;
+#if defined(HAVE_PTHREADS)
+	pthread_mutex_t				lock;
+#endif
+};
+
+/* Allocators whose leases are given back when the process exits */
+static struct openchangedb_cn_allocator	*cn_allocators = NULL;
+
+static inline void openchangedb_cn_lock(struct openchangedb_cn_allocator *allocator)
+{
+#if defined(HAVE_PTHREADS)
+	pthread_mutex_lock(&allocator->lock);
+#endif
+}
+
+static inline void openchangedb_cn_unlock(struct openchangedb_cn_allocator *allocator)
+{
+#if defined(HAVE_PTHREADS)
+	pthread_mutex_unlock(&allocator->lock);
+#endif
+}
+
+static inline uint64_t openchangedb_cn_format(uint64_t globcnt)
+{
+	return (exchange_globcnt(globcnt) << 16) | 0x0001;
+}
+
+/**
+   \details Give the unused part of every lease back to the database
+   and forget them. Must be called with the allocator lock held.
+
+   Leases inherited by a forked process are dropped without being
+   released: they still belong to the parent.
+ */
+static void openchangedb_cn_release_leases(struct openchangedb_cn_allocator *allocator)
+{
+	struct openchangedb_context	*oc_ctx = allocator->oc_ctx;
+	struct openchangedb_cn_lease	*lease;
+	bool				owner = (allocator->pid == getpid());
+
+	while ((lease = allocator->leases) != NULL) {
+		if (owner && lease->next_cn < lease->end && oc_ctx->release_changeNumbers) {
+			oc_ctx->release_changeNumbers(oc_ctx, lease->username,
+						      openchangedb_cn_format(lease->next_cn),
+						      openchangedb_cn_format(lease->end));
+		}
+		DLIST_REMOVE(allocator->leases, lease);
+		talloc_free(lease);
+	}
+}
+
+static int openchangedb_cn_allocator_destructor(struct openchangedb_cn_allocator *allocator)
+{
+	openchangedb_cn_lock(allocator);
+	openchangedb_cn_release_leases(allocator);
+	openchangedb_cn_unlock(allocator);
+
+	DLIST_REMOVE(cn_allocators, allocator);
+#if defined(HAVE_PTHREADS)
+	pthread_mutex_destroy(&allocator->lock);
+#endif
+	if (allocator->lock_fd != -1) {
+		close(allocator->lock_fd);
+	}
+	return 0;
+}
+
+static void openchangedb_cn_atexit(void)
+{
+	struct openchangedb_cn_allocator	*allocator;
+
+	for (allocator = cn_allocators; allocator; allocator = allocator->next) {
+		openchangedb_cn_lock(allocator);
+		openchangedb_cn_release_leases(allocator);
+		openchangedb_cn_unlock(allocator);
+	}
+}
+
+/**
+   \details Enable or disable change number leasing
+
+   When enabled, change numbers are reserved in the database by blocks
+   of size and then handed out from memory, so allocating a change
+   number no longer costs a database round trip. The unused part of
+   the leases is given back when leasing is disabled, when the context
+   is freed and when the process exits, provided no other process
+   reserved numbers in the meantime.
+
+   Incremental synchronization expects change numbers to be issued in
+   commit order, which leases only guarantee when the calling process
+   is the only one allocating change numbers from the database. Forked
+   processes are refused change numbers.
+
+   This function is not thread-safe and should be called before the
+   context is shared.
+
+   \param oc_ctx pointer to the openchange DB context
+   \param size number of change numbers per lease, 0 or 1 to disable
+   leasing
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_set_changeNumber_lease(struct openchangedb_context *oc_ctx, uint32_t size)
+{
+	struct openchangedb_cn_allocator	*allocator;
+	static bool				atexit_registered = false;
+
+	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+
+	allocator = oc_ctx->cn_allocator;
+	if (size <= 1) {
+		oc_ctx->cn_allocator = NULL;
+		talloc_free(allocator);
+		return MAPI_E_SUCCESS;
+	}
+
+	if (allocator) {
+		openchangedb_cn_lock(allocator);
+		openchangedb_cn_release_leases(allocator);
+		allocator->size = size;
+		openchangedb_cn_unlock(allocator);
+		return MAPI_E_SUCCESS;
+	}
+
+	allocator = talloc_zero(oc_ctx, struct openchangedb_cn_allocator);
+	OPENCHANGE_RETVAL_IF(!allocator, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	allocator->oc_ctx = oc_ctx;
+	allocator->size = size;
+	allocator->pid = getpid();
+	allocator->lock_fd = -1;
+#if defined(HAVE_PTHREADS)
+	OPENCHANGE_RETVAL_IF(pthread_mutex_init(&allocator->lock, NULL), MAPI_E_CALL_FAILED, allocator);
+#endif
+	DLIST_ADD(cn_allocators, allocator);
+	talloc_set_destructor(allocator, openchangedb_cn_allocator_destructor);
+
+	if (!atexit_registered) {
+		atexit(openchangedb_cn_atexit);
+		atexit_registered = true;
+	}
+
+	oc_ctx->cn_allocator = allocator;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Make sure no other process leases change numbers from the
+   same database
+
+   An exclusive lock is held on lock_path for as long as leasing is
+   enabled. It is released when the process exits.
+
+   \param oc_ctx pointer to the openchange DB context
+   \param lock_path path of the lock file
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_BUSY if another process
+   holds the lock, otherwise MAPI error
+ */
+static enum MAPISTATUS openchangedb_cn_lease_lock(struct openchangedb_context *oc_ctx, const char *lock_path)
+{
+	struct openchangedb_cn_allocator	*allocator;
+	struct flock				lock;
+	int					fd;
+
+	OPENCHANGE_RETVAL_IF(!oc_ctx || !oc_ctx->cn_allocator, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!lock_path, MAPI_E_INVALID_PARAMETER, NULL);
+
+	allocator = oc_ctx->cn_allocator;
+	if (allocator->lock_fd != -1) {
+		return MAPI_E_SUCCESS;
+	}
+
+	fd = open(lock_path, O_RDWR|O_CREAT|O_CLOEXEC, 0600);
+	if (fd == -1) {
+		OC_DEBUG(0, "Unable to open %s: %s", lock_path, strerror(errno));
+		openchangedb_set_changeNumber_lease(oc_ctx, 0);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NO_ACCESS, NULL);
+	}
+
+	memset(&lock, 0, sizeof (struct flock));
+	lock.l_type = F_WRLCK;
+	lock.l_whence = SEEK_SET;
+	if (fcntl(fd, F_SETLK, &lock) == -1) {
+		OC_DEBUG(0, "mapiproxy:openchangedb_cn_lease requires a single server process "
+			 "but change numbers are already leased by another one (%s)", lock_path);
+		close(fd);
+		openchangedb_set_changeNumber_lease(oc_ctx, 0);
+		OPENCHANGE_RETVAL_ERR(MAPI_E_BUSY, NULL);
+	}
+	allocator->lock_fd = fd;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Give the unused change numbers leased by this process back
+   to the database
+
+   \param oc_ctx pointer to the openchange DB context
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_release_changeNumbers(struct openchangedb_context *oc_ctx)
+{
+	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+
+	if (oc_ctx->cn_allocator) {
+		openchangedb_cn_lock(oc_ctx->cn_allocator);
+		openchangedb_cn_release_leases(oc_ctx->cn_allocator);
+		openchangedb_cn_unlock(oc_ctx->cn_allocator);
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Take count consecutive change numbers from the lease of a
+   mailbox owner, leasing a new block from the database when the
+   current one is exhausted. The remainder of an exhausted block is
+   dropped, leaving a gap in the sequence.
+
+   \param oc_ctx pointer to the openchange DB context
+   \param username current user
+   \param count number of change numbers to take
+   \param first pointer to the first raw GlobalCount value taken
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS openchangedb_cn_lease_take(struct openchangedb_context *oc_ctx,
+						  const char *username, uint64_t count,
+						  uint64_t *first)
+{
+	TALLOC_CTX				*mem_ctx;
+	struct openchangedb_cn_allocator	*allocator = oc_ctx->cn_allocator;
+	struct openchangedb_cn_lease		*lease;
+	struct UI8Array_r			*cns;
+	enum MAPISTATUS				retval;
+	uint64_t				block;
+
+	openchangedb_cn_lock(allocator);
+
+	/* Change numbers would no longer be issued in commit order */
+	if (allocator->pid != getpid()) {
+		openchangedb_cn_unlock(allocator);
+		OC_DEBUG(0, "Change numbers cannot be leased from a forked process: "
+			 "run a single server process or disable mapiproxy:openchangedb_cn_lease");
+		OPENCHANGE_RETVAL_ERR(MAPI_E_NO_SUPPORT, NULL);
+	}
+
+	for (lease = allocator->leases; lease; lease = lease->next) {
+		if (!strcmp(lease->username, username)) break;
+	}
+
+	if (!lease || lease->end - lease->next_cn < count) {
+		if (!lease) {
+			lease = talloc_zero(allocator, struct openchangedb_cn_lease);
+			if (!lease || !(lease->username = talloc_strdup(lease, username))) {
+				talloc_free(lease);
+				openchangedb_cn_unlock(allocator);
+				OPENCHANGE_RETVAL_ERR(MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+			}
+			DLIST_ADD(allocator->leases, lease);
+		}
+
+		block = (count > allocator->size) ? count : allocator->size;
+		mem_ctx = talloc_new(NULL);
+		retval = oc_ctx->get_new_changeNumbers(oc_ctx, mem_ctx, username, block, &cns);
+		if (retval != MAPI_E_SUCCESS) {
+			talloc_free(mem_ctx);
+			openchangedb_cn_unlock(allocator);
+			OPENCHANGE_RETVAL_ERR(retval, NULL);
+		}
+		lease->next_cn = exchange_globcnt(cns->lpui8[0] >> 16);
+		lease->end = lease->next_cn + block;
+		talloc_free(mem_ctx);
+	}
+
+	*first = lease->next_cn;
+	lease->next_cn += count;
+
+	openchangedb_cn_unlock(allocator);
+
+	return MAPI_E_SUCCESS;
+}
+
 /**
    \details Allocates a new change number and returns it
    
@@ -578,10 +937,21 @@ _PUBLIC_ char *openchangedb_set_folder_property_data(TALLOC_CTX *mem_ctx,
  */
 _PUBLIC_ enum MAPISTATUS openchangedb_get_new_changeNumber(struct openchangedb_context *oc_ctx, const char *username, uint64_t *cn)
 {
+	enum MAPISTATUS	retval;
+	uint64_t	globcnt;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!cn, MAPI_E_INVALID_PARAMETER, NULL);
 
+	if (oc_ctx->cn_allocator) {
+		retval = openchangedb_cn_lease_take(oc_ctx, username, 1, &globcnt);
+		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
+
+		*cn = openchangedb_cn_format(globcnt);
+		return MAPI_E_SUCCESS;
+	}
+
 	return oc_ctx->get_new_changeNumber(oc_ctx, username, cn);
 }
 
@@ -603,10 +973,33 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_new_changeNumbers(struct openchangedb_
 							    uint64_t max,
 							    struct UI8Array_r **cns_p)
 {
+	enum MAPISTATUS		retval;
+	struct UI8Array_r	*cns;
+	uint64_t		globcnt;
+	uint64_t		i;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!cns_p, MAPI_E_INVALID_PARAMETER, NULL);
 
+	/* Batches larger than a lease go straight to the database */
+	if (oc_ctx->cn_allocator && max && max < oc_ctx->cn_allocator->size) {
+		retval = openchangedb_cn_lease_take(oc_ctx, username, max, &globcnt);
+		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
+
+		cns = talloc_zero(mem_ctx, struct UI8Array_r);
+		OPENCHANGE_RETVAL_IF(!cns, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		cns->cValues = max;
+		cns->lpui8 = talloc_array(cns, uint64_t, max);
+		OPENCHANGE_RETVAL_IF(!cns->lpui8, MAPI_E_NOT_ENOUGH_MEMORY, cns);
+		for (i = 0; i < max; i++) {
+			cns->lpui8[i] = openchangedb_cn_format(globcnt + i);
+		}
+
+		*cns_p = cns;
+		return MAPI_E_SUCCESS;
+	}
+
 	return oc_ctx->get_new_changeNumbers(oc_ctx, mem_ctx, username, max, cns_p);
 }
 
@@ -622,10 +1015,29 @@ _PUBLIC_ enum MAPISTATUS openchangedb_get_new_changeNumbers(struct openchangedb_
  */
 _PUBLIC_ enum MAPISTATUS openchangedb_get_next_changeNumber(struct openchangedb_context *oc_ctx, const char *username, uint64_t *cn)
 {
+	struct openchangedb_cn_allocator	*allocator;
+	struct openchangedb_cn_lease		*lease;
+
 	OPENCHANGE_RETVAL_IF(!oc_ctx, MAPI_E_NOT_INITIALIZED, NULL);
 	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
 	OPENCHANGE_RETVAL_IF(!cn, MAPI_E_INVALID_PARAMETER, NULL);
 
+	allocator = oc_ctx->cn_allocator;
+	if (allocator) {
+		openchangedb_cn_lock(allocator);
+		if (allocator->pid == getpid()) {
+			for (lease = allocator->leases; lease; lease = lease->next) {
+				if (!strcmp(lease->username, username)) break;
+			}
+			if (lease && lease->next_cn < lease->end) {
+				*cn = openchangedb_cn_format(lease->next_cn);
+				openchangedb_cn_unlock(allocator);
+				return MAPI_E_SUCCESS;
+			}
+		}
+		openchangedb_cn_unlock(allocator);
+	}
+
 	return oc_ctx->get_next_changeNumber(oc_ctx, username, cn);
 }
 
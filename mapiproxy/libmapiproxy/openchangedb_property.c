@@ -580,33 +580,238 @@ static struct pidtags pidtags[] = {
 	{ 0,                                                                   NULL         }
 };
 
+#define PIDTAGS_TAG_SIZE 566
+
+static const int16_t pidtags_tag_displace[PIDTAGS_TAG_SIZE] = {
+	-3, -5, 0, -9, 1, -12, 0, -13, -17, 1, 0, -19,
+	0, 1, 5, 0, 0, 2, -21, 1, -22, 1, 0, 4,
+	2, 0, 2, 0, 1, -28, -30, -33, 0, 0, 0, 0,
+	1, 1, 4, -34, -35, 0, 1, -36, -38, -39, -41, 0,
+	1, 3, -47, 0, 1, -55, 3, 0, -58, 0, 0, 0,
+	1, 2, 0, -59, 1, 2, -61, 1, 0, -63, 1, -64,
+	0, 0, -68, 0, -73, 0, 1, 2, 0, -76, 2, 0,
+	1, 2, 6, 0, 0, -77, 0, 0, -81, 0, 1, 0,
+	-83, 0, 1, 1, 0, 2, -86, 0, 0, 2, 0, -88,
+	-90, 0, 0, -95, 1, 0, 0, 1, 0, 0, -103, 0,
+	0, 1, -104, 0, 0, 0, -109, 3, 5, 1, -111, -112,
+	0, 4, 0, 0, 0, 0, -113, -114, 0, 0, 0, 0,
+	-115, -119, -120, 0, 0, 2, 0, 0, -124, 0, 2, 0,
+	0, -128, -129, 4, 2, 0, 2, -130, 2, -131, 0, 5,
+	-133, -139, 0, -140, 1, 1, 1, 2, 1, -144, 0, 0,
+	0, 0, 0, -145, 1, -147, 6, -154, -157, 0, -159, -161,
+	3, -164, -165, 0, -168, 8, 2, 3, -169, -170, 0, -172,
+	0, 1, 1, 2, -175, 0, -176, 0, 1, 0, 0, 0,
+	0, -178, 0, 3, -179, 0, 0, 1, -186, -190, 0, -191,
+	1, 1, 4, 1, 0, -193, 1, 0, 2, -198, -203, -205,
+	2, 0, -208, 1, -211, 0, -212, 0, 0, 0, 0, 0,
+	0, 0, 0, -215, -218, 1, -219, 0, 8, -227, 0, 0,
+	-228, 0, -230, -237, 0, 1, 0, 0, 5, 0, 3, 1,
+	1, -239, 0, 0, 0, 0, -244, 4, 1, 0, -245, -246,
+	-247, 3, 0, 0, 0, -248, -250, 0, -252, -255, 4, -259,
+	3, 1, -260, 0, -262, 4, 3, 0, 1, 0, 3, -263,
+	0, 0, -265, 0, 0, -267, 0, 3, 1, -271, -272, -274,
+	-281, -287, 3, -289, 1, 0, -293, -296, -298, -299, 0, -300,
+	-304, 0, 0, 3, -314, 0, 0, 0, -315, -316, 0, 2,
+	0, 5, -317, 14, 0, -328, -333, 0, -338, 0, -339, 0,
+	0, -341, -342, -344, -347, -353, -355, 0, 0, -356, 0, 0,
+	0, 0, 0, -360, -362, 3, 0, 0, 1, 6, 0, 9,
+	4, -365, 0, 0, 4, 1, 0, -367, 0, 0, -368, -369,
+	-370, 0, 0, 0, 0, 0, -374, 0, 0, -375, 1, -377,
+	-379, -392, -393, -396, -403, 8, 0, -408, -414, 2, -421, 7,
+	0, 0, 3, 4, -422, -426, 0, 0, 0, 4, -427, -430,
+	5, 0, 0, -433, -434, 0, 8, -436, -440, -441, 8, 0,
+	-443, 0, 1, -445, -446, 0, 5, 14, -447, 0, -454, -455,
+	0, -457, 5, 0, 0, 1, -458, -461, -462, 0, 0, 0,
+	-465, 9, 0, 0, 13, 3, 0, 1, 6, 0, 1, -473,
+	0, -474, 0, 0, 0, 5, -479, 1, 1, 1, 2, -481,
+	0, 0, 0, 3, 0, 0, 6, -484, 0, 1, 0, -487,
+	-490, -492, 2, 0, -494, 2, 6, 0, -495, 4, 0, -498,
+	1, 4, -501, -502, 0, -504, -506, 0, 6, -507, 0, -517,
+	0, 0, 0, -519, -524, 2, 1, -530, -537, 0, -538, -539,
+	7, 2, -544, -545, -547, -549, -553, 0, 0, 10, 0, -555,
+	1, -559, 1, -560, -561, 9, -564, 0, 0, 0, -566, 3,
+	0, 0,
+};
+
+static const uint16_t pidtags_tag_slots[PIDTAGS_TAG_SIZE] = {
+	374, 399, 164, 452, 458, 179, 183, 347, 70, 35, 531, 84,
+	295, 51, 431, 446, 135, 111, 131, 134, 20, 422, 145, 163,
+	315, 99, 120, 127, 462, 255, 2, 444, 419, 369, 412, 484,
+	413, 359, 561, 268, 472, 509, 492, 320, 551, 95, 461, 325,
+	168, 457, 83, 184, 420, 205, 76, 516, 465, 511, 407, 510,
+	402, 479, 368, 306, 548, 324, 147, 361, 559, 190, 227, 218,
+	180, 331, 530, 68, 449, 478, 158, 156, 136, 316, 265, 52,
+	455, 246, 317, 81, 437, 280, 143, 550, 555, 309, 16, 137,
+	89, 29, 326, 115, 240, 487, 273, 443, 328, 288, 165, 506,
+	257, 172, 169, 126, 363, 311, 123, 82, 71, 504, 512, 519,
+	19, 381, 193, 260, 121, 297, 358, 292, 529, 502, 523, 245,
+	498, 410, 352, 60, 322, 173, 263, 323, 450, 356, 329, 167,
+	122, 128, 232, 319, 414, 373, 75, 239, 174, 175, 389, 554,
+	421, 522, 153, 543, 146, 415, 341, 226, 333, 274, 537, 398,
+	375, 49, 101, 301, 390, 98, 310, 94, 432, 299, 215, 408,
+	56, 460, 4, 377, 357, 283, 360, 277, 78, 221, 26, 69,
+	102, 91, 73, 93, 242, 340, 552, 185, 176, 233, 490, 334,
+	533, 72, 65, 104, 427, 314, 267, 547, 556, 30, 501, 307,
+	335, 203, 97, 346, 337, 287, 525, 234, 181, 54, 47, 125,
+	557, 154, 371, 42, 290, 160, 213, 67, 563, 109, 80, 321,
+	225, 376, 206, 284, 425, 468, 294, 103, 433, 43, 488, 401,
+	496, 96, 196, 251, 46, 130, 36, 198, 138, 238, 435, 281,
+	564, 13, 403, 526, 440, 10, 558, 514, 313, 270, 235, 44,
+	199, 486, 396, 507, 38, 141, 330, 50, 503, 194, 64, 386,
+	336, 161, 447, 300, 236, 508, 217, 237, 348, 74, 379, 252,
+	223, 39, 177, 536, 256, 545, 451, 518, 23, 14, 298, 285,
+	535, 88, 62, 77, 534, 87, 37, 204, 473, 409, 191, 7,
+	271, 45, 400, 48, 349, 151, 155, 560, 162, 417, 469, 201,
+	312, 90, 383, 187, 228, 118, 170, 61, 540, 541, 31, 230,
+	57, 254, 110, 247, 150, 282, 544, 513, 475, 549, 539, 318,
+	364, 565, 442, 142, 231, 262, 244, 362, 342, 343, 195, 166,
+	6, 429, 497, 394, 85, 275, 107, 296, 32, 148, 517, 542,
+	279, 202, 216, 250, 438, 224, 480, 1, 459, 269, 332, 11,
+	308, 456, 289, 524, 106, 178, 370, 197, 430, 278, 249, 355,
+	214, 59, 55, 229, 208, 448, 25, 485, 474, 105, 494, 434,
+	445, 261, 8, 366, 258, 481, 0, 424, 17, 253, 21, 144,
+	207, 489, 391, 15, 28, 209, 339, 491, 124, 493, 416, 546,
+	305, 149, 499, 304, 171, 418, 119, 114, 515, 553, 453, 387,
+	41, 500, 293, 58, 220, 382, 133, 466, 27, 222, 467, 152,
+	528, 53, 24, 159, 272, 470, 210, 266, 63, 428, 354, 378,
+	33, 302, 192, 426, 477, 439, 12, 384, 372, 351, 291, 92,
+	388, 5, 211, 100, 397, 463, 365, 189, 79, 367, 248, 9,
+	243, 483, 212, 521, 3, 353, 344, 527, 259, 454, 482, 393,
+	385, 423, 40, 476, 34, 562, 406, 405, 303, 392, 338, 345,
+	219, 532, 18, 132, 113, 86, 264, 327, 404, 117, 108, 436,
+	395, 66, 276, 538, 286, 157, 441, 520, 129, 471, 186, 495,
+	350, 200, 139, 188, 116, 140, 241, 182, 411, 22, 112, 380,
+	464, 505,
+};
+
+#define PIDTAGS_ID_SIZE 540
+
+static const int16_t pidtags_id_displace[PIDTAGS_ID_SIZE] = {
+	-3, -4, 0, 1, 0, 1, -5, 0, 0, -7, -11, 0,
+	0, 1, 0, 0, 0, 0, 0, 1, -15, 0, -18, -21,
+	3, 0, 1, -23, -25, 0, -27, -28, 1, 0, 2, -29,
+	-30, 1, -32, 0, -38, 1, -41, 0, -44, 1, 0, 0,
+	0, -54, 3, -55, -56, -57, 0, -58, -62, 2, -63, 0,
+	-65, 0, 0, 1, -66, 1, 1, -69, 2, -70, 3, -71,
+	-73, 0, -74, 0, -77, -79, -80, 0, -82, 0, -84, 2,
+	-85, 3, 0, 3, -86, -91, 0, -93, -94, 0, 0, 6,
+	-100, -103, 1, -109, 0, 0, -111, 1, 0, 2, -113, -115,
+	0, -117, -118, 2, 1, -119, -123, 0, 1, 0, 0, -127,
+	-129, 0, 1, 0, -136, 5, 2, 0, 0, -140, 3, 0,
+	2, -141, 0, 1, 0, -142, 0, 0, 2, 0, 1, 2,
+	-143, -144, 1, 0, 0, 0, 0, 2, -149, -153, -154, 0,
+	0, 1, 0, 2, 2, 0, 1, 3, 0, 0, 0, -158,
+	5, -160, 8, -164, -166, -168, 0, 1, -169, 1, -171, 0,
+	0, 0, 0, 0, 0, 2, 1, -172, -173, 3, 1, 0,
+	1, -174, -179, -181, -185, 0, 0, 0, -186, -190, 0, 0,
+	0, -194, 1, -195, 2, 0, -198, -199, 0, 1, 1, 0,
+	0, 3, 0, 0, 0, -200, 0, -202, 0, -205, 0, 0,
+	0, 7, 2, -206, -209, 0, 0, 4, -210, -211, -214, -215,
+	-218, 0, -219, -220, -229, 0, -231, -236, 0, 0, -239, -240,
+	0, -241, 0, 0, -245, 0, -246, 1, 1, 0, 0, -247,
+	1, 1, -248, 0, -250, -254, 0, 3, -255, -257, -258, 0,
+	2, -259, -260, 0, 0, 0, 0, 0, 0, -262, -264, 0,
+	0, 0, -265, 1, 2, -266, -267, -268, 0, -269, -270, -277,
+	-281, -282, 0, -291, 0, 3, 0, -292, 1, -293, 5, 1,
+	-297, -302, 1, -304, 2, -305, -309, 0, 7, -313, 0, -316,
+	-320, 3, -321, 1, -323, -325, 0, 5, 0, 3, 0, -329,
+	-330, 6, 0, -338, -340, -345, -346, 0, 0, 2, 0, 0,
+	0, 0, -356, 4, 0, 0, 0, 0, 1, 1, -357, -365,
+	-367, -368, -371, 6, -373, 4, 0, -377, -378, 2, -380, -382,
+	-386, 0, 0, 1, 0, 0, -390, 4, 0, 1, 0, -391,
+	-392, 0, -395, -396, 1, 0, 0, 0, 0, 3, -397, 0,
+	-400, 5, 3, -402, -403, 2, 0, 1, -406, 0, -409, 0,
+	0, 1, 5, 0, -410, -412, 1, 4, 3, 0, -414, -415,
+	0, 0, 0, -418, 14, -421, -422, 2, 0, 0, 2, -423,
+	-424, 0, 0, -427, 4, -431, 0, -432, 1, 7, 5, -433,
+	0, -434, 0, -439, 0, -442, -444, 0, 0, 0, 0, 0,
+	6, 0, 6, 1, 0, 0, -445, 0, -448, 0, -456, 0,
+	0, -458, 0, -466, -468, 1, -469, 0, -471, -473, 0, -475,
+	0, -476, 4, -477, 1, -483, -484, -486, -487, 0, -488, 0,
+	3, 0, -492, 0, 5, 9, -497, -499, 4, -502, 0, 8,
+	0, -506, 0, -507, 0, -508, -510, 3, 3, -512, 1, -515,
+	-519, -521, 0, 0, 3, -523, -527, 4, 9, 2, -532, 0,
+	0, -536, 0, 0, 4, -537, 0, 4, 0, 0, 10, -538,
+};
+
+static const uint16_t pidtags_id_slots[PIDTAGS_ID_SIZE] = {
+	234, 540, 2, 120, 170, 330, 499, 114, 14, 297, 238, 185,
+	411, 94, 202, 396, 117, 240, 16, 65, 180, 249, 116, 298,
+	492, 19, 181, 324, 336, 25, 130, 244, 538, 348, 136, 141,
+	256, 91, 232, 531, 41, 172, 63, 82, 454, 553, 89, 278,
+	494, 525, 9, 316, 83, 344, 102, 516, 12, 355, 247, 34,
+	430, 371, 374, 551, 246, 155, 84, 373, 401, 61, 301, 358,
+	81, 279, 472, 387, 167, 47, 186, 502, 131, 328, 36, 293,
+	449, 184, 132, 511, 109, 216, 32, 549, 521, 465, 295, 534,
+	6, 206, 33, 423, 225, 500, 338, 388, 173, 3, 42, 207,
+	379, 274, 198, 270, 262, 20, 97, 201, 124, 305, 26, 522,
+	370, 424, 86, 257, 222, 359, 125, 455, 221, 135, 367, 169,
+	121, 391, 1, 564, 312, 382, 350, 542, 154, 43, 243, 503,
+	96, 283, 349, 129, 507, 284, 69, 178, 393, 536, 187, 326,
+	434, 288, 408, 467, 478, 40, 398, 452, 554, 106, 493, 52,
+	111, 193, 448, 385, 287, 450, 208, 183, 15, 399, 191, 160,
+	21, 148, 309, 166, 245, 157, 30, 139, 149, 508, 313, 100,
+	223, 54, 200, 230, 242, 212, 377, 404, 310, 151, 80, 426,
+	233, 302, 339, 456, 415, 251, 526, 174, 451, 380, 519, 146,
+	545, 469, 161, 509, 286, 561, 461, 346, 55, 342, 403, 50,
+	471, 123, 291, 133, 543, 546, 489, 104, 88, 255, 22, 375,
+	35, 458, 101, 144, 440, 315, 445, 218, 439, 446, 29, 277,
+	220, 192, 27, 322, 541, 68, 529, 319, 427, 386, 77, 323,
+	487, 495, 214, 468, 7, 486, 412, 267, 147, 103, 406, 321,
+	356, 368, 241, 490, 268, 153, 113, 219, 497, 428, 433, 171,
+	437, 303, 4, 79, 443, 464, 229, 389, 175, 273, 209, 429,
+	436, 383, 276, 524, 78, 258, 56, 179, 263, 67, 376, 361,
+	523, 394, 264, 347, 250, 441, 362, 215, 314, 280, 400, 345,
+	266, 165, 164, 535, 126, 90, 275, 537, 421, 115, 483, 163,
+	17, 365, 425, 343, 39, 397, 110, 143, 162, 530, 53, 156,
+	252, 317, 158, 93, 28, 474, 70, 304, 381, 134, 112, 533,
+	307, 150, 363, 62, 137, 414, 159, 333, 491, 59, 431, 334,
+	435, 470, 190, 514, 13, 224, 520, 562, 318, 353, 329, 57,
+	74, 58, 351, 419, 260, 402, 294, 420, 66, 282, 92, 466,
+	460, 128, 0, 296, 197, 46, 196, 311, 505, 140, 496, 517,
+	272, 105, 518, 539, 405, 299, 265, 236, 337, 49, 501, 127,
+	515, 281, 513, 231, 51, 335, 5, 48, 73, 142, 269, 87,
+	271, 341, 422, 413, 418, 107, 152, 320, 369, 37, 447, 239,
+	261, 512, 38, 331, 432, 205, 72, 459, 199, 227, 228, 8,
+	119, 188, 289, 210, 95, 45, 544, 253, 528, 145, 195, 372,
+	182, 360, 194, 285, 475, 122, 390, 532, 453, 300, 416, 31,
+	463, 235, 364, 444, 76, 10, 354, 168, 60, 24, 213, 11,
+	357, 410, 99, 306, 477, 75, 327, 292, 176, 332, 407, 366,
+	64, 211, 510, 417, 378, 481, 204, 203, 71, 177, 340, 108,
+	23, 438, 462, 476, 98, 248, 325, 237, 442, 138, 409, 189,
+	352, 395, 527, 504, 254, 384, 259, 473, 506, 392, 488, 18,
+};
+
 static const char *_openchangedb_property_get_string_attribute(uint32_t proptag)
 {
-	uint32_t i;
-	uint32_t tag_id = (proptag >> 16);
+	const struct pidtags	*entry;
+	uint32_t		tag_id = (proptag >> 16);
+	int32_t			d;
+	uint32_t		slot;
 
-	for (i = 0; pidtags[i].pidtag; i++) {
-		if (tag_id == (pidtags[i].proptag >> 16)) {
-			return pidtags[i].pidtag;
-		}
-	}
+	d = pidtags_id_displace[mapi_phash_proptag(0, tag_id) % PIDTAGS_ID_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_proptag(d, tag_id) % PIDTAGS_ID_SIZE;
+	entry = &pidtags[pidtags_id_slots[slot]];
 
-	return NULL;
+	return (tag_id == (entry->proptag >> 16)) ? entry->pidtag : NULL;
 }
 
 _PUBLIC_ const char *openchangedb_property_get_attribute(uint32_t proptag)
 {
-	uint32_t i;
-	uint32_t prop_type = proptag & 0x0FFF;
+	const struct pidtags	*entry;
+	uint32_t		prop_type = proptag & 0x0FFF;
+	int32_t			d;
+	uint32_t		slot;
 
 	if (prop_type == PT_UNICODE || prop_type == PT_STRING8) {
 		return _openchangedb_property_get_string_attribute(proptag);
 	}
 
-	for (i = 0; pidtags[i].pidtag; i++) {
-		if (pidtags[i].proptag == proptag) {
-			return pidtags[i].pidtag;
-		}
+	d = pidtags_tag_displace[mapi_phash_proptag(0, proptag) % PIDTAGS_TAG_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_proptag(d, proptag) % PIDTAGS_TAG_SIZE;
+	entry = &pidtags[pidtags_tag_slots[slot]];
+	if (entry->proptag == proptag) {
+		return entry->pidtag;
 	}
 	OC_DEBUG(0, "Unsupported property tag '0x%.8x'", proptag);
 
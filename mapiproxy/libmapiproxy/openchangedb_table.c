@@ -105,3 +105,46 @@ _PUBLIC_ enum MAPISTATUS openchangedb_table_get_property(TALLOC_CTX *mem_ctx,
 
 	return self->table_get_property(mem_ctx, self, table_object, proptag, pos, live_filtered, data);
 }
+
+
+/**
+   \details Retrieve a window of rows x columns from an openchangedb
+   table in a single backend round trip
+
+   \param mem_ctx pointer to the memory context to use for allocation
+   \param self pointer to the openchangedb context
+   \param table_object pointer to the table object
+   \param proptags pointer to the list of columns to retrieve
+   \param pos position of the first row in the table
+   \param count number of rows to retrieve
+   \param live_filtered whether the rows have to be filtered live
+   \param data pointer on the array of count * proptags->cValues data
+   pointers to return, indexed by row then column
+   \param retvals pointer on the array of per-cell status to return
+
+   \note Cells are not cached by the backend: subsequent
+   openchangedb_table_get_property calls always see current values.
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_NOT_IMPLEMENTED if the
+   backend does not support batched fetch, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS openchangedb_table_get_properties(TALLOC_CTX *mem_ctx,
+							   struct openchangedb_context *self,
+							   void *table_object,
+							   struct SPropTagArray *proptags,
+							   uint32_t pos,
+							   uint32_t count,
+							   bool live_filtered,
+							   void ***data,
+							   enum MAPISTATUS **retvals)
+{
+	OPENCHANGE_RETVAL_IF(!self, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!table_object, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!proptags, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!data, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!retvals, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!self->table_get_properties, MAPI_E_NOT_IMPLEMENTED, NULL);
+
+	return self->table_get_properties(mem_ctx, self, table_object, proptags, pos, count,
+					  live_filtered, data, retvals);
+}
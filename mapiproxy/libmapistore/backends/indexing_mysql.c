@@ -495,10 +495,9 @@ static enum mapistore_error mysql_record_get_uri(struct indexing_context *ictx,
 						 char **urip,
 						 bool *soft_deletedp)
 {
-	int		ret;
-	char		*sql;
-	MYSQL_RES	*res = NULL;
-	MYSQL_ROW	row;
+	int			ret;
+	struct stmt_params	params;
+	const char		*row[2];
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -507,24 +506,18 @@ static enum mapistore_error mysql_record_get_uri(struct indexing_context *ictx,
 	MAPISTORE_RETVAL_IF(!urip, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!soft_deletedp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
+	stmt_params_init(&params);
+	stmt_bind_string(&params, username);
+	stmt_bind_u64(&params, fmid);
+	ret = stmt_select_row(mem_ctx, MYSQL(ictx),
+		"SELECT url, soft_deleted FROM "INDEXING_TABLE" "
+		"WHERE username = ? AND fmid = ?", &params, 2, row);
+	MAPISTORE_RETVAL_IF(ret == MYSQL_NOT_FOUND, MAPISTORE_ERR_NOT_FOUND, NULL);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, NULL);
 
-	sql = talloc_asprintf(mem_ctx,
-		"SELECT url, soft_deleted FROM %s "
-		"WHERE username = '%s' AND fmid = '%"PRIu64"'",
-		INDEXING_TABLE, _sql(mem_ctx, username), fmid);
-	MAPISTORE_RETVAL_IF(!sql, MAPISTORE_ERR_NO_MEMORY, NULL);
-
-	ret = select_without_fetch(MYSQL(ictx), sql, &res);
-	MAPISTORE_RETVAL_IF(ret == MYSQL_NOT_FOUND, MAPISTORE_ERR_NOT_FOUND, sql);
-	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, sql);
-
-	row = mysql_fetch_row(res);
-
-	*urip = talloc_strdup(mem_ctx, row[0]);
-	*soft_deletedp = strtoull(row[1], NULL, 0) == 1;
-
-	mysql_free_result(res);
-	talloc_free(sql);
+	*urip = (char *) row[0];
+	*soft_deletedp = row[1] && strtoull(row[1], NULL, 0) == 1;
+	talloc_free((char *) row[1]);
 
 	return MAPISTORE_SUCCESS;
 }
@@ -630,9 +623,10 @@ static enum mapistore_error mysql_record_get_fmid(struct indexing_context *ictx,
 {
 	enum mapistore_error	retval;
 	enum MYSQLRESULT	ret;
-	char			*sql, *uri_like;
-	MYSQL_RES		*res;
-	MYSQL_ROW		row;
+	char			*uri_like;
+	const char		*sql;
+	struct stmt_params	params;
+	const char		*row[2];
 	TALLOC_CTX		*mem_ctx;
 	uint64_t		fmid = 0;
 
@@ -652,30 +646,28 @@ static enum mapistore_error mysql_record_get_fmid(struct indexing_context *ictx,
 
 	mem_ctx = talloc_named(NULL, 0, "mysql_record_get_fmid");
 
-	sql = talloc_asprintf(mem_ctx,
-		"SELECT fmid, soft_deleted FROM "INDEXING_TABLE" "
-		"WHERE username = '%s'", _sql(mem_ctx, username));
-
+	stmt_params_init(&params);
+	stmt_bind_string(&params, username);
 	if (partial) {
 		uri_like = talloc_strdup(mem_ctx, uri);
+		MAPISTORE_RETVAL_IF(!uri_like, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
 		string_replace(uri_like, '*', '%');
-		sql = talloc_asprintf_append(sql, " AND url LIKE '%s'",
-					     _sql(mem_ctx, uri_like));
+		stmt_bind_string(&params, uri_like);
+		sql = "SELECT fmid, soft_deleted FROM "INDEXING_TABLE" "
+		      "WHERE username = ? AND url LIKE ?";
 	} else {
-		sql = talloc_asprintf_append(sql, " AND url = '%s'",
-					     _sql(mem_ctx, uri));
+		stmt_bind_string(&params, uri);
+		sql = "SELECT fmid, soft_deleted FROM "INDEXING_TABLE" "
+		      "WHERE username = ? AND url = ?";
 	}
 
-	ret = select_without_fetch(MYSQL(ictx), sql, &res);
+	ret = stmt_select_row(mem_ctx, MYSQL(ictx), sql, &params, 2, row);
 	MAPISTORE_RETVAL_IF(ret == MYSQL_NOT_FOUND, MAPISTORE_ERR_NOT_FOUND, mem_ctx);
 	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
 
-	row = mysql_fetch_row(res);
+	*fmidp = row[0] ? strtoull(row[0], NULL, 0) : 0;
+	*soft_deletedp = row[1] && strtoull(row[1], NULL, 0) == 1;
 
-	*fmidp = strtoull(row[0], NULL, 0);
-	*soft_deletedp = strtoull(row[1], NULL, 0) == 1;
-
-	mysql_free_result(res);
 	talloc_free(mem_ctx);
 
 	return MAPISTORE_SUCCESS;
@@ -33,6 +33,472 @@
 
 
 #define	TDB_WRAP(context)	((struct tdb_wrap*)context->data)
+#define	URI_INDEX(context)	((struct tdb_uri_index*)context->cache)
+
+/**
+   Sorted list of the URIs of the reverse keyspace, used to serve
+   partial URI lookups. It is only trusted while the TDB sequence
+   number matches the one it was built or last updated at.
+ */
+struct tdb_uri_index {
+	bool		valid;
+	bool		exact;
+	int		seqnum;
+	uint32_t	count;
+	uint32_t	size;
+	char		**uris;
+};
+
+/**
+   \details Return a copy of a URI without its trailing slash, the form
+   URIs are indexed with
+ */
+static char *tdb_uri_normalize(TALLOC_CTX *mem_ctx, const char *uri, size_t len)
+{
+	char	*normalized;
+
+	if (len && uri[len - 1] == '/') {
+		len--;
+	}
+	normalized = talloc_strndup(mem_ctx, uri, len);
+
+	return normalized;
+}
+
+static TDB_DATA tdb_uri_key(TALLOC_CTX *mem_ctx, const char *normalized_uri)
+{
+	TDB_DATA	key;
+
+	key.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s%s", MAPISTORE_URI_TAG, normalized_uri);
+	key.dsize = key.dptr ? strlen((const char *) key.dptr) : 0;
+
+	return key;
+}
+
+/**
+   \details Parse the value of a URI: record, which is the key of the
+   fmid record it points to
+ */
+static bool tdb_uri_value_parse(TDB_DATA value, uint64_t *fmidp, bool *soft_deletedp)
+{
+	char	buf[64];
+	size_t	tag_len = strlen(MAPISTORE_SOFT_DELETED_TAG);
+	char	*str = buf;
+
+	if (!value.dptr || !value.dsize || value.dsize >= sizeof(buf)) {
+		return false;
+	}
+	memcpy(buf, value.dptr, value.dsize);
+	buf[value.dsize] = '\0';
+
+	*soft_deletedp = false;
+	if (!strncmp(str, MAPISTORE_SOFT_DELETED_TAG, tag_len)) {
+		*soft_deletedp = true;
+		str += tag_len;
+	}
+	*fmidp = strtoull(str, NULL, 16);
+
+	return *fmidp != 0;
+}
+
+/**
+   \details Point the URI: record of uri to the fmid record, must be
+   called within a transaction
+ */
+static int tdb_uri_record_store(struct tdb_context *tdb, const char *normalized_uri,
+				uint64_t fmid, bool soft_deleted)
+{
+	TALLOC_CTX	*mem_ctx = talloc_new(NULL);
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	int		ret;
+
+	key = tdb_uri_key(mem_ctx, normalized_uri);
+	dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "%s0x%.16"PRIx64,
+						      soft_deleted ? MAPISTORE_SOFT_DELETED_TAG : "",
+						      fmid);
+	if (!key.dptr || !dbuf.dptr) {
+		talloc_free(mem_ctx);
+		return -1;
+	}
+	dbuf.dsize = strlen((const char *) dbuf.dptr);
+
+	ret = tdb_store(tdb, key, dbuf, TDB_REPLACE);
+	talloc_free(mem_ctx);
+
+	return ret;
+}
+
+/**
+   \details Remove the URI: record of uri if it still points to fmid,
+   must be called within a transaction
+
+   \return 1 if the record was removed, 0 if it was left alone, -1 on
+   error
+ */
+static int tdb_uri_record_del(struct tdb_context *tdb, const char *normalized_uri, uint64_t fmid)
+{
+	TALLOC_CTX	*mem_ctx = talloc_new(NULL);
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	uint64_t	indexed_fmid;
+	bool		soft_deleted;
+	int		ret = 0;
+
+	key = tdb_uri_key(mem_ctx, normalized_uri);
+	if (!key.dptr) {
+		talloc_free(mem_ctx);
+		return -1;
+	}
+
+	dbuf = tdb_fetch(tdb, key);
+	if (tdb_uri_value_parse(dbuf, &indexed_fmid, &soft_deleted) && indexed_fmid == fmid) {
+		ret = tdb_delete(tdb, key) ? -1 : 1;
+	}
+	free(dbuf.dptr);
+	talloc_free(mem_ctx);
+
+	return ret;
+}
+
+/**
+   \details Retrieve the normalized URI an fmid record points to
+ */
+static char *tdb_fmid_uri(TALLOC_CTX *mem_ctx, struct tdb_context *tdb, TDB_DATA key)
+{
+	TDB_DATA	dbuf;
+	char		*uri;
+
+	dbuf = tdb_fetch(tdb, key);
+	if (!dbuf.dptr) {
+		return NULL;
+	}
+	uri = tdb_uri_normalize(mem_ctx, (const char *) dbuf.dptr, dbuf.dsize);
+	free(dbuf.dptr);
+
+	return uri;
+}
+
+static int tdb_uri_index_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/* Position of the first URI not lower than uri */
+static uint32_t tdb_uri_index_lower_bound(struct tdb_uri_index *index, const char *uri)
+{
+	uint32_t	low = 0;
+	uint32_t	high = index->count;
+	uint32_t	middle;
+
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (strcmp(index->uris[middle], uri) < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+static int tdb_uri_index_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
+{
+	struct tdb_uri_index	*index = data;
+	size_t			tag_len = strlen(MAPISTORE_URI_TAG);
+
+	if (key.dsize < tag_len || strncmp((const char *) key.dptr, MAPISTORE_URI_TAG, tag_len)) {
+		return 0;
+	}
+
+	if (index->count == index->size) {
+		index->size = index->size ? index->size * 2 : 64;
+		index->uris = talloc_realloc(index, index->uris, char *, index->size);
+		if (!index->uris) {
+			index->count = index->size = 0;
+			return -1;
+		}
+	}
+	index->uris[index->count] = talloc_strndup(index->uris, (const char *) key.dptr + tag_len,
+						   key.dsize - tag_len);
+	if (!index->uris[index->count]) {
+		return -1;
+	}
+	index->count++;
+
+	return 0;
+}
+
+/**
+   \details Rebuild the prefix index from the reverse keyspace
+ */
+static enum mapistore_error tdb_uri_index_rebuild(struct indexing_context *ictx)
+{
+	struct tdb_uri_index	*index = URI_INDEX(ictx);
+	int			ret;
+
+	if (!index) {
+		index = talloc_zero(ictx, struct tdb_uri_index);
+		MAPISTORE_RETVAL_IF(!index, MAPISTORE_ERR_NO_MEMORY, NULL);
+		ictx->cache = index;
+	}
+
+	talloc_free(index->uris);
+	index->uris = NULL;
+	index->count = index->size = 0;
+	index->valid = false;
+
+	index->seqnum = tdb_get_seqnum(TDB_WRAP(ictx)->tdb);
+	ret = tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_uri_index_traverse, index);
+	MAPISTORE_RETVAL_IF(ret < 0, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	qsort(index->uris, index->count, sizeof(char *), tdb_uri_index_cmp);
+	index->valid = true;
+	index->exact = true;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/**
+   \details Apply a change committed by this context to the prefix
+   index, so it does not have to be rebuilt after each write
+
+   \param ictx pointer to the indexing context
+   \param seqnum the TDB sequence number before the change
+   \param added_uri normalized URI added to the reverse keyspace, or NULL
+   \param removed_uri normalized URI removed from the reverse keyspace, or NULL
+ */
+static void tdb_uri_index_update(struct indexing_context *ictx, int seqnum,
+				 const char *added_uri, const char *removed_uri)
+{
+	struct tdb_uri_index	*index = URI_INDEX(ictx);
+	uint32_t		pos;
+
+	if (!index || !index->valid) {
+		return;
+	}
+	if (index->seqnum != seqnum) {
+		index->valid = false;
+		return;
+	}
+
+	if (removed_uri) {
+		pos = tdb_uri_index_lower_bound(index, removed_uri);
+		if (pos < index->count && !strcmp(index->uris[pos], removed_uri)) {
+			talloc_free(index->uris[pos]);
+			memmove(&index->uris[pos], &index->uris[pos + 1],
+				(index->count - pos - 1) * sizeof(char *));
+			index->count--;
+		}
+	}
+
+	if (added_uri) {
+		pos = tdb_uri_index_lower_bound(index, added_uri);
+		if (pos == index->count || strcmp(index->uris[pos], added_uri)) {
+			if (index->count == index->size) {
+				index->size = index->size ? index->size * 2 : 64;
+				index->uris = talloc_realloc(index, index->uris, char *, index->size);
+				if (!index->uris) {
+					index->count = index->size = 0;
+					index->valid = false;
+					return;
+				}
+			}
+			memmove(&index->uris[pos + 1], &index->uris[pos],
+				(index->count - pos) * sizeof(char *));
+			index->uris[pos] = talloc_strdup(index->uris, added_uri);
+			if (!index->uris[pos]) {
+				index->valid = false;
+				return;
+			}
+			index->count++;
+		}
+	}
+
+	/* Another process may have written between the commit and
+	 * now: lookups which miss will rebuild the index */
+	index->seqnum = tdb_get_seqnum(TDB_WRAP(ictx)->tdb);
+	index->exact = false;
+}
+
+/**
+   \details Search the prefix index for a URI starting with startswith
+   and ending with endswith
+ */
+static bool tdb_uri_index_search(struct indexing_context *ictx, const char *startswith,
+				 const char *endswith, uint64_t *fmidp, bool *soft_deletedp)
+{
+	struct tdb_uri_index	*index = URI_INDEX(ictx);
+	TALLOC_CTX		*mem_ctx;
+	size_t			start_len = strlen(startswith);
+	size_t			end_len = strlen(endswith);
+	size_t			len;
+	uint32_t		pos;
+	TDB_DATA		key;
+	TDB_DATA		dbuf;
+	bool			found = false;
+
+	mem_ctx = talloc_new(NULL);
+	for (pos = tdb_uri_index_lower_bound(index, startswith); pos < index->count && !found; pos++) {
+		if (strncmp(index->uris[pos], startswith, start_len)) {
+			break;
+		}
+		len = strlen(index->uris[pos]);
+		if (len < start_len + end_len || strcmp(index->uris[pos] + len - end_len, endswith)) {
+			continue;
+		}
+
+		/* The entry may be stale, the reverse record is authoritative */
+		key = tdb_uri_key(mem_ctx, index->uris[pos]);
+		if (!key.dptr) break;
+		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+		found = tdb_uri_value_parse(dbuf, fmidp, soft_deletedp);
+		free(dbuf.dptr);
+	}
+	talloc_free(mem_ctx);
+
+	return found;
+}
+
+struct tdb_migrate_data {
+	TALLOC_CTX	*mem_ctx;
+	uint32_t	count;
+	char		**uris;
+	uint64_t	*fmids;
+	bool		*soft_deleted;
+};
+
+static int tdb_migrate_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
+{
+	struct tdb_migrate_data	*migrate = data;
+	size_t			tag_len = strlen(MAPISTORE_SOFT_DELETED_TAG);
+	bool			soft_deleted = false;
+	char			*key_str;
+
+	key_str = talloc_strndup(migrate->mem_ctx, (const char *) key.dptr, key.dsize);
+	if (!key_str) return -1;
+
+	if (!strncmp(key_str, MAPISTORE_SOFT_DELETED_TAG, tag_len)) {
+		soft_deleted = true;
+		key_str += tag_len;
+	}
+	if (strncmp(key_str, "0x", 2)) {
+		return 0;
+	}
+
+	migrate->uris = talloc_realloc(migrate->mem_ctx, migrate->uris, char *, migrate->count + 1);
+	migrate->fmids = talloc_realloc(migrate->mem_ctx, migrate->fmids, uint64_t, migrate->count + 1);
+	migrate->soft_deleted = talloc_realloc(migrate->mem_ctx, migrate->soft_deleted, bool, migrate->count + 1);
+	if (!migrate->uris || !migrate->fmids || !migrate->soft_deleted) {
+		return -1;
+	}
+	migrate->uris[migrate->count] = tdb_uri_normalize(migrate->mem_ctx, (const char *) value.dptr, value.dsize);
+	if (!migrate->uris[migrate->count]) return -1;
+	migrate->fmids[migrate->count] = strtoull(key_str, NULL, 16);
+	migrate->soft_deleted[migrate->count] = soft_deleted;
+	migrate->count++;
+
+	return 0;
+}
+
+static int tdb_indexing_version(struct tdb_context *tdb)
+{
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		buf[16];
+	int		version = 0;
+
+	key.dptr = (unsigned char *) MAPISTORE_INDEXING_VERSION_KEY;
+	key.dsize = strlen(MAPISTORE_INDEXING_VERSION_KEY);
+
+	dbuf = tdb_fetch(tdb, key);
+	if (dbuf.dptr && dbuf.dsize < sizeof(buf)) {
+		memcpy(buf, dbuf.dptr, dbuf.dsize);
+		buf[dbuf.dsize] = '\0';
+		version = atoi(buf);
+	}
+	free(dbuf.dptr);
+
+	return version;
+}
+
+/**
+   \details Build the reverse URI keyspace of databases created before
+   it existed
+
+   Live records take precedence over soft deleted ones when several
+   records share a URI.
+
+   \param tdb pointer to the indexing database
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error tdb_indexing_migrate(struct tdb_context *tdb)
+{
+	struct tdb_migrate_data	migrate;
+	TDB_DATA		key;
+	TDB_DATA		dbuf;
+	char			version[16];
+	uint32_t		i;
+	int			ret;
+
+	if (tdb_indexing_version(tdb) >= MAPISTORE_INDEXING_VERSION) {
+		return MAPISTORE_SUCCESS;
+	}
+
+	ret = tdb_transaction_start(tdb);
+	MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, NULL);
+
+	/* Another process may have migrated the database meanwhile */
+	if (tdb_indexing_version(tdb) >= MAPISTORE_INDEXING_VERSION) {
+		tdb_transaction_cancel(tdb);
+		return MAPISTORE_SUCCESS;
+	}
+
+	memset(&migrate, 0, sizeof(migrate));
+	migrate.mem_ctx = talloc_named(NULL, 0, "tdb_indexing_migrate");
+	if (!migrate.mem_ctx) goto fail;
+
+	ret = tdb_traverse_read(tdb, tdb_migrate_traverse, &migrate);
+	if (ret < 0) goto fail;
+
+	for (i = 0; i < migrate.count; i++) {
+		if (migrate.soft_deleted[i]) continue;
+		if (tdb_uri_record_store(tdb, migrate.uris[i], migrate.fmids[i], false)) goto fail;
+	}
+	for (i = 0; i < migrate.count; i++) {
+		if (!migrate.soft_deleted[i]) continue;
+		key = tdb_uri_key(migrate.mem_ctx, migrate.uris[i]);
+		if (!key.dptr) goto fail;
+		if (tdb_exists(tdb, key)) continue;
+		if (tdb_uri_record_store(tdb, migrate.uris[i], migrate.fmids[i], true)) goto fail;
+	}
+
+	key.dptr = (unsigned char *) MAPISTORE_INDEXING_VERSION_KEY;
+	key.dsize = strlen(MAPISTORE_INDEXING_VERSION_KEY);
+	snprintf(version, sizeof(version), "%d", MAPISTORE_INDEXING_VERSION);
+	dbuf.dptr = (unsigned char *) version;
+	dbuf.dsize = strlen(version);
+	if (tdb_store(tdb, key, dbuf, TDB_REPLACE)) goto fail;
+
+	if (tdb_transaction_commit(tdb)) {
+		talloc_free(migrate.mem_ctx);
+		return MAPISTORE_ERR_DATABASE_OPS;
+	}
+
+	if (migrate.count) {
+		OC_DEBUG(3, "Indexed %u URIs of %s\n", migrate.count, tdb_name(tdb));
+	}
+	talloc_free(migrate.mem_ctx);
+
+	return MAPISTORE_SUCCESS;
+
+fail:
+	tdb_transaction_cancel(tdb);
+	talloc_free(migrate.mem_ctx);
+	return MAPISTORE_ERR_DATABASE_OPS;
+}
 
 
 
@@ -82,6 +548,8 @@ static enum mapistore_error tdb_record_add(struct indexing_context *ictx,
 	TDB_DATA	key;
 	TDB_DATA	dbuf;
 	bool		IsSoftDeleted = false;
+	char		*uri;
+	int		seqnum;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -100,9 +568,28 @@ static enum mapistore_error tdb_record_add(struct indexing_context *ictx,
 	dbuf.dptr = (unsigned char *) talloc_strdup(ictx, mapistore_URI);
 	dbuf.dsize = strlen((const char *) dbuf.dptr);
 
-	ret = tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_INSERT);
+	uri = tdb_uri_normalize(ictx, mapistore_URI, strlen(mapistore_URI));
+
+	/* Store the record and its reverse URI record together */
+	ret = tdb_transaction_start(TDB_WRAP(ictx)->tdb);
+	if (ret == 0) {
+		seqnum = tdb_get_seqnum(TDB_WRAP(ictx)->tdb);
+		ret = tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_INSERT);
+		if (ret == 0) {
+			ret = tdb_uri_record_store(TDB_WRAP(ictx)->tdb, uri, fmid, false);
+		}
+		if (ret == 0) {
+			ret = tdb_transaction_commit(TDB_WRAP(ictx)->tdb);
+		} else {
+			tdb_transaction_cancel(TDB_WRAP(ictx)->tdb);
+		}
+		if (ret == 0) {
+			tdb_uri_index_update(ictx, seqnum, uri, NULL);
+		}
+	}
 	talloc_free(key.dptr);
 	talloc_free(dbuf.dptr);
+	talloc_free(uri);
 
 	if (ret == -1) {
 		OC_DEBUG(3, "Unable to create 0x%.16"PRIx64" record: %s\n", fmid,
@@ -121,6 +608,10 @@ static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
 	int		ret;
 	TDB_DATA	key;
 	TDB_DATA	dbuf;
+	char		*uri;
+	char		*old_uri = NULL;
+	int		removed = 0;
+	int		seqnum;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -135,9 +626,34 @@ static enum mapistore_error tdb_record_update(struct indexing_context *ictx,
 	dbuf.dptr = (unsigned char *) talloc_strdup(ictx, mapistore_URI);
 	dbuf.dsize = strlen((const char *) dbuf.dptr);
 
-	ret = tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_MODIFY);
+	uri = tdb_uri_normalize(ictx, mapistore_URI, strlen(mapistore_URI));
+
+	/* Move the reverse URI record along with the record */
+	ret = tdb_transaction_start(TDB_WRAP(ictx)->tdb);
+	if (ret == 0) {
+		seqnum = tdb_get_seqnum(TDB_WRAP(ictx)->tdb);
+		old_uri = tdb_fmid_uri(ictx, TDB_WRAP(ictx)->tdb, key);
+		ret = tdb_store(TDB_WRAP(ictx)->tdb, key, dbuf, TDB_MODIFY);
+		if (ret == 0 && old_uri && strcmp(old_uri, uri)) {
+			removed = tdb_uri_record_del(TDB_WRAP(ictx)->tdb, old_uri, fmid);
+			ret = removed < 0 ? -1 : 0;
+		}
+		if (ret == 0) {
+			ret = tdb_uri_record_store(TDB_WRAP(ictx)->tdb, uri, fmid, false);
+		}
+		if (ret == 0) {
+			ret = tdb_transaction_commit(TDB_WRAP(ictx)->tdb);
+		} else {
+			tdb_transaction_cancel(TDB_WRAP(ictx)->tdb);
+		}
+		if (ret == 0) {
+			tdb_uri_index_update(ictx, seqnum, uri, removed > 0 ? old_uri : NULL);
+		}
+	}
 	talloc_free(key.dptr);
 	talloc_free(dbuf.dptr);
+	talloc_free(uri);
+	talloc_free(old_uri);
 
 	if (ret == -1) {
 		OC_DEBUG(3, "Unable to update 0x%.16"PRIx64" record: %s\n",
@@ -158,6 +674,9 @@ static enum mapistore_error tdb_record_del(struct indexing_context *ictx,
 	TDB_DATA			newkey;
 	TDB_DATA			dbuf;
 	bool				IsSoftDeleted = false;
+	char				*uri;
+	int				removed = 0;
+	int				seqnum;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -179,27 +698,75 @@ static enum mapistore_error tdb_record_del(struct indexing_context *ictx,
 	switch (flags) {
 	case MAPISTORE_SOFT_DELETE:
 		/* nothing to do if the record is already soft deleted */
-		MAPISTORE_RETVAL_IF(IsSoftDeleted == true, MAPISTORE_SUCCESS, NULL);
+		if (IsSoftDeleted == true) {
+			talloc_free(key.dptr);
+			return MAPISTORE_SUCCESS;
+		}
 		newkey.dptr = (unsigned char *) talloc_asprintf(ictx, "%s0x%.16"PRIx64,
 								MAPISTORE_SOFT_DELETED_TAG,
 								fmid);
 		newkey.dsize = strlen ((const char *)newkey.dptr);
-		/* Retrieve previous value */
-		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
-		/* Add new record */
-		ret = tdb_store(TDB_WRAP(ictx)->tdb, newkey, dbuf, TDB_INSERT);
-		free(dbuf.dptr);
-		/* Delete previous record */
-		ret = tdb_delete(TDB_WRAP(ictx)->tdb, key);
+
+		ret = tdb_transaction_start(TDB_WRAP(ictx)->tdb);
+		if (ret == 0) {
+			seqnum = tdb_get_seqnum(TDB_WRAP(ictx)->tdb);
+			/* Retrieve previous value */
+			dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+			uri = tdb_uri_normalize(ictx, (const char *) dbuf.dptr, dbuf.dsize);
+			/* Add new record */
+			ret = tdb_store(TDB_WRAP(ictx)->tdb, newkey, dbuf, TDB_INSERT);
+			free(dbuf.dptr);
+			/* Delete previous record */
+			if (ret == 0) {
+				ret = tdb_delete(TDB_WRAP(ictx)->tdb, key);
+			}
+			/* The URI keeps pointing to the record, now soft deleted */
+			if (ret == 0 && uri) {
+				removed = tdb_uri_record_del(TDB_WRAP(ictx)->tdb, uri, fmid);
+				if (removed > 0) {
+					ret = tdb_uri_record_store(TDB_WRAP(ictx)->tdb, uri, fmid, true);
+				}
+			}
+			if (ret == 0 && removed >= 0) {
+				ret = tdb_transaction_commit(TDB_WRAP(ictx)->tdb);
+			} else {
+				tdb_transaction_cancel(TDB_WRAP(ictx)->tdb);
+				ret = -1;
+			}
+			if (ret == 0) {
+				tdb_uri_index_update(ictx, seqnum, NULL, NULL);
+			}
+			talloc_free(uri);
+		}
 		talloc_free(key.dptr);
 		talloc_free(newkey.dptr);
+		MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, NULL);
 		break;
 	case MAPISTORE_PERMANENT_DELETE:
-		ret = tdb_delete(TDB_WRAP(ictx)->tdb, key);
+		ret = tdb_transaction_start(TDB_WRAP(ictx)->tdb);
+		if (ret == 0) {
+			seqnum = tdb_get_seqnum(TDB_WRAP(ictx)->tdb);
+			uri = tdb_fmid_uri(ictx, TDB_WRAP(ictx)->tdb, key);
+			ret = tdb_delete(TDB_WRAP(ictx)->tdb, key);
+			if (ret == 0 && uri) {
+				removed = tdb_uri_record_del(TDB_WRAP(ictx)->tdb, uri, fmid);
+			}
+			if (ret == 0 && removed >= 0) {
+				ret = tdb_transaction_commit(TDB_WRAP(ictx)->tdb);
+			} else {
+				tdb_transaction_cancel(TDB_WRAP(ictx)->tdb);
+				ret = -1;
+			}
+			if (ret == 0) {
+				tdb_uri_index_update(ictx, seqnum, NULL, removed > 0 ? uri : NULL);
+			}
+			talloc_free(uri);
+		}
 		talloc_free(key.dptr);
 		MAPISTORE_RETVAL_IF(ret, MAPISTORE_ERR_DATABASE_OPS, NULL);
 		break;
 	default:
+		talloc_free(key.dptr);
 		return MAPISTORE_ERR_INVALID_PARAMETER;
 	}
 
@@ -256,94 +823,33 @@ static enum mapistore_error tdb_record_get_uri(struct indexing_context *ictx,
 }
 
 /**
-   \details A slow but effective way to retrieve an fmid from a uri
+   \details Retrieve an fmid from a uri
 
-   \param mstore_ctx pointer to the mapistore context
-   \param mem_ctx pointer to the talloc context
-   \param fmid the fmid/key to the record
-   \param urip pointer to the uri pointer
-   \param soft_deletedp pointer to the soft deleted pointer
+   Complete URIs are resolved with the reverse URI records, URIs with a
+   wildcard with the prefix index.
+
+   \param ictx pointer to the indexing context
+   \param username the user owning the record
+   \param uri the uri to look for, may contain one '*' if partial is true
+   \param partial whether uri is a pattern
+   \param fmidp pointer to the fmid the function returns
+   \param soft_deletedp pointer to the soft deleted state the function returns
 
    \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
  */
-struct tdb_get_fid_data {
-	bool		found;
-	uint64_t	fmid;
-	char		*uri;
-	size_t		uri_len;
-	uint32_t	wildcard_count;
-	char		*startswith;
-	char		*endswith;
-};
-
-static int tdb_get_fid_traverse(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
-{
-	struct tdb_get_fid_data	*tdb_data;
-	char			*key_str, *cmp_uri, *slash_ptr;
-	TALLOC_CTX		*mem_ctx;
-	int			ret = 0;
-
-	mem_ctx = talloc_zero(NULL, void);
-	tdb_data = data;
-	cmp_uri = talloc_array(mem_ctx, char, value.dsize + 1);
-	memcpy(cmp_uri, value.dptr, value.dsize);
-	*(cmp_uri + value.dsize) = 0;
-	slash_ptr = cmp_uri + value.dsize - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-	}
-	if (strcmp(cmp_uri, tdb_data->uri) == 0) {
-		key_str = talloc_strndup(mem_ctx, (char *) key.dptr, key.dsize);
-		tdb_data->fmid = strtoull(key_str, NULL, 16);
-		tdb_data->found = true;
-		ret = 1;
-	}
-	
-	talloc_free(mem_ctx);
-
-	return ret;
-}
-
-static int tdb_get_fid_traverse_partial(struct tdb_context *tdb_ctx, TDB_DATA key, TDB_DATA value, void *data)
-{
-	struct tdb_get_fid_data	*tdb_data;
-	char			*key_str, *cmp_uri, *slash_ptr;
-	TALLOC_CTX		*mem_ctx;
-	int			ret = 0;
-
-	mem_ctx = talloc_zero(NULL, void);
-	tdb_data = data;
-	cmp_uri = talloc_array(mem_ctx, char, value.dsize + 1);
-	memcpy(cmp_uri, value.dptr, value.dsize);
-	*(cmp_uri + value.dsize) = 0;
-	slash_ptr = cmp_uri + value.dsize - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-	}
-
-	if (!strncmp(cmp_uri, tdb_data->startswith, strlen(tdb_data->startswith)) &&
-	    !strncmp(cmp_uri + (strlen(cmp_uri) - strlen(tdb_data->endswith)), tdb_data->endswith, 
-		     strlen(tdb_data->endswith))) {
-		    key_str = talloc_strndup(mem_ctx, (char *) key.dptr, key.dsize);
-		    tdb_data->fmid = strtoull(key_str, NULL, 16);
-		    tdb_data->found = true;
-		    ret = 1;
-	}
-	
-	talloc_free(mem_ctx);
-
-	return ret;
-}
-
 static enum mapistore_error tdb_record_get_fmid(struct indexing_context *ictx,
 					        const char *username,
 					        const char *uri, bool partial,
 					        uint64_t *fmidp, bool *soft_deletedp)
 {
-	int				ret;
-	struct tdb_get_fid_data		tdb_data;
-	char				*slash_ptr;
-	uint32_t			i;
+	enum mapistore_error		ret;
+	TALLOC_CTX			*mem_ctx;
+	char				*normalized_uri;
+	char				*wildcard;
+	const char			*endswith;
+	TDB_DATA			key;
+	TDB_DATA			dbuf;
+	bool				found;
 
 	/* SANITY checks */
 	MAPISTORE_RETVAL_IF(!ictx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -352,60 +858,45 @@ static enum mapistore_error tdb_record_get_fmid(struct indexing_context *ictx,
 	MAPISTORE_RETVAL_IF(!fmidp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 	MAPISTORE_RETVAL_IF(!soft_deletedp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
 
-	/* Check if the fmid exists within the database */
-	tdb_data.found = false;
-	tdb_data.uri = talloc_strdup(NULL, uri);
-	tdb_data.uri_len = strlen(uri);
-
-	tdb_data.startswith = NULL;
-	tdb_data.endswith = NULL;
-	tdb_data.wildcard_count = 0;
+	mem_ctx = talloc_named(NULL, 0, "tdb_record_get_fmid");
+	normalized_uri = tdb_uri_normalize(mem_ctx, uri, strlen(uri));
+	MAPISTORE_RETVAL_IF(!normalized_uri, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
 
-	slash_ptr = tdb_data.uri + tdb_data.uri_len - 1;
-	if (*slash_ptr == '/') {
-		*slash_ptr = 0;
-		tdb_data.uri_len--;
+	wildcard = partial ? strchr(normalized_uri, '*') : NULL;
+	if (wildcard == NULL) {
+		key = tdb_uri_key(mem_ctx, normalized_uri);
+		MAPISTORE_RETVAL_IF(!key.dptr, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
+		dbuf = tdb_fetch(TDB_WRAP(ictx)->tdb, key);
+		found = tdb_uri_value_parse(dbuf, fmidp, soft_deletedp);
+		free(dbuf.dptr);
+		talloc_free(mem_ctx);
+		return found ? MAPISTORE_SUCCESS : MAPISTORE_ERR_NOT_FOUND;
 	}
-	if (partial == false) {
-		tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse, &tdb_data);
-	} else {
-		for (tdb_data.wildcard_count = 0, i = 0; i < strlen(uri); i++) {
-			if (uri[i] == '*') tdb_data.wildcard_count += 1;
-		}
-
-		switch (tdb_data.wildcard_count) {
-		case 0: /* complete URI */
-			partial = true;
-			break;
-		case 1: /* start and end only */
-			tdb_data.endswith = strchr(uri, '*') + 1;
-			tdb_data.startswith = talloc_strndup(NULL, uri, strlen(uri) - strlen(tdb_data.endswith) - 1);
-			break;
-		default:
-			OC_DEBUG(0, "Too many wildcards found (1 maximum)\n");
-			talloc_free(tdb_data.uri);
-			return MAPISTORE_ERR_NOT_FOUND;
-		}
 
-		if (partial == true) {
-			tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse_partial, &tdb_data);
-			talloc_free(tdb_data.startswith);
-		} else {
-			tdb_traverse_read(TDB_WRAP(ictx)->tdb, tdb_get_fid_traverse, &tdb_data);
-		}
+	endswith = wildcard + 1;
+	if (strchr(endswith, '*')) {
+		OC_DEBUG(0, "Too many wildcards found (1 maximum)\n");
+		talloc_free(mem_ctx);
+		return MAPISTORE_ERR_NOT_FOUND;
 	}
+	*wildcard = '\0';
 
-	talloc_free(tdb_data.uri);
-	if (tdb_data.found) {
-		*fmidp = tdb_data.fmid;
-		*soft_deletedp = false; /* TODO: implement the feature */
-		ret = MAPISTORE_SUCCESS;
+	if (!URI_INDEX(ictx) || !URI_INDEX(ictx)->valid ||
+	    URI_INDEX(ictx)->seqnum != tdb_get_seqnum(TDB_WRAP(ictx)->tdb)) {
+		ret = tdb_uri_index_rebuild(ictx);
+		MAPISTORE_RETVAL_IF(ret, ret, mem_ctx);
 	}
-	else {
-		ret = MAPISTORE_ERR_NOT_FOUND;
+
+	found = tdb_uri_index_search(ictx, normalized_uri, endswith, fmidp, soft_deletedp);
+	if (!found && !URI_INDEX(ictx)->exact) {
+		/* Records added by other processes may be missing */
+		ret = tdb_uri_index_rebuild(ictx);
+		MAPISTORE_RETVAL_IF(ret, ret, mem_ctx);
+		found = tdb_uri_index_search(ictx, normalized_uri, endswith, fmidp, soft_deletedp);
 	}
+	talloc_free(mem_ctx);
 
-	return ret;
+	return found ? MAPISTORE_SUCCESS : MAPISTORE_ERR_NOT_FOUND;
 }
 
 
@@ -506,6 +997,15 @@ _PUBLIC_ enum mapistore_error mapistore_indexing_tdb_init(struct mapistore_conte
 		return MAPISTORE_ERR_DATABASE_INIT;
 	}
 
+	/* Step 2. Index the URIs of databases created by older versions */
+	tdb_enable_seqnum(TDB_WRAP(ictx)->tdb);
+	if (tdb_indexing_migrate(TDB_WRAP(ictx)->tdb) != MAPISTORE_SUCCESS) {
+		OC_DEBUG(1, "Unable to index the URIs of %s/indexing.tdb\n", username);
+		talloc_free(ictx);
+		talloc_free(mem_ctx);
+		return MAPISTORE_ERR_DATABASE_INIT;
+	}
+
 	/* TODO: extract url from backend mapping, by the moment we use the username */
 	ictx->url = talloc_strdup(ictx, username);
 
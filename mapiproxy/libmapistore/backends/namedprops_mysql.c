@@ -40,37 +40,30 @@ static enum mapistore_error get_mapped_id(struct namedprops_context *self,
 	int type = nameid.ulKind;
 	char *guid = GUID_string(mem_ctx, &nameid.lpguid);
 	MYSQL *conn = self->data;
-
-	char *sql = NULL;
+	struct stmt_params params;
+	const char *sql = NULL;
+	uint64_t id;
+	enum MYSQLRESULT ret;
+
+	stmt_params_init(&params);
+	stmt_bind_u64(&params, type);
+	stmt_bind_string(&params, guid);
 	if (type == MNID_ID) {
-		uint32_t prop_id = nameid.kind.lid;
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT mappedId FROM "NAMEDPROPS_MYSQL_TABLE" "
-			"WHERE `type`=%d AND `oleguid`='%s' AND `propId`=%d",
-			type, guid, prop_id);
+		stmt_bind_u64(&params, nameid.kind.lid);
+		sql = "SELECT mappedId FROM "NAMEDPROPS_MYSQL_TABLE" "
+		      "WHERE `type`=? AND `oleguid`=? AND `propId`=?";
 	} else if (type == MNID_STRING) {
-		const char *prop_name = nameid.kind.lpwstr.Name;
-		sql = talloc_asprintf(mem_ctx,
-			"SELECT mappedId FROM "NAMEDPROPS_MYSQL_TABLE" "
-			"WHERE `type`=%d AND `oleguid`='%s' AND `propName`='%s'",
-			type, guid, prop_name);
+		stmt_bind_string(&params, nameid.kind.lpwstr.Name);
+		sql = "SELECT mappedId FROM "NAMEDPROPS_MYSQL_TABLE" "
+		      "WHERE `type`=? AND `oleguid`=? AND `propName`=?";
 	} else {
 		MAPISTORE_RETVAL_IF(true, MAPISTORE_ERROR, mem_ctx);
 	}
 
-	if (mysql_query(conn, sql) != 0) {
-		MAPISTORE_RETVAL_IF(true, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
-	}
-
-	MYSQL_RES *res = mysql_store_result(conn);
-	if (mysql_num_rows(res) == 0) {
-		// Not found
-		mysql_free_result(res);
-		MAPISTORE_RETVAL_IF(true, MAPISTORE_ERR_NOT_FOUND, mem_ctx);
-	}
-	MYSQL_ROW row = mysql_fetch_row(res);
-	*mapped_id = strtol(row[0], NULL, 10);
-	mysql_free_result(res);
+	ret = stmt_select_first_uint(conn, sql, &params, &id);
+	MAPISTORE_RETVAL_IF(ret == MYSQL_NOT_FOUND, MAPISTORE_ERR_NOT_FOUND, mem_ctx);
+	MAPISTORE_RETVAL_IF(ret != MYSQL_SUCCESS, MAPISTORE_ERR_DATABASE_OPS, mem_ctx);
+	*mapped_id = id;
 
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -265,8 +265,32 @@ struct processing_context;
 struct mapistore_notification_context {
 	memcached_st				*memc_ctx;
 	bool					threading;
+	bool					local;
 };
 
+/**
+   Resolver record returned by batched resolver lookups
+ */
+struct mapistore_notification_resolver_record {
+	const char	*cn;
+	uint32_t	count;		/* 0 when no record exists for cn */
+	const char	**hosts;
+};
+
+/**
+   Counters exposed by the message body prefetch engine
+ */
+struct mapistore_prefetch_stats {
+	uint64_t	hits;		/* message reads served from preloaded bodies */
+	uint64_t	misses;		/* message reads outside the preloaded range */
+	uint64_t	preloads;	/* backend preload_message_bodies calls */
+	uint64_t	preloaded;	/* message bodies requested from the backend */
+	uint64_t	deferred;	/* preloads run from the event loop */
+	uint64_t	evictions;	/* streams dropped to honour the stream limit */
+};
+
+struct mapistore_prefetch_context;
+
 struct mapistore_context {
 	struct processing_context		*processing_ctx;
 	struct backend_context_list		*context_list;
@@ -278,6 +302,7 @@ struct mapistore_context {
 	struct mapistore_connection_info	*conn_info;
 	const char				*cache;
 	struct mapistore_notification_context	*notification_ctx;
+	struct mapistore_prefetch_context	*prefetch_ctx;
 };
 
 struct mapistore_freebusy_properties {
@@ -421,6 +446,7 @@ enum mapistore_error mapistore_notification_session_get(TALLOC_CTX *, struct map
 enum mapistore_error mapistore_notification_resolver_add(struct mapistore_context *, const char *, const char *);
 enum mapistore_error mapistore_notification_resolver_exist(struct mapistore_context *, const char *);
 enum mapistore_error mapistore_notification_resolver_get(TALLOC_CTX *, struct mapistore_context *, const char *, uint32_t *, const char ***);
+enum mapistore_error mapistore_notification_resolver_get_multi(TALLOC_CTX *, struct mapistore_context *, uint32_t, const char **, struct mapistore_notification_resolver_record **);
 enum mapistore_error mapistore_notification_resolver_delete(struct mapistore_context *, const char *, const char *);
 
 enum mapistore_error mapistore_notification_subscription_add(struct mapistore_context *, struct GUID, uint32_t, uint16_t, uint64_t, uint64_t, uint32_t, enum MAPITAGS *);
@@ -435,6 +461,14 @@ enum mapistore_error mapistore_notification_deliver_delete(struct mapistore_cont
 
 enum mapistore_error mapistore_notification_payload_newmail(TALLOC_CTX *, char *, char *, char *, char, uint8_t **, size_t *);
 
+/* definitions from mapistore_prefetch.c */
+struct tevent_context;
+enum mapistore_error mapistore_prefetch_set_event_context(struct mapistore_context *, struct tevent_context *);
+enum mapistore_error mapistore_prefetch_hint(struct mapistore_context *, uint32_t, void *, enum mapistore_table_type, const struct UI8Array_r *);
+enum mapistore_error mapistore_prefetch_access(struct mapistore_context *, uint32_t, uint64_t);
+enum mapistore_error mapistore_prefetch_release(struct mapistore_context *, uint32_t, void *);
+enum mapistore_error mapistore_prefetch_get_stats(struct mapistore_context *, struct mapistore_prefetch_stats *);
+
 __END_DECLS
 
 #endif	/* ! __MAPISTORE_H */
@@ -97,6 +97,7 @@ _PUBLIC_ struct mapistore_context *mapistore_init(TALLOC_CTX *mem_ctx, struct lo
 	mstore_ctx->subscriptions = NULL;
 	mstore_ctx->conn_info = NULL;
 	mstore_ctx->notification_ctx = NULL;
+	mstore_ctx->prefetch_ctx = NULL;
 
 	indexing_url = lpcfg_parm_string(lp_ctx, NULL, "mapistore", "indexing_backend");
 	mapistore_set_default_indexing_url(indexing_url);
@@ -116,6 +117,13 @@ _PUBLIC_ struct mapistore_context *mapistore_init(TALLOC_CTX *mem_ctx, struct lo
 		return NULL;
 	}
 
+	retval = mapistore_prefetch_init(mstore_ctx, lp_ctx, &(mstore_ctx->prefetch_ctx));
+	if (retval != MAPISTORE_SUCCESS) {
+		OC_DEBUG(0, "[mapistore]: Unable to initialize mapistore prefetch engine: %s\n", mapistore_errstr(retval));
+		talloc_free(mstore_ctx);
+		return NULL;
+	}
+
 	cache_url = lpcfg_parm_string(lp_ctx, NULL, "mapistore", "indexing_cache");
 	mapistore_set_default_cache_url(cache_url);
 
@@ -373,6 +381,9 @@ _PUBLIC_ enum mapistore_error mapistore_del_context(struct mapistore_context *ms
 	case MAPISTORE_ERR_REF_COUNT:
 		return MAPISTORE_SUCCESS;
 	case MAPISTORE_SUCCESS:
+		if (mstore_ctx->prefetch_ctx) {
+			mapistore_prefetch_release(mstore_ctx, context_id, NULL);
+		}
 		DLIST_REMOVE(mstore_ctx->context_list, backend_list);
 		/* Step 2. Add the free'd context id to the free list */
 		retval = mapistore_free_context_id(mstore_ctx->processing_ctx, context_id);
@@ -1044,9 +1055,78 @@ static int mapistore_days_in_month(int month, int year)
 	return days;
 }
 
-static int mapistore_mins_in_ymon(uint32_t ymon)
+/**
+   \details Return the number of days between 1970-01-01 and the first
+   day of a month, using proleptic Gregorian arithmetic instead of the
+   process timezone
+
+   \param year the year (tm_year + 1900)
+   \param month the month from 0 to 11, values outside this range carry
+   over to the year
+
+   \return the number of days, negative before 1970
+ */
+static int64_t mapistore_freebusy_days_from_civil(int64_t year, int64_t month)
 {
-	return mapistore_days_in_month((ymon & 0xf) - 1, ymon >> 4) * 24 * 60;
+	int64_t	era, yoe, doy;
+
+	year += month / 12;
+	month %= 12;
+	if (month < 0) {
+		month += 12;
+		year--;
+	}
+
+	/* Years start in March so that leap days fall at their end */
+	if (month < 2) {
+		year--;
+		month += 12;
+	}
+	era = (year >= 0 ? year : year - 399) / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month - 2) + 2) / 5;
+
+	return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+/**
+   \details timegm(3) equivalent: convert a broken-down UTC time to a
+   unix timestamp without touching TZ. Out of range tm_mon and tm_mday
+   values are normalized like mktime(3) does.
+ */
+static time_t mapistore_freebusy_timegm(const struct tm *tm)
+{
+	int64_t	days;
+
+	days = mapistore_freebusy_days_from_civil(tm->tm_year + 1900, tm->tm_mon) + tm->tm_mday - 1;
+
+	return (time_t) (days * 86400 + tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec);
+}
+
+/**
+   \details Return the first minute of a freebusy month, in minutes
+   since the unix epoch
+
+   \param ymon the month, encoded as (year << 4) | month with month
+   from 1 to 12
+   \param offset number of months to add to ymon
+ */
+static int64_t mapistore_freebusy_month_start(uint32_t ymon, int offset)
+{
+	return mapistore_freebusy_days_from_civil(ymon >> 4, (int64_t)(ymon & 0xf) - 1 + offset) * 24 * 60;
+}
+
+/**
+   \details Convert a FILETIME to minutes since the unix epoch
+ */
+static int64_t mapistore_freebusy_filetime_to_minutes(const struct FILETIME *ft_value)
+{
+	NTTIME	nt_time;
+
+	nt_time = ((NTTIME) ft_value->dwHighDateTime << 32) | ft_value->dwLowDateTime;
+
+	/* 194074560 minutes between 1601-01-01 and 1970-01-01 */
+	return (int64_t) (nt_time / (60 * 10000000ULL)) - 194074560;
 }
 
 static inline void mapistore_freebusy_make_range(struct tm *start_time, struct tm *end_time)
@@ -1063,7 +1143,7 @@ static inline void mapistore_freebusy_make_range(struct tm *start_time, struct t
 	*/
 
 	now = time(NULL);
-	time_data = *gmtime(&now);
+	gmtime_r(&now, &time_data);
 	time_data.tm_hour = 0;
 	time_data.tm_min = 0;
 	time_data.tm_sec = 0;
@@ -1106,137 +1186,140 @@ static inline void mapistore_freebusy_make_range(struct tm *start_time, struct t
 	*end_time = time_data;
 }
 
-static void mapistore_freebusy_convert_filetime(struct FILETIME *ft_value, uint32_t *ymon, uint32_t *mins)
-{
-	NTTIME		nt_time;
-	time_t		u_time;
-	struct tm	*gm_time;
+/**
+   Busy time intervals of a given status, in minutes since the unix
+   epoch, end excluded
+ */
+struct mapistore_freebusy_interval {
+	int64_t		start;
+	int64_t		end;
+};
 
-	nt_time = ((NTTIME) ft_value->dwHighDateTime << 32) | ft_value->dwLowDateTime;
-	u_time = nt_time_to_unix(nt_time);
-	gm_time = gmtime(&u_time);
+struct mapistore_freebusy_intervals {
+	struct mapistore_freebusy_interval	*items;
+	uint32_t				count;
+	uint32_t				size;
+};
 
-	*ymon = ((gm_time->tm_year + 1900) << 4) | (gm_time->tm_mon + 1);
-	*mins = gm_time->tm_min + (gm_time->tm_hour + ((gm_time->tm_mday - 1) * 24)) * 60;
-}
+/**
+   \details Record an event in a list of intervals, clamped to the
+   published range
 
-static uint16_t mapistore_freebusy_find_month_range(uint32_t ymon, uint32_t *months_ranges, uint16_t nbr_months, bool *overflow)
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE_ERR_NO_MEMORY
+ */
+static enum mapistore_error mapistore_freebusy_add_interval(TALLOC_CTX *mem_ctx, struct mapistore_freebusy_intervals *intervals,
+							    int64_t start, int64_t end, int64_t range_start, int64_t range_end)
 {
-	uint16_t	range;
+	if (start < range_start) {
+		start = range_start;
+	}
+	if (end > range_end) {
+		end = range_end;
+	}
+	if (start >= end) {
+		return MAPISTORE_SUCCESS;
+	}
 
-	if (nbr_months > 0) {
-		if (months_ranges[0] > ymon) {
-			*overflow = true;
-			return 0;
-		}
-		else {
-			if (months_ranges[nbr_months - 1] < ymon) {
-				*overflow = true;
-				return (nbr_months - 1);
-			}
-			else {
-				*overflow = false;
-				for (range = 0; range < nbr_months; range++) {
-					if (months_ranges[range] == ymon) {
-						return range;
-					}
-				}
-			}
-		}
+	if (intervals->count == intervals->size) {
+		intervals->size = intervals->size ? intervals->size * 2 : 16;
+		intervals->items = talloc_realloc(mem_ctx, intervals->items, struct mapistore_freebusy_interval, intervals->size);
+		MAPISTORE_RETVAL_IF(!intervals->items, MAPISTORE_ERR_NO_MEMORY, NULL);
 	}
+	intervals->items[intervals->count].start = start;
+	intervals->items[intervals->count].end = end;
+	intervals->count++;
 
-	return (uint16_t) -1;
+	return MAPISTORE_SUCCESS;
 }
 
-/* TODO: both following methods could be merged. This would certainly enhance performance by avoiding to wander through long arrays multiple times */
-static void mapistore_freebusy_fill_fbarray(uint8_t **minutes_array, uint32_t *months_ranges, uint16_t nbr_months, struct FILETIME *start, struct FILETIME *end)
+static int mapistore_freebusy_interval_cmp(const void *a, const void *b)
 {
-	uint32_t	i, max, start_ymon, start_mins, end_ymon, end_mins;
-	uint16_t	start_mr_idx, end_mr_idx;
-	bool		start_range_overflow, end_range_overflow;
-
-	mapistore_freebusy_convert_filetime(start, &start_ymon, &start_mins);
-	mapistore_freebusy_convert_filetime(end, &end_ymon, &end_mins);
+	const struct mapistore_freebusy_interval	*ia = (const struct mapistore_freebusy_interval *) a;
+	const struct mapistore_freebusy_interval	*ib = (const struct mapistore_freebusy_interval *) b;
 
-	start_mr_idx = mapistore_freebusy_find_month_range(start_ymon, months_ranges, nbr_months, &start_range_overflow);
-	if (start_range_overflow) {
-		start_mins = 0;
+	if (ia->start != ib->start) {
+		return (ia->start < ib->start) ? -1 : 1;
 	}
-	end_mr_idx = mapistore_freebusy_find_month_range(end_ymon, months_ranges, nbr_months, &end_range_overflow);
-	if (end_range_overflow) {
-		end_mins = mapistore_mins_in_ymon(end_ymon);
+	if (ia->end != ib->end) {
+		return (ia->end < ib->end) ? -1 : 1;
 	}
+	return 0;
+}
 
-	/* head */
-	if (end_mr_idx > start_mr_idx) {
-		/* end occurs after start range */
+/**
+   \details Sort intervals and coalesce the overlapping or adjacent
+   ones, in place
+ */
+static void mapistore_freebusy_merge_intervals(struct mapistore_freebusy_intervals *intervals)
+{
+	uint32_t	i, count;
 
-		/* middle */
-		for (i = start_mr_idx + 1; i < end_mr_idx; i++) {
-			memset(minutes_array[i], 1, mapistore_mins_in_ymon(months_ranges[i]));
-		}
+	if (intervals->count < 2) return;
 
-		/* tail */
-		memset(minutes_array[end_mr_idx], 1, end_mins);
+	qsort(intervals->items, intervals->count, sizeof (struct mapistore_freebusy_interval),
+	      mapistore_freebusy_interval_cmp);
 
-		max = mapistore_mins_in_ymon(start_ymon); /* = max chunk for first range */
-	}
-	else {
-		/* end occurs on same range as start */
-
-		max = end_mins;
+	count = 1;
+	for (i = 1; i < intervals->count; i++) {
+		if (intervals->items[i].start <= intervals->items[count - 1].end) {
+			if (intervals->items[i].end > intervals->items[count - 1].end) {
+				intervals->items[count - 1].end = intervals->items[i].end;
+			}
+		} else {
+			intervals->items[count++] = intervals->items[i];
+		}
 	}
-	memset(minutes_array[start_mr_idx] + start_mins, 1, (max - start_mins));
+	intervals->count = count;
 }
 
-static const int	max_mins_per_month = 31 * 24 * 60;
-
-static void mapistore_freebusy_compile_fbarray(TALLOC_CTX *mem_ctx, uint8_t *minutes_array, struct Binary_r *fb_bin)
+/**
+   \details Build the per-month freebusy binaries from a list of
+   intervals
+
+   Each month binary is a sequence of (start, end) uint16 pairs holding
+   minute offsets from the beginning of the month, end included.
+
+   \param mem_ctx pointer to the memory context the binaries are
+   attached to
+   \param intervals the intervals to compile, sorted and merged on return
+   \param months_ranges the published months
+   \param nbr_months number of elements in months_ranges
+   \param fb_bins array of nbr_months binaries to fill
+ */
+static void mapistore_freebusy_compile_intervals(TALLOC_CTX *mem_ctx, struct mapistore_freebusy_intervals *intervals,
+						 uint32_t *months_ranges, uint16_t nbr_months, struct Binary_r *fb_bins)
 {
-	int			i;
-	bool			filled;
-	struct ndr_push		*ndr;
-	TALLOC_CTX		*local_mem_ctx;
+	TALLOC_CTX	*local_mem_ctx;
+	struct ndr_push	*ndr;
+	int64_t		month_start, month_end, start, end;
+	uint32_t	i, j = 0, k;
 
-	local_mem_ctx = talloc_zero(NULL, TALLOC_CTX);
+	mapistore_freebusy_merge_intervals(intervals);
 
-	ndr = ndr_push_init_ctx(local_mem_ctx);
+	local_mem_ctx = talloc_zero(NULL, TALLOC_CTX);
+	for (i = 0; i < nbr_months; i++) {
+		month_start = mapistore_freebusy_month_start(months_ranges[i], 0);
+		month_end = mapistore_freebusy_month_start(months_ranges[i], 1);
 
-	filled = (minutes_array[0] != 0);
-	if (filled) {
-		ndr_push_uint16(ndr, NDR_SCALARS, 0);
-	}
+		ndr = ndr_push_init_ctx(local_mem_ctx);
 
-	for (i = 1; i < max_mins_per_month; i++) {
-		if (filled && !minutes_array[i]) {
-			ndr_push_uint16(ndr, NDR_SCALARS, (i - 1));
-			filled = false;
+		/* intervals are sorted and disjoint: skip the ones already
+		   consumed by previous months */
+		while (j < intervals->count && intervals->items[j].end <= month_start) {
+			j++;
 		}
-		else if (!filled && minutes_array[i]) {
-			ndr_push_uint16(ndr, NDR_SCALARS, i);
-			filled = true;
+		for (k = j; k < intervals->count && intervals->items[k].start < month_end; k++) {
+			start = intervals->items[k].start > month_start ? intervals->items[k].start : month_start;
+			end = intervals->items[k].end < month_end ? intervals->items[k].end : month_end;
+			ndr_push_uint16(ndr, NDR_SCALARS, (uint16_t) (start - month_start));
+			ndr_push_uint16(ndr, NDR_SCALARS, (uint16_t) (end - month_start - 1));
 		}
-	}
-	if (filled) {
-		ndr_push_uint16(ndr, NDR_SCALARS, (max_mins_per_month - 1));
-	}
-
-	fb_bin->cb = ndr->offset;
-	fb_bin->lpb = ndr->data;
-	(void) talloc_reference(mem_ctx, fb_bin->lpb);
-
-	talloc_free(local_mem_ctx);
-}
 
-static void mapistore_freebusy_merge_subarray(uint8_t *minutes_array, uint8_t *included_array)
-{
-	int i;
-
-	for (i = 0; i < max_mins_per_month; i++) {
-		if (included_array[i]) {
-			minutes_array[i] = 1;
-		}
+		fb_bins[i].cb = ndr->offset;
+		fb_bins[i].lpb = ndr->data;
+		(void) talloc_reference(mem_ctx, fb_bins[i].lpb);
 	}
+	talloc_free(local_mem_ctx);
 }
 
 enum mapistore_error mapistore_folder_fetch_freebusy_properties(struct mapistore_context *mstore_ctx, uint32_t context_id, void *folder, struct tm *start_tm, struct tm *end_tm, TALLOC_CTX *mem_ctx, struct mapistore_freebusy_properties **fb_props_p)
@@ -1244,7 +1327,7 @@ enum mapistore_error mapistore_folder_fetch_freebusy_properties(struct mapistore
 	enum mapistore_error			ret;
 	struct mapistore_freebusy_properties	*fb_props;
 	struct backend_context			*backend_ctx;
-	TALLOC_CTX				*local_mem_ctx;
+	TALLOC_CTX				*local_mem_ctx, *row_mem_ctx;
 	void					*table;
 	uint32_t				row_count;
 	struct SPropTagArray			*props;
@@ -1256,8 +1339,9 @@ enum mapistore_error mapistore_folder_fetch_freebusy_properties(struct mapistore
 	NTTIME					nt_time;
 	struct mapi_SRestriction_and		time_restrictions[2];
 	int					i, month, nbr_months;
-	uint8_t					**minutes_array, **free_array, **tentative_array, **busy_array, **oof_array;
-	char					*tz;
+	int64_t					range_start, range_end;
+	struct mapistore_freebusy_intervals	free_intervals, tentative_intervals, busy_intervals, oof_intervals;
+	struct mapistore_freebusy_intervals	*intervals;
 
 	/* Sanity checks */
 	MAPISTORE_SANITY_CHECKS(mstore_ctx, NULL);
@@ -1288,18 +1372,8 @@ enum mapistore_error mapistore_folder_fetch_freebusy_properties(struct mapistore
 	fb_props->timestamp.dwLowDateTime = (nt_time & 0xffffffff);
 	fb_props->timestamp.dwHighDateTime = nt_time >> 32;
 
-	tz = getenv("TZ");
-	setenv("TZ", "", 1);
-	tzset();
-	start_time = mktime(&local_start_tm);
-	end_time = mktime(&local_end_tm);
-	if (tz) {
-		setenv("TZ", tz, 1);
-	}
-	else {
-		unsetenv("TZ");
-	}
-	tzset();
+	start_time = mapistore_freebusy_timegm(&local_start_tm);
+	end_time = mapistore_freebusy_timegm(&local_end_tm);
 
 	/* setup restriction */
 	and_res.rt = RES_AND;
@@ -1342,6 +1416,10 @@ enum mapistore_error mapistore_folder_fetch_freebusy_properties(struct mapistore
 	else {
 		nbr_months = (12 - local_start_tm.tm_mon) + local_end_tm.tm_mon + 1;
 	}
+	if (nbr_months <= 0) {
+		ret = MAPISTORE_ERR_INVALID_PARAMETER;
+		goto end;
+	}
 	fb_props->months_ranges = talloc_array(fb_props, uint32_t, nbr_months);
 	if (local_start_tm.tm_year == local_end_tm.tm_year) {
 		for (i = 0; i < nbr_months; i++) {
@@ -1365,63 +1443,72 @@ enum mapistore_error mapistore_folder_fetch_freebusy_properties(struct mapistore
 		fb_props->months_ranges[i] = ((local_end_tm.tm_year + 1900) << 4) + month + 1;
 	}
 
-	/* fetch events and fill freebusy arrays */
-	free_array = talloc_array(local_mem_ctx, uint8_t *, nbr_months);
-	tentative_array = talloc_array(local_mem_ctx, uint8_t *, nbr_months);
-	busy_array = talloc_array(local_mem_ctx, uint8_t *, nbr_months);
-	oof_array = talloc_array(local_mem_ctx, uint8_t *, nbr_months);
-	for (i = 0; i < nbr_months; i++) {
-		free_array[i] = talloc_array(free_array, uint8_t, max_mins_per_month);
-		memset(free_array[i], 0, max_mins_per_month);
-		tentative_array[i] = talloc_array(tentative_array, uint8_t, max_mins_per_month);
-		memset(tentative_array[i], 0, max_mins_per_month);
-		busy_array[i] = talloc_array(tentative_array, uint8_t, max_mins_per_month);
-		memset(busy_array[i], 0, max_mins_per_month);
-		oof_array[i] = talloc_array(tentative_array, uint8_t, max_mins_per_month);
-		memset(oof_array[i], 0, max_mins_per_month);
-	}
+	/* fetch events as intervals of their busy status */
+	range_start = mapistore_freebusy_month_start(fb_props->months_ranges[0], 0);
+	range_end = mapistore_freebusy_month_start(fb_props->months_ranges[nbr_months - 1], 1);
+	memset(&free_intervals, 0, sizeof (struct mapistore_freebusy_intervals));
+	memset(&tentative_intervals, 0, sizeof (struct mapistore_freebusy_intervals));
+	memset(&busy_intervals, 0, sizeof (struct mapistore_freebusy_intervals));
+	memset(&oof_intervals, 0, sizeof (struct mapistore_freebusy_intervals));
 
+	/* rows are only needed until their interval is recorded */
+	row_mem_ctx = talloc_new(local_mem_ctx);
 	i = 0;
-	while (mapistore_table_get_row(mstore_ctx, context_id, table, local_mem_ctx, MAPISTORE_PREFILTERED_QUERY, i, &row_data) == MAPISTORE_SUCCESS) {
+	while (mapistore_table_get_row(mstore_ctx, context_id, table, row_mem_ctx, MAPISTORE_PREFILTERED_QUERY, i, &row_data) == MAPISTORE_SUCCESS) {
 		if (row_data[0].error == MAPISTORE_SUCCESS && row_data[1].error == MAPISTORE_SUCCESS && row_data[2].error == MAPISTORE_SUCCESS) {
 			switch (*((uint32_t *) row_data[2].data)) {
 			case olFree:
-				minutes_array = free_array;
+				intervals = &free_intervals;
 				break;
 			case olTentative:
-				minutes_array = tentative_array;
+				intervals = &tentative_intervals;
 				break;
 			case olBusy:
-				minutes_array = busy_array;
+				intervals = &busy_intervals;
 				break;
 			case olOutOfOffice:
-				minutes_array = oof_array;
+				intervals = &oof_intervals;
 				break;
 			default:
-				minutes_array = NULL;
+				intervals = NULL;
 			}
-			if (minutes_array) {
-				mapistore_freebusy_fill_fbarray(minutes_array, fb_props->months_ranges, nbr_months, row_data[0].data, row_data[1].data);
+			if (intervals) {
+				ret = mapistore_freebusy_add_interval(local_mem_ctx, intervals,
+								      mapistore_freebusy_filetime_to_minutes(row_data[0].data),
+								      mapistore_freebusy_filetime_to_minutes(row_data[1].data),
+								      range_start, range_end);
+				if (ret != MAPISTORE_SUCCESS) {
+					goto end;
+				}
 			}
 		}
+		talloc_free(row_mem_ctx);
+		row_mem_ctx = talloc_new(local_mem_ctx);
 		i++;
 	}
 
-        /* compile minutes array into arrays of ranges */
+	/* compile intervals into arrays of ranges */
 	fb_props->nbr_months = nbr_months;
 	fb_props->freebusy_free = talloc_array(fb_props, struct Binary_r, nbr_months);
 	fb_props->freebusy_tentative = talloc_array(fb_props, struct Binary_r, nbr_months);
 	fb_props->freebusy_busy = talloc_array(fb_props, struct Binary_r, nbr_months);
 	fb_props->freebusy_away = talloc_array(fb_props, struct Binary_r, nbr_months);
 	fb_props->freebusy_merged = talloc_array(fb_props, struct Binary_r, nbr_months);
-	for (i = 0; i < nbr_months; i++) {
-		mapistore_freebusy_compile_fbarray(fb_props, free_array[i], fb_props->freebusy_free + i);
-		mapistore_freebusy_compile_fbarray(fb_props, tentative_array[i], fb_props->freebusy_tentative + i);
-		mapistore_freebusy_compile_fbarray(fb_props, busy_array[i], fb_props->freebusy_busy + i);
-		mapistore_freebusy_compile_fbarray(fb_props, oof_array[i], fb_props->freebusy_away + i);
-		mapistore_freebusy_merge_subarray(busy_array[i], oof_array[i]);
-		mapistore_freebusy_compile_fbarray(fb_props, busy_array[i], fb_props->freebusy_merged + i);
+	mapistore_freebusy_compile_intervals(fb_props, &free_intervals, fb_props->months_ranges, nbr_months, fb_props->freebusy_free);
+	mapistore_freebusy_compile_intervals(fb_props, &tentative_intervals, fb_props->months_ranges, nbr_months, fb_props->freebusy_tentative);
+	mapistore_freebusy_compile_intervals(fb_props, &busy_intervals, fb_props->months_ranges, nbr_months, fb_props->freebusy_busy);
+	mapistore_freebusy_compile_intervals(fb_props, &oof_intervals, fb_props->months_ranges, nbr_months, fb_props->freebusy_away);
+
+	/* merged: busy and out of office */
+	for (i = 0; i < oof_intervals.count; i++) {
+		ret = mapistore_freebusy_add_interval(local_mem_ctx, &busy_intervals,
+						      oof_intervals.items[i].start, oof_intervals.items[i].end,
+						      range_start, range_end);
+		if (ret != MAPISTORE_SUCCESS) {
+			goto end;
+		}
 	}
+	mapistore_freebusy_compile_intervals(fb_props, &busy_intervals, fb_props->months_ranges, nbr_months, fb_props->freebusy_merged);
 
 	*fb_props_p = fb_props;
 
@@ -23,6 +23,22 @@
 #include "mapiproxy/libmapistore/mapistore_notification.h"
 #include "mapiproxy/util/oc_memcached.h"
 
+/* Compute the new value of a record from its current one (NULL when the
+   record does not exist). Returning an empty blob deletes the record. */
+typedef enum mapistore_error (*mapistore_notification_update_fn)(TALLOC_CTX *, const DATA_BLOB *, void *, DATA_BLOB *);
+
+/* Position of a key within a batched request */
+struct mapistore_notification_kv_index {
+	const char	*key;
+	uint32_t	idx;
+};
+
+static int mapistore_notification_kv_index_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct mapistore_notification_kv_index *)a)->key,
+		      ((const struct mapistore_notification_kv_index *)b)->key);
+}
+
 /**
    \details Map memcached to mapistore error mapping
 
@@ -52,12 +68,338 @@ static enum mapistore_error ret_to_mapistore(memcached_return rc)
 		return MAPISTORE_ERROR;
 	case MEMCACHED_DATA_EXISTS:
 		return MAPISTORE_ERR_EXIST;
+	case MEMCACHED_MEMORY_ALLOCATION_FAILURE:
+		return MAPISTORE_ERR_NO_MEMORY;
 	default:
 		oc_log(OC_LOG_WARNING, "memcached return valud %d (%s) is not mapped", rc, memcached_strerror(NULL, rc));
 		return MAPISTORE_ERROR;
 	};
 }
 
+/**
+   \details Retrieve the value stored for a batch of keys
+
+   With memcached, keys are sent in pipelined memcached_mget requests
+   of at most MSTORE_MEMC_MGET_BATCH keys instead of one round trip per
+   key. Results come back in no particular order and are matched back
+   to their position through a sorted index.
+
+   \param mem_ctx pointer to the memory context to allocate values with
+   \param notification_ctx pointer to the notification context
+   \param count the number of keys
+   \param keys array of keys to fetch
+   \param values array of count blobs to return, data is NULL for keys
+   not found or holding an empty record
+   \param cas optional array of count cas tokens to return, 0 for keys
+   not found. The token of an empty record is returned.
+
+   \return MEMCACHED_SUCCESS on success, otherwise memcached error
+ */
+static memcached_return mapistore_notification_kv_mget(TALLOC_CTX *mem_ctx,
+						       struct mapistore_notification_context *notification_ctx,
+						       uint32_t count, const char **keys,
+						       DATA_BLOB *values, uint64_t *cas)
+{
+	TALLOC_CTX				*local_mem_ctx;
+	struct mapistore_notification_kv_index	*sorted;
+	struct mapistore_notification_kv_index	lookup;
+	struct mapistore_notification_kv_index	*match;
+	memcached_result_st			result;
+	memcached_return			rc = MEMCACHED_SUCCESS;
+	memcached_return			error;
+	size_t					*lengths;
+	uint32_t				offset;
+	uint32_t				batch;
+	uint32_t				i;
+
+	for (i = 0; i < count; i++) {
+		values[i] = data_blob_null;
+		if (cas) cas[i] = 0;
+	}
+
+	if (notification_ctx->local) {
+		for (i = 0; i < count; i++) {
+			rc = mapistore_notification_local_get(mem_ctx, keys[i], &values[i], cas ? &cas[i] : NULL);
+			if (rc != MEMCACHED_SUCCESS && rc != MEMCACHED_NOTFOUND) return rc;
+			if (!values[i].length) {
+				talloc_free(values[i].data);
+				values[i] = data_blob_null;
+			}
+		}
+		return MEMCACHED_SUCCESS;
+	}
+
+	local_mem_ctx = talloc_new(NULL);
+	if (!local_mem_ctx) return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+
+	sorted = talloc_array(local_mem_ctx, struct mapistore_notification_kv_index, count);
+	lengths = talloc_array(local_mem_ctx, size_t, count);
+	if (!sorted || !lengths) {
+		talloc_free(local_mem_ctx);
+		return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+	}
+	for (i = 0; i < count; i++) {
+		sorted[i].key = keys[i];
+		sorted[i].idx = i;
+		lengths[i] = strlen(keys[i]);
+	}
+	qsort(sorted, count, sizeof (struct mapistore_notification_kv_index), mapistore_notification_kv_index_cmp);
+
+	if (!memcached_result_create(notification_ctx->memc_ctx, &result)) {
+		talloc_free(local_mem_ctx);
+		return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+	}
+
+	for (offset = 0; offset < count; offset += batch) {
+		batch = MIN(count - offset, MSTORE_MEMC_MGET_BATCH);
+		rc = memcached_mget(notification_ctx->memc_ctx, keys + offset, lengths + offset, batch);
+		if (rc != MEMCACHED_SUCCESS) break;
+
+		/* Pending results must be drained even when one cannot be stored */
+		error = MEMCACHED_SUCCESS;
+		while (memcached_fetch_result(notification_ctx->memc_ctx, &result, &rc)) {
+			/* Result keys are not NUL-terminated */
+			lookup.key = talloc_strndup(local_mem_ctx, memcached_result_key_value(&result),
+						    memcached_result_key_length(&result));
+			if (!lookup.key) {
+				error = MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+				continue;
+			}
+			match = bsearch(&lookup, sorted, count, sizeof (struct mapistore_notification_kv_index),
+					mapistore_notification_kv_index_cmp);
+			/* The same key may have been requested more than once */
+			while (match && match > sorted && !strcmp((match - 1)->key, lookup.key)) {
+				match--;
+			}
+			for (; match && match < sorted + count && !strcmp(match->key, lookup.key); match++) {
+				if (values[match->idx].data) continue;
+				if (cas) cas[match->idx] = memcached_result_cas(&result);
+				/* Empty records stand for absent ones */
+				if (!memcached_result_length(&result)) continue;
+				values[match->idx].data = talloc_memdup(mem_ctx, memcached_result_value(&result),
+									memcached_result_length(&result));
+				if (!values[match->idx].data) {
+					error = MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+					break;
+				}
+				values[match->idx].length = memcached_result_length(&result);
+			}
+			talloc_free((char *)lookup.key);
+		}
+		if (rc != MEMCACHED_END && rc != MEMCACHED_NOTFOUND) break;
+		rc = error;
+		if (rc != MEMCACHED_SUCCESS) break;
+	}
+
+	memcached_result_free(&result);
+	talloc_free(local_mem_ctx);
+	return rc;
+}
+
+/**
+   \details Retrieve the value stored for a key
+
+   Records emptied by mapistore_notification_update are kept with a
+   zero length and reported as not found.
+
+   \param mem_ctx pointer to the memory context to allocate value with
+   \param notification_ctx pointer to the notification context
+   \param key the key to fetch
+   \param value pointer to the blob to return
+   \param cas pointer to the cas token to return, NULL if not needed.
+   The token of an empty record is returned along with
+   MEMCACHED_NOTFOUND, 0 is returned if the key does not exist.
+
+   \return MEMCACHED_SUCCESS on success, MEMCACHED_NOTFOUND if the key
+   does not exist or holds an empty record, otherwise memcached error
+ */
+static memcached_return mapistore_notification_kv_get(TALLOC_CTX *mem_ctx,
+						      struct mapistore_notification_context *notification_ctx,
+						      const char *key, DATA_BLOB *value, uint64_t *cas)
+{
+	memcached_return	rc;
+	char			*data;
+	size_t			length = 0;
+	uint32_t		flags;
+
+	*value = data_blob_null;
+	if (cas) *cas = 0;
+
+	if (notification_ctx->local) {
+		rc = mapistore_notification_local_get(mem_ctx, key, value, cas);
+	} else if (cas) {
+		/* cas tokens are only returned by gets, issued through mget */
+		rc = mapistore_notification_kv_mget(mem_ctx, notification_ctx, 1, &key, value, cas);
+	} else {
+		data = memcached_get(notification_ctx->memc_ctx, key, strlen(key), &length, &flags, &rc);
+		if (data) {
+			value->data = talloc_memdup(mem_ctx, data, length);
+			value->length = length;
+			free(data);
+			if (!value->data) return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+		}
+	}
+	if (rc != MEMCACHED_SUCCESS) return rc;
+
+	if (!value->length) {
+		talloc_free(value->data);
+		*value = data_blob_null;
+		return MEMCACHED_NOTFOUND;
+	}
+
+	return MEMCACHED_SUCCESS;
+}
+
+/**
+   \details Store a value for a key
+
+   \param notification_ctx pointer to the notification context
+   \param op the storage command to issue
+   \param key the key to store
+   \param data pointer to the value
+   \param length the length of the value
+   \param cas the cas token to check for MSTORE_MEMC_OP_CAS
+
+   \return MEMCACHED_SUCCESS on success, otherwise memcached error
+ */
+static memcached_return mapistore_notification_kv_store(struct mapistore_notification_context *notification_ctx,
+							enum mapistore_notification_store_op op,
+							const char *key, const uint8_t *data,
+							size_t length, uint64_t cas)
+{
+	memcached_st	*memc = notification_ctx->memc_ctx;
+
+	if (notification_ctx->local) {
+		return mapistore_notification_local_store(op, key, data, length, cas);
+	}
+
+	switch (op) {
+	case MSTORE_MEMC_OP_ADD:
+		return memcached_add(memc, key, strlen(key), (const char *)data, length, 0, 0);
+	case MSTORE_MEMC_OP_SET:
+		return memcached_set(memc, key, strlen(key), (const char *)data, length, 0, 0);
+	case MSTORE_MEMC_OP_APPEND:
+		return memcached_append(memc, key, strlen(key), (const char *)data, length, 0, 0);
+	case MSTORE_MEMC_OP_CAS:
+		return memcached_cas(memc, key, strlen(key), (const char *)data, length, 0, 0, cas);
+	}
+
+	return MEMCACHED_INVALID_ARGUMENTS;
+}
+
+static memcached_return mapistore_notification_kv_delete(struct mapistore_notification_context *notification_ctx,
+							 const char *key)
+{
+	if (notification_ctx->local) {
+		return mapistore_notification_local_delete(key);
+	}
+	return memcached_delete(notification_ctx->memc_ctx, key, strlen(key), 0);
+}
+
+/**
+   \details Check if a non-empty record is stored for a key. The value
+   is fetched since memcached_exist would also report empty records.
+
+   \return MEMCACHED_SUCCESS if the record exists, MEMCACHED_NOTFOUND
+   if it does not or is empty, otherwise memcached error
+ */
+static memcached_return mapistore_notification_kv_exist(struct mapistore_notification_context *notification_ctx,
+							const char *key)
+{
+	TALLOC_CTX		*mem_ctx;
+	memcached_return	rc;
+	DATA_BLOB		value;
+
+	mem_ctx = talloc_new(NULL);
+	if (!mem_ctx) return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+
+	rc = mapistore_notification_kv_get(mem_ctx, notification_ctx, key, &value, NULL);
+	talloc_free(mem_ctx);
+
+	return rc;
+}
+
+/**
+   \details Atomically update the record stored for a key
+
+   The record is read along with its cas token, handed to update_fn and
+   written back with memcached_cas (or memcached_add when it did not
+   exist). If another instance modified the record in between, the
+   write is rejected and the whole read-modify-write is replayed, so
+   concurrent updates are never lost.
+
+   memcached has no conditional delete, so when update_fn empties the
+   record an empty value is stored with memcached_cas instead of
+   deleting the key. Empty records are handed to update_fn as missing
+   ones and reported as not found by the readers.
+
+   \param notification_ctx pointer to the notification context
+   \param key the key of the record to update
+   \param update_fn the function computing the new record
+   \param private_data pointer to data passed to update_fn
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_notification_update(struct mapistore_notification_context *notification_ctx,
+							  const char *key,
+							  mapistore_notification_update_fn update_fn,
+							  void *private_data)
+{
+	TALLOC_CTX		*mem_ctx;
+	enum mapistore_error	retval;
+	memcached_return	rc = MEMCACHED_FAILURE;
+	DATA_BLOB		current;
+	DATA_BLOB		updated;
+	uint64_t		cas = 0;
+	bool			found;
+	int			attempt;
+
+	for (attempt = 0; attempt < MSTORE_MEMC_CAS_RETRIES; attempt++) {
+		mem_ctx = talloc_new(NULL);
+		MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+		/* An empty record is not found but still has a cas token */
+		rc = mapistore_notification_kv_get(mem_ctx, notification_ctx, key, &current, &cas);
+		MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS && rc != MEMCACHED_NOTFOUND,
+				    ret_to_mapistore(rc), mem_ctx);
+		found = (rc == MEMCACHED_SUCCESS);
+
+		updated = data_blob_null;
+		retval = update_fn(mem_ctx, found ? &current : NULL, private_data, &updated);
+		MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
+
+		if (!updated.length && !found) {
+			rc = MEMCACHED_SUCCESS;
+		} else if (cas) {
+			rc = mapistore_notification_kv_store(notification_ctx, MSTORE_MEMC_OP_CAS, key,
+							     updated.length ? updated.data : (const uint8_t *)"",
+							     updated.length, cas);
+		} else {
+			rc = mapistore_notification_kv_store(notification_ctx, MSTORE_MEMC_OP_ADD, key,
+							     updated.data, updated.length, 0);
+		}
+		talloc_free(mem_ctx);
+
+		switch (rc) {
+		case MEMCACHED_SUCCESS:
+		case MEMCACHED_STORED:
+			return MAPISTORE_SUCCESS;
+		case MEMCACHED_DATA_EXISTS:
+		case MEMCACHED_NOTSTORED:
+		case MEMCACHED_NOTFOUND:
+			/* The record changed underneath: reload it */
+			OC_DEBUG(5, "cas conflict on '%s' (attempt %d)", key, attempt + 1);
+			break;
+		default:
+			return ret_to_mapistore(rc);
+		}
+	}
+
+	OC_DEBUG(0, "giving up update of '%s' after %d cas conflicts", key, MSTORE_MEMC_CAS_RETRIES);
+	return ret_to_mapistore(rc);
+}
+
+
 /**
    \details Release the notification context used by mapistore
    notification subsystem
@@ -72,7 +414,7 @@ static int mapistore_notification_destructor(void *data)
 
 	if (notification_ctx->memc_ctx) {
 		oc_memcached_release_connection(notification_ctx->memc_ctx,
-						!notification_ctx->threading);
+						!notification_ctx->threading && !notification_ctx->local);
 	}
 
 	return 0;
@@ -107,8 +449,24 @@ enum mapistore_error mapistore_notification_init(TALLOC_CTX *mem_ctx,
 	url = lpcfg_parm_string(lp_ctx, NULL, "mapistore", "notification_cache");
 	threading = lpcfg_parm_bool(lp_ctx, NULL, "mapistore", "threading", false);
 	notification_ctx->threading = threading;
-	notification_ctx->memc_ctx = oc_memcached_new_connection(url, !threading);
-	MAPISTORE_RETVAL_IF(!notification_ctx->memc_ctx, MAPISTORE_ERR_CONTEXT_FAILED, NULL);
+
+	if (url && !strcmp(url, MSTORE_MEMC_LOCAL)) {
+		/* The in-process store is not thread-safe */
+		if (threading) {
+			OC_DEBUG(0, "local notification cache cannot be used with mapistore:threading");
+			talloc_free(notification_ctx);
+			return MAPISTORE_ERR_CONTEXT_FAILED;
+		}
+		/* Server-less handle: keeps the context valid, never used for I/O */
+		notification_ctx->local = true;
+		notification_ctx->memc_ctx = memcached_create(NULL);
+	} else {
+		notification_ctx->memc_ctx = oc_memcached_new_connection(url, !threading);
+	}
+	MAPISTORE_RETVAL_IF(!notification_ctx->memc_ctx, MAPISTORE_ERR_CONTEXT_FAILED, notification_ctx);
+	if (!notification_ctx->local) {
+		memcached_behavior_set(notification_ctx->memc_ctx, MEMCACHED_BEHAVIOR_SUPPORT_CAS, 1);
+	}
 	talloc_set_destructor((void *)notification_ctx, (int (*)(void *))mapistore_notification_destructor);
 
 	*_notification_ctx = notification_ctx;
@@ -198,8 +556,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_add(struct mapistor
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	/* Register the key */
-	rc = memcached_add(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-			   (char *)ndr->data, ndr->offset, 0, 0);
+	rc = mapistore_notification_kv_store(mstore_ctx->notification_ctx, MSTORE_MEMC_OP_ADD,
+					     key, ndr->data, ndr->offset, 0);
 	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
 
 	talloc_free(mem_ctx);
@@ -238,7 +596,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_delete(struct mapis
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	/* Delete the key */
-	rc = memcached_delete(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), 0);
+	rc = mapistore_notification_kv_delete(mstore_ctx->notification_ctx, key);
 	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
 
 	talloc_free(mem_ctx);
@@ -275,7 +633,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_exist(struct mapist
 	retval = mapistore_notification_session_set_key(mem_ctx, async_uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	rc = memcached_exist(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key));
+	rc = mapistore_notification_kv_exist(mstore_ctx->notification_ctx, key);
 	talloc_free(key);
 	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
 
@@ -311,10 +669,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_get(TALLOC_CTX *mem
 	struct mapistore_notification_session	r;
 	DATA_BLOB				blob;
 	char					*key = NULL;
-	char					*value = NULL;
-	size_t					value_len = 0;
 	memcached_return_t			rc;
-	uint32_t				flags;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -330,17 +685,11 @@ _PUBLIC_ enum mapistore_error mapistore_notification_session_get(TALLOC_CTX *mem
 	retval = mapistore_notification_session_set_key(local_mem_ctx, async_uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
-	value = memcached_get(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), &value_len,
-			      &flags, &rc);
+	rc = mapistore_notification_kv_get(local_mem_ctx, mstore_ctx->notification_ctx, key, &blob, NULL);
 	talloc_free(key);
-	MAPISTORE_RETVAL_IF(!value, ret_to_mapistore(rc), local_mem_ctx);
+	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), local_mem_ctx);
 
 	/* Unpack session structure */
-	blob.data = talloc_memdup(local_mem_ctx, (uint8_t *) value, value_len);
-	free(value);
-	MAPISTORE_RETVAL_IF(!blob.data, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
-	blob.length = value_len;
-
 	ndr = ndr_pull_init_blob(&blob, local_mem_ctx);
 	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
 	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
@@ -412,6 +761,123 @@ static enum mapistore_error mapistore_notification_resolver_set_key(TALLOC_CTX *
 }
 
 
+/**
+   \details Unpack a resolver record
+
+   \param mem_ctx pointer to the memory context to allocate the record with
+   \param blob pointer to the packed record
+   \param r pointer to the resolver record to return
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_notification_resolver_unpack(TALLOC_CTX *mem_ctx,
+								   const DATA_BLOB *blob,
+								   struct mapistore_notification_resolver *r)
+{
+	struct ndr_pull		*ndr;
+	enum ndr_err_code	ndr_err_code;
+
+	ndr = ndr_pull_init_blob(blob, mem_ctx);
+	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, NULL);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
+
+	ndr_err_code = ndr_pull_mapistore_notification_resolver(ndr, NDR_SCALARS, r);
+	talloc_free(ndr);
+	MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, NULL);
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/* Host to register or unregister within a resolver record */
+struct mapistore_notification_resolver_update {
+	const char	*cn;
+	const char	*host;
+	bool		add;
+};
+
+/**
+   \details Compute the resolver record resulting from the addition or
+   removal of a host. Used as mapistore_notification_update callback.
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_EXIST if the
+   host to add is already registered, MAPISTORE_ERR_NOT_FOUND if the
+   host to remove is not, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_notification_resolver_update(TALLOC_CTX *mem_ctx,
+								   const DATA_BLOB *current,
+								   void *private_data,
+								   DATA_BLOB *updated)
+{
+	struct mapistore_notification_resolver_update	*u = (struct mapistore_notification_resolver_update *) private_data;
+	struct mapistore_notification_resolver		r;
+	struct mapistore_notification_resolver		_r;
+	struct ndr_push					*ndr;
+	enum ndr_err_code				ndr_err_code;
+	enum mapistore_error				retval;
+	uint32_t					count = 0;
+	const char					**hosts = NULL;
+	uint32_t					i, j;
+	int						index = -1;
+
+	if (current) {
+		retval = mapistore_notification_resolver_unpack(mem_ctx, current, &r);
+		MAPISTORE_RETVAL_IF(retval, retval, NULL);
+		count = r.v.v1.count;
+		hosts = r.v.v1.hosts;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (hosts[i] && !strncmp(hosts[i], u->host, strlen(u->host))) {
+			index = i;
+			break;
+		}
+	}
+
+	_r.vnum = 1;
+	if (u->add) {
+		if (index != -1) {
+			OC_DEBUG(0, "host '%s' is already registered for cn '%s'", u->host, u->cn);
+			return MAPISTORE_ERR_EXIST;
+		}
+		_r.v.v1.count = count + 1;
+		_r.v.v1.hosts = talloc_array(mem_ctx, const char *, _r.v.v1.count);
+		MAPISTORE_RETVAL_IF(!_r.v.v1.hosts, MAPISTORE_ERR_NO_MEMORY, NULL);
+		for (i = 0; i < count; i++) {
+			_r.v.v1.hosts[i] = hosts[i];
+		}
+		_r.v.v1.hosts[count] = u->host;
+	} else {
+		MAPISTORE_RETVAL_IF(index == -1, MAPISTORE_ERR_NOT_FOUND, NULL);
+
+		/* If host is the only entry, empty the record */
+		if (count == 1) {
+			*updated = data_blob_null;
+			return MAPISTORE_SUCCESS;
+		}
+
+		_r.v.v1.count = count - 1;
+		_r.v.v1.hosts = talloc_array(mem_ctx, const char *, _r.v.v1.count);
+		MAPISTORE_RETVAL_IF(!_r.v.v1.hosts, MAPISTORE_ERR_NO_MEMORY, NULL);
+		for (i = 0, j = 0; i < count; i++) {
+			if (i != index) {
+				_r.v.v1.hosts[j++] = hosts[i];
+			}
+		}
+	}
+
+	ndr = ndr_push_init_ctx(mem_ctx);
+	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, NULL);
+	ndr->offset = 0;
+
+	ndr_err_code = ndr_push_mapistore_notification_resolver(ndr, NDR_SCALARS, &_r);
+	MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, NULL);
+
+	*updated = data_blob_const(ndr->data, ndr->offset);
+	return MAPISTORE_SUCCESS;
+}
+
+
 /**
    \details Add a record to the resolver
 
@@ -421,18 +887,8 @@ static enum mapistore_error mapistore_notification_resolver_set_key(TALLOC_CTX *
 
    \note This function acts as a wrapper and manages both the creation
    of a new key/value pair and the update of an existing record. The
-   following logic is implemented:
-
-   [START] Does the key exist?
-	If yes: Update record
-	If no: Insert key
-
-   \todo Note that a race condition is possible between the exist
-   check and the addition of the record, where the same key could have
-   been created by another instance, leading to the failure of the add
-   operation. While this scenario is very unlikely to happen in real
-   world, a retry with a counter should be implemented in further
-   iterations to reasonably circumvent this use case.
+   update is performed with a cas read-modify-write, so hosts
+   registered concurrently by other instances are preserved.
 
    \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
  */
@@ -440,13 +896,10 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_add(struct mapisto
 								  const char *cn,
 								  const char *host)
 {
-	TALLOC_CTX				*mem_ctx;
-	enum mapistore_error			retval;
-	struct mapistore_notification_resolver	r;
-	struct ndr_push				*ndr;
-	enum ndr_err_code			ndr_err_code;
-	memcached_return			rc = MEMCACHED_ERROR;
-	char					*key = NULL;
+	TALLOC_CTX					*mem_ctx;
+	enum mapistore_error				retval;
+	struct mapistore_notification_resolver_update	u;
+	char						*key = NULL;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -462,62 +915,13 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_add(struct mapisto
 	retval = mapistore_notification_resolver_set_key(mem_ctx, cn, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	/* Create resolver v1 value */
-	ndr = ndr_push_init_ctx(mem_ctx);
-	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-	ndr->offset = 0;
-
-	/* If the key already exist: update if no duplicate */
-	retval = mapistore_notification_resolver_exist(mstore_ctx, cn);
-	if (retval == MAPISTORE_SUCCESS) {
-		uint32_t	count = 0;
-		uint32_t	i = 0;
-		const char	**hosts = NULL;
-
-		retval = mapistore_notification_resolver_get(mem_ctx, mstore_ctx, cn, &count, &hosts);
-		MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
-
-		for (i = 0; i < count; i++) {
-			if (hosts[i] && !strncmp(hosts[i], host, strlen(host))) {
-				OC_DEBUG(0, "host '%s' is already registered for cn '%s'", host, cn);
-				talloc_free(mem_ctx);
-				return MAPISTORE_ERR_EXIST;
-			}
-		}
-
-		r.vnum = 1;
-		r.v.v1.count = count + 1;
-		r.v.v1.hosts = talloc_array(mem_ctx, const char *, r.v.v1.count);
-		for (i = 0; i < count; i++) {
-			r.v.v1.hosts[i] = talloc_strdup(r.v.v1.hosts, hosts[i]);
-			MAPISTORE_RETVAL_IF(!r.v.v1.hosts[i], MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-		}
-		r.v.v1.hosts[count] = talloc_strdup(r.v.v1.hosts, host);
-		MAPISTORE_RETVAL_IF(!r.v.v1.hosts[count], MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-
-		ndr_err_code = ndr_push_mapistore_notification_resolver(ndr, NDR_SCALARS, &r);
-		MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
-
-		/* Add the key/value record */
-		rc = memcached_set(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *)ndr->data, ndr->offset, 0, 0);
-	} else if (retval == MAPISTORE_ERR_NOT_FOUND) {
-		r.vnum = 1;
-		r.v.v1.count = 1;
-		r.v.v1.hosts = talloc_array(mem_ctx, const char *, 1);
-		MAPISTORE_RETVAL_IF(!r.v.v1.hosts, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-		r.v.v1.hosts[0] = talloc_strdup(r.v.v1.hosts, host);
-		MAPISTORE_RETVAL_IF(!r.v.v1.hosts[0], MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-
-		ndr_err_code = ndr_push_mapistore_notification_resolver(ndr, NDR_SCALARS, &r);
-		MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
-
-		/* Add the key/value record */
-		rc = memcached_add(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *)ndr->data, ndr->offset, 0, 0);
-	}
+	u.cn = cn;
+	u.host = host;
+	u.add = true;
+	retval = mapistore_notification_update(mstore_ctx->notification_ctx, key,
+					       mapistore_notification_resolver_update, &u);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
 }
@@ -543,15 +947,10 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_get(TALLOC_CTX *me
 {
 	TALLOC_CTX				*local_mem_ctx;
 	enum mapistore_error			retval;
-	enum ndr_err_code			ndr_err_code;
-	struct ndr_pull				*ndr;
 	struct mapistore_notification_resolver	r;
 	DATA_BLOB				blob;
 	char					*key = NULL;
-	char					*value = NULL;
-	size_t					value_len = 0;
 	memcached_return_t			rc;
-	uint32_t				flags;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -567,24 +966,13 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_get(TALLOC_CTX *me
 	retval = mapistore_notification_resolver_set_key(local_mem_ctx, cn, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
-	value = memcached_get(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), &value_len,
-			      &flags, &rc);
+	rc = mapistore_notification_kv_get(local_mem_ctx, mstore_ctx->notification_ctx, key, &blob, NULL);
 	talloc_free(key);
-	MAPISTORE_RETVAL_IF(!value, ret_to_mapistore(rc), local_mem_ctx);
+	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), local_mem_ctx);
 
 	/* Unpack resolver structure */
-	blob.data = talloc_memdup(local_mem_ctx, (uint8_t *) value, value_len);
-	free(value);
-	MAPISTORE_RETVAL_IF(!blob.data, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
-	blob.length = value_len;
-
-	ndr = ndr_pull_init_blob(&blob, local_mem_ctx);
-	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
-	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
-
-	ndr_err_code = ndr_pull_mapistore_notification_resolver(ndr, NDR_SCALARS, &r);
-	talloc_free(ndr);
-	MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, local_mem_ctx);
+	retval = mapistore_notification_resolver_unpack(local_mem_ctx, &blob, &r);
+	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
 	*countp = r.v.v1.count;
 	*hostsp = talloc_steal(mem_ctx, r.v.v1.hosts);
@@ -595,6 +983,81 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_get(TALLOC_CTX *me
 }
 
 
+/**
+   \details Get resolver data for a list of resolver entries in a
+   single batch
+
+   This is the bulk counterpart of mapistore_notification_resolver_get
+   for fan-out to many recipients: all the resolver keys are fetched
+   with pipelined memcached_mget requests instead of one round trip
+   per cn.
+
+   \param mem_ctx pointer to the memory context
+   \param mstore_ctx pointer to the mapistore context
+   \param count the number of common names to lookup
+   \param cns array of common names to lookup
+   \param recordsp pointer on the array of count records to return,
+   in the same order as cns. Records of unregistered common names
+   have a count of 0
+
+   \note calling function is responsible for freeing recordsp
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_notification_resolver_get_multi(TALLOC_CTX *mem_ctx,
+									struct mapistore_context *mstore_ctx,
+									uint32_t count, const char **cns,
+									struct mapistore_notification_resolver_record **recordsp)
+{
+	TALLOC_CTX					*local_mem_ctx;
+	enum mapistore_error				retval;
+	struct mapistore_notification_resolver		r;
+	struct mapistore_notification_resolver_record	*records;
+	DATA_BLOB					*blobs;
+	char						**keys;
+	memcached_return_t				rc;
+	uint32_t					i;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(count && !cns, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!recordsp, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->notification_ctx->memc_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+
+	local_mem_ctx = talloc_new(NULL);
+	MAPISTORE_RETVAL_IF(!local_mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	records = talloc_zero_array(local_mem_ctx, struct mapistore_notification_resolver_record, count);
+	keys = talloc_array(local_mem_ctx, char *, count);
+	blobs = talloc_array(local_mem_ctx, DATA_BLOB, count);
+	MAPISTORE_RETVAL_IF(!records || !keys || !blobs, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
+
+	for (i = 0; i < count; i++) {
+		retval = mapistore_notification_resolver_set_key(keys, cns[i], &keys[i]);
+		MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
+	}
+
+	rc = mapistore_notification_kv_mget(local_mem_ctx, mstore_ctx->notification_ctx, count,
+					    (const char **)keys, blobs, NULL);
+	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), local_mem_ctx);
+
+	for (i = 0; i < count; i++) {
+		records[i].cn = cns[i];
+		if (!blobs[i].data) continue;
+
+		retval = mapistore_notification_resolver_unpack(records, &blobs[i], &r);
+		MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
+		records[i].count = r.v.v1.count;
+		records[i].hosts = r.v.v1.hosts;
+	}
+
+	*recordsp = talloc_steal(mem_ctx, records);
+	talloc_free(local_mem_ctx);
+	return MAPISTORE_SUCCESS;
+}
+
+
 /**
    \details Unregister a host from a resolver entry
 
@@ -602,25 +1065,18 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_get(TALLOC_CTX *me
    \param cn the resolver key to lookup
    \param host the host entry to delete within record
 
-   \note If the record has no longer host entry, the function deletes
-   the record
+   \note If the record has no longer host entry, the function empties
+   the record, which is then reported as not found
 
    \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
  */
 _PUBLIC_ enum mapistore_error mapistore_notification_resolver_delete(struct mapistore_context *mstore_ctx,
 								     const char *cn, const char *host)
 {
-	TALLOC_CTX				*mem_ctx;
-	memcached_return			rc;
-	struct mapistore_notification_resolver	r;
-	enum mapistore_error			retval;
-	enum ndr_err_code			ndr_err_code;
-	struct ndr_push				*ndr;
-	char					*key;
-	uint32_t				count;
-	const char				**hosts = NULL;
-	uint32_t				i, j;
-	int					index = -1;
+	TALLOC_CTX					*mem_ctx;
+	enum mapistore_error				retval;
+	struct mapistore_notification_resolver_update	u;
+	char						*key;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -632,56 +1088,17 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_delete(struct mapi
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
 
-	/* Get the record and fetch host entry index */
-	retval = mapistore_notification_resolver_get(mem_ctx, mstore_ctx, cn, &count, &hosts);
-	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
-
-	for (i = 0; i < count; i++) {
-		if (hosts[i] && !strncmp(hosts[i], host, strlen(host))) {
-			index = i;
-			break;
-		}
-	}
-	MAPISTORE_RETVAL_IF(index == -1, MAPISTORE_ERR_NOT_FOUND, mem_ctx);
-
 	/* Prepare the resolver key */
 	retval = mapistore_notification_resolver_set_key(mem_ctx, cn, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	/* If host is the only entry, delete the record */
-	if (count == 1) {
-		rc = memcached_delete(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), 0);
-		MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
-		goto end;
-	}
-
-	/* Otherwise remove the entry from the array and update record */
-	ndr = ndr_push_init_ctx(mem_ctx);
-	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-	ndr->offset = 0;
-
-	r.vnum = 1;
-	r.v.v1.count = count - 1;
-	r.v.v1.hosts = talloc_array(mem_ctx, const char *, r.v.v1.count);
-
-	MAPISTORE_RETVAL_IF(!r.v.v1.hosts, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-
-	for (i = 0, j = 0; i < count; i++) {
-		if (i != index) {
-			r.v.v1.hosts[j] = talloc_strdup(r.v.v1.hosts, hosts[i]);
-			MAPISTORE_RETVAL_IF(!r.v.v1.hosts[j], MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-			j++;
-		}
-	}
-
-	ndr_err_code = ndr_push_mapistore_notification_resolver(ndr, NDR_SCALARS, &r);
-	MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
-
-	rc = memcached_set(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-			   (char *)ndr->data, ndr->offset, 0, 0);
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	u.cn = cn;
+	u.host = host;
+	u.add = false;
+	retval = mapistore_notification_update(mstore_ctx->notification_ctx, key,
+					       mapistore_notification_resolver_update, &u);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-end:
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
 }
@@ -718,7 +1135,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_resolver_exist(struct mapis
 	retval = mapistore_notification_resolver_set_key(mem_ctx, cn, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	rc = memcached_exist(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key));
+	rc = mapistore_notification_kv_exist(mstore_ctx->notification_ctx, key);
 	talloc_free(key);
 	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
 
@@ -760,6 +1177,34 @@ static enum mapistore_error mapistore_notification_subscription_set_key(TALLOC_C
 }
 
 
+/**
+   \details Unpack a subscription record
+
+   \param mem_ctx pointer to the memory context to allocate the record with
+   \param blob pointer to the packed record
+   \param r pointer to the subscription record to return
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+static enum mapistore_error mapistore_notification_subscription_unpack(TALLOC_CTX *mem_ctx,
+								       const DATA_BLOB *blob,
+								       struct mapistore_notification_subscription *r)
+{
+	struct ndr_pull		*ndr;
+	enum ndr_err_code	ndr_err_code;
+
+	ndr = ndr_pull_init_blob(blob, mem_ctx);
+	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, NULL);
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
+
+	ndr_err_code = ndr_pull_mapistore_notification_subscription(ndr, NDR_SCALARS, r);
+	talloc_free(ndr);
+	MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERROR, NULL);
+
+	return MAPISTORE_SUCCESS;
+}
+
+
 /**
    \details Retrieve all the subscriptions associated to a uuid
 
@@ -780,15 +1225,9 @@ enum mapistore_error mapistore_notification_subscription_get(TALLOC_CTX *mem_ctx
 {
 	TALLOC_CTX					*local_mem_ctx;
 	enum mapistore_error				retval;
-	enum ndr_err_code				ndr_err_code;
-	struct ndr_pull					*ndr;
 	DATA_BLOB					blob;
-	struct mapistore_notification_subscription	r;
 	char						*key;
-	char						*value = NULL;
-	size_t						value_len = 0;
 	memcached_return_t				rc;
-	uint32_t					flags;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -803,28 +1242,103 @@ enum mapistore_error mapistore_notification_subscription_get(TALLOC_CTX *mem_ctx
 	retval = mapistore_notification_subscription_set_key(local_mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
-	value = memcached_get(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), &value_len,
-			      &flags, &rc);
+	rc = mapistore_notification_kv_get(local_mem_ctx, mstore_ctx->notification_ctx, key, &blob, NULL);
 	talloc_free(key);
-	MAPISTORE_RETVAL_IF(!value, ret_to_mapistore(rc), local_mem_ctx);
+	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), local_mem_ctx);
 
 	/* Unpack subscription structure */
-	blob.data = talloc_memdup(local_mem_ctx, (uint8_t *) value, value_len);
-	free(value);
-	MAPISTORE_RETVAL_IF(!blob.data, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
-	blob.length = value_len;
+	retval = mapistore_notification_subscription_unpack(mem_ctx, &blob, _r);
+	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
-	ndr = ndr_pull_init_blob(&blob, mem_ctx);
-	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
-	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN|LIBNDR_FLAG_REF_ALLOC);
+	talloc_free(local_mem_ctx);
+	return MAPISTORE_SUCCESS;
+}
 
-	ndr_err_code = ndr_pull_mapistore_notification_subscription(ndr, NDR_SCALARS, &r);
-	talloc_free(ndr);
-	MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERROR, local_mem_ctx);
 
-	*_r = r;
+/* Subscription to register, or handle of the subscription to remove */
+struct mapistore_notification_subscription_update {
+	struct subscription_object_v1	object;
+	bool				add;
+};
 
-	talloc_free(local_mem_ctx);
+/**
+   \details Compute the subscription record resulting from the
+   addition or removal of a subscription. Used as
+   mapistore_notification_update callback.
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_EXIST if a
+   subscription with the same handle is already registered,
+   MAPISTORE_ERR_NOT_FOUND if the handle to remove is not, otherwise
+   MAPISTORE error
+ */
+static enum mapistore_error mapistore_notification_subscription_update(TALLOC_CTX *mem_ctx,
+								       const DATA_BLOB *current,
+								       void *private_data,
+								       DATA_BLOB *updated)
+{
+	struct mapistore_notification_subscription_update	*u = (struct mapistore_notification_subscription_update *) private_data;
+	struct mapistore_notification_subscription		r;
+	struct mapistore_notification_subscription		_r;
+	struct ndr_push						*ndr;
+	enum ndr_err_code					ndr_err_code;
+	enum mapistore_error					retval;
+	uint32_t						count = 0;
+	uint32_t						i, j;
+	int							index = -1;
+
+	if (current) {
+		retval = mapistore_notification_subscription_unpack(mem_ctx, current, &r);
+		MAPISTORE_RETVAL_IF(retval, retval, NULL);
+		count = r.v.v1.count;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (r.v.v1.subscription[i].handle == u->object.handle) {
+			index = i;
+			break;
+		}
+	}
+
+	_r.vnum = 1;
+	if (u->add) {
+		if (index != -1) {
+			OC_DEBUG(0, "subscription with handle=0x%x already exist", u->object.handle);
+			return MAPISTORE_ERR_EXIST;
+		}
+		_r.v.v1.count = count + 1;
+		_r.v.v1.subscription = talloc_array(mem_ctx, struct subscription_object_v1, _r.v.v1.count);
+		MAPISTORE_RETVAL_IF(!_r.v.v1.subscription, MAPISTORE_ERR_NO_MEMORY, NULL);
+		for (i = 0; i < count; i++) {
+			_r.v.v1.subscription[i] = r.v.v1.subscription[i];
+		}
+		_r.v.v1.subscription[count] = u->object;
+	} else {
+		MAPISTORE_RETVAL_IF(index == -1, MAPISTORE_ERR_NOT_FOUND, NULL);
+
+		/* If we only have one entry left, empty the record */
+		if (count == 1) {
+			*updated = data_blob_null;
+			return MAPISTORE_SUCCESS;
+		}
+
+		_r.v.v1.count = count - 1;
+		_r.v.v1.subscription = talloc_array(mem_ctx, struct subscription_object_v1, _r.v.v1.count);
+		MAPISTORE_RETVAL_IF(!_r.v.v1.subscription, MAPISTORE_ERR_NO_MEMORY, NULL);
+		for (i = 0, j = 0; i < count; i++) {
+			if (i != index) {
+				_r.v.v1.subscription[j++] = r.v.v1.subscription[i];
+			}
+		}
+	}
+
+	ndr = ndr_push_init_ctx(mem_ctx);
+	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, NULL);
+	ndr->offset = 0;
+
+	ndr_err_code = ndr_push_mapistore_notification_subscription(ndr, NDR_SCALARS, &_r);
+	MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, NULL);
+
+	*updated = data_blob_const(ndr->data, ndr->offset);
 	return MAPISTORE_SUCCESS;
 }
 
@@ -854,14 +1368,10 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_add(struct map
 								      uint32_t count,
 								      enum MAPITAGS *properties)
 {
-	TALLOC_CTX					*mem_ctx;
-	enum mapistore_error				retval;
-	struct mapistore_notification_subscription	r;
-	struct ndr_push					*ndr;
-	enum ndr_err_code				ndr_err_code;
-	memcached_return				rc = MEMCACHED_ERROR;
-	char						*key = NULL;
-
+	TALLOC_CTX						*mem_ctx;
+	enum mapistore_error					retval;
+	struct mapistore_notification_subscription_update	u;
+	char							*key = NULL;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -876,69 +1386,18 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_add(struct map
 	retval = mapistore_notification_subscription_set_key(mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	/* Create subscription v1 blob */
-	ndr = ndr_push_init_ctx(mem_ctx);
-	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-	ndr->offset = 0;
-
-	retval = mapistore_notification_subscription_exist(mstore_ctx, uuid);
-	if (retval == MAPISTORE_SUCCESS) {
-		uint32_t	i = 0;
-		uint32_t	last = 0;
-
-		retval = mapistore_notification_subscription_get(mem_ctx, mstore_ctx, uuid, &r);
-		MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
-
-		/* Check if the subscription does not already exist */
-		for (i = 0; i < r.v.v1.count; i++) {
-			if (r.v.v1.subscription[i].handle == handle) {
-				OC_DEBUG(0, "subscription with handle=0x%x already exist", handle);
-				talloc_free(mem_ctx);
-				return MAPISTORE_ERR_EXIST;
-			}
-		}
-
-		r.vnum = 1;
-		last = r.v.v1.count;
-		r.v.v1.count = r.v.v1.count + 1;
-		r.v.v1.subscription = talloc_realloc(mem_ctx, r.v.v1.subscription, struct subscription_object_v1, r.v.v1.count + 1);
-		r.v.v1.subscription[last].handle = handle;
-		r.v.v1.subscription[last].flags = flags;
-		r.v.v1.subscription[last].fid = fid;
-		r.v.v1.subscription[last].mid = mid;
-		r.v.v1.subscription[last].count = count;
-		r.v.v1.subscription[last].properties = (uint32_t *)properties;
-
-		ndr_err_code = ndr_push_mapistore_notification_subscription(ndr, NDR_SCALARS, &r);
-		MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
-
-		/* Add the key/value record */
-		rc = memcached_set(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *) ndr->data, ndr->offset, 0, 0);
-
-	} else {
-		r.vnum = 1;
-		r.v.v1.count = 1;
-		r.v.v1.subscription = talloc_array(mem_ctx, struct subscription_object_v1, 1);
-		MAPISTORE_RETVAL_IF(!r.v.v1.subscription, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-		r.v.v1.subscription[0].handle = handle;
-		r.v.v1.subscription[0].flags = flags;
-		r.v.v1.subscription[0].fid = fid;
-		r.v.v1.subscription[0].mid = mid;
-		r.v.v1.subscription[0].count = count;
-		r.v.v1.subscription[0].properties = (uint32_t *)properties;
-
-		ndr_err_code = ndr_push_mapistore_notification_subscription(ndr, NDR_SCALARS, &r);
-		MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
-
-		/* Add the key/value record */
-		rc = memcached_add(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *)ndr->data, ndr->offset, 0, 0);
-	}
+	u.add = true;
+	u.object.handle = handle;
+	u.object.flags = flags;
+	u.object.fid = fid;
+	u.object.mid = mid;
+	u.object.count = count;
+	u.object.properties = (uint32_t *)properties;
+	retval = mapistore_notification_update(mstore_ctx->notification_ctx, key,
+					       mapistore_notification_subscription_update, &u);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
 	talloc_free(mem_ctx);
-
 	return MAPISTORE_SUCCESS;
 }
 
@@ -971,7 +1430,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_exist(struct m
 	retval = mapistore_notification_subscription_set_key(mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	rc = memcached_exist(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key));
+	rc = mapistore_notification_kv_exist(mstore_ctx->notification_ctx, key);
 	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
 
 	talloc_free(mem_ctx);
@@ -1008,7 +1467,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_delete(struct
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	/* Delete the key */
-	rc = memcached_delete(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), 0);
+	rc = mapistore_notification_kv_delete(mstore_ctx->notification_ctx, key);
 	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
 
 	talloc_free(mem_ctx);
@@ -1030,15 +1489,10 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_delete_by_hand
 										   struct GUID uuid,
 										   uint32_t handle)
 {
-	TALLOC_CTX					*mem_ctx;
-	memcached_return				rc;
-	struct mapistore_notification_subscription	r, _r;
-	enum mapistore_error				retval;
-	enum ndr_err_code				ndr_err_code;
-	struct ndr_push					*ndr;
-	char						*key;
-	uint32_t					i, j;
-	int						index = -1;
+	TALLOC_CTX						*mem_ctx;
+	enum mapistore_error					retval;
+	struct mapistore_notification_subscription_update	u;
+	char							*key;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -1048,54 +1502,16 @@ _PUBLIC_ enum mapistore_error mapistore_notification_subscription_delete_by_hand
 	mem_ctx = talloc_new(NULL);
 	MAPISTORE_RETVAL_IF(!mem_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
 
-	/* Get the record */
-	retval = mapistore_notification_subscription_get(mem_ctx, mstore_ctx, uuid, &r);
-	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
-
-	for (i = 0; i < r.v.v1.count; i++) {
-		if (r.v.v1.subscription[i].handle == handle) {
-			index = i;
-			break;
-		}
-	}
-	MAPISTORE_RETVAL_IF(index == -1, MAPISTORE_ERR_NOT_FOUND, mem_ctx);
-
 	/* Prepare the subscription key */
 	retval = mapistore_notification_subscription_set_key(mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	/* If we only have one entry left, delete the record */
-	if (r.v.v1.count == 1) {
-		rc = memcached_delete(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), 0);
-		MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
-		goto end;
-	}
-
-	/* Otherwise remove the entry from the array and update record */
-	ndr = ndr_push_init_ctx(mem_ctx);
-	MAPISTORE_RETVAL_IF(!ndr, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-	ndr->offset = 0;
-
-	_r.vnum = 1;
-	_r.v.v1.count = r.v.v1.count - 1;
-	_r.v.v1.subscription = talloc_array(mem_ctx, struct subscription_object_v1, _r.v.v1.count + 1);
-	MAPISTORE_RETVAL_IF(!_r.v.v1.subscription, MAPISTORE_ERR_NO_MEMORY, mem_ctx);
-
-	for (i = 0, j = 0; i < r.v.v1.count; i++) {
-		if (i != index) {
-			_r.v.v1.subscription[j] = r.v.v1.subscription[i];
-			j++;
-		}
-	}
-
-	ndr_err_code = ndr_push_mapistore_notification_subscription(ndr, NDR_SCALARS, &_r);
-	MAPISTORE_RETVAL_IF(ndr_err_code != NDR_ERR_SUCCESS, MAPISTORE_ERR_INVALID_DATA, mem_ctx);
-
-	rc = memcached_set(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-			   (char *)ndr->data, ndr->offset, 0, 0);
-	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
+	u.add = false;
+	u.object.handle = handle;
+	retval = mapistore_notification_update(mstore_ctx->notification_ctx, key,
+					       mapistore_notification_subscription_update, &u);
+	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-end:
 	talloc_free(mem_ctx);
 	return MAPISTORE_SUCCESS;
 }
@@ -1149,7 +1565,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_add(struct mapistor
 	TALLOC_CTX		*mem_ctx;
 	enum mapistore_error	retval;
 	char			*key = NULL;
-	memcached_return	rc;
+	memcached_return	rc = MEMCACHED_NOTSTORED;
+	int			attempt;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -1165,17 +1582,17 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_add(struct mapistor
 	retval = mapistore_notification_deliver_set_key(mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	/* Create deliver v1 blob */
-	retval = mapistore_notification_deliver_exist(mstore_ctx, uuid);
-	if (retval == MAPISTORE_SUCCESS) {
-		/* Update the key/value record */
-		rc = memcached_append(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *) payload, length, 0, 0);
-
-	} else {
-		/* Add the key/value record */
-		rc = memcached_add(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key),
-				   (char *)payload, length, 0, 0);
+	/* Both add and append are atomic: add fails if the key was created
+	   meanwhile, append if it was consumed meanwhile. Alternate until
+	   one of them succeeds. */
+	for (attempt = 0; attempt < MSTORE_MEMC_CAS_RETRIES; attempt++) {
+		rc = mapistore_notification_kv_store(mstore_ctx->notification_ctx, MSTORE_MEMC_OP_ADD,
+						     key, payload, length, 0);
+		if (rc != MEMCACHED_NOTSTORED) break;
+
+		rc = mapistore_notification_kv_store(mstore_ctx->notification_ctx, MSTORE_MEMC_OP_APPEND,
+						     key, payload, length, 0);
+		if (rc != MEMCACHED_NOTSTORED) break;
 	}
 
 	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
@@ -1213,7 +1630,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_exist(struct mapist
 	retval = mapistore_notification_deliver_set_key(mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
-	rc = memcached_exist(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key));
+	rc = mapistore_notification_kv_exist(mstore_ctx->notification_ctx, key);
 	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
 
 	talloc_free(mem_ctx);
@@ -1239,10 +1656,8 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_get(TALLOC_CTX *mem
 	TALLOC_CTX		*local_mem_ctx;
 	enum mapistore_error	retval;
 	char			*key = NULL;
-	char			*value;
-	size_t			value_len = 0;
+	DATA_BLOB		value;
 	memcached_return_t	rc;
-	uint32_t		flags;
 
 	/* Sanity checks */
 	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
@@ -1258,15 +1673,12 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_get(TALLOC_CTX *mem
 	retval = mapistore_notification_deliver_set_key(local_mem_ctx, uuid, &key);
 	MAPISTORE_RETVAL_IF(retval, retval, local_mem_ctx);
 
-	value = memcached_get(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), &value_len,
-			      &flags, &rc);
+	rc = mapistore_notification_kv_get(mem_ctx, mstore_ctx->notification_ctx, key, &value, NULL);
 	talloc_free(key);
-	MAPISTORE_RETVAL_IF(!value, ret_to_mapistore(rc), local_mem_ctx);
+	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), local_mem_ctx);
 
-	*payload = talloc_memdup(mem_ctx, value, value_len);
-	free(value);
-	MAPISTORE_RETVAL_IF(!payload, MAPISTORE_ERR_NO_MEMORY, local_mem_ctx);
-	*length = value_len;
+	*payload = value.data;
+	*length = value.length;
 
 	talloc_free(local_mem_ctx);
 	return MAPISTORE_SUCCESS;
@@ -1301,7 +1713,7 @@ _PUBLIC_ enum mapistore_error mapistore_notification_deliver_delete(struct mapis
 	MAPISTORE_RETVAL_IF(retval, retval, mem_ctx);
 
 	/* Delete the key */
-	rc = memcached_delete(mstore_ctx->notification_ctx->memc_ctx, key, strlen(key), 0);
+	rc = mapistore_notification_kv_delete(mstore_ctx->notification_ctx, key);
 	MAPISTORE_RETVAL_IF(rc != MEMCACHED_SUCCESS, ret_to_mapistore(rc), mem_ctx);
 
 	talloc_free(mem_ctx);
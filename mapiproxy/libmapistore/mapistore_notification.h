@@ -33,4 +33,29 @@
 #define	MSTORE_MEMC_FMT_SUBSCRIPTION "subscription:%s"
 #define	MSTORE_MEMC_FMT_DELIVER "deliver:%s"
 
+/* notification_cache value selecting the in-process memcached stand-in */
+#define	MSTORE_MEMC_LOCAL "local"
+
+/* Number of read-modify-write attempts before giving up on a CAS conflict */
+#define	MSTORE_MEMC_CAS_RETRIES 16
+
+/* Maximum number of keys sent in a single memcached_mget request */
+#define	MSTORE_MEMC_MGET_BATCH 256
+
+enum mapistore_notification_store_op {
+	MSTORE_MEMC_OP_ADD,
+	MSTORE_MEMC_OP_SET,
+	MSTORE_MEMC_OP_APPEND,
+	MSTORE_MEMC_OP_CAS
+};
+
+__BEGIN_DECLS
+
+/* definitions from mapistore_notification_local.c */
+memcached_return mapistore_notification_local_get(TALLOC_CTX *, const char *, DATA_BLOB *, uint64_t *);
+memcached_return mapistore_notification_local_store(enum mapistore_notification_store_op, const char *, const uint8_t *, size_t, uint64_t);
+memcached_return mapistore_notification_local_delete(const char *);
+
+__END_DECLS
+
 #endif /* MAPISTORE_NOTIFICATION_H */
@@ -0,0 +1,191 @@
+/*
+   OpenChange Storage Abstraction Layer library
+
+   OpenChange Project
+
+   Copyright (C) Julien Kerihuel 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file mapistore_notification_local.c
+
+   \brief In-process stand-in for the memcached server used by the
+   notification subsystem.
+
+   Records live in a process-wide hash table and follow memcached
+   semantics closely enough (add/set/append/cas, cas tokens, return
+   codes) for the notification code to run unchanged on top of it. It
+   is meant for single process deployments and for the testsuite: it
+   is neither shared between processes nor thread-safe.
+ */
+
+#include "mapiproxy/libmapistore/mapistore_notification.h"
+#include "mapiproxy/util/ccan/htable/htable.h"
+#include "mapiproxy/util/ccan/hash/hash.h"
+
+struct mapistore_notification_local_item {
+	char		*key;
+	uint8_t		*data;
+	size_t		length;
+	uint64_t	cas;
+};
+
+static size_t mapistore_notification_local_rehash(const void *e, void *unused)
+{
+	return hash_string(((const struct mapistore_notification_local_item *)e)->key);
+}
+
+static bool mapistore_notification_local_cmp(const void *e, void *key)
+{
+	return strcmp(((const struct mapistore_notification_local_item *)e)->key, (const char *)key) == 0;
+}
+
+/* Process-wide records, released at exit like shared memcached connections */
+static struct htable local_ht = HTABLE_INITIALIZER(local_ht, mapistore_notification_local_rehash, NULL);
+static TALLOC_CTX *local_mem_ctx = NULL;
+static uint64_t local_cas = 0;
+
+static struct mapistore_notification_local_item *mapistore_notification_local_lookup(const char *key)
+{
+	return htable_get(&local_ht, hash_string(key), mapistore_notification_local_cmp, key);
+}
+
+
+/**
+   \details Retrieve a record and its cas token
+
+   \param mem_ctx pointer to the memory context to allocate value with
+   \param key the key to lookup
+   \param value pointer to the data blob to return
+   \param cas pointer to the cas token to return, may be NULL
+
+   \return MEMCACHED_SUCCESS on success, MEMCACHED_NOTFOUND if the key
+   does not exist, otherwise MEMCACHED_MEMORY_ALLOCATION_FAILURE
+ */
+memcached_return mapistore_notification_local_get(TALLOC_CTX *mem_ctx, const char *key,
+						  DATA_BLOB *value, uint64_t *cas)
+{
+	struct mapistore_notification_local_item	*item;
+
+	item = mapistore_notification_local_lookup(key);
+	if (!item) {
+		return MEMCACHED_NOTFOUND;
+	}
+
+	value->data = talloc_memdup(mem_ctx, item->data, item->length);
+	if (!value->data) {
+		return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+	}
+	value->length = item->length;
+	if (cas) {
+		*cas = item->cas;
+	}
+
+	return MEMCACHED_SUCCESS;
+}
+
+
+/**
+   \details Store a record
+
+   \param op the memcached storage command to emulate
+   \param key the key to store
+   \param data pointer to the value
+   \param length the length of the value
+   \param cas the cas token expected by MSTORE_MEMC_OP_CAS
+
+   \return MEMCACHED_SUCCESS on success, MEMCACHED_NOTSTORED when the
+   add/append precondition fails, MEMCACHED_NOTFOUND or
+   MEMCACHED_DATA_EXISTS when a cas update is stale, otherwise
+   MEMCACHED_MEMORY_ALLOCATION_FAILURE
+ */
+memcached_return mapistore_notification_local_store(enum mapistore_notification_store_op op,
+						    const char *key, const uint8_t *data,
+						    size_t length, uint64_t cas)
+{
+	struct mapistore_notification_local_item	*item;
+	uint8_t						*buf;
+
+	item = mapistore_notification_local_lookup(key);
+	switch (op) {
+	case MSTORE_MEMC_OP_ADD:
+		if (item) return MEMCACHED_NOTSTORED;
+		break;
+	case MSTORE_MEMC_OP_APPEND:
+		if (!item) return MEMCACHED_NOTSTORED;
+		buf = talloc_realloc(item, item->data, uint8_t, item->length + length);
+		if (!buf) return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+		memcpy(buf + item->length, data, length);
+		item->data = buf;
+		item->length += length;
+		item->cas = ++local_cas;
+		return MEMCACHED_SUCCESS;
+	case MSTORE_MEMC_OP_CAS:
+		if (!item) return MEMCACHED_NOTFOUND;
+		if (item->cas != cas) return MEMCACHED_DATA_EXISTS;
+		break;
+	case MSTORE_MEMC_OP_SET:
+		break;
+	}
+
+	if (!item) {
+		if (!local_mem_ctx) {
+			local_mem_ctx = talloc_named_const(talloc_autofree_context(), 0,
+							   "mapistore_notification_local");
+			if (!local_mem_ctx) return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+		}
+		item = talloc_zero(local_mem_ctx, struct mapistore_notification_local_item);
+		if (!item) return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+		item->key = talloc_strdup(item, key);
+		item->data = talloc_memdup(item, data, length);
+		if (!item->key || !item->data || !htable_add(&local_ht, hash_string(key), item)) {
+			talloc_free(item);
+			return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+		}
+	} else {
+		buf = talloc_memdup(item, data, length);
+		if (!buf) return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+		talloc_free(item->data);
+		item->data = buf;
+	}
+	item->length = length;
+	item->cas = ++local_cas;
+
+	return MEMCACHED_SUCCESS;
+}
+
+
+/**
+   \details Delete a record
+
+   \param key the key to delete
+
+   \return MEMCACHED_SUCCESS on success, otherwise MEMCACHED_NOTFOUND
+ */
+memcached_return mapistore_notification_local_delete(const char *key)
+{
+	struct mapistore_notification_local_item	*item;
+
+	item = mapistore_notification_local_lookup(key);
+	if (!item) {
+		return MEMCACHED_NOTFOUND;
+	}
+
+	htable_del(&local_ht, hash_string(key), item);
+	talloc_free(item);
+
+	return MEMCACHED_SUCCESS;
+}
@@ -0,0 +1,466 @@
+/*
+   OpenChange Storage Abstraction Layer library
+
+   OpenChange Project
+
+   Copyright (C) Julien Kerihuel 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file mapistore_prefetch.c
+
+   \brief Look-ahead preloading of message bodies
+
+   Callers hint the ordered list of messages a client is about to
+   read (ICS message window, QueryRows result) and report each
+   message they actually open. The engine keeps the bodies of the
+   next messages preloaded in the backend, at most cache_size per
+   stream. When an event context is registered, preloads are deferred
+   to the event loop so they run between client requests instead of
+   inside them; a read reaching a message that is not preloaded yet
+   loads the next window synchronously.
+
+   Backends are not thread safe, so no worker thread is used. Without
+   an event context every preload is run synchronously.
+ */
+
+#include <tevent.h>
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+
+/**
+   \details Ask the backend to preload the bodies of a range of
+   messages within a stream
+
+   \param stream pointer to the prefetch stream
+   \param lo index of the first message to preload
+   \param hi index following the last message to preload
+ */
+static void mapistore_prefetch_load(struct mapistore_prefetch_stream *stream,
+				    uint32_t lo, uint32_t hi)
+{
+	struct mapistore_prefetch_context	*prefetch_ctx = stream->prefetch_ctx;
+	struct UI8Array_r			mids;
+	enum mapistore_error			retval;
+
+	if (hi > stream->count) {
+		hi = stream->count;
+	}
+	if (lo >= hi) return;
+
+	mids.cValues = hi - lo;
+	mids.lpui8 = stream->mids + lo;
+	retval = mapistore_folder_preload_message_bodies(prefetch_ctx->mstore_ctx, stream->context_id,
+							 stream->folder, stream->table_type, &mids);
+	if (retval != MAPISTORE_SUCCESS) {
+		OC_DEBUG(5, "[mapistore_prefetch]: preload of %"PRIu32" messages failed: %s",
+			 hi - lo, mapistore_errstr(retval));
+		return;
+	}
+
+	prefetch_ctx->stats.preloads++;
+	prefetch_ctx->stats.preloaded += hi - lo;
+	stream->lo = lo;
+	stream->hi = hi;
+}
+
+
+/**
+   \details Extend the preloaded range of a stream to cache_size
+   messages past the read position
+ */
+static void mapistore_prefetch_refill(struct mapistore_prefetch_stream *stream)
+{
+	struct mapistore_prefetch_context	*prefetch_ctx = stream->prefetch_ctx;
+
+	stream->pending = false;
+	if (stream->position >= stream->count) return;
+	if (stream->lo <= stream->position && stream->hi >= stream->count) return;
+
+	mapistore_prefetch_load(stream, stream->position, stream->position + prefetch_ctx->cache_size);
+}
+
+
+/**
+   \details tevent immediate handler running the preloads deferred
+   since the last event loop iteration
+ */
+static void mapistore_prefetch_handler(struct tevent_context *ev,
+				       struct tevent_immediate *im,
+				       void *private_data)
+{
+	struct mapistore_prefetch_context	*prefetch_ctx = (struct mapistore_prefetch_context *) private_data;
+	struct mapistore_prefetch_stream	*stream;
+
+	prefetch_ctx->scheduled = false;
+	for (stream = prefetch_ctx->streams; stream; stream = stream->next) {
+		if (stream->pending) {
+			prefetch_ctx->stats.deferred++;
+			mapistore_prefetch_refill(stream);
+		}
+	}
+}
+
+
+/**
+   \details Queue a refill of the stream, or run it right away when
+   no event context is available
+ */
+static void mapistore_prefetch_schedule(struct mapistore_prefetch_stream *stream)
+{
+	struct mapistore_prefetch_context	*prefetch_ctx = stream->prefetch_ctx;
+
+	if (!prefetch_ctx->ev || !prefetch_ctx->im) {
+		mapistore_prefetch_refill(stream);
+		return;
+	}
+
+	stream->pending = true;
+	if (prefetch_ctx->scheduled == false) {
+		tevent_schedule_immediate(prefetch_ctx->im, prefetch_ctx->ev,
+					  mapistore_prefetch_handler, prefetch_ctx);
+		prefetch_ctx->scheduled = true;
+	}
+}
+
+
+/**
+   \details Search a message in a stream, starting from the read
+   position so sequential reads are found at once
+
+   \param stream pointer to the prefetch stream
+   \param mid the message identifier to search
+   \param index pointer to the index of the message to return
+
+   \return true if the message belongs to the stream, otherwise false
+ */
+static bool mapistore_prefetch_stream_find(struct mapistore_prefetch_stream *stream,
+					   uint64_t mid, uint32_t *index)
+{
+	uint32_t	i, k;
+
+	for (i = 0; i < stream->count; i++) {
+		k = (stream->position + i) % stream->count;
+		if (stream->mids[k] == mid) {
+			*index = k;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+static int mapistore_prefetch_stream_destructor(void *data)
+{
+	struct mapistore_prefetch_stream	*stream = (struct mapistore_prefetch_stream *) data;
+	struct mapistore_prefetch_context	*prefetch_ctx = stream->prefetch_ctx;
+
+	DLIST_REMOVE(prefetch_ctx->streams, stream);
+	prefetch_ctx->stream_count--;
+
+	return 0;
+}
+
+
+/**
+   \details Initialize the message body prefetch engine
+
+   \param mstore_ctx pointer to the mapistore context
+   \param lp_ctx loadparm_context to get smb.conf options
+   \param _prefetch_ctx pointer to the prefetch context to return
+
+   \note *_prefetch_ctx is set to NULL when prefetching is disabled
+   with "mapistore:prefetch = false"
+
+   \return MAPISTORE_SUCCESS on success, otherwise MAPISTORE error
+ */
+enum mapistore_error mapistore_prefetch_init(struct mapistore_context *mstore_ctx,
+					     struct loadparm_context *lp_ctx,
+					     struct mapistore_prefetch_context **_prefetch_ctx)
+{
+	struct mapistore_prefetch_context	*prefetch_ctx;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!lp_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!_prefetch_ctx, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	*_prefetch_ctx = NULL;
+	if (lpcfg_parm_bool(lp_ctx, NULL, "mapistore", "prefetch", true) == false) {
+		return MAPISTORE_SUCCESS;
+	}
+
+	prefetch_ctx = talloc_zero(mstore_ctx, struct mapistore_prefetch_context);
+	MAPISTORE_RETVAL_IF(!prefetch_ctx, MAPISTORE_ERR_NO_MEMORY, NULL);
+
+	prefetch_ctx->mstore_ctx = mstore_ctx;
+	prefetch_ctx->window = lpcfg_parm_int(lp_ctx, NULL, "mapistore", "prefetch_window",
+					      MAPISTORE_PREFETCH_WINDOW);
+	prefetch_ctx->cache_size = lpcfg_parm_int(lp_ctx, NULL, "mapistore", "prefetch_cache_size",
+						  MAPISTORE_PREFETCH_CACHE_SIZE);
+	if (prefetch_ctx->window == 0) {
+		prefetch_ctx->window = MAPISTORE_PREFETCH_WINDOW;
+	}
+	if (prefetch_ctx->cache_size < prefetch_ctx->window) {
+		prefetch_ctx->cache_size = prefetch_ctx->window;
+	}
+
+	*_prefetch_ctx = prefetch_ctx;
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Register the event context used to defer preloads
+
+   \param mstore_ctx pointer to the mapistore context
+   \param ev pointer to the tevent context, NULL to run every preload
+   synchronously
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_AVAILABLE
+   if prefetching is disabled, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_prefetch_set_event_context(struct mapistore_context *mstore_ctx,
+								   struct tevent_context *ev)
+{
+	struct mapistore_prefetch_context	*prefetch_ctx;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	prefetch_ctx = mstore_ctx->prefetch_ctx;
+	MAPISTORE_RETVAL_IF(!prefetch_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+
+	if (prefetch_ctx->ev == ev) return MAPISTORE_SUCCESS;
+
+	if (!prefetch_ctx->im) {
+		prefetch_ctx->im = tevent_create_immediate(prefetch_ctx);
+		MAPISTORE_RETVAL_IF(!prefetch_ctx->im, MAPISTORE_ERR_NO_MEMORY, NULL);
+	}
+
+	/* Cancel any preload queued on the previous event context */
+	if (prefetch_ctx->scheduled) {
+		tevent_schedule_immediate(prefetch_ctx->im, NULL, NULL, NULL);
+		prefetch_ctx->scheduled = false;
+	}
+	prefetch_ctx->ev = ev;
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Announce the ordered list of messages a client is about to
+   read in a folder
+
+   The bodies of the first cache_size messages are preloaded from the
+   event loop, or before the function returns if no event context is
+   registered. The remaining ones are preloaded as reads progress.
+
+   \param mstore_ctx pointer to the mapistore context
+   \param context_id the context identifier referencing the backend
+   \param folder pointer to the backend folder object
+   \param table_type the type of table the mids belong to
+   \param mids the message identifiers, in expected read order
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_AVAILABLE
+   if prefetching is disabled, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_prefetch_hint(struct mapistore_context *mstore_ctx,
+						      uint32_t context_id,
+						      void *folder,
+						      enum mapistore_table_type table_type,
+						      const struct UI8Array_r *mids)
+{
+	struct mapistore_prefetch_context	*prefetch_ctx;
+	struct mapistore_prefetch_stream	*stream;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	prefetch_ctx = mstore_ctx->prefetch_ctx;
+	MAPISTORE_RETVAL_IF(!prefetch_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+	MAPISTORE_RETVAL_IF(!folder, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!mids, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(mids->cValues && !mids->lpui8, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+
+	for (stream = prefetch_ctx->streams; stream; stream = stream->next) {
+		if (stream->context_id == context_id && stream->folder == folder &&
+		    stream->table_type == table_type) {
+			break;
+		}
+	}
+
+	if (stream) {
+		DLIST_REMOVE(prefetch_ctx->streams, stream);
+		talloc_free(stream->mids);
+	} else {
+		/* Drop the least recently used stream */
+		if (prefetch_ctx->stream_count >= MAPISTORE_PREFETCH_MAX_STREAMS) {
+			stream = DLIST_TAIL(prefetch_ctx->streams);
+			talloc_free(stream);
+			prefetch_ctx->stats.evictions++;
+		}
+
+		stream = talloc_zero(prefetch_ctx, struct mapistore_prefetch_stream);
+		MAPISTORE_RETVAL_IF(!stream, MAPISTORE_ERR_NO_MEMORY, NULL);
+		stream->prefetch_ctx = prefetch_ctx;
+		stream->context_id = context_id;
+		stream->folder = folder;
+		stream->table_type = table_type;
+		prefetch_ctx->stream_count++;
+		talloc_set_destructor((void *)stream, (int (*)(void *))mapistore_prefetch_stream_destructor);
+	}
+	DLIST_ADD(prefetch_ctx->streams, stream);
+
+	stream->mids = NULL;
+	if (mids->cValues) {
+		stream->mids = talloc_memdup(stream, mids->lpui8, mids->cValues * sizeof (uint64_t));
+		if (!stream->mids) {
+			talloc_free(stream);
+			MAPISTORE_RETVAL_ERR(MAPISTORE_ERR_NO_MEMORY, NULL);
+		}
+	}
+	stream->count = mids->cValues;
+	stream->position = 0;
+	stream->lo = 0;
+	stream->hi = 0;
+	stream->pending = false;
+
+	if (!stream->count) return MAPISTORE_SUCCESS;
+
+	mapistore_prefetch_schedule(stream);
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Report a message read to the prefetch engine
+
+   The read is accounted as a hit if the message body was preloaded,
+   as a miss otherwise. The preloaded range is then moved forward
+   when fewer than window messages are left ahead of the reader.
+
+   \param mstore_ctx pointer to the mapistore context
+   \param context_id the context identifier referencing the backend
+   \param mid the identifier of the message being read
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_FOUND if
+   the message belongs to no hinted stream,
+   MAPISTORE_ERR_NOT_AVAILABLE if prefetching is disabled, otherwise
+   MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_prefetch_access(struct mapistore_context *mstore_ctx,
+							uint32_t context_id,
+							uint64_t mid)
+{
+	struct mapistore_prefetch_context	*prefetch_ctx;
+	struct mapistore_prefetch_stream	*stream;
+	uint32_t				k = 0;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	prefetch_ctx = mstore_ctx->prefetch_ctx;
+	MAPISTORE_RETVAL_IF(!prefetch_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+
+	for (stream = prefetch_ctx->streams; stream; stream = stream->next) {
+		if (stream->context_id == context_id &&
+		    mapistore_prefetch_stream_find(stream, mid, &k) == true) {
+			break;
+		}
+	}
+	MAPISTORE_RETVAL_IF(!stream, MAPISTORE_ERR_NOT_FOUND, NULL);
+
+	if (stream != prefetch_ctx->streams) {
+		DLIST_REMOVE(prefetch_ctx->streams, stream);
+		DLIST_ADD(prefetch_ctx->streams, stream);
+	}
+
+	stream->position = k + 1;
+	if (k >= stream->lo && k < stream->hi) {
+		prefetch_ctx->stats.hits++;
+	} else {
+		/* Batch the body being read with the next ones, the rest
+		   of the cache is filled from the event loop if possible */
+		prefetch_ctx->stats.misses++;
+		mapistore_prefetch_load(stream, k, k + (prefetch_ctx->ev ? prefetch_ctx->window : prefetch_ctx->cache_size));
+	}
+
+	if (stream->hi < stream->count && stream->hi < stream->position + prefetch_ctx->window) {
+		mapistore_prefetch_schedule(stream);
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Forget the streams hinted for a folder, or for a whole
+   context
+
+   \param mstore_ctx pointer to the mapistore context
+   \param context_id the context identifier referencing the backend
+   \param folder pointer to the backend folder object, NULL to release
+   every stream of the context
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_AVAILABLE
+   if prefetching is disabled, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_prefetch_release(struct mapistore_context *mstore_ctx,
+							 uint32_t context_id,
+							 void *folder)
+{
+	struct mapistore_prefetch_context	*prefetch_ctx;
+	struct mapistore_prefetch_stream	*stream, *next;
+
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	prefetch_ctx = mstore_ctx->prefetch_ctx;
+	MAPISTORE_RETVAL_IF(!prefetch_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+
+	for (stream = prefetch_ctx->streams; stream; stream = next) {
+		next = stream->next;
+		if (stream->context_id == context_id && (!folder || stream->folder == folder)) {
+			talloc_free(stream);
+		}
+	}
+
+	return MAPISTORE_SUCCESS;
+}
+
+
+/**
+   \details Retrieve the prefetch engine counters
+
+   \param mstore_ctx pointer to the mapistore context
+   \param stats pointer to the structure to fill
+
+   \return MAPISTORE_SUCCESS on success, MAPISTORE_ERR_NOT_AVAILABLE
+   if prefetching is disabled, otherwise MAPISTORE error
+ */
+_PUBLIC_ enum mapistore_error mapistore_prefetch_get_stats(struct mapistore_context *mstore_ctx,
+							   struct mapistore_prefetch_stats *stats)
+{
+	/* Sanity checks */
+	MAPISTORE_RETVAL_IF(!mstore_ctx, MAPISTORE_ERR_NOT_INITIALIZED, NULL);
+	MAPISTORE_RETVAL_IF(!stats, MAPISTORE_ERR_INVALID_PARAMETER, NULL);
+	MAPISTORE_RETVAL_IF(!mstore_ctx->prefetch_ctx, MAPISTORE_ERR_NOT_AVAILABLE, NULL);
+
+	*stats = mstore_ctx->prefetch_ctx->stats;
+
+	return MAPISTORE_SUCCESS;
+}
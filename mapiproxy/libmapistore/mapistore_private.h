@@ -102,6 +102,46 @@ struct replica_mapping_context_list {
 };
 #define	MAPISTORE_DB_REPLICA_MAPPING	"replica_mapping.tdb"
 
+/**
+   Message body prefetching
+
+   A prefetch stream tracks the ordered list of message identifiers
+   a client is expected to read in a given backend folder (ICS
+   window, QueryRows result). The [lo, hi) range of mids is the
+   set of bodies currently preloaded by the backend, position is
+   the index following the last message read.
+ */
+struct mapistore_prefetch_stream {
+	struct mapistore_prefetch_context	*prefetch_ctx;
+	uint32_t				context_id;
+	void					*folder;
+	enum mapistore_table_type		table_type;
+	uint64_t				*mids;
+	uint32_t				count;
+	uint32_t				position;
+	uint32_t				lo;
+	uint32_t				hi;
+	bool					pending;
+	struct mapistore_prefetch_stream	*prev;
+	struct mapistore_prefetch_stream	*next;
+};
+
+struct mapistore_prefetch_context {
+	struct mapistore_context		*mstore_ctx;
+	struct tevent_context			*ev;
+	struct tevent_immediate			*im;
+	bool					scheduled;
+	uint32_t				window;
+	uint32_t				cache_size;
+	uint32_t				stream_count;
+	struct mapistore_prefetch_stream	*streams;
+	struct mapistore_prefetch_stats		stats;
+};
+
+#define	MAPISTORE_PREFETCH_WINDOW	50
+#define	MAPISTORE_PREFETCH_CACHE_SIZE	150
+#define	MAPISTORE_PREFETCH_MAX_STREAMS	8
+
 /**
    The database name where in use ID mappings are stored
  */
@@ -197,6 +237,9 @@ enum mapistore_error mapistore_indexing_record_del_fmid(struct mapistore_context
 enum mapistore_error mapistore_notification_init(TALLOC_CTX *, struct loadparm_context *, struct mapistore_notification_context **);
 enum mapistore_error mapistore_notification_subscription_get(TALLOC_CTX *, struct mapistore_context *, struct GUID, struct mapistore_notification_subscription *);
 
+/* definitions from mapistore_prefetch.c */
+enum mapistore_error mapistore_prefetch_init(struct mapistore_context *, struct loadparm_context *, struct mapistore_prefetch_context **);
+
 __END_DECLS
 
 #endif	/* ! __MAPISTORE_PRIVATE_H__ */
@@ -35,6 +35,25 @@
 
 void					*openchange_db_ctx = NULL;
 
+/* EcDoRpcExt2 response buffers and chaining (extended buffer packing) */
+#define	EMSMDB_RPC_HEADER_EXT_SIZE	8
+#define	EMSMDB_CHAIN_ROP_OVERHEAD	16
+#define	EMSMDB_CHAIN_MIN_BUFFER		0x100
+#define	EMSMDB_CHAIN_MAX_BUFFER		0x8000
+
+static bool				emsmdb_chaining = true;
+
+/* EcDoRpcExt2 response compression settings and counters */
+static struct {
+	bool		enabled;
+	uint32_t	threshold;
+	uint32_t	min_saving;
+	uint64_t	responses;
+	uint64_t	compressed;
+	uint64_t	bytes_in;
+	uint64_t	bytes_saved;
+} emsmdb_compression;
+
 
 static struct emsmdbp_context *dcesrv_find_emsmdbp_context(struct GUID *uuid)
 {
@@ -116,6 +135,8 @@ static enum MAPISTATUS dcesrv_EcDoConnect(struct dcesrv_call_state *dce_call,
 		OC_PANIC(false, ("[exchange_emsmdb] EcDoConnect failed: unable to initialize emsmdbp context\n"));
 		goto failure;
 	}
+	/* Deferred message body preloads run from the server event loop */
+	mapistore_prefetch_set_event_context(emsmdbp_ctx->mstore_ctx, dce_call->event_ctx);
 
 	/* Step 2. Check if incoming user belongs to the Exchange organization */
 	if (emsmdbp_verify_user(dce_call, emsmdbp_ctx) == false) {
@@ -263,16 +284,170 @@ static enum MAPISTATUS dcesrv_EcDoDisconnect(struct dcesrv_call_state *dce_call,
 	return MAPI_E_SUCCESS;
 }
 
+/**
+   \details Adapt EcDoRpc_RopRelease to the ROP handler signature:
+   Release never produces a reply
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS EcDoRpc_RopRelease_dispatch(TALLOC_CTX *mem_ctx,
+						   struct emsmdbp_context *emsmdbp_ctx,
+						   struct EcDoRpc_MAPI_REQ *mapi_req,
+						   struct EcDoRpc_MAPI_REPL *mapi_repl,
+						   uint32_t *handles, uint16_t *size)
+{
+	return EcDoRpc_RopRelease(mem_ctx, emsmdbp_ctx, mapi_req, handles, size);
+}
+
+/* ROP dispatch table indexed by opnum, see emsmdbp_rop_register() */
+static struct emsmdbp_rop_handler	emsmdbp_rops[0x100] = {
+	[op_MAPI_Release]	= { "Release", EcDoRpc_RopRelease_dispatch },
+	[op_MAPI_OpenFolder]	= { "OpenFolder", EcDoRpc_RopOpenFolder },
+	[op_MAPI_OpenMessage]	= { "OpenMessage", EcDoRpc_RopOpenMessage },
+	[op_MAPI_GetHierarchyTable]	= { "GetHierarchyTable", EcDoRpc_RopGetHierarchyTable },
+	[op_MAPI_GetContentsTable]	= { "GetContentsTable", EcDoRpc_RopGetContentsTable },
+	[op_MAPI_CreateMessage]	= { "CreateMessage", EcDoRpc_RopCreateMessage },
+	[op_MAPI_GetProps]	= { "GetProps", EcDoRpc_RopGetPropertiesSpecific },
+	[op_MAPI_GetPropsAll]	= { "GetPropsAll", EcDoRpc_RopGetPropertiesAll },
+	[op_MAPI_GetPropList]	= { "GetPropList", EcDoRpc_RopGetPropertiesList },
+	[op_MAPI_SetProps]	= { "SetProps", EcDoRpc_RopSetProperties },
+	[op_MAPI_DeleteProps]	= { "DeleteProps", EcDoRpc_RopDeleteProperties },
+	[op_MAPI_SaveChangesMessage]	= { "SaveChangesMessage", EcDoRpc_RopSaveChangesMessage },
+	[op_MAPI_RemoveAllRecipients]	= { "RemoveAllRecipients", EcDoRpc_RopRemoveAllRecipients },
+	[op_MAPI_ModifyRecipients]	= { "ModifyRecipients", EcDoRpc_RopModifyRecipients },
+	[op_MAPI_ReloadCachedInformation]	= { "ReloadCachedInformation", EcDoRpc_RopReloadCachedInformation },
+	[op_MAPI_SetMessageReadFlag]	= { "SetMessageReadFlag", EcDoRpc_RopSetMessageReadFlag },
+	[op_MAPI_SetColumns]	= { "SetColumns", EcDoRpc_RopSetColumns },
+	[op_MAPI_SortTable]	= { "SortTable", EcDoRpc_RopSortTable },
+	[op_MAPI_Restrict]	= { "Restrict", EcDoRpc_RopRestrict },
+	[op_MAPI_QueryRows]	= { "QueryRows", EcDoRpc_RopQueryRows },
+	[op_MAPI_QueryPosition]	= { "QueryPosition", EcDoRpc_RopQueryPosition },
+	[op_MAPI_SeekRow]	= { "SeekRow", EcDoRpc_RopSeekRow },
+	[op_MAPI_CreateFolder]	= { "CreateFolder", EcDoRpc_RopCreateFolder },
+	[op_MAPI_DeleteFolder]	= { "DeleteFolder", EcDoRpc_RopDeleteFolder },
+	[op_MAPI_DeleteMessages]	= { "DeleteMessages", EcDoRpc_RopDeleteMessages },
+	[op_MAPI_GetMessageStatus]	= { "GetMessageStatus", EcDoRpc_RopGetMessageStatus },
+	[op_MAPI_GetAttachmentTable]	= { "GetAttachmentTable", EcDoRpc_RopGetAttachmentTable },
+	[op_MAPI_OpenAttach]	= { "OpenAttach", EcDoRpc_RopOpenAttach },
+	[op_MAPI_CreateAttach]	= { "CreateAttach", EcDoRpc_RopCreateAttach },
+	[op_MAPI_SaveChangesAttachment]	= { "SaveChangesAttachment", EcDoRpc_RopSaveChangesAttachment },
+	[op_MAPI_SetReceiveFolder]	= { "SetReceiveFolder", EcDoRpc_RopSetReceiveFolder },
+	[op_MAPI_GetReceiveFolder]	= { "GetReceiveFolder", EcDoRpc_RopGetReceiveFolder },
+	[op_MAPI_RegisterNotification]	= { "RegisterNotification", EcDoRpc_RopRegisterNotification },
+	[op_MAPI_OpenStream]	= { "OpenStream", EcDoRpc_RopOpenStream },
+	[op_MAPI_ReadStream]	= { "ReadStream", EcDoRpc_RopReadStream },
+	[op_MAPI_WriteStream]	= { "WriteStream", EcDoRpc_RopWriteStream },
+	[op_MAPI_SeekStream]	= { "SeekStream", EcDoRpc_RopSeekStream },
+	[op_MAPI_SetStreamSize]	= { "SetStreamSize", EcDoRpc_RopSetStreamSize },
+	[op_MAPI_SetSearchCriteria]	= { "SetSearchCriteria", EcDoRpc_RopSetSearchCriteria },
+	[op_MAPI_GetSearchCriteria]	= { "GetSearchCriteria", EcDoRpc_RopGetSearchCriteria },
+	[op_MAPI_SubmitMessage]	= { "SubmitMessage", EcDoRpc_RopSubmitMessage },
+	[op_MAPI_MoveCopyMessages]	= { "MoveCopyMessages", EcDoRpc_RopMoveCopyMessages },
+	[op_MAPI_MoveFolder]	= { "MoveFolder", EcDoRpc_RopMoveFolder },
+	[op_MAPI_CopyFolder]	= { "CopyFolder", EcDoRpc_RopCopyFolder },
+	[op_MAPI_CopyTo]	= { "CopyTo", EcDoRpc_RopCopyTo },
+	[op_MAPI_GetPermissionsTable]	= { "GetPermissionsTable", EcDoRpc_RopGetPermissionsTable },
+	[op_MAPI_GetRulesTable]	= { "GetRulesTable", EcDoRpc_RopGetRulesTable },
+	[op_MAPI_ModifyPermissions]	= { "ModifyPermissions", EcDoRpc_RopModifyPermissions },
+	[op_MAPI_ModifyRules]	= { "ModifyRules", EcDoRpc_RopModifyRules },
+	[op_MAPI_LongTermIdFromId]	= { "LongTermIdFromId", EcDoRpc_RopLongTermIdFromId },
+	[op_MAPI_IdFromLongTermId]	= { "IdFromLongTermId", EcDoRpc_RopIdFromLongTermId },
+	[op_MAPI_OpenEmbeddedMessage]	= { "OpenEmbeddedMessage", EcDoRpc_RopOpenEmbeddedMessage },
+	[op_MAPI_SetSpooler]	= { "SetSpooler", EcDoRpc_RopSetSpooler },
+	[op_MAPI_AddressTypes]	= { "AddressTypes", EcDoRpc_RopGetAddressTypes },
+	[op_MAPI_TransportSend]	= { "TransportSend", EcDoRpc_RopTransportSend },
+	[op_MAPI_FastTransferSourceCopyTo]	= { "FastTransferSourceCopyTo", EcDoRpc_RopFastTransferSourceCopyTo },
+	[op_MAPI_FastTransferSourceGetBuffer]	= { "FastTransferSourceGetBuffer", EcDoRpc_RopFastTransferSourceGetBuffer },
+	[op_MAPI_FindRow]	= { "FindRow", EcDoRpc_RopFindRow },
+	[op_MAPI_GetNamesFromIDs]	= { "GetNamesFromIDs", EcDoRpc_RopGetNamesFromIDs },
+	[op_MAPI_GetIDsFromNames]	= { "GetIDsFromNames", EcDoRpc_RopGetPropertyIdsFromNames },
+	[op_MAPI_EmptyFolder]	= { "EmptyFolder", EcDoRpc_RopEmptyFolder },
+	[op_MAPI_CommitStream]	= { "CommitStream", EcDoRpc_RopCommitStream },
+	[op_MAPI_GetStreamSize]	= { "GetStreamSize", EcDoRpc_RopGetStreamSize },
+	[op_MAPI_GetPerUserLongTermIds]	= { "GetPerUserLongTermIds", EcDoRpc_RopGetPerUserLongTermIds },
+	[op_MAPI_GetPerUserGuid]	= { "GetPerUserGuid", EcDoRpc_RopGetPerUserGuid },
+	[op_MAPI_ReadPerUserInformation]	= { "ReadPerUserInformation", EcDoRpc_RopReadPerUserInformation },
+	[op_MAPI_GetReceiveFolderTable]	= { "GetReceiveFolderTable", EcDoRpc_RopGetReceiveFolderTable },
+	[op_MAPI_GetTransportFolder]	= { "GetTransportFolder", EcDoRpc_RopGetTransportFolder },
+	[op_MAPI_OptionsData]	= { "OptionsData", EcDoRpc_RopOptionsData },
+	[op_MAPI_SyncConfigure]	= { "SyncConfigure", EcDoRpc_RopSyncConfigure },
+	[op_MAPI_SyncImportMessageChange]	= { "SyncImportMessageChange", EcDoRpc_RopSyncImportMessageChange },
+	[op_MAPI_SyncImportHierarchyChange]	= { "SyncImportHierarchyChange", EcDoRpc_RopSyncImportHierarchyChange },
+	[op_MAPI_SyncImportDeletes]	= { "SyncImportDeletes", EcDoRpc_RopSyncImportDeletes },
+	[op_MAPI_SyncUploadStateStreamBegin]	= { "SyncUploadStateStreamBegin", EcDoRpc_RopSyncUploadStateStreamBegin },
+	[op_MAPI_SyncUploadStateStreamContinue]	= { "SyncUploadStateStreamContinue", EcDoRpc_RopSyncUploadStateStreamContinue },
+	[op_MAPI_SyncUploadStateStreamEnd]	= { "SyncUploadStateStreamEnd", EcDoRpc_RopSyncUploadStateStreamEnd },
+	[op_MAPI_SyncImportMessageMove]	= { "SyncImportMessageMove", EcDoRpc_RopSyncImportMessageMove },
+	[op_MAPI_DeletePropertiesNoReplicate]	= { "DeletePropertiesNoReplicate", EcDoRpc_RopDeletePropertiesNoReplicate },
+	[op_MAPI_GetStoreState]	= { "GetStoreState", EcDoRpc_RopGetStoreState },
+	[op_MAPI_SyncOpenCollector]	= { "SyncOpenCollector", EcDoRpc_RopSyncOpenCollector },
+	[op_MAPI_GetLocalReplicaIds]	= { "GetLocalReplicaIds", EcDoRpc_RopGetLocalReplicaIds },
+	[op_MAPI_SyncImportReadStateChanges]	= { "SyncImportReadStateChanges", EcDoRpc_RopSyncImportReadStateChanges },
+	[op_MAPI_ResetTable]	= { "ResetTable", EcDoRpc_RopResetTable },
+	[op_MAPI_SyncGetTransferState]	= { "SyncGetTransferState", EcDoRpc_RopSyncGetTransferState },
+	[op_MAPI_SetLocalReplicaMidsetDeleted]	= { "SetLocalReplicaMidsetDeleted", EcDoRpc_RopSetLocalReplicaMidsetDeleted },
+	[op_MAPI_Logon]	= { "Logon", EcDoRpc_RopLogon },
+};
+
+/**
+   \details Register a handler for a ROP the server does not
+   implement itself
+
+   \param opnum the ROP identifier
+   \param name the ROP name used in debug output
+   \param fn the handler to call when opnum is found in a request
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_COLLISION if opnum
+   already has a handler, otherwise MAPI_E_INVALID_PARAMETER
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_rop_register(uint8_t opnum, const char *name,
+					      emsmdbp_rop_handler_fn fn)
+{
+	/* opnum 0 terminates the request ROP list */
+	OPENCHANGE_RETVAL_IF(!opnum, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!name, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!fn, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(emsmdbp_rops[opnum].fn, MAPI_E_COLLISION, NULL);
+
+	emsmdbp_rops[opnum].name = name;
+	emsmdbp_rops[opnum].fn = fn;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Remove a handler previously added with emsmdbp_rop_register
+
+   \param opnum the ROP identifier
+   \param fn the handler that was registered for opnum
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_FOUND
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_rop_unregister(uint8_t opnum, emsmdbp_rop_handler_fn fn)
+{
+	OPENCHANGE_RETVAL_IF(!fn || emsmdbp_rops[opnum].fn != fn, MAPI_E_NOT_FOUND, NULL);
+
+	emsmdbp_rops[opnum].name = NULL;
+	emsmdbp_rops[opnum].fn = NULL;
+
+	return MAPI_E_SUCCESS;
+}
+
 static struct mapi_response *EcDoRpc_process_transaction(TALLOC_CTX *mem_ctx,
 							 struct emsmdbp_context *emsmdbp_ctx,
-							 struct mapi_request *mapi_request)
+							 struct mapi_request *mapi_request,
+							 bool notifications)
 {
-	enum MAPISTATUS		retval;
-	struct mapi_response	*mapi_response;
-	uint32_t		handles_length;
-	uint16_t		size = 0;
-	uint32_t		i;
-	uint32_t		idx;
+	enum MAPISTATUS			retval;
+	struct mapi_response		*mapi_response;
+	struct EcDoRpc_MAPI_REQ		*mapi_req;
+	const struct emsmdbp_rop_handler	*rop;
+	uint32_t			handles_length;
+	uint16_t			size = 0;
+	uint64_t			start;
+	uint32_t			count;
+	uint32_t			i;
+	uint32_t			idx;
 
 	/* Sanity checks */
 	if (!emsmdbp_ctx) return NULL;
@@ -290,592 +465,43 @@ static struct mapi_response *EcDoRpc_process_transaction(TALLOC_CTX *mem_ctx,
 		goto notif;
 	}
 
-	/* Step 2. Process serialized MAPI requests */
-	mapi_response->mapi_repl = talloc_zero(mem_ctx, struct EcDoRpc_MAPI_REPL);
-	for (i = 0, idx = 0, size = 0; mapi_request->mapi_req[i].opnum != 0; i++) {
-		OC_DEBUG(0, "MAPI Rop: 0x%.2x (%d)\n", mapi_request->mapi_req[i].opnum, size);
+	/* Step 2. Size the reply array once: at most one reply per ROP plus the terminator */
+	for (count = 0; mapi_request->mapi_req[count].opnum != 0; count++);
+	mapi_response->mapi_repl = talloc_zero_array(mem_ctx, struct EcDoRpc_MAPI_REPL, count + 1);
+	if (!mapi_response->mapi_repl) {
+		OC_DEBUG(0, "No memory available");
+		return NULL;
+	}
 
-		if (mapi_request->mapi_req[i].opnum != op_MAPI_Release) {
-			mapi_response->mapi_repl = talloc_realloc(mem_ctx, mapi_response->mapi_repl,
-								  struct EcDoRpc_MAPI_REPL, idx + 2);
+	/* Step 3. Process serialized MAPI requests */
+	for (i = 0, idx = 0, size = 0; i < count; i++) {
+		mapi_req = &(mapi_request->mapi_req[i]);
+		rop = &emsmdbp_rops[mapi_req->opnum];
+		if (!rop->fn) {
+			OC_DEBUG(1, "MAPI Rop: 0x%.2x not implemented!\n", mapi_req->opnum);
+			continue;
 		}
 
-		switch (mapi_request->mapi_req[i].opnum) {
-		case op_MAPI_Release: /* 0x01 */
-			retval = EcDoRpc_RopRelease(mem_ctx, emsmdbp_ctx,
-						    &(mapi_request->mapi_req[i]),
-						    mapi_request->handles, &size);
-			break;
-		case op_MAPI_OpenFolder: /* 0x02 */
-			retval = EcDoRpc_RopOpenFolder(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		case op_MAPI_OpenMessage: /* 0x3 */
-			retval = EcDoRpc_RopOpenMessage(mem_ctx, emsmdbp_ctx,
-							&(mapi_request->mapi_req[i]),
-							&(mapi_response->mapi_repl[idx]),
-							mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetHierarchyTable: /* 0x04 */
-			retval = EcDoRpc_RopGetHierarchyTable(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetContentsTable: /* 0x05 */
-			retval = EcDoRpc_RopGetContentsTable(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_CreateMessage: /* 0x06 */
-			retval = EcDoRpc_RopCreateMessage(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetProps: /* 0x07 */
-			retval = EcDoRpc_RopGetPropertiesSpecific(mem_ctx, emsmdbp_ctx,
-								  &(mapi_request->mapi_req[i]),
-								  &(mapi_response->mapi_repl[idx]),
-								  mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetPropsAll: /* 0x8 */
-			retval = EcDoRpc_RopGetPropertiesAll(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetPropList: /* 0x9 */
-			retval = EcDoRpc_RopGetPropertiesList(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_SetProps: /* 0x0a */
-			retval = EcDoRpc_RopSetProperties(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_DeleteProps: /* 0xb */
-			retval = EcDoRpc_RopDeleteProperties(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_SaveChangesMessage: /* 0x0c */
-			retval = EcDoRpc_RopSaveChangesMessage(mem_ctx, emsmdbp_ctx,
-                                                               &(mapi_request->mapi_req[i]),
-                                                               &(mapi_response->mapi_repl[idx]),
-                                                               mapi_response->handles, &size);
-			break;
-		case op_MAPI_RemoveAllRecipients: /* 0xd */
-			retval = EcDoRpc_RopRemoveAllRecipients(mem_ctx, emsmdbp_ctx,
-								&(mapi_request->mapi_req[i]),
-								&(mapi_response->mapi_repl[idx]),
-								mapi_response->handles, &size);
-			break;
-		case op_MAPI_ModifyRecipients: /* 0xe */
-			retval = EcDoRpc_RopModifyRecipients(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-
-		/* op_MAPI_ReadRecipients: 0xf */
-		case op_MAPI_ReloadCachedInformation: /* 0x10 */
-			retval = EcDoRpc_RopReloadCachedInformation(mem_ctx, emsmdbp_ctx,
-								    &(mapi_request->mapi_req[i]),
-								    &(mapi_response->mapi_repl[idx]),
-								    mapi_response->handles, &size);
-			break;
-		case op_MAPI_SetMessageReadFlag: /* 0x11 */
-			retval = EcDoRpc_RopSetMessageReadFlag(mem_ctx, emsmdbp_ctx,
-							       &(mapi_request->mapi_req[i]),
-							       &(mapi_response->mapi_repl[idx]),
-							       mapi_response->handles, &size);
-			break;
-		case op_MAPI_SetColumns: /* 0x12 */
-			retval = EcDoRpc_RopSetColumns(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		case op_MAPI_SortTable: /* 0x13 */
-			retval = EcDoRpc_RopSortTable(mem_ctx, emsmdbp_ctx,
-						      &(mapi_request->mapi_req[i]),
-						      &(mapi_response->mapi_repl[idx]),
-						      mapi_response->handles, &size);
-			break;
-		case op_MAPI_Restrict: /* 0x14 */
-			retval = EcDoRpc_RopRestrict(mem_ctx, emsmdbp_ctx,
-						     &(mapi_request->mapi_req[i]),
-						     &(mapi_response->mapi_repl[idx]),
-						     mapi_response->handles, &size);
-			break;
-		case op_MAPI_QueryRows: /* 0x15 */
-			retval = EcDoRpc_RopQueryRows(mem_ctx, emsmdbp_ctx,
-						      &(mapi_request->mapi_req[i]),
-						      &(mapi_response->mapi_repl[idx]),
-						      mapi_response->handles, &size);
-			break;
-		/* op_MAPI_GetStatus: 0x16 */
-		case op_MAPI_QueryPosition: /* 0x17 */
-			retval = EcDoRpc_RopQueryPosition(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_SeekRow: /* 0x18 */
-			retval = EcDoRpc_RopSeekRow(mem_ctx, emsmdbp_ctx,
-						    &(mapi_request->mapi_req[i]),
-						    &(mapi_response->mapi_repl[idx]),
-						    mapi_response->handles, &size);
-			break;
-		/* op_MAPI_SeekRowBookmark: 0x19 */
-		/* op_MAPI_SeekRowApprox: 0x1a */
-		/* op_MAPI_CreateBookmark: 0x1b */
-		case op_MAPI_CreateFolder: /* 0x1c */
-			retval = EcDoRpc_RopCreateFolder(mem_ctx, emsmdbp_ctx,
-							 &(mapi_request->mapi_req[i]),
-							 &(mapi_response->mapi_repl[idx]),
-							 mapi_response->handles, &size);
-			break;
-		case op_MAPI_DeleteFolder: /* 0x1d */
-			retval = EcDoRpc_RopDeleteFolder(mem_ctx, emsmdbp_ctx,
-							 &(mapi_request->mapi_req[i]),
-							 &(mapi_response->mapi_repl[idx]),
-							 mapi_response->handles, &size);
-			break;
-		case op_MAPI_DeleteMessages: /* 0x1e */
-			retval = EcDoRpc_RopDeleteMessages(mem_ctx, emsmdbp_ctx,
-							   &(mapi_request->mapi_req[i]),
-							   &(mapi_response->mapi_repl[idx]),
-							   mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetMessageStatus: /* 0x1f */
-			retval = EcDoRpc_RopGetMessageStatus(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		/* op_MAPI_SetMessageStatus: 0x20 */
-		case op_MAPI_GetAttachmentTable: /* 0x21 */
-			retval = EcDoRpc_RopGetAttachmentTable(mem_ctx, emsmdbp_ctx,
-							       &(mapi_request->mapi_req[i]),
-							       &(mapi_response->mapi_repl[idx]),
-							       mapi_response->handles, &size);
-			break;
-                case op_MAPI_OpenAttach: /* 0x22 */
-			retval = EcDoRpc_RopOpenAttach(mem_ctx, emsmdbp_ctx,
-                                                       &(mapi_request->mapi_req[i]),
-                                                       &(mapi_response->mapi_repl[idx]),
-                                                       mapi_response->handles, &size);
-			break;
-                case op_MAPI_CreateAttach: /* 0x23 */
-			retval = EcDoRpc_RopCreateAttach(mem_ctx, emsmdbp_ctx,
-                                                         &(mapi_request->mapi_req[i]),
-                                                         &(mapi_response->mapi_repl[idx]),
-                                                         mapi_response->handles, &size);
-			break;
-		/* op_MAPI_DeleteAttach: 0x24 */
-		case op_MAPI_SaveChangesAttachment: /* 0x25 */
-			retval = EcDoRpc_RopSaveChangesAttachment(mem_ctx, emsmdbp_ctx,
-                                                                  &(mapi_request->mapi_req[i]),
-                                                                  &(mapi_response->mapi_repl[idx]),
-                                                                  mapi_response->handles, &size);
-			break;
-		case op_MAPI_SetReceiveFolder: /* 0x26 */
-			retval = EcDoRpc_RopSetReceiveFolder(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetReceiveFolder: /* 0x27 */
-			retval = EcDoRpc_RopGetReceiveFolder(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_RegisterNotification: /* 0x29 */
-			retval = EcDoRpc_RopRegisterNotification(mem_ctx, emsmdbp_ctx,
-								 &(mapi_request->mapi_req[i]),
-								 &(mapi_response->mapi_repl[idx]),
-								 mapi_response->handles, &size);
-			break;
-		/* op_MAPI_Notify: 0x2a */
-		case op_MAPI_OpenStream: /* 0x2b */
-			retval = EcDoRpc_RopOpenStream(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		case op_MAPI_ReadStream: /* 0x2c */
-			retval = EcDoRpc_RopReadStream(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		case op_MAPI_WriteStream: /* 0x2d */
-			retval = EcDoRpc_RopWriteStream(mem_ctx, emsmdbp_ctx,
-							&(mapi_request->mapi_req[i]),
-							&(mapi_response->mapi_repl[idx]),
-							mapi_response->handles, &size);
-			break;
-                case op_MAPI_SeekStream: /* 0x2e */
-			retval = EcDoRpc_RopSeekStream(mem_ctx, emsmdbp_ctx,
-                                                       &(mapi_request->mapi_req[i]),
-                                                       &(mapi_response->mapi_repl[idx]),
-                                                       mapi_response->handles, &size);
-			break;
-                case op_MAPI_SetStreamSize: /* 0x2f */
-			retval = EcDoRpc_RopSetStreamSize(mem_ctx, emsmdbp_ctx,
-                                                          &(mapi_request->mapi_req[i]),
-                                                          &(mapi_response->mapi_repl[idx]),
-                                                          mapi_response->handles, &size);
-			break;
-		case op_MAPI_SetSearchCriteria: /* 0x30 */
-			retval = EcDoRpc_RopSetSearchCriteria(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetSearchCriteria: /* 0x31 */
-			retval = EcDoRpc_RopGetSearchCriteria(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_SubmitMessage: /* 0x32 */
-			retval = EcDoRpc_RopSubmitMessage(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_MoveCopyMessages: /* 0x33 */
-			retval = EcDoRpc_RopMoveCopyMessages(mem_ctx, emsmdbp_ctx,
-							    &(mapi_request->mapi_req[i]),
-							    &(mapi_response->mapi_repl[idx]),
-							    mapi_response->handles, &size);
-		        break;
-		/* op_MAPI_AbortSubmit: 0x34 */
-		case op_MAPI_MoveFolder: /* 0x35 */
-			retval = EcDoRpc_RopMoveFolder(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-		        break;
-		case op_MAPI_CopyFolder: /* 0x36 */
-			retval = EcDoRpc_RopCopyFolder(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-		        break;
-		/* op_MAPI_QueryColumnsAll: 0x37 */
-		/* op_MAPI_Abort: 0x38 */
-		case op_MAPI_CopyTo: /* 0x39 */
-                        retval = EcDoRpc_RopCopyTo(mem_ctx, emsmdbp_ctx,
-                                                   &(mapi_request->mapi_req[i]),
-                                                   &(mapi_response->mapi_repl[idx]),
-                                                   mapi_response->handles, &size);
-			break;
-		/* op_MAPI_CopyToStream: 0x3a */
-		/* op_MAPI_CloneStream: 0x3b */
-		case op_MAPI_GetPermissionsTable: /* 0x3e */
-			retval = EcDoRpc_RopGetPermissionsTable(mem_ctx, emsmdbp_ctx,
-								&(mapi_request->mapi_req[i]),
-								&(mapi_response->mapi_repl[idx]),
-								mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetRulesTable: /* 0x3f */
-			retval = EcDoRpc_RopGetRulesTable(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_ModifyPermissions: /* 0x40 */
-			retval = EcDoRpc_RopModifyPermissions(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_ModifyRules: /* 0x41 */
-			retval = EcDoRpc_RopModifyRules(mem_ctx, emsmdbp_ctx,
-							&(mapi_request->mapi_req[i]),
-							&(mapi_response->mapi_repl[idx]),
-							mapi_response->handles, &size);
-			break;
-		/* op_MAPI_GetOwningServers: 0x42 */
-		case op_MAPI_LongTermIdFromId: /* 0x43 */
-			retval = EcDoRpc_RopLongTermIdFromId(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		case op_MAPI_IdFromLongTermId: /* 0x44 */
-			retval = EcDoRpc_RopIdFromLongTermId(mem_ctx, emsmdbp_ctx,
-							     &(mapi_request->mapi_req[i]),
-							     &(mapi_response->mapi_repl[idx]),
-							     mapi_response->handles, &size);
-			break;
-		/* op_MAPI_PublicFolderIsGhosted: 0x45 */
-		case op_MAPI_OpenEmbeddedMessage: /* 0x46 */
-			retval = EcDoRpc_RopOpenEmbeddedMessage(mem_ctx, emsmdbp_ctx,
-                                                                &(mapi_request->mapi_req[i]),
-                                                                &(mapi_response->mapi_repl[idx]),
-                                                                mapi_response->handles, &size);
-                        break;
-		case op_MAPI_SetSpooler: /* 0x47 */
-			retval = EcDoRpc_RopSetSpooler(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		/* op_MAPI_SpoolerLockMessage: 0x48 */
-		case op_MAPI_AddressTypes: /*x49 */
-			retval = EcDoRpc_RopGetAddressTypes(mem_ctx, emsmdbp_ctx,
-							    &(mapi_request->mapi_req[i]),
-							    &(mapi_response->mapi_repl[idx]),
-							    mapi_response->handles, &size);
-			break;
-		case op_MAPI_TransportSend: /* 0x4a */
-			retval = EcDoRpc_RopTransportSend(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		/* op_MAPI_FastTransferSourceCopyMessages: 0x4b */
-		/* op_MAPI_FastTransferSourceCopyFolder: 0x4c */
-		case op_MAPI_FastTransferSourceCopyTo: /* 0x4d */
-			retval = EcDoRpc_RopFastTransferSourceCopyTo(mem_ctx, emsmdbp_ctx,
-								     &(mapi_request->mapi_req[i]),
-								     &(mapi_response->mapi_repl[idx]),
-								     mapi_response->handles, &size);
-			break;
-		case op_MAPI_FastTransferSourceGetBuffer: /* 0x4e */
-			retval = EcDoRpc_RopFastTransferSourceGetBuffer(mem_ctx, emsmdbp_ctx,
-									&(mapi_request->mapi_req[i]),
-									&(mapi_response->mapi_repl[idx]),
-									mapi_response->handles, &size);
-			break;
-		case op_MAPI_FindRow: /* 0x4f */
-			retval = EcDoRpc_RopFindRow(mem_ctx, emsmdbp_ctx,
-						    &(mapi_request->mapi_req[i]),
-						    &(mapi_response->mapi_repl[idx]),
-						    mapi_response->handles, &size);
-			break;
-		/* op_MAPI_Progress: 0x50 */
-		/* op_MAPI_TransportNewMail: 0x51 */
-		/* op_MAPI_GetValidAttachments: 0x52 */
-		case op_MAPI_GetNamesFromIDs: /* 0x55 */
-			retval = EcDoRpc_RopGetNamesFromIDs(mem_ctx, emsmdbp_ctx,
-							    &(mapi_request->mapi_req[i]),
-							    &(mapi_response->mapi_repl[idx]),
-							    mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetIDsFromNames: /* 0x56 */
-			retval = EcDoRpc_RopGetPropertyIdsFromNames(mem_ctx, emsmdbp_ctx,
-								    &(mapi_request->mapi_req[i]),
-								    &(mapi_response->mapi_repl[idx]),
-								    mapi_response->handles, &size);
-			break;
-		/* op_MAPI_UpdateDeferredActionMessages: 0x57 */
-		case op_MAPI_EmptyFolder: /* 0x58 */
-		retval = EcDoRpc_RopEmptyFolder(mem_ctx, emsmdbp_ctx,
-						&(mapi_request->mapi_req[i]),
-						&(mapi_response->mapi_repl[idx]),
-						mapi_response->handles, &size);
-			break;
-		/* op_MAPI_ExpandRow: 0x59 */
-		/* op_MAPI_CollapseRow: 0x5a */
-		/* op_MAPI_LockRegionStream: 0x5b */
-		/* op_MAPI_UnlockRegionStream: 0x5c */
-		case op_MAPI_CommitStream: /* 0x5d */
-			retval = EcDoRpc_RopCommitStream(mem_ctx, emsmdbp_ctx,
-							 &(mapi_request->mapi_req[i]),
-							 &(mapi_response->mapi_repl[idx]),
-							 mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetStreamSize: /* 0x5e */
-			retval = EcDoRpc_RopGetStreamSize(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		/* op_MAPI_QueryNamedProperties: 0x5f */
-		case op_MAPI_GetPerUserLongTermIds: /* 0x60 */
-			retval = EcDoRpc_RopGetPerUserLongTermIds(mem_ctx, emsmdbp_ctx,
-								  &(mapi_request->mapi_req[i]),
-								  &(mapi_response->mapi_repl[idx]),
-								  mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetPerUserGuid: /* 0x61 */
-			retval = EcDoRpc_RopGetPerUserGuid(mem_ctx, emsmdbp_ctx,
-							   &(mapi_request->mapi_req[i]),
-							   &(mapi_response->mapi_repl[idx]),
-							   mapi_response->handles, &size);
-			break;
-		case op_MAPI_ReadPerUserInformation: /* 0x63 */
-			retval = EcDoRpc_RopReadPerUserInformation(mem_ctx, emsmdbp_ctx,
-								   &(mapi_request->mapi_req[i]),
-								   &(mapi_response->mapi_repl[idx]),
-								   mapi_response->handles, &size);
-			break;
-		/* op_MAPI_ReadPerUserInformation: 0x63 */
-		/* op_MAPI_SetReadFlags: 0x66 */
-		/* op_MAPI_CopyProperties: 0x67 */
-		case op_MAPI_GetReceiveFolderTable: /* 0x68 */
-			retval = EcDoRpc_RopGetReceiveFolderTable(mem_ctx, emsmdbp_ctx,
-								  &(mapi_request->mapi_req[i]),
-								  &(mapi_response->mapi_repl[idx]),
-								  mapi_response->handles, &size);
-			break;
+		OC_DEBUG(5, "MAPI Rop: %s (0x%.2x) [size=%d]\n", rop->name, mapi_req->opnum, size);
 
-		/* op_MAPI_GetCollapseState: 0x6b */
-		/* op_MAPI_SetCollapseState: 0x6c */
-		case op_MAPI_GetTransportFolder: /* 0x6d */
-			retval = EcDoRpc_RopGetTransportFolder(mem_ctx, emsmdbp_ctx,
-							       &(mapi_request->mapi_req[i]),
-							       &(mapi_response->mapi_repl[idx]),
-							       mapi_response->handles, &size);
-			break;
-		/* op_MAPI_Pending: 0x6e */
-		case op_MAPI_OptionsData: /* 0x6f */
-			retval = EcDoRpc_RopOptionsData(mem_ctx, emsmdbp_ctx,
-							&(mapi_request->mapi_req[i]),
-							&(mapi_response->mapi_repl[idx]),
-							mapi_response->handles, &size);
-			break;
-                case op_MAPI_SyncConfigure: /* 0x70 */
-			retval = EcDoRpc_RopSyncConfigure(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncImportMessageChange: /* 0x72 */
-			retval = EcDoRpc_RopSyncImportMessageChange(mem_ctx, emsmdbp_ctx,
-								    &(mapi_request->mapi_req[i]),
-								    &(mapi_response->mapi_repl[idx]),
-								    mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncImportHierarchyChange: /* 0x73 */
-			retval = EcDoRpc_RopSyncImportHierarchyChange(mem_ctx, emsmdbp_ctx,
-								      &(mapi_request->mapi_req[i]),
-								      &(mapi_response->mapi_repl[idx]),
-								      mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncImportDeletes: /* 0x74 */
-			retval = EcDoRpc_RopSyncImportDeletes(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-                case op_MAPI_SyncUploadStateStreamBegin: /* 0x75 */
-			retval = EcDoRpc_RopSyncUploadStateStreamBegin(mem_ctx, emsmdbp_ctx,
-								       &(mapi_request->mapi_req[i]),
-								       &(mapi_response->mapi_repl[idx]),
-								       mapi_response->handles, &size);
-			break;
-                case op_MAPI_SyncUploadStateStreamContinue: /* 0x76 */
-			retval = EcDoRpc_RopSyncUploadStateStreamContinue(mem_ctx, emsmdbp_ctx,
-									  &(mapi_request->mapi_req[i]),
-									  &(mapi_response->mapi_repl[idx]),
-									  mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncUploadStateStreamEnd: /* 0x77 */
-			retval = EcDoRpc_RopSyncUploadStateStreamEnd(mem_ctx, emsmdbp_ctx,
-								     &(mapi_request->mapi_req[i]),
-								     &(mapi_response->mapi_repl[idx]),
-								     mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncImportMessageMove: /* 0x78 */
-			retval = EcDoRpc_RopSyncImportMessageMove(mem_ctx, emsmdbp_ctx,
-								  &(mapi_request->mapi_req[i]),
-								  &(mapi_response->mapi_repl[idx]),
-								  mapi_response->handles, &size);
-			break;
-		/* op_MAPI_SetPropertiesNoReplicate: 0x79 */
-		case op_MAPI_DeletePropertiesNoReplicate: /* 0x7a */
-			retval = EcDoRpc_RopDeletePropertiesNoReplicate(mem_ctx, emsmdbp_ctx,
-									&(mapi_request->mapi_req[i]),
-									&(mapi_response->mapi_repl[idx]),
-									mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetStoreState: /* 0x7b */
-			retval = EcDoRpc_RopGetStoreState(mem_ctx, emsmdbp_ctx,
-							  &(mapi_request->mapi_req[i]),
-							  &(mapi_response->mapi_repl[idx]),
-							  mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncOpenCollector: /* 0x7e */
-			retval = EcDoRpc_RopSyncOpenCollector(mem_ctx, emsmdbp_ctx,
-							      &(mapi_request->mapi_req[i]),
-							      &(mapi_response->mapi_repl[idx]),
-							      mapi_response->handles, &size);
-			break;
-		case op_MAPI_GetLocalReplicaIds: /* 0x7f */
-			retval = EcDoRpc_RopGetLocalReplicaIds(mem_ctx, emsmdbp_ctx,
-                                                               &(mapi_request->mapi_req[i]),
-                                                               &(mapi_response->mapi_repl[idx]),
-                                                               mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncImportReadStateChanges: /* 0x80 */
-			retval = EcDoRpc_RopSyncImportReadStateChanges(mem_ctx, emsmdbp_ctx,
-								       &(mapi_request->mapi_req[i]),
-								       &(mapi_response->mapi_repl[idx]),
-								       mapi_response->handles, &size);
-			break;
-		case op_MAPI_ResetTable: /* 0x81 */
-			retval = EcDoRpc_RopResetTable(mem_ctx, emsmdbp_ctx,
-						       &(mapi_request->mapi_req[i]),
-						       &(mapi_response->mapi_repl[idx]),
-						       mapi_response->handles, &size);
-			break;
-		case op_MAPI_SyncGetTransferState: /* 0x82 */
-			retval = EcDoRpc_RopSyncGetTransferState(mem_ctx, emsmdbp_ctx,
-								 &(mapi_request->mapi_req[i]),
-								 &(mapi_response->mapi_repl[idx]),
-								 mapi_response->handles, &size);
-			break;
-		/* op_MAPI_OpenPublicFolderByName: 0x87 */
-		/* op_MAPI_SetSyncNotificationGuid: 0x88 */
-		/* op_MAPI_FreeBookmark: 0x89 */
-		/* op_MAPI_WriteAndCommitStream: 0x90 */
-		/* op_MAPI_HardDeleteMessages: 0x91 */
-		/* op_MAPI_HardDeleteMessagesAndSubfolders: 0x92 */
-		case op_MAPI_SetLocalReplicaMidsetDeleted: /* 0x93 */
-			retval = EcDoRpc_RopSetLocalReplicaMidsetDeleted(mem_ctx, emsmdbp_ctx,
-									 &(mapi_request->mapi_req[i]),
-									 &(mapi_response->mapi_repl[idx]),
-									 mapi_response->handles, &size);
-			break;
-		case op_MAPI_Logon: /* 0xfe */
-			retval = EcDoRpc_RopLogon(mem_ctx, emsmdbp_ctx,
-						  &(mapi_request->mapi_req[i]),
-						  &(mapi_response->mapi_repl[idx]),
-						  mapi_response->handles, &size);
-			break;
-		default:
-			OC_DEBUG(1, "MAPI Rop: 0x%.2x not implemented!\n",
-				  mapi_request->mapi_req[i].opnum);
-		}
+		start = emsmdbp_stats_now();
+		retval = rop->fn(mem_ctx, emsmdbp_ctx, mapi_req, &(mapi_response->mapi_repl[idx]),
+				 mapi_response->handles, &size);
+		emsmdbp_stats_rop(mapi_req->opnum, rop->name, retval, emsmdbp_stats_now() - start);
 
-		if (mapi_request->mapi_req[i].opnum != op_MAPI_Release) {
+		if (mapi_req->opnum != op_MAPI_Release) {
 			idx++;
 		}
 
 		if (retval) {
-			OC_DEBUG(5, "MAPI Rop: 0x%.2x [retval=0x%.8x]\n", mapi_request->mapi_req[i].opnum, retval);
+			OC_DEBUG(5, "MAPI Rop: %s (0x%.2x) [retval=0x%.8x]\n", rop->name, mapi_req->opnum, retval);
 		}
 	}
 
 notif:
-	/* Step 3. Notifications/Pending calls should be processed here */
+	/* Step 4. Notifications/Pending calls should be processed here */
 	/* Note: GetProps and GetRows are filled with flag NDR_REMAINING, which may hide the content of the following replies. */
-	{
+	if (notifications) {
 		DATA_BLOB		payload;
 		enum mapistore_error	ret;
 		struct ndr_pull		*ndr;
@@ -922,7 +548,7 @@ end:
 		mapi_response->mapi_repl[idx].opnum = 0;
 	}
 
-	/* Step 4. Fill mapi_response structure */
+	/* Step 5. Fill mapi_response structure */
 	handles_length = mapi_request->mapi_len - mapi_request->length;
 	mapi_response->length = size + sizeof (mapi_response->length);
 	mapi_response->mapi_len = mapi_response->length + handles_length;
@@ -946,6 +572,7 @@ static enum MAPISTATUS dcesrv_EcDoRpc(struct dcesrv_call_state *dce_call,
 	struct emsmdbp_context		*emsmdbp_ctx = NULL;
 	struct mapi_request		*mapi_request;
 	struct mapi_response		*mapi_response;
+	uint64_t			start;
 
 	OC_DEBUG(3, "exchange_emsmdb: EcDoRpc (0x2)\n");
 
@@ -968,8 +595,10 @@ static enum MAPISTATUS dcesrv_EcDoRpc(struct dcesrv_call_state *dce_call,
 	}
 
 	/* Step 1. Process EcDoRpc requests */
+	start = emsmdbp_stats_now();
 	mapi_request = r->in.mapi_request;
-	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi_request);
+	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi_request, true);
+	emsmdbp_stats_transaction(emsmdbp_ctx, MAPI_E_SUCCESS, emsmdbp_stats_now() - start);
 
 	/* Step 2. Fill EcDoRpc reply */
 	r->out.handle = r->in.handle;
@@ -1227,6 +856,7 @@ static enum MAPISTATUS dcesrv_EcDoConnectEx(struct dcesrv_call_state *dce_call,
 		r->out.result = MAPI_E_LOGON_FAILED;
 		goto failure;
 	}
+	mapistore_prefetch_set_event_context(emsmdbp_ctx->mstore_ctx, dce_call->event_ctx);
 
 	/* Step 2. Check if incoming user belongs to the Exchange organization */
 	if (emsmdbp_verify_user(dce_call, emsmdbp_ctx) == false) {
@@ -1337,6 +967,432 @@ static enum MAPISTATUS dcesrv_EcDoConnectEx(struct dcesrv_call_state *dce_call,
 	return MAPI_E_SUCCESS;
 }
 
+/**
+   \details Compress a MAPI response payload with LZXPRESS
+
+   The payload is left untouched when compression is disabled, when
+   it is smaller than the configured threshold or when the compressed
+   blob does not save at least min_saving percent of the original
+   size.
+
+   \param mem_ctx pointer to the memory context
+   \param data pointer to the uncompressed MAPI response payload
+   \param size the size of the payload
+
+   \return pointer to the compressed blob on success, otherwise NULL
+ */
+static struct ndr_push *dcesrv_EcDoRpcExt2_compress(TALLOC_CTX *mem_ctx,
+						    uint8_t *data,
+						    uint32_t size)
+{
+	enum ndr_err_code	ndr_err;
+	struct ndr_push		*uncomp;
+	struct ndr_push		*comp;
+	uint32_t		max_size;
+
+	if (!emsmdb_compression.enabled) return NULL;
+	if (size < emsmdb_compression.threshold) return NULL;
+
+	/* Wrap the payload without copying it */
+	uncomp = talloc_zero(mem_ctx, struct ndr_push);
+	if (!uncomp) return NULL;
+	uncomp->flags = LIBNDR_FLAG_NOALIGN;
+	uncomp->data = data;
+	uncomp->offset = size;
+
+	comp = ndr_push_init_ctx(mem_ctx);
+	if (!comp) {
+		talloc_free(uncomp);
+		return NULL;
+	}
+	ndr_set_flags(&comp->flags, LIBNDR_FLAG_NOALIGN);
+
+	ndr_err = ndr_push_lzxpress_compress(comp, uncomp);
+	talloc_free(uncomp);
+	max_size = size - (uint32_t)(((uint64_t)size * emsmdb_compression.min_saving) / 100);
+	if (ndr_err != NDR_ERR_SUCCESS || comp->offset >= max_size) {
+		talloc_free(comp);
+		return NULL;
+	}
+
+	return comp;
+}
+
+/**
+   \details Account a response buffer sent to the client in the
+   compression counters
+
+   \param header pointer to the RPC_HEADER_EXT of the buffer
+ */
+static void dcesrv_EcDoRpcExt2_account(struct RPC_HEADER_EXT *header)
+{
+	emsmdb_compression.responses++;
+	emsmdb_compression.bytes_in += header->SizeActual;
+
+	if (!(header->Flags & RHEF_Compressed)) return;
+
+	emsmdb_compression.compressed++;
+	emsmdb_compression.bytes_saved += header->SizeActual - header->Size;
+	OC_DEBUG(5, "exchange_emsmdb: compressed response %u -> %u bytes "
+		 "(%"PRIu64"/%"PRIu64" responses compressed, %"PRIu64"/%"PRIu64" bytes saved)\n",
+		 header->SizeActual, header->Size,
+		 emsmdb_compression.compressed, emsmdb_compression.responses,
+		 emsmdb_compression.bytes_saved, emsmdb_compression.bytes_in);
+}
+
+/**
+   \details Write a RPC_HEADER_EXT header at a given offset of the
+   EcDoRpcExt2 output blob
+
+   \param ndr_rgbOut pointer to the output blob
+   \param offset the offset of the header in the output blob
+   \param header pointer to the RPC_HEADER_EXT header to write
+ */
+static void dcesrv_EcDoRpcExt2_set_header(struct ndr_push *ndr_rgbOut,
+					  uint32_t offset,
+					  struct RPC_HEADER_EXT *header)
+{
+	uint32_t	end;
+
+	end = ndr_rgbOut->offset;
+	ndr_rgbOut->offset = offset;
+	ndr_push_RPC_HEADER_EXT(ndr_rgbOut, NDR_SCALARS|NDR_BUFFERS, header);
+	ndr_rgbOut->offset = end;
+}
+
+/**
+   \details Serialize a MAPI response buffer and its RPC_HEADER_EXT
+   header at the end of the EcDoRpcExt2 output blob
+
+   Room for the header is reserved first and the response is
+   serialized, compressed and obfuscated in place right after it.
+
+   \param mem_ctx pointer to the memory context
+   \param ndr_rgbOut pointer to the output blob
+   \param mapi_response pointer to the MAPI response to push
+   \param flags the RPC_HEADER_EXT flags (RHEF_XorMagic, RHEF_Last)
+   \param compress whether the buffer may be compressed
+   \param header pointer to the RPC_HEADER_EXT header to fill
+
+   \return the offset of the header in the output blob
+ */
+static uint32_t dcesrv_EcDoRpcExt2_push_buffer(TALLOC_CTX *mem_ctx,
+					       struct ndr_push *ndr_rgbOut,
+					       struct mapi_response *mapi_response,
+					       uint16_t flags,
+					       bool compress,
+					       struct RPC_HEADER_EXT *header)
+{
+	struct ndr_push	*comp = NULL;
+	uint32_t	header_offset;
+	uint32_t	payload_offset;
+
+	header_offset = ndr_rgbOut->offset;
+	ndr_push_zero(ndr_rgbOut, EMSMDB_RPC_HEADER_EXT_SIZE);
+	payload_offset = ndr_rgbOut->offset;
+	ndr_push_mapi_response(ndr_rgbOut, NDR_SCALARS|NDR_BUFFERS, mapi_response);
+
+	header->Version = 0x0000;
+	header->Flags = flags;
+	header->SizeActual = ndr_rgbOut->offset - payload_offset;
+
+	/* Compress the response unless the client opted out */
+	if (compress) {
+		comp = dcesrv_EcDoRpcExt2_compress(mem_ctx, ndr_rgbOut->data + payload_offset, header->SizeActual);
+	}
+	if (comp) {
+		memcpy(ndr_rgbOut->data + payload_offset, comp->data, comp->offset);
+		ndr_rgbOut->offset = payload_offset + comp->offset;
+		header->Flags |= RHEF_Compressed;
+		talloc_free(comp);
+	}
+	header->Size = ndr_rgbOut->offset - payload_offset;
+
+	/* Obfuscate content if applicable*/
+	if (header->Flags & RHEF_XorMagic) {
+		obfuscate_data(ndr_rgbOut->data + payload_offset, header->Size, 0xA5);
+	}
+
+	dcesrv_EcDoRpcExt2_set_header(ndr_rgbOut, header_offset, header);
+
+	return header_offset;
+}
+
+/**
+   \details Check whether a ROP response can be followed by another
+   chained response buffer
+
+   \param mapi_response pointer to the MAPI response
+   \param opnum the chained ROP opnum
+
+   \return true if another response should be packed, otherwise false
+ */
+static bool dcesrv_EcDoRpcExt2_chain_continue(struct mapi_response *mapi_response, uint8_t opnum)
+{
+	struct EcDoRpc_MAPI_REPL	*mapi_repl = NULL;
+	uint32_t			i;
+
+	if (!mapi_response || !mapi_response->mapi_repl) return false;
+
+	/* Notifications may follow the ROP response */
+	for (i = 0; mapi_response->mapi_repl[i].opnum != 0; i++) {
+		if (mapi_response->mapi_repl[i].opnum == opnum) {
+			mapi_repl = &mapi_response->mapi_repl[i];
+		}
+	}
+	if (!mapi_repl || mapi_repl->error_code != MAPI_E_SUCCESS) return false;
+
+	switch (opnum) {
+	case op_MAPI_FastTransferSourceGetBuffer:
+		return (mapi_repl->u.mapi_FastTransferSourceGetBuffer.TransferStatus == TransferStatus_Partial);
+	case op_MAPI_QueryRows:
+		return (mapi_repl->u.mapi_QueryRows.RowCount &&
+			mapi_repl->u.mapi_QueryRows.Origin == BOOKMARK_CURRENT);
+	default:
+		return false;
+	}
+}
+
+/* Cursor of a chained ROP object, restored when a response does not fit */
+struct dcesrv_EcDoRpcExt2_cursor {
+	struct emsmdbp_object	*object;
+	uint32_t		numerator;
+	size_t			position;
+	uint32_t		next_cutmark_idx;
+	uint16_t		steps;
+	uint16_t		total_steps;
+};
+
+/**
+   \details Save the cursor of the object a chained ROP operates on, so
+   it can be restored if the response does not fit
+
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param mapi_request pointer to the chained MAPI request
+   \param cursor pointer to the cursor to fill
+
+   \return true if the cursor was saved, false if the object can not be
+   rewound and the ROP must not be chained
+ */
+static bool dcesrv_EcDoRpcExt2_chain_save(struct emsmdbp_context *emsmdbp_ctx,
+					  struct mapi_request *mapi_request,
+					  struct dcesrv_EcDoRpcExt2_cursor *cursor)
+{
+	struct mapi_handles			*rec = NULL;
+	struct emsmdbp_object			*object;
+	struct emsmdbp_object_synccontext	*synccontext;
+	void					*data = NULL;
+
+	if (mapi_handles_search(emsmdbp_ctx->handles_ctx, mapi_request->handles[mapi_request->mapi_req[0].handle_idx], &rec)) {
+		return false;
+	}
+	mapi_handles_get_private_data(rec, &data);
+	object = (struct emsmdbp_object *) data;
+	if (!object) return false;
+
+	cursor->object = object;
+	switch (object->type) {
+	case EMSMDBP_OBJECT_TABLE:
+		cursor->numerator = object->object.table->numerator;
+		return true;
+	case EMSMDBP_OBJECT_FTCONTEXT:
+		cursor->position = object->object.ftcontext->stream.position;
+		cursor->next_cutmark_idx = object->object.ftcontext->next_cutmark_idx;
+		cursor->steps = object->object.ftcontext->steps;
+		cursor->total_steps = object->object.ftcontext->total_steps;
+		return true;
+	case EMSMDBP_OBJECT_SYNCCONTEXT:
+		synccontext = object->object.synccontext;
+		if (synccontext->request.contents_mode) {
+			/* Content synchronization chunks are released once
+			   read: record the data handed out until the response
+			   is accepted, and rewind the record instead */
+			if (synccontext->replay.position == synccontext->replay.buffer.length) {
+				emsmdbp_stream_reset(&synccontext->replay);
+			}
+			synccontext->replay_retain = true;
+			cursor->position = synccontext->replay.position;
+			return true;
+		}
+		cursor->position = synccontext->stream.position;
+		cursor->next_cutmark_idx = synccontext->next_cutmark_idx;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+   \details Restore the cursor saved by dcesrv_EcDoRpcExt2_chain_save so
+   the data of a dropped response is sent with the next call
+
+   \param cursor pointer to the saved cursor
+ */
+static void dcesrv_EcDoRpcExt2_chain_restore(struct dcesrv_EcDoRpcExt2_cursor *cursor)
+{
+	struct emsmdbp_object	*object = cursor->object;
+
+	switch (object->type) {
+	case EMSMDBP_OBJECT_TABLE:
+		object->object.table->numerator = cursor->numerator;
+		break;
+	case EMSMDBP_OBJECT_FTCONTEXT:
+		object->object.ftcontext->stream.position = cursor->position;
+		object->object.ftcontext->next_cutmark_idx = cursor->next_cutmark_idx;
+		object->object.ftcontext->steps = cursor->steps;
+		object->object.ftcontext->total_steps = cursor->total_steps;
+		break;
+	case EMSMDBP_OBJECT_SYNCCONTEXT:
+		if (object->object.synccontext->request.contents_mode) {
+			object->object.synccontext->replay.position = cursor->position;
+			object->object.synccontext->replay_retain = false;
+			break;
+		}
+		object->object.synccontext->stream.position = cursor->position;
+		object->object.synccontext->next_cutmark_idx = cursor->next_cutmark_idx;
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+   \details Release the cursor saved by dcesrv_EcDoRpcExt2_chain_save
+   once the response has been accepted
+
+   \param cursor pointer to the saved cursor
+ */
+static void dcesrv_EcDoRpcExt2_chain_release(struct dcesrv_EcDoRpcExt2_cursor *cursor)
+{
+	struct emsmdbp_object	*object = cursor->object;
+
+	if (object->type == EMSMDBP_OBJECT_SYNCCONTEXT) {
+		/* The recorded data is released with the next read */
+		object->object.synccontext->replay_retain = false;
+	}
+}
+
+/**
+   \details Pack chained response buffers (extended buffer packing) for
+   RopFastTransferSourceGetBuffer and RopQueryRows
+
+   The last ROP of the request is run again as long as it has more
+   data to return and its response fits in the space left in rgbOut.
+   A response that does not fit is dropped and the cursor of its
+   object rewound; content synchronization data is replayed from the
+   record kept while the response was pending.
+   header and header_offset are updated to describe the last buffer
+   pushed, so the caller can flag it with RHEF_Last.
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param mapi_request pointer to the MAPI request
+   \param mapi_response pointer to the first MAPI response
+   \param ndr_rgbOut pointer to the output blob
+   \param max_size the maximum size of the output blob
+   \param flags the RPC_HEADER_EXT flags applied to each buffer
+   \param compress whether buffers may be compressed
+   \param header pointer to the RPC_HEADER_EXT of the last buffer
+   \param header_offset pointer to the offset of the last buffer header
+ */
+static void dcesrv_EcDoRpcExt2_chain(TALLOC_CTX *mem_ctx,
+				     struct emsmdbp_context *emsmdbp_ctx,
+				     struct mapi_request *mapi_request,
+				     struct mapi_response *mapi_response,
+				     struct ndr_push *ndr_rgbOut,
+				     uint32_t max_size,
+				     uint16_t flags,
+				     bool compress,
+				     struct RPC_HEADER_EXT *header,
+				     uint32_t *header_offset)
+{
+	struct mapi_request			chain_request;
+	struct mapi_response			*chain_response;
+	struct mapi_response			*last_response = NULL;
+	struct EcDoRpc_MAPI_REQ			*chain_req;
+	struct FastTransferSourceGetBuffer_req	*ft_req;
+	struct dcesrv_EcDoRpcExt2_cursor	cursor;
+	struct RPC_HEADER_EXT			chain_header;
+	uint32_t				chain_offset;
+	uint32_t				buffer_size = 0;
+	uint32_t				avail;
+	uint32_t				overhead;
+	uint32_t				i;
+	uint8_t					opnum;
+
+	if (!mapi_request || !mapi_request->mapi_req || !mapi_request->mapi_req[0].opnum) return;
+
+	/* Only the last ROP of the request is chained */
+	for (i = 0; mapi_request->mapi_req[i + 1].opnum != 0; i++);
+	opnum = mapi_request->mapi_req[i].opnum;
+
+	switch (opnum) {
+	case op_MAPI_FastTransferSourceGetBuffer:
+		ft_req = &mapi_request->mapi_req[i].u.mapi_FastTransferSourceGetBuffer;
+		buffer_size = ft_req->BufferSize;
+		if (buffer_size == 0xBABE) {
+			buffer_size = ft_req->MaximumBufferSize.MaximumBufferSize;
+		}
+		break;
+	case op_MAPI_QueryRows:
+		if (mapi_request->mapi_req[i].u.mapi_QueryRows.QueryRowsFlags & TBL_NOADVANCE) return;
+		break;
+	default:
+		return;
+	}
+
+	chain_req = talloc_zero_array(mem_ctx, struct EcDoRpc_MAPI_REQ, 2);
+	if (!chain_req) return;
+	chain_req[0] = mapi_request->mapi_req[i];
+	chain_request = *mapi_request;
+	chain_request.mapi_req = chain_req;
+	ft_req = &chain_req[0].u.mapi_FastTransferSourceGetBuffer;
+
+	/* RPC_HEADER_EXT, RopSize, fixed ROP response fields and handles */
+	overhead = EMSMDB_RPC_HEADER_EXT_SIZE + 2 + EMSMDB_CHAIN_ROP_OVERHEAD + (mapi_request->mapi_len - mapi_request->length);
+
+	while (dcesrv_EcDoRpcExt2_chain_continue(mapi_response, opnum)) {
+		if (ndr_rgbOut->offset + overhead + EMSMDB_CHAIN_MIN_BUFFER > max_size) break;
+		avail = MIN(max_size - ndr_rgbOut->offset - overhead, EMSMDB_CHAIN_MAX_BUFFER);
+
+		if (opnum == op_MAPI_FastTransferSourceGetBuffer) {
+			ft_req->BufferSize = MIN(buffer_size, avail);
+			if (ft_req->BufferSize == 0xBABE) {
+				ft_req->BufferSize -= 1;
+			}
+		}
+		if (!dcesrv_EcDoRpcExt2_chain_save(emsmdbp_ctx, &chain_request, &cursor)) break;
+
+		chain_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, &chain_request, false);
+		if (!chain_response) {
+			dcesrv_EcDoRpcExt2_chain_release(&cursor);
+			break;
+		}
+
+		chain_offset = dcesrv_EcDoRpcExt2_push_buffer(mem_ctx, ndr_rgbOut, chain_response,
+							      flags, compress, &chain_header);
+		if (ndr_rgbOut->offset > max_size || chain_header.SizeActual > EMSMDB_CHAIN_MAX_BUFFER + overhead) {
+			/* Drop the buffer and rewind the cursor so the data is sent with the next call */
+			ndr_rgbOut->offset = chain_offset;
+			dcesrv_EcDoRpcExt2_chain_restore(&cursor);
+			talloc_free(chain_response);
+			break;
+		}
+		dcesrv_EcDoRpcExt2_chain_release(&cursor);
+		*header = chain_header;
+		*header_offset = chain_offset;
+		dcesrv_EcDoRpcExt2_account(&chain_header);
+
+		/* The first response is released by the caller */
+		talloc_free(last_response);
+		last_response = chain_response;
+		mapi_response = chain_response;
+	}
+
+	talloc_free(last_response);
+	talloc_free(chain_req);
+}
+
 /**
    \details exchange_emsmdb EcDoRpcExt2 (0xB) function
 
@@ -1356,15 +1412,19 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 	struct mapi_response		*mapi_response;
 	struct RPC_HEADER_EXT		RPC_HEADER_EXT;
 	struct ndr_pull			*ndr_pull = NULL;
-	struct ndr_push			*ndr_uncomp_rgbOut;
-	struct ndr_push			*ndr_comp_rgbOut;
 	struct ndr_push			*ndr_rgbOut;
+	uint32_t			header_offset;
+	uint16_t			flags;
+	bool				compress;
 	uint32_t			pulFlags = 0x0;
-	uint32_t			pulTransTime = 0;
+	uint64_t			start;
+	uint64_t			elapsed;
 	DATA_BLOB			rgbIn;
 
 	OC_DEBUG(3, "exchange_emsmdb: EcDoRpcExt2 (0xB)\n");
 
+	start = emsmdbp_stats_now();
+
 	r->out.rgbOut = NULL;
 	*r->out.pcbOut = 0;
 	r->out.rgbAuxOut = NULL;
@@ -1414,45 +1474,43 @@ static enum MAPISTATUS dcesrv_EcDoRpcExt2(struct dcesrv_call_state *dce_call,
 		return ecRpcFormat;
 	}
 
-	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi2k7_request.mapi_request);
-	talloc_free(mapi2k7_request.mapi_request);
+	mapi_response = EcDoRpc_process_transaction(mem_ctx, emsmdbp_ctx, mapi2k7_request.mapi_request, true);
 
 	/* Fill EcDoRpcExt2 reply */
 	r->out.handle = r->in.handle;
 	*r->out.pulFlags = pulFlags;
 
-	/* Push MAPI response into a DATA blob */
-	ndr_uncomp_rgbOut = ndr_push_init_ctx(mem_ctx);
-	ndr_set_flags(&ndr_uncomp_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_mapi_response(ndr_uncomp_rgbOut, NDR_SCALARS|NDR_BUFFERS, mapi_response);
-	talloc_free(mapi_response);
-
-	/* TODO: compress if requested */
-	ndr_comp_rgbOut = ndr_uncomp_rgbOut;
-
-	/* Build RPC_HEADER_EXT header for MAPI response DATA blob */
-	RPC_HEADER_EXT.Version = 0x0000;
-	RPC_HEADER_EXT.Flags = RHEF_Last;
-	RPC_HEADER_EXT.Flags |= (mapi2k7_request.header.Flags & RHEF_XorMagic);
-	RPC_HEADER_EXT.Size = ndr_comp_rgbOut->offset;
-	RPC_HEADER_EXT.SizeActual = ndr_comp_rgbOut->offset;
+	/* Serialize the MAPI response in place after its header */
+	ndr_rgbOut = ndr_push_init_ctx(mem_ctx);
+	ndr_set_flags(&ndr_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
 
-	/* Obfuscate content if applicable*/
-	if (RPC_HEADER_EXT.Flags & RHEF_XorMagic) {
-		obfuscate_data(ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset, 0xA5);
+	compress = !(*r->in.pulFlags & pulFlags_NoCompression);
+	flags = mapi2k7_request.header.Flags & RHEF_XorMagic;
+	header_offset = dcesrv_EcDoRpcExt2_push_buffer(mem_ctx, ndr_rgbOut, mapi_response,
+						       flags, compress, &RPC_HEADER_EXT);
+	dcesrv_EcDoRpcExt2_account(&RPC_HEADER_EXT);
+
+	/* Pack further responses of the last ROP if the client supports chaining */
+	if (emsmdb_chaining && (*r->in.pulFlags & pulFlags_Chain)) {
+		dcesrv_EcDoRpcExt2_chain(mem_ctx, emsmdbp_ctx, mapi2k7_request.mapi_request,
+					 mapi_response, ndr_rgbOut, *r->in.pcbOut, flags, compress,
+					 &RPC_HEADER_EXT, &header_offset);
 	}
+	talloc_free(mapi_response);
+	talloc_free(mapi2k7_request.mapi_request);
 
-	/* Push the constructed blob */
-	ndr_rgbOut = ndr_push_init_ctx(mem_ctx);
-	ndr_set_flags(&ndr_rgbOut->flags, LIBNDR_FLAG_NOALIGN);
-	ndr_push_RPC_HEADER_EXT(ndr_rgbOut, NDR_SCALARS|NDR_BUFFERS, &RPC_HEADER_EXT);
-	ndr_push_bytes(ndr_rgbOut, ndr_comp_rgbOut->data, ndr_comp_rgbOut->offset);
+	/* Flag the last response buffer */
+	RPC_HEADER_EXT.Flags |= RHEF_Last;
+	dcesrv_EcDoRpcExt2_set_header(ndr_rgbOut, header_offset, &RPC_HEADER_EXT);
 
 	/* Push MAPI response into a DATA blob */
 	r->out.rgbOut = ndr_rgbOut->data;
 	*r->out.pcbOut = ndr_rgbOut->offset;
 
-	*r->out.pulTransTime = pulTransTime;
+	/* Report the time spent on the server, in milliseconds */
+	elapsed = emsmdbp_stats_now() - start;
+	*r->out.pulTransTime = elapsed / 1000;
+	emsmdbp_stats_transaction(emsmdbp_ctx, MAPI_E_SUCCESS, elapsed);
 
 	return MAPI_E_SUCCESS;
 }
@@ -1683,6 +1741,24 @@ static NTSTATUS dcesrv_exchange_emsmdb_init(struct dcesrv_context *dce_ctx)
 		return NT_STATUS_INTERNAL_ERROR;
 	}
 
+	/* Load EcDoRpcExt2 chaining and response compression settings */
+	emsmdb_chaining = lpcfg_parm_bool(dce_ctx->lp_ctx, NULL, "exchange_emsmdb", "chaining", true);
+	emsmdb_compression.enabled = lpcfg_parm_bool(dce_ctx->lp_ctx, NULL, "exchange_emsmdb", "compression", true);
+	emsmdb_compression.threshold = lpcfg_parm_int(dce_ctx->lp_ctx, NULL, "exchange_emsmdb", "compression_threshold", 1024);
+	emsmdb_compression.min_saving = lpcfg_parm_int(dce_ctx->lp_ctx, NULL, "exchange_emsmdb", "compression_min_saving", 10);
+	if (emsmdb_compression.min_saving > 99) {
+		emsmdb_compression.min_saving = 99;
+	}
+
+	/* Load the size above which uploaded streams are kept on disk */
+	emsmdbp_stream_set_spill(lpcfg_parm_ulong(dce_ctx->lp_ctx, NULL, "exchange_emsmdb", "stream_spill_threshold",
+						  EMSMDBP_STREAM_SPILL_THRESHOLD),
+				 lpcfg_parm_string(dce_ctx->lp_ctx, NULL, "exchange_emsmdb", "stream_spill_directory"));
+
+	/* Load ROP latency accounting settings, see ocstat */
+	emsmdbp_stats_set(lpcfg_parm_bool(dce_ctx->lp_ctx, NULL, "exchange_emsmdb", "rop_stats", true),
+			  lpcfg_parm_string(dce_ctx->lp_ctx, NULL, "exchange_emsmdb", "rop_stats_directory"));
+
 	return NT_STATUS_OK;
 }
 
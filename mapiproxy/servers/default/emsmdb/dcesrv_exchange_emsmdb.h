@@ -29,6 +29,7 @@
 #include "mapiproxy/libmapiproxy/libmapiproxy.h"
 #include "mapiproxy/libmapistore/mapistore.h"
 #include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "emsmdbp_stats.h"
 #include <ldb.h>
 #include <ldb_errors.h>
 #include <tevent.h>
@@ -45,6 +46,21 @@
 #endif
 #endif
 
+struct emsmdbp_replica {
+	uint16_t		replid;
+	struct GUID		guid;
+};
+
+/* Replica identifiers known for a mailbox, see emsmdbp_get_mailbox_replica() */
+struct emsmdbp_replica_map {
+	struct emsmdbp_replica_map	*prev;
+	struct emsmdbp_replica_map	*next;
+	char				*username;
+	struct emsmdbp_replica		mailbox;
+	struct emsmdbp_replica		*replicas;
+	uint32_t			replica_count;
+};
+
 struct emsmdbp_context {
 	char					*szUserDN;
 	char					*szDisplayName;
@@ -59,13 +75,41 @@ struct emsmdbp_context {
 
 	TALLOC_CTX				*mem_ctx;
 	struct GUID				session_uuid;
+	struct emsmdbp_replica_map		*replica_maps;
 };
 
+/* Signature shared by every entry of the EcDoRpc ROP dispatch table */
+typedef enum MAPISTATUS (*emsmdbp_rop_handler_fn)(TALLOC_CTX *, struct emsmdbp_context *,
+						  struct EcDoRpc_MAPI_REQ *, struct EcDoRpc_MAPI_REPL *,
+						  uint32_t *, uint16_t *);
+
+struct emsmdbp_rop_handler {
+	const char		*name;
+	emsmdbp_rop_handler_fn	fn;
+};
+
+#define	EMSMDBP_STREAM_SPILL_THRESHOLD	(4 * 1024 * 1024)
+
+struct emsmdbp_stream_rope;
+
 struct emsmdbp_stream {
-	size_t			position;
-	DATA_BLOB		buffer;
+	size_t				position;
+	DATA_BLOB			buffer;	/* buffer.data is unused once the rope is set */
+	struct emsmdbp_stream_rope	*rope;	/* written data, see emsmdbp_stream.c */
+};
+
+/* Messages of a content synchronization download, listed when it
+ * starts, see emsmdbp_sync_snapshot.c */
+struct emsmdbp_sync_snapshot {
+	uint64_t			*mids;
+	uint64_t			*cns;
+	uint32_t			count;
+	uint32_t			next;		/* next message to send */
+	uint32_t			preloaded;	/* end of the preloaded window */
 };
 
+typedef enum MAPISTATUS (*emsmdbp_sync_snapshot_read_row)(void *, uint32_t, uint64_t *, uint64_t *);
+
 struct emsmdbp_syncconfigure_request {
 	bool is_collector;
 	bool contents_mode;
@@ -200,6 +244,11 @@ struct emsmdbp_object_synccontext {
 	uint32_t		*cutmarks;
 	uint32_t		next_cutmark_idx;
 
+	/* content synchronization data handed out while a chained
+	   response is pending, sent again if the response is dropped */
+	struct emsmdbp_stream	replay;
+	bool			replay_retain;
+
 	/* SyncOpenCollector specific attributes */
 	/* Involved fmids in upload operations */
 	struct rawidset		*involved_fmids;
@@ -292,6 +341,10 @@ __BEGIN_DECLS
 NTSTATUS	samba_init_module(void);
 struct ldb_context *samdb_connect_url(TALLOC_CTX *, struct tevent_context *, struct loadparm_context *, struct auth_session_info *, unsigned int, const char *);
 
+/* definitions from dcesrv_exchange_emsmdb.c */
+enum MAPISTATUS		emsmdbp_rop_register(uint8_t, const char *, emsmdbp_rop_handler_fn);
+enum MAPISTATUS		emsmdbp_rop_unregister(uint8_t, emsmdbp_rop_handler_fn);
+
 /* definitions from emsmdbp.c */
 struct emsmdbp_context	*emsmdbp_init(struct loadparm_context *, const char *, void *);
 bool			emsmdbp_set_session_uuid(struct emsmdbp_context *, struct GUID);
@@ -305,6 +358,7 @@ enum MAPISTATUS		emsmdbp_get_org_dn(struct emsmdbp_context *, struct ldb_dn **);
 enum MAPISTATUS		emsmdbp_get_external_email(struct emsmdbp_context *, const char **);
 
 const struct GUID *const	MagicGUIDp;
+enum MAPISTATUS			emsmdbp_get_mailbox_replica(struct emsmdbp_context *, const char *, uint16_t *, struct GUID *);
 int				emsmdbp_guid_to_replid(struct emsmdbp_context *, const char *username, const struct GUID *, uint16_t *);
 int				emsmdbp_replid_to_guid(struct emsmdbp_context *, const char *username, const uint16_t, struct GUID *);
 int				emsmdbp_source_key_from_fmid(TALLOC_CTX *, struct emsmdbp_context *, const char *username, uint64_t, struct Binary_r **);
@@ -347,7 +401,9 @@ enum mapistore_error emsmdbp_folder_move_folder(struct emsmdbp_context *, struct
 struct emsmdbp_object *emsmdbp_folder_open_table(TALLOC_CTX *, struct emsmdbp_object *, uint32_t, uint32_t);
 struct emsmdbp_object *emsmdbp_object_table_init(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
 int emsmdbp_object_table_get_available_properties(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, struct SPropTagArray **);
+enum MAPISTATUS emsmdbp_object_table_fetch_rows(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint32_t, uint32_t, enum mapistore_query_type, void ***, enum MAPISTATUS **, uint32_t *);
 void **emsmdbp_object_table_get_row_props(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint32_t, enum mapistore_query_type, enum MAPISTATUS **);
+void **emsmdbp_object_table_get_fetched_row_props(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint32_t, enum mapistore_query_type, void **, enum MAPISTATUS *, enum MAPISTATUS **);
 enum MAPISTATUS emsmdbp_object_table_get_recursive_row_props(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, DATA_BLOB *, struct SPropTagArray *, uint64_t, int64_t *, uint32_t *);
 struct emsmdbp_object *emsmdbp_object_message_init(TALLOC_CTX *, struct emsmdbp_context *, uint64_t, struct emsmdbp_object *);
 enum mapistore_error emsmdbp_object_message_open(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *, uint64_t, uint64_t, bool, struct emsmdbp_object **, struct mapistore_message **);
@@ -363,12 +419,28 @@ struct emsmdbp_object *emsmdbp_object_synccontext_init(TALLOC_CTX *, struct emsm
 struct emsmdbp_object *emsmdbp_object_ftcontext_init(TALLOC_CTX *, struct emsmdbp_context *, struct emsmdbp_object *);
 struct emsmdbp_stream_data *emsmdbp_stream_data_from_value(TALLOC_CTX *, enum MAPITAGS, void *value, bool);
 struct emsmdbp_stream_data *emsmdbp_object_get_stream_data(struct emsmdbp_object *, enum MAPITAGS);
-DATA_BLOB emsmdbp_stream_read_buffer(struct emsmdbp_stream *, uint32_t);
-void emsmdbp_stream_write_buffer(TALLOC_CTX *, struct emsmdbp_stream *, DATA_BLOB);
 void emsmdbp_fill_table_row_blob(TALLOC_CTX *, struct emsmdbp_context *, DATA_BLOB *, uint16_t, enum MAPITAGS *, void **, enum MAPISTATUS *);
 void emsmdbp_fill_row_blob(TALLOC_CTX *, struct emsmdbp_context *, uint8_t *, DATA_BLOB *,struct SPropTagArray *, void **, enum MAPISTATUS *, bool *);
 enum MAPISTATUS emsmdbp_object_attach_sharing_metadata_XML_file(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *sharing_object);
 
+/* definitions from emsmdbp_stats.c */
+void		emsmdbp_stats_set(bool, const char *);
+uint64_t	emsmdbp_stats_now(void);
+void		emsmdbp_stats_rop(uint8_t, const char *, enum MAPISTATUS, uint64_t);
+void		emsmdbp_stats_transaction(struct emsmdbp_context *, enum MAPISTATUS, uint64_t);
+
+/* definitions from emsmdbp_stream.c */
+void		emsmdbp_stream_set_spill(size_t, const char *);
+DATA_BLOB	emsmdbp_stream_read_buffer(TALLOC_CTX *, struct emsmdbp_stream *, uint32_t);
+enum MAPISTATUS	emsmdbp_stream_write_buffer(TALLOC_CTX *, struct emsmdbp_stream *, DATA_BLOB);
+void		emsmdbp_stream_reset(struct emsmdbp_stream *);
+enum MAPISTATUS	emsmdbp_stream_map(TALLOC_CTX *, struct emsmdbp_stream *, DATA_BLOB *);
+enum MAPISTATUS	emsmdbp_stream_replay_record(TALLOC_CTX *, struct emsmdbp_stream *, DATA_BLOB);
+
+/* definitions from emsmdbp_sync_snapshot.c */
+enum MAPISTATUS	emsmdbp_sync_snapshot_fill(TALLOC_CTX *, struct emsmdbp_sync_snapshot *, uint32_t, emsmdbp_sync_snapshot_read_row, void *);
+bool		emsmdbp_sync_snapshot_window(struct emsmdbp_sync_snapshot *, uint32_t, struct UI8Array_r *);
+
 
 /* definitions from oxcfold.c */
 enum MAPISTATUS EcDoRpc_RopOpenFolder(TALLOC_CTX *, struct emsmdbp_context *, struct EcDoRpc_MAPI_REQ *, struct EcDoRpc_MAPI_REPL *, uint32_t *, uint16_t *);
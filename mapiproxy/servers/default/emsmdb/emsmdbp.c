@@ -289,7 +289,7 @@ _PUBLIC_ bool emsmdbp_verify_user(struct dcesrv_call_state *dce_call,
 
 	/* Get a copy of the username for later use and setup missing conn_info components */
 	emsmdbp_ctx->username = talloc_strdup(emsmdbp_ctx, username);
-	openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, emsmdbp_ctx->username, &emsmdbp_ctx->mstore_ctx->conn_info->repl_id, &emsmdbp_ctx->mstore_ctx->conn_info->replica_guid);
+	emsmdbp_get_mailbox_replica(emsmdbp_ctx, emsmdbp_ctx->username, &emsmdbp_ctx->mstore_ctx->conn_info->repl_id, &emsmdbp_ctx->mstore_ctx->conn_info->replica_guid);
 
 	return true;
 }
@@ -498,23 +498,128 @@ _PUBLIC_ enum MAPISTATUS emsmdbp_resolve_recipient(TALLOC_CTX *mem_ctx,
 	return MAPI_E_SUCCESS;
 }
 
+/**
+   \details Find or load the replica map of a mailbox
+
+   The mailbox replica is read from openchangedb the first time the
+   mailbox is used within the session. Mapped replicas are added to
+   the map as they get resolved, so that source keys and XIDs can be
+   built without querying the database again.
+
+   \param emsmdbp_ctx pointer to the EMSMDBP context
+   \param username the mailbox owner
+
+   \return pointer to the replica map on success, otherwise NULL
+ */
+static struct emsmdbp_replica_map *emsmdbp_replica_map_get(struct emsmdbp_context *emsmdbp_ctx, const char *username)
+{
+	enum MAPISTATUS			retval;
+	struct emsmdbp_replica_map	*map;
+
+	if (!emsmdbp_ctx || !username) return NULL;
+
+	for (map = emsmdbp_ctx->replica_maps; map; map = map->next) {
+		if (strcmp(map->username, username) == 0) {
+			return map;
+		}
+	}
+
+	map = talloc_zero(emsmdbp_ctx, struct emsmdbp_replica_map);
+	if (!map) return NULL;
+
+	retval = openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, username, &map->mailbox.replid, &map->mailbox.guid);
+	if (retval != MAPI_E_SUCCESS) {
+		talloc_free(map);
+		return NULL;
+	}
+
+	map->username = talloc_strdup(map, username);
+	if (!map->username) {
+		talloc_free(map);
+		return NULL;
+	}
+	DLIST_ADD(emsmdbp_ctx->replica_maps, map);
+
+	return map;
+}
+
+static void emsmdbp_replica_map_add(struct emsmdbp_replica_map *map, uint16_t replid, const struct GUID *guid)
+{
+	struct emsmdbp_replica	*replicas;
+
+	replicas = talloc_realloc(map, map->replicas, struct emsmdbp_replica, map->replica_count + 1);
+	if (!replicas) return;
+
+	replicas[map->replica_count].replid = replid;
+	replicas[map->replica_count].guid = *guid;
+	map->replicas = replicas;
+	map->replica_count++;
+}
+
+/**
+   \details Retrieve the replica identifier and GUID of a mailbox
+
+   This is the cached equivalent of openchangedb_get_MailboxReplica.
+
+   \param emsmdbp_ctx pointer to the EMSMDBP context
+   \param username the mailbox owner
+   \param ReplID pointer to the replica identifier to return, can be NULL
+   \param ReplGUID pointer to the replica GUID to return, can be NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_FOUND
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_get_mailbox_replica(struct emsmdbp_context *emsmdbp_ctx, const char *username,
+						     uint16_t *ReplID, struct GUID *ReplGUID)
+{
+	struct emsmdbp_replica_map	*map;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!emsmdbp_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+	OPENCHANGE_RETVAL_IF(!username, MAPI_E_INVALID_PARAMETER, NULL);
+
+	map = emsmdbp_replica_map_get(emsmdbp_ctx, username);
+	OPENCHANGE_RETVAL_IF(!map, MAPI_E_NOT_FOUND, NULL);
+
+	if (ReplID) {
+		*ReplID = map->mailbox.replid;
+	}
+	if (ReplGUID) {
+		*ReplGUID = map->mailbox.guid;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
 _PUBLIC_ int emsmdbp_guid_to_replid(struct emsmdbp_context *emsmdbp_ctx, const char *username, const struct GUID *guidP, uint16_t *replidP)
 {
-	uint16_t	replid;
-	struct GUID	guid;
+	struct emsmdbp_replica_map	*map;
+	uint16_t			replid;
+	uint32_t			i;
 
 	if (GUID_equal(guidP, MagicGUIDp)) {
 		*replidP = 2;
 		return MAPI_E_SUCCESS;
 	}
 
-	openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, username, &replid, &guid);
-	if (GUID_equal(guidP, &guid)) {
-		*replidP = replid;
-		return MAPI_E_SUCCESS;
+	map = emsmdbp_replica_map_get(emsmdbp_ctx, username);
+	if (map) {
+		if (GUID_equal(guidP, &map->mailbox.guid)) {
+			*replidP = map->mailbox.replid;
+			return MAPI_E_SUCCESS;
+		}
+		for (i = 0; i < map->replica_count; i++) {
+			if (GUID_equal(guidP, &map->replicas[i].guid)) {
+				*replidP = map->replicas[i].replid;
+				return MAPI_E_SUCCESS;
+			}
+		}
 	}
 
+	/* Unknown GUIDs are given a new replica identifier by openchangedb */
 	if (openchangedb_replica_mapping_guid_to_replid(emsmdbp_ctx->oc_ctx, username, guidP, &replid) == MAPI_E_SUCCESS) {
+		if (map) {
+			emsmdbp_replica_map_add(map, replid, guidP);
+		}
 		*replidP = replid;
 		return MAPI_E_SUCCESS;
 	}
@@ -524,21 +629,33 @@ _PUBLIC_ int emsmdbp_guid_to_replid(struct emsmdbp_context *emsmdbp_ctx, const c
 
 _PUBLIC_ int emsmdbp_replid_to_guid(struct emsmdbp_context *emsmdbp_ctx, const char *username, const uint16_t replid, struct GUID *guidP)
 {
-	uint16_t	db_replid;
-	struct GUID	guid;
+	struct emsmdbp_replica_map	*map;
+	struct GUID			guid;
+	uint32_t			i;
 
 	if (replid == 2) {
 		*guidP = MagicGUID;
 		return MAPI_E_SUCCESS;
 	}
 
-	openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, username, &db_replid, &guid);
-	if (replid == db_replid) {
-		*guidP = guid;
-		return MAPI_E_SUCCESS;
+	map = emsmdbp_replica_map_get(emsmdbp_ctx, username);
+	if (map) {
+		if (replid == map->mailbox.replid) {
+			*guidP = map->mailbox.guid;
+			return MAPI_E_SUCCESS;
+		}
+		for (i = 0; i < map->replica_count; i++) {
+			if (replid == map->replicas[i].replid) {
+				*guidP = map->replicas[i].guid;
+				return MAPI_E_SUCCESS;
+			}
+		}
 	}
 
 	if (openchangedb_replica_mapping_replid_to_guid(emsmdbp_ctx->oc_ctx, username, replid, &guid) == MAPI_E_SUCCESS) {
+		if (map) {
+			emsmdbp_replica_map_add(map, replid, &guid);
+		}
 		*guidP = guid;
 		return MAPI_E_SUCCESS;
 	}
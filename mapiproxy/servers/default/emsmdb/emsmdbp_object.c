@@ -704,6 +704,7 @@ _PUBLIC_ int emsmdbp_object_stream_commit(struct emsmdbp_object *stream_object)
         uint8_t				*utf8_buffer;
         struct Binary_r			*binary_data;
         struct SRow			aRow;
+	DATA_BLOB			content;
 	size_t				converted_size;
 	uint16_t			propType;
 
@@ -717,22 +718,28 @@ _PUBLIC_ int emsmdbp_object_stream_commit(struct emsmdbp_object *stream_object)
 		aRow.cValues = 1;
 		aRow.lpProps = talloc_zero(NULL, struct SPropValue);
 
+		/* Large uploads are mapped from their spill file rather than copied */
+		if (emsmdbp_stream_map(aRow.lpProps, &stream->stream, &content) != MAPI_E_SUCCESS) {
+			talloc_free(aRow.lpProps);
+			return MAPISTORE_ERROR;
+		}
+
 		propType = stream->property & 0xffff;
 		if (propType == PT_BINARY) {
 			binary_data = talloc(aRow.lpProps, struct Binary_r);
-			binary_data->cb = stream->stream.buffer.length;
-			binary_data->lpb = stream->stream.buffer.data;
+			binary_data->cb = content.length;
+			binary_data->lpb = content.data;
 			stream_data = binary_data;
 		}
 		else if (propType == PT_STRING8) {
-			stream_data = stream->stream.buffer.data;
+			stream_data = talloc_strndup(aRow.lpProps, (const char *) content.data, content.length);
 		}
 		else {
 			/* PT_UNICODE */
-			utf8_buffer = talloc_array(aRow.lpProps, uint8_t, stream->stream.buffer.length + 2);
+			utf8_buffer = talloc_array(aRow.lpProps, uint8_t, content.length + 2);
 			convert_string(CH_UTF16LE, CH_UTF8,
-				       stream->stream.buffer.data, stream->stream.buffer.length,
-				       utf8_buffer, stream->stream.buffer.length, &converted_size);
+				       content.data, content.length,
+				       utf8_buffer, content.length, &converted_size);
 			utf8_buffer[converted_size] = 0;
 			stream_data = utf8_buffer;
 		}
@@ -769,6 +776,9 @@ static int emsmdbp_object_destructor(void *data)
 	contextID = emsmdbp_get_contextID(object);
 	switch (object->type) {
 	case EMSMDBP_OBJECT_FOLDER:
+		if (object->backend_object) {
+			mapistore_prefetch_release(object->emsmdbp_ctx->mstore_ctx, contextID, object->backend_object);
+		}
 		if (object->object.folder->mapistore_root) {
 			ret = mapistore_del_context(object->emsmdbp_ctx->mstore_ctx, contextID);
 		}
@@ -2066,7 +2076,79 @@ _PUBLIC_ int emsmdbp_object_table_get_available_properties(TALLOC_CTX *mem_ctx,
 	return retval;
 }
 
-_PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t row_id, enum mapistore_query_type query_type, enum MAPISTATUS **retvalsp)
+/**
+   \details Fetch in batch the cells of a window of rows of a
+   non-mapistore table.
+
+   The returned cells are meant to be handed row by row to
+   emsmdbp_object_table_get_fetched_row_props, which then no longer
+   issues one backend query per cell.
+
+   \param mem_ctx pointer to the memory context to allocate cells with
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param table_object pointer to the table object
+   \param row_id position of the first row of the window
+   \param count number of rows in the window
+   \param query_type type of query (prefiltered or live filtered)
+   \param cellsp pointer on the array of cells to return, indexed by
+   row then column
+   \param retvalsp pointer on the array of per-cell status to return
+   \param rowsp pointer on the number of rows actually fetched
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_NOT_IMPLEMENTED if the
+   table or its backend does not support batched fetch, otherwise MAPI
+   error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_object_table_fetch_rows(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t row_id, uint32_t count, enum mapistore_query_type query_type, void ***cellsp, enum MAPISTATUS **retvalsp, uint32_t *rowsp)
+{
+	enum MAPISTATUS		retval;
+	struct SPropTagArray	props;
+
+	OPENCHANGE_RETVAL_IF(!emsmdbp_ctx || !table_object, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!cellsp || !retvalsp || !rowsp, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(table_object->type != EMSMDBP_OBJECT_TABLE, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(emsmdbp_is_mapistore(table_object), MAPI_E_NOT_IMPLEMENTED, NULL);
+	OPENCHANGE_RETVAL_IF(table_object->object.table->ulType != MAPISTORE_FOLDER_TABLE &&
+			     table_object->object.table->ulType != MAPISTORE_MESSAGE_TABLE,
+			     MAPI_E_NOT_IMPLEMENTED, NULL);
+	OPENCHANGE_RETVAL_IF(!count || !table_object->object.table->prop_count, MAPI_E_NOT_IMPLEMENTED, NULL);
+
+	props.cValues = table_object->object.table->prop_count;
+	props.aulPropTag = table_object->object.table->properties;
+	retval = openchangedb_table_get_properties(mem_ctx, emsmdbp_ctx->oc_ctx, table_object->backend_object,
+						   &props, row_id, count,
+						   (query_type == MAPISTORE_LIVEFILTERED_QUERY),
+						   cellsp, retvalsp);
+	if (retval != MAPI_E_SUCCESS) {
+		if (retval != MAPI_E_NOT_IMPLEMENTED) {
+			OC_DEBUG(5, "unable to fetch %d rows from row %d: %s", count, row_id, mapi_get_errstr(retval));
+		}
+		return retval;
+	}
+
+	/* The backend clamps the window to the table size */
+	*rowsp = talloc_array_length(*cellsp) / props.cValues;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Retrieve the properties of a table row, using cells
+   already fetched by emsmdbp_object_table_fetch_rows when available
+
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the emsmdb provider context
+   \param table_object pointer to the table object
+   \param row_id position of the row in the table
+   \param query_type type of query (prefiltered or live filtered)
+   \param cells pointer to the fetched cells of the row, may be NULL
+   \param cell_retvals pointer to the fetched per-cell status of the
+   row, may be NULL
+   \param retvalsp pointer on the array of per-column status to return
+
+   \return the array of column values on success, otherwise NULL
+ */
+_PUBLIC_ void **emsmdbp_object_table_get_fetched_row_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t row_id, enum mapistore_query_type query_type, void **cells, enum MAPISTATUS *cell_retvals, enum MAPISTATUS **retvalsp)
 {
         void				**data_pointers;
         enum MAPISTATUS			retval;
@@ -2233,6 +2315,11 @@ _PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct e
 					retval = MAPI_E_SUCCESS;
 					break;
 				default:
+					if (cells) {
+						data_pointers[i] = cells[i];
+						retval = cell_retvals[i];
+						break;
+					}
 					retval = openchangedb_table_get_property(data_pointers, emsmdbp_ctx->oc_ctx,
 										 table_object->backend_object,
 										 table->properties[i], 
@@ -2241,6 +2328,10 @@ _PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct e
 										 data_pointers + i);
 				}
 			}
+			else if (cells) {
+				data_pointers[i] = cells[i];
+				retval = cell_retvals[i];
+			}
 			else {
 				retval = openchangedb_table_get_property(data_pointers, emsmdbp_ctx->oc_ctx,
 									 table_object->backend_object,
@@ -2272,6 +2363,11 @@ _PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct e
         return data_pointers;
 }
 
+_PUBLIC_ void **emsmdbp_object_table_get_row_props(TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *table_object, uint32_t row_id, enum mapistore_query_type query_type, enum MAPISTATUS **retvalsp)
+{
+	return emsmdbp_object_table_get_fetched_row_props(mem_ctx, emsmdbp_ctx, table_object, row_id, query_type, NULL, NULL, retvalsp);
+}
+
 
 
 /**
@@ -2694,6 +2790,7 @@ _PUBLIC_ enum mapistore_error emsmdbp_object_message_open(TALLOC_CTX *mem_ctx, s
 		/* mapistore implementation goes here */
 		message_object = emsmdbp_object_message_init(mem_ctx, emsmdbp_ctx, messageID, folder_object);
 		contextID = emsmdbp_get_contextID(folder_object);
+		mapistore_prefetch_access(emsmdbp_ctx->mstore_ctx, contextID, messageID);
 		ret = mapistore_folder_open_message(emsmdbp_ctx->mstore_ctx, contextID, folder_object->backend_object, message_object, messageID, read_write, &message_object->backend_object);
 		if (ret == MAPISTORE_SUCCESS && msgp) {
 			if (mapistore_message_get_message_data(emsmdbp_ctx->mstore_ctx, contextID, message_object->backend_object, mem_ctx, msgp) != MAPISTORE_SUCCESS) {
@@ -3623,50 +3720,6 @@ _PUBLIC_ struct emsmdbp_stream_data *emsmdbp_stream_data_from_value(TALLOC_CTX *
 	return stream_data;
 }
 
-_PUBLIC_ DATA_BLOB emsmdbp_stream_read_buffer(struct emsmdbp_stream *stream, uint32_t length)
-{
-	DATA_BLOB buffer;
-	uint32_t real_length;
-
-	real_length = length;
-	if (real_length + stream->position > stream->buffer.length) {
-		real_length = stream->buffer.length - stream->position;
-	}
-	buffer.length = real_length;
-	buffer.data = stream->buffer.data + stream->position;
-	stream->position += real_length;
-
-	return buffer;
-}
-
-_PUBLIC_ void emsmdbp_stream_write_buffer(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, DATA_BLOB new_buffer)
-{
-	size_t new_position;
-	uint32_t old_length;
-	uint8_t *old_data;
-
-	new_position = stream->position + new_buffer.length;
-	if (new_position >= stream->buffer.length) {
-		old_length = stream->buffer.length;
-		stream->buffer.length = new_position;
-		if (stream->buffer.data) {
-			old_data = stream->buffer.data;
-			stream->buffer.data = talloc_realloc(mem_ctx, stream->buffer.data, uint8_t, stream->buffer.length);
-			if (!stream->buffer.data) {
-				OC_DEBUG(5, "WARNING: [bug] lost buffer pointer (data = NULL)\n");
-				stream->buffer.data = talloc_array(mem_ctx, uint8_t, stream->buffer.length);
-				memcpy(stream->buffer.data, old_data, old_length);
-			}
-		}
-		else {
-			stream->buffer.data = talloc_array(mem_ctx, uint8_t, stream->buffer.length);
-		}
-	}
-
-	memcpy(stream->buffer.data + stream->position, new_buffer.data, new_buffer.length);
-	stream->position = new_position;
-}
-
 _PUBLIC_ struct emsmdbp_stream_data *emsmdbp_object_get_stream_data(struct emsmdbp_object *object, enum MAPITAGS prop_tag)
 {
         struct emsmdbp_stream_data *current_data;
@@ -3724,11 +3777,9 @@ _PUBLIC_ struct emsmdbp_object *emsmdbp_object_synccontext_init(TALLOC_CTX *mem_
         synccontext_object->object.synccontext->stream.buffer.data = NULL;
 
 	synccontext_object->object.synccontext->cnset_seen = talloc_zero(emsmdbp_ctx, struct idset);
-	openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, emsmdbp_ctx->username, NULL, &synccontext_object->object.synccontext->cnset_seen->repl.guid);
+	emsmdbp_get_mailbox_replica(emsmdbp_ctx, emsmdbp_ctx->username, NULL, &synccontext_object->object.synccontext->cnset_seen->repl.guid);
 	synccontext_object->object.synccontext->cnset_seen->ranges = talloc_zero(synccontext_object->object.synccontext->cnset_seen, struct globset_range);
 	synccontext_object->object.synccontext->cnset_seen->range_count = 1;
-	synccontext_object->object.synccontext->cnset_seen->ranges->next = NULL;
-	synccontext_object->object.synccontext->cnset_seen->ranges->prev = synccontext_object->object.synccontext->cnset_seen->ranges;
 	synccontext_object->object.synccontext->cnset_seen->ranges->low = 0xffffffffffffffffLL;
 	synccontext_object->object.synccontext->cnset_seen->ranges->high = 0x0;
 
@@ -0,0 +1,388 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_stats.c
+
+   \brief Per-ROP and per-user latency accounting
+
+   Counters live in a file mapped by each server process, see
+   emsmdbp_stats.h for the layout. They are only ever updated with
+   atomic builtins so that no lock is taken in the ROP hot path, and
+   read by the ocstat tool. Exiting processes add their counters to a
+   locked archive file instead of leaving their segment behind.
+ */
+
+#include "dcesrv_exchange_emsmdb.h"
+
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static struct {
+	bool				enabled;
+	char				*directory;
+	pid_t				pid;
+	struct emsmdbp_stats_segment	*segment;
+} stats = { true, NULL, 0, NULL };
+
+static struct emsmdbp_stats_user *emsmdbp_stats_user_get(struct emsmdbp_stats_segment *, const char *);
+
+static char *emsmdbp_stats_path(TALLOC_CTX *mem_ctx, const char *name, pid_t pid)
+{
+	const char	*directory = stats.directory ? stats.directory : EMSMDBP_STATS_DIRECTORY;
+
+	if (pid) {
+		return talloc_asprintf(mem_ctx, "%s/%s%d", directory, name, (int)pid);
+	}
+	return talloc_asprintf(mem_ctx, "%s/%s", directory, name);
+}
+
+static void emsmdbp_stats_counter_merge(struct emsmdbp_stats_counter *dst, const struct emsmdbp_stats_counter *src)
+{
+	uint32_t	i;
+
+	dst->calls += src->calls;
+	dst->errors += src->errors;
+	dst->usec_total += src->usec_total;
+	if (src->usec_max > dst->usec_max) {
+		dst->usec_max = src->usec_max;
+	}
+	for (i = 0; i < EMSMDBP_STATS_BUCKETS; i++) {
+		dst->histogram[i] += src->histogram[i];
+	}
+}
+
+/**
+   \details Add the counters of the process segment to the archive of
+   the statistics directory. The archive is locked while it is updated
+   since several processes may exit at the same time.
+
+   \param segment pointer to the segment to archive
+ */
+static void emsmdbp_stats_archive(const struct emsmdbp_stats_segment *segment)
+{
+	struct emsmdbp_stats_segment	*archive;
+	struct emsmdbp_stats_user	*user;
+	struct stat			st;
+	char				*path;
+	uint32_t			i;
+	int				fd;
+
+	path = emsmdbp_stats_path(NULL, EMSMDBP_STATS_ARCHIVE, 0);
+	if (!path) return;
+
+	fd = open(path, O_RDWR|O_CREAT|O_NOFOLLOW, 0644);
+	if (fd == -1) {
+		OC_DEBUG(1, "Unable to open ROP statistics archive %s: %s", path, strerror(errno));
+		talloc_free(path);
+		return;
+	}
+	if (flock(fd, LOCK_EX) == -1 || fstat(fd, &st) == -1) {
+		OC_DEBUG(1, "Unable to lock ROP statistics archive %s: %s", path, strerror(errno));
+		goto end;
+	}
+	/* Never update a file planted by another user */
+	if (!S_ISREG(st.st_mode) || st.st_uid != geteuid()) {
+		OC_DEBUG(1, "Ignoring ROP statistics archive %s: not a regular file owned by the server", path);
+		goto end;
+	}
+	if (st.st_size != (off_t) sizeof (struct emsmdbp_stats_segment) &&
+	    ftruncate(fd, sizeof (struct emsmdbp_stats_segment)) == -1) {
+		OC_DEBUG(1, "Unable to size ROP statistics archive %s: %s", path, strerror(errno));
+		goto end;
+	}
+
+	archive = mmap(NULL, sizeof (struct emsmdbp_stats_segment), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (archive == MAP_FAILED) {
+		OC_DEBUG(1, "Unable to map ROP statistics archive %s: %s", path, strerror(errno));
+		goto end;
+	}
+
+	/* New or outdated archive */
+	if (st.st_size != (off_t) sizeof (struct emsmdbp_stats_segment) || archive->magic != EMSMDBP_STATS_MAGIC ||
+	    archive->version != EMSMDBP_STATS_VERSION || archive->size != sizeof (struct emsmdbp_stats_segment)) {
+		memset(archive, 0, sizeof (struct emsmdbp_stats_segment));
+		archive->magic = EMSMDBP_STATS_MAGIC;
+		archive->version = EMSMDBP_STATS_VERSION;
+		archive->size = sizeof (struct emsmdbp_stats_segment);
+		archive->started = segment->started;
+	}
+
+	emsmdbp_stats_counter_merge(&archive->transactions, &segment->transactions);
+	for (i = 0; i < EMSMDBP_STATS_ROPS; i++) {
+		if (!archive->rops[i].name[0] && segment->rops[i].name[0]) {
+			memcpy(archive->rops[i].name, segment->rops[i].name, EMSMDBP_STATS_NAME_LEN - 1);
+		}
+		emsmdbp_stats_counter_merge(&archive->rops[i].counter, &segment->rops[i].counter);
+	}
+	for (i = 0; i < EMSMDBP_STATS_USERS; i++) {
+		if (!segment->users[i].hash) continue;
+		user = emsmdbp_stats_user_get(archive, segment->users[i].username);
+		if (user) {
+			emsmdbp_stats_counter_merge(&user->counter, &segment->users[i].counter);
+		}
+	}
+	munmap(archive, sizeof (struct emsmdbp_stats_segment));
+
+end:
+	close(fd);
+	talloc_free(path);
+}
+
+/**
+   \details Drop the statistics segment mapped by the process. A
+   segment created by the calling process is archived and removed, one
+   inherited from the parent process is only unmapped.
+ */
+static void emsmdbp_stats_segment_release(void)
+{
+	char	*path;
+
+	if (!stats.segment) return;
+
+	if (stats.pid == getpid()) {
+		emsmdbp_stats_archive(stats.segment);
+		path = emsmdbp_stats_path(NULL, EMSMDBP_STATS_PREFIX, stats.pid);
+		if (path) {
+			unlink(path);
+			talloc_free(path);
+		}
+	}
+
+	munmap(stats.segment, sizeof (struct emsmdbp_stats_segment));
+	stats.segment = NULL;
+}
+
+static void emsmdbp_stats_atexit(void)
+{
+	emsmdbp_stats_segment_release();
+}
+
+/**
+   \details Configure ROP latency accounting
+
+   \param enabled whether counters are maintained
+   \param directory the directory where the per-process segments are
+   created, NULL for EMSMDBP_STATS_DIRECTORY
+ */
+_PUBLIC_ void emsmdbp_stats_set(bool enabled, const char *directory)
+{
+	/* The segment is created again on next use */
+	emsmdbp_stats_segment_release();
+	stats.pid = 0;
+
+	stats.enabled = enabled;
+	talloc_free(stats.directory);
+	stats.directory = directory ? talloc_strdup(NULL, directory) : NULL;
+}
+
+/**
+   \details Return the statistics segment of the calling process,
+   creating it on first use. Server processes are forked after the
+   module is initialized, so a segment inherited from the parent is
+   dropped and a new one created for the child. The segment is
+   archived and removed when the process exits.
+
+   \return pointer to the segment, NULL if accounting is disabled or
+   the segment could not be created
+ */
+static struct emsmdbp_stats_segment *emsmdbp_stats_segment_get(void)
+{
+	struct emsmdbp_stats_segment	*segment;
+	static bool			atexit_registered = false;
+	char				*path;
+	pid_t				pid;
+	int				fd;
+
+	if (!stats.enabled) return NULL;
+
+	pid = getpid();
+	if (stats.pid == pid) return stats.segment;
+
+	emsmdbp_stats_segment_release();
+	stats.pid = pid;
+
+	path = emsmdbp_stats_path(NULL, EMSMDBP_STATS_PREFIX, pid);
+	if (!path) return NULL;
+
+	/* The name is predictable: remove what a previous process with
+	 * the same pid left behind and refuse to follow symlinks */
+	unlink(path);
+	fd = open(path, O_RDWR|O_CREAT|O_EXCL|O_NOFOLLOW, 0644);
+	if (fd == -1) {
+		OC_DEBUG(1, "Unable to create ROP statistics segment %s: %s", path, strerror(errno));
+		talloc_free(path);
+		return NULL;
+	}
+
+	if (ftruncate(fd, sizeof (struct emsmdbp_stats_segment)) == -1) {
+		OC_DEBUG(1, "Unable to size ROP statistics segment %s: %s", path, strerror(errno));
+		close(fd);
+		unlink(path);
+		talloc_free(path);
+		return NULL;
+	}
+
+	segment = mmap(NULL, sizeof (struct emsmdbp_stats_segment), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (segment == MAP_FAILED) {
+		OC_DEBUG(1, "Unable to map ROP statistics segment %s: %s", path, strerror(errno));
+		unlink(path);
+		talloc_free(path);
+		return NULL;
+	}
+	talloc_free(path);
+
+	segment->version = EMSMDBP_STATS_VERSION;
+	segment->size = sizeof (struct emsmdbp_stats_segment);
+	segment->pid = pid;
+	segment->started = time(NULL);
+	/* Readers check the magic before anything else */
+	__sync_synchronize();
+	segment->magic = EMSMDBP_STATS_MAGIC;
+
+	stats.segment = segment;
+
+	if (!atexit_registered) {
+		atexit(emsmdbp_stats_atexit);
+		atexit_registered = true;
+	}
+
+	return segment;
+}
+
+/**
+   \details Return the current time of the monotonic clock
+
+   \return the time in microseconds
+ */
+_PUBLIC_ uint64_t emsmdbp_stats_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void emsmdbp_stats_counter_add(struct emsmdbp_stats_counter *counter, bool failed, uint64_t usec)
+{
+	uint64_t	max;
+	uint32_t	bucket;
+
+	for (bucket = 0; bucket < EMSMDBP_STATS_BUCKETS - 1 && (usec >> bucket); bucket++);
+
+	__sync_fetch_and_add(&counter->calls, 1);
+	if (failed) {
+		__sync_fetch_and_add(&counter->errors, 1);
+	}
+	__sync_fetch_and_add(&counter->usec_total, usec);
+	__sync_fetch_and_add(&counter->histogram[bucket], 1);
+
+	max = counter->usec_max;
+	while (usec > max && !__sync_bool_compare_and_swap(&counter->usec_max, max, usec)) {
+		max = counter->usec_max;
+	}
+}
+
+/**
+   \details Find or claim the slot of a user in the segment
+
+   \return pointer to the user slot, NULL if the table is full
+ */
+static struct emsmdbp_stats_user *emsmdbp_stats_user_get(struct emsmdbp_stats_segment *segment,
+							  const char *username)
+{
+	struct emsmdbp_stats_user	*user;
+	const char			*c;
+	uint32_t			hash = 0x811c9dc5;
+	uint32_t			i;
+	uint32_t			slot;
+
+	for (c = username; *c; c++) {
+		hash = (hash ^ (uint8_t)*c) * 0x01000193;
+	}
+	if (!hash) hash = 1;
+
+	for (i = 0; i < EMSMDBP_STATS_USERS; i++) {
+		slot = (hash + i) % EMSMDBP_STATS_USERS;
+		user = &segment->users[slot];
+		if (user->hash == hash && !strncmp(user->username, username, EMSMDBP_STATS_USERNAME_LEN - 1)) {
+			return user;
+		}
+		if (!user->hash && __sync_bool_compare_and_swap(&user->hash, 0, hash)) {
+			strncpy(user->username, username, EMSMDBP_STATS_USERNAME_LEN - 1);
+			return user;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+   \details Account the time spent in a ROP handler
+
+   \param opnum the ROP identifier
+   \param name the ROP name
+   \param retval the value returned by the handler
+   \param usec the time spent in the handler in microseconds
+ */
+_PUBLIC_ void emsmdbp_stats_rop(uint8_t opnum, const char *name, enum MAPISTATUS retval, uint64_t usec)
+{
+	struct emsmdbp_stats_segment	*segment;
+	struct emsmdbp_stats_rop	*rop;
+
+	segment = emsmdbp_stats_segment_get();
+	if (!segment) return;
+
+	rop = &segment->rops[opnum];
+	if (!rop->name[0] && name) {
+		strncpy(rop->name, name, EMSMDBP_STATS_NAME_LEN - 1);
+	}
+	emsmdbp_stats_counter_add(&rop->counter, retval != MAPI_E_SUCCESS, usec);
+}
+
+/**
+   \details Account the time spent processing a whole EcDoRpc or
+   EcDoRpcExt2 call, globally and for the user owning the session
+
+   \param emsmdbp_ctx pointer to the EMSMDB provider context
+   \param retval the status of the call
+   \param usec the time spent in the call in microseconds
+ */
+_PUBLIC_ void emsmdbp_stats_transaction(struct emsmdbp_context *emsmdbp_ctx, enum MAPISTATUS retval, uint64_t usec)
+{
+	struct emsmdbp_stats_segment	*segment;
+	struct emsmdbp_stats_user	*user;
+
+	segment = emsmdbp_stats_segment_get();
+	if (!segment) return;
+
+	emsmdbp_stats_counter_add(&segment->transactions, retval != MAPI_E_SUCCESS, usec);
+
+	if (!emsmdbp_ctx || !emsmdbp_ctx->username) return;
+	user = emsmdbp_stats_user_get(segment, emsmdbp_ctx->username);
+	if (user) {
+		emsmdbp_stats_counter_add(&user->counter, retval != MAPI_E_SUCCESS, usec);
+	}
+}
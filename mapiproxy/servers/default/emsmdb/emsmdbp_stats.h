@@ -0,0 +1,85 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef	__EMSMDBP_STATS_H
+#define	__EMSMDBP_STATS_H
+
+/**
+   \file emsmdbp_stats.h
+
+   \brief Layout of the per-process ROP latency segment
+
+   Each server process maps a file named EMSMDBP_STATS_PREFIX<pid> in
+   the statistics directory and updates it with atomic operations
+   only. When the process exits, its counters are added to the
+   EMSMDBP_STATS_ARCHIVE file, which shares the same layout, and the
+   segment is removed. The layout has no dependency on samba so that
+   ocstat can map the segments read-only.
+ */
+
+#include <stdint.h>
+
+#define	EMSMDBP_STATS_MAGIC		0x5453434f	/* "OCST" */
+#define	EMSMDBP_STATS_VERSION		1
+#define	EMSMDBP_STATS_DIRECTORY		"/dev/shm"
+#define	EMSMDBP_STATS_PREFIX		"openchange-emsmdb."
+#define	EMSMDBP_STATS_ARCHIVE		"openchange-emsmdb-archive"
+
+#define	EMSMDBP_STATS_ROPS		0x100
+#define	EMSMDBP_STATS_USERS		256
+#define	EMSMDBP_STATS_NAME_LEN		32
+#define	EMSMDBP_STATS_USERNAME_LEN	64
+
+/* Bucket 0 counts calls under 1us, bucket n calls in [2^(n-1), 2^n) us
+ * and the last bucket everything above */
+#define	EMSMDBP_STATS_BUCKETS		26
+
+struct emsmdbp_stats_counter {
+	uint64_t	calls;
+	uint64_t	errors;
+	uint64_t	usec_total;
+	uint64_t	usec_max;
+	uint64_t	histogram[EMSMDBP_STATS_BUCKETS];
+};
+
+struct emsmdbp_stats_rop {
+	char				name[EMSMDBP_STATS_NAME_LEN];
+	struct emsmdbp_stats_counter	counter;
+};
+
+struct emsmdbp_stats_user {
+	uint32_t			hash;		/* 0 for a free slot */
+	char				username[EMSMDBP_STATS_USERNAME_LEN];
+	struct emsmdbp_stats_counter	counter;
+};
+
+struct emsmdbp_stats_segment {
+	uint32_t			magic;
+	uint32_t			version;
+	uint32_t			size;
+	uint32_t			pid;		/* 0 for the archive */
+	uint64_t			started;	/* unix time */
+	struct emsmdbp_stats_counter	transactions;	/* EcDoRpc and EcDoRpcExt2 calls */
+	struct emsmdbp_stats_rop	rops[EMSMDBP_STATS_ROPS];
+	struct emsmdbp_stats_user	users[EMSMDBP_STATS_USERS];
+};
+
+#endif /* __EMSMDBP_STATS_H */
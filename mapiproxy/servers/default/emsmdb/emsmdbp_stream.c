@@ -0,0 +1,491 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_stream.c
+
+   \brief Stream buffers used by the stream and ICS upload/download ROPs
+
+   Uploaded data is stored in a rope of chunks whose size doubles up to
+   EMSMDBP_STREAM_CHUNK_MAX, so appending never copies what has already
+   been written. Once the stream grows above the spill threshold, its
+   content is moved to an unlinked temporary file and further writes go
+   straight to disk.
+ */
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "dcesrv_exchange_emsmdb.h"
+
+#define	EMSMDBP_STREAM_CHUNK_MIN	(64 * 1024)
+#define	EMSMDBP_STREAM_CHUNK_MAX	(4 * 1024 * 1024)
+
+struct emsmdbp_stream_chunk {
+	uint8_t				*data;
+	size_t				offset;
+	size_t				size;
+};
+
+struct emsmdbp_stream_rope {
+	struct emsmdbp_stream_chunk	*chunks;
+	uint32_t			chunk_count;
+	size_t				allocated;
+	int				fd;
+};
+
+struct emsmdbp_stream_mapping {
+	void				*addr;
+	size_t				length;
+};
+
+static size_t	spill_threshold = EMSMDBP_STREAM_SPILL_THRESHOLD;
+static char	*spill_directory = NULL;
+
+/**
+   \details Configure when and where uploaded streams are spilled to
+   disk
+
+   \param threshold the stream size above which data is moved to a
+   temporary file, 0 to keep streams in memory
+   \param directory the directory where temporary files are created,
+   NULL to use TMPDIR or /tmp
+ */
+_PUBLIC_ void emsmdbp_stream_set_spill(size_t threshold, const char *directory)
+{
+	spill_threshold = threshold;
+	talloc_free(spill_directory);
+	spill_directory = directory ? talloc_strdup(NULL, directory) : NULL;
+}
+
+static int emsmdbp_stream_rope_destructor(struct emsmdbp_stream_rope *rope)
+{
+	if (rope->fd != -1) {
+		close(rope->fd);
+	}
+	return 0;
+}
+
+static struct emsmdbp_stream_rope *emsmdbp_stream_rope_init(TALLOC_CTX *mem_ctx)
+{
+	struct emsmdbp_stream_rope	*rope;
+
+	rope = talloc_zero(mem_ctx, struct emsmdbp_stream_rope);
+	if (!rope) return NULL;
+
+	rope->fd = -1;
+	talloc_set_destructor(rope, emsmdbp_stream_rope_destructor);
+
+	return rope;
+}
+
+/**
+   \details Grow the rope so it can hold size bytes. Chunks double in
+   size until EMSMDBP_STREAM_CHUNK_MAX is reached and existing chunks
+   are never moved.
+ */
+static bool emsmdbp_stream_rope_reserve(struct emsmdbp_stream_rope *rope, size_t size)
+{
+	struct emsmdbp_stream_chunk	*chunks;
+	struct emsmdbp_stream_chunk	*chunk;
+	size_t				chunk_size;
+
+	while (rope->allocated < size) {
+		chunk_size = rope->allocated;
+		if (chunk_size < EMSMDBP_STREAM_CHUNK_MIN) {
+			chunk_size = EMSMDBP_STREAM_CHUNK_MIN;
+		} else if (chunk_size > EMSMDBP_STREAM_CHUNK_MAX) {
+			chunk_size = EMSMDBP_STREAM_CHUNK_MAX;
+		}
+
+		chunks = talloc_realloc(rope, rope->chunks, struct emsmdbp_stream_chunk, rope->chunk_count + 1);
+		if (!chunks) return false;
+		rope->chunks = chunks;
+
+		chunk = &rope->chunks[rope->chunk_count];
+		chunk->data = talloc_array(rope->chunks, uint8_t, chunk_size);
+		if (!chunk->data) return false;
+		chunk->offset = rope->allocated;
+		chunk->size = chunk_size;
+
+		rope->chunk_count++;
+		rope->allocated += chunk_size;
+	}
+
+	return true;
+}
+
+/**
+   \details Find the chunk holding a given stream offset
+ */
+static struct emsmdbp_stream_chunk *emsmdbp_stream_rope_chunk(struct emsmdbp_stream_rope *rope, size_t offset)
+{
+	uint32_t	i;
+
+	for (i = 0; i < rope->chunk_count; i++) {
+		if (offset < rope->chunks[i].offset + rope->chunks[i].size) {
+			return &rope->chunks[i];
+		}
+	}
+
+	return NULL;
+}
+
+static bool emsmdbp_stream_rope_write(struct emsmdbp_stream_rope *rope, size_t offset, const uint8_t *data, size_t length)
+{
+	struct emsmdbp_stream_chunk	*chunk;
+	ssize_t				written;
+	size_t				count;
+
+	if (rope->fd != -1) {
+		while (length > 0) {
+			written = pwrite(rope->fd, data, length, offset);
+			if (written <= 0) {
+				OC_DEBUG(0, "unable to write %zu bytes to stream spill file: %s", length, strerror(errno));
+				return false;
+			}
+			data += written;
+			offset += written;
+			length -= written;
+		}
+		return true;
+	}
+
+	if (!emsmdbp_stream_rope_reserve(rope, offset + length)) {
+		OC_DEBUG(0, "unable to grow stream buffer to %zu bytes", offset + length);
+		return false;
+	}
+
+	while (length > 0) {
+		chunk = emsmdbp_stream_rope_chunk(rope, offset);
+		count = chunk->offset + chunk->size - offset;
+		if (count > length) {
+			count = length;
+		}
+		memcpy(chunk->data + (offset - chunk->offset), data, count);
+		data += count;
+		offset += count;
+		length -= count;
+	}
+
+	return true;
+}
+
+static bool emsmdbp_stream_rope_read(struct emsmdbp_stream_rope *rope, size_t offset, uint8_t *data, size_t length)
+{
+	struct emsmdbp_stream_chunk	*chunk;
+	ssize_t				nread;
+	size_t				count;
+
+	if (rope->fd != -1) {
+		while (length > 0) {
+			nread = pread(rope->fd, data, length, offset);
+			if (nread <= 0) {
+				OC_DEBUG(0, "unable to read %zu bytes from stream spill file: %s", length, strerror(errno));
+				return false;
+			}
+			data += nread;
+			offset += nread;
+			length -= nread;
+		}
+		return true;
+	}
+
+	while (length > 0) {
+		chunk = emsmdbp_stream_rope_chunk(rope, offset);
+		if (!chunk) return false;
+		count = chunk->offset + chunk->size - offset;
+		if (count > length) {
+			count = length;
+		}
+		memcpy(data, chunk->data + (offset - chunk->offset), count);
+		data += count;
+		offset += count;
+		length -= count;
+	}
+
+	return true;
+}
+
+/**
+   \details Move the in-memory chunks of a rope to an unlinked
+   temporary file
+
+   \param rope pointer to the rope to spill
+   \param length the number of meaningful bytes in the rope
+
+   \return true on success, otherwise false and the rope is left in
+   memory
+ */
+static bool emsmdbp_stream_rope_spill(struct emsmdbp_stream_rope *rope, size_t length)
+{
+	const char	*directory;
+	char		*path;
+	int		fd;
+	uint32_t	i;
+	size_t		count;
+
+	directory = spill_directory;
+	if (!directory) {
+		directory = getenv("TMPDIR");
+	}
+	if (!directory) {
+		directory = "/tmp";
+	}
+
+	path = talloc_asprintf(NULL, "%s/openchange-stream-XXXXXX", directory);
+	if (!path) return false;
+	fd = mkstemp(path);
+	if (fd == -1) {
+		OC_DEBUG(0, "unable to create stream spill file in %s: %s", directory, strerror(errno));
+		talloc_free(path);
+		return false;
+	}
+	unlink(path);
+	talloc_free(path);
+
+	rope->fd = fd;
+	for (i = 0; i < rope->chunk_count && rope->chunks[i].offset < length; i++) {
+		count = length - rope->chunks[i].offset;
+		if (count > rope->chunks[i].size) {
+			count = rope->chunks[i].size;
+		}
+		if (!emsmdbp_stream_rope_write(rope, rope->chunks[i].offset, rope->chunks[i].data, count)) {
+			rope->fd = -1;
+			close(fd);
+			return false;
+		}
+	}
+
+	OC_DEBUG(5, "stream of %zu bytes spilled to disk", length);
+
+	talloc_free(rope->chunks);
+	rope->chunks = NULL;
+	rope->chunk_count = 0;
+	rope->allocated = 0;
+
+	return true;
+}
+
+/**
+   \details Read data from a stream at its current position and move
+   the position forward
+
+   \param mem_ctx pointer to the memory context the data is copied to
+   when it does not lie within a single chunk of the stream
+   \param stream pointer to the stream to read from
+   \param length the maximum number of bytes to read
+
+   \return a DATA_BLOB pointing to the data read. The data either
+   belongs to the stream and remains valid until it is released, or is
+   allocated on mem_ctx.
+ */
+_PUBLIC_ DATA_BLOB emsmdbp_stream_read_buffer(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, uint32_t length)
+{
+	struct emsmdbp_stream_chunk	*chunk;
+	DATA_BLOB			buffer;
+	uint32_t			real_length;
+
+	real_length = length;
+	if (real_length + stream->position > stream->buffer.length) {
+		real_length = stream->buffer.length - stream->position;
+	}
+	buffer.length = real_length;
+
+	if (!stream->rope) {
+		buffer.data = stream->buffer.data + stream->position;
+	} else {
+		/* Avoid a copy when the range lies within a single chunk */
+		chunk = NULL;
+		if (stream->rope->fd == -1) {
+			chunk = emsmdbp_stream_rope_chunk(stream->rope, stream->position);
+		}
+		if (chunk && stream->position + real_length <= chunk->offset + chunk->size) {
+			buffer.data = chunk->data + (stream->position - chunk->offset);
+		} else {
+			buffer.data = talloc_array(mem_ctx, uint8_t, real_length);
+			if (!buffer.data || !emsmdbp_stream_rope_read(stream->rope, stream->position, buffer.data, real_length)) {
+				talloc_free(buffer.data);
+				buffer.data = NULL;
+				buffer.length = 0;
+				return buffer;
+			}
+		}
+	}
+	stream->position += real_length;
+
+	return buffer;
+}
+
+/**
+   \details Write data to a stream at its current position, extending
+   the stream when needed, and move the position forward
+
+   \param mem_ctx pointer to the memory context owning the stream data
+   \param stream pointer to the stream to write to
+   \param new_buffer the data to write
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_ENOUGH_MEMORY
+   or MAPI_E_DISK_ERROR
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_stream_write_buffer(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, DATA_BLOB new_buffer)
+{
+	size_t	new_position;
+
+	if (!stream->rope) {
+		stream->rope = emsmdbp_stream_rope_init(mem_ctx);
+		OPENCHANGE_RETVAL_IF(!stream->rope, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		/* Move the current content of the stream into the rope */
+		if (stream->buffer.length > 0
+		    && !emsmdbp_stream_rope_write(stream->rope, 0, stream->buffer.data, stream->buffer.length)) {
+			talloc_free(stream->rope);
+			stream->rope = NULL;
+			return MAPI_E_NOT_ENOUGH_MEMORY;
+		}
+		stream->buffer.data = NULL;
+	}
+
+	new_position = stream->position + new_buffer.length;
+	OPENCHANGE_RETVAL_IF(!emsmdbp_stream_rope_write(stream->rope, stream->position, new_buffer.data, new_buffer.length),
+			     stream->rope->fd != -1 ? MAPI_E_DISK_ERROR : MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	if (new_position > stream->buffer.length) {
+		stream->buffer.length = new_position;
+	}
+	stream->position = new_position;
+
+	if (stream->rope->fd == -1 && spill_threshold && stream->buffer.length > spill_threshold) {
+		emsmdbp_stream_rope_spill(stream->rope, stream->buffer.length);
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Discard the content of a stream
+
+   \param stream pointer to the stream to reset
+ */
+_PUBLIC_ void emsmdbp_stream_reset(struct emsmdbp_stream *stream)
+{
+	talloc_free(stream->rope);
+	stream->rope = NULL;
+	stream->buffer.data = NULL;
+	stream->buffer.length = 0;
+	stream->position = 0;
+}
+
+static int emsmdbp_stream_mapping_destructor(struct emsmdbp_stream_mapping *mapping)
+{
+	munmap(mapping->addr, mapping->length);
+	return 0;
+}
+
+/**
+   \details Provide a contiguous read-only view of the whole stream.
+
+   Spilled streams are mapped from their temporary file, so committing
+   a large upload does not bring it back to the heap. In-memory streams
+   held in a single chunk are returned as is.
+
+   \param mem_ctx pointer to the memory context owning the view
+   \param stream pointer to the stream to view
+   \param blob pointer on the DATA_BLOB to fill
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_stream_map(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, DATA_BLOB *blob)
+{
+	struct emsmdbp_stream_mapping	*mapping;
+	void				*addr;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!stream, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!blob, MAPI_E_INVALID_PARAMETER, NULL);
+
+	blob->length = stream->buffer.length;
+	if (!stream->rope) {
+		blob->data = stream->buffer.data;
+		return MAPI_E_SUCCESS;
+	}
+
+	if (stream->buffer.length == 0) {
+		blob->data = NULL;
+		return MAPI_E_SUCCESS;
+	}
+
+	if (stream->rope->fd != -1) {
+		addr = mmap(NULL, stream->buffer.length, PROT_READ, MAP_PRIVATE, stream->rope->fd, 0);
+		OPENCHANGE_RETVAL_IF(addr == MAP_FAILED, MAPI_E_DISK_ERROR, NULL);
+
+		mapping = talloc_zero(mem_ctx, struct emsmdbp_stream_mapping);
+		if (!mapping) {
+			munmap(addr, stream->buffer.length);
+			return MAPI_E_NOT_ENOUGH_MEMORY;
+		}
+		mapping->addr = addr;
+		mapping->length = stream->buffer.length;
+		talloc_set_destructor(mapping, emsmdbp_stream_mapping_destructor);
+		blob->data = (uint8_t *) addr;
+		return MAPI_E_SUCCESS;
+	}
+
+	if (stream->rope->chunks[0].size >= stream->buffer.length) {
+		blob->data = stream->rope->chunks[0].data;
+		return MAPI_E_SUCCESS;
+	}
+
+	blob->data = talloc_array(mem_ctx, uint8_t, stream->buffer.length);
+	OPENCHANGE_RETVAL_IF(!blob->data, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	OPENCHANGE_RETVAL_IF(!emsmdbp_stream_rope_read(stream->rope, 0, blob->data, blob->length),
+			     MAPI_E_CALL_FAILED, blob->data);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Record data handed out from a stream that releases what has
+   been read, so it can be sent again if the response carrying it is
+   dropped. Recorded data is read back from the replay stream once its
+   position is moved backwards.
+
+   \param mem_ctx pointer to the memory context owning the replay data
+   \param replay pointer to the replay stream
+   \param data the data handed out
+
+   \return MAPI_E_SUCCESS on success, MAPI_E_INVALID_PARAMETER if
+   recorded data is still pending in the replay stream, otherwise the
+   error returned by emsmdbp_stream_write_buffer
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_stream_replay_record(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *replay, DATA_BLOB data)
+{
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!replay, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(replay->position != replay->buffer.length, MAPI_E_INVALID_PARAMETER, NULL);
+
+	if (!data.length) {
+		return MAPI_E_SUCCESS;
+	}
+
+	return emsmdbp_stream_write_buffer(mem_ctx, replay, data);
+}
@@ -0,0 +1,113 @@
+/*
+   OpenChange Server implementation
+
+   EMSMDBP: EMSMDB Provider implementation
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+   \file emsmdbp_sync_snapshot.c
+
+   \brief Message list of an ICS content synchronization download
+
+   The message and change numbers of the synchronized table are listed
+   once when the download starts. The stream is then produced from that
+   list over as many RopFastTransferSourceGetBuffer calls as needed, so
+   messages created or deleted in the meantime do not shift the
+   messages left to send. Only message bodies are preloaded window by
+   window.
+ */
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "dcesrv_exchange_emsmdb.h"
+
+/**
+   \details List the messages of a table
+
+   \param mem_ctx pointer to the memory context the list is allocated
+   with
+   \param snapshot pointer to the snapshot to fill
+   \param rows the number of rows in the table
+   \param read_row function reading the message and change numbers of
+   a row. Rows it fails to read are left out
+   \param private_data pointer passed to read_row
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsmdbp_sync_snapshot_fill(TALLOC_CTX *mem_ctx,
+						    struct emsmdbp_sync_snapshot *snapshot,
+						    uint32_t rows,
+						    emsmdbp_sync_snapshot_read_row read_row,
+						    void *private_data)
+{
+	uint32_t	row;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!snapshot, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!read_row, MAPI_E_INVALID_PARAMETER, NULL);
+
+	memset(snapshot, 0, sizeof (struct emsmdbp_sync_snapshot));
+	if (!rows) {
+		return MAPI_E_SUCCESS;
+	}
+
+	snapshot->mids = talloc_array(mem_ctx, uint64_t, rows);
+	OPENCHANGE_RETVAL_IF(!snapshot->mids, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	snapshot->cns = talloc_array(mem_ctx, uint64_t, rows);
+	OPENCHANGE_RETVAL_IF(!snapshot->cns, MAPI_E_NOT_ENOUGH_MEMORY, snapshot->mids);
+
+	for (row = 0; row < rows; row++) {
+		if (read_row(private_data, row, &snapshot->mids[snapshot->count],
+			     &snapshot->cns[snapshot->count]) == MAPI_E_SUCCESS) {
+			snapshot->count++;
+		}
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Return the next window of messages to preload, once the
+   messages of the previous one have all been sent
+
+   \param snapshot pointer to the snapshot
+   \param interval the maximum number of messages in a window
+   \param window pointer to the returned message identifiers, they
+   point into the snapshot
+
+   \return true if a new window starts at the next message, otherwise
+   false
+ */
+_PUBLIC_ bool emsmdbp_sync_snapshot_window(struct emsmdbp_sync_snapshot *snapshot,
+					   uint32_t interval,
+					   struct UI8Array_r *window)
+{
+	uint32_t	end;
+
+	if (!snapshot || !window || !interval) return false;
+	if (snapshot->next < snapshot->preloaded || snapshot->next >= snapshot->count) {
+		return false;
+	}
+
+	end = (snapshot->count - snapshot->next > interval) ? snapshot->next + interval : snapshot->count;
+	window->cValues = end - snapshot->next;
+	window->lpui8 = snapshot->mids + snapshot->next;
+	snapshot->preloaded = end;
+
+	return true;
+}
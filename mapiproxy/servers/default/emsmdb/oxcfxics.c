@@ -37,6 +37,7 @@
 
 /* the maximum buffer that will be populated during msg synchronization operations (note: this is a soft limit) */
 static const size_t max_message_sync_size = 262144;
+/* number of table rows fetched and preloaded at once during msg synchronization operations */
 static const uint32_t message_preload_interval = 150;
 
 /** notes:
@@ -89,11 +90,17 @@ struct oxcfxics_sync_data {
 	struct oxcfxics_message_sync_data	*message_sync_data;
 };
 
+/* Message table being synchronized: its messages are listed when the
+ * download starts and their bodies preloaded by windows of
+ * message_preload_interval as the stream is produced */
 struct oxcfxics_message_sync_data {
-	uint64_t	*mids;
-	uint64_t	*cns;
-	uint64_t	count;
-	uint64_t	max;
+	struct emsmdbp_sync_snapshot	snapshot;
+};
+
+/* Table read by oxcfxics_read_message_row */
+struct oxcfxics_message_table {
+	struct emsmdbp_context		*emsmdbp_ctx;
+	struct emsmdbp_object		*table_object;
 };
 
 /** ndr helpers */
@@ -792,7 +799,64 @@ static void oxcfxics_table_set_cn_restriction(struct emsmdbp_context *emsmdbp_ct
 	mapistore_table_set_restrictions(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(table_object), table_object->backend_object, &cn_restriction, &state);
 }
 
-static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object_synccontext *synccontext, const char *owner, struct oxcfxics_sync_data *sync_data, struct emsmdbp_object *folder_object)
+/**
+   \details Read the message and change numbers of a message table row
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS oxcfxics_read_message_row(void *private_data, uint32_t row, uint64_t *mid, uint64_t *cn)
+{
+	struct oxcfxics_message_table	*table = private_data;
+	TALLOC_CTX			*mem_ctx;
+	void				**data_pointers;
+	enum MAPISTATUS			*retvals;
+	enum MAPISTATUS			retval = MAPI_E_NOT_FOUND;
+
+	mem_ctx = talloc_new(NULL);
+	data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, table->emsmdbp_ctx, table->table_object, row, MAPISTORE_PREFILTERED_QUERY, &retvals);
+	if (data_pointers && retvals[0] == MAPI_E_SUCCESS) {
+		*mid = *(uint64_t *) data_pointers[0];
+		if (retvals[1] == MAPI_E_SUCCESS) {
+			*cn = *(uint64_t *) data_pointers[1];
+		} else {
+			OC_DEBUG(5, "Unable to get change number for mid: %" PRIx64, *mid);
+			*cn = 0;
+		}
+		retval = MAPI_E_SUCCESS;
+	}
+	talloc_free(mem_ctx);
+
+	return retval;
+}
+
+/**
+   \details Make the next message of the synchronized table available,
+   preloading the bodies of the next window of messages once the
+   current one has been sent
+
+   \return true if a message is available at snapshot.next, false once
+   every message was sent
+ */
+static bool oxcfxics_fetch_message_window(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object *folder_object, enum mapistore_table_type mstore_type, struct oxcfxics_message_sync_data *message_sync_data)
+{
+	struct UI8Array_r	preload_mids;
+
+	if (message_sync_data->snapshot.next >= message_sync_data->snapshot.count) {
+		return false;
+	}
+
+	/* Only mapistore folders have a backend to preload from */
+	if (emsmdbp_sync_snapshot_window(&message_sync_data->snapshot, message_preload_interval, &preload_mids)
+	    && emsmdbp_is_mapistore(folder_object)) {
+		if (mapistore_prefetch_hint(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(folder_object), folder_object->backend_object, mstore_type, &preload_mids) == MAPISTORE_ERR_NOT_AVAILABLE) {
+			mapistore_folder_preload_message_bodies(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(folder_object), folder_object->backend_object, mstore_type, &preload_mids);
+		}
+	}
+
+	return true;
+}
+
+static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, struct emsmdbp_object_synccontext *synccontext, const char *owner, struct oxcfxics_sync_data *sync_data, struct emsmdbp_object *folder_object, size_t size_hint)
 {
 	TALLOC_CTX			*mem_ctx, *msg_ctx;
 	bool				folder_is_mapistore, changed_prop_index = false;
@@ -800,7 +864,7 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 	struct emsmdbp_object		*table_object, *message_object;
 	uint32_t			i;
 	enum MAPISTATUS			*retvals, *header_retvals, retval_msg_class = MAPI_E_NOT_FOUND;
-	const enum MAPITAGS		table_prop_tags[] = {PidTagMid, PidTagChangeNumber};
+	static const enum MAPITAGS	table_prop_tags[] = {PidTagMid, PidTagChangeNumber};
 	void				**data_pointers, **header_data_pointers;
 	struct FILETIME			*lm_time;
 	NTTIME				nt_time;
@@ -818,6 +882,7 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 	struct UI8Array_r		*deleted_eids;
 	struct SPropTagArray		*msg_properties, *properties, *sharing_properties;
 	struct oxcfxics_message_sync_data	*message_sync_data;
+	struct oxcfxics_message_table	message_table;
 	struct SSortOrderSet		lpSortCriteria;
 	uint8_t				status;
 	struct oxcfxics_prop_index	msg_prop_index;
@@ -841,7 +906,7 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		message_sync_data = sync_data->message_sync_data;
 	}
 	else {
-		message_sync_data = talloc_zero(NULL, struct oxcfxics_message_sync_data);
+		message_sync_data = talloc_zero(sync_data, struct oxcfxics_message_sync_data);
 		sync_data->message_sync_data = message_sync_data;
 
 		/* we only push "messageChangeFull" since we don't handle property-based changes */
@@ -857,7 +922,6 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		table_object->object.table->properties = (enum MAPITAGS *)table_prop_tags;
 
 		oxcfxics_table_set_cn_restriction(emsmdbp_ctx, table_object, owner, original_cnset_seen);
-		message_sync_data->max = 0;
 		if (emsmdbp_is_mapistore(table_object)) {
 			contextID = emsmdbp_get_contextID(folder_object);
 			mapistore_table_set_columns(emsmdbp_ctx->mstore_ctx, contextID, table_object->backend_object,
@@ -882,38 +946,19 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 
 			OC_DEBUG(5, "push_messageChange: %d objects in table\n", table_object->object.table->denominator);
 
-			/* fetch maching mids */
-			message_sync_data->mids = talloc_zero_array(message_sync_data, uint64_t, table_object->object.table->denominator);
-			if (!message_sync_data->mids) {
-				OC_DEBUG(1, "Error allocating mid array");
+			/* mids and change numbers are listed once: messages created or
+			   deleted between two GetBuffer calls must not shift the rows
+			   left to send */
+			message_table.emsmdbp_ctx = emsmdbp_ctx;
+			message_table.table_object = table_object;
+			if (emsmdbp_sync_snapshot_fill(message_sync_data, &message_sync_data->snapshot,
+						       table_object->object.table->denominator,
+						       oxcfxics_read_message_row, &message_table) != MAPI_E_SUCCESS) {
+				OC_DEBUG(1, "Error listing the messages of the table");
 				goto end;
 			}
-			message_sync_data->cns = talloc_zero_array(message_sync_data, uint64_t,
-								   table_object->object.table->denominator);
-			if (!message_sync_data->cns) {
-				OC_DEBUG(1, "Error allocating change number array");
-				goto end;
-			}
-
-			for (i = 0; i < table_object->object.table->denominator; i++) {
-				data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, emsmdbp_ctx, table_object, i, MAPISTORE_PREFILTERED_QUERY, &retvals);
-				if (data_pointers) {
-					if (retvals[0] == MAPI_E_SUCCESS) {
-						message_sync_data->mids[message_sync_data->max] = *(uint64_t *) data_pointers[0];
-						if (retvals[1] == MAPI_E_SUCCESS) {
-							message_sync_data->cns[message_sync_data->max] = *(uint64_t *) data_pointers[1];
-						} else {
-							OC_DEBUG(5, "Unable to get change number for mid: %" PRIx64,
-								 *(uint64_t *) data_pointers[0]);
-							message_sync_data->cns[message_sync_data->max] = 0;
-						}
-						message_sync_data->max++;
-					}
-				}
-			}
 		}
-
-		message_sync_data->count = 0;
+		talloc_free(table_object);
 	}
 
 	folder_is_mapistore = emsmdbp_is_mapistore(folder_object);
@@ -927,11 +972,11 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 	}
 
 	/* open each message and fetch properties */
-	for (; sync_data->ndr->offset < max_message_sync_size && message_sync_data->count < message_sync_data->max; message_sync_data->count++) {
+	for (; sync_data->ndr->offset < size_hint && oxcfxics_fetch_message_window(emsmdbp_ctx, folder_object, mstore_type, message_sync_data); message_sync_data->snapshot.next++) {
 		msg_ctx = talloc_new(NULL);
 		msg_properties = properties;
 
-		eid = *(message_sync_data->mids + message_sync_data->count);
+		eid = message_sync_data->snapshot.mids[message_sync_data->snapshot.next];
 		if (eid == 0x7fffffffffffffffLL) {
 			OC_DEBUG(0, "message without a valid eid\n");
 			goto end_row;
@@ -939,32 +984,23 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		/* Always include the mid in the updated IdsetGiven to
 		   notify the client the mid is still valid in the server */
 		emsmdbp_replid_to_guid(emsmdbp_ctx, owner, eid & 0xffff, &replica_guid);
-		RAWIDSET_push_guid_glob(sync_data->eid_set, &replica_guid, (eid >> 16) & 0x0000ffffffffffff);
 
-		if (folder_is_mapistore && message_sync_data->cns[message_sync_data->count] != 0) {
-			cn = ((message_sync_data->cns[message_sync_data->count] >> 16) & 0x0000ffffffffffff);
+		if (folder_is_mapistore && message_sync_data->snapshot.cns[message_sync_data->snapshot.next] != 0) {
+			cn = ((message_sync_data->snapshot.cns[message_sync_data->snapshot.next] >> 16) & 0x0000ffffffffffff);
 			if (IDSET_includes_guid_glob(original_cnset_seen, &sync_data->replica_guid, cn)) {
+				RAWIDSET_push_guid_glob(sync_data->eid_set, &replica_guid, (eid >> 16) & 0x0000ffffffffffff);
 				synccontext->skipped_objects++;
 				OC_DEBUG(5, "Skip message %"PRIx64" as cn %.12"PRIx64" already present\n", eid, cn);
 				goto end_row;
 			}
 		}
 
-		if (folder_is_mapistore && (message_sync_data->count % message_preload_interval) == 0) {
-			preload_mids.lpui8 = message_sync_data->mids + message_sync_data->count;
-			if ((message_sync_data->count + message_preload_interval) < message_sync_data->max) {
-				preload_mids.cValues = message_preload_interval;
-			}
-			else {
-				preload_mids.cValues = message_sync_data->max - message_sync_data->count;
-			}
-			mapistore_folder_preload_message_bodies(emsmdbp_ctx->mstore_ctx, contextID, folder_object->backend_object, mstore_type, &preload_mids);
-		}
-
+		/* The message may have been deleted since the download started */
 		if (emsmdbp_object_message_open(msg_ctx, emsmdbp_ctx, folder_object, folder_object->object.folder->folderID, eid, false, &message_object, &msg) != MAPISTORE_SUCCESS) {
 			OC_DEBUG(5, "message '%.16"PRIx64"' could not be open, skipped\n", eid);
 			goto end_row;
 		}
+		RAWIDSET_push_guid_glob(sync_data->eid_set, &replica_guid, (eid >> 16) & 0x0000ffffffffffff);
 
 		data_pointers = emsmdbp_object_get_properties(msg_ctx, emsmdbp_ctx, message_object, msg_properties, &retvals);
 		if (!data_pointers) {
@@ -1161,13 +1197,13 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 		talloc_free(msg_ctx);
 	}
 
-	if (sync_data->ndr->offset >= max_message_sync_size) {
-		OC_DEBUG(5, "reached max sync size: %u >= %zu\n", sync_data->ndr->offset, max_message_sync_size);
+	if (sync_data->ndr->offset >= size_hint) {
+		OC_DEBUG(5, "reached sync chunk size: %u >= %zu\n", sync_data->ndr->offset, size_hint);
 	}
 
-	if (message_sync_data->count < message_sync_data->max) {
+	if (message_sync_data->snapshot.next < message_sync_data->snapshot.count) {
 		end_of_table = false;
-		OC_DEBUG(5, "table status: count: %"PRId64", max: %"PRId64"\n", message_sync_data->count, message_sync_data->max);
+		OC_DEBUG(5, "table status: message: %"PRIu32", count: %"PRIu32"\n", message_sync_data->snapshot.next, message_sync_data->snapshot.count);
 	}
 	else {
 		/* fetch deleted ids */
@@ -1193,9 +1229,10 @@ static bool oxcfxics_push_messageChange(struct emsmdbp_context *emsmdbp_ctx, str
 				}
 			}
 			preload_mids.cValues = 0;
+			mapistore_prefetch_release(emsmdbp_ctx->mstore_ctx, contextID, folder_object->backend_object);
 			mapistore_folder_preload_message_bodies(emsmdbp_ctx->mstore_ctx, contextID, folder_object->backend_object, mstore_type, &preload_mids);
 		}
-		OC_DEBUG(5, "end of table reached: count: %"PRId64", max: %"PRId64"\n", message_sync_data->count, message_sync_data->max);
+		OC_DEBUG(5, "end of table reached: messages: %"PRIu32"\n", message_sync_data->snapshot.count);
 		talloc_free(message_sync_data);
 		sync_data->message_sync_data = NULL;
 		end_of_table = true;
@@ -1207,17 +1244,37 @@ end:
 	return end_of_table;
 }
 
-static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_synccontext *synccontext, TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct emsmdbp_object *parent_object)
+/**
+   \details Produce the next chunk of the content synchronization stream
+
+   The stream is produced as a state machine over sync_stage and the
+   message tables: each call serializes complete messages until the chunk
+   reaches size_hint (a soft limit bounded by max_message_sync_size), so
+   only the part of the stream the client is about to download is kept
+   in memory.
+
+   \param synccontext pointer to the synchronization context
+   \param mem_ctx pointer to the memory context
+   \param emsmdbp_ctx pointer to the EMSMDBP context
+   \param owner the mailbox owner
+   \param parent_object pointer to the synchronized folder
+   \param size_hint the number of bytes the client is waiting for
+ */
+static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_synccontext *synccontext, TALLOC_CTX *mem_ctx, struct emsmdbp_context *emsmdbp_ctx, const char *owner, struct emsmdbp_object *parent_object, uint32_t size_hint)
 {
 	struct oxcfxics_sync_data	*sync_data;
 	struct idset			*new_idset, *old_idset;
 	
 	/* contentsSync = [progressTotal] *( [progressPerMessage] messageChange ) [deletions] [readStateChanges] state IncrSyncEnd */
 
+	if (size_hint > max_message_sync_size) {
+		size_hint = max_message_sync_size;
+	}
+
 	if (synccontext->sync_stage == 0) {
 		/* 1. we setup the mandatory properties indexes */
-		sync_data = talloc_zero(NULL, struct oxcfxics_sync_data);
-		openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, owner, NULL, &sync_data->replica_guid);
+		sync_data = talloc_zero(synccontext, struct oxcfxics_sync_data);
+		emsmdbp_get_mailbox_replica(emsmdbp_ctx, owner, NULL, &sync_data->replica_guid);
 		SPropTagArray_find(synccontext->properties, PidTagMid, &sync_data->prop_index.eid);
 		SPropTagArray_find(synccontext->properties, PidTagChangeNumber, &sync_data->prop_index.change_number);
 		SPropTagArray_find(synccontext->properties, PidTagChangeKey, &sync_data->prop_index.change_key);
@@ -1253,7 +1310,7 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 				sync_data->table_type = MAPISTORE_MESSAGE_TABLE;
 			}
 
-			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object)) {
+			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object, size_hint)) {
 				new_idset = RAWIDSET_convert_to_idset(NULL, sync_data->cnset_seen);
 				old_idset = synccontext->cnset_seen;
 				/* IDSET_dump (synccontext->cnset_seen, "initial cnset_seen"); */
@@ -1278,7 +1335,7 @@ static void oxcfxics_fill_synccontext_with_messageChange(struct emsmdbp_object_s
 				sync_data->table_type = MAPISTORE_FAI_TABLE;
 			}
 
-			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object)) {
+			if (oxcfxics_push_messageChange(emsmdbp_ctx, synccontext, owner, sync_data, parent_object, size_hint)) {
 				new_idset = RAWIDSET_convert_to_idset(NULL, sync_data->cnset_seen);
 				old_idset = synccontext->cnset_seen_fai;
 				/* IDSET_dump (synccontext->cnset_seen, "initial cnset_seen_fai"); */
@@ -1600,7 +1657,7 @@ static void oxcfxics_prepare_synccontext_with_folderChange(struct emsmdbp_object
 
 	/* 1b. we setup context data */
 	sync_data = talloc_zero(NULL, struct oxcfxics_sync_data);
-	openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, owner, NULL, &sync_data->replica_guid);
+	emsmdbp_get_mailbox_replica(emsmdbp_ctx, owner, NULL, &sync_data->replica_guid);
 	SPropTagArray_find(synccontext->properties, PidTagParentFolderId, &sync_data->prop_index.parent_fid);
 	SPropTagArray_find(synccontext->properties, PidTagFolderId, &sync_data->prop_index.eid);
 	SPropTagArray_find(synccontext->properties, PidTagChangeNumber, &sync_data->prop_index.change_number);
@@ -1709,7 +1766,7 @@ static inline void oxcfxics_fill_ftcontext_fasttransfer_response(struct FastTran
 		ftcontext->next_cutmark_idx = mark_idx;
 	}
 	
-	response->TransferBuffer = emsmdbp_stream_read_buffer(&ftcontext->stream, buffer_size);
+	response->TransferBuffer = emsmdbp_stream_read_buffer(mem_ctx, &ftcontext->stream, buffer_size);
 	response->TotalStepCount = ftcontext->total_steps;
 	if (ftcontext->stream.position == ftcontext->stream.buffer.length) {
 		response->TransferStatus = TransferStatus_Done;
@@ -1746,107 +1803,140 @@ static uint32_t oxcfxics_advance_cutmarks(struct emsmdbp_object_synccontext *syn
 }
 
 
+/**
+   \details Append data read from a synchronization stream to a
+   transfer buffer
+
+   \param replay_ctx pointer to the memory context owning the recorded data
+   \param replay pointer to the stream recording the data read, NULL if
+   it is not recorded
+ */
+static void oxcfxics_append_transfer_buffer(TALLOC_CTX *mem_ctx, DATA_BLOB *transfer_buffer, struct emsmdbp_stream *stream, uint32_t length, TALLOC_CTX *replay_ctx, struct emsmdbp_stream *replay)
+{
+	TALLOC_CTX	*local_mem_ctx;
+	DATA_BLOB	chunk;
+
+	local_mem_ctx = talloc_new(NULL);
+	if (!local_mem_ctx) {
+		return;
+	}
+
+	chunk = emsmdbp_stream_read_buffer(local_mem_ctx, stream, length);
+	if (chunk.length) {
+		/* The chunk may be released when the next one is produced */
+		transfer_buffer->data = talloc_realloc(mem_ctx, transfer_buffer->data, uint8_t, transfer_buffer->length + chunk.length);
+		memcpy(transfer_buffer->data + transfer_buffer->length, chunk.data, chunk.length);
+		transfer_buffer->length += chunk.length;
+
+		if (replay && emsmdbp_stream_replay_record(replay_ctx, replay, chunk) != MAPI_E_SUCCESS) {
+			OC_DEBUG(1, "Unable to record %zu bytes of the synchronization stream\n", chunk.length);
+		}
+	}
+
+	talloc_free(local_mem_ctx);
+}
+
+/**
+   \details Fill a transfer buffer from the content synchronization
+   stream, producing new chunks on demand until the requested size is
+   reached or the stream ends. Buffers are only cut at cutmarks within a
+   chunk, chunks themselves always end on a message boundary.
+
+   Data of a dropped chained response is read back from the replay
+   stream first. While a chained response is pending (replay_retain),
+   the data handed out is recorded in the replay stream.
+
+   \return true if the end of the stream was reached, false otherwise
+ */
+static bool oxcfxics_read_synccontext_contents(DATA_BLOB *transfer_buffer, uint32_t request_buffer_size, TALLOC_CTX *mem_ctx, struct emsmdbp_object_synccontext *synccontext, const char *owner, struct emsmdbp_object *parent_object)
+{
+	uint32_t		remaining = request_buffer_size;
+	size_t			available;
+	struct emsmdbp_stream	*replay = NULL;
+
+	transfer_buffer->data = NULL;
+	transfer_buffer->length = 0;
+
+	available = synccontext->replay.buffer.length - synccontext->replay.position;
+	if (available) {
+		OC_DEBUG(5, "content mode: replaying %zu bytes\n", available);
+		if (available > remaining) {
+			available = remaining;
+		}
+		oxcfxics_append_transfer_buffer(mem_ctx, transfer_buffer, &synccontext->replay, available, NULL, NULL);
+		remaining -= available;
+	}
+	if (synccontext->replay_retain) {
+		replay = &synccontext->replay;
+	}
+	else if (synccontext->replay.position == synccontext->replay.buffer.length) {
+		emsmdbp_stream_reset(&synccontext->replay);
+	}
+	if (synccontext->replay.position < synccontext->replay.buffer.length) {
+		return false;
+	}
+
+	while (true) {
+		available = synccontext->stream.buffer.length - synccontext->stream.position;
+		if (available > remaining) {
+			/* the current chunk has not been "emptied" yet */
+			oxcfxics_append_transfer_buffer(mem_ctx, transfer_buffer, &synccontext->stream,
+							oxcfxics_advance_cutmarks(synccontext, remaining),
+							synccontext, replay);
+			return false;
+		}
+
+		/* we reach the end of the current chunk */
+		if (available) {
+			oxcfxics_append_transfer_buffer(mem_ctx, transfer_buffer, &synccontext->stream, available,
+							synccontext, replay);
+			remaining -= available;
+		}
+
+		if (synccontext->sync_stage == 4) {
+			return true;
+		}
+		if (!remaining) {
+			return false;
+		}
+
+		OC_DEBUG(5, "content mode, stage %d: producing %u bytes\n", synccontext->sync_stage, remaining);
+		oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object, remaining);
+		oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
+	}
+}
+
 static inline void oxcfxics_fill_synccontext_fasttransfer_response(struct FastTransferSourceGetBuffer_repl *response, uint32_t request_buffer_size, TALLOC_CTX *mem_ctx, struct emsmdbp_object_synccontext *synccontext, struct emsmdbp_object *parent_object)
 {
 	char		*owner;
-	size_t		old_chunk_size, new_chunk_size;
 	uint32_t	buffer_size;
 	bool		end_of_buffer = false;
-	DATA_BLOB	joint_buffer;
 
 	owner = emsmdbp_get_owner(parent_object);
 
 	OC_DEBUG(5, "start syncstream: position = %zu, size = %zu\n", synccontext->stream.position, synccontext->stream.buffer.length);
-	if (synccontext->stream.position + request_buffer_size < synccontext->stream.buffer.length) {
+	if (synccontext->request.contents_mode) {
+		end_of_buffer = oxcfxics_read_synccontext_contents(&response->TransferBuffer, request_buffer_size, mem_ctx, synccontext, owner, parent_object);
+	}
+	else if (synccontext->stream.position + request_buffer_size < synccontext->stream.buffer.length) {
 		/* the current chunk has not been "emptied" yet */
 		buffer_size = oxcfxics_advance_cutmarks(synccontext, request_buffer_size);
-		response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, buffer_size);
+		response->TransferBuffer = emsmdbp_stream_read_buffer(mem_ctx, &synccontext->stream, buffer_size);
 	}
 	else {
-		/* the current chunk not does exist or we reached its end */
-		if (synccontext->request.contents_mode) {
-			OC_DEBUG(5, "content mode, stage %d\n", synccontext->sync_stage);
-			if (synccontext->sync_stage == 4) {
-				/* the last chunk was the last one */
-				end_of_buffer = true;
-				response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, request_buffer_size);
-			}
-			else if (synccontext->sync_stage == 0) {
-				/* no chunk sent yet, so we create a new one */
-				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
-				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
-				if (request_buffer_size < synccontext->stream.buffer.length) {
-					buffer_size = oxcfxics_advance_cutmarks(synccontext, request_buffer_size);
-				}
-				else {
-					buffer_size = request_buffer_size;
-					if (synccontext->sync_stage == 4) {
-						end_of_buffer = true;
-					}
-					else {
-						abort();
-					}
-				}
-				response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, buffer_size);
-			}
-			else {
-				/* we have reached the end of a middle chunk, we must thus finish it and complete the buffer with the content of the next chunk */
-				old_chunk_size = synccontext->stream.buffer.length - synccontext->stream.position;
-
-				if (old_chunk_size > 0) {
-					joint_buffer.length = old_chunk_size;
-					joint_buffer.data = talloc_memdup(mem_ctx, synccontext->stream.buffer.data + synccontext->stream.position, joint_buffer.length);
-				}
-
-				oxcfxics_fill_synccontext_with_messageChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
-				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
-
-				new_chunk_size = request_buffer_size - old_chunk_size;
-				if (synccontext->stream.buffer.length < new_chunk_size) {
-					new_chunk_size = synccontext->stream.buffer.length;
-					if (synccontext->sync_stage == 4) {
-						end_of_buffer = true;
-					}
-					else {
-						abort();
-					}
-				}
-				else {
-					new_chunk_size = oxcfxics_advance_cutmarks(synccontext, new_chunk_size);
-				}
-
-				if (new_chunk_size > 0) {
-					if (old_chunk_size) {
-						joint_buffer.length += new_chunk_size;
-						joint_buffer.data = talloc_realloc(mem_ctx, joint_buffer.data, uint8_t, joint_buffer.length);
-						memcpy(joint_buffer.data + old_chunk_size, synccontext->stream.buffer.data, new_chunk_size);
-						synccontext->stream.position += new_chunk_size;
-					}
-					else {
-						joint_buffer = emsmdbp_stream_read_buffer(&synccontext->stream, new_chunk_size);
-					}
-				}
-				response->TransferBuffer = joint_buffer;
-
-
-				OC_DEBUG(5, "joint buffers of sizes %zu and %zu\n", old_chunk_size, new_chunk_size);
-			}
+		buffer_size = request_buffer_size;
+		if (synccontext->stream.buffer.data) {
+			end_of_buffer = true;
 		}
 		else {
-			buffer_size = request_buffer_size;
-			if (synccontext->stream.buffer.data) {
-				end_of_buffer = true;
-			}
-			else {
-				oxcfxics_prepare_synccontext_with_folderChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
-				oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
-				OC_DEBUG(5, "synccontext buffer is %u bytes long\n", (uint32_t) synccontext->stream.buffer.length);
-			}
-			response->TransferBuffer = emsmdbp_stream_read_buffer(&synccontext->stream, buffer_size);
+			oxcfxics_prepare_synccontext_with_folderChange(synccontext, mem_ctx, parent_object->emsmdbp_ctx, owner, parent_object);
+			oxcfxics_check_cutmark_buffer(synccontext->cutmarks, &synccontext->stream.buffer);
+			OC_DEBUG(5, "synccontext buffer is %u bytes long\n", (uint32_t) synccontext->stream.buffer.length);
+		}
+		response->TransferBuffer = emsmdbp_stream_read_buffer(mem_ctx, &synccontext->stream, buffer_size);
 
-			if (synccontext->stream.position == synccontext->stream.buffer.length) {
-				end_of_buffer = true;
-			}
+		if (synccontext->stream.position == synccontext->stream.buffer.length) {
+			end_of_buffer = true;
 		}
 	}
 
@@ -2287,7 +2377,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncImportMessageChange(TALLOC_CTX *mem_ctx,
 
 	folderID = synccontext_object->parent_object->object.folder->folderID;
 	owner = emsmdbp_get_owner(synccontext_object);
-	retval = openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, owner, &repl_id, &replica_guid);
+	retval = emsmdbp_get_mailbox_replica(emsmdbp_ctx, owner, &repl_id, &replica_guid);
 	if (retval != MAPI_E_SUCCESS) {
 		OC_DEBUG(5, "Impossible to get %s mailbox replica guid", owner);
 		mapi_repl->error_code = MAPI_E_CALL_FAILED;
@@ -2417,7 +2507,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncImportHierarchyChange(TALLOC_CTX *mem_ct
 	response = &mapi_repl->u.mapi_SyncImportHierarchyChange;
 
 	owner = emsmdbp_get_owner(synccontext_object);
-	retval = openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, owner, &repl_id, &replica_guid);
+	retval = emsmdbp_get_mailbox_replica(emsmdbp_ctx, owner, &repl_id, &replica_guid);
 	if (retval != MAPI_E_SUCCESS) {
 		OC_DEBUG(5, "Impossible to get %s mailbox replica guid", owner);
 		mapi_repl->error_code = MAPI_E_CALL_FAILED;
@@ -2595,7 +2685,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncImportDeletes(TALLOC_CTX *mem_ctx,
 	}
 
 	owner = emsmdbp_get_owner(synccontext_object);
-	retval = openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, owner, &repl_id, &replica_guid);
+	retval = emsmdbp_get_mailbox_replica(emsmdbp_ctx, owner, &repl_id, &replica_guid);
 	if (retval != MAPI_E_SUCCESS) {
 		OC_DEBUG(5, "Impossible to get %s mailbox replica guid", owner);
 		mapi_repl->error_code = MAPI_E_CALL_FAILED;
@@ -2767,8 +2857,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamBegin(TALLOC_CTX *mem_c
 	}
 
 	synccontext_object->object.synccontext->state_property = property;
-	memset(&synccontext_object->object.synccontext->state_stream, 0, sizeof(struct emsmdbp_stream));
-	synccontext_object->object.synccontext->state_stream.buffer.data = talloc_zero(synccontext_object->object.synccontext, uint8_t);
+	emsmdbp_stream_reset(&synccontext_object->object.synccontext->state_stream);
 
 end:
 	*size += libmapiserver_RopSyncUploadStateStreamBegin_size(mapi_repl);
@@ -2840,9 +2929,9 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamContinue(TALLOC_CTX *me
 	request = &mapi_req->u.mapi_SyncUploadStateStreamContinue;
 	new_data.length = request->StreamDataSize;
 	new_data.data = request->StreamData;
-	emsmdbp_stream_write_buffer(synccontext_object->object.synccontext,
-				    &synccontext_object->object.synccontext->state_stream,
-				    new_data);
+	mapi_repl->error_code = emsmdbp_stream_write_buffer(synccontext_object->object.synccontext,
+							    &synccontext_object->object.synccontext->state_stream,
+							    new_data);
 
 end:
 	*size += libmapiserver_RopSyncUploadStateStreamContinue_size(mapi_repl);
@@ -2911,6 +3000,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamEnd(TALLOC_CTX *mem_ctx
 	struct emsmdbp_object			*synccontext_object;
 	struct emsmdbp_object_synccontext	*synccontext;
 	struct idset				*parsed_idset, *old_idset = NULL;
+	DATA_BLOB				state_buffer;
 	enum MAPISTATUS				retval;
 	void					*data = NULL;
 
@@ -2955,7 +3045,12 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamEnd(TALLOC_CTX *mem_ctx
 
 	/* parse IDSET */
 	synccontext = synccontext_object->object.synccontext;
-	parsed_idset = IDSET_parse(synccontext, synccontext->state_stream.buffer, false);
+	retval = emsmdbp_stream_map(mem_ctx, &synccontext->state_stream, &state_buffer);
+	if (retval != MAPI_E_SUCCESS) {
+		mapi_repl->error_code = retval;
+		goto reset;
+	}
+	parsed_idset = IDSET_parse(synccontext, state_buffer, false);
 
 	retval = IDSET_check_ranges(parsed_idset);
 	if (retval != MAPI_E_SUCCESS) {
@@ -3014,11 +3109,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncUploadStateStreamEnd(TALLOC_CTX *mem_ctx
 
 reset:
 	/* reset synccontext state */
-	if (synccontext->state_stream.buffer.length > 0) {
-		talloc_free(synccontext->state_stream.buffer.data);
-		synccontext->state_stream.buffer.data = talloc_zero(synccontext, uint8_t);
-		synccontext->state_stream.buffer.length = 0;
-	}
+	emsmdbp_stream_reset(&synccontext->state_stream);
 
 	synccontext->state_property = 0;
 
@@ -3420,7 +3511,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopSyncImportReadStateChanges(TALLOC_CTX *mem_c
 
 	request = &mapi_req->u.mapi_SyncImportReadStateChanges;
 
-	retval = openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, emsmdbp_get_owner(synccontext_object), NULL, &replica_guid);
+	retval = emsmdbp_get_mailbox_replica(emsmdbp_ctx, emsmdbp_get_owner(synccontext_object), NULL, &replica_guid);
 	if (retval != MAPI_E_SUCCESS) {
 		OC_DEBUG(5, "Impossible to get %s mailbox replica guid", emsmdbp_get_owner(synccontext_object));
 		mapi_repl->error_code = MAPI_E_CALL_FAILED;
@@ -3669,7 +3760,7 @@ static enum MAPISTATUS oxcfxics_ndr_push_transfer_state(struct ndr_push *ndr, co
 
 	sync_data = talloc_zero(mem_ctx, struct oxcfxics_sync_data);
 	OPENCHANGE_RETVAL_IF(!sync_data, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
-	retval = openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, owner, NULL, &sync_data->replica_guid);
+	retval = emsmdbp_get_mailbox_replica(emsmdbp_ctx, owner, NULL, &sync_data->replica_guid);
 	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, mem_ctx);
 	sync_data->prop_index.eid = 0;
 	sync_data->prop_index.change_number = 1;
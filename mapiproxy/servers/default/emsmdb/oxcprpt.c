@@ -743,7 +743,7 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopReadStream(TALLOC_CTX *mem_ctx,
 		}
 	}
 
-        mapi_repl->u.mapi_ReadStream.data = emsmdbp_stream_read_buffer(&object->object.stream->stream, buffer_size);
+        mapi_repl->u.mapi_ReadStream.data = emsmdbp_stream_read_buffer(mem_ctx, &object->object.stream->stream, buffer_size);
 
 end:
 	*size += libmapiserver_RopReadStream_size(mapi_repl);
@@ -818,7 +818,11 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopWriteStream(TALLOC_CTX *mem_ctx,
 
 	request = &mapi_req->u.mapi_WriteStream;
 	if (request->data.length > 0) {
-                emsmdbp_stream_write_buffer(object->object.stream, &object->object.stream->stream, request->data);
+		retval = emsmdbp_stream_write_buffer(object->object.stream, &object->object.stream->stream, request->data);
+		if (retval != MAPI_E_SUCCESS) {
+			mapi_repl->error_code = retval;
+			goto end;
+		}
 		mapi_repl->u.mapi_WriteStream.WrittenSize = request->data.length;
 	}
 
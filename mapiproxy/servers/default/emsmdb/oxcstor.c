@@ -109,9 +109,9 @@ static enum MAPISTATUS RopLogon_Mailbox(TALLOC_CTX *mem_ctx,
 	openchangedb_get_MailboxGuid(emsmdbp_ctx->oc_ctx, username, &response->LogonType.store_mailbox.MailboxGuid);
 
 	/* Step 7. Retrieve mailbox replication information */
-	openchangedb_get_MailboxReplica(emsmdbp_ctx->oc_ctx, username,
-					&response->LogonType.store_mailbox.ReplId,
-					&response->LogonType.store_mailbox.ReplGUID);
+	emsmdbp_get_mailbox_replica(emsmdbp_ctx, username,
+				    &response->LogonType.store_mailbox.ReplId,
+				    &response->LogonType.store_mailbox.ReplGUID);
 
 	/* Step 8. Set LogonTime both in openchange dispatcher database and reply */
 	t = time(NULL);
@@ -383,6 +383,15 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopQueryRows(TALLOC_CTX *mem_ctx,
 	uint32_t			handle;
 	uint16_t			flags = 0;
 	int64_t			        i = 0, end;
+	int				mid_index = -1;
+	uint16_t			j;
+	struct UI8Array_r		mids = { 0, NULL };
+	TALLOC_CTX			*window_ctx = NULL;
+	void				**window_cells = NULL;
+	enum MAPISTATUS			*window_retvals = NULL;
+	uint32_t			window_start = 0;
+	uint32_t			window_count = 0;
+	uint32_t			cell;
 
 	OC_DEBUG(4, "exchange_emsmdb: [OXCTABL] QueryRows (0x15)\n");
 
@@ -472,22 +481,72 @@ _PUBLIC_ enum MAPISTATUS EcDoRpc_RopQueryRows(TALLOC_CTX *mem_ctx,
 			break;
 		}
 	} else {
+		/* Fetch the whole window at once for openchangedb tables */
+		if (request->ForwardRead && end > table->numerator) {
+			window_start = table->numerator;
+			window_count = end - table->numerator;
+		} else if (!request->ForwardRead && table->numerator < table->denominator) {
+			window_start = end + 1;
+			window_count = table->numerator - end;
+		}
+		if (window_count) {
+			window_ctx = talloc_new(mem_ctx);
+			if (window_ctx && emsmdbp_object_table_fetch_rows(window_ctx, emsmdbp_ctx, object,
+									  window_start, window_count,
+									  MAPISTORE_PREFILTERED_QUERY,
+									  &window_cells, &window_retvals,
+									  &window_count) != MAPI_E_SUCCESS) {
+				window_cells = NULL;
+				window_count = 0;
+			}
+		}
+
+		/* Clients usually open the messages they have just listed:
+		   collect their mids for the prefetch engine */
+		if (emsmdbp_is_mapistore(object) &&
+		    (table->ulType == MAPISTORE_MESSAGE_TABLE || table->ulType == MAPISTORE_FAI_TABLE)) {
+			for (j = 0; j < table->prop_count; j++) {
+				if (table->properties[j] == PidTagMid) {
+					mid_index = j;
+					mids.lpui8 = talloc_array(mem_ctx, uint64_t, request->RowCount);
+					break;
+				}
+			}
+		}
+
 		i = table->numerator;
 		while (i != end) {
-			data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, emsmdbp_ctx, object, i, MAPISTORE_PREFILTERED_QUERY, &retvals);
+			if (window_cells && i >= window_start && i < window_start + window_count) {
+				cell = (i - window_start) * table->prop_count;
+				data_pointers = emsmdbp_object_table_get_fetched_row_props(mem_ctx, emsmdbp_ctx, object, i, MAPISTORE_PREFILTERED_QUERY,
+											   window_cells + cell, window_retvals + cell, &retvals);
+			} else {
+				data_pointers = emsmdbp_object_table_get_row_props(mem_ctx, emsmdbp_ctx, object, i, MAPISTORE_PREFILTERED_QUERY, &retvals);
+			}
 			if (data_pointers) {
 				emsmdbp_fill_table_row_blob(mem_ctx, emsmdbp_ctx,
 							    &response->RowData, table->prop_count,
 							    table->properties, data_pointers, retvals);
+				if (mids.lpui8 && retvals[mid_index] == MAPI_E_SUCCESS) {
+					mids.lpui8[mids.cValues++] = *(uint64_t *) data_pointers[mid_index];
+				}
 				talloc_free(retvals);
 				talloc_free(data_pointers);
 				count++;
 			} else {
 				count = 0;
+				talloc_free(window_ctx);
 				goto finish;
 			}
 			i = (request->ForwardRead) ? i + 1 : i - 1;
 		}
+		talloc_free(window_ctx);
+
+		if (mids.cValues) {
+			mapistore_prefetch_hint(emsmdbp_ctx->mstore_ctx, emsmdbp_get_contextID(object),
+						object->parent_object->backend_object, table->ulType, &mids);
+		}
+		talloc_free(mids.lpui8);
 	}
 
 finish:
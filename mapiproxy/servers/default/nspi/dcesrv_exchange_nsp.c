@@ -439,26 +439,40 @@ static void dcesrv_do_NspiQueryRows(TALLOC_CTX *mem_ctx, struct NspiQueryRows *r
 	/* Step 2. Fill ppRows  */
 	if (r->in.lpETable == NULL) {
 		/* Step 2.1 Fill ppRows for supplied Container ID */
-		struct ldb_result	*ldb_res;
-		uint32_t		start_pos;
-		uint32_t		last_row;
+		struct PropertyTagArray_r	*container_mids;
+		char				*filter_search;
+		uint32_t			start_pos;
+		uint32_t			last_row;
 
 		position_in_table(r->in.pStat, mids, &start_pos, &last_row);
-		retval = emsabp_ab_container_enum(mem_ctx, emsabp_ctx,
-						  r->in.pStat->ContainerID, &ldb_res);
-		if (retval != MAPI_E_SUCCESS)  {
+		retval = emsabp_ab_fetch_filter(mem_ctx, emsabp_ctx, r->in.pStat->ContainerID, &filter_search);
+		if (retval != MAPI_E_SUCCESS) {
+			retval = MAPI_E_INVALID_BOOKMARK;
 			goto failure;
 		}
-		if (ldb_res == NULL) {
+		if (filter_search == NULL) {
 			/* No elements in this container */
 			*r->out.ppRows = pRows;
 			DCESRV_NSP_RETURN(r, MAPI_E_SUCCESS, NULL);
 		}
 
+		/* Container entries sorted by display name, rows are
+		   only fetched for the requested slice */
+		container_mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+		if (container_mids == NULL) {
+			retval = MAPI_E_NOT_ENOUGH_MEMORY;
+			goto failure;
+		}
+		retval = emsabp_snapshot_fetch(mem_ctx, emsabp_ctx, filter_search, NULL, container_mids);
+		talloc_free(filter_search);
+		if (retval != MAPI_E_SUCCESS) {
+			goto failure;
+		}
+
 		if (r->in.pStat->Delta >= 0) {
 			start_pos = start_pos + r->in.pStat->Delta;
-			if (start_pos >= ldb_res->count) {
-				start_pos = ldb_res->count;
+			if (start_pos >= container_mids->cValues) {
+				start_pos = container_mids->cValues;
 			}
 		} else {
 			if (abs(r->in.pStat->Delta) > r->in.pStat->NumPos) {
@@ -468,7 +482,11 @@ static void dcesrv_do_NspiQueryRows(TALLOC_CTX *mem_ctx, struct NspiQueryRows *r
 			}
 		}
 
-		count = ldb_res->count - start_pos;
+		if (start_pos > container_mids->cValues) {
+			start_pos = container_mids->cValues;
+		}
+
+		count = container_mids->cValues - start_pos;
 		if (r->in.Count < count) {
 			count = r->in.Count;
 		}
@@ -483,8 +501,8 @@ static void dcesrv_do_NspiQueryRows(TALLOC_CTX *mem_ctx, struct NspiQueryRows *r
 
 			/* fetch required attributes for every entry found */
 			for (i = 0; i < count; i++) {
-				retval = emsabp_fetch_attrs_from_msg(mem_ctx, emsabp_ctx, pRows->aRow + i,
-								     ldb_res->msgs[start_pos+i], 0, r->in.dwFlags, pPropTags);
+				retval = emsabp_fetch_attrs(mem_ctx, emsabp_ctx, pRows->aRow + i,
+							    container_mids->aulPropTag[start_pos+i], r->in.dwFlags, pPropTags);
 				if (retval != MAPI_E_SUCCESS) {
 					goto failure;
 				}
@@ -500,7 +518,7 @@ static void dcesrv_do_NspiQueryRows(TALLOC_CTX *mem_ctx, struct NspiQueryRows *r
 			r_UpdateStat.in.pStat = r->in.pStat;
 			r_UpdateStat.in.pStat->Delta += pRows->cRows;
 			r_UpdateStat.in.plDelta = NULL;
-			r_UpdateStat.in.pStat->TotalRecs = ldb_res->count;
+			r_UpdateStat.in.pStat->TotalRecs = container_mids->cValues;
 			r_UpdateStat.out.pStat = r->out.pStat;
 			dcesrv_do_NspiUpdateStat(&r_UpdateStat, mids);
 			if (r_UpdateStat.out.result != MAPI_E_SUCCESS) {
@@ -615,6 +633,8 @@ static void dcesrv_NspiSeekEntries(struct dcesrv_call_state *dce_call, TALLOC_CT
 	struct emsabp_context		*emsabp_ctx = NULL;
 	uint32_t			row;
 	struct PropertyTagArray_r	*mids, *all_mids;
+	struct emsabp_snapshot		*snapshot = NULL;
+	const char			*target;
 	struct Restriction_r		*seek_restriction;
 	bool				container_exists;
 	struct NspiQueryRows		r_QueryRows;
@@ -665,41 +685,63 @@ static void dcesrv_NspiSeekEntries(struct dcesrv_call_state *dce_call, TALLOC_CT
 			goto failure;
 		}
 
-		retval = emsabp_search(mem_ctx, emsabp_ctx, all_mids, NULL, r->in.pStat, 0);
+		retval = emsabp_search_snapshot(mem_ctx, emsabp_ctx, all_mids, &snapshot);
 		if (retval != MAPI_E_SUCCESS) {
 			goto failure;
 		}
-	}
-
-	/* find the records matching the qualifier */
-	seek_restriction = talloc_zero(mem_ctx, struct Restriction_r);
-	if (seek_restriction == NULL) {
-		retval = MAPI_E_NOT_ENOUGH_MEMORY;
-		goto failure;
-	}
-	seek_restriction->rt = RES_PROPERTY;
-	seek_restriction->res.resProperty.relop = RELOP_GE;
-	seek_restriction->res.resProperty.ulPropTag = r->in.pTarget->ulPropTag;
-	seek_restriction->res.resProperty.lpProp = r->in.pTarget;
-
-	mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
-	if (mids == NULL) {
-		retval = MAPI_E_NOT_ENOUGH_MEMORY;
-		goto failure;
-	}
-	if (emsabp_search(mem_ctx, emsabp_ctx, mids, seek_restriction, r->in.pStat, 0) != MAPI_E_SUCCESS) {
-		mids = all_mids;
-		retval = MAPI_E_NOT_FOUND;
+		if (all_mids->cValues == 0) {
+			retval = MAPI_E_NOT_FOUND;
+			goto failure;
+		}
 	}
 
 	r->out.pStat->CurrentRec = MID_END_OF_TABLE;
 	r->out.pStat->NumPos = all_mids->cValues - 1;
 	r->out.pStat->TotalRecs = all_mids->cValues;
-	for (row = 0; row < all_mids->cValues; row++) {
-		if (all_mids->aulPropTag[row] == mids->aulPropTag[0]) {
-			r->out.pStat->CurrentRec = mids->aulPropTag[0];
+
+	if (snapshot && (r->in.pTarget->ulPropTag == PR_DISPLAY_NAME ||
+			 r->in.pTarget->ulPropTag == PR_DISPLAY_NAME_UNICODE)) {
+		/* all_mids is aligned with the display name sorted snapshot */
+		if (r->in.pTarget->ulPropTag == PR_DISPLAY_NAME) {
+			target = r->in.pTarget->value.lpszA;
+		} else {
+			target = r->in.pTarget->value.lpszW;
+		}
+		row = emsabp_snapshot_seek(snapshot, target);
+		if (row < all_mids->cValues) {
+			r->out.pStat->CurrentRec = all_mids->aulPropTag[row];
 			r->out.pStat->NumPos = row;
-			break;
+		} else {
+			retval = MAPI_E_NOT_FOUND;
+		}
+	} else {
+		/* find the records matching the qualifier */
+		seek_restriction = talloc_zero(mem_ctx, struct Restriction_r);
+		if (seek_restriction == NULL) {
+			retval = MAPI_E_NOT_ENOUGH_MEMORY;
+			goto failure;
+		}
+		seek_restriction->rt = RES_PROPERTY;
+		seek_restriction->res.resProperty.relop = RELOP_GE;
+		seek_restriction->res.resProperty.ulPropTag = r->in.pTarget->ulPropTag;
+		seek_restriction->res.resProperty.lpProp = r->in.pTarget;
+
+		mids = talloc_zero(mem_ctx, struct PropertyTagArray_r);
+		if (mids == NULL) {
+			retval = MAPI_E_NOT_ENOUGH_MEMORY;
+			goto failure;
+		}
+		if (emsabp_search(mem_ctx, emsabp_ctx, mids, seek_restriction, r->in.pStat, 0) != MAPI_E_SUCCESS) {
+			mids = all_mids;
+			retval = MAPI_E_NOT_FOUND;
+		}
+
+		for (row = 0; row < all_mids->cValues; row++) {
+			if (all_mids->aulPropTag[row] == mids->aulPropTag[0]) {
+				r->out.pStat->CurrentRec = mids->aulPropTag[0];
+				r->out.pStat->NumPos = row;
+				break;
+			}
 		}
 	}
 
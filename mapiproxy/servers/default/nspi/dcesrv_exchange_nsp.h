@@ -49,12 +49,43 @@ struct emsabp_context {
 	void			*ldb_ctx;
 	TDB_CONTEXT		*tdb_ctx;
 	TDB_CONTEXT		*ttdb_ctx;
+	struct emsabp_snapshot_view	*snapshot_views;
 	TALLOC_CTX		*mem_ctx;
 };
 
-struct emsabp_MId {
-	uint32_t	MId;
-	char		*dn;
+/**
+   Address Book entry recorded in a snapshot
+ */
+struct emsabp_snapshot_entry {
+	struct GUID		guid;		/* objectGUID, survives renames and deletion */
+	char			*dn;
+	char			*display_name;	/* sort key */
+};
+
+/**
+   Display name sorted snapshot of the entries matching a search
+   filter. Snapshots are shared by all the sessions of the process
+   and refreshed from the samdb USN.
+ */
+struct emsabp_snapshot {
+	char				*filter;
+	uint64_t			usn;		/* highestCommittedUSN the snapshot reflects */
+	uint32_t			generation;	/* bumped whenever entries change */
+	uint32_t			count;
+	struct emsabp_snapshot_entry	*entries;
+	struct emsabp_snapshot		*prev;
+	struct emsabp_snapshot		*next;
+};
+
+/**
+   Session MIds for a snapshot generation, aligned with its entries
+ */
+struct emsabp_snapshot_view {
+	struct emsabp_snapshot		*snapshot;
+	uint32_t			generation;
+	struct PropertyTagArray_r	MIds;
+	struct emsabp_snapshot_view	*prev;
+	struct emsabp_snapshot_view	*next;
 };
 
 /**
@@ -99,6 +130,8 @@ struct EphemeralEntryID {
 #define	EMSABP_TDB_MID_START		0x1b28
 #define	EMSABP_TDB_TMP_MID_START	0x5000
 #define	EMSABP_TDB_DATA_REC		"MId_index"
+#define	EMSABP_TDB_MID_DN_REC		"MId_dn_index"
+#define	EMSABP_TDB_MID_DN_PREFIX	"MId=0x"
 
 #define DCESRV_NSP_RETURN_IF(x,r,c,ctx)		\
 do {						\
@@ -147,10 +180,10 @@ enum MAPISTATUS		emsabp_fetch_attrs(TALLOC_CTX *, struct emsabp_context *, struc
 enum MAPISTATUS		emsabp_table_fetch_attrs(TALLOC_CTX *, struct emsabp_context *, struct PropertyRow_r *, uint32_t, struct PermanentEntryID *, 
 						 struct PermanentEntryID *, struct ldb_message *, bool);
 enum MAPISTATUS		emsabp_search(TALLOC_CTX *, struct emsabp_context *, struct PropertyTagArray_r *, struct Restriction_r *, struct STAT *, uint32_t);
+enum MAPISTATUS		emsabp_search_snapshot(TALLOC_CTX *, struct emsabp_context *, struct PropertyTagArray_r *, struct emsabp_snapshot **);
 enum MAPISTATUS		emsabp_search_dn(struct emsabp_context *, const char *, struct ldb_message **);
 enum MAPISTATUS		emsabp_search_legacyExchangeDN(struct emsabp_context *, const char *, struct ldb_message **, bool *);
 enum MAPISTATUS		emsabp_ab_fetch_filter(TALLOC_CTX *, struct emsabp_context *, uint32_t, char **);
-enum MAPISTATUS		emsabp_ab_container_enum(TALLOC_CTX *, struct emsabp_context *, uint32_t, struct ldb_result **);
 
 
 /* definitions from emsabp_tdb.c */
@@ -164,6 +197,10 @@ enum MAPISTATUS		emsabp_tdb_fetch_dn_from_MId(TALLOC_CTX *, TDB_CONTEXT *, uint3
 
 TDB_CONTEXT		*emsabp_tdb_init_tmp(TALLOC_CTX *);
 
+/* definitions from emsabp_snapshot.c */
+enum MAPISTATUS		emsabp_snapshot_fetch(TALLOC_CTX *, struct emsabp_context *, const char *, struct emsabp_snapshot **, struct PropertyTagArray_r *);
+uint32_t		emsabp_snapshot_seek(struct emsabp_snapshot *, const char *);
+
 /* definitions from emsabp_property.c */
 const char		*emsabp_property_get_attribute(uint32_t);
 uint32_t		emsabp_property_get_ulPropTag(const char *);
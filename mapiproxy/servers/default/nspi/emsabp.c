@@ -1106,6 +1106,39 @@ static enum MAPISTATUS emsabp_include_organization_restriction(struct emsabp_con
 }
 
 
+/* Filter matching every Address Book recipient */
+#define	EMSABP_RECIPIENTS_FILTER	"(&(objectClass=user)(displayName=*)(!(objectClass=computer)))"
+
+/**
+   \details Retrieve the display name sorted list of MIds for every
+   recipient of the organization, served from the Address Book
+   snapshot.
+
+   \param mem_ctx pointer to the memory context
+   \param emsabp_ctx pointer to the EMSABP context
+   \param MIds pointer to the list of MIds the function returns
+   \param snapshotp pointer on pointer to the snapshot the MIds are
+   aligned with, may be NULL
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_search_snapshot(TALLOC_CTX *mem_ctx, struct emsabp_context *emsabp_ctx,
+						struct PropertyTagArray_r *MIds,
+						struct emsabp_snapshot **snapshotp)
+{
+	enum MAPISTATUS		retval;
+	char			*search_filter = NULL;
+
+	retval = emsabp_include_organization_restriction(emsabp_ctx, EMSABP_RECIPIENTS_FILTER, &search_filter);
+	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
+
+	retval = emsabp_snapshot_fetch(mem_ctx, emsabp_ctx, search_filter, snapshotp, MIds);
+	talloc_free(search_filter);
+
+	return retval;
+}
+
+
 /**
    \details Search Active Directory given input search criterias. The
    function associates for each records returned by the search a
@@ -1141,6 +1174,15 @@ _PUBLIC_ enum MAPISTATUS emsabp_search(TALLOC_CTX *mem_ctx, struct emsabp_contex
 	struct ldb_server_sort_control	**ldb_sort_controls = NULL;
 	struct ldb_request		*ldb_req;
 
+	/* Unrestricted display name sorted searches use the snapshot */
+	if (!restriction && pStat->SortType == SortTypeDisplayName) {
+		retval = emsabp_search_snapshot(mem_ctx, emsabp_ctx, MIds, NULL);
+		OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, retval, NULL);
+		OPENCHANGE_RETVAL_IF(MIds->cValues == 0, MAPI_E_NOT_FOUND, NULL);
+		OPENCHANGE_RETVAL_IF(limit && MIds->cValues > limit, MAPI_E_TABLE_TOO_BIG, NULL);
+		return MAPI_E_SUCCESS;
+	}
+
 	local_mem_ctx = talloc_new(NULL);
 	OPENCHANGE_RETVAL_IF(local_mem_ctx == NULL, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
 
@@ -1187,7 +1229,7 @@ _PUBLIC_ enum MAPISTATUS emsabp_search(TALLOC_CTX *mem_ctx, struct emsabp_contex
 		}
 		OPENCHANGE_RETVAL_IF(fmt_str == NULL, MAPI_E_NOT_ENOUGH_MEMORY, local_mem_ctx);
 	} else {
-		fmt_str = talloc_strdup(local_mem_ctx, "(&(objectClass=user)(displayName=*)(!(objectClass=computer)))");
+		fmt_str = talloc_strdup(local_mem_ctx, EMSABP_RECIPIENTS_FILTER);
 		OPENCHANGE_RETVAL_IF(fmt_str == NULL, MAPI_E_NOT_ENOUGH_MEMORY, local_mem_ctx);
 		attr = NULL;
 	}
@@ -1382,80 +1424,3 @@ _PUBLIC_ enum MAPISTATUS emsabp_ab_fetch_filter(TALLOC_CTX *mem_ctx,
 	/* Add organization restriction */
 	return emsabp_include_organization_restriction(emsabp_ctx, purportedSearch, filter);
 }
-
-
-/**
-   \details Enumerate AB container entries
-
-   \param mem_ctx pointer to the memory context
-   \param emsabp_ctx pointer to the EMSABP context
-   \param ContainerID id of the container to fetch
-   \param ldb_resp pointer on pointer to the LDB result returned by the
-   function
-
-   \return MAPI_E_SUCCESS on success, otherwise MAPI error
- */
-_PUBLIC_ enum MAPISTATUS emsabp_ab_container_enum(TALLOC_CTX *mem_ctx,
-						  struct emsabp_context *emsabp_ctx,
-						  uint32_t ContainerID,
-						  struct ldb_result **ldb_resp)
-{
-	enum MAPISTATUS			retval;
-	int				ldb_ret;
-	struct ldb_request		*ldb_req;
-	struct ldb_result		*ldb_res;
-	char				*filter_search;
-	const char * const		recipient_attrs[] = { "*", NULL };
-	struct ldb_server_sort_control	**ldb_sort_controls;
-
-	/* Fetch AB container record */
-	retval = emsabp_ab_fetch_filter(mem_ctx, emsabp_ctx, ContainerID, &filter_search);
-	OPENCHANGE_RETVAL_IF(retval != MAPI_E_SUCCESS, MAPI_E_INVALID_BOOKMARK, NULL);
-	if (filter_search == NULL) {
-		/* this container is not meant to have entries */
-		*ldb_resp = NULL;
-		return MAPI_E_SUCCESS;
-	}
-
-	/* Search AD with filter_search */
-	ldb_res = talloc_zero(mem_ctx, struct ldb_result);
-	OPENCHANGE_RETVAL_IF(!ldb_res, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
-
-	ldb_req = NULL;
-	ldb_ret = ldb_build_search_req(&ldb_req, emsabp_ctx->samdb_ctx, mem_ctx,
-				       ldb_get_default_basedn(emsabp_ctx->samdb_ctx),
-				       LDB_SCOPE_SUBTREE,
-				       filter_search,
-				       recipient_attrs,
-				       NULL,
-				       ldb_res,
-				       ldb_search_default_callback,
-				       NULL);
-	if (ldb_ret != LDB_SUCCESS) goto done;
-
-	ldb_sort_controls = talloc_zero_array(filter_search, struct ldb_server_sort_control *, 2);
-	ldb_sort_controls[0] = talloc_zero(ldb_sort_controls, struct ldb_server_sort_control);
-	ldb_sort_controls[0]->attributeName = talloc_strdup(ldb_sort_controls, "displayName");
-	ldb_request_add_control(ldb_req, LDB_CONTROL_SERVER_SORT_OID, false, ldb_sort_controls);
-
-	ldb_ret = ldb_request(emsabp_ctx->samdb_ctx, ldb_req);
-
-	if (ldb_ret == LDB_SUCCESS) {
-		ldb_ret = ldb_wait(ldb_req->handle, LDB_WAIT_ALL);
-	}
-
-done:
-	talloc_free(filter_search);
-	if (ldb_req) {
-		talloc_free(ldb_req);
-	}
-
-	if (ldb_ret != LDB_SUCCESS) {
-		talloc_free(ldb_res);
-		ldb_res = NULL;
-	}
-
-	*ldb_resp = ldb_res;
-
-	return (ldb_ret != LDB_SUCCESS) ? MAPI_E_NOT_FOUND : MAPI_E_SUCCESS;
-}
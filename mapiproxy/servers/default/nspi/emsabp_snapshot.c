@@ -0,0 +1,500 @@
+/*
+   OpenChange Server implementation.
+
+   EMSABP: Address Book Provider implementation
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   \file emsabp_snapshot.c
+
+   \brief Display name sorted snapshots of the Address Book
+
+   Browsing the Address Book (NspiUpdateStat, NspiQueryRows,
+   NspiSeekEntries) used to search and sort the whole directory on
+   every call. Snapshots keep, per search filter, the matching entries
+   sorted by display name. They are shared by every session of the
+   process and refreshed incrementally: entries changed since the last
+   known highestCommittedUSN are removed, including deleted objects,
+   then the ones still matching the filter are added back.
+*/
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "dcesrv_exchange_nsp.h"
+#include "ldb.h"
+
+/* Above this number of changed entries, rebuild the snapshot */
+#define	EMSABP_SNAPSHOT_MAX_DELTA	1024
+
+/* Snapshots shared by all emsabp contexts */
+static struct emsabp_snapshot	*snapshots = NULL;
+
+static int emsabp_snapshot_entry_cmp(const void *a, const void *b)
+{
+	const struct emsabp_snapshot_entry	*ea = (const struct emsabp_snapshot_entry *) a;
+	const struct emsabp_snapshot_entry	*eb = (const struct emsabp_snapshot_entry *) b;
+	int					ret;
+
+	ret = strcasecmp(ea->display_name, eb->display_name);
+	if (ret) return ret;
+
+	return strcasecmp(ea->dn, eb->dn);
+}
+
+static int emsabp_snapshot_guid_cmp(const void *a, const void *b)
+{
+	return GUID_compare((const struct GUID *) a, (const struct GUID *) b);
+}
+
+/**
+   \details Retrieve the highest USN committed to samdb
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param usn pointer to the USN returned by the function
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_snapshot_get_usn(struct emsabp_context *emsabp_ctx, uint64_t *usn)
+{
+	TALLOC_CTX		*mem_ctx;
+	const char * const	attrs[] = { "highestCommittedUSN", NULL };
+	struct ldb_result	*res = NULL;
+	int			ret;
+
+	mem_ctx = talloc_new(NULL);
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	ret = ldb_search(emsabp_ctx->samdb_ctx, mem_ctx, &res,
+			 ldb_dn_new(mem_ctx, emsabp_ctx->samdb_ctx, NULL),
+			 LDB_SCOPE_BASE, attrs, NULL);
+	OPENCHANGE_RETVAL_IF(ret != LDB_SUCCESS || res->count != 1, MAPI_E_NOT_FOUND, mem_ctx);
+
+	*usn = ldb_msg_find_attr_as_uint64(res->msgs[0], "highestCommittedUSN", 0);
+	talloc_free(mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Search the default naming context
+
+   \param mem_ctx pointer to the memory context
+   \param emsabp_ctx pointer to the EMSABP context
+   \param filter the LDB search filter
+   \param attrs the attributes to retrieve
+   \param show_deleted whether deleted objects should be returned
+   \param resp pointer on pointer to the LDB result returned by the
+   function
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_snapshot_search(TALLOC_CTX *mem_ctx, struct emsabp_context *emsabp_ctx,
+					      const char *filter, const char * const *attrs,
+					      bool show_deleted, struct ldb_result **resp)
+{
+	struct ldb_request	*ldb_req = NULL;
+	struct ldb_result	*ldb_res;
+	int			ldb_ret;
+
+	ldb_res = talloc_zero(mem_ctx, struct ldb_result);
+	OPENCHANGE_RETVAL_IF(!ldb_res, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	ldb_ret = ldb_build_search_req(&ldb_req, emsabp_ctx->samdb_ctx, mem_ctx,
+				       ldb_get_default_basedn(emsabp_ctx->samdb_ctx),
+				       LDB_SCOPE_SUBTREE, filter, attrs, NULL,
+				       ldb_res, ldb_search_default_callback, NULL);
+	OPENCHANGE_RETVAL_IF(ldb_ret != LDB_SUCCESS, MAPI_E_NOT_FOUND, ldb_res);
+
+	if (show_deleted) {
+		ldb_request_add_control(ldb_req, LDB_CONTROL_SHOW_DELETED_OID, false, NULL);
+	}
+
+	ldb_ret = ldb_request(emsabp_ctx->samdb_ctx, ldb_req);
+	if (ldb_ret == LDB_SUCCESS) {
+		ldb_ret = ldb_wait(ldb_req->handle, LDB_WAIT_ALL);
+	}
+	talloc_free(ldb_req);
+	OPENCHANGE_RETVAL_IF(ldb_ret != LDB_SUCCESS, MAPI_E_NOT_FOUND, ldb_res);
+
+	*resp = ldb_res;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Append the entries of a LDB result to a snapshot. Records
+   without objectGUID or distinguishedName are skipped.
+
+   \param snapshot pointer to the snapshot
+   \param res pointer to the LDB result
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_snapshot_append(struct emsabp_snapshot *snapshot, struct ldb_result *res)
+{
+	struct emsabp_snapshot_entry	*entries;
+	struct emsabp_snapshot_entry	*entry;
+	const struct ldb_val		*guid;
+	const char			*dn;
+	const char			*display_name;
+	uint32_t			i;
+
+	if (!res->count) return MAPI_E_SUCCESS;
+
+	if (snapshot->entries) {
+		entries = talloc_realloc(snapshot, snapshot->entries, struct emsabp_snapshot_entry,
+					 snapshot->count + res->count);
+	} else {
+		entries = talloc_array(snapshot, struct emsabp_snapshot_entry, res->count);
+	}
+	OPENCHANGE_RETVAL_IF(!entries, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+	snapshot->entries = entries;
+
+	for (i = 0; i < res->count; i++) {
+		guid = ldb_msg_find_ldb_val(res->msgs[i], "objectGUID");
+		dn = ldb_msg_find_attr_as_string(res->msgs[i], "distinguishedName", NULL);
+		display_name = ldb_msg_find_attr_as_string(res->msgs[i], "displayName", "");
+		if (!guid || !dn) continue;
+
+		entry = &entries[snapshot->count];
+		if (!NT_STATUS_IS_OK(GUID_from_data_blob(guid, &entry->guid))) continue;
+
+		/* Strings hang from the array so a rebuild releases them at once */
+		entry->dn = talloc_strdup(entries, dn);
+		OPENCHANGE_RETVAL_IF(!entry->dn, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		entry->display_name = talloc_strdup(entry->dn, display_name);
+		OPENCHANGE_RETVAL_IF(!entry->display_name, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		snapshot->count++;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Rebuild a snapshot from scratch
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param snapshot pointer to the snapshot to rebuild
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_snapshot_build(struct emsabp_context *emsabp_ctx,
+					     struct emsabp_snapshot *snapshot)
+{
+	TALLOC_CTX		*mem_ctx;
+	enum MAPISTATUS		retval;
+	const char * const	attrs[] = { "objectGUID", "distinguishedName", "displayName", NULL };
+	struct ldb_result	*res = NULL;
+
+	mem_ctx = talloc_new(NULL);
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	retval = emsabp_snapshot_search(mem_ctx, emsabp_ctx, snapshot->filter, attrs, false, &res);
+	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+
+	talloc_free(snapshot->entries);
+	snapshot->entries = NULL;
+	snapshot->count = 0;
+
+	retval = emsabp_snapshot_append(snapshot, res);
+	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+
+	if (snapshot->count) {
+		qsort(snapshot->entries, snapshot->count, sizeof (struct emsabp_snapshot_entry),
+		      emsabp_snapshot_entry_cmp);
+	}
+	snapshot->generation++;
+
+	OC_DEBUG(5, "[nspi] snapshot built with %u entries for %s", snapshot->count, snapshot->filter);
+	talloc_free(mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Apply the changes committed since the snapshot USN
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param snapshot pointer to the snapshot to update
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_snapshot_update(struct emsabp_context *emsabp_ctx,
+					      struct emsabp_snapshot *snapshot)
+{
+	TALLOC_CTX			*mem_ctx;
+	enum MAPISTATUS			retval;
+	const char * const		guid_attrs[] = { "objectGUID", NULL };
+	const char * const		attrs[] = { "objectGUID", "distinguishedName", "displayName", NULL };
+	struct ldb_result		*res = NULL;
+	const struct ldb_val		*val;
+	struct GUID			*changed;
+	uint32_t			changed_count;
+	char				*filter;
+	uint32_t			i;
+	uint32_t			j;
+
+	mem_ctx = talloc_new(NULL);
+	OPENCHANGE_RETVAL_IF(!mem_ctx, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	/* Step 1. Retrieve every object changed or deleted since the snapshot */
+	filter = talloc_asprintf(mem_ctx, "(uSNChanged>=%"PRIu64")", snapshot->usn + 1);
+	OPENCHANGE_RETVAL_IF(!filter, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	retval = emsabp_snapshot_search(mem_ctx, emsabp_ctx, filter, guid_attrs, true, &res);
+	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+	if (!res->count) {
+		talloc_free(mem_ctx);
+		return MAPI_E_SUCCESS;
+	}
+
+	if (res->count > EMSABP_SNAPSHOT_MAX_DELTA) {
+		talloc_free(mem_ctx);
+		return emsabp_snapshot_build(emsabp_ctx, snapshot);
+	}
+
+	changed = talloc_array(mem_ctx, struct GUID, res->count);
+	OPENCHANGE_RETVAL_IF(!changed, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+	for (changed_count = 0, i = 0; i < res->count; i++) {
+		val = ldb_msg_find_ldb_val(res->msgs[i], "objectGUID");
+		if (val && NT_STATUS_IS_OK(GUID_from_data_blob(val, &changed[changed_count]))) {
+			changed_count++;
+		}
+	}
+	qsort(changed, changed_count, sizeof (struct GUID), emsabp_snapshot_guid_cmp);
+
+	/* Step 2. Drop their current entries */
+	for (i = 0, j = 0; i < snapshot->count; i++) {
+		if (bsearch(&snapshot->entries[i].guid, changed, changed_count,
+			    sizeof (struct GUID), emsabp_snapshot_guid_cmp)) {
+			talloc_free(snapshot->entries[i].dn);
+			continue;
+		}
+		if (i != j) {
+			snapshot->entries[j] = snapshot->entries[i];
+		}
+		j++;
+	}
+	snapshot->count = j;
+
+	/* Step 3. Add back the ones still matching the filter */
+	filter = talloc_asprintf(mem_ctx, "(&(uSNChanged>=%"PRIu64")%s)", snapshot->usn + 1, snapshot->filter);
+	OPENCHANGE_RETVAL_IF(!filter, MAPI_E_NOT_ENOUGH_MEMORY, mem_ctx);
+
+	retval = emsabp_snapshot_search(mem_ctx, emsabp_ctx, filter, attrs, false, &res);
+	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+
+	retval = emsabp_snapshot_append(snapshot, res);
+	OPENCHANGE_RETVAL_IF(retval, retval, mem_ctx);
+
+	if (snapshot->count) {
+		qsort(snapshot->entries, snapshot->count, sizeof (struct emsabp_snapshot_entry),
+		      emsabp_snapshot_entry_cmp);
+	}
+	snapshot->generation++;
+
+	OC_DEBUG(5, "[nspi] snapshot updated with %u changes, %u entries for %s",
+		 changed_count, snapshot->count, snapshot->filter);
+	talloc_free(mem_ctx);
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Retrieve the snapshot associated to a search filter and
+   bring it up to date with samdb
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param filter the LDB search filter
+   \param snapshotp pointer on pointer to the snapshot returned by the
+   function
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_snapshot_refresh(struct emsabp_context *emsabp_ctx, const char *filter,
+					       struct emsabp_snapshot **snapshotp)
+{
+	enum MAPISTATUS		retval;
+	struct emsabp_snapshot	*snapshot;
+	uint64_t		usn;
+
+	/* The USN is read first so changes committed while we search are
+	   applied again on the next refresh */
+	retval = emsabp_snapshot_get_usn(emsabp_ctx, &usn);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	for (snapshot = snapshots; snapshot; snapshot = snapshot->next) {
+		if (!strcmp(snapshot->filter, filter)) break;
+	}
+
+	if (!snapshot) {
+		snapshot = talloc_zero(talloc_autofree_context(), struct emsabp_snapshot);
+		OPENCHANGE_RETVAL_IF(!snapshot, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+		snapshot->filter = talloc_strdup(snapshot, filter);
+		OPENCHANGE_RETVAL_IF(!snapshot->filter, MAPI_E_NOT_ENOUGH_MEMORY, snapshot);
+
+		retval = emsabp_snapshot_build(emsabp_ctx, snapshot);
+		OPENCHANGE_RETVAL_IF(retval, retval, snapshot);
+		DLIST_ADD(snapshots, snapshot);
+	} else if (snapshot->usn != usn) {
+		retval = emsabp_snapshot_update(emsabp_ctx, snapshot);
+		if (retval != MAPI_E_SUCCESS) {
+			OC_DEBUG(3, "[nspi] snapshot update failed, rebuilding: %s", mapi_get_errstr(retval));
+			retval = emsabp_snapshot_build(emsabp_ctx, snapshot);
+			OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+		}
+	}
+	snapshot->usn = usn;
+
+	*snapshotp = snapshot;
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Retrieve the session MIds of a snapshot, creating the
+   missing ones when the snapshot generation has changed
+
+   \param emsabp_ctx pointer to the EMSABP context
+   \param snapshot pointer to the snapshot
+
+   \return Pointer to the session view on success, otherwise NULL
+ */
+static struct emsabp_snapshot_view *emsabp_snapshot_get_view(struct emsabp_context *emsabp_ctx,
+							     struct emsabp_snapshot *snapshot)
+{
+	enum MAPISTATUS			retval;
+	struct emsabp_snapshot_view	*view;
+	uint32_t			*MIds;
+	const char			*dn;
+	uint32_t			i;
+
+	for (view = emsabp_ctx->snapshot_views; view; view = view->next) {
+		if (view->snapshot == snapshot) break;
+	}
+
+	if (!view) {
+		view = talloc_zero(emsabp_ctx->mem_ctx, struct emsabp_snapshot_view);
+		if (!view) return NULL;
+		view->snapshot = snapshot;
+		DLIST_ADD(emsabp_ctx->snapshot_views, view);
+	} else if (view->generation == snapshot->generation && view->MIds.aulPropTag) {
+		return view;
+	}
+
+	MIds = talloc_array(view, uint32_t, snapshot->count ? snapshot->count : 1);
+	if (!MIds) return NULL;
+
+	for (i = 0; i < snapshot->count; i++) {
+		dn = snapshot->entries[i].dn;
+		retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, &MIds[i]);
+		if (retval != MAPI_E_SUCCESS) {
+			retval = emsabp_tdb_insert(emsabp_ctx->ttdb_ctx, dn);
+			if (retval == MAPI_E_SUCCESS) {
+				retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, dn, &MIds[i]);
+			}
+			if (retval != MAPI_E_SUCCESS) {
+				talloc_free(MIds);
+				return NULL;
+			}
+		}
+	}
+
+	talloc_free(view->MIds.aulPropTag);
+	view->MIds.aulPropTag = MIds;
+	view->MIds.cValues = snapshot->count;
+	view->generation = snapshot->generation;
+
+	return view;
+}
+
+/**
+   \details Retrieve the display name sorted list of session MIds
+   matching a search filter
+
+   \param mem_ctx pointer to the memory context
+   \param emsabp_ctx pointer to the EMSABP context
+   \param filter the LDB search filter
+   \param snapshotp pointer on pointer to the snapshot the MIds are
+   aligned with, may be NULL
+   \param MIds pointer to the list of MIds the function returns
+
+   \note The snapshot returned remains valid until the next call to
+   this function.
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+_PUBLIC_ enum MAPISTATUS emsabp_snapshot_fetch(TALLOC_CTX *mem_ctx, struct emsabp_context *emsabp_ctx,
+					       const char *filter, struct emsabp_snapshot **snapshotp,
+					       struct PropertyTagArray_r *MIds)
+{
+	enum MAPISTATUS			retval;
+	struct emsabp_snapshot		*snapshot = NULL;
+	struct emsabp_snapshot_view	*view;
+
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!emsabp_ctx, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!filter, MAPI_E_INVALID_PARAMETER, NULL);
+	OPENCHANGE_RETVAL_IF(!MIds, MAPI_E_INVALID_PARAMETER, NULL);
+
+	retval = emsabp_snapshot_refresh(emsabp_ctx, filter, &snapshot);
+	OPENCHANGE_RETVAL_IF(retval, retval, NULL);
+
+	view = emsabp_snapshot_get_view(emsabp_ctx, snapshot);
+	OPENCHANGE_RETVAL_IF(!view, MAPI_E_CORRUPT_STORE, NULL);
+
+	MIds->cValues = view->MIds.cValues;
+	MIds->aulPropTag = (uint32_t *) talloc_memdup(mem_ctx, view->MIds.aulPropTag,
+						      (view->MIds.cValues ? view->MIds.cValues : 1) * sizeof (uint32_t));
+	OPENCHANGE_RETVAL_IF(!MIds->aulPropTag, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	if (snapshotp) {
+		*snapshotp = snapshot;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+/**
+   \details Find the first snapshot entry whose display name is
+   greater than or equal to the target
+
+   \param snapshot pointer to the snapshot
+   \param target the display name to seek
+
+   \return position of the entry, snapshot->count if there is none
+ */
+_PUBLIC_ uint32_t emsabp_snapshot_seek(struct emsabp_snapshot *snapshot, const char *target)
+{
+	uint32_t	low = 0;
+	uint32_t	high;
+	uint32_t	middle;
+
+	if (!snapshot || !target) return 0;
+
+	high = snapshot->count;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (strcasecmp(snapshot->entries[middle].display_name, target) < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
@@ -29,12 +29,113 @@
 #include "dcesrv_exchange_nsp.h"
 
 /**
-   \details Structure to be used for MId traversal within TDB
+   \details Build the reverse index key associated to a MId
+
+   \param MId the MId to build the key for
+   \param keyname pointer to the buffer to fill
+   \param size size of the keyname buffer
+
+   \return TDB key pointing to keyname
  */
-struct traverse_MId {
-	uint32_t	MId;
-	bool		found;
-};
+static TDB_DATA emsabp_tdb_MId_dn_key(uint32_t MId, char *keyname, size_t size)
+{
+	TDB_DATA	key;
+
+	key.dptr = (unsigned char *) keyname;
+	key.dsize = snprintf(keyname, size, EMSABP_TDB_MID_DN_PREFIX "%x", MId);
+
+	return key;
+}
+
+
+/**
+   \details Store the MId to DN reverse index record
+
+   \param tdb_ctx pointer to the EMSABP TDB context
+   \param MId the MId of the record
+   \param dn pointer to the DN of the record
+   \param dn_len length of the DN
+
+   \return 0 on success, otherwise -1
+ */
+static int emsabp_tdb_store_MId_dn(TDB_CONTEXT *tdb_ctx, uint32_t MId,
+				   const char *dn, size_t dn_len)
+{
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		keyname[32];
+
+	key = emsabp_tdb_MId_dn_key(MId, keyname, sizeof (keyname));
+	dbuf.dptr = (unsigned char *) dn;
+	dbuf.dsize = dn_len;
+
+	return tdb_store(tdb_ctx, key, dbuf, TDB_REPLACE);
+}
+
+
+static int emsabp_tdb_traverse_MId_dn_index(TDB_CONTEXT *tdb_ctx,
+					    TDB_DATA key, TDB_DATA dbuf,
+					    void *state)
+{
+	char		value_str[16];
+	uint32_t	value;
+	int		*count = (int *) state;
+
+	if (!key.dptr || !dbuf.dptr || !dbuf.dsize || dbuf.dsize >= sizeof (value_str)) return 0;
+
+	/* Skip the data and reverse index records */
+	if (key.dsize == strlen(EMSABP_TDB_DATA_REC) &&
+	    !strncmp((const char *)key.dptr, EMSABP_TDB_DATA_REC, key.dsize)) return 0;
+	if (key.dsize == strlen(EMSABP_TDB_MID_DN_REC) &&
+	    !strncmp((const char *)key.dptr, EMSABP_TDB_MID_DN_REC, key.dsize)) return 0;
+	if (key.dsize >= strlen(EMSABP_TDB_MID_DN_PREFIX) &&
+	    !strncmp((const char *)key.dptr, EMSABP_TDB_MID_DN_PREFIX, strlen(EMSABP_TDB_MID_DN_PREFIX))) return 0;
+
+	memcpy(value_str, dbuf.dptr, dbuf.dsize);
+	value_str[dbuf.dsize] = '\0';
+	value = strtol(value_str, NULL, 16);
+
+	if (emsabp_tdb_store_MId_dn(tdb_ctx, value, (const char *)key.dptr, key.dsize) == -1) {
+		return -1;
+	}
+	*count += 1;
+
+	return 0;
+}
+
+
+/**
+   \details Build the MId to DN reverse index of databases created
+   before it was maintained by emsabp_tdb_insert
+
+   \param tdb_ctx pointer to the EMSABP TDB context
+
+   \return MAPI_E_SUCCESS on success, otherwise MAPI error
+ */
+static enum MAPISTATUS emsabp_tdb_upgrade_MId_dn_index(TDB_CONTEXT *tdb_ctx)
+{
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	int		count = 0;
+	int		ret;
+
+	key.dptr = (unsigned char *) EMSABP_TDB_MID_DN_REC;
+	key.dsize = strlen(EMSABP_TDB_MID_DN_REC);
+	if (tdb_exists(tdb_ctx, key)) return MAPI_E_SUCCESS;
+
+	ret = tdb_traverse(tdb_ctx, emsabp_tdb_traverse_MId_dn_index, (void *)&count);
+	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, NULL);
+
+	dbuf.dptr = (unsigned char *) "1";
+	dbuf.dsize = 1;
+	ret = tdb_store(tdb_ctx, key, dbuf, TDB_INSERT);
+	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, NULL);
+
+	OC_DEBUG(3, "MId to DN reverse index built for %d records", count);
+
+	return MAPI_E_SUCCESS;
+}
+
 
 /**
    \details Open EMSABP TDB database
@@ -80,6 +181,15 @@ _PUBLIC_ TDB_CONTEXT *emsabp_tdb_init(TALLOC_CTX *mem_ctx,
 		free (dbuf.dptr);
 	}
 
+	/* Step 2. Build the MId to DN reverse index if missing */
+	retval = emsabp_tdb_upgrade_MId_dn_index(tdb_ctx);
+	if (retval != MAPI_E_SUCCESS) {
+		OC_DEBUG(3, "Unable to build %s reverse index: %s",
+			  EMSABP_TDB_MID_DN_REC, tdb_errorstr(tdb_ctx));
+		tdb_close(tdb_ctx);
+		return NULL;
+	}
+
 	return tdb_ctx;
 }
 
@@ -221,32 +331,8 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_fetch_MId(TDB_CONTEXT *tdb_ctx,
 }
 
 
-static int emsabp_tdb_traverse_MId(TDB_CONTEXT *tdb_ctx, 
-				   TDB_DATA key, TDB_DATA dbuf, 
-				   void *state)
-{
-	TALLOC_CTX		*mem_ctx;
-	uint32_t		value;
-	char			*value_str = NULL;
-	struct traverse_MId	*mid_trav = (struct traverse_MId *) state;
-
-	mem_ctx = talloc_named(NULL, 0, "emsabp_tdb_traverse_MId");
-	value_str = talloc_strndup(mem_ctx, (char *)dbuf.dptr, dbuf.dsize);
-	value = strtol((const char *)value_str, NULL, 16);
-	talloc_free(mem_ctx);
-
-	if (value == mid_trav->MId) {
-		mid_trav->found = true;
-		return 1;
-	}
-
-	return 0;
-}
-
-
 /**
-   \details Traverse the EMSABP TDB database and look for the input
-   MId
+   \details Look for the input MId within the EMSABP TDB database
 
    \param tdb_ctx pointer to the EMSABP TDB context
    \param MId MID to lookup
@@ -256,73 +342,58 @@ static int emsabp_tdb_traverse_MId(TDB_CONTEXT *tdb_ctx,
 _PUBLIC_ bool emsabp_tdb_lookup_MId(TDB_CONTEXT *tdb_ctx,
 				    uint32_t MId)
 {
-	int			ret;
-	struct traverse_MId	mid_trav = { MId, false };
-
-	ret = tdb_traverse(tdb_ctx, emsabp_tdb_traverse_MId, (void *)&mid_trav);
+	TDB_DATA	key;
+	char		keyname[32];
 
-	return (ret > 0) && mid_trav.found;
-}
+	/* Sanity checks */
+	if (!tdb_ctx) return false;
 
+	key = emsabp_tdb_MId_dn_key(MId, keyname, sizeof (keyname));
 
-static int emsabp_tdb_traverse_MId_DN(TDB_CONTEXT *tdb_ctx,
-				      TDB_DATA key, TDB_DATA dbuf,
-				      void *state)
-{
-	char			*MId;
-	uint32_t		value;
-	struct emsabp_MId	*emsabp_MId = (struct emsabp_MId *) state;
-
-	if (key.dptr) {
-		if (!strncmp((const char *)key.dptr, "CN=", 3)) {
-			MId = talloc_strndup(emsabp_MId, (char *)dbuf.dptr, dbuf.dsize);
-			value = strtol((const char *)MId, NULL, 16);
-			talloc_free(MId);
-			if (value == emsabp_MId->MId) {
-				emsabp_MId->dn = talloc_strndup(emsabp_MId, (char *)key.dptr, key.dsize);
-				return 1;
-			}
-		}
-	}
-
-	return 0;
+	return tdb_exists(tdb_ctx, key);
 }
 
 
 /**
-   \details Traverse the EMSABP TDB and fetch the DN associated with
-   the MId
+   \details Fetch the DN associated with the MId from the EMSABP TDB
+   reverse index
 
    \param mem_ctx pointer to the memory context
    \param tdb_ctx pointer to the EMSABP TDB context
    \param MId MID to search
    \param dn pointer on pointer to the dn to return
 
-   \return MAPI_E_SUCCESS on success, otherwise false
+   \return MAPI_E_SUCCESS on success, otherwise MAPI_E_NOT_FOUND
  */
 _PUBLIC_ enum MAPISTATUS emsabp_tdb_fetch_dn_from_MId(TALLOC_CTX *mem_ctx,
 						      TDB_CONTEXT *tdb_ctx,
 						      uint32_t MId,
 						      char **dn)
 {
-	int			ret;
-	struct emsabp_MId	*emsabp_MId;
-	
-	emsabp_MId = talloc_zero(mem_ctx, struct emsabp_MId);
-	emsabp_MId->dn = NULL;
-	emsabp_MId->MId = MId;
-	
-	ret = tdb_traverse(tdb_ctx, emsabp_tdb_traverse_MId_DN, (void *)emsabp_MId);
-	if (ret > -1 && emsabp_MId->dn) {
-		*dn = talloc_strdup(mem_ctx, emsabp_MId->dn);
-		talloc_free(emsabp_MId);
-		return MAPI_E_SUCCESS;
-	}
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		keyname[32];
 
 	*dn = NULL;
-	talloc_free(emsabp_MId);
 
-	return MAPI_E_NOT_FOUND;
+	/* Sanity checks */
+	OPENCHANGE_RETVAL_IF(!tdb_ctx, MAPI_E_NOT_INITIALIZED, NULL);
+
+	key = emsabp_tdb_MId_dn_key(MId, keyname, sizeof (keyname));
+	dbuf = tdb_fetch(tdb_ctx, key);
+	OPENCHANGE_RETVAL_IF(!dbuf.dptr, MAPI_E_NOT_FOUND, NULL);
+
+	/* Only DN records are returned */
+	if (dbuf.dsize < 3 || strncmp((const char *)dbuf.dptr, "CN=", 3)) {
+		free(dbuf.dptr);
+		return MAPI_E_NOT_FOUND;
+	}
+
+	*dn = talloc_strndup(mem_ctx, (char *)dbuf.dptr, dbuf.dsize);
+	free(dbuf.dptr);
+	OPENCHANGE_RETVAL_IF(!*dn, MAPI_E_NOT_ENOUGH_MEMORY, NULL);
+
+	return MAPI_E_SUCCESS;
 }
 
 
@@ -383,6 +454,10 @@ _PUBLIC_ enum MAPISTATUS emsabp_tdb_insert(TDB_CONTEXT *tdb_ctx,
 	ret = tdb_store(tdb_ctx, key, dbuf, TDB_MODIFY);
 	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, mem_ctx);
 
+	/* Step 5. Update the MId to DN reverse index */
+	ret = emsabp_tdb_store_MId_dn(tdb_ctx, index, keyname, strlen(keyname));
+	OPENCHANGE_RETVAL_IF(ret == -1, MAPI_E_CORRUPT_STORE, mem_ctx);
+
 	talloc_free(mem_ctx);
 
 	return MAPI_E_SUCCESS;
@@ -22,6 +22,8 @@
 #include "mysql.h"
 
 #include <time.h>
+#include <mysql/errmsg.h>
+#include <mysql/mysqld_error.h>
 #include "ccan/htable/htable.h"
 #include "ccan/hash/hash.h"
 #include "libmapi/mapicode.h"
@@ -33,6 +35,7 @@
 struct conn_v {
 	MYSQL		*conn;
 	const char	*connection_string;
+	time_t		last_used;
 };
 
 /* Rehash function for ht table */
@@ -50,6 +53,45 @@ static bool _ht_cmp(const void *e, void *string)
 /* This is a dictionary [connection_string] -> [MYSQL *] (actually struct conn_v) */
 static struct htable ht = HTABLE_INITIALIZER(ht, _ht_rehash, NULL);
 
+/* Items stored on stmt_ht table */
+struct stmt_v {
+	MYSQL		*conn;
+	const char	*query;
+	MYSQL_STMT	*stmt;
+	unsigned long	thread_id;	/* server connection the statement was prepared on */
+};
+
+/* Key used to get items from stmt_ht table */
+struct stmt_k {
+	MYSQL		*conn;
+	const char	*query;
+};
+
+static size_t _stmt_hash(MYSQL *conn, const char *query)
+{
+	return hash_string(query) ^ hash_pointer(conn, 0);
+}
+
+/* Rehash function for stmt_ht table */
+static size_t _stmt_ht_rehash(const void *e, void *unused)
+{
+	const struct stmt_v *entry = (const struct stmt_v *)e;
+
+	return _stmt_hash(entry->conn, entry->query);
+}
+
+/* Comparison function to get items from stmt_ht table */
+static bool _stmt_ht_cmp(const void *e, void *key)
+{
+	const struct stmt_v *entry = (const struct stmt_v *)e;
+	const struct stmt_k *k = (const struct stmt_k *)key;
+
+	return entry->conn == k->conn && strcmp(entry->query, k->query) == 0;
+}
+
+/* This is a dictionary [MYSQL *, query template] -> [MYSQL_STMT *] (actually struct stmt_v) */
+static struct htable stmt_ht = HTABLE_INITIALIZER(stmt_ht, _stmt_ht_rehash, NULL);
+
 
 static float timespec_diff_in_seconds(struct timespec *end, struct timespec *start)
 {
@@ -58,6 +100,27 @@ static float timespec_diff_in_seconds(struct timespec *end, struct timespec *sta
 		/ 1000000000;
 }
 
+/**
+    \details Close the prepared statements cached for a connection
+
+    \param conn pointer to the MySQL connection, NULL for all of them
+ */
+static void close_statements(MYSQL *conn)
+{
+	struct htable_iter	i;
+	struct stmt_v		*entry;
+
+	entry = htable_first(&stmt_ht, &i);
+	while (entry) {
+		if (!conn || entry->conn == conn) {
+			htable_delval(&stmt_ht, &i);
+			mysql_stmt_close(entry->stmt);
+			talloc_free(entry);
+		}
+		entry = htable_next(&stmt_ht, &i);
+	}
+}
+
 /**
     \details Close and delete all mysql connections already open
  */
@@ -66,6 +129,8 @@ void close_all_connections(void)
 	struct htable_iter 	i;
 	struct conn_v		*entry;
 
+	close_statements(NULL);
+
 	entry = htable_first(&ht, &i);
 	while (entry) {
 		OC_DEBUG(3, "Closing %s", entry->connection_string);
@@ -213,6 +278,15 @@ MYSQL *create_connection(const char *connection_string, MYSQL **conn)
 	retval = htable_get(&ht, hash_string(connection_string), _ht_cmp, connection_string);
 	if (retval) {
 		OC_DEBUG(5, "[MYSQL] Found connection, reusing it %"PRIu32, hash_string(connection_string));
+		/* Callers keep the MYSQL pointer, so an unhealthy
+		   connection is re-established in place by mysql_ping */
+		if (time(NULL) - retval->last_used > MYSQL_HEALTH_CHECK_INTERVAL) {
+			if (mysql_ping(retval->conn)) {
+				OC_DEBUG(1, "[MYSQL] Connection %s is not healthy: %s",
+					 connection_string, mysql_error(retval->conn));
+			}
+		}
+		retval->last_used = time(NULL);
 		*conn = retval->conn;
 		return *conn;
 	}
@@ -267,6 +341,7 @@ connected:
 	entry = talloc_zero(talloc_autofree_context(), struct conn_v);
 	entry->connection_string = talloc_strdup(entry, connection_string);
 	entry->conn = *conn;
+	entry->last_used = time(NULL);
 	// Store the new connection in our table
 	if (!htable_add(&ht, hash_string(connection_string), entry)) {
 		OC_DEBUG(1, "[MYSQL] ERROR adding new connection to internal pool of connections");
@@ -445,6 +520,385 @@ enum MYSQLRESULT select_first_uint(MYSQL *conn, const char *sql,
 }
 
 
+/**
+   \details Reset a parameters list before binding values to it
+
+   \param params pointer to the parameters list
+ */
+void stmt_params_init(struct stmt_params *params)
+{
+	if (!params) return;
+	memset(params, 0, sizeof (struct stmt_params));
+}
+
+/**
+   \details Bind an unsigned 64 bits integer to the next placeholder
+
+   \param params pointer to the parameters list
+   \param value the value to bind
+
+   \return true on success, false if there is no room left
+ */
+bool stmt_bind_u64(struct stmt_params *params, uint64_t value)
+{
+	MYSQL_BIND	*bind;
+
+	if (!params || params->count >= STMT_PARAMS_MAX) return false;
+
+	params->u64[params->count] = value;
+	bind = &params->bind[params->count];
+	bind->buffer_type = MYSQL_TYPE_LONGLONG;
+	bind->buffer = &params->u64[params->count];
+	bind->is_unsigned = true;
+	params->count++;
+
+	return true;
+}
+
+/**
+   \details Bind a binary buffer to the next placeholder. The buffer
+   is not copied and has to remain valid until the statement runs.
+
+   \param params pointer to the parameters list
+   \param data pointer to the data to bind
+   \param size size of the data
+
+   \return true on success, false if there is no room left
+ */
+bool stmt_bind_blob(struct stmt_params *params, const void *data, size_t size)
+{
+	MYSQL_BIND	*bind;
+
+	if (!params || params->count >= STMT_PARAMS_MAX) return false;
+
+	params->length[params->count] = size;
+	bind = &params->bind[params->count];
+	bind->buffer_type = MYSQL_TYPE_BLOB;
+	bind->buffer = (void *)data;
+	bind->buffer_length = size;
+	bind->length = &params->length[params->count];
+	params->count++;
+
+	return true;
+}
+
+/**
+   \details Bind a string to the next placeholder, NULL binds SQL
+   NULL. The string is not copied and has to remain valid until the
+   statement runs.
+
+   \param params pointer to the parameters list
+   \param value the string to bind
+
+   \return true on success, false if there is no room left
+ */
+bool stmt_bind_string(struct stmt_params *params, const char *value)
+{
+	if (!params || params->count >= STMT_PARAMS_MAX) return false;
+
+	if (!value) {
+		params->bind[params->count].buffer_type = MYSQL_TYPE_NULL;
+		params->count++;
+		return true;
+	}
+
+	if (!stmt_bind_blob(params, value, strlen(value))) return false;
+	params->bind[params->count - 1].buffer_type = MYSQL_TYPE_STRING;
+
+	return true;
+}
+
+/**
+   \details Drop a cached prepared statement
+
+   \param conn pointer to the MySQL connection
+   \param entry pointer to the cached statement
+ */
+static void stmt_invalidate(MYSQL *conn, struct stmt_v *entry)
+{
+	htable_del(&stmt_ht, _stmt_hash(conn, entry->query), entry);
+	mysql_stmt_close(entry->stmt);
+	talloc_free(entry);
+}
+
+/**
+   \details Retrieve the prepared statement for a query template,
+   preparing it on first use. Statements are prepared again when the
+   connection was re-established since they were cached.
+
+   \param conn pointer to the MySQL connection
+   \param query the query template, with ? placeholders
+
+   \return pointer to the cached statement on success, otherwise NULL
+ */
+static struct stmt_v *stmt_prepare(MYSQL *conn, const char *query)
+{
+	struct stmt_k	key;
+	struct stmt_v	*entry;
+	MYSQL_STMT	*stmt;
+
+	key.conn = conn;
+	key.query = query;
+	entry = htable_get(&stmt_ht, _stmt_hash(conn, query), _stmt_ht_cmp, &key);
+	if (entry) {
+		if (entry->thread_id == mysql_thread_id(conn)) {
+			return entry;
+		}
+		OC_DEBUG(5, "[MYSQL] Connection changed, preparing `%s` again", query);
+		stmt_invalidate(conn, entry);
+	}
+
+	stmt = mysql_stmt_init(conn);
+	if (!stmt) {
+		OC_DEBUG(1, "[MYSQL] Can't allocate statement: %s", mysql_error(conn));
+		return NULL;
+	}
+
+	if (mysql_stmt_prepare(stmt, query, strlen(query))) {
+		OC_DEBUG(1, "[MYSQL] Can't prepare `%s`: %s", query, mysql_stmt_error(stmt));
+		mysql_stmt_close(stmt);
+		return NULL;
+	}
+
+	// This entries live until the connection is closed
+	entry = talloc_zero(talloc_autofree_context(), struct stmt_v);
+	if (!entry) {
+		mysql_stmt_close(stmt);
+		return NULL;
+	}
+	entry->conn = conn;
+	entry->query = talloc_strdup(entry, query);
+	entry->stmt = stmt;
+	entry->thread_id = mysql_thread_id(conn);
+	if (!entry->query || !htable_add(&stmt_ht, _stmt_hash(conn, query), entry)) {
+		OC_DEBUG(1, "[MYSQL] ERROR adding statement to the cache");
+		mysql_stmt_close(stmt);
+		talloc_free(entry);
+		return NULL;
+	}
+
+	return entry;
+}
+
+/**
+   \details Execute a cached prepared statement. A statement lost with
+   the server connection is prepared and executed once again.
+
+   \param conn pointer to the MySQL connection
+   \param query the query template, with ? placeholders
+   \param params pointer to the parameters to bind, may be NULL
+   \param stmtp pointer on pointer to the executed statement
+
+   \return MYSQL_SUCCESS on success, otherwise MYSQL_ERROR
+ */
+static enum MYSQLRESULT stmt_run(MYSQL *conn, const char *query,
+				 struct stmt_params *params, MYSQL_STMT **stmtp)
+{
+	struct timespec	start, end;
+	float		seconds_spent;
+	struct stmt_v	*entry;
+	unsigned int	count;
+	unsigned int	err;
+	int		attempt;
+
+	if (!conn || !query || !stmtp) {
+		OC_DEBUG(0, "Bad parameters when calling stmt_run");
+		return MYSQL_ERROR;
+	}
+
+	count = params ? params->count : 0;
+	for (attempt = 0; attempt < 2; attempt++) {
+		entry = stmt_prepare(conn, query);
+		if (!entry) return MYSQL_ERROR;
+
+		if (mysql_stmt_param_count(entry->stmt) != count) {
+			OC_DEBUG(0, "[MYSQL] `%s` expects %lu parameters, %u given", query,
+				 mysql_stmt_param_count(entry->stmt), count);
+			return MYSQL_ERROR;
+		}
+		if (count && mysql_stmt_bind_param(entry->stmt, params->bind)) {
+			OC_DEBUG(1, "[MYSQL] Can't bind parameters of `%s`: %s", query,
+				 mysql_stmt_error(entry->stmt));
+			return MYSQL_ERROR;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (mysql_stmt_execute(entry->stmt) == 0) {
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			seconds_spent = timespec_diff_in_seconds(&end, &start);
+			if (seconds_spent > THRESHOLD_SLOW_QUERIES) {
+				OC_DEBUG(5, "MySQL slow query!"
+					 "\tQuery: `%s`\n\tTime: %.3f\n", query, seconds_spent);
+			}
+			*stmtp = entry->stmt;
+			return MYSQL_SUCCESS;
+		}
+
+		err = mysql_stmt_errno(entry->stmt);
+		OC_DEBUG(3, "Error on query `%s`: %s", query, mysql_stmt_error(entry->stmt));
+		if (err != CR_SERVER_GONE_ERROR && err != CR_SERVER_LOST &&
+		    err != ER_UNKNOWN_STMT_HANDLER) {
+			break;
+		}
+		stmt_invalidate(conn, entry);
+	}
+
+	return MYSQL_ERROR;
+}
+
+/**
+   \details Execute a statement which does not return rows
+
+   \param conn pointer to the MySQL connection
+   \param query the query template, with ? placeholders
+   \param params pointer to the parameters to bind, may be NULL
+
+   \return MYSQL_SUCCESS on success, otherwise MYSQL_ERROR
+ */
+enum MYSQLRESULT stmt_execute(MYSQL *conn, const char *query, struct stmt_params *params)
+{
+	MYSQL_STMT	*stmt;
+
+	return stmt_run(conn, query, params, &stmt);
+}
+
+/**
+   \details Execute a statement and fetch the columns of its first
+   row as strings. SQL NULL columns are returned as NULL.
+
+   \param mem_ctx pointer to the memory context
+   \param conn pointer to the MySQL connection
+   \param query the query template, with ? placeholders
+   \param params pointer to the parameters to bind, may be NULL
+   \param count number of columns to fetch
+   \param values array of count strings the function fills
+
+   \return MYSQL_SUCCESS on success, MYSQL_NOT_FOUND if there is no
+   row, otherwise MYSQL_ERROR
+ */
+enum MYSQLRESULT stmt_select_row(TALLOC_CTX *mem_ctx, MYSQL *conn, const char *query,
+				 struct stmt_params *params, unsigned int count,
+				 const char **values)
+{
+	MYSQL_STMT		*stmt;
+	MYSQL_BIND		result[STMT_PARAMS_MAX];
+	unsigned long		length[STMT_PARAMS_MAX];
+	my_bool			is_null[STMT_PARAMS_MAX];
+	enum MYSQLRESULT	ret;
+	unsigned int		fields;
+	unsigned int		i;
+	char			*value;
+	int			rc;
+
+	if (!values || !count) return MYSQL_ERROR;
+
+	ret = stmt_run(conn, query, params, &stmt);
+	if (ret != MYSQL_SUCCESS) return ret;
+
+	fields = mysql_stmt_field_count(stmt);
+	if (fields < count || fields > STMT_PARAMS_MAX) {
+		OC_DEBUG(0, "[MYSQL] `%s` returns %u columns, %u expected", query, fields, count);
+		mysql_stmt_free_result(stmt);
+		return MYSQL_ERROR;
+	}
+
+	/* Bind without buffers to learn the column lengths first */
+	memset(result, 0, sizeof (result));
+	for (i = 0; i < fields; i++) {
+		result[i].buffer_type = MYSQL_TYPE_STRING;
+		result[i].length = &length[i];
+		result[i].is_null = &is_null[i];
+	}
+
+	ret = MYSQL_ERROR;
+	if (mysql_stmt_bind_result(stmt, result) || mysql_stmt_store_result(stmt)) {
+		OC_DEBUG(0, "Error getting results of `%s`: %s", query, mysql_stmt_error(stmt));
+		goto end;
+	}
+
+	rc = mysql_stmt_fetch(stmt);
+	if (rc == MYSQL_NO_DATA) {
+		ret = MYSQL_NOT_FOUND;
+		goto end;
+	}
+	if (rc != 0 && rc != MYSQL_DATA_TRUNCATED) {
+		OC_DEBUG(0, "Error getting row of `%s`: %s", query, mysql_stmt_error(stmt));
+		goto end;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (is_null[i]) {
+			values[i] = NULL;
+			continue;
+		}
+		value = talloc_array(mem_ctx, char, length[i] + 1);
+		if (!value) goto end;
+		if (length[i]) {
+			result[i].buffer = value;
+			result[i].buffer_length = length[i];
+			if (mysql_stmt_fetch_column(stmt, &result[i], i, 0)) {
+				OC_DEBUG(0, "Error getting column %u of `%s`: %s", i, query,
+					 mysql_stmt_error(stmt));
+				goto end;
+			}
+		}
+		value[length[i]] = '\0';
+		values[i] = value;
+	}
+	ret = MYSQL_SUCCESS;
+end:
+	mysql_stmt_free_result(stmt);
+	return ret;
+}
+
+/**
+   \details Execute a statement and fetch the first column of its
+   first row as a string
+
+   \param mem_ctx pointer to the memory context
+   \param conn pointer to the MySQL connection
+   \param query the query template, with ? placeholders
+   \param params pointer to the parameters to bind, may be NULL
+   \param s pointer to the string the function returns
+
+   \return MYSQL_SUCCESS on success, MYSQL_NOT_FOUND if there is no
+   row, otherwise MYSQL_ERROR
+ */
+enum MYSQLRESULT stmt_select_first_string(TALLOC_CTX *mem_ctx, MYSQL *conn, const char *query,
+					  struct stmt_params *params, const char **s)
+{
+	return stmt_select_row(mem_ctx, conn, query, params, 1, s);
+}
+
+/**
+   \details Execute a statement and fetch the first column of its
+   first row as an unsigned integer
+
+   \param conn pointer to the MySQL connection
+   \param query the query template, with ? placeholders
+   \param params pointer to the parameters to bind, may be NULL
+   \param n pointer to the integer the function returns
+
+   \return MYSQL_SUCCESS on success, MYSQL_NOT_FOUND if there is no
+   row, otherwise MYSQL_ERROR
+ */
+enum MYSQLRESULT stmt_select_first_uint(MYSQL *conn, const char *query,
+					struct stmt_params *params, uint64_t *n)
+{
+	TALLOC_CTX		*mem_ctx = talloc_named(NULL, 0, "stmt_select_first_uint");
+	const char		*result = NULL;
+	enum MYSQLRESULT	ret;
+
+	ret = stmt_select_first_string(mem_ctx, conn, query, params, &result);
+	if (ret == MYSQL_SUCCESS && !convert_string_to_ull(result, n)) {
+		ret = MYSQL_ERROR;
+	}
+
+	talloc_free(mem_ctx);
+	return ret;
+}
+
+
 bool table_exists(MYSQL *conn, char *table_name)
 {
 	MYSQL_RES *res;
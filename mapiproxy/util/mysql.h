@@ -30,6 +30,20 @@
 #define THRESHOLD_SLOW_QUERIES 0.25
 #define _sql(A, B) _sql_escape(A, B, '\'')
 
+/* Idle time in seconds after which a reused connection is pinged */
+#define MYSQL_HEALTH_CHECK_INTERVAL 30
+
+/* Maximum number of parameters and result columns of a prepared statement */
+#define STMT_PARAMS_MAX 8
+
+/* Parameters bound to a prepared statement, filled with stmt_bind_* */
+struct stmt_params {
+	MYSQL_BIND	bind[STMT_PARAMS_MAX];
+	unsigned long	length[STMT_PARAMS_MAX];
+	uint64_t	u64[STMT_PARAMS_MAX];
+	unsigned int	count;
+};
+
 const char* _sql_escape(TALLOC_CTX *mem_ctx, const char *s, char c);
 
 enum MYSQLRESULT execute_query(MYSQL *, const char *);
@@ -42,6 +56,16 @@ bool table_exists(MYSQL *, char *);
 bool create_schema(MYSQL *, const char *);
 bool convert_string_to_ull(const char *, uint64_t *);
 
+void stmt_params_init(struct stmt_params *);
+bool stmt_bind_u64(struct stmt_params *, uint64_t);
+bool stmt_bind_string(struct stmt_params *, const char *);
+bool stmt_bind_blob(struct stmt_params *, const void *, size_t);
+
+enum MYSQLRESULT stmt_execute(MYSQL *, const char *, struct stmt_params *);
+enum MYSQLRESULT stmt_select_row(TALLOC_CTX *, MYSQL *, const char *, struct stmt_params *, unsigned int, const char **);
+enum MYSQLRESULT stmt_select_first_string(TALLOC_CTX *, MYSQL *, const char *, struct stmt_params *, const char **);
+enum MYSQLRESULT stmt_select_first_uint(MYSQL *, const char *, struct stmt_params *, uint64_t *);
+
 MYSQL *create_connection(const char *, MYSQL **);
 void release_connection(MYSQL *);
 void close_all_connections(void);
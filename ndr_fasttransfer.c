@@ -189,7 +189,7 @@ static void ndr_print_IDSET(struct ndr_print *ndr, const struct idset *idset,
 				ndr->print(ndr, COLOR_BOLD COLOR_RED "Incorrect GLOBCNT range as high value is larger than low value" COLOR_END COLOR_END);
 			}
 			ndr->print(ndr, COLOR_CYAN "0x%.12" PRIx64 ":0x%.12" PRIx64 COLOR_END, range->low, range->high);
-			range = range->next;
+			range++;
 		}
 		ndr->depth--;
 
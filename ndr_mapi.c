@@ -26,13 +26,49 @@
 #include "gen_ndr/ndr_exchange.h"
 #include "gen_ndr/ndr_property.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define MIN(a,b) ((a)<(b)?(a):(b))
 
+/**
+   \details XOR a buffer in place with a single byte salt
+
+   The buffer is processed 16 bytes at a time with SSE2 when available,
+   then 8 bytes at a time, and remaining bytes one by one. Unaligned
+   words are accessed through memcpy.
+
+   \param data pointer to the buffer to obfuscate
+   \param size the size of the buffer
+   \param salt the byte to XOR the buffer with
+ */
 _PUBLIC_ void obfuscate_data(uint8_t *data, uint32_t size, uint8_t salt)
 {
-	uint32_t i;
+	uint64_t	mask;
+	uint64_t	word;
+	uint32_t	i = 0;
+
+#ifdef __SSE2__
+	{
+		__m128i	vmask = _mm_set1_epi8((char)salt);
+		__m128i	v;
 
-	for (i=0; i<size; i++) {
+		for (; i + 16 <= size; i += 16) {
+			v = _mm_loadu_si128((const __m128i *)(data + i));
+			_mm_storeu_si128((__m128i *)(data + i), _mm_xor_si128(v, vmask));
+		}
+	}
+#endif
+
+	mask = salt * 0x0101010101010101ULL;
+	for (; i + 8 <= size; i += 8) {
+		memcpy(&word, data + i, sizeof (word));
+		word ^= mask;
+		memcpy(data + i, &word, sizeof (word));
+	}
+
+	for (; i < size; i++) {
 		data[i] ^= salt;
 	}
 }
@@ -278,6 +314,10 @@ _PUBLIC_ enum ndr_err_code ndr_pull_mapi2k7_response(struct ndr_pull *ndr, int n
 					if (r->header.Flags & RHEF_Compressed) {
 						struct ndr_pull *_ndr_data_compressed = NULL;
 
+						/* XorMagic is applied after compression */
+						if (r->header.Flags & RHEF_XorMagic) {
+							obfuscate_data(_ndr_buffer->data, _ndr_buffer->data_size, 0xA5);
+						}
 						NDR_CHECK(ndr_pull_lzxpress_decompress(_ndr_buffer, &_ndr_data_compressed, r->header.SizeActual));
 						NDR_CHECK(ndr_pull_mapi_response(_ndr_data_compressed, NDR_SCALARS|NDR_BUFFERS, r->mapi_response));
 					} else if (r->header.Flags & RHEF_XorMagic) {
@@ -7,6 +7,7 @@ import subprocess
 import sys
 import tempfile
 import re
+import struct
 
 knownpropsets = { "PSETID_PostRss" :           "{00062041-0000-0000-C000-000000000046}",
 		  "PSETID_Sharing" :           "{00062040-0000-0000-C000-000000000046}",
@@ -539,6 +540,152 @@ temporary_private_tags_struct = """\t{ openchange_private_ROOT_FOLDER_FID,		PT_I
 	{ openchange_private_PF_LOCAL_OAB,		PT_I8, "openchange_private_PF_LOCAL_OAB" },
 """
 
+# Perfect hash tables (hash and displace). The hash functions must
+# match mapi_phash_proptag(), mapi_phash_string() and
+# mapi_phash_nameid() in libmapi/property.c
+def phash_init(seed):
+	return (0x811c9dc5 ^ ((seed * 0x9e3779b9) & 0xffffffff)) & 0xffffffff
+
+def phash_bytes(h, data):
+	for c in data:
+		h = ((h ^ ord(c)) * 0x01000193) & 0xffffffff
+	return h
+
+def phash_final(h):
+	h ^= h >> 16
+	h = (h * 0x85ebca6b) & 0xffffffff
+	h ^= h >> 13
+	h = (h * 0xc2b2ae35) & 0xffffffff
+	h ^= h >> 16
+	return h
+
+def phash_proptag(seed, proptag):
+	return phash_final(phash_bytes(phash_init(seed), struct.pack("<I", proptag)))
+
+def phash_string(seed, name):
+	return phash_final(phash_bytes(phash_init(seed), name))
+
+def phash_nameid(seed, key):
+	(lid, name, oleguid) = key
+	h = phash_bytes(phash_init(seed), struct.pack("<I", lid))
+	if name is not None:
+		h = phash_bytes(h, name)
+	h = phash_bytes(h, [c for c in oleguid.lower() if c in string.hexdigits])
+	return phash_final(h)
+
+def make_perfect_hash(keys, hashfunc):
+	"""Build a perfect hash over (key, index) pairs. Returns the
+	displacement table and the slot table, both len(keys) long. A
+	negative displacement d stores the single key of its bucket
+	directly in slot -d - 1."""
+	size = len(keys)
+	buckets = [[] for i in range(size)]
+	for (key, index) in keys:
+		buckets[hashfunc(0, key) % size].append((key, index))
+	displace = [0] * size
+	slots = [None] * size
+	order = sorted(range(size), key=lambda b: -len(buckets[b]))
+	for b in order:
+		if len(buckets[b]) <= 1:
+			break
+		seed = 1
+		while True:
+			used = []
+			for (key, index) in buckets[b]:
+				slot = hashfunc(seed, key) % size
+				if slots[slot] is not None or slot in used:
+					break
+				used.append(slot)
+			else:
+				break
+			seed += 1
+			if seed > 0x7fff:
+				raise Exception("could not build perfect hash table")
+		displace[b] = seed
+		for ((key, index), slot) in zip(buckets[b], used):
+			slots[slot] = index
+	free = [i for i in range(size) if slots[i] is None]
+	free.reverse()
+	for b in order:
+		if len(buckets[b]) == 1:
+			slot = free.pop()
+			displace[b] = -slot - 1
+			slots[slot] = buckets[b][0][1]
+	return (displace, slots)
+
+def write_perfect_hash(f, prefix, keys, hashfunc):
+	"""Write the perfect hash over keys as <prefix>_displace and
+	<prefix>_slots tables. Only the first occurrence of a key is kept,
+	so lookups return the same entry as a linear scan."""
+	unique = []
+	seen = set()
+	for (key, index) in keys:
+		if key not in seen:
+			seen.add(key)
+			unique.append((key, index))
+	(displace, slots) = make_perfect_hash(unique, hashfunc)
+	f.write("#define %s_SIZE %d\n\n" % (prefix.upper(), len(slots)))
+	f.write("static const int16_t %s_displace[%s_SIZE] = {\n" % (prefix, prefix.upper()))
+	for i in range(0, len(displace), 12):
+		f.write("\t" + " ".join(["%d," % d for d in displace[i:i + 12]]) + "\n")
+	f.write("};\n\n")
+	f.write("static const uint16_t %s_slots[%s_SIZE] = {\n" % (prefix, prefix.upper()))
+	for i in range(0, len(slots), 12):
+		f.write("\t" + " ".join(["%d," % d for d in slots[i:i + 12]]) + "\n")
+	f.write("};\n\n")
+
+def write_property_tags_hash(f, sortedproplines, tagvalues):
+	entries = re.findall(r'\{\s*(\w+),\s*(\w+),\s*"(\w+)"\s*\}', "".join(sortedproplines))
+	tags = []
+	names = []
+	ids = []
+	for (index, (tagname, proptype, propname)) in enumerate(entries):
+		proptag = tagvalues[tagname]
+		tags.append((proptag, index))
+		names.append((propname, index))
+		if proptype != "PT_ERROR" and proptype != "PT_STRING8":
+			ids.append((proptag >> 16, index))
+	write_perfect_hash(f, "canonical_property_tags_tag", tags, phash_proptag)
+	write_perfect_hash(f, "canonical_property_tags_name", names, phash_string)
+	write_perfect_hash(f, "canonical_property_tags_id", ids, phash_proptag)
+
+def write_pidtags_hash(f, sortedproplines, tagvalues):
+	entries = re.findall(r'\{\s*(\w+),\s*"(\w+)"\s*\}', "".join(sortedproplines))
+	tags = []
+	ids = []
+	for (index, (tagname, pidtag)) in enumerate(entries):
+		tags.append((tagvalues[tagname], index))
+		ids.append((tagvalues[tagname] >> 16, index))
+	write_perfect_hash(f, "pidtags_tag", tags, phash_proptag)
+	write_perfect_hash(f, "pidtags_id", ids, phash_proptag)
+
+def write_nameid_hash(f, nameidentries, nameidnames, namevalues):
+	oleguids = dict(knownpropsets)
+	oleguids["PSETID_Remote"] = "{00062014-0000-0000-C000-000000000046}"
+	tags = []
+	lids = []
+	ooms = []
+	strings = []
+	for (index, (propname, OOM, lid, Name, guid)) in enumerate(nameidentries):
+		oleguid = oleguids[guid]
+		tags.append((namevalues[propname], index))
+		lids.append(((lid, None, oleguid), index))
+		if OOM is not None:
+			ooms.append(((0, OOM, oleguid), index))
+		if Name is not None:
+			strings.append(((0, Name, oleguid), index))
+	write_perfect_hash(f, "mapi_nameid_tags_tag", tags, phash_proptag)
+	write_perfect_hash(f, "mapi_nameid_tags_lid", lids, phash_nameid)
+	write_perfect_hash(f, "mapi_nameid_tags_OOM", ooms, phash_nameid)
+	write_perfect_hash(f, "mapi_nameid_tags_Name", strings, phash_nameid)
+	names = []
+	tags = []
+	for (index, propname) in enumerate(nameidnames):
+		names.append((propname, index))
+		tags.append((namevalues[propname], index))
+	write_perfect_hash(f, "mapi_nameid_names_name", names, phash_string)
+	write_perfect_hash(f, "mapi_nameid_names_tag", tags, phash_proptag)
+
 def make_mapi_properties_file():
 	proplines = []
 	altnamelines = []
@@ -670,6 +817,10 @@ def make_mapi_properties_file():
 	for propline in sortedaltnamelines:
 		f.write(propline)
 	f.close()
+	tagvalues = {}
+	for (tagname, tagvalue) in re.findall(r'^#define\s+(\w+)\s+PROP_TAG\(.*\)\s*/\*\s*(0x[0-9A-Fa-f]{8})\s*\*/',
+					     "".join(sortedproplines + sortedaltnamelines), re.MULTILINE):
+		tagvalues[tagname] = int(tagvalue, 16)
 
 	# write canonical properties out for lookup 
 	proplines = []
@@ -713,24 +864,34 @@ def make_mapi_properties_file():
 	for propline in sortedproplines:
 		f.write(propline)
 	f.write("\t{ 0,                                                                  0,            \"NULL\"                                                              }\n")
-	f.write("};\n")
-	f.write("""
+	f.write("};\n\n")
+	write_property_tags_hash(f, sortedproplines, tagvalues)
+	f.write("""static const struct mapi_proptags *canonical_property_tags_find_tag(uint32_t proptag)
+{
+	const struct mapi_proptags	*entry;
+	int32_t				d;
+	uint32_t			slot;
+
+	d = canonical_property_tags_tag_displace[mapi_phash_proptag(0, proptag) % CANONICAL_PROPERTY_TAGS_TAG_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_proptag(d, proptag) % CANONICAL_PROPERTY_TAGS_TAG_SIZE;
+	entry = &canonical_property_tags[canonical_property_tags_tag_slots[slot]];
+
+	return (entry->proptag == proptag) ? entry : NULL;
+}
+
 _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 {
-	uint32_t idx;
+	const struct mapi_proptags	*entry;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
-		}
+	entry = canonical_property_tags_find_tag(proptag);
+	if (entry) {
+		return entry->propname;
 	}
 	if (((proptag & 0xFFFF) == PT_STRING8) ||
 	    ((proptag & 0xFFFF) == PT_MV_STRING8)) {
-		proptag += 1; /* try as _UNICODE variant */
-	}
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (canonical_property_tags[idx].proptag == proptag) { 
-			return canonical_property_tags[idx].propname;
+		entry = canonical_property_tags_find_tag(proptag + 1); /* try as _UNICODE variant */
+		if (entry) {
+			return entry->propname;
 		}
 	}
 	return NULL;
@@ -738,29 +899,30 @@ _PUBLIC_ const char *get_proptag_name(uint32_t proptag)
 
 _PUBLIC_ uint32_t get_proptag_value(const char *propname)
 {
-	uint32_t idx;
+	const struct mapi_proptags	*entry;
+	int32_t				d;
+	uint32_t			slot;
 
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if (!strcmp(canonical_property_tags[idx].propname, propname)) { 
-			return canonical_property_tags[idx].proptag;
-		}
-	}
+	if (!propname) return 0;
 
-	return 0;
+	d = canonical_property_tags_name_displace[mapi_phash_string(0, propname) % CANONICAL_PROPERTY_TAGS_NAME_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_string(d, propname) % CANONICAL_PROPERTY_TAGS_NAME_SIZE;
+	entry = &canonical_property_tags[canonical_property_tags_name_slots[slot]];
+
+	return strcmp(entry->propname, propname) ? 0 : entry->proptag;
 }
 
 _PUBLIC_ uint16_t get_property_type(uint16_t untypedtag)
 {
-	uint32_t	idx;
-	uint16_t	current_type;
-
-	for (idx = 0; canonical_property_tags[idx].proptag; idx++) {
-		if ((canonical_property_tags[idx].proptag >> 16) == untypedtag) {
-			current_type = canonical_property_tags[idx].proptype;
-			if (current_type != PT_ERROR && current_type != PT_STRING8) {
-				return current_type;
-			}
-		}
+	const struct mapi_proptags	*entry;
+	int32_t				d;
+	uint32_t			slot;
+
+	d = canonical_property_tags_id_displace[mapi_phash_proptag(0, untypedtag) % CANONICAL_PROPERTY_TAGS_ID_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_proptag(d, untypedtag) % CANONICAL_PROPERTY_TAGS_ID_SIZE;
+	entry = &canonical_property_tags[canonical_property_tags_id_slots[slot]];
+	if ((entry->proptag >> 16) == untypedtag) {
+		return entry->proptype;
 	}
 
 	OC_DEBUG(5, "type for property '%x' could not be deduced", untypedtag);
@@ -937,33 +1099,38 @@ static struct pidtags pidtags[] = {
 	f.write("""\t{ 0,                                                                   NULL         }
 };
 
-static const char *_openchangedb_property_get_string_attribute(uint32_t proptag)
+""")
+	write_pidtags_hash(f, sortedproplines, tagvalues)
+	f.write("""static const char *_openchangedb_property_get_string_attribute(uint32_t proptag)
 {
-	uint32_t i;
-	uint32_t tag_id = (proptag >> 16);
+	const struct pidtags	*entry;
+	uint32_t		tag_id = (proptag >> 16);
+	int32_t			d;
+	uint32_t		slot;
 
-	for (i = 0; pidtags[i].pidtag; i++) {
-		if (tag_id == (pidtags[i].proptag >> 16)) {
-			return pidtags[i].pidtag;
-		}
-	}
+	d = pidtags_id_displace[mapi_phash_proptag(0, tag_id) % PIDTAGS_ID_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_proptag(d, tag_id) % PIDTAGS_ID_SIZE;
+	entry = &pidtags[pidtags_id_slots[slot]];
 
-	return NULL;
+	return (tag_id == (entry->proptag >> 16)) ? entry->pidtag : NULL;
 }
 
 _PUBLIC_ const char *openchangedb_property_get_attribute(uint32_t proptag)
 {
-	uint32_t i;
-	uint32_t prop_type = proptag & 0x0FFF;
+	const struct pidtags	*entry;
+	uint32_t		prop_type = proptag & 0x0FFF;
+	int32_t			d;
+	uint32_t		slot;
 
 	if (prop_type == PT_UNICODE || prop_type == PT_STRING8) {
 		return _openchangedb_property_get_string_attribute(proptag);
 	}
 
-	for (i = 0; pidtags[i].pidtag; i++) {
-		if (pidtags[i].proptag == proptag) {
-			return pidtags[i].pidtag;
-		}
+	d = pidtags_tag_displace[mapi_phash_proptag(0, proptag) % PIDTAGS_TAG_SIZE];
+	slot = (d < 0) ? (uint32_t)(-d - 1) : mapi_phash_proptag(d, proptag) % PIDTAGS_TAG_SIZE;
+	entry = &pidtags[pidtags_tag_slots[slot]];
+	if (entry->proptag == proptag) {
+		return entry->pidtag;
 	}
 	OC_DEBUG(0, "Unsupported property tag '0x%.8x'", proptag);
 
@@ -1322,9 +1489,11 @@ struct mapi_nameid {
 /* MNID_ID named properties */
 """)
 
+	namevalues = {}
 	for line in sortednamedprops:
 		if line[5] == "MNID_ID":
-			proptag = "0x%.8x" % (int(line[2], 16) << 16 | int(line[4], 16))
+			namevalues[line[0]] = int(line[2], 16) << 16 | int(line[4], 16)
+			proptag = "0x%.8x" % namevalues[line[0]]
 			propline = "#define %s %s\n" % (string.ljust(line[0], 60), string.ljust(proptag, 20))
 			f.write(propline)
 
@@ -1332,12 +1501,14 @@ struct mapi_nameid {
 	mnstring_id = 0xa000
 	for line in sortednamedprops:
 		if line[5] == "MNID_STRING":
-			proptag = "0x%.8x" % ((mnstring_id << 16) | int(line[4], 16))
+			namevalues[line[0]] = (mnstring_id << 16) | int(line[4], 16)
+			proptag = "0x%.8x" % namevalues[line[0]]
 			propline = "#define %s %s\n" % (string.ljust(line[0], 60), string.ljust(proptag, 20))
 			mnstring_id += 1
 			f.write(propline)
 
 	# Additional properties
+	namevalues["PidLidRemoteTransferSize"] = 0x8f050003
 	propline = "#define %s %s\n" % (string.ljust("PidLidRemoteTransferSize", 60), string.ljust("0x8f050003", 20))
 	f.write(propline)
 
@@ -1354,8 +1525,10 @@ struct mapi_nameid {
 static struct mapi_nameid_tags mapi_nameid_tags[] = {
 """)
 
+	nameidentries = []
 	for line in sortednamedprops:
 		if line[5] == "MNID_ID":
+			nameidentries.append((line[0], line[1], int(line[2], 16), None, line[6]))
 			OOM = "\"%s\"" % line[1]
 			key = find_key(knowndatatypes, line[4])
 			datatype = datatypemap[key]
@@ -1366,6 +1539,8 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 
 	for line in sortednamedprops:
 		if line[5] == "MNID_STRING":
+			nameidentries.append((line[0], None if line[1] == "NULL" else line[1],
+					      int(line[2], 16), line[3], line[6]))
 			OOM = "%s" % line[1]
 			key = find_key(knowndatatypes, line[4])
 			datatype = datatypemap[key]
@@ -1375,6 +1550,7 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 			f.write(propline)
 
 	# Addtional named properties
+	nameidentries.append(("PidLidRemoteTransferSize", "RemoteTransferSize", 0x8f05, None, "PSETID_Remote"))
 	propline = "{ %s, %s, %s, %s, %s, %s, %s, %s },\n" % (
 		string.ljust("PidLidRemoteTransferSize", 60), string.ljust("\"RemoteTransferSize\"", 65), "0x8f05",
 		"NULL", string.ljust("PT_LONG", 15), "MNID_ID", "PSETID_Remote", "0x0")
@@ -1391,7 +1567,9 @@ static struct mapi_nameid_tags mapi_nameid_tags[] = {
 	f.write("""
 static struct mapi_nameid_names mapi_nameid_names[] = {
 """)
+	nameidnames = []
 	for line in sortednamedprops:
+		nameidnames.append(line[0])
 		propline = "{ %s, \"%s\" },\n" % (string.ljust(line[0], 60), line[0])
 		f.write(propline)
 
@@ -1403,7 +1581,9 @@ static struct mapi_nameid_names mapi_nameid_names[] = {
 	f.write("""
 };
 
-#endif /* !MAPI_NAMEID_PRIVATE_H__ */
+""")
+	write_nameid_hash(f, nameidentries, nameidnames, namevalues)
+	f.write("""#endif /* !MAPI_NAMEID_PRIVATE_H__ */
 """)
 	f.close()
 
@@ -0,0 +1,175 @@
+/*
+   Benchmark EMSABP TDB MId to DN lookups against a traversal
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/servers/default/nspi/dcesrv_exchange_nsp.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <time.h>
+
+static void popt_openchange_version_callback(poptContext con,
+                                             enum poptCallbackReason reason,
+                                             const struct poptOption *opt,
+                                             const char *arg,
+                                             const void *data)
+{
+        switch (opt->val) {
+        case 'V':
+                printf("Version %s\n", OPENCHANGE_VERSION_STRING);
+                exit (0);
+        }
+}
+
+struct poptOption popt_openchange_version[] = {
+        { NULL, '\0', POPT_ARG_CALLBACK, (void *)popt_openchange_version_callback, '\0', NULL, NULL },
+        { "version", 'V', POPT_ARG_NONE, NULL, 'V', "Print version ", NULL },
+        POPT_TABLEEND
+};
+
+#define POPT_OPENCHANGE_VERSION { NULL, 0, POPT_ARG_INCLUDE_TABLE, popt_openchange_version, 0, "Common openchange options:", NULL },
+
+#define	BENCH_DEFAULT_ENTRIES	100000
+#define	BENCH_DEFAULT_TRAVERSALS	20
+
+/* Reference implementation of the former traversal based lookup */
+struct traverse_dn {
+	TALLOC_CTX	*mem_ctx;
+	uint32_t	MId;
+	char		*dn;
+};
+
+static double bench_time(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int traverse_dn(TDB_CONTEXT *ctx, TDB_DATA key, TDB_DATA dbuf, void *state)
+{
+	struct traverse_dn	*trav = (struct traverse_dn *) state;
+	char			*str;
+	uint32_t		value;
+
+	if (key.dptr && !strncmp((const char *)key.dptr, "CN=", 3)) {
+		str = talloc_strndup(trav->mem_ctx, (char *)dbuf.dptr, dbuf.dsize);
+		value = strtol(str, NULL, 16);
+		talloc_free(str);
+		if (value == trav->MId) {
+			trav->dn = talloc_strndup(trav->mem_ctx, (char *)key.dptr, key.dsize);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	TDB_CONTEXT		*tdb_ctx;
+	struct traverse_dn	trav;
+	poptContext		pc;
+	int			opt;
+	int			entries = BENCH_DEFAULT_ENTRIES;
+	int			traversals = BENCH_DEFAULT_TRAVERSALS;
+	char			*dn;
+	char			*res;
+	uint32_t		i;
+	double			start;
+	double			traverse_time;
+	double			index_time;
+
+	enum { OPT_ENTRIES=1000, OPT_TRAVERSALS };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "entries", 'n', POPT_ARG_INT, &entries, OPT_ENTRIES, "number of directory entries", "COUNT" },
+		{ "traversals", 't', POPT_ARG_INT, &traversals, OPT_TRAVERSALS, "number of lookups timed with a traversal", "COUNT" },
+		POPT_OPENCHANGE_VERSION
+		{ NULL, 0, 0, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_emsabp_tdb", argc, argv, long_options, 0);
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_ENTRIES:
+		case OPT_TRAVERSALS:
+			break;
+		}
+	}
+
+	if (entries <= 0 || traversals <= 0) {
+		fprintf(stderr, "Invalid number of entries or traversals\n");
+		exit (1);
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_emsabp_tdb");
+	tdb_ctx = emsabp_tdb_init_tmp(mem_ctx);
+	if (!tdb_ctx) {
+		fprintf(stderr, "Unable to initialize the EMSABP TDB database\n");
+		exit (1);
+	}
+
+	for (i = 0; i < (uint32_t) entries; i++) {
+		dn = talloc_asprintf(mem_ctx, "CN=user%u,CN=Users,DC=example,DC=com", i);
+		if (emsabp_tdb_insert(tdb_ctx, dn) != MAPI_E_SUCCESS) {
+			fprintf(stderr, "Unable to insert %s\n", dn);
+			exit (1);
+		}
+		talloc_free(dn);
+	}
+
+	trav.mem_ctx = mem_ctx;
+	start = bench_time();
+	for (i = 0; i < (uint32_t) traversals; i++) {
+		trav.MId = EMSABP_TDB_TMP_MID_START + 1 + (i * 4999) % entries;
+		trav.dn = NULL;
+		tdb_traverse(tdb_ctx, traverse_dn, &trav);
+		if (!trav.dn) {
+			fprintf(stderr, "Traversal lookup of 0x%x failed\n", trav.MId);
+			exit (1);
+		}
+		talloc_free(trav.dn);
+	}
+	traverse_time = (bench_time() - start) / traversals;
+
+	start = bench_time();
+	for (i = 0; i < (uint32_t) entries; i++) {
+		if (emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, EMSABP_TDB_TMP_MID_START + 1 + i, &res) != MAPI_E_SUCCESS) {
+			fprintf(stderr, "Index lookup of 0x%x failed\n", EMSABP_TDB_TMP_MID_START + 1 + i);
+			exit (1);
+		}
+		talloc_free(res);
+	}
+	index_time = (bench_time() - start) / entries;
+
+	printf("%8s %14s %14s %8s\n", "entries", "traverse(us)", "index(us)", "speedup");
+	printf("%8d %14.1f %14.3f %7.0fx\n", entries, traverse_time * 1e6, index_time * 1e6,
+	       index_time > 0 ? traverse_time / index_time : 0);
+
+	tdb_close(tdb_ctx);
+	poptFreeContext(pc);
+	talloc_free(mem_ctx);
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+/*
+   Benchmark IDSET range lookups and merges
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <time.h>
+
+static void popt_openchange_version_callback(poptContext con,
+                                             enum poptCallbackReason reason,
+                                             const struct poptOption *opt,
+                                             const char *arg,
+                                             const void *data)
+{
+        switch (opt->val) {
+        case 'V':
+                printf("Version %s\n", OPENCHANGE_VERSION_STRING);
+                exit (0);
+        }
+}
+
+struct poptOption popt_openchange_version[] = {
+        { NULL, '\0', POPT_ARG_CALLBACK, (void *)popt_openchange_version_callback, '\0', NULL, NULL },
+        { "version", 'V', POPT_ARG_NONE, NULL, 'V', "Print version ", NULL },
+        POPT_TABLEEND
+};
+
+#define POPT_OPENCHANGE_VERSION { NULL, 0, POPT_ARG_INCLUDE_TABLE, popt_openchange_version, 0, "Common openchange options:", NULL },
+
+#define	BENCH_DEFAULT_RANGES	10000
+#define	BENCH_DEFAULT_LOOKUPS	200000
+#define	BENCH_LINEAR_LOOKUPS	2000
+#define	BENCH_MERGES		100
+
+static double bench_time(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Reference implementation of the former linear range scan */
+static bool idset_includes_linear(const struct idset *idset, uint64_t globcnt)
+{
+	uint32_t	i;
+
+	for (i = 0; i < idset->range_count; i++) {
+		if (exchange_globcnt(idset->ranges[i].low) <= exchange_globcnt(globcnt)
+		    && exchange_globcnt(idset->ranges[i].high) >= exchange_globcnt(globcnt)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Build an idset holding every step-th counter starting at first */
+static struct idset *fragmented_idset(TALLOC_CTX *mem_ctx, const struct GUID *guid, uint64_t first, uint64_t count, uint64_t step)
+{
+	struct rawidset	*rawidset;
+	struct idset	*idset;
+	uint64_t	i;
+
+	rawidset = RAWIDSET_make(mem_ctx, false, false);
+	if (!rawidset) return NULL;
+	for (i = 0; i < count; i++) {
+		RAWIDSET_push_guid_glob(rawidset, guid, exchange_globcnt(first + i * step));
+	}
+	idset = RAWIDSET_convert_to_idset(mem_ctx, rawidset);
+	talloc_free(rawidset);
+
+	return idset;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	struct GUID		server_guid = GUID_random();
+	struct idset		*odd_idset, *even_idset, *merged_idset;
+	poptContext		pc;
+	int			opt;
+	int			ranges = BENCH_DEFAULT_RANGES;
+	int			lookups = BENCH_DEFAULT_LOOKUPS;
+	uint64_t		globcnt;
+	uint32_t		i;
+	double			start;
+	double			linear_time;
+	double			search_time;
+	double			merge_time;
+
+	enum { OPT_RANGES=1000, OPT_LOOKUPS };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "ranges", 'n', POPT_ARG_INT, &ranges, OPT_RANGES, "number of ranges in each idset", "COUNT" },
+		{ "lookups", 'l', POPT_ARG_INT, &lookups, OPT_LOOKUPS, "number of range lookups to time", "COUNT" },
+		POPT_OPENCHANGE_VERSION
+		{ NULL, 0, 0, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_idset", argc, argv, long_options, 0);
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_RANGES:
+		case OPT_LOOKUPS:
+			break;
+		}
+	}
+
+	if (ranges <= 0 || lookups <= 0) {
+		fprintf(stderr, "Invalid number of ranges or lookups\n");
+		exit (1);
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_idset");
+
+	/* Two interleaved idsets that merge into a single range */
+	odd_idset = fragmented_idset(mem_ctx, &server_guid, 1, ranges, 2);
+	even_idset = fragmented_idset(mem_ctx, &server_guid, 2, ranges, 2);
+	if (!odd_idset || !even_idset || odd_idset->range_count != (uint32_t) ranges) {
+		fprintf(stderr, "Unable to build the idsets\n");
+		exit (1);
+	}
+
+	start = bench_time();
+	for (i = 0; i < BENCH_LINEAR_LOOKUPS; i++) {
+		globcnt = exchange_globcnt((i * 7919) % (2 * ranges) + 1);
+		if (idset_includes_linear(odd_idset, globcnt) != IDSET_includes_guid_glob(odd_idset, &server_guid, globcnt)) {
+			fprintf(stderr, "Lookup mismatch for 0x%"PRIx64"\n", globcnt);
+			exit (1);
+		}
+	}
+	linear_time = (bench_time() - start) / BENCH_LINEAR_LOOKUPS;
+
+	start = bench_time();
+	for (i = 0; i < (uint32_t) lookups; i++) {
+		globcnt = exchange_globcnt((i * 7919) % (2 * ranges) + 1);
+		IDSET_includes_guid_glob(odd_idset, &server_guid, globcnt);
+	}
+	search_time = (bench_time() - start) / lookups;
+
+	start = bench_time();
+	for (i = 0; i < BENCH_MERGES; i++) {
+		merged_idset = IDSET_merge_idsets(mem_ctx, odd_idset, even_idset);
+		if (!merged_idset || merged_idset->range_count != 1) {
+			fprintf(stderr, "Unexpected merge result\n");
+			exit (1);
+		}
+		talloc_free(merged_idset);
+	}
+	merge_time = (bench_time() - start) / BENCH_MERGES;
+
+	printf("%8s %12s %12s %8s %10s\n", "ranges", "linear(us)", "search(us)", "speedup", "merge(ms)");
+	printf("%8d %12.3f %12.3f %7.0fx %10.3f\n", ranges, linear_time * 1e6, search_time * 1e6,
+	       search_time > 0 ? linear_time / search_time : 0, merge_time * 1e3);
+
+	poptFreeContext(pc);
+	talloc_free(mem_ctx);
+
+	return 0;
+}
@@ -0,0 +1,196 @@
+/*
+   Benchmark mapi_handles lookups against the former TDB implementation
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <time.h>
+
+static void popt_openchange_version_callback(poptContext con,
+                                             enum poptCallbackReason reason,
+                                             const struct poptOption *opt,
+                                             const char *arg,
+                                             const void *data)
+{
+        switch (opt->val) {
+        case 'V':
+                printf("Version %s\n", OPENCHANGE_VERSION_STRING);
+                exit (0);
+        }
+}
+
+struct poptOption popt_openchange_version[] = {
+        { NULL, '\0', POPT_ARG_CALLBACK, (void *)popt_openchange_version_callback, '\0', NULL, NULL },
+        { "version", 'V', POPT_ARG_NONE, NULL, 'V', "Print version ", NULL },
+        POPT_TABLEEND
+};
+
+#define POPT_OPENCHANGE_VERSION { NULL, 0, POPT_ARG_INCLUDE_TABLE, popt_openchange_version, 0, "Common openchange options:", NULL },
+
+#define	BENCH_DEFAULT_HANDLES	5000
+#define	BENCH_DEFAULT_LOOKUPS	200000
+
+/* Reference implementation of the former TDB-backed lookup path */
+struct tdb_handles {
+	uint32_t		handle;
+	struct tdb_handles	*prev;
+	struct tdb_handles	*next;
+};
+
+static double bench_time(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool tdb_handles_search(TDB_CONTEXT *tdb_ctx, struct tdb_handles *list, uint32_t handle)
+{
+	TDB_DATA		key;
+	TDB_DATA		dbuf;
+	struct tdb_handles	*el;
+	char			*key_str;
+
+	key_str = talloc_asprintf(NULL, "0x%x", handle);
+	key.dptr = (unsigned char *) key_str;
+	key.dsize = strlen(key_str);
+	dbuf = tdb_fetch(tdb_ctx, key);
+	talloc_free(key_str);
+	if (!dbuf.dptr) return false;
+	free(dbuf.dptr);
+
+	for (el = list; el; el = el->next) {
+		if (el->handle == handle) return true;
+	}
+	return false;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX			*mem_ctx;
+	struct mapi_handles_context	*handles_ctx;
+	struct mapi_handles		*rec = NULL;
+	TDB_CONTEXT			*tdb_ctx;
+	TDB_DATA			key;
+	TDB_DATA			dbuf;
+	struct tdb_handles		*tdb_list = NULL;
+	struct tdb_handles		*tdb_el;
+	poptContext			pc;
+	int				opt;
+	int				count = BENCH_DEFAULT_HANDLES;
+	int				lookups = BENCH_DEFAULT_LOOKUPS;
+	uint32_t			*handles;
+	char				*key_str;
+	uint32_t			i;
+	double				start;
+	double				tdb_time;
+	double				arena_time;
+
+	enum { OPT_HANDLES=1000, OPT_LOOKUPS };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "handles", 'n', POPT_ARG_INT, &count, OPT_HANDLES, "number of handles to allocate", "COUNT" },
+		{ "lookups", 'l', POPT_ARG_INT, &lookups, OPT_LOOKUPS, "number of lookups to time", "COUNT" },
+		POPT_OPENCHANGE_VERSION
+		{ NULL, 0, 0, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_mapi_handles", argc, argv, long_options, 0);
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_HANDLES:
+		case OPT_LOOKUPS:
+			break;
+		}
+	}
+
+	if (count <= 0 || lookups <= 0) {
+		fprintf(stderr, "Invalid number of handles or lookups\n");
+		exit (1);
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_mapi_handles");
+	handles_ctx = mapi_handles_init(mem_ctx);
+	handles = talloc_array(mem_ctx, uint32_t, count);
+	tdb_ctx = tdb_open(NULL, 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0600);
+	if (!handles_ctx || !handles || !tdb_ctx) {
+		fprintf(stderr, "Unable to initialize the handle stores\n");
+		exit (1);
+	}
+
+	/* Populate both implementations with the same handles */
+	for (i = 0; i < (uint32_t) count; i++) {
+		if (mapi_handles_add(handles_ctx, 0, &rec) != MAPI_E_SUCCESS) {
+			fprintf(stderr, "Unable to add handle %d\n", i);
+			exit (1);
+		}
+		handles[i] = rec->handle;
+
+		key_str = talloc_asprintf(mem_ctx, "0x%x", rec->handle);
+		key.dptr = (unsigned char *) key_str;
+		key.dsize = strlen(key_str);
+		dbuf.dptr = (unsigned char *) "root";
+		dbuf.dsize = 4;
+		if (tdb_store(tdb_ctx, key, dbuf, TDB_INSERT) != 0) {
+			fprintf(stderr, "Unable to store handle 0x%x\n", rec->handle);
+			exit (1);
+		}
+		talloc_free(key_str);
+
+		tdb_el = talloc_zero(mem_ctx, struct tdb_handles);
+		tdb_el->handle = rec->handle;
+		DLIST_ADD_END(tdb_list, tdb_el, struct tdb_handles *);
+	}
+
+	start = bench_time();
+	for (i = 0; i < (uint32_t) lookups; i++) {
+		if (!tdb_handles_search(tdb_ctx, tdb_list, handles[i % count])) {
+			fprintf(stderr, "TDB lookup of 0x%x failed\n", handles[i % count]);
+			exit (1);
+		}
+	}
+	tdb_time = bench_time() - start;
+
+	start = bench_time();
+	for (i = 0; i < (uint32_t) lookups; i++) {
+		if (mapi_handles_search(handles_ctx, handles[i % count], &rec) != MAPI_E_SUCCESS) {
+			fprintf(stderr, "Arena lookup of 0x%x failed\n", handles[i % count]);
+			exit (1);
+		}
+	}
+	arena_time = bench_time() - start;
+
+	printf("%8s %8s %12s %12s %8s\n", "handles", "lookups", "tdb(ms)", "arena(ms)", "speedup");
+	printf("%8d %8d %12.3f %12.3f %7.1fx\n", count, lookups, tdb_time * 1e3, arena_time * 1e3,
+	       arena_time > 0 ? tdb_time / arena_time : 0);
+
+	tdb_close(tdb_ctx);
+	mapi_handles_release(handles_ctx);
+	poptFreeContext(pc);
+	talloc_free(mem_ctx);
+
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+   Benchmark mapistore notification fan-out resolution
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <param.h>
+#include <time.h>
+
+static void popt_openchange_version_callback(poptContext con,
+                                             enum poptCallbackReason reason,
+                                             const struct poptOption *opt,
+                                             const char *arg,
+                                             const void *data)
+{
+        switch (opt->val) {
+        case 'V':
+                printf("Version %s\n", OPENCHANGE_VERSION_STRING);
+                exit (0);
+        }
+}
+
+struct poptOption popt_openchange_version[] = {
+        { NULL, '\0', POPT_ARG_CALLBACK, (void *)popt_openchange_version_callback, '\0', NULL, NULL },
+        { "version", 'V', POPT_ARG_NONE, NULL, 'V', "Print version ", NULL },
+        POPT_TABLEEND
+};
+
+#define POPT_OPENCHANGE_VERSION { NULL, 0, POPT_ARG_INCLUDE_TABLE, popt_openchange_version, 0, "Common openchange options:", NULL },
+
+#define	BENCH_DEFAULT_SUBSCRIBERS	10000
+#define	BENCH_DEFAULT_CACHE		"local"
+#define	BENCH_HOST1			"tcp://host1:9005"
+#define	BENCH_HOST2			"tcp://host2:9006"
+
+static double bench_time(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX					*mem_ctx;
+	enum mapistore_error				retval;
+	struct mapistore_context			mstore_ctx;
+	struct loadparm_context				*lp_ctx;
+	struct mapistore_notification_context		*ctx = NULL;
+	struct mapistore_notification_resolver_record	*records = NULL;
+	poptContext					pc;
+	int						opt;
+	int						subscribers = BENCH_DEFAULT_SUBSCRIBERS;
+	const char					*cache = BENCH_DEFAULT_CACHE;
+	const char					**cns;
+	const char					**hosts = NULL;
+	uint32_t					count = 0;
+	uint32_t					i;
+	double						start;
+	double						add_time;
+	double						get_time;
+	double						mget_time;
+
+	enum { OPT_SUBSCRIBERS=1000, OPT_CACHE };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "subscribers", 'n', POPT_ARG_INT, &subscribers, OPT_SUBSCRIBERS, "number of subscribers to resolve", "COUNT" },
+		{ "cache", 'c', POPT_ARG_STRING, &cache, OPT_CACHE, "mapistore:notification_cache connection string", "STRING" },
+		POPT_OPENCHANGE_VERSION
+		{ NULL, 0, 0, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_notification_fanout", argc, argv, long_options, 0);
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_SUBSCRIBERS:
+		case OPT_CACHE:
+			break;
+		}
+	}
+
+	if (subscribers <= 0) {
+		fprintf(stderr, "Invalid number of subscribers: %d\n", subscribers);
+		exit (1);
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_notification_fanout");
+	lp_ctx = loadparm_init(mem_ctx);
+	if (!lp_ctx || !lpcfg_set_cmdline(lp_ctx, "mapistore:notification_cache", cache)) {
+		fprintf(stderr, "Unable to set mapistore:notification_cache\n");
+		exit (1);
+	}
+
+	retval = mapistore_notification_init(mem_ctx, lp_ctx, &ctx);
+	if (retval != MAPISTORE_SUCCESS) {
+		fprintf(stderr, "Unable to initialize notifications: %s\n", mapistore_errstr(retval));
+		exit (1);
+	}
+	memset(&mstore_ctx, 0, sizeof (struct mapistore_context));
+	mstore_ctx.notification_ctx = ctx;
+
+	cns = talloc_array(mem_ctx, const char *, subscribers);
+	if (!cns) {
+		fprintf(stderr, "No more memory\n");
+		exit (1);
+	}
+	for (i = 0; i < (uint32_t) subscribers; i++) {
+		cns[i] = talloc_asprintf(cns, "benchsubscriber%05d", i);
+	}
+
+	/* Register every subscriber on two server instances */
+	start = bench_time();
+	for (i = 0; i < (uint32_t) subscribers; i++) {
+		if (mapistore_notification_resolver_add(&mstore_ctx, cns[i], BENCH_HOST1) != MAPISTORE_SUCCESS ||
+		    mapistore_notification_resolver_add(&mstore_ctx, cns[i], BENCH_HOST2) != MAPISTORE_SUCCESS) {
+			fprintf(stderr, "Unable to register %s\n", cns[i]);
+			exit (1);
+		}
+	}
+	add_time = bench_time() - start;
+
+	/* Resolve the distribution list one subscriber at a time */
+	start = bench_time();
+	for (i = 0; i < (uint32_t) subscribers; i++) {
+		retval = mapistore_notification_resolver_get(mem_ctx, &mstore_ctx, cns[i], &count, &hosts);
+		if (retval != MAPISTORE_SUCCESS || count != 2) {
+			fprintf(stderr, "Unable to resolve %s\n", cns[i]);
+			exit (1);
+		}
+		talloc_free(hosts);
+	}
+	get_time = bench_time() - start;
+
+	/* Resolve it in a single batch */
+	start = bench_time();
+	retval = mapistore_notification_resolver_get_multi(mem_ctx, &mstore_ctx, subscribers, cns, &records);
+	mget_time = bench_time() - start;
+	if (retval != MAPISTORE_SUCCESS) {
+		fprintf(stderr, "Unable to resolve the subscribers: %s\n", mapistore_errstr(retval));
+		exit (1);
+	}
+	for (i = 0; i < (uint32_t) subscribers; i++) {
+		if (records[i].count != 2) {
+			fprintf(stderr, "Unexpected record for %s\n", cns[i]);
+			exit (1);
+		}
+	}
+	talloc_free(records);
+
+	printf("%11s %12s %12s %13s\n", "subscribers", "register(ms)", "get(ms)", "get_multi(ms)");
+	printf("%11d %12.3f %12.3f %13.3f\n", subscribers, add_time * 1e3, get_time * 1e3, mget_time * 1e3);
+
+	/* Unregister the subscribers from a shared memcached server */
+	for (i = 0; i < (uint32_t) subscribers; i++) {
+		mapistore_notification_resolver_delete(&mstore_ctx, cns[i], BENCH_HOST1);
+		mapistore_notification_resolver_delete(&mstore_ctx, cns[i], BENCH_HOST2);
+	}
+
+	poptFreeContext(pc);
+	talloc_free(mem_ctx);
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+/*
+   Benchmark XOR obfuscation of EcDoRpcExt2 buffers
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <time.h>
+
+static void popt_openchange_version_callback(poptContext con,
+                                             enum poptCallbackReason reason,
+                                             const struct poptOption *opt,
+                                             const char *arg,
+                                             const void *data)
+{
+        switch (opt->val) {
+        case 'V':
+                printf("Version %s\n", OPENCHANGE_VERSION_STRING);
+                exit (0);
+        }
+}
+
+struct poptOption popt_openchange_version[] = {
+        { NULL, '\0', POPT_ARG_CALLBACK, (void *)popt_openchange_version_callback, '\0', NULL, NULL },
+        { "version", 'V', POPT_ARG_NONE, NULL, 'V', "Print version ", NULL },
+        POPT_TABLEEND
+};
+
+#define POPT_OPENCHANGE_VERSION { NULL, 0, POPT_ARG_INCLUDE_TABLE, popt_openchange_version, 0, "Common openchange options:", NULL },
+
+#define	BENCH_MIN_SIZE		(32 * 1024)
+#define	BENCH_MAX_SIZE		(1024 * 1024)
+#define	BENCH_DEFAULT_MBYTES	256
+
+/**
+   \details Reference byte-at-a-time implementation
+ */
+static void obfuscate_data_scalar(uint8_t *data, uint32_t size, uint8_t salt)
+{
+	uint32_t	i;
+
+	for (i = 0; i < size; i++) {
+		data[i] ^= salt;
+	}
+}
+
+static double bench_cpu_time(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX	*mem_ctx;
+	poptContext	pc;
+	int		opt;
+	int		mbytes = BENCH_DEFAULT_MBYTES;
+	uint8_t		*buf;
+	uint32_t	size;
+	uint32_t	rounds;
+	uint32_t	i;
+	double		start;
+	double		scalar_time;
+	double		word_time;
+
+	enum { OPT_MBYTES=1000 };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "mbytes", 'm', POPT_ARG_INT, &mbytes, OPT_MBYTES, "number of MiB to obfuscate per buffer size", "COUNT" },
+		POPT_OPENCHANGE_VERSION
+		{ NULL, 0, 0, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_obfuscate", argc, argv, long_options, 0);
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_MBYTES:
+			break;
+		}
+	}
+	poptFreeContext(pc);
+
+	if (mbytes <= 0) {
+		fprintf(stderr, "Invalid number of MiB: %d\n", mbytes);
+		exit (1);
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_obfuscate");
+	buf = talloc_zero_array(mem_ctx, uint8_t, BENCH_MAX_SIZE);
+	if (!buf) {
+		fprintf(stderr, "No more memory\n");
+		exit (1);
+	}
+
+	printf("%8s %7s %10s %10s %7s\n", "size", "rounds", "scalar(s)", "word(s)", "speedup");
+	for (size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size *= 2) {
+		rounds = ((uint64_t)mbytes * 1024 * 1024) / size;
+		if (!rounds) rounds = 1;
+
+		start = bench_cpu_time();
+		for (i = 0; i < rounds; i++) {
+			obfuscate_data_scalar(buf, size, 0xA5);
+		}
+		scalar_time = bench_cpu_time() - start;
+
+		start = bench_cpu_time();
+		for (i = 0; i < rounds; i++) {
+			obfuscate_data(buf, size, 0xA5);
+		}
+		word_time = bench_cpu_time() - start;
+
+		printf("%8u %7u %10.3f %10.3f %6.1fx\n", size, rounds, scalar_time, word_time,
+		       word_time > 0 ? scalar_time / word_time : 0);
+	}
+
+	talloc_free(mem_ctx);
+
+	return 0;
+}
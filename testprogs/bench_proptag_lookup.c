@@ -0,0 +1,184 @@
+/*
+   Benchmark property tag lookups against a linear scan
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <time.h>
+
+static void popt_openchange_version_callback(poptContext con,
+                                             enum poptCallbackReason reason,
+                                             const struct poptOption *opt,
+                                             const char *arg,
+                                             const void *data)
+{
+        switch (opt->val) {
+        case 'V':
+                printf("Version %s\n", OPENCHANGE_VERSION_STRING);
+                exit (0);
+        }
+}
+
+struct poptOption popt_openchange_version[] = {
+        { NULL, '\0', POPT_ARG_CALLBACK, (void *)popt_openchange_version_callback, '\0', NULL, NULL },
+        { "version", 'V', POPT_ARG_NONE, NULL, 'V', "Print version ", NULL },
+        POPT_TABLEEND
+};
+
+#define POPT_OPENCHANGE_VERSION { NULL, 0, POPT_ARG_INCLUDE_TABLE, popt_openchange_version, 0, "Common openchange options:", NULL },
+
+#define	BENCH_DEFAULT_LOOKUPS	1000000
+#define	BENCH_LINEAR_LOOKUPS	20000
+
+/* Reference table for the former linear scan */
+struct proptag_ref {
+	uint32_t	proptag;
+	const char	*propname;
+};
+
+static double bench_time(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX		*mem_ctx;
+	const uint16_t		types[] = { PT_SHORT, PT_LONG, PT_DOUBLE, PT_ERROR, PT_BOOLEAN,
+					    PT_OBJECT, PT_I8, PT_UNICODE, PT_SYSTIME, PT_CLSID,
+					    PT_SVREID, PT_SRESTRICT, PT_ACTIONS, PT_BINARY,
+					    PT_MV_SHORT, PT_MV_LONG, PT_MV_I8, PT_MV_UNICODE,
+					    PT_MV_SYSTIME, PT_MV_CLSID, PT_MV_BINARY };
+	struct proptag_ref	*ref;
+	poptContext		pc;
+	int			opt;
+	int			lookups = BENCH_DEFAULT_LOOKUPS;
+	const char		*propname;
+	uint32_t		proptag;
+	uint32_t		count = 0;
+	uint32_t		i;
+	uint32_t		j;
+	double			start;
+	double			linear_name_time;
+	double			phash_name_time;
+	double			linear_value_time;
+	double			phash_value_time;
+
+	enum { OPT_LOOKUPS=1000 };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "lookups", 'l', POPT_ARG_INT, &lookups, OPT_LOOKUPS, "number of lookups to time", "COUNT" },
+		POPT_OPENCHANGE_VERSION
+		{ NULL, 0, 0, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_proptag_lookup", argc, argv, long_options, 0);
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_LOOKUPS:
+			break;
+		}
+	}
+
+	if (lookups <= 0) {
+		fprintf(stderr, "Invalid number of lookups: %d\n", lookups);
+		exit (1);
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_proptag_lookup");
+
+	/* Collect every canonical property through the public API */
+	ref = talloc_array(mem_ctx, struct proptag_ref, 0x10000);
+	if (!ref) {
+		fprintf(stderr, "No more memory\n");
+		exit (1);
+	}
+	for (i = 1; i < 0x10000; i++) {
+		for (j = 0; j < sizeof (types) / sizeof (types[0]); j++) {
+			proptag = (i << 16) | types[j];
+			propname = get_proptag_name(proptag);
+			if (!propname) continue;
+
+			if (count == talloc_array_length(ref)) {
+				ref = talloc_realloc(mem_ctx, ref, struct proptag_ref, count * 2);
+			}
+			ref[count].proptag = proptag;
+			ref[count].propname = propname;
+			count++;
+		}
+	}
+	if (!count) {
+		fprintf(stderr, "No property tag found\n");
+		exit (1);
+	}
+
+	/* Linear scan, as the lookups were implemented before */
+	start = bench_time();
+	for (i = 0; i < BENCH_LINEAR_LOOKUPS; i++) {
+		proptag = ref[(i * 7919) % count].proptag;
+		for (j = 0; j < count && ref[j].proptag != proptag; j++);
+	}
+	linear_name_time = (bench_time() - start) / BENCH_LINEAR_LOOKUPS;
+
+	start = bench_time();
+	for (i = 0; i < (uint32_t) lookups; i++) {
+		if (!get_proptag_name(ref[(i * 7919) % count].proptag)) {
+			fprintf(stderr, "Lookup of 0x%.8x failed\n", ref[(i * 7919) % count].proptag);
+			exit (1);
+		}
+	}
+	phash_name_time = (bench_time() - start) / lookups;
+
+	start = bench_time();
+	for (i = 0; i < BENCH_LINEAR_LOOKUPS; i++) {
+		propname = ref[(i * 7919) % count].propname;
+		for (j = 0; j < count && strcmp(ref[j].propname, propname); j++);
+	}
+	linear_value_time = (bench_time() - start) / BENCH_LINEAR_LOOKUPS;
+
+	start = bench_time();
+	for (i = 0; i < (uint32_t) lookups; i++) {
+		if (get_proptag_value(ref[(i * 7919) % count].propname) != ref[(i * 7919) % count].proptag) {
+			fprintf(stderr, "Lookup of %s failed\n", ref[(i * 7919) % count].propname);
+			exit (1);
+		}
+	}
+	phash_value_time = (bench_time() - start) / lookups;
+
+	printf("%18s %6s %12s %12s %8s\n", "function", "tags", "linear(ns)", "phash(ns)", "speedup");
+	printf("%18s %6u %12.1f %12.1f %7.1fx\n", "get_proptag_name", count,
+	       linear_name_time * 1e9, phash_name_time * 1e9,
+	       phash_name_time > 0 ? linear_name_time / phash_name_time : 0);
+	printf("%18s %6u %12.1f %12.1f %7.1fx\n", "get_proptag_value", count,
+	       linear_value_time * 1e9, phash_value_time * 1e9,
+	       phash_value_time > 0 ? linear_value_time / phash_value_time : 0);
+
+	poptFreeContext(pc);
+	talloc_free(mem_ctx);
+
+	return 0;
+}
@@ -0,0 +1,286 @@
+/*
+   Benchmark EcDoRpcExt2 request compression
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libmapi/libmapi.h"
+#include "gen_ndr/ndr_exchange.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <time.h>
+
+static void popt_openchange_version_callback(poptContext con,
+                                             enum poptCallbackReason reason,
+                                             const struct poptOption *opt,
+                                             const char *arg,
+                                             const void *data)
+{
+        switch (opt->val) {
+        case 'V':
+                printf("Version %s\n", OPENCHANGE_VERSION_STRING);
+                exit (0);
+        }
+}
+
+struct poptOption popt_openchange_version[] = {
+        { NULL, '\0', POPT_ARG_CALLBACK, (void *)popt_openchange_version_callback, '\0', NULL, NULL },
+        { "version", 'V', POPT_ARG_NONE, NULL, 'V', "Print version ", NULL },
+        POPT_TABLEEND
+};
+
+#define POPT_OPENCHANGE_VERSION { NULL, 0, POPT_ARG_INCLUDE_TABLE, popt_openchange_version, 0, "Common openchange options:", NULL },
+
+#define	BENCH_DEFAULT_ITERATIONS	1000
+
+static const char	lorem[] = "Dear team, please find attached the minutes of "
+	"today's meeting. The next review is scheduled for Monday; "
+	"make sure the action items below are updated before then.\r\n";
+
+/**
+   \details Fill in the lengths and handle array of a request made of
+   count ROPs so it can be pushed by ndr_push_mapi_request
+
+   \param mem_ctx pointer to the memory context
+   \param req pointer to the request to finalize
+   \param count number of ROPs in req->mapi_req
+
+   \return true on success, otherwise false
+ */
+static bool bench_finalize_request(TALLOC_CTX *mem_ctx, struct mapi_request *req,
+				   uint32_t count)
+{
+	struct ndr_push		*ndr;
+	enum ndr_err_code	ndr_err;
+	uint32_t		i;
+
+	ndr = ndr_push_init_ctx(mem_ctx);
+	if (!ndr) return false;
+	ndr_set_flags(&ndr->flags, LIBNDR_FLAG_NOALIGN);
+
+	for (i = 0; i < count; i++) {
+		ndr_err = ndr_push_EcDoRpc_MAPI_REQ(ndr, NDR_SCALARS, &req->mapi_req[i]);
+		if (ndr_err != NDR_ERR_SUCCESS) {
+			talloc_free(ndr);
+			return false;
+		}
+	}
+
+	req->length = ndr->offset + sizeof (uint16_t);
+	req->mapi_len = req->length + sizeof (uint32_t) * 2;
+	req->handles = talloc_array(req, uint32_t, 2);
+	req->handles[0] = 0x00000001;
+	req->handles[1] = 0xffffffff;
+	talloc_free(ndr);
+
+	return true;
+}
+
+/**
+   \details Build a single WriteStream ROP carrying size bytes of
+   either text (compressible) or pseudo-random (incompressible) data
+ */
+static struct mapi_request *bench_WriteStream(TALLOC_CTX *mem_ctx, uint32_t size, bool text)
+{
+	struct mapi_request	*req;
+	uint8_t			*data;
+	uint32_t		i;
+
+	req = talloc_zero(mem_ctx, struct mapi_request);
+	req->mapi_req = talloc_zero_array(req, struct EcDoRpc_MAPI_REQ, 1);
+	data = talloc_array(req, uint8_t, size);
+	for (i = 0; i < size; i++) {
+		data[i] = text ? lorem[i % (sizeof (lorem) - 1)] : (uint8_t)random();
+	}
+
+	req->mapi_req[0].opnum = op_MAPI_WriteStream;
+	req->mapi_req[0].u.mapi_WriteStream.data.data = data;
+	req->mapi_req[0].u.mapi_WriteStream.data.length = size;
+
+	return bench_finalize_request(mem_ctx, req, 1) ? req : NULL;
+}
+
+/**
+   \details Build a SetProps ROP setting the envelope properties a
+   client typically uploads when saving a new message
+ */
+static struct mapi_request *bench_SetProps(TALLOC_CTX *mem_ctx)
+{
+	struct mapi_request	*req;
+	struct mapi_SPropValue	*lpProps;
+
+	req = talloc_zero(mem_ctx, struct mapi_request);
+	req->mapi_req = talloc_zero_array(req, struct EcDoRpc_MAPI_REQ, 1);
+	lpProps = talloc_zero_array(req, struct mapi_SPropValue, 6);
+
+	lpProps[0].ulPropTag = PR_SUBJECT_UNICODE;
+	lpProps[0].value.lpszW = "Minutes of the weekly review meeting";
+	lpProps[1].ulPropTag = PR_DISPLAY_TO_UNICODE;
+	lpProps[1].value.lpszW = "Alice Example; Bob Example; Carol Example";
+	lpProps[2].ulPropTag = PR_DISPLAY_CC_UNICODE;
+	lpProps[2].value.lpszW = "Dave Example; Eve Example";
+	lpProps[3].ulPropTag = PR_BODY_UNICODE;
+	lpProps[3].value.lpszW = talloc_asprintf(req, "%s%s%s%s", lorem, lorem, lorem, lorem);
+	lpProps[4].ulPropTag = PR_MESSAGE_FLAGS;
+	lpProps[4].value.l = MSGFLAG_UNSENT;
+	lpProps[5].ulPropTag = PR_IMPORTANCE;
+	lpProps[5].value.l = 1;
+
+	req->mapi_req[0].opnum = op_MAPI_SetProps;
+	req->mapi_req[0].u.mapi_SetProps.values.cValues = 6;
+	req->mapi_req[0].u.mapi_SetProps.values.lpProps = lpProps;
+
+	return bench_finalize_request(mem_ctx, req, 1) ? req : NULL;
+}
+
+/**
+   \details Build a batch of count OpenMessage ROPs on consecutive
+   message identifiers, as produced by mapi_batch_OpenMessage
+ */
+static struct mapi_request *bench_OpenMessage_batch(TALLOC_CTX *mem_ctx, uint32_t count)
+{
+	struct mapi_request	*req;
+	uint32_t		i;
+
+	req = talloc_zero(mem_ctx, struct mapi_request);
+	req->mapi_req = talloc_zero_array(req, struct EcDoRpc_MAPI_REQ, count);
+	for (i = 0; i < count; i++) {
+		req->mapi_req[i].opnum = op_MAPI_OpenMessage;
+		req->mapi_req[i].handle_idx = 1;
+		req->mapi_req[i].u.mapi_OpenMessage.handle_idx = 1;
+		req->mapi_req[i].u.mapi_OpenMessage.CodePageId = 0xfff;
+		req->mapi_req[i].u.mapi_OpenMessage.FolderId = 0x0000000000010001ULL;
+		req->mapi_req[i].u.mapi_OpenMessage.OpenModeFlags = ReadOnly;
+		req->mapi_req[i].u.mapi_OpenMessage.MessageId = 0x0000000000200001ULL + ((uint64_t)i << 48);
+	}
+
+	return bench_finalize_request(mem_ctx, req, count) ? req : NULL;
+}
+
+/**
+   \details Build a single Release ROP, the smallest request a client sends
+ */
+static struct mapi_request *bench_Release(TALLOC_CTX *mem_ctx)
+{
+	struct mapi_request	*req;
+
+	req = talloc_zero(mem_ctx, struct mapi_request);
+	req->mapi_req = talloc_zero_array(req, struct EcDoRpc_MAPI_REQ, 1);
+	req->mapi_req[0].opnum = op_MAPI_Release;
+
+	return bench_finalize_request(mem_ctx, req, 1) ? req : NULL;
+}
+
+static double bench_cpu_time(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+   \details Build the rgbIn buffer of req iterations times, with and
+   without compression, and print wire size and CPU cost per request
+ */
+static void bench_run(TALLOC_CTX *mem_ctx, const char *name, struct mapi_request *req,
+		      uint32_t iterations)
+{
+	struct ndr_push	*ndr;
+	uint32_t	plain_size = 0;
+	uint32_t	wire_size = 0;
+	double		plain_time;
+	double		wire_time;
+	double		start;
+	uint32_t	i;
+
+	if (!req) {
+		printf("%-24s  failed to build request\n", name);
+		return;
+	}
+
+	start = bench_cpu_time();
+	for (i = 0; i < iterations; i++) {
+		ndr = emsmdb_ext2_rgbIn(mem_ctx, req, false);
+		if (!ndr) return;
+		plain_size = ndr->offset;
+		talloc_free(ndr);
+	}
+	plain_time = bench_cpu_time() - start;
+
+	start = bench_cpu_time();
+	for (i = 0; i < iterations; i++) {
+		ndr = emsmdb_ext2_rgbIn(mem_ctx, req, true);
+		if (!ndr) return;
+		wire_size = ndr->offset;
+		talloc_free(ndr);
+	}
+	wire_time = bench_cpu_time() - start;
+
+	printf("%-24s %8u %8u %6.1f%% %10.2f %10.2f\n", name, plain_size, wire_size,
+	       100.0 * wire_size / plain_size,
+	       plain_time * 1e6 / iterations, wire_time * 1e6 / iterations);
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX	*mem_ctx;
+	poptContext	pc;
+	int		opt;
+	int		iterations = BENCH_DEFAULT_ITERATIONS;
+
+	enum { OPT_ITERATIONS=1000 };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "iterations", 'n', POPT_ARG_INT, &iterations, OPT_ITERATIONS, "number of iterations per request", "COUNT" },
+		POPT_OPENCHANGE_VERSION
+		{ NULL, 0, 0, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_request_compression", argc, argv, long_options, 0);
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_ITERATIONS:
+			break;
+		}
+	}
+	poptFreeContext(pc);
+
+	if (iterations <= 0) {
+		fprintf(stderr, "Invalid number of iterations: %d\n", iterations);
+		exit (1);
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_request_compression");
+	srandom(0x5eed);
+
+	printf("%-24s %8s %8s %7s %10s %10s\n", "request", "plain", "wire", "ratio",
+	       "plain(us)", "lzx(us)");
+	bench_run(mem_ctx, "Release", bench_Release(mem_ctx), iterations);
+	bench_run(mem_ctx, "SetProps (envelope)", bench_SetProps(mem_ctx), iterations);
+	bench_run(mem_ctx, "OpenMessage x30", bench_OpenMessage_batch(mem_ctx, 30), iterations);
+	bench_run(mem_ctx, "WriteStream text 4k", bench_WriteStream(mem_ctx, 4096, true), iterations);
+	bench_run(mem_ctx, "WriteStream text 16k", bench_WriteStream(mem_ctx, 16384, true), iterations);
+	bench_run(mem_ctx, "WriteStream random 16k", bench_WriteStream(mem_ctx, 16384, false), iterations);
+
+	talloc_free(mem_ctx);
+
+	return 0;
+}
@@ -0,0 +1,194 @@
+/*
+   Benchmark EMSMDBP stream uploads
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mapiproxy/dcesrv_mapiproxy.h"
+#include "mapiproxy/servers/default/emsmdb/dcesrv_exchange_emsmdb.h"
+
+#include <popt.h>
+#include <talloc.h>
+#include <time.h>
+
+static void popt_openchange_version_callback(poptContext con,
+                                             enum poptCallbackReason reason,
+                                             const struct poptOption *opt,
+                                             const char *arg,
+                                             const void *data)
+{
+        switch (opt->val) {
+        case 'V':
+                printf("Version %s\n", OPENCHANGE_VERSION_STRING);
+                exit (0);
+        }
+}
+
+struct poptOption popt_openchange_version[] = {
+        { NULL, '\0', POPT_ARG_CALLBACK, (void *)popt_openchange_version_callback, '\0', NULL, NULL },
+        { "version", 'V', POPT_ARG_NONE, NULL, 'V', "Print version ", NULL },
+        POPT_TABLEEND
+};
+
+#define POPT_OPENCHANGE_VERSION { NULL, 0, POPT_ARG_INCLUDE_TABLE, popt_openchange_version, 0, "Common openchange options:", NULL },
+
+/* Size of the RopWriteStream buffers sent by Outlook */
+#define	BENCH_WRITE_SIZE		(30 * 1024)
+#define	BENCH_DEFAULT_MAX_MBYTES	100
+
+/**
+   \details Reference implementation of the former exact-size realloc
+   growth, quadratic in the stream size
+ */
+static void stream_write_exact(TALLOC_CTX *mem_ctx, struct emsmdbp_stream *stream, DATA_BLOB new_buffer)
+{
+	size_t	new_position;
+
+	new_position = stream->position + new_buffer.length;
+	if (new_position >= stream->buffer.length) {
+		stream->buffer.length = new_position;
+		stream->buffer.data = talloc_realloc(mem_ctx, stream->buffer.data, uint8_t, stream->buffer.length);
+	}
+	memcpy(stream->buffer.data + stream->position, new_buffer.data, new_buffer.length);
+	stream->position = new_position;
+}
+
+static double bench_time(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+   \details Upload size bytes to an empty stream in BENCH_WRITE_SIZE
+   writes
+
+   \return the elapsed time in seconds, a negative value on failure
+ */
+static double bench_upload(TALLOC_CTX *mem_ctx, const uint8_t *data, size_t size, bool exact)
+{
+	TALLOC_CTX		*local_mem_ctx;
+	struct emsmdbp_stream	stream;
+	DATA_BLOB		blob;
+	size_t			offset;
+	double			start;
+	double			elapsed;
+
+	local_mem_ctx = talloc_new(mem_ctx);
+	memset(&stream, 0, sizeof (struct emsmdbp_stream));
+
+	start = bench_time();
+	for (offset = 0; offset < size; offset += blob.length) {
+		blob.data = (uint8_t *) data;
+		blob.length = (size - offset < BENCH_WRITE_SIZE) ? size - offset : BENCH_WRITE_SIZE;
+		if (exact) {
+			stream_write_exact(local_mem_ctx, &stream, blob);
+		} else if (emsmdbp_stream_write_buffer(local_mem_ctx, &stream, blob) != MAPI_E_SUCCESS) {
+			talloc_free(local_mem_ctx);
+			return -1;
+		}
+	}
+	elapsed = bench_time() - start;
+
+	if (stream.buffer.length != size) {
+		elapsed = -1;
+	}
+	emsmdbp_stream_reset(&stream);
+	talloc_free(local_mem_ctx);
+
+	return elapsed;
+}
+
+int main(int argc, const char *argv[])
+{
+	TALLOC_CTX	*mem_ctx;
+	poptContext	pc;
+	int		opt;
+	int		max_mbytes = BENCH_DEFAULT_MAX_MBYTES;
+	const char	*spill_directory = NULL;
+	const int	sizes[] = { 1, 10, 30, 100, 0 };
+	uint8_t		*data;
+	size_t		size;
+	uint32_t	i;
+	double		exact_time;
+	double		rope_time;
+	double		spill_time;
+
+	enum { OPT_MAX_MBYTES=1000, OPT_SPILL_DIRECTORY };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "max-mbytes", 'm', POPT_ARG_INT, &max_mbytes, OPT_MAX_MBYTES, "largest stream size to upload in MiB", "COUNT" },
+		{ "spill-directory", 'd', POPT_ARG_STRING, &spill_directory, OPT_SPILL_DIRECTORY, "directory where spilled streams are written", "PATH" },
+		POPT_OPENCHANGE_VERSION
+		{ NULL, 0, 0, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("bench_stream_upload", argc, argv, long_options, 0);
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_MAX_MBYTES:
+		case OPT_SPILL_DIRECTORY:
+			break;
+		}
+	}
+
+	if (max_mbytes <= 0) {
+		fprintf(stderr, "Invalid number of MiB: %d\n", max_mbytes);
+		exit (1);
+	}
+
+	mem_ctx = talloc_named(NULL, 0, "bench_stream_upload");
+	data = talloc_array(mem_ctx, uint8_t, BENCH_WRITE_SIZE);
+	if (!data) {
+		fprintf(stderr, "No more memory\n");
+		exit (1);
+	}
+	for (i = 0; i < BENCH_WRITE_SIZE; i++) {
+		data[i] = (uint8_t)(i * 31 + 7);
+	}
+
+	printf("%5s %10s %10s %10s %7s\n", "MiB", "exact(s)", "rope(s)", "spill(s)", "speedup");
+	for (i = 0; sizes[i] && sizes[i] <= max_mbytes; i++) {
+		size = (size_t) sizes[i] * 1024 * 1024;
+
+		exact_time = bench_upload(mem_ctx, data, size, true);
+
+		emsmdbp_stream_set_spill(0, NULL);
+		rope_time = bench_upload(mem_ctx, data, size, false);
+
+		emsmdbp_stream_set_spill(EMSMDBP_STREAM_SPILL_THRESHOLD, spill_directory);
+		spill_time = bench_upload(mem_ctx, data, size, false);
+
+		if (exact_time < 0 || rope_time < 0 || spill_time < 0) {
+			fprintf(stderr, "Upload of %d MiB failed\n", sizes[i]);
+			exit (1);
+		}
+
+		printf("%5d %10.3f %10.3f %10.3f %6.1fx\n", sizes[i], exact_time, rope_time, spill_time,
+		       rope_time > 0 ? exact_time / rope_time : 0);
+	}
+
+	emsmdbp_stream_set_spill(0, NULL);
+	poptFreeContext(pc);
+	talloc_free(mem_ctx);
+
+	return 0;
+}
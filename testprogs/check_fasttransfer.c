@@ -28,6 +28,7 @@
 #include <ldb.h>
 #include <talloc.h>
 #include <inttypes.h>
+#include <time.h>
 
 static void popt_openchange_version_callback(poptContext con,
                                              enum poptCallbackReason reason,
@@ -226,6 +227,38 @@ static enum MAPISTATUS dump_property(struct SPropValue prop, void *priv)
 	return MAPI_E_SUCCESS;
 }
 
+/* Benchmark helpers */
+static double elapsed_ms(const struct timespec *start)
+{
+	struct timespec	now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/* Return the peak resident set size of a process in kB, -1 if unknown */
+static long peak_rss_kb(const char *pid)
+{
+	FILE	*f;
+	char	path[64];
+	char	line[256];
+	long	rss = -1;
+
+	snprintf(path, sizeof (path), "/proc/%s/status", pid);
+	f = fopen(path, "r");
+	if (!f) {
+		return -1;
+	}
+	while (fgets(line, sizeof (line), f)) {
+		if (sscanf(line, "VmHWM: %ld kB", &rss) == 1) {
+			break;
+		}
+	}
+	fclose(f);
+
+	return rss;
+}
+
 int main(int argc, const char *argv[])
 {
 	TALLOC_CTX			*mem_ctx;
@@ -256,8 +289,18 @@ int main(int argc, const char *argv[])
 	bool				opt_showprogress = false;
 	bool				opt_dumpdata = false;
 	const char			*opt_debug = NULL;
-
-	enum {OPT_PROFILE_DB=1000, OPT_PROFILE, OPT_PASSWORD, OPT_MAXDATA, OPT_SHOWPROGRESS, OPT_MAPISTORE, OPT_DEBUG, OPT_DUMPDATA};
+	bool				opt_sync = false;
+	bool				opt_benchmark = false;
+	const char			*opt_server_pid = NULL;
+	struct timespec			start;
+	double				first_buffer_ms = 0;
+	uint64_t			transferred = 0;
+	struct SPropTagArray		*property_tags;
+	DATA_BLOB			restriction;
+	DATA_BLOB			ics_state;
+
+	enum {OPT_PROFILE_DB=1000, OPT_PROFILE, OPT_PASSWORD, OPT_MAXDATA, OPT_SHOWPROGRESS, OPT_MAPISTORE, OPT_DEBUG, OPT_DUMPDATA,
+	      OPT_SYNC, OPT_BENCHMARK, OPT_SERVER_PID};
 
 	struct poptOption long_options[] = {
 		POPT_AUTOHELP
@@ -269,6 +312,9 @@ int main(int argc, const char *argv[])
 		{"mapistore", 0, POPT_ARG_STRING, NULL, OPT_MAPISTORE, "serialise to mapistore", "FILESYSTEM_PATH"},
 		{"debuglevel", 'd', POPT_ARG_STRING, NULL, OPT_DEBUG, "set the debug level", "LEVEL"},
 		{"dump-data", 0, POPT_ARG_NONE, NULL, OPT_DUMPDATA, "dump the transfer data", NULL},
+		{"sync", 0, POPT_ARG_NONE, NULL, OPT_SYNC, "download the Inbox contents with ICS instead of copying the store", NULL},
+		{"benchmark", 0, POPT_ARG_NONE, NULL, OPT_BENCHMARK, "report transfer timings and peak memory usage", NULL},
+		{"server-pid", 0, POPT_ARG_STRING, NULL, OPT_SERVER_PID, "server process to report the peak memory usage of", "PID"},
 		POPT_OPENCHANGE_VERSION
 		{ NULL, 0, POPT_ARG_NONE, NULL, 0, NULL, NULL }
 	};
@@ -289,7 +335,7 @@ int main(int argc, const char *argv[])
 			opt_password = poptGetOptArg(pc);
 			break;
 		case OPT_MAXDATA:
-			opt_maxsize = *poptGetOptArg(pc);
+			opt_maxsize = atoi(poptGetOptArg(pc));
 			break;
 		case OPT_SHOWPROGRESS:
 			opt_showprogress = true;
@@ -303,6 +349,15 @@ int main(int argc, const char *argv[])
 		case OPT_DUMPDATA:
 			opt_dumpdata = true;
 			break;
+		case OPT_SYNC:
+			opt_sync = true;
+			break;
+		case OPT_BENCHMARK:
+			opt_benchmark = true;
+			break;
+		case OPT_SERVER_PID:
+			opt_server_pid = poptGetOptArg(pc);
+			break;
 		}
 	}
 
@@ -359,8 +414,8 @@ int main(int argc, const char *argv[])
 		exit (1);
 	}
 
-	/* Open the top level folder */
-	retval = GetDefaultFolder(&obj_store, &id_folder, olFolderTopInformationStore);
+	/* Open the top level folder, or the Inbox for a content synchronization */
+	retval = GetDefaultFolder(&obj_store, &id_folder, opt_sync ? olFolderInbox : olFolderTopInformationStore);
 	if (retval != MAPI_E_SUCCESS) {
 		mapi_errstr("GetReceiveFolder", retval);
 		exit (1);
@@ -372,10 +427,40 @@ int main(int argc, const char *argv[])
 		exit (1);
 	}
 
-	retval = FXCopyFolder(&obj_folder, FastTransferCopyFolder_CopySubfolders, FastTransfer_Unicode, &obj_fx_context);
-	if (retval != MAPI_E_SUCCESS) {
-		mapi_errstr("FXCopyFolder", retval);
-		exit (1);
+	if (opt_sync) {
+		/* Initial synchronization: the uploaded state is empty */
+		property_tags = set_SPropTagArray(mem_ctx, 0x0);
+		restriction.length = 0;
+		restriction.data = NULL;
+		retval = ICSSyncConfigure(&obj_folder, Contents, FastTransfer_Unicode,
+					  SynchronizationFlag_Unicode | SynchronizationFlag_Normal | SynchronizationFlag_NoForeignIdentifiers | SynchronizationFlag_BestBody,
+					  Eid | Cn | OrderByDeliveryTime,
+					  restriction, property_tags, &obj_fx_context);
+		if (retval != MAPI_E_SUCCESS) {
+			mapi_errstr("ICSSyncConfigure", retval);
+			exit (1);
+		}
+
+		retval = ICSSyncUploadStateBegin(&obj_fx_context, MetaTagIdsetGiven, 0);
+		if (retval == MAPI_E_SUCCESS) {
+			ics_state.length = 0;
+			ics_state.data = NULL;
+			retval = ICSSyncUploadStateContinue(&obj_fx_context, ics_state);
+		}
+		if (retval == MAPI_E_SUCCESS) {
+			retval = ICSSyncUploadStateEnd(&obj_fx_context);
+		}
+		if (retval != MAPI_E_SUCCESS) {
+			mapi_errstr("ICSSyncUploadState", retval);
+			exit (1);
+		}
+	}
+	else {
+		retval = FXCopyFolder(&obj_folder, FastTransferCopyFolder_CopySubfolders, FastTransfer_Unicode, &obj_fx_context);
+		if (retval != MAPI_E_SUCCESS) {
+			mapi_errstr("FXCopyFolder", retval);
+			exit (1);
+		}
 	}
 
 	if (opt_mapistore) {
@@ -425,6 +510,7 @@ int main(int argc, const char *argv[])
 		parser = fxparser_init(mem_ctx, NULL);
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &start);
 	do {
 		retval = FXGetBuffer(&obj_fx_context, opt_maxsize, &fxTransferStatus, &progressCount, &totalStepCount, &transferdata);
 		transfers++;
@@ -432,6 +518,10 @@ int main(int argc, const char *argv[])
 			mapi_errstr("FXGetBuffer", retval);
 			exit (1);
 		}
+		if (transfers == 1) {
+			first_buffer_ms = elapsed_ms(&start);
+		}
+		transferred += transferdata.length;
 
 		if (opt_showprogress) {
 			printf("progress: (%d/%d)\n", progressCount, totalStepCount);
@@ -443,6 +533,16 @@ int main(int argc, const char *argv[])
 
 	printf("total transfers: %i\n", transfers);
 
+	if (opt_benchmark) {
+		printf("time to first buffer: %.3f ms\n", first_buffer_ms);
+		printf("total transfer time: %.3f ms\n", elapsed_ms(&start));
+		printf("bytes transferred: %"PRIu64"\n", transferred);
+		printf("client peak RSS: %ld kB\n", peak_rss_kb("self"));
+		if (opt_server_pid) {
+			printf("server peak RSS: %ld kB\n", peak_rss_kb(opt_server_pid));
+		}
+	}
+
 	if (opt_mapistore) {
 		mretval = mapistore_del_context(output_ctx.mstore_ctx, output_ctx.mapistore_context_id);
 		if (mretval != MAPISTORE_SUCCESS) {
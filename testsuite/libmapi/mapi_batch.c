@@ -0,0 +1,276 @@
+/*
+   MAPI batch Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "libmapi/mapi_batch.c"
+
+#define	STORE_HANDLE		0x100
+#define	STRING_TAGS_COUNT	10
+#define	OBJECTS_COUNT		300
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct mapi_session	*session;
+static struct mapi_batch	*batch;
+static mapi_object_t		obj_store;
+
+static void init_object(mapi_object_t *obj, mapi_handle_t handle)
+{
+	mapi_object_init(obj);
+	mapi_object_set_session(obj, session);
+	mapi_object_set_handle(obj, handle);
+	mapi_object_set_logon_id(obj, 0);
+}
+
+/* Mark the operations of the last request as processed */
+static void complete_request(void)
+{
+	uint32_t	i;
+
+	for (i = 0; i < batch->count; i++) {
+		if (batch->ops[i].in_round) {
+			batch->ops[i].in_round = false;
+			mapi_batch_op_done(&batch->ops[i], MAPI_E_SUCCESS);
+		}
+	}
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_mapi_batch_build_buffer_limit) {
+	struct SPropTagArray	tags;
+	enum MAPITAGS		aulPropTag[STRING_TAGS_COUNT];
+	struct SPropValue	*lpProps[8];
+	uint32_t		PropCount[8];
+	struct mapi_request	*request;
+	uint32_t		fit;
+	uint32_t		i;
+
+	/* String properties are estimated at MAPI_BATCH_VARIABLE_PROP
+	 * bytes each in the response */
+	for (i = 0; i < STRING_TAGS_COUNT; i++) {
+		aulPropTag[i] = PidTagDisplayName;
+	}
+	tags.cValues = STRING_TAGS_COUNT;
+	tags.aulPropTag = aulPropTag;
+	for (i = 0; i < 8; i++) {
+		ck_assert_int_eq(mapi_batch_GetProps(batch, &obj_store, MAPI_UNICODE, &tags,
+						     &lpProps[i], &PropCount[i], NULL), MAPI_E_SUCCESS);
+	}
+
+	/* As many operations as the estimated response can hold */
+	fit = (MAPI_BATCH_MAX_BUFFER - sizeof (uint16_t) - sizeof (uint32_t)) / batch->ops[0].repl_size;
+	ck_assert(fit > 0 && fit < 8);
+	ck_assert_int_eq(mapi_batch_build(batch, mem_ctx, 0, &request), fit);
+	ck_assert_int_eq(request->length, sizeof (uint16_t) + fit * batch->ops[0].req_size);
+	ck_assert_int_eq(request->mapi_len, request->length + sizeof (uint32_t));
+	ck_assert_int_eq(request->handles[0], STORE_HANDLE);
+	ck_assert_int_eq(request->mapi_req[fit].opnum, 0);
+	for (i = 0; i < fit; i++) {
+		ck_assert_int_eq(request->mapi_req[i].opnum, op_MAPI_GetProps);
+		ck_assert_int_eq(request->mapi_req[i].handle_idx, 0);
+	}
+	ck_assert(!batch->ops[fit].in_round);
+
+	/* The remaining operations go with the next request */
+	complete_request();
+	ck_assert_int_eq(mapi_batch_build(batch, mem_ctx, fit, &request), 8 - fit);
+
+	complete_request();
+	ck_assert_int_eq(mapi_batch_build(batch, mem_ctx, 8, &request), 0);
+} END_TEST
+
+START_TEST (test_mapi_batch_build_handle_limit) {
+	struct SPropTagArray	tags;
+	enum MAPITAGS		aulPropTag = PidTagMessageFlags;
+	mapi_object_t		*objects;
+	struct SPropValue	**lpProps;
+	uint32_t		*PropCount;
+	struct mapi_request	*request;
+	uint32_t		i;
+
+	objects = talloc_array(mem_ctx, mapi_object_t, OBJECTS_COUNT);
+	lpProps = talloc_array(mem_ctx, struct SPropValue *, OBJECTS_COUNT);
+	PropCount = talloc_array(mem_ctx, uint32_t, OBJECTS_COUNT);
+	ck_assert(objects && lpProps && PropCount);
+
+	/* Small operations on distinct objects: the handle table is the
+	 * limit */
+	tags.cValues = 1;
+	tags.aulPropTag = &aulPropTag;
+	for (i = 0; i < OBJECTS_COUNT; i++) {
+		init_object(&objects[i], STORE_HANDLE + 1 + i);
+		ck_assert_int_eq(mapi_batch_GetProps(batch, &objects[i], 0, &tags,
+						     &lpProps[i], &PropCount[i], NULL), MAPI_E_SUCCESS);
+	}
+
+	ck_assert_int_eq(mapi_batch_build(batch, mem_ctx, 0, &request), MAPI_BATCH_MAX_HANDLES);
+	ck_assert_int_eq(request->mapi_len - request->length, MAPI_BATCH_MAX_HANDLES * sizeof (uint32_t));
+	for (i = 0; i < MAPI_BATCH_MAX_HANDLES; i++) {
+		ck_assert_int_eq(request->mapi_req[i].handle_idx, i);
+		ck_assert_int_eq(request->handles[i], STORE_HANDLE + 1 + i);
+	}
+
+	complete_request();
+	ck_assert_int_eq(mapi_batch_build(batch, mem_ctx, MAPI_BATCH_MAX_HANDLES, &request),
+			 OBJECTS_COUNT - MAPI_BATCH_MAX_HANDLES);
+	ck_assert_int_eq(request->handles[0], STORE_HANDLE + 1 + MAPI_BATCH_MAX_HANDLES);
+} END_TEST
+
+START_TEST (test_mapi_batch_build_chained_handles) {
+	struct SPropTagArray	tags;
+	enum MAPITAGS		aulPropTag = PidTagMessageFlags;
+	mapi_object_t		obj_message;
+	struct SPropValue	*lpProps;
+	uint32_t		PropCount;
+	struct mapi_request	*request;
+
+	/* Operations on a message opened in the same request refer to the
+	 * handle index OpenMessage fills */
+	tags.cValues = 1;
+	tags.aulPropTag = &aulPropTag;
+	mapi_object_init(&obj_message);
+	ck_assert_int_eq(mapi_batch_OpenMessage(batch, &obj_store, 0x1, 0x2, &obj_message, 0, NULL), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_batch_GetProps(batch, &obj_message, 0, &tags, &lpProps, &PropCount, NULL), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_batch_Release(batch, &obj_message, NULL), MAPI_E_SUCCESS);
+
+	ck_assert_int_eq(mapi_batch_build(batch, mem_ctx, 0, &request), 3);
+	ck_assert_int_eq(request->mapi_len - request->length, 2 * sizeof (uint32_t));
+	ck_assert_int_eq(request->handles[0], STORE_HANDLE);
+	ck_assert_int_eq(request->handles[1], 0xffffffff);
+	ck_assert_int_eq(request->mapi_req[0].handle_idx, 0);
+	ck_assert_int_eq(request->mapi_req[0].u.mapi_OpenMessage.handle_idx, 1);
+	ck_assert_int_eq(request->mapi_req[1].handle_idx, 1);
+	ck_assert_int_eq(request->mapi_req[2].handle_idx, 1);
+} END_TEST
+
+START_TEST (test_mapi_batch_buffer_too_small) {
+	struct SPropTagArray		tags;
+	enum MAPITAGS			aulPropTag = PidTagMessageFlags;
+	struct SPropValue		*lpProps[3];
+	uint32_t			PropCount[3];
+	enum MAPISTATUS			retval[3];
+	struct mapi_request		*request;
+	struct mapi_response		response;
+	struct EcDoRpc_MAPI_REPL	repl[2];
+	/* PidTagMessageFlags value, then a RopBufferTooSmall response */
+	uint8_t				prop_data[] = { 0x2a, 0x00, 0x00, 0x00,
+							0xff, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	uint32_t			i;
+
+	tags.cValues = 1;
+	tags.aulPropTag = &aulPropTag;
+	for (i = 0; i < 3; i++) {
+		ck_assert_int_eq(mapi_batch_GetProps(batch, &obj_store, 0, &tags,
+						     &lpProps[i], &PropCount[i], &retval[i]), MAPI_E_SUCCESS);
+	}
+	ck_assert_int_eq(mapi_batch_build(batch, mem_ctx, 0, &request), 3);
+
+	/* The server only processed the first ROP */
+	memset(repl, 0, sizeof (repl));
+	repl[0].opnum = op_MAPI_GetProps;
+	repl[0].error_code = MAPI_E_SUCCESS;
+	repl[0].u.mapi_GetProps.layout = 0;
+	repl[0].u.mapi_GetProps.prop_data.data = prop_data;
+	repl[0].u.mapi_GetProps.prop_data.length = sizeof (prop_data);
+	memset(&response, 0, sizeof (response));
+	response.mapi_repl = repl;
+	response.handles = request->handles;
+
+	ck_assert_int_eq(mapi_batch_process(batch, mem_ctx, 0, &response), 1);
+	ck_assert_int_eq(retval[0], MAPI_E_SUCCESS);
+	ck_assert_int_eq(PropCount[0], 1);
+	ck_assert_int_eq(lpProps[0][0].ulPropTag, PidTagMessageFlags);
+	ck_assert_int_eq(lpProps[0][0].value.l, 0x2a);
+
+	/* The others are left pending and sent again */
+	for (i = 1; i < 3; i++) {
+		ck_assert(!batch->ops[i].done);
+		ck_assert(!batch->ops[i].in_round);
+		ck_assert_int_eq(retval[i], MAPI_E_UNABLE_TO_COMPLETE);
+	}
+	ck_assert_int_eq(mapi_batch_build(batch, mem_ctx, 1, &request), 2);
+	ck_assert_int_eq(request->handles[0], STORE_HANDLE);
+} END_TEST
+
+START_TEST (test_mapi_batch_pull_tail) {
+	struct EcDoRpc_MAPI_REPL	*repl;
+	DATA_BLOB			prop_data;
+	/* 4 bytes of properties, a failed GetProps, a RopBufferTooSmall
+	 * and a truncated response */
+	uint8_t				data[] = { 0x01, 0x02, 0x03, 0x04,
+						   0x07, 0x00, 0x0f, 0x01, 0x04, 0x80,
+						   0xff, 0x00, 0x00, 0x00, 0x00, 0x00,
+						   0x07, 0x00 };
+
+	prop_data.data = data;
+	prop_data.length = sizeof (data);
+
+	repl = mapi_batch_pull_tail(mem_ctx, &prop_data, 4);
+	ck_assert(repl != NULL);
+	ck_assert_int_eq(repl[0].opnum, op_MAPI_GetProps);
+	ck_assert_int_eq(repl[0].error_code, MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(repl[1].opnum, op_MAPI_BufferTooSmall);
+	ck_assert_int_eq(repl[2].opnum, 0);
+
+	/* Nothing left after the properties */
+	repl = mapi_batch_pull_tail(mem_ctx, &prop_data, sizeof (data));
+	ck_assert(repl != NULL);
+	ck_assert_int_eq(repl[0].opnum, 0);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_mapi_batch_setup(void)
+{
+	mem_ctx = talloc_new(talloc_autofree_context());
+	session = talloc_zero(mem_ctx, struct mapi_session);
+	ck_assert(session != NULL);
+	init_object(&obj_store, STORE_HANDLE);
+
+	batch = talloc_zero(session, struct mapi_batch);
+	ck_assert(batch != NULL);
+	batch->session = session;
+}
+
+static void tc_mapi_batch_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapi_batch_suite(void)
+{
+	Suite *s = suite_create("libmapi batch");
+	TCase *tc;
+
+	tc = tcase_create("mapi_batch");
+	tcase_add_checked_fixture(tc, tc_mapi_batch_setup, tc_mapi_batch_teardown);
+	tcase_add_test(tc, test_mapi_batch_build_buffer_limit);
+	tcase_add_test(tc, test_mapi_batch_build_handle_limit);
+	tcase_add_test(tc, test_mapi_batch_build_chained_handles);
+	tcase_add_test(tc, test_mapi_batch_buffer_too_small);
+	tcase_add_test(tc, test_mapi_batch_pull_tail);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
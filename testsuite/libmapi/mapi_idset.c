@@ -24,9 +24,62 @@
 #include "libmapi/libmapi_private.h"
 #include <gen_ndr/ndr_exchange.h>
 
+#define	FRAGMENTED_RANGES_COUNT	1000
+
 /* Global test variables */
 static TALLOC_CTX *mem_ctx;
 
+/* Reference linear range scan the range lookups are checked against */
+static bool idset_includes_linear(const struct idset *idset, uint64_t globcnt)
+{
+	uint32_t	i;
+
+	for (i = 0; i < idset->range_count; i++) {
+		if (exchange_globcnt(idset->ranges[i].low) <= exchange_globcnt(globcnt)
+		    && exchange_globcnt(idset->ranges[i].high) >= exchange_globcnt(globcnt)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Build an idset holding count ranges of length counters, the k-th
+   one starting at first + k * period */
+static struct idset *periodic_idset(const struct GUID *guid, uint64_t first, uint64_t count,
+				    uint64_t period, uint64_t length)
+{
+	struct rawidset	*rawidset;
+	struct idset	*idset;
+	uint64_t	i;
+	uint64_t	j;
+
+	rawidset = RAWIDSET_make(mem_ctx, false, false);
+	ck_assert(rawidset != NULL);
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < length; j++) {
+			RAWIDSET_push_guid_glob(rawidset, guid, exchange_globcnt(first + i * period + j));
+		}
+	}
+	idset = RAWIDSET_convert_to_idset(mem_ctx, rawidset);
+	ck_assert(idset != NULL);
+	talloc_free(rawidset);
+
+	return idset;
+}
+
+/* Check the ranges are sorted, disjoint and not consecutive */
+static void check_sorted_ranges(const struct idset *idset)
+{
+	uint32_t	i;
+
+	for (i = 0; i < idset->range_count; i++) {
+		ck_assert(exchange_globcnt(idset->ranges[i].low) <= exchange_globcnt(idset->ranges[i].high));
+		if (i) {
+			ck_assert(exchange_globcnt(idset->ranges[i-1].high) + 1 < exchange_globcnt(idset->ranges[i].low));
+		}
+	}
+}
+
 // v Unit test ----------------------------------------------------------------
 
 START_TEST (test_IDSET_parse) {
@@ -116,12 +169,12 @@ START_TEST (test_IDSET_parse_bitmask_cmd) {
 	ck_assert_int_eq(res->idbased, false);
 	ck_assert_int_eq(res->single, false);
 	ck_assert_int_eq(res->range_count, 3);
-	ck_assert_int_eq(res->ranges->low, 0x5e4d06000000);
-	ck_assert_int_eq(res->ranges->high, 0xe68906000000);
-	ck_assert_int_eq(res->ranges->next->low, 0xe88906000000);
-	ck_assert_int_eq(res->ranges->next->high, res->ranges->next->low);
-	ck_assert_int_eq(res->ranges->next->next->low, 0xea8906000000);
-	ck_assert_int_eq(res->ranges->next->next->high, res->ranges->next->next->low);
+	ck_assert_int_eq(res->ranges[0].low, 0x5e4d06000000);
+	ck_assert_int_eq(res->ranges[0].high, 0xe68906000000);
+	ck_assert_int_eq(res->ranges[1].low, 0xe88906000000);
+	ck_assert_int_eq(res->ranges[1].high, res->ranges[1].low);
+	ck_assert_int_eq(res->ranges[2].low, 0xea8906000000);
+	ck_assert_int_eq(res->ranges[2].high, res->ranges[2].low);
 
 	bin.length = cases_size[1];
 	bin.data = (uint8_t *)case_1;
@@ -130,12 +183,36 @@ START_TEST (test_IDSET_parse_bitmask_cmd) {
 	ck_assert_int_eq(res->idbased, true);
 	ck_assert_int_eq(res->single, false);
 	ck_assert_int_eq(res->range_count, 3);
-	ck_assert_int_eq(res->ranges->low, 0x018906000000);
-	ck_assert_int_eq(res->ranges->high, 0x038906000000);
-	ck_assert_int_eq(res->ranges->next->low, 0x058906000000);
-	ck_assert_int_eq(res->ranges->next->high, res->ranges->next->low);
-	ck_assert_int_eq(res->ranges->next->next->low, 0x078906000000);
-	ck_assert_int_eq(res->ranges->next->next->high, 0x098906000000);
+	ck_assert_int_eq(res->ranges[0].low, 0x018906000000);
+	ck_assert_int_eq(res->ranges[0].high, 0x038906000000);
+	ck_assert_int_eq(res->ranges[1].low, 0x058906000000);
+	ck_assert_int_eq(res->ranges[1].high, res->ranges[1].low);
+	ck_assert_int_eq(res->ranges[2].low, 0x078906000000);
+	ck_assert_int_eq(res->ranges[2].high, 0x098906000000);
+} END_TEST
+
+START_TEST (test_IDSET_parse_unsorted) {
+	/* Ranges [0x50:0x52] and [0x18:0x1a] in reverse order */
+	const uint8_t		case_0[] =
+		{0x1, 0x0, 0x5, 0x0, 0x0, 0x0, 0x1, 0x4,
+		 0x52, 0x50, 0x52, 0x52, 0x18, 0x1a, 0x50, 0x0};
+	DATA_BLOB		bin;
+	struct idset		*res;
+
+	bin.length = sizeof(case_0)/sizeof(uint8_t);
+	bin.data = (uint8_t *) case_0;
+	res = IDSET_parse(mem_ctx, bin, true);
+	ck_assert(res != NULL);
+	ck_assert_int_eq(res->range_count, 2);
+	ck_assert_int_eq(res->ranges[0].low, 0x180401000000);
+	ck_assert_int_eq(res->ranges[0].high, 0x1a0401000000);
+	ck_assert_int_eq(res->ranges[1].low, 0x500401000000);
+	ck_assert_int_eq(res->ranges[1].high, 0x520401000000);
+
+	ck_assert(IDSET_includes_eid(res, (0x190401000000 << 16) | 0x0001));
+	ck_assert(IDSET_includes_eid(res, (0x520401000000 << 16) | 0x0001));
+	ck_assert(!IDSET_includes_eid(res, (0x1b0401000000 << 16) | 0x0001));
+	ck_assert(!IDSET_includes_eid(res, (0x190401000000 << 16) | 0x0002));
 } END_TEST
 
 START_TEST (test_IDSET_includes_guid_glob) {
@@ -196,7 +273,6 @@ START_TEST (test_IDSET_remove_rawidset) {
 	size_t			ids_size = sizeof(ids)/sizeof(uint64_t);
 	struct idset		*idset_in;
 	uint16_t		repl_id = 0x0001;
-	struct globset_range	*range;
 	struct rawidset		*rawidset_in, *rawidset_rm_0, *rawidset_rm_1, *rawidset_rm_2;
 
 	/* Generate idsets */
@@ -225,27 +301,25 @@ START_TEST (test_IDSET_remove_rawidset) {
 	/* Case: Remove first element */
 	IDSET_remove_rawidset(idset_in, rawidset_rm_0);
 
-	range = idset_in->ranges;
 	ck_assert_int_eq(idset_in->range_count, 1);
-	ck_assert_int_eq(range->low, ids[1]);
-	ck_assert_int_eq(range->high, ids[ids_size - 1]);
+	ck_assert_int_eq(idset_in->ranges[0].low, ids[1]);
+	ck_assert_int_eq(idset_in->ranges[0].high, ids[ids_size - 1]);
 
 	/* Case: Remove last element */
 	IDSET_remove_rawidset(idset_in, rawidset_rm_1);
 
 	ck_assert_int_eq(idset_in->range_count, 1);
-	ck_assert_int_eq(range->low, ids[1]);
-	ck_assert_int_eq(range->high, ids[ids_size - 2]);
+	ck_assert_int_eq(idset_in->ranges[0].low, ids[1]);
+	ck_assert_int_eq(idset_in->ranges[0].high, ids[ids_size - 2]);
 
 	/* Case: Remove middle elements (3rd & 4th in the original set) */
 	IDSET_remove_rawidset(idset_in, rawidset_rm_2);
 
 	ck_assert_int_eq(idset_in->range_count, 2);
-	ck_assert_int_eq(range->low, ids[1]);
-	ck_assert_int_eq(range->high, ids[2]);
-	range = range->next;
-	ck_assert_int_eq(range->low, ids[5]);
-	ck_assert_int_eq(range->high, ids[ids_size - 2]);
+	ck_assert_int_eq(idset_in->ranges[0].low, ids[1]);
+	ck_assert_int_eq(idset_in->ranges[0].high, ids[2]);
+	ck_assert_int_eq(idset_in->ranges[1].low, ids[5]);
+	ck_assert_int_eq(idset_in->ranges[1].high, ids[ids_size - 2]);
 
 } END_TEST
 
@@ -295,8 +369,8 @@ START_TEST (test_RAWIDSET_convert_to_idset) {
 	ck_assert(new_idset->single == false);
 	ck_assert(new_idset->next == NULL);
 	ck_assert_int_eq(new_idset->range_count, 2);
-	ck_assert_int_ne(new_idset->ranges->next->low, new_idset->ranges->next->high);
-	ck_assert_int_eq(new_idset->ranges->next->high, consq_ids[consq_ids_size - 1]);
+	ck_assert_int_ne(new_idset->ranges[1].low, new_idset->ranges[1].high);
+	ck_assert_int_eq(new_idset->ranges[1].high, consq_ids[consq_ids_size - 1]);
 
 } END_TEST
 
@@ -315,8 +389,8 @@ START_TEST (test_RAWIDSET_convert_to_idset_one_id) {
 	ck_assert(new_idset->single == false);
 	ck_assert(new_idset->next == NULL);
 	ck_assert_int_eq(new_idset->range_count, 1);
-	ck_assert_int_eq(new_idset->ranges->low, id);
-	ck_assert_int_eq(new_idset->ranges->high, id);
+	ck_assert_int_eq(new_idset->ranges[0].low, id);
+	ck_assert_int_eq(new_idset->ranges[0].high, id);
 
 	talloc_free(new_idset);
 
@@ -327,8 +401,8 @@ START_TEST (test_RAWIDSET_convert_to_idset_one_id) {
 	ck_assert(new_idset->single == true);
 	ck_assert(new_idset->next == NULL);
 	ck_assert_int_eq(new_idset->range_count, 1);
-	ck_assert_int_eq(new_idset->ranges->low, id);
-	ck_assert_int_eq(new_idset->ranges->high, id);
+	ck_assert_int_eq(new_idset->ranges[0].low, id);
+	ck_assert_int_eq(new_idset->ranges[0].high, id);
 
 } END_TEST
 
@@ -366,10 +440,10 @@ START_TEST (test_IDSET_merge_idsets_consecutive) {
 	merged_idset = IDSET_merge_idsets(mem_ctx, old_idset, new_idset);
 	ck_assert(merged_idset != NULL);
 	ck_assert_int_eq(merged_idset->range_count, 2);
-	ck_assert_int_eq(merged_idset->ranges->low, ids[0]);
-	ck_assert_int_eq(merged_idset->ranges->high, 0x5b2304000000);
-	ck_assert_int_eq(merged_idset->ranges->next->low, 0x602304000000);
-	ck_assert_int_eq(merged_idset->ranges->next->high, new_id);
+	ck_assert_int_eq(merged_idset->ranges[0].low, ids[0]);
+	ck_assert_int_eq(merged_idset->ranges[0].high, 0x5b2304000000);
+	ck_assert_int_eq(merged_idset->ranges[1].low, 0x602304000000);
+	ck_assert_int_eq(merged_idset->ranges[1].high, new_id);
 
 } END_TEST
 
@@ -412,8 +486,8 @@ START_TEST (test_IDSET_merge_idsets_new_within_old) {
 	merged_idset = IDSET_merge_idsets(mem_ctx, old_idset, new_idset);
 	ck_assert(merged_idset != NULL);
 	ck_assert_int_eq(merged_idset->range_count, 2);
-	ck_assert_int_eq(merged_idset->ranges->low, old_ids[0]);
-	ck_assert_int_eq(merged_idset->ranges->high, 0x5b2304000000);
+	ck_assert_int_eq(merged_idset->ranges[0].low, old_ids[0]);
+	ck_assert_int_eq(merged_idset->ranges[0].high, 0x5b2304000000);
 
 } END_TEST
 
@@ -459,8 +533,8 @@ START_TEST (test_IDSET_merge_idsets_new_intersects_old) {
 	merged_idset = IDSET_merge_idsets(mem_ctx, old_idset, new_idset);
 	ck_assert(merged_idset != NULL);
 	ck_assert_int_eq(merged_idset->range_count, 2);
-	ck_assert_int_eq(merged_idset->ranges->low, old_ids[0]);
-	ck_assert_int_eq(merged_idset->ranges->high, new_ids[new_ids_size-1]);
+	ck_assert_int_eq(merged_idset->ranges[0].low, old_ids[0]);
+	ck_assert_int_eq(merged_idset->ranges[0].high, new_ids[new_ids_size-1]);
 
 } END_TEST
 
@@ -502,8 +576,8 @@ START_TEST (test_IDSET_merge_idsets_single) {
 	merged_idset = IDSET_merge_idsets(mem_ctx, old_idset, new_idset);
 	ck_assert(merged_idset != NULL);
 	ck_assert_int_eq(merged_idset->range_count, 1);
-	ck_assert_int_eq(merged_idset->ranges->low, old_ids[0]);
-	ck_assert_int_eq(merged_idset->ranges->high, new_upper_ids[new_ids_size-1]);
+	ck_assert_int_eq(merged_idset->ranges[0].low, old_ids[0]);
+	ck_assert_int_eq(merged_idset->ranges[0].high, new_upper_ids[new_ids_size-1]);
 
 	/* Second case */
 	eid_set = RAWIDSET_make(mem_ctx, false, true);
@@ -519,9 +593,142 @@ START_TEST (test_IDSET_merge_idsets_single) {
 	merged_idset = IDSET_merge_idsets(mem_ctx, old_idset, new_idset);
 	ck_assert(merged_idset != NULL);
 	ck_assert_int_eq(merged_idset->range_count, 1);
-	ck_assert_int_eq(merged_idset->ranges->low, new_lower_ids[0]);
-	ck_assert_int_eq(merged_idset->ranges->high, new_upper_ids[new_ids_size-1]);
+	ck_assert_int_eq(merged_idset->ranges[0].low, new_lower_ids[0]);
+	ck_assert_int_eq(merged_idset->ranges[0].high, new_upper_ids[new_ids_size-1]);
+
+} END_TEST
+
+START_TEST (test_IDSET_fragmented) {
+	struct GUID		server_guid = GUID_random();
+	struct idset		*odd_idset, *even_idset, *merged_idset;
+	uint64_t		i;
+
+	odd_idset = periodic_idset(&server_guid, 1, FRAGMENTED_RANGES_COUNT, 2, 1);
+	ck_assert_int_eq(odd_idset->range_count, FRAGMENTED_RANGES_COUNT);
+
+	for (i = 0; i <= 2 * FRAGMENTED_RANGES_COUNT + 1; i++) {
+		ck_assert_int_eq(IDSET_includes_guid_glob(odd_idset, &server_guid, exchange_globcnt(i)),
+				 (i % 2) == 1 && i < 2 * FRAGMENTED_RANGES_COUNT);
+	}
+
+	/* Interleaved ranges collapse into one */
+	even_idset = periodic_idset(&server_guid, 2, FRAGMENTED_RANGES_COUNT, 2, 1);
+	merged_idset = IDSET_merge_idsets(mem_ctx, odd_idset, even_idset);
+	ck_assert(merged_idset != NULL);
+	ck_assert(merged_idset->next == NULL);
+	ck_assert_int_eq(merged_idset->range_count, 1);
+	ck_assert_int_eq(merged_idset->ranges[0].low, exchange_globcnt(1));
+	ck_assert_int_eq(merged_idset->ranges[0].high, exchange_globcnt(2 * FRAGMENTED_RANGES_COUNT));
 
+	/* Disjoint ranges are kept sorted */
+	even_idset = periodic_idset(&server_guid, 2 * FRAGMENTED_RANGES_COUNT + 2, FRAGMENTED_RANGES_COUNT, 2, 1);
+	merged_idset = IDSET_merge_idsets(mem_ctx, even_idset, odd_idset);
+	ck_assert(merged_idset != NULL);
+	ck_assert_int_eq(merged_idset->range_count, 2 * FRAGMENTED_RANGES_COUNT);
+	for (i = 1; i < merged_idset->range_count; i++) {
+		ck_assert(exchange_globcnt(merged_idset->ranges[i-1].high) < exchange_globcnt(merged_idset->ranges[i].low));
+	}
+} END_TEST
+
+START_TEST (test_IDSET_fragmented_lookup) {
+	struct GUID		server_guid = GUID_random();
+	struct GUID		other_guid = GUID_random();
+	struct idset		*idset;
+	uint64_t		i;
+
+	/* Ranges of 3 counters separated by gaps of 4 */
+	idset = periodic_idset(&server_guid, 5, FRAGMENTED_RANGES_COUNT, 7, 3);
+	ck_assert_int_eq(idset->range_count, FRAGMENTED_RANGES_COUNT);
+	check_sorted_ranges(idset);
+
+	for (i = 0; i <= 7 * FRAGMENTED_RANGES_COUNT + 7; i++) {
+		ck_assert_int_eq(IDSET_includes_guid_glob(idset, &server_guid, exchange_globcnt(i)),
+				 idset_includes_linear(idset, exchange_globcnt(i)));
+	}
+	ck_assert(IDSET_includes_guid_glob(idset, &server_guid, exchange_globcnt(5)));
+	ck_assert(IDSET_includes_guid_glob(idset, &server_guid, exchange_globcnt(7)));
+	ck_assert(!IDSET_includes_guid_glob(idset, &server_guid, exchange_globcnt(8)));
+	ck_assert(!IDSET_includes_guid_glob(idset, &server_guid, exchange_globcnt(4)));
+	ck_assert(!IDSET_includes_guid_glob(idset, &other_guid, exchange_globcnt(5)));
+} END_TEST
+
+START_TEST (test_IDSET_fragmented_merge) {
+	struct GUID		server_guid = GUID_random();
+	struct GUID		other_guid = GUID_random();
+	struct idset		*old_idset, *new_idset, *other_idset, *merged_idset;
+	uint32_t		i;
+
+	/* [5k+1, 5k+2] merged with [5k+2, 5k+3] gives [5k+1, 5k+3] */
+	old_idset = periodic_idset(&server_guid, 1, FRAGMENTED_RANGES_COUNT, 5, 2);
+	new_idset = periodic_idset(&server_guid, 2, FRAGMENTED_RANGES_COUNT, 5, 2);
+	merged_idset = IDSET_merge_idsets(mem_ctx, old_idset, new_idset);
+	ck_assert(merged_idset != NULL);
+	ck_assert(merged_idset->next == NULL);
+	ck_assert_int_eq(merged_idset->range_count, FRAGMENTED_RANGES_COUNT);
+	check_sorted_ranges(merged_idset);
+	for (i = 0; i < merged_idset->range_count; i++) {
+		ck_assert_int_eq(merged_idset->ranges[i].low, exchange_globcnt(5 * i + 1));
+		ck_assert_int_eq(merged_idset->ranges[i].high, exchange_globcnt(5 * i + 3));
+	}
+
+	/* The sources are left untouched */
+	ck_assert_int_eq(old_idset->range_count, FRAGMENTED_RANGES_COUNT);
+	ck_assert_int_eq(old_idset->ranges[0].high, exchange_globcnt(2));
+
+	/* Ranges of another replica are kept apart */
+	other_idset = periodic_idset(&other_guid, 1, FRAGMENTED_RANGES_COUNT, 5, 1);
+	merged_idset = IDSET_merge_idsets(mem_ctx, merged_idset, other_idset);
+	ck_assert(merged_idset != NULL);
+	ck_assert(merged_idset->next != NULL);
+	ck_assert(merged_idset->next->next == NULL);
+	ck_assert(IDSET_includes_guid_glob(merged_idset, &server_guid, exchange_globcnt(3)));
+	ck_assert(!IDSET_includes_guid_glob(merged_idset, &other_guid, exchange_globcnt(3)));
+	ck_assert(IDSET_includes_guid_glob(merged_idset, &other_guid, exchange_globcnt(5 * (FRAGMENTED_RANGES_COUNT - 1) + 1)));
+} END_TEST
+
+START_TEST (test_IDSET_fragmented_remove) {
+	struct GUID		server_guid = GUID_random();
+	struct idset		*idset;
+	struct rawidset		*rawidset;
+	uint64_t		i;
+
+	/* Ranges [10k+1, 10k+5] */
+	idset = periodic_idset(&server_guid, 1, FRAGMENTED_RANGES_COUNT, 10, 5);
+	ck_assert_int_eq(idset->range_count, FRAGMENTED_RANGES_COUNT);
+
+	/* Removing the middle counter splits every range in two */
+	rawidset = RAWIDSET_make(mem_ctx, false, true);
+	ck_assert(rawidset != NULL);
+	for (i = 0; i < FRAGMENTED_RANGES_COUNT; i++) {
+		RAWIDSET_push_guid_glob(rawidset, &server_guid, exchange_globcnt(10 * i + 3));
+	}
+	IDSET_remove_rawidset(idset, rawidset);
+	ck_assert_int_eq(idset->range_count, 2 * FRAGMENTED_RANGES_COUNT);
+	check_sorted_ranges(idset);
+	for (i = 0; i < FRAGMENTED_RANGES_COUNT; i++) {
+		ck_assert_int_eq(idset->ranges[2 * i].low, exchange_globcnt(10 * i + 1));
+		ck_assert_int_eq(idset->ranges[2 * i].high, exchange_globcnt(10 * i + 2));
+		ck_assert_int_eq(idset->ranges[2 * i + 1].low, exchange_globcnt(10 * i + 4));
+		ck_assert_int_eq(idset->ranges[2 * i + 1].high, exchange_globcnt(10 * i + 5));
+		ck_assert(!IDSET_includes_guid_glob(idset, &server_guid, exchange_globcnt(10 * i + 3)));
+	}
+
+	/* Removing every counter of a range drops it */
+	rawidset = RAWIDSET_make(mem_ctx, false, true);
+	ck_assert(rawidset != NULL);
+	RAWIDSET_push_guid_glob(rawidset, &server_guid, exchange_globcnt(1));
+	RAWIDSET_push_guid_glob(rawidset, &server_guid, exchange_globcnt(2));
+	IDSET_remove_rawidset(idset, rawidset);
+	ck_assert_int_eq(idset->range_count, 2 * FRAGMENTED_RANGES_COUNT - 1);
+	ck_assert_int_eq(idset->ranges[0].low, exchange_globcnt(4));
+	check_sorted_ranges(idset);
+
+	/* Counters outside the set are ignored */
+	rawidset = RAWIDSET_make(mem_ctx, false, true);
+	ck_assert(rawidset != NULL);
+	RAWIDSET_push_guid_glob(rawidset, &server_guid, exchange_globcnt(8));
+	IDSET_remove_rawidset(idset, rawidset);
+	ck_assert_int_eq(idset->range_count, 2 * FRAGMENTED_RANGES_COUNT - 1);
 } END_TEST
 
 // ^ unit tests ---------------------------------------------------------------
@@ -548,6 +755,7 @@ Suite *libmapi_idset_suite(void)
 	tcase_add_test(tc, test_IDSET_parse);
 	tcase_add_test(tc, test_IDSET_parse_invalid);
 	tcase_add_test(tc, test_IDSET_parse_bitmask_cmd);
+	tcase_add_test(tc, test_IDSET_parse_unsorted);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("IDSET_includes_guid_glob");
@@ -574,5 +782,13 @@ Suite *libmapi_idset_suite(void)
 	tcase_add_test(tc, test_IDSET_merge_idsets_single);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("IDSET fragmented ranges");
+	tcase_add_checked_fixture(tc, tc_mapi_idset_setup, tc_mapi_idset_teardown);
+	tcase_add_test(tc, test_IDSET_fragmented);
+	tcase_add_test(tc, test_IDSET_fragmented_lookup);
+	tcase_add_test(tc, test_IDSET_fragmented_merge);
+	tcase_add_test(tc, test_IDSET_fragmented_remove);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
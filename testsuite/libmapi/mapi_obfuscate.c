@@ -0,0 +1,98 @@
+/*
+   XOR obfuscation Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+/* Global test variables */
+static TALLOC_CTX	*mem_ctx;
+
+/* Reference byte-at-a-time implementation */
+static void obfuscate_data_scalar(uint8_t *data, uint32_t size, uint8_t salt)
+{
+	uint32_t	i;
+
+	for (i = 0; i < size; i++) {
+		data[i] ^= salt;
+	}
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_obfuscate_data) {
+	uint8_t		*buf;
+	uint8_t		*ref;
+	uint32_t	offset;
+	uint32_t	size;
+	uint32_t	i;
+
+	buf = talloc_array(mem_ctx, uint8_t, 256 + 16);
+	ref = talloc_array(mem_ctx, uint8_t, 256 + 16);
+	ck_assert(buf != NULL && ref != NULL);
+
+	/* Every size up to 256 bytes at every alignment within a word */
+	for (offset = 0; offset < 16; offset++) {
+		for (size = 0; size <= 256; size++) {
+			for (i = 0; i < 256 + 16; i++) {
+				buf[i] = ref[i] = (uint8_t)(i * 7 + size);
+			}
+			obfuscate_data(buf + offset, size, 0xA5);
+			obfuscate_data_scalar(ref + offset, size, 0xA5);
+			ck_assert(memcmp(buf, ref, 256 + 16) == 0);
+		}
+	}
+
+	/* Obfuscation is its own inverse */
+	for (i = 0; i < 256; i++) {
+		buf[i] = ref[i] = i;
+	}
+	obfuscate_data(buf, 256, 0xA5);
+	obfuscate_data(buf, 256, 0xA5);
+	ck_assert(memcmp(buf, ref, 256) == 0);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_obfuscate_setup(void)
+{
+	mem_ctx = talloc_new(talloc_autofree_context());
+}
+
+static void tc_obfuscate_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *libmapi_obfuscate_suite(void)
+{
+	Suite *s = suite_create("libmapi obfuscate");
+	TCase *tc;
+
+	tc = tcase_create("obfuscate_data");
+	tcase_add_checked_fixture(tc, tc_obfuscate_setup, tc_obfuscate_teardown);
+	tcase_add_test(tc, test_obfuscate_data);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -24,6 +24,7 @@
 #include "testsuite.h"
 #include "libmapi/libmapi.h"
 #include "libmapi/libmapi_private.h"
+#include "libmapi/mapi_nameid.h"
 #include <gen_ndr/ndr_exchange.h>
 
 /* Global test variables */
@@ -315,6 +316,70 @@ START_TEST (test_get_SizedXidArray) {
 
 } END_TEST
 
+START_TEST (test_nameid_lookup) {
+	enum MAPISTATUS		retval;
+	uint16_t		propType;
+	uint32_t		propTag;
+
+	retval = mapi_nameid_lid_lookup(0x8029, PSETID_Address, &propType);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(propType, PT_LONG);
+	retval = mapi_nameid_lid_lookup_canonical(0x8029, PSETID_Address, &propTag);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(propTag, PidLidAddressBookProviderArrayType);
+	retval = mapi_nameid_lid_lookup(0x8029, PSETID_Common, &propType);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	retval = mapi_nameid_OOM_lookup("ABPArrayType", PSETID_Address, &propType);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(propType, PT_LONG);
+	retval = mapi_nameid_OOM_lookup("ABPArrayType", PSETID_Appointment, &propType);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	retval = mapi_nameid_string_lookup_canonical("AttachmentMacInfo", PSETID_Attachment, &propTag);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(propTag, PidNameAttachmentMacInfo);
+	retval = mapi_nameid_string_lookup("AttachmentMacInfo", PS_PUBLIC_STRINGS, &propType);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	ck_assert_int_eq(mapi_nameid_property_lookup(PidLidAddressCountryCode), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_nameid_property_lookup(PidTagSubject), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(get_namedid_value("PidLidAddressCountryCode"), PidLidAddressCountryCode);
+	ck_assert_str_eq(get_namedid_name(PidLidAddressCountryCode), "PidLidAddressCountryCode");
+	ck_assert_int_eq(get_namedid_value("PidLidDoesNotExist"), 0);
+} END_TEST
+
+START_TEST (test_proptag_lookup) {
+	const uint16_t		types[] = { PT_SHORT, PT_LONG, PT_DOUBLE, PT_ERROR, PT_BOOLEAN,
+					    PT_OBJECT, PT_I8, PT_UNICODE, PT_SYSTIME, PT_CLSID,
+					    PT_SVREID, PT_SRESTRICT, PT_ACTIONS, PT_BINARY,
+					    PT_MV_SHORT, PT_MV_LONG, PT_MV_I8, PT_MV_UNICODE,
+					    PT_MV_SYSTIME, PT_MV_CLSID, PT_MV_BINARY };
+	const char		*propname;
+	uint32_t		proptag;
+	uint32_t		count = 0;
+	uint32_t		i;
+	uint32_t		j;
+
+	/* Every canonical property maps back to its tag */
+	for (i = 1; i < 0x10000; i++) {
+		for (j = 0; j < sizeof (types) / sizeof (types[0]); j++) {
+			proptag = (i << 16) | types[j];
+			propname = get_proptag_name(proptag);
+			if (!propname) continue;
+
+			ck_assert_int_eq(get_proptag_value(propname), proptag);
+			count++;
+		}
+	}
+	ck_assert(count > 1000);
+	ck_assert(get_proptag_name(PidTagSubject) != NULL);
+	ck_assert_str_eq(get_proptag_name(PR_SUBJECT), get_proptag_name(PR_SUBJECT_UNICODE));
+	ck_assert(get_proptag_name(0xFFFE0003) == NULL);
+	ck_assert_int_eq(get_property_type(PidTagSubject >> 16), PT_UNICODE);
+	ck_assert_int_eq(get_proptag_value("PidTagDoesNotExist"), 0);
+} END_TEST
+
 // ^ unit tests ---------------------------------------------------------------
 
 // v suite definition ---------------------------------------------------------
@@ -392,6 +457,16 @@ static void get_SizedXidArray_teardown(void)
 	talloc_free(mem_ctx);
 }
 
+static void tc_proptag_lookup_setup(void)
+{
+	mem_ctx = talloc_new(talloc_autofree_context());
+}
+
+static void tc_proptag_lookup_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
 Suite *libmapi_property_suite(void)
 {
 	Suite *s = suite_create("libmapi property");
@@ -419,5 +494,11 @@ Suite *libmapi_property_suite(void)
 	tcase_add_test(tc, test_get_SizedXidArray);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("proptag lookup");
+	tcase_add_checked_fixture(tc, tc_proptag_lookup_setup, tc_proptag_lookup_teardown);
+	tcase_add_test(tc, test_nameid_lookup);
+	tcase_add_test(tc, test_proptag_lookup);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
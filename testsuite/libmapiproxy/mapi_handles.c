@@ -0,0 +1,190 @@
+/*
+   MAPI handles Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+
+#define	HANDLES_COUNT	5000
+
+/* Global test variables */
+static TALLOC_CTX			*mem_ctx;
+static struct mapi_handles_context	*handles_ctx;
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_mapi_handles_add_search) {
+	struct mapi_handles	*rec = NULL;
+	struct mapi_handles	*found = NULL;
+	enum MAPISTATUS		retval;
+
+	retval = mapi_handles_add(handles_ctx, 0, &rec);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(rec->handle, 1);
+	ck_assert(rec->parent == NULL);
+
+	retval = mapi_handles_search(handles_ctx, rec->handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert(found == rec);
+
+	retval = mapi_handles_search(handles_ctx, 0x42, &found);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+	retval = mapi_handles_search(handles_ctx, MAPI_HANDLES_RESERVED, &found);
+	ck_assert_int_eq(retval, MAPI_E_INVALID_PARAMETER);
+} END_TEST
+
+START_TEST (test_mapi_handles_reuse_generation) {
+	struct mapi_handles	*rec = NULL;
+	struct mapi_handles	*found = NULL;
+	uint32_t		old_handle;
+	enum MAPISTATUS		retval;
+
+	retval = mapi_handles_add(handles_ctx, 0, &rec);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	old_handle = rec->handle;
+
+	retval = mapi_handles_delete(handles_ctx, old_handle);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	retval = mapi_handles_delete(handles_ctx, old_handle);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+
+	/* The slot is reused but the stale handle must not resolve */
+	retval = mapi_handles_add(handles_ctx, 0, &rec);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(MAPI_HANDLES_INDEX(rec->handle), MAPI_HANDLES_INDEX(old_handle));
+	ck_assert_int_ne(rec->handle, old_handle);
+
+	retval = mapi_handles_search(handles_ctx, old_handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+	retval = mapi_handles_search(handles_ctx, rec->handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert(found == rec);
+} END_TEST
+
+START_TEST (test_mapi_handles_delete_children) {
+	struct mapi_handles	*root = NULL;
+	struct mapi_handles	*child = NULL;
+	struct mapi_handles	*grandchild = NULL;
+	struct mapi_handles	*sibling = NULL;
+	struct mapi_handles	*found = NULL;
+	uint32_t		child_handle;
+	uint32_t		grandchild_handle;
+	enum MAPISTATUS		retval;
+
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, 0, &root), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, root->handle, &child), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, child->handle, &grandchild), MAPI_E_SUCCESS);
+	ck_assert_int_eq(mapi_handles_add(handles_ctx, 0, &sibling), MAPI_E_SUCCESS);
+	ck_assert(child->parent == root);
+	ck_assert(root->children == child);
+	ck_assert(grandchild->parent == child);
+	ck_assert_int_eq(handles_ctx->handles_count, 4);
+
+	child_handle = child->handle;
+	grandchild_handle = grandchild->handle;
+
+	retval = mapi_handles_delete(handles_ctx, root->handle);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(handles_ctx->handles_count, 1);
+
+	retval = mapi_handles_search(handles_ctx, child_handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+	retval = mapi_handles_search(handles_ctx, grandchild_handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+	retval = mapi_handles_search(handles_ctx, sibling->handle, &found);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert(handles_ctx->handles == sibling);
+} END_TEST
+
+START_TEST (test_mapi_handles_grow) {
+	struct mapi_handles	*rec = NULL;
+	uint32_t		*handles;
+	uint32_t		i;
+
+	handles = talloc_array(mem_ctx, uint32_t, HANDLES_COUNT);
+	ck_assert(handles != NULL);
+
+	/* Adding past the initial slot array size must keep earlier
+	 * handles resolvable */
+	for (i = 0; i < HANDLES_COUNT; i++) {
+		ck_assert_int_eq(mapi_handles_add(handles_ctx, 0, &rec), MAPI_E_SUCCESS);
+		handles[i] = rec->handle;
+	}
+	ck_assert_int_eq(handles_ctx->handles_count, HANDLES_COUNT);
+
+	for (i = 0; i < HANDLES_COUNT; i++) {
+		ck_assert_int_eq(mapi_handles_search(handles_ctx, handles[i], &rec), MAPI_E_SUCCESS);
+		ck_assert_int_eq(rec->handle, handles[i]);
+	}
+
+	/* Release every other handle and reuse the freed slots */
+	for (i = 0; i < HANDLES_COUNT; i += 2) {
+		ck_assert_int_eq(mapi_handles_delete(handles_ctx, handles[i]), MAPI_E_SUCCESS);
+	}
+	ck_assert_int_eq(handles_ctx->handles_count, HANDLES_COUNT / 2);
+
+	for (i = 0; i < HANDLES_COUNT; i += 2) {
+		ck_assert_int_eq(mapi_handles_add(handles_ctx, 0, &rec), MAPI_E_SUCCESS);
+		ck_assert(MAPI_HANDLES_INDEX(rec->handle) <= HANDLES_COUNT);
+	}
+	ck_assert_int_eq(handles_ctx->handles_count, HANDLES_COUNT);
+
+	for (i = 0; i < HANDLES_COUNT; i++) {
+		if (i % 2) {
+			ck_assert_int_eq(mapi_handles_search(handles_ctx, handles[i], &rec), MAPI_E_SUCCESS);
+		} else {
+			ck_assert_int_eq(mapi_handles_search(handles_ctx, handles[i], &rec), MAPI_E_NOT_FOUND);
+		}
+	}
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_mapi_handles_setup(void)
+{
+	mem_ctx = talloc_new(talloc_autofree_context());
+	handles_ctx = mapi_handles_init(mem_ctx);
+	ck_assert(handles_ctx != NULL);
+}
+
+static void tc_mapi_handles_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_mapi_handles_suite(void)
+{
+	Suite *s = suite_create("libmapiproxy mapi handles");
+	TCase *tc;
+
+	tc = tcase_create("mapi_handles");
+	tcase_add_checked_fixture(tc, tc_mapi_handles_setup, tc_mapi_handles_teardown);
+	tcase_add_test(tc, test_mapi_handles_add_search);
+	tcase_add_test(tc, test_mapi_handles_reuse_generation);
+	tcase_add_test(tc, test_mapi_handles_delete_children);
+	tcase_add_test(tc, test_mapi_handles_grow);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
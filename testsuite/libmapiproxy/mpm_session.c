@@ -0,0 +1,120 @@
+/*
+   mapiproxy session Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "libmapi/libmapi.h"
+
+#define	SESSIONS_COUNT	10000
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct GUID		*uuids;
+static struct server_id		*server_ids;
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_mpm_session_find_by_uuid) {
+	struct mpm_session	*session;
+	struct GUID		unknown;
+	int			i;
+
+	for (i = 0; i < SESSIONS_COUNT; i++) {
+		session = mpm_session_find_by_uuid(&uuids[i]);
+		ck_assert(session != NULL);
+		ck_assert(GUID_equal(&session->uuid, &uuids[i]));
+		ck_assert_int_eq(session->context_id, i);
+	}
+
+	unknown = GUID_random();
+	ck_assert(mpm_session_find_by_uuid(&unknown) == NULL);
+	ck_assert(mpm_session_find_by_uuid(NULL) == NULL);
+} END_TEST
+
+START_TEST (test_mpm_session_unbind) {
+	struct mpm_session	*session;
+	int			i;
+
+	/* Release even sessions */
+	for (i = 0; i < SESSIONS_COUNT; i += 2) {
+		ck_assert(mpm_session_unbind(&server_ids[i], i) == true);
+	}
+
+	for (i = 0; i < SESSIONS_COUNT; i++) {
+		session = mpm_session_find_by_uuid(&uuids[i]);
+		if (i % 2) {
+			ck_assert(session != NULL);
+			ck_assert_int_eq(session->context_id, i);
+		} else {
+			ck_assert(session == NULL);
+		}
+	}
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_mpm_session_setup(void)
+{
+	struct mpm_session	*session;
+	char			*username;
+	int			i;
+
+	mem_ctx = talloc_new(talloc_autofree_context());
+	uuids = talloc_array(mem_ctx, struct GUID, SESSIONS_COUNT);
+	server_ids = talloc_zero_array(mem_ctx, struct server_id, SESSIONS_COUNT);
+	ck_assert(uuids != NULL && server_ids != NULL);
+
+	for (i = 0; i < SESSIONS_COUNT; i++) {
+		uuids[i] = GUID_random();
+		server_ids[i].pid = i + 1;
+		username = talloc_asprintf(mem_ctx, "user%d", i);
+		session = mpm_session_init_sub(server_ids[i], i, username, &uuids[i]);
+		ck_assert(session != NULL);
+		talloc_free(username);
+	}
+}
+
+static void tc_mpm_session_teardown(void)
+{
+	int	i;
+
+	for (i = 0; i < SESSIONS_COUNT; i++) {
+		mpm_session_unbind(&server_ids[i], i);
+	}
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_mpm_session_suite(void)
+{
+	Suite *s = suite_create("libmapiproxy mpm session");
+	TCase *tc;
+
+	tc = tcase_create("mpm_session");
+	tcase_add_checked_fixture(tc, tc_mpm_session_setup, tc_mpm_session_teardown);
+	tcase_set_timeout(tc, 60);
+	tcase_add_test(tc, test_mpm_session_find_by_uuid);
+	tcase_add_test(tc, test_mpm_session_unbind);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
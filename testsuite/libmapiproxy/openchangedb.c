@@ -28,6 +28,11 @@
 #include "libmapi/libmapi.h"
 #include <inttypes.h>
 #include <mysql/mysql.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(HAVE_PTHREADS)
+#include <pthread.h>
+#endif
 
 #define OPENCHANGEDB_SAMPLE_SQL		RESOURCES_DIR "/openchangedb_sample.sql"
 #define OPENCHANGEDB_LDB		RESOURCES_DIR "/openchange.ldb"
@@ -42,6 +47,8 @@
 static TALLOC_CTX 			*g_mem_ctx;
 static struct openchangedb_context 	*g_oc_ctx;
 static enum MAPISTATUS			retval;
+/* Gives forked processes their own backend connection */
+static void				(*g_fork_setup)(void);
 
 #define USER1 "paco"
 // v Unit test ----------------------------------------------------------------
@@ -387,6 +394,213 @@ START_TEST (test_get_next_changeNumber) {
 	}
 } END_TEST
 
+START_TEST (test_get_new_changeNumber_lease) {
+	uint64_t base = 0, cn = 0, prev = 0, next_cn = 0;
+	struct UI8Array_r *cns;
+	int i;
+
+	retval = openchangedb_get_next_changeNumber(g_oc_ctx, USER1, &base);
+	CHECK_SUCCESS;
+	base = exchange_globcnt(base >> 16);
+
+	retval = openchangedb_set_changeNumber_lease(g_oc_ctx, 16);
+	CHECK_SUCCESS;
+
+	/* The second block is leased on the 17th allocation */
+	for (i = 0; i < 20; i++) {
+		retval = openchangedb_get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+		CHECK_SUCCESS;
+		retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cn);
+		CHECK_SUCCESS;
+		ck_assert(cn == next_cn);
+		ck_assert(exchange_globcnt(cn >> 16) == base + i);
+		ck_assert(!i || exchange_globcnt(cn >> 16) > prev);
+		prev = exchange_globcnt(cn >> 16);
+	}
+
+	retval = openchangedb_get_new_changeNumbers(g_oc_ctx, g_mem_ctx, USER1, 4, &cns);
+	CHECK_SUCCESS;
+	ck_assert_int_eq(4, cns->cValues);
+	for (i = 0; i < 4; i++) {
+		ck_assert(cns->lpui8[i] == ((exchange_globcnt(base + 20 + i) << 16) | 0x0001));
+	}
+
+	/* The unused part of the lease is given back */
+	retval = openchangedb_set_changeNumber_lease(g_oc_ctx, 0);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_next_changeNumber(g_oc_ctx, USER1, &next_cn);
+	CHECK_SUCCESS;
+	ck_assert(next_cn == ((exchange_globcnt(base + 24) << 16) | 0x0001));
+} END_TEST
+
+static int cn_cmp(const void *a, const void *b)
+{
+	uint64_t	ca = *(const uint64_t *)a;
+	uint64_t	cb = *(const uint64_t *)b;
+
+	return (ca > cb) - (ca < cb);
+}
+
+#if defined(HAVE_PTHREADS)
+#define CN_LEASE_THREADS	8
+#define CN_LEASE_ALLOCATIONS	200
+
+static void *cn_lease_thread(void *arg)
+{
+	uint64_t	*cns = arg;
+	int		i;
+
+	for (i = 0; i < CN_LEASE_ALLOCATIONS; i++) {
+		if (openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cns[i]) != MAPI_E_SUCCESS) {
+			cns[i] = 0;
+		} else {
+			cns[i] = exchange_globcnt(cns[i] >> 16);
+		}
+	}
+
+	return NULL;
+}
+
+START_TEST (test_get_new_changeNumber_lease_threads) {
+	pthread_t	threads[CN_LEASE_THREADS];
+	uint64_t	*cns;
+	int		i;
+
+	cns = talloc_zero_array(g_mem_ctx, uint64_t, CN_LEASE_THREADS * CN_LEASE_ALLOCATIONS);
+	ck_assert(cns != NULL);
+
+	retval = openchangedb_set_changeNumber_lease(g_oc_ctx, 7);
+	CHECK_SUCCESS;
+
+	for (i = 0; i < CN_LEASE_THREADS; i++) {
+		ck_assert_int_eq(pthread_create(&threads[i], NULL, cn_lease_thread,
+						&cns[i * CN_LEASE_ALLOCATIONS]), 0);
+	}
+	for (i = 0; i < CN_LEASE_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	retval = openchangedb_set_changeNumber_lease(g_oc_ctx, 0);
+	CHECK_SUCCESS;
+
+	qsort(cns, CN_LEASE_THREADS * CN_LEASE_ALLOCATIONS, sizeof (uint64_t), cn_cmp);
+	ck_assert(cns[0] != 0);
+	for (i = 1; i < CN_LEASE_THREADS * CN_LEASE_ALLOCATIONS; i++) {
+		ck_assert(cns[i] != cns[i - 1]);
+	}
+} END_TEST
+#endif
+
+#define CN_RESERVE_PROCESSES	4
+#define CN_RESERVE_ROUNDS	50
+#define CN_RESERVE_BLOCK	5
+
+static void cn_reserve_process(int start_fd, int result_fd)
+{
+	struct UI8Array_r	*cns;
+	uint64_t		first;
+	char			c;
+	int			i;
+
+	if (g_fork_setup) {
+		g_fork_setup();
+	}
+
+	/* Wait until every process is ready */
+	if (read(start_fd, &c, 1) < 0) {
+		_exit(1);
+	}
+
+	for (i = 0; i < CN_RESERVE_ROUNDS; i++) {
+		if (openchangedb_get_new_changeNumbers(g_oc_ctx, g_mem_ctx, USER1, CN_RESERVE_BLOCK, &cns) != MAPI_E_SUCCESS) {
+			_exit(1);
+		}
+		first = exchange_globcnt(cns->lpui8[0] >> 16);
+		if (exchange_globcnt(cns->lpui8[CN_RESERVE_BLOCK - 1] >> 16) != first + CN_RESERVE_BLOCK - 1 ||
+		    write(result_fd, &first, sizeof (first)) != sizeof (first)) {
+			_exit(1);
+		}
+		talloc_free(cns);
+	}
+
+	_exit(0);
+}
+
+START_TEST (test_get_new_changeNumbers_processes) {
+	pid_t		pids[CN_RESERVE_PROCESSES];
+	int		start_pipe[2];
+	int		result_pipe[2];
+	uint64_t	*firsts;
+	ssize_t		len;
+	size_t		received = 0;
+	int		status;
+	int		i;
+
+	firsts = talloc_zero_array(g_mem_ctx, uint64_t, CN_RESERVE_PROCESSES * CN_RESERVE_ROUNDS);
+	ck_assert(firsts != NULL);
+	ck_assert_int_eq(pipe(start_pipe), 0);
+	ck_assert_int_eq(pipe(result_pipe), 0);
+
+	/* Every process reserves blocks from the backend at once */
+	for (i = 0; i < CN_RESERVE_PROCESSES; i++) {
+		pids[i] = fork();
+		ck_assert(pids[i] != -1);
+		if (pids[i] == 0) {
+			close(start_pipe[1]);
+			close(result_pipe[0]);
+			cn_reserve_process(start_pipe[0], result_pipe[1]);
+		}
+	}
+	close(start_pipe[0]);
+	close(result_pipe[1]);
+	close(start_pipe[1]);
+
+	while (received < CN_RESERVE_PROCESSES * CN_RESERVE_ROUNDS * sizeof (uint64_t)) {
+		len = read(result_pipe[0], (char *)firsts + received,
+			   CN_RESERVE_PROCESSES * CN_RESERVE_ROUNDS * sizeof (uint64_t) - received);
+		if (len <= 0) break;
+		received += len;
+	}
+	close(result_pipe[0]);
+
+	for (i = 0; i < CN_RESERVE_PROCESSES; i++) {
+		ck_assert_int_eq(waitpid(pids[i], &status, 0), pids[i]);
+		ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+	ck_assert_int_eq(received, CN_RESERVE_PROCESSES * CN_RESERVE_ROUNDS * sizeof (uint64_t));
+
+	/* The reserved ranges do not overlap */
+	qsort(firsts, CN_RESERVE_PROCESSES * CN_RESERVE_ROUNDS, sizeof (uint64_t), cn_cmp);
+	for (i = 1; i < CN_RESERVE_PROCESSES * CN_RESERVE_ROUNDS; i++) {
+		ck_assert(firsts[i] >= firsts[i - 1] + CN_RESERVE_BLOCK);
+	}
+} END_TEST
+
+START_TEST (test_get_new_changeNumber_lease_fork) {
+	uint64_t	cn = 0;
+	pid_t		pid;
+	int		status;
+
+	retval = openchangedb_set_changeNumber_lease(g_oc_ctx, 16);
+	CHECK_SUCCESS;
+	retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cn);
+	CHECK_SUCCESS;
+
+	/* Leases are refused to forked processes */
+	pid = fork();
+	ck_assert(pid != -1);
+	if (pid == 0) {
+		_exit(openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cn) == MAPI_E_NO_SUPPORT ? 0 : 1);
+	}
+	ck_assert_int_eq(waitpid(pid, &status, 0), pid);
+	ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	retval = openchangedb_get_new_changeNumber(g_oc_ctx, USER1, &cn);
+	CHECK_SUCCESS;
+	retval = openchangedb_set_changeNumber_lease(g_oc_ctx, 0);
+	CHECK_SUCCESS;
+} END_TEST
+
 START_TEST (test_get_folder_property) {
 	void *data;
 	uint64_t fid;
@@ -1165,6 +1379,68 @@ START_TEST (test_build_table_folders) {
 	ck_assert_int_eq(retval, MAPI_E_INVALID_OBJECT);
 } END_TEST
 
+START_TEST (test_build_table_folders_batch) {
+	void *table, *single_table, *data;
+	void **rows_data;
+	struct SRow *row;
+	enum MAPISTATUS *rows_retvals;
+	struct SPropTagArray props;
+	enum MAPITAGS tags[] = { PidTagFolderId, PidTagDisplayName };
+	uint64_t fid;
+	uint32_t i, j;
+
+	fid = 17438782182108692481ul;
+	retval = openchangedb_table_init(g_mem_ctx, g_oc_ctx, USER1, 1, fid, &table);
+	CHECK_SUCCESS;
+	retval = openchangedb_table_init(g_mem_ctx, g_oc_ctx, USER1, 1, fid, &single_table);
+	CHECK_SUCCESS;
+
+	props.cValues = 2;
+	props.aulPropTag = tags;
+	retval = openchangedb_table_get_properties(g_mem_ctx, g_oc_ctx, table, &props,
+						   0, 20, false, &rows_data, &rows_retvals);
+	if (retval == MAPI_E_NOT_IMPLEMENTED) return;
+	CHECK_SUCCESS;
+
+	/* Batched cells match cell by cell lookups */
+	for (i = 0; i < 13; i++) {
+		for (j = 0; j < props.cValues; j++) {
+			retval = openchangedb_table_get_property(g_mem_ctx, g_oc_ctx, single_table,
+								 tags[j], i, false, &data);
+			ck_assert_int_eq(retval, rows_retvals[i * props.cValues + j]);
+			if (retval != MAPI_E_SUCCESS) continue;
+			if (tags[j] == PidTagFolderId) {
+				ck_assert_int_eq(*(uint64_t *)data, *(uint64_t *)rows_data[i * props.cValues + j]);
+			} else {
+				ck_assert_str_eq((char *)data, (char *)rows_data[i * props.cValues + j]);
+			}
+		}
+	}
+
+	/* Batched cells are not cached: later lookups see updates */
+	ck_assert_int_eq(rows_retvals[0], MAPI_E_SUCCESS);
+	ck_assert_int_eq(rows_retvals[1], MAPI_E_SUCCESS);
+	row = talloc_zero(g_mem_ctx, struct SRow);
+	row->cValues = 1;
+	row->lpProps = talloc_zero(g_mem_ctx, struct SPropValue);
+	row->lpProps[0].ulPropTag = PidTagDisplayName;
+	row->lpProps[0].value.lpszW = talloc_strdup(g_mem_ctx, "renamed after batch");
+	retval = openchangedb_set_folder_properties(g_oc_ctx, USER1, *(uint64_t *)rows_data[0], row);
+	CHECK_SUCCESS;
+	retval = openchangedb_table_get_property(g_mem_ctx, g_oc_ctx, table,
+						 PidTagDisplayName, 0, false, &data);
+	CHECK_SUCCESS;
+	ck_assert_str_eq((char *)data, "renamed after batch");
+	row->lpProps[0].value.lpszW = (char *)rows_data[1];
+	retval = openchangedb_set_folder_properties(g_oc_ctx, USER1, *(uint64_t *)rows_data[0], row);
+	CHECK_SUCCESS;
+
+	/* Windows out of the table range are invalid */
+	retval = openchangedb_table_get_properties(g_mem_ctx, g_oc_ctx, table, &props,
+						   13, 1, false, &rows_data, &rows_retvals);
+	ck_assert_int_eq(retval, MAPI_E_INVALID_OBJECT);
+} END_TEST
+
 START_TEST (test_build_table_folders_with_restrictions) {
 	void *table, *data;
 	uint64_t fid;
@@ -1401,6 +1677,7 @@ static void ldb_setup(void)
 		fprintf(stderr, "Error initializing openchangedb %d\n", ret);
 		ck_abort();
 	}
+	g_fork_setup = NULL;
 }
 
 static void ldb_teardown(void)
@@ -1410,10 +1687,26 @@ static void ldb_teardown(void)
 	unlink(REPLICA_MAPPING_TDB);
 }
 
+static void mysql_fork_setup(void)
+{
+	const char	*mysql_pass = getenv("OC_MYSQL_PASS");
+	MYSQL		*conn;
+
+	/* The cached connection is the parent's one */
+	conn = mysql_init(NULL);
+	if (!conn || !mysql_real_connect(conn, OC_TESTSUITE_MYSQL_HOST, OC_TESTSUITE_MYSQL_USER,
+					 mysql_pass ? mysql_pass : OC_TESTSUITE_MYSQL_PASS,
+					 OC_TESTSUITE_MYSQL_DB, 0, NULL, 0)) {
+		_exit(1);
+	}
+	g_oc_ctx->data = conn;
+}
+
 static void mysql_setup(void)
 {
 	g_mem_ctx = talloc_new(talloc_autofree_context());
 	initialize_mysql_with_file(g_mem_ctx, OPENCHANGEDB_SAMPLE_SQL, &g_oc_ctx);
+	g_fork_setup = mysql_fork_setup;
 }
 
 static void mysql_teardown(void)
@@ -1484,6 +1777,7 @@ static Suite *openchangedb_create_suite(const char *backend_name,
 	tcase_add_test(tc, test_set_property_message_with_change_key);
 
 	tcase_add_test(tc, test_build_table_folders);
+	tcase_add_test(tc, test_build_table_folders_batch);
 	tcase_add_test(tc, test_build_table_folders_with_restrictions);
 	tcase_add_test(tc, test_build_table_folders_live_filtering);
 	tcase_add_test(tc, test_get_Transport_folder_when_has_unusual_display_name);
@@ -1502,6 +1796,13 @@ static Suite *openchangedb_create_suite(const char *backend_name,
 
 	tcase_add_test(tc, test_set_receive_folder_to_mailbox);
 
+	tcase_add_test(tc, test_get_new_changeNumber_lease);
+#if defined(HAVE_PTHREADS)
+	tcase_add_test(tc, test_get_new_changeNumber_lease_threads);
+#endif
+	tcase_add_test(tc, test_get_new_changeNumber_lease_fork);
+	tcase_add_test(tc, test_get_new_changeNumbers_processes);
+
 	suite_add_tcase(s, tc);
 	return s;
 }
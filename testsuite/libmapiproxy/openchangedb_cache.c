@@ -0,0 +1,374 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/libmapiproxy/backends/openchangedb_cache.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+#include <inttypes.h>
+
+
+#define FOLDER_ID_EXPECTED 289356276058554369ul
+#define OTHER_FOLDER_ID 289356276058554370ul
+#define MOCKED_URL "mocked_url"
+#define MOCKED_NAME "mocked_name"
+#define CACHE_SIZE 16
+
+#define CHECK_SUCCESS(fncall) do { \
+	enum MAPISTATUS ret = fncall; \
+	ck_assert_int_eq(ret, MAPI_E_SUCCESS); \
+} while(0)
+
+
+struct openchangedb_context_checker {
+	int get_SystemFolderID;
+	int get_MailboxReplica;
+	int get_mapistoreURI;
+	int set_mapistoreURI;
+	int get_folder_property;
+	int set_folder_properties;
+	int create_folder;
+	int message_save;
+};
+
+
+static TALLOC_CTX *mem_ctx;
+static struct openchangedb_context *oc_ctx;
+static struct openchangedb_context_checker functions_called;
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_cache_SystemFolderID) {
+	struct openchangedb_cache_stats	stats;
+	uint64_t			folder_id;
+	int				i;
+
+	for (i = 0; i < 10; i++) {
+		folder_id = 0;
+		CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 3, &folder_id));
+		ck_assert_int_eq(folder_id, FOLDER_ID_EXPECTED + 3);
+	}
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 1);
+
+	/* Other users and indexes are distinct entries */
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 4, &folder_id));
+	ck_assert_int_eq(folder_id, FOLDER_ID_EXPECTED + 4);
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "other", 3, &folder_id));
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 3);
+
+	CHECK_SUCCESS(openchangedb_cache_get_stats(oc_ctx, &stats));
+	ck_assert_int_eq(stats.hits, 9);
+	ck_assert_int_eq(stats.misses, 3);
+	ck_assert_int_eq(stats.entries, 3);
+} END_TEST
+
+START_TEST (test_cache_failures_not_cached) {
+	uint64_t	folder_id;
+
+	ck_assert_int_eq(openchangedb_get_SystemFolderID(oc_ctx, "nobody", 3, &folder_id), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(openchangedb_get_SystemFolderID(oc_ctx, "nobody", 3, &folder_id), MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 2);
+} END_TEST
+
+START_TEST (test_cache_MailboxReplica) {
+	uint16_t	ReplID = 0;
+	struct GUID	ReplGUID;
+	struct GUID	expected = GUID_zero();
+
+	expected.time_low = 0x42;
+
+	/* A partial request first still caches both values */
+	CHECK_SUCCESS(openchangedb_get_MailboxReplica(oc_ctx, "recipient", NULL, &ReplGUID));
+	ck_assert(GUID_equal(&ReplGUID, &expected));
+	CHECK_SUCCESS(openchangedb_get_MailboxReplica(oc_ctx, "recipient", &ReplID, NULL));
+	ck_assert_int_eq(ReplID, 1);
+
+	ck_assert_int_eq(functions_called.get_MailboxReplica, 1);
+} END_TEST
+
+START_TEST (test_cache_mapistoreURI) {
+	TALLOC_CTX	*local_mem_ctx;
+	char		*uri;
+
+	local_mem_ctx = talloc_new(mem_ctx);
+	CHECK_SUCCESS(openchangedb_get_mapistoreURI(local_mem_ctx, oc_ctx, "recipient", FOLDER_ID_EXPECTED, &uri, true));
+	ck_assert_str_eq(uri, MOCKED_URL);
+	talloc_free(local_mem_ctx);
+
+	/* The cached copy survives the caller's memory context */
+	local_mem_ctx = talloc_new(mem_ctx);
+	CHECK_SUCCESS(openchangedb_get_mapistoreURI(local_mem_ctx, oc_ctx, "recipient", FOLDER_ID_EXPECTED, &uri, true));
+	ck_assert_str_eq(uri, MOCKED_URL);
+	ck_assert(talloc_parent(uri) == local_mem_ctx);
+	talloc_free(local_mem_ctx);
+	ck_assert_int_eq(functions_called.get_mapistoreURI, 1);
+
+	/* Updating the URI invalidates the folder entries */
+	CHECK_SUCCESS(openchangedb_set_mapistoreURI(oc_ctx, "recipient", FOLDER_ID_EXPECTED, "new_url"));
+	CHECK_SUCCESS(openchangedb_get_mapistoreURI(mem_ctx, oc_ctx, "recipient", FOLDER_ID_EXPECTED, &uri, true));
+	CHECK_SUCCESS(openchangedb_get_mapistoreURI(mem_ctx, oc_ctx, "recipient", FOLDER_ID_EXPECTED, &uri, true));
+	ck_assert_int_eq(functions_called.set_mapistoreURI, 1);
+	ck_assert_int_eq(functions_called.get_mapistoreURI, 2);
+} END_TEST
+
+START_TEST (test_cache_folder_property) {
+	void		*data;
+	struct SRow	row;
+
+	CHECK_SUCCESS(openchangedb_get_folder_property(mem_ctx, oc_ctx, "recipient", PidTagDisplayName, FOLDER_ID_EXPECTED, &data));
+	ck_assert_str_eq((const char *) data, MOCKED_NAME);
+	CHECK_SUCCESS(openchangedb_get_folder_property(mem_ctx, oc_ctx, "recipient", PidTagDisplayName, FOLDER_ID_EXPECTED, &data));
+	ck_assert_str_eq((const char *) data, MOCKED_NAME);
+	CHECK_SUCCESS(openchangedb_get_folder_property(mem_ctx, oc_ctx, "recipient", PidTagContentCount, FOLDER_ID_EXPECTED, &data));
+	ck_assert_int_eq(*(uint32_t *) data, 42);
+	CHECK_SUCCESS(openchangedb_get_folder_property(mem_ctx, oc_ctx, "recipient", PidTagContentCount, FOLDER_ID_EXPECTED, &data));
+	ck_assert_int_eq(*(uint32_t *) data, 42);
+	CHECK_SUCCESS(openchangedb_get_folder_property(mem_ctx, oc_ctx, "recipient", PidTagDisplayName, OTHER_FOLDER_ID, &data));
+	ck_assert_int_eq(functions_called.get_folder_property, 3);
+
+	/* Writing a folder only invalidates that folder */
+	memset(&row, 0, sizeof(struct SRow));
+	CHECK_SUCCESS(openchangedb_set_folder_properties(oc_ctx, "recipient", FOLDER_ID_EXPECTED, &row));
+	CHECK_SUCCESS(openchangedb_get_folder_property(mem_ctx, oc_ctx, "recipient", PidTagDisplayName, FOLDER_ID_EXPECTED, &data));
+	CHECK_SUCCESS(openchangedb_get_folder_property(mem_ctx, oc_ctx, "recipient", PidTagDisplayName, OTHER_FOLDER_ID, &data));
+	ck_assert_int_eq(functions_called.get_folder_property, 4);
+
+	/* Saving a message invalidates every folder property */
+	CHECK_SUCCESS(openchangedb_message_save(oc_ctx, &row, 0));
+	CHECK_SUCCESS(openchangedb_get_folder_property(mem_ctx, oc_ctx, "recipient", PidTagDisplayName, OTHER_FOLDER_ID, &data));
+	ck_assert_int_eq(functions_called.get_folder_property, 5);
+
+	/* Multi-valued properties are not cached */
+	CHECK_SUCCESS(openchangedb_get_folder_property(mem_ctx, oc_ctx, "recipient", PidTagAdditionalRenEntryIds, FOLDER_ID_EXPECTED, &data));
+	CHECK_SUCCESS(openchangedb_get_folder_property(mem_ctx, oc_ctx, "recipient", PidTagAdditionalRenEntryIds, FOLDER_ID_EXPECTED, &data));
+	ck_assert_int_eq(functions_called.get_folder_property, 7);
+} END_TEST
+
+START_TEST (test_cache_create_folder) {
+	struct openchangedb_cache_stats	stats;
+	uint64_t			folder_id;
+
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 3, &folder_id));
+	CHECK_SUCCESS(openchangedb_create_folder(oc_ctx, "recipient", FOLDER_ID_EXPECTED, OTHER_FOLDER_ID, 1, MOCKED_URL, 4));
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", 3, &folder_id));
+	ck_assert_int_eq(functions_called.create_folder, 1);
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 2);
+
+	CHECK_SUCCESS(openchangedb_cache_get_stats(oc_ctx, &stats));
+	ck_assert_int_eq(stats.flushes, 1);
+	ck_assert_int_eq(stats.entries, 1);
+} END_TEST
+
+START_TEST (test_cache_max_entries) {
+	struct openchangedb_cache_stats	stats;
+	uint64_t			folder_id;
+	uint32_t			i;
+
+	for (i = 0; i < CACHE_SIZE + 1; i++) {
+		CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", i, &folder_id));
+	}
+
+	CHECK_SUCCESS(openchangedb_cache_get_stats(oc_ctx, &stats));
+	ck_assert_int_eq(stats.flushes, 1);
+	ck_assert_int_eq(stats.entries, 1);
+
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", CACHE_SIZE, &folder_id));
+	ck_assert_int_eq(functions_called.get_SystemFolderID, CACHE_SIZE + 1);
+} END_TEST
+
+// ^ Unit test ----------------------------------------------------------------
+
+// v Mocked backend -----------------------------------------------------------
+
+static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
+					  const char *recipient, uint32_t SystemIdx,
+					  uint64_t *FolderId)
+{
+	functions_called.get_SystemFolderID++;
+	if (strcmp(recipient, "nobody") == 0) {
+		return MAPI_E_NOT_FOUND;
+	}
+	*FolderId = FOLDER_ID_EXPECTED + SystemIdx;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_MailboxReplica(struct openchangedb_context *self,
+					  const char *recipient, uint16_t *ReplID,
+					  struct GUID *ReplGUID)
+{
+	functions_called.get_MailboxReplica++;
+	if (ReplID) {
+		*ReplID = 1;
+	}
+	if (ReplGUID) {
+		*ReplGUID = GUID_zero();
+		ReplGUID->time_low = 0x42;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_mapistoreURI(TALLOC_CTX *parent_ctx,
+					struct openchangedb_context *self,
+					const char *username,
+					uint64_t fid, char **mapistoreURL,
+					bool mailboxstore)
+{
+	functions_called.get_mapistoreURI++;
+	*mapistoreURL = talloc_strdup(parent_ctx, MOCKED_URL);
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS set_mapistoreURI(struct openchangedb_context *self,
+					const char *username, uint64_t fid,
+					const char *mapistoreURL)
+{
+	functions_called.set_mapistoreURI++;
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_folder_property(TALLOC_CTX *parent_ctx,
+					   struct openchangedb_context *self,
+					   const char *username,
+					   uint32_t proptag, uint64_t fid,
+					   void **data)
+{
+	uint32_t		*l;
+	struct LongArray_r	*long_array;
+
+	functions_called.get_folder_property++;
+	switch (proptag & 0xFFFF) {
+	case PT_UNICODE:
+		*data = talloc_strdup(parent_ctx, MOCKED_NAME);
+		break;
+	case PT_LONG:
+		l = talloc_zero(parent_ctx, uint32_t);
+		*l = 42;
+		*data = l;
+		break;
+	default:
+		long_array = talloc_zero(parent_ctx, struct LongArray_r);
+		*data = long_array;
+		break;
+	}
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS set_folder_properties(struct openchangedb_context *self,
+					     const char *username, uint64_t fid,
+					     struct SRow *row)
+{
+	functions_called.set_folder_properties++;
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS create_folder(struct openchangedb_context *self,
+				     const char *username,
+				     uint64_t parentFolderID, uint64_t fid,
+				     uint64_t changeNumber,
+				     const char *MAPIStoreURI, int systemIdx)
+{
+	functions_called.create_folder++;
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS message_save(struct openchangedb_context *self,
+				    void *_msg, uint8_t SaveFlags)
+{
+	functions_called.message_save++;
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS mock_backend_init(TALLOC_CTX *mem_ctx,
+					 struct openchangedb_context **ctx)
+{
+	struct openchangedb_context	*oc_ctx = talloc_zero(mem_ctx, struct openchangedb_context);
+
+	OPENCHANGE_RETVAL_IF(oc_ctx == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+
+	oc_ctx->backend_type = talloc_strdup(oc_ctx, "mocked_backend");
+	OPENCHANGE_RETVAL_IF(oc_ctx->backend_type == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+
+	oc_ctx->get_SystemFolderID = get_SystemFolderID;
+	oc_ctx->get_MailboxReplica = get_MailboxReplica;
+	oc_ctx->get_mapistoreURI = get_mapistoreURI;
+	oc_ctx->set_mapistoreURI = set_mapistoreURI;
+	oc_ctx->get_folder_property = get_folder_property;
+	oc_ctx->set_folder_properties = set_folder_properties;
+	oc_ctx->create_folder = create_folder;
+	oc_ctx->message_save = message_save;
+
+	*ctx = oc_ctx;
+
+	return MAPI_E_SUCCESS;
+}
+
+// ^ Mocked backend -----------------------------------------------------------
+
+// v Suite definition ---------------------------------------------------------
+
+static void ocdb_cache_setup(void)
+{
+	enum MAPISTATUS mapi_status;
+	struct openchangedb_context *backend_ctx = NULL;
+
+	mem_ctx = talloc_new(NULL);
+
+	mapi_status = mock_backend_init(mem_ctx, &backend_ctx);
+	if (mapi_status != MAPI_E_SUCCESS) {
+		fprintf(stderr, "Failed to initialize Mocked backend %d\n", mapi_status);
+		ck_abort();
+	}
+	mapi_status = openchangedb_cache_initialize(mem_ctx, CACHE_SIZE, backend_ctx, &oc_ctx);
+	if (mapi_status != MAPI_E_SUCCESS) {
+		fprintf(stderr, "Failed to initialize Cache backend %d\n", mapi_status);
+		ck_abort();
+	}
+
+	ZERO_STRUCT(functions_called);
+}
+
+static void ocdb_cache_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_openchangedb_cache_suite(void)
+{
+	Suite *s = suite_create("Openchangedb Cache backend");
+
+	TCase *tc = tcase_create("Openchangedb Cache interface");
+	tcase_add_checked_fixture(tc, ocdb_cache_setup, ocdb_cache_teardown);
+
+	tcase_add_test(tc, test_cache_SystemFolderID);
+	tcase_add_test(tc, test_cache_failures_not_cached);
+	tcase_add_test(tc, test_cache_MailboxReplica);
+	tcase_add_test(tc, test_cache_mapistoreURI);
+	tcase_add_test(tc, test_cache_folder_property);
+	tcase_add_test(tc, test_cache_create_folder);
+	tcase_add_test(tc, test_cache_max_entries);
+
+	suite_add_tcase(s, tc);
+	return s;
+}
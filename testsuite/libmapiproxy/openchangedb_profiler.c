@@ -0,0 +1,290 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/libmapiproxy/libmapiproxy.h"
+#include "mapiproxy/libmapiproxy/backends/openchangedb_profiler.h"
+#include "libmapi/libmapi.h"
+#include "libmapi/libmapi_private.h"
+#include <unistd.h>
+#include <utime.h>
+
+
+#define FOLDER_ID_EXPECTED 289356276058554369ul
+#define MOCKED_URL "mocked_url"
+
+#define CHECK_SUCCESS(fncall) do { \
+	enum MAPISTATUS ret = fncall; \
+	ck_assert_int_eq(ret, MAPI_E_SUCCESS); \
+} while(0)
+
+
+struct openchangedb_context_checker {
+	int get_SystemFolderID;
+	int get_mapistoreURI;
+};
+
+
+static TALLOC_CTX *mem_ctx;
+static struct openchangedb_context *backend_ctx;
+static struct openchangedb_context *oc_ctx;
+static struct openchangedb_context_checker functions_called;
+
+static char *read_stream(TALLOC_CTX *mem_ctx, FILE *stream)
+{
+	char	*content = talloc_strdup(mem_ctx, "");
+	char	buf[512];
+	size_t	len;
+
+	rewind(stream);
+	while ((len = fread(buf, 1, sizeof(buf) - 1, stream)) > 0) {
+		buf[len] = '\0';
+		content = talloc_strdup_append(content, buf);
+	}
+
+	return content;
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_profiler_counts) {
+	struct openchangedb_profiler_stats	stats;
+	uint64_t				folder_id;
+	char					*uri;
+	int					i;
+
+	for (i = 0; i < 5; i++) {
+		CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", i, &folder_id));
+		ck_assert_int_eq(folder_id, FOLDER_ID_EXPECTED + i);
+	}
+	for (i = 0; i < 2; i++) {
+		ck_assert_int_eq(openchangedb_get_SystemFolderID(oc_ctx, "nobody", i, &folder_id),
+				 MAPI_E_NOT_FOUND);
+	}
+	CHECK_SUCCESS(openchangedb_get_mapistoreURI(mem_ctx, oc_ctx, "recipient",
+						    FOLDER_ID_EXPECTED, &uri, true));
+	ck_assert_str_eq(uri, MOCKED_URL);
+
+	/* Every call reaches the backend exactly once */
+	ck_assert_int_eq(functions_called.get_SystemFolderID, 7);
+	ck_assert_int_eq(functions_called.get_mapistoreURI, 1);
+
+	CHECK_SUCCESS(openchangedb_profiler_get_stats(oc_ctx, "get_SystemFolderID", &stats));
+	ck_assert_int_eq(stats.count, 7);
+	ck_assert_int_eq(stats.errors, 2);
+	ck_assert(stats.max_ns <= stats.total_ns);
+
+	CHECK_SUCCESS(openchangedb_profiler_get_stats(oc_ctx, "get_mapistoreURI", &stats));
+	ck_assert_int_eq(stats.count, 1);
+	ck_assert_int_eq(stats.errors, 0);
+
+	CHECK_SUCCESS(openchangedb_profiler_get_stats(oc_ctx, "get_PublicFolderID", &stats));
+	ck_assert_int_eq(stats.count, 0);
+
+	ck_assert_int_eq(openchangedb_profiler_get_stats(oc_ctx, "no_such_operation", &stats),
+			 MAPI_E_NOT_FOUND);
+	ck_assert_int_eq(openchangedb_profiler_get_stats(backend_ctx, "get_SystemFolderID", &stats),
+			 MAPI_E_INVALID_PARAMETER);
+} END_TEST
+
+START_TEST (test_profiler_dump) {
+	uint64_t	folder_id;
+	FILE		*stream;
+	char		*content;
+	int		i;
+
+	for (i = 0; i < 3; i++) {
+		CHECK_SUCCESS(openchangedb_get_SystemFolderID(oc_ctx, "recipient", i, &folder_id));
+	}
+
+	stream = tmpfile();
+	ck_assert(stream != NULL);
+	CHECK_SUCCESS(openchangedb_profiler_dump(oc_ctx, stream));
+	content = read_stream(mem_ctx, stream);
+	fclose(stream);
+
+	ck_assert(strstr(content, "\"get_SystemFolderID\": {\"count\": 3, \"errors\": 0") != NULL);
+	ck_assert(strstr(content, "\"buckets\": [[") != NULL);
+	/* Operations which were never called are left out */
+	ck_assert(strstr(content, "get_mapistoreURI") == NULL);
+} END_TEST
+
+START_TEST (test_profiler_snapshot) {
+	struct openchangedb_context	*profiler_ctx;
+	char				*prefix;
+	char				*path;
+	uint64_t			folder_id;
+	FILE				*stream;
+	char				*content;
+
+	prefix = talloc_strdup(mem_ctx, "/tmp/openchangedb_profiler_test");
+	path = talloc_asprintf(mem_ctx, "%s.%d.json", prefix, (int) getpid());
+	unlink(path);
+
+	CHECK_SUCCESS(openchangedb_profiler_initialize(mem_ctx, prefix, 0, backend_ctx, &profiler_ctx));
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(profiler_ctx, "recipient", 1, &folder_id));
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(profiler_ctx, "recipient", 2, &folder_id));
+	ck_assert_int_eq(access(path, F_OK), -1);
+
+	CHECK_SUCCESS(openchangedb_profiler_snapshot(profiler_ctx));
+
+	stream = fopen(path, "r");
+	ck_assert(stream != NULL);
+	content = read_stream(mem_ctx, stream);
+	fclose(stream);
+	ck_assert(strstr(content, "\"get_SystemFolderID\": {\"count\": 2") != NULL);
+
+	talloc_free(profiler_ctx);
+	unlink(path);
+
+	/* Contexts without a prefix only keep the histograms in memory */
+	ck_assert_int_eq(openchangedb_profiler_snapshot(oc_ctx), MAPI_E_NOT_INITIALIZED);
+	ck_assert_int_eq(openchangedb_profiler_snapshot(backend_ctx), MAPI_E_INVALID_PARAMETER);
+} END_TEST
+
+START_TEST (test_profiler_snapshot_trigger) {
+	struct openchangedb_context	*profiler_ctx;
+	struct utimbuf			times;
+	char				*prefix;
+	char				*path;
+	char				*trigger;
+	uint64_t			folder_id;
+	FILE				*stream;
+
+	prefix = talloc_strdup(mem_ctx, "/tmp/openchangedb_profiler_trigger_test");
+	path = talloc_asprintf(mem_ctx, "%s.%d.json", prefix, (int) getpid());
+	trigger = talloc_asprintf(mem_ctx, "%s.snapshot", prefix);
+	unlink(path);
+	unlink(trigger);
+
+	CHECK_SUCCESS(openchangedb_profiler_initialize(mem_ctx, prefix, 0, backend_ctx, &profiler_ctx));
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(profiler_ctx, "recipient", 1, &folder_id));
+	ck_assert_int_eq(access(path, F_OK), -1);
+
+	/* Touching the control file requests a snapshot on the next call */
+	stream = fopen(trigger, "w");
+	ck_assert(stream != NULL);
+	fclose(stream);
+	sleep(1);
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(profiler_ctx, "recipient", 2, &folder_id));
+	ck_assert_int_eq(access(path, F_OK), 0);
+
+	/* An unchanged control file does not request another one */
+	unlink(path);
+	sleep(1);
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(profiler_ctx, "recipient", 3, &folder_id));
+	ck_assert_int_eq(access(path, F_OK), -1);
+
+	times.actime = times.modtime = time(NULL) + 10;
+	ck_assert_int_eq(utime(trigger, &times), 0);
+	sleep(1);
+	CHECK_SUCCESS(openchangedb_get_SystemFolderID(profiler_ctx, "recipient", 4, &folder_id));
+	ck_assert_int_eq(access(path, F_OK), 0);
+
+	talloc_free(profiler_ctx);
+	unlink(path);
+	unlink(trigger);
+} END_TEST
+
+// ^ Unit test ----------------------------------------------------------------
+
+// v Mocked backend -----------------------------------------------------------
+
+static enum MAPISTATUS get_SystemFolderID(struct openchangedb_context *self,
+					  const char *recipient, uint32_t SystemIdx,
+					  uint64_t *FolderId)
+{
+	functions_called.get_SystemFolderID++;
+	if (strcmp(recipient, "nobody") == 0) {
+		return MAPI_E_NOT_FOUND;
+	}
+	*FolderId = FOLDER_ID_EXPECTED + SystemIdx;
+
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS get_mapistoreURI(TALLOC_CTX *parent_ctx,
+					struct openchangedb_context *self,
+					const char *username,
+					uint64_t fid, char **mapistoreURL,
+					bool mailboxstore)
+{
+	functions_called.get_mapistoreURI++;
+	*mapistoreURL = talloc_strdup(parent_ctx, MOCKED_URL);
+	return MAPI_E_SUCCESS;
+}
+
+static enum MAPISTATUS mock_backend_init(TALLOC_CTX *mem_ctx,
+					 struct openchangedb_context **ctx)
+{
+	struct openchangedb_context	*oc_ctx = talloc_zero(mem_ctx, struct openchangedb_context);
+
+	OPENCHANGE_RETVAL_IF(oc_ctx == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, NULL);
+
+	oc_ctx->backend_type = talloc_strdup(oc_ctx, "mocked_backend");
+	OPENCHANGE_RETVAL_IF(oc_ctx->backend_type == NULL, MAPI_E_NOT_ENOUGH_RESOURCES, oc_ctx);
+
+	oc_ctx->get_SystemFolderID = get_SystemFolderID;
+	oc_ctx->get_mapistoreURI = get_mapistoreURI;
+
+	*ctx = oc_ctx;
+
+	return MAPI_E_SUCCESS;
+}
+
+// ^ Mocked backend -----------------------------------------------------------
+
+// v Suite definition ---------------------------------------------------------
+
+static void ocdb_profiler_setup(void)
+{
+	enum MAPISTATUS mapi_status;
+
+	mem_ctx = talloc_new(NULL);
+
+	mapi_status = mock_backend_init(mem_ctx, &backend_ctx);
+	ck_assert_int_eq(mapi_status, MAPI_E_SUCCESS);
+	mapi_status = openchangedb_profiler_initialize(mem_ctx, NULL, 0, backend_ctx, &oc_ctx);
+	ck_assert_int_eq(mapi_status, MAPI_E_SUCCESS);
+
+	ZERO_STRUCT(functions_called);
+}
+
+static void ocdb_profiler_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_openchangedb_profiler_suite(void)
+{
+	Suite *s = suite_create("Openchangedb Profiler backend");
+
+	TCase *tc = tcase_create("Openchangedb Profiler interface");
+	tcase_add_checked_fixture(tc, ocdb_profiler_setup, ocdb_profiler_teardown);
+
+	tcase_add_test(tc, test_profiler_counts);
+	tcase_add_test(tc, test_profiler_dump);
+	tcase_add_test(tc, test_profiler_snapshot);
+	tcase_add_test(tc, test_profiler_snapshot_trigger);
+
+	suite_add_tcase(s, tc);
+	return s;
+}
@@ -0,0 +1,305 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) Julien Kerihuel 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <time.h>
+#include "testsuite.h"
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+
+#define	YMON(y,m)	(((y) << 4) | (m))
+
+struct fb_event {
+	time_t		start;
+	time_t		end;
+	uint32_t	status;
+};
+
+/* Global variables */
+static TALLOC_CTX			*g_mem_ctx;
+static struct mapistore_context		*g_mstore_ctx;
+static struct mapistore_backend		g_backend;
+static const uint32_t			g_context_id = 0x2a;
+static int				g_folder;
+static int				g_table;
+static struct fb_event			*g_events;
+static uint32_t				g_events_count;
+
+static time_t utc(int year, int mon, int mday, int hour, int min)
+{
+	struct tm	tm;
+
+	memset(&tm, 0, sizeof (struct tm));
+	tm.tm_year = year - 1900;
+	tm.tm_mon = mon - 1;
+	tm.tm_mday = mday;
+	tm.tm_hour = hour;
+	tm.tm_min = min;
+
+	return timegm(&tm);
+}
+
+static struct FILETIME *filetime(TALLOC_CTX *mem_ctx, time_t t)
+{
+	struct FILETIME	*ft;
+	NTTIME		nt_time;
+
+	ft = talloc_zero(mem_ctx, struct FILETIME);
+	unix_to_nt_time(&nt_time, t);
+	ft->dwLowDateTime = (nt_time & 0xffffffff);
+	ft->dwHighDateTime = nt_time >> 32;
+
+	return ft;
+}
+
+static enum mapistore_error mock_open_table(void *folder, TALLOC_CTX *mem_ctx, enum mapistore_table_type table_type,
+					    uint32_t handle_id, void **table, uint32_t *row_count)
+{
+	ck_assert_int_eq(table_type, MAPISTORE_MESSAGE_TABLE);
+	*table = &g_table;
+	*row_count = g_events_count;
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error mock_set_columns(void *table, uint16_t count, enum MAPITAGS *properties)
+{
+	ck_assert_int_eq(count, 3);
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error mock_set_restrictions(void *table, struct mapi_SRestriction *res, uint8_t *table_status)
+{
+	return MAPISTORE_SUCCESS;
+}
+
+static enum mapistore_error mock_get_row(void *table, TALLOC_CTX *mem_ctx, enum mapistore_query_type query_type,
+					 uint32_t rowid, struct mapistore_property_data **data)
+{
+	struct mapistore_property_data	*row;
+	uint32_t			*status;
+
+	if (rowid >= g_events_count) {
+		return MAPISTORE_ERR_NOT_FOUND;
+	}
+
+	row = talloc_zero_array(mem_ctx, struct mapistore_property_data, 3);
+	row[0].data = filetime(row, g_events[rowid].start);
+	row[1].data = filetime(row, g_events[rowid].end);
+	status = talloc_zero(row, uint32_t);
+	*status = g_events[rowid].status;
+	row[2].data = status;
+	*data = row;
+
+	return MAPISTORE_SUCCESS;
+}
+
+/* check a month binary against (start, end) minute pairs */
+static void check_ranges(struct Binary_r *bin, const uint16_t *expected, uint32_t count)
+{
+	uint32_t	i;
+
+	ck_assert_int_eq(bin->cb, count * sizeof (uint16_t));
+	for (i = 0; i < count; i++) {
+		ck_assert_int_eq(bin->lpb[2 * i] | (bin->lpb[2 * i + 1] << 8), expected[i]);
+	}
+}
+
+static struct mapistore_freebusy_properties *fetch(int start_year, int start_mon, int end_year, int end_mon, int end_mday)
+{
+	struct mapistore_freebusy_properties	*fb_props = NULL;
+	struct tm				start_tm, end_tm;
+	enum mapistore_error			retval;
+
+	memset(&start_tm, 0, sizeof (struct tm));
+	start_tm.tm_year = start_year - 1900;
+	start_tm.tm_mon = start_mon - 1;
+	start_tm.tm_mday = 1;
+
+	memset(&end_tm, 0, sizeof (struct tm));
+	end_tm.tm_year = end_year - 1900;
+	end_tm.tm_mon = end_mon - 1;
+	end_tm.tm_mday = end_mday;
+	end_tm.tm_hour = 23;
+	end_tm.tm_min = 59;
+	end_tm.tm_sec = 59;
+
+	retval = mapistore_folder_fetch_freebusy_properties(g_mstore_ctx, g_context_id, &g_folder,
+							    &start_tm, &end_tm, g_mem_ctx, &fb_props);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(fb_props != NULL);
+
+	return fb_props;
+}
+
+START_TEST(test_freebusy_ranges) {
+	struct mapistore_freebusy_properties	*fb_props;
+	struct fb_event				events[] = {
+		{ utc(2015, 1, 1, 10, 0), utc(2015, 1, 1, 11, 0), olBusy },
+		{ utc(2015, 1, 1, 10, 30), utc(2015, 1, 1, 12, 0), olBusy },
+		{ utc(2015, 1, 1, 12, 0), utc(2015, 1, 1, 13, 0), olOutOfOffice },
+		{ utc(2015, 1, 31, 23, 0), utc(2015, 2, 1, 1, 0), olBusy },
+		{ utc(2014, 12, 31, 22, 0), utc(2015, 1, 1, 1, 0), olFree },
+		{ utc(2015, 3, 31, 23, 0), utc(2015, 4, 2, 0, 0), olTentative },
+		{ utc(2015, 2, 10, 8, 0), utc(2015, 2, 10, 8, 0), olBusy },
+	};
+	const uint16_t	busy_jan[] = { 600, 719, 44580, 44639 };
+	const uint16_t	busy_feb[] = { 0, 59 };
+	const uint16_t	away_jan[] = { 720, 779 };
+	const uint16_t	merged_jan[] = { 600, 779, 44580, 44639 };
+	const uint16_t	free_jan[] = { 0, 59 };
+	const uint16_t	tentative_mar[] = { 44580, 44639 };
+
+	g_events = events;
+	g_events_count = sizeof (events) / sizeof (events[0]);
+
+	fb_props = fetch(2015, 1, 2015, 3, 31);
+	ck_assert_int_eq(fb_props->nbr_months, 3);
+	ck_assert_int_eq(fb_props->months_ranges[0], YMON(2015, 1));
+	ck_assert_int_eq(fb_props->months_ranges[1], YMON(2015, 2));
+	ck_assert_int_eq(fb_props->months_ranges[2], YMON(2015, 3));
+
+	/* minutes since 1601 */
+	ck_assert_int_eq(fb_props->publish_start, utc(2015, 1, 1, 0, 0) / 60 + 194074560);
+
+	/* overlapping events are merged, events crossing months are split */
+	check_ranges(&fb_props->freebusy_busy[0], busy_jan, 4);
+	check_ranges(&fb_props->freebusy_busy[1], busy_feb, 2);
+	check_ranges(&fb_props->freebusy_busy[2], NULL, 0);
+	check_ranges(&fb_props->freebusy_away[0], away_jan, 2);
+	/* adjacent busy and out of office events merge */
+	check_ranges(&fb_props->freebusy_merged[0], merged_jan, 4);
+	check_ranges(&fb_props->freebusy_merged[1], busy_feb, 2);
+	/* events are clamped to the published range */
+	check_ranges(&fb_props->freebusy_free[0], free_jan, 2);
+	check_ranges(&fb_props->freebusy_tentative[0], NULL, 0);
+	check_ranges(&fb_props->freebusy_tentative[2], tentative_mar, 2);
+
+} END_TEST
+
+START_TEST(test_freebusy_leap_year) {
+	struct mapistore_freebusy_properties	*fb_props;
+	struct fb_event				events[] = {
+		{ utc(2016, 2, 29, 0, 0), utc(2016, 3, 1, 0, 0), olBusy },
+		{ utc(2016, 12, 31, 23, 30), utc(2017, 1, 1, 0, 30), olBusy },
+	};
+	const uint16_t	busy_feb[] = { 40320, 41759 };
+	const uint16_t	busy_dec[] = { 44610, 44639 };
+	const uint16_t	busy_jan[] = { 0, 29 };
+
+	g_events = events;
+	g_events_count = sizeof (events) / sizeof (events[0]);
+
+	fb_props = fetch(2016, 2, 2016, 3, 31);
+	ck_assert_int_eq(fb_props->nbr_months, 2);
+	check_ranges(&fb_props->freebusy_busy[0], busy_feb, 2);
+	check_ranges(&fb_props->freebusy_busy[1], NULL, 0);
+
+	/* range crossing a year */
+	fb_props = fetch(2016, 12, 2017, 1, 31);
+	ck_assert_int_eq(fb_props->nbr_months, 2);
+	ck_assert_int_eq(fb_props->months_ranges[0], YMON(2016, 12));
+	ck_assert_int_eq(fb_props->months_ranges[1], YMON(2017, 1));
+	check_ranges(&fb_props->freebusy_busy[0], busy_dec, 2);
+	check_ranges(&fb_props->freebusy_busy[1], busy_jan, 2);
+
+} END_TEST
+
+START_TEST(test_freebusy_timezone) {
+	struct mapistore_freebusy_properties	*fb_props;
+	struct fb_event				events[] = {
+		{ utc(2015, 1, 1, 10, 0), utc(2015, 1, 1, 11, 0), olBusy },
+	};
+	const uint16_t	busy_jan[] = { 600, 659 };
+	const char	*tz;
+
+	g_events = events;
+	g_events_count = sizeof (events) / sizeof (events[0]);
+
+	/* ranges are computed in UTC whatever the process timezone is,
+	   and the process timezone is left alone */
+	setenv("TZ", "America/New_York", 1);
+	tzset();
+
+	fb_props = fetch(2015, 1, 2015, 1, 31);
+	check_ranges(&fb_props->freebusy_busy[0], busy_jan, 2);
+	ck_assert_int_eq(fb_props->publish_start, utc(2015, 1, 1, 0, 0) / 60 + 194074560);
+
+	tz = getenv("TZ");
+	ck_assert(tz != NULL);
+	ck_assert_str_eq(tz, "America/New_York");
+
+	unsetenv("TZ");
+	tzset();
+
+} END_TEST
+
+static void freebusy_setup(void)
+{
+	struct backend_context_list	*backend_list;
+
+	g_mem_ctx = talloc_named(NULL, 0, "freebusy_setup");
+	ck_assert(g_mem_ctx != NULL);
+
+	memset(&g_backend, 0, sizeof (struct mapistore_backend));
+	g_backend.folder.open_table = mock_open_table;
+	g_backend.table.set_columns = mock_set_columns;
+	g_backend.table.set_restrictions = mock_set_restrictions;
+	g_backend.table.get_row = mock_get_row;
+
+	/* mapistore context with a single mock backend context */
+	g_mstore_ctx = talloc_zero(g_mem_ctx, struct mapistore_context);
+	ck_assert(g_mstore_ctx != NULL);
+	g_mstore_ctx->processing_ctx = talloc_zero(g_mstore_ctx, struct processing_context);
+	ck_assert(g_mstore_ctx->processing_ctx != NULL);
+
+	backend_list = talloc_zero(g_mstore_ctx, struct backend_context_list);
+	ck_assert(backend_list != NULL);
+	backend_list->ctx = talloc_zero(backend_list, struct backend_context);
+	ck_assert(backend_list->ctx != NULL);
+	backend_list->ctx->backend = &g_backend;
+	backend_list->ctx->context_id = g_context_id;
+	DLIST_ADD(g_mstore_ctx->context_list, backend_list);
+
+	g_events = NULL;
+	g_events_count = 0;
+}
+
+static void freebusy_teardown(void)
+{
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapistore_freebusy_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+
+	s = suite_create("libmapistore freebusy");
+
+	tc = tcase_create("freebusy ranges");
+	tcase_add_checked_fixture(tc, freebusy_setup, freebusy_teardown);
+	tcase_add_test(tc, test_freebusy_ranges);
+	tcase_add_test(tc, test_freebusy_leap_year);
+	tcase_add_test(tc, test_freebusy_timezone);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
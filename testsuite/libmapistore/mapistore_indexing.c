@@ -456,6 +456,88 @@ START_TEST(test_get_fmid_with_wildcard) {
 } END_TEST
 
 
+START_TEST(test_get_fmid_after_update) {
+	enum mapistore_error	ret;
+	uint64_t		fmid_res;
+	bool			soft_deleted = true;
+
+	ret = g_ictx->add_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, INDEXING_TEST_URI);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->update_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, INDEXING_TEST_URI_2);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_TEST_URI, false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_TEST_URI_2, false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(!soft_deleted);
+	ck_assert(fmid_res == INDEXING_TEST_FMID);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "idxtest://url/test2*", true, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(fmid_res == INDEXING_TEST_FMID);
+
+	ret = g_ictx->del_fmid(g_ictx, g_test_username, INDEXING_TEST_FMID, MAPISTORE_PERMANENT_DELETE);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, "idxtest://url/test2*", true, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+} END_TEST
+
+/* TDB reverse URI index */
+
+static void _tdb_raw_store(const char *key, const char *value)
+{
+	TDB_DATA	k, v;
+
+	k.dptr = (unsigned char *) key;
+	k.dsize = strlen(key);
+	v.dptr = (unsigned char *) value;
+	v.dsize = strlen(value);
+	ck_assert_int_eq(tdb_store(((struct tdb_wrap *) g_ictx->data)->tdb, k, v, TDB_REPLACE), 0);
+}
+
+static void _tdb_raw_delete(const char *key)
+{
+	TDB_DATA	k;
+
+	k.dptr = (unsigned char *) key;
+	k.dsize = strlen(key);
+	tdb_delete(((struct tdb_wrap *) g_ictx->data)->tdb, k);
+}
+
+START_TEST(test_tdb_migrate_uri_index) {
+	enum mapistore_error	ret;
+	uint64_t		fmid_res;
+	bool			soft_deleted = true;
+
+	/* Records written before the URI: keyspace existed */
+	_tdb_raw_delete(MAPISTORE_INDEXING_VERSION_KEY);
+	_tdb_raw_delete(MAPISTORE_URI_TAG INDEXING_EXIST_URL);
+	_tdb_raw_store("0x0000000000123456", INDEXING_TEST_URI "/");
+	_tdb_raw_store(MAPISTORE_SOFT_DELETED_TAG "0x0000000000123457", INDEXING_TEST_URI_2);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_EXIST_URL, false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_ERR_NOT_FOUND);
+
+	ret = mapistore_indexing_tdb_init(g_mstore_ctx, g_test_username, &g_ictx);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_EXIST_URL, false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(fmid_res == INDEXING_EXIST_FMID);
+	ck_assert(!soft_deleted);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_TEST_URI, false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(fmid_res == INDEXING_TEST_FMID);
+
+	ret = g_ictx->get_fmid(g_ictx, g_test_username, INDEXING_TEST_URI_2, false, &fmid_res, &soft_deleted);
+	ck_assert_int_eq(ret, MAPISTORE_SUCCESS);
+	ck_assert(fmid_res == INDEXING_TEST_FMID + 1);
+	ck_assert(soft_deleted);
+} END_TEST
+
+
 /* allocate_fmid */
 
 START_TEST (test_allocate_fmid) {
@@ -564,6 +646,7 @@ static TCase *create_test_case_indexing_interface(const char *name, SFun setup,
 	tcase_add_test(tc_interface, test_get_fmid_sanity);
 	tcase_add_test(tc_interface, test_get_fmid);
 	tcase_add_test(tc_interface, test_get_fmid_with_wildcard);
+	tcase_add_test(tc_interface, test_get_fmid_after_update);
 	tcase_add_test(tc_interface, test_allocate_fmid);
 
 	return tc_interface;
@@ -598,6 +681,7 @@ Suite *mapistore_indexing_mysql_suite(void)
 Suite *mapistore_indexing_tdb_suite(void)
 {
 	Suite *s;
+	TCase *tc_internal;
 	TCase *tc_interface;
 
 	s = suite_create("libmapistore indexing: TDB backend");
@@ -605,5 +689,10 @@ Suite *mapistore_indexing_tdb_suite(void)
 	tc_interface = create_test_case_indexing_interface("TDB", tdb_setup, tdb_teardown);
 	suite_add_tcase(s, tc_interface);
 
+	tc_internal = tcase_create("indexing: TDB backend internal");
+	tcase_add_checked_fixture(tc_internal, tdb_setup, tdb_teardown);
+	tcase_add_test(tc_internal, test_tdb_migrate_uri_index);
+	suite_add_tcase(s, tc_internal);
+
 	return s;
 }
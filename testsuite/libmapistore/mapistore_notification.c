@@ -1164,6 +1164,221 @@ START_TEST(payload_newmail) {
 
 } END_TEST
 
+START_TEST(local_cache) {
+	TALLOC_CTX				*mem_ctx;
+	struct mapistore_context		mstore_ctx;
+	enum mapistore_error			retval;
+	struct loadparm_context			*lp_ctx;
+	struct mapistore_notification_context	*ctx = NULL;
+	struct mapistore_notification_subscription	r;
+	struct mapistore_notification_resolver_record	*records = NULL;
+	uint32_t				count = 0;
+	const char				**hosts = NULL;
+	uint8_t					*payload = NULL;
+	size_t					length = 0;
+	bool					bret;
+
+	mem_ctx = talloc_named(NULL, 0, "local_cache");
+	ck_assert(mem_ctx != NULL);
+
+	lp_ctx = loadparm_init(mem_ctx);
+	ck_assert(lp_ctx != NULL);
+
+	bret = lpcfg_set_cmdline(lp_ctx, "mapistore:notification_cache", "local");
+	ck_assert(bret == true);
+
+	/* the in-process store is not thread-safe */
+	bret = lpcfg_set_cmdline(lp_ctx, "mapistore:threading", "true");
+	ck_assert(bret == true);
+	retval = mapistore_notification_init(mem_ctx, lp_ctx, &ctx);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_CONTEXT_FAILED);
+
+	bret = lpcfg_set_cmdline(lp_ctx, "mapistore:threading", "false");
+	ck_assert(bret == true);
+	retval = mapistore_notification_init(mem_ctx, lp_ctx, &ctx);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(ctx->local == true);
+	mstore_ctx.notification_ctx = ctx;
+
+	/* resolver records */
+	retval = mapistore_notification_resolver_add(&mstore_ctx, gl_cn, gl_host1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_add(&mstore_ctx, gl_cn_lowercase, gl_host2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_add(&mstore_ctx, gl_cn, gl_host2);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_EXIST);
+
+	retval = mapistore_notification_resolver_get(mem_ctx, &mstore_ctx, gl_cn, &count, &hosts);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(count, 2);
+	ck_assert_str_eq(hosts[0], gl_host1);
+	ck_assert_str_eq(hosts[1], gl_host2);
+	talloc_free(hosts);
+
+	retval = mapistore_notification_resolver_delete(&mstore_ctx, gl_cn, gl_host1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_delete(&mstore_ctx, gl_cn, gl_host2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_exist(&mstore_ctx, gl_cn);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+
+	/* an emptied record reads as absent and can be filled again */
+	retval = mapistore_notification_resolver_get(mem_ctx, &mstore_ctx, gl_cn, &count, &hosts);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	retval = mapistore_notification_resolver_get_multi(mem_ctx, &mstore_ctx, 1, &gl_cn, &records);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(records[0].count, 0);
+	ck_assert(records[0].hosts == NULL);
+	talloc_free(records);
+	retval = mapistore_notification_resolver_delete(&mstore_ctx, gl_cn, gl_host1);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+
+	retval = mapistore_notification_resolver_add(&mstore_ctx, gl_cn, gl_host3);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_get(mem_ctx, &mstore_ctx, gl_cn, &count, &hosts);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(count, 1);
+	ck_assert_str_eq(hosts[0], gl_host3);
+	talloc_free(hosts);
+	retval = mapistore_notification_resolver_delete(&mstore_ctx, gl_cn, gl_host3);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	/* subscription records */
+	retval = mapistore_notification_subscription_add(&mstore_ctx, gl_uuid, gl_handle, gl_flags_newmail,
+							 gl_FolderId, 0, 0, NULL);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_subscription_add(&mstore_ctx, gl_uuid, gl_handle + 1, gl_flags_table,
+							 gl_FolderId, 0, 2, gl_tags);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_subscription_add(&mstore_ctx, gl_uuid, gl_handle, gl_flags_wholestore,
+							 0, 0, 0, NULL);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_EXIST);
+
+	retval = mapistore_notification_subscription_delete_by_handle(&mstore_ctx, gl_uuid, gl_handle);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_subscription_get(mem_ctx, &mstore_ctx, gl_uuid, &r);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(r.v.v1.count, 1);
+	ck_assert_int_eq(r.v.v1.subscription[0].handle, gl_handle + 1);
+	ck_assert_int_eq(r.v.v1.subscription[0].count, 2);
+	ck_assert_int_eq(r.v.v1.subscription[0].properties[1], PidTagSubject);
+
+	retval = mapistore_notification_subscription_delete_by_handle(&mstore_ctx, gl_uuid, gl_handle + 1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_subscription_exist(&mstore_ctx, gl_uuid);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	retval = mapistore_notification_subscription_get(mem_ctx, &mstore_ctx, gl_uuid, &r);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+
+	retval = mapistore_notification_subscription_add(&mstore_ctx, gl_uuid, gl_handle, gl_flags_newmail,
+							 gl_FolderId, 0, 0, NULL);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_subscription_exist(&mstore_ctx, gl_uuid);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	retval = mapistore_notification_subscription_delete(&mstore_ctx, gl_uuid);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	/* deliver payloads are appended */
+	retval = mapistore_notification_deliver_add(&mstore_ctx, gl_uuid, (uint8_t *)gl_deliver_1, strlen(gl_deliver_1));
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_deliver_add(&mstore_ctx, gl_uuid, (uint8_t *)gl_deliver_2, strlen(gl_deliver_2) + 1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_deliver_get(mem_ctx, &mstore_ctx, gl_uuid, &payload, &length);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(length, strlen(gl_deliver_1) + strlen(gl_deliver_2) + 1);
+	ck_assert_str_eq((char *) payload, "deliver1deliver2");
+
+	retval = mapistore_notification_deliver_delete(&mstore_ctx, gl_uuid);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_deliver_exist(&mstore_ctx, gl_uuid);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+
+	talloc_free(lp_ctx);
+	talloc_free(mem_ctx);
+
+} END_TEST
+
+
+START_TEST(resolver_get_multi) {
+	TALLOC_CTX					*mem_ctx;
+	struct mapistore_context			mstore_ctx;
+	enum mapistore_error				retval;
+	struct loadparm_context				*lp_ctx;
+	struct mapistore_notification_context		*ctx = NULL;
+	struct mapistore_notification_context		_ctx;
+	struct mapistore_notification_resolver_record	*records = NULL;
+	const char					*cns[] = { "multi1", "nonexistent", "Multi2", "multi1" };
+
+	/* Check sanity check compliance */
+	retval = mapistore_notification_resolver_get_multi(NULL, NULL, 4, cns, &records);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_INITIALIZED);
+
+	retval = mapistore_notification_resolver_get_multi(NULL, &mstore_ctx, 4, NULL, &records);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	retval = mapistore_notification_resolver_get_multi(NULL, &mstore_ctx, 4, cns, NULL);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	mstore_ctx.notification_ctx = NULL;
+	retval = mapistore_notification_resolver_get_multi(NULL, &mstore_ctx, 4, cns, &records);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
+
+	mstore_ctx.notification_ctx = &_ctx;
+	mstore_ctx.notification_ctx->memc_ctx = NULL;
+	retval = mapistore_notification_resolver_get_multi(NULL, &mstore_ctx, 4, cns, &records);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
+
+	/* Initialize mapistore notification system */
+	mem_ctx = talloc_named(NULL, 0, "resolver_get_multi");
+	ck_assert(mem_ctx != NULL);
+
+	lp_ctx = loadparm_init(mem_ctx);
+	ck_assert(lp_ctx != NULL);
+
+	retval = mapistore_notification_init(mem_ctx, lp_ctx, &ctx);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	mstore_ctx.notification_ctx = ctx;
+
+	retval = mapistore_notification_resolver_add(&mstore_ctx, "multi1", gl_host1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_add(&mstore_ctx, "multi2", gl_host2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_add(&mstore_ctx, "multi2", gl_host3);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	/* records come back in request order, duplicates included */
+	retval = mapistore_notification_resolver_get_multi(mem_ctx, &mstore_ctx, 4, cns, &records);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_str_eq(records[0].cn, "multi1");
+	ck_assert_int_eq(records[0].count, 1);
+	ck_assert_str_eq(records[0].hosts[0], gl_host1);
+	ck_assert_int_eq(records[1].count, 0);
+	ck_assert(records[1].hosts == NULL);
+	ck_assert_int_eq(records[2].count, 2);
+	ck_assert_str_eq(records[2].hosts[0], gl_host2);
+	ck_assert_str_eq(records[2].hosts[1], gl_host3);
+	ck_assert_int_eq(records[3].count, 1);
+	ck_assert_str_eq(records[3].hosts[0], gl_host1);
+	talloc_free(records);
+
+	/* invalid cn */
+	cns[1] = "Foo Bar";
+	retval = mapistore_notification_resolver_get_multi(mem_ctx, &mstore_ctx, 4, cns, &records);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_DATA);
+
+	retval = mapistore_notification_resolver_delete(&mstore_ctx, "multi1", gl_host1);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_delete(&mstore_ctx, "multi2", gl_host2);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	retval = mapistore_notification_resolver_delete(&mstore_ctx, "multi2", gl_host3);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	talloc_free(lp_ctx);
+	talloc_free(mem_ctx);
+
+} END_TEST
+
 Suite *mapistore_notification_suite(void)
 {
 	Suite	*s;
@@ -1173,6 +1388,7 @@ Suite *mapistore_notification_suite(void)
 	TCase	*tc_subscription;
 	TCase	*tc_deliver;
 	TCase	*tc_payload;
+	TCase	*tc_local;
 
 	s = suite_create("libmapistore notification");
 
@@ -1198,6 +1414,7 @@ Suite *mapistore_notification_suite(void)
 	tcase_add_test(tc_resolver, resolver_exist);
 	tcase_add_test(tc_resolver, resolver_get);
 	tcase_add_test(tc_resolver, resolver_delete);
+	tcase_add_test(tc_resolver, resolver_get_multi);
 	suite_add_tcase(s, tc_resolver);
 
 	/* Subscription */
@@ -1222,5 +1439,10 @@ Suite *mapistore_notification_suite(void)
 	tcase_add_test(tc_payload, payload_newmail);
 	suite_add_tcase(s, tc_payload);
 
+	/* In-process cache */
+	tc_local = tcase_create("local cache");
+	tcase_add_test(tc_local, local_cache);
+	suite_add_tcase(s, tc_local);
+
 	return s;
 }
@@ -0,0 +1,314 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) Julien Kerihuel 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <tevent.h>
+#include "testsuite.h"
+#include "mapiproxy/libmapistore/mapistore.h"
+#include "mapiproxy/libmapistore/mapistore_errors.h"
+#include "mapiproxy/libmapistore/mapistore_private.h"
+
+#define	PREFETCH_MIDS	20
+
+/* Global variables */
+static TALLOC_CTX			*g_mem_ctx;
+static struct loadparm_context		*g_lp_ctx;
+static struct mapistore_context		*g_mstore_ctx;
+static struct mapistore_backend		g_backend;
+static const uint32_t			g_context_id = 0x2a;
+static uint64_t				g_mids[PREFETCH_MIDS];
+static int				g_folder;
+
+/* mock backend counters */
+static uint32_t				g_preload_calls;
+static uint64_t				g_preload_first;
+static uint32_t				g_preload_count;
+
+static enum mapistore_error mock_preload_message_bodies(void *folder,
+							enum mapistore_table_type table_type,
+							const struct UI8Array_r *mids)
+{
+	ck_assert(folder != NULL);
+	ck_assert_int_eq(table_type, MAPISTORE_MESSAGE_TABLE);
+
+	g_preload_calls++;
+	g_preload_count = mids->cValues;
+	g_preload_first = mids->cValues ? mids->lpui8[0] : 0;
+
+	return MAPISTORE_SUCCESS;
+}
+
+static void hint_all(void)
+{
+	struct UI8Array_r	mids;
+	enum mapistore_error	retval;
+
+	mids.cValues = PREFETCH_MIDS;
+	mids.lpui8 = g_mids;
+	retval = mapistore_prefetch_hint(g_mstore_ctx, g_context_id, &g_folder, MAPISTORE_MESSAGE_TABLE, &mids);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+}
+
+START_TEST(test_disabled) {
+	struct mapistore_prefetch_context	*prefetch_ctx = (struct mapistore_prefetch_context *) 0x1;
+	struct mapistore_prefetch_stats		stats;
+	struct UI8Array_r			mids;
+	enum mapistore_error			retval;
+	bool					bret;
+
+	bret = lpcfg_set_cmdline(g_lp_ctx, "mapistore:prefetch", "false");
+	ck_assert(bret == true);
+
+	retval = mapistore_prefetch_init(g_mstore_ctx, g_lp_ctx, &prefetch_ctx);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(prefetch_ctx == NULL);
+
+	talloc_free(g_mstore_ctx->prefetch_ctx);
+	g_mstore_ctx->prefetch_ctx = NULL;
+
+	mids.cValues = PREFETCH_MIDS;
+	mids.lpui8 = g_mids;
+	retval = mapistore_prefetch_hint(g_mstore_ctx, g_context_id, &g_folder, MAPISTORE_MESSAGE_TABLE, &mids);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
+	retval = mapistore_prefetch_access(g_mstore_ctx, g_context_id, g_mids[0]);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
+	retval = mapistore_prefetch_get_stats(g_mstore_ctx, &stats);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_AVAILABLE);
+	ck_assert_int_eq(g_preload_calls, 0);
+
+} END_TEST
+
+START_TEST(test_sanity) {
+	struct UI8Array_r	mids;
+	enum mapistore_error	retval;
+
+	retval = mapistore_prefetch_init(NULL, g_lp_ctx, &g_mstore_ctx->prefetch_ctx);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	mids.cValues = PREFETCH_MIDS;
+	mids.lpui8 = NULL;
+	retval = mapistore_prefetch_hint(g_mstore_ctx, g_context_id, &g_folder, MAPISTORE_MESSAGE_TABLE, &mids);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_PARAMETER);
+	retval = mapistore_prefetch_hint(g_mstore_ctx, g_context_id, NULL, MAPISTORE_MESSAGE_TABLE, &mids);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_PARAMETER);
+	retval = mapistore_prefetch_hint(g_mstore_ctx, g_context_id, &g_folder, MAPISTORE_MESSAGE_TABLE, NULL);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_INVALID_PARAMETER);
+
+	/* reads outside any hinted stream are not tracked */
+	retval = mapistore_prefetch_access(g_mstore_ctx, g_context_id, g_mids[0]);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	ck_assert_int_eq(g_preload_calls, 0);
+
+} END_TEST
+
+START_TEST(test_sequential_synchronous) {
+	struct mapistore_prefetch_stats	stats;
+	enum mapistore_error		retval;
+	uint32_t			i;
+
+	/* without event context the first cache_size bodies are preloaded at once */
+	hint_all();
+	ck_assert_int_eq(g_preload_calls, 1);
+	ck_assert_int_eq(g_preload_count, 8);
+	ck_assert(g_preload_first == g_mids[0]);
+
+	for (i = 0; i < PREFETCH_MIDS; i++) {
+		retval = mapistore_prefetch_access(g_mstore_ctx, g_context_id, g_mids[i]);
+		ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+		ck_assert(g_preload_count <= 8);
+	}
+
+	retval = mapistore_prefetch_get_stats(g_mstore_ctx, &stats);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(stats.hits, PREFETCH_MIDS);
+	ck_assert_int_eq(stats.misses, 0);
+	ck_assert_int_eq(stats.preloads, g_preload_calls);
+	ck_assert_int_eq(stats.deferred, 0);
+
+} END_TEST
+
+START_TEST(test_random_miss) {
+	struct mapistore_prefetch_stats	stats;
+	enum mapistore_error		retval;
+
+	hint_all();
+
+	/* jumping past the preloaded range loads the next window from there */
+	retval = mapistore_prefetch_access(g_mstore_ctx, g_context_id, g_mids[15]);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(g_preload_first == g_mids[15]);
+
+	retval = mapistore_prefetch_access(g_mstore_ctx, g_context_id, g_mids[16]);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	retval = mapistore_prefetch_get_stats(g_mstore_ctx, &stats);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(stats.hits, 1);
+	ck_assert_int_eq(stats.misses, 1);
+
+} END_TEST
+
+START_TEST(test_deferred) {
+	struct tevent_context		*ev;
+	struct mapistore_prefetch_stats	stats;
+	enum mapistore_error		retval;
+	uint32_t			i, j;
+
+	ev = tevent_context_init(g_mem_ctx);
+	ck_assert(ev != NULL);
+
+	retval = mapistore_prefetch_set_event_context(g_mstore_ctx, ev);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	/* the hint itself does not block on the backend */
+	hint_all();
+	ck_assert_int_eq(g_preload_calls, 0);
+	tevent_loop_once(ev);
+	ck_assert_int_eq(g_preload_calls, 1);
+
+	/* requests reading 3 messages each, the event loop running in between */
+	for (i = 0; i < PREFETCH_MIDS; i += 3) {
+		for (j = i; j < i + 3 && j < PREFETCH_MIDS; j++) {
+			retval = mapistore_prefetch_access(g_mstore_ctx, g_context_id, g_mids[j]);
+			ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+		}
+		/* an empty event loop would block, only run it when needed */
+		if (g_mstore_ctx->prefetch_ctx->scheduled) {
+			tevent_loop_once(ev);
+		}
+	}
+
+	retval = mapistore_prefetch_get_stats(g_mstore_ctx, &stats);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(stats.hits, PREFETCH_MIDS);
+	ck_assert_int_eq(stats.misses, 0);
+	ck_assert_int_eq(stats.deferred, stats.preloads);
+
+	retval = mapistore_prefetch_set_event_context(g_mstore_ctx, NULL);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	talloc_free(ev);
+
+} END_TEST
+
+START_TEST(test_stream_limit) {
+	struct mapistore_prefetch_stats	stats;
+	struct UI8Array_r		mids;
+	enum mapistore_error		retval;
+	int				folders[MAPISTORE_PREFETCH_MAX_STREAMS + 2];
+	uint32_t			i;
+
+	mids.cValues = 1;
+	for (i = 0; i < MAPISTORE_PREFETCH_MAX_STREAMS + 2; i++) {
+		mids.lpui8 = &g_mids[i];
+		retval = mapistore_prefetch_hint(g_mstore_ctx, g_context_id, &folders[i], MAPISTORE_MESSAGE_TABLE, &mids);
+		ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	}
+	ck_assert_int_eq(g_mstore_ctx->prefetch_ctx->stream_count, MAPISTORE_PREFETCH_MAX_STREAMS);
+
+	retval = mapistore_prefetch_get_stats(g_mstore_ctx, &stats);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(stats.evictions, 2);
+
+	/* least recently used streams are the ones dropped */
+	retval = mapistore_prefetch_access(g_mstore_ctx, g_context_id, g_mids[0]);
+	ck_assert_int_eq(retval, MAPISTORE_ERR_NOT_FOUND);
+	retval = mapistore_prefetch_access(g_mstore_ctx, g_context_id, g_mids[2]);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+
+	/* release a single folder, then the whole context */
+	retval = mapistore_prefetch_release(g_mstore_ctx, g_context_id, &folders[2]);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(g_mstore_ctx->prefetch_ctx->stream_count, MAPISTORE_PREFETCH_MAX_STREAMS - 1);
+	retval = mapistore_prefetch_release(g_mstore_ctx, g_context_id, NULL);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert_int_eq(g_mstore_ctx->prefetch_ctx->stream_count, 0);
+
+} END_TEST
+
+static void prefetch_setup(void)
+{
+	struct backend_context_list	*backend_list;
+	enum mapistore_error		retval;
+	uint32_t			i;
+	bool				bret;
+
+	g_mem_ctx = talloc_named(NULL, 0, "prefetch_setup");
+	ck_assert(g_mem_ctx != NULL);
+
+	g_lp_ctx = loadparm_init(g_mem_ctx);
+	ck_assert(g_lp_ctx != NULL);
+	bret = lpcfg_set_cmdline(g_lp_ctx, "mapistore:prefetch_window", "4");
+	ck_assert(bret == true);
+	bret = lpcfg_set_cmdline(g_lp_ctx, "mapistore:prefetch_cache_size", "8");
+	ck_assert(bret == true);
+
+	memset(&g_backend, 0, sizeof (struct mapistore_backend));
+	g_backend.folder.preload_message_bodies = mock_preload_message_bodies;
+
+	/* mapistore context with a single mock backend context */
+	g_mstore_ctx = talloc_zero(g_mem_ctx, struct mapistore_context);
+	ck_assert(g_mstore_ctx != NULL);
+	g_mstore_ctx->processing_ctx = talloc_zero(g_mstore_ctx, struct processing_context);
+	ck_assert(g_mstore_ctx->processing_ctx != NULL);
+
+	backend_list = talloc_zero(g_mstore_ctx, struct backend_context_list);
+	ck_assert(backend_list != NULL);
+	backend_list->ctx = talloc_zero(backend_list, struct backend_context);
+	ck_assert(backend_list->ctx != NULL);
+	backend_list->ctx->backend = &g_backend;
+	backend_list->ctx->context_id = g_context_id;
+	DLIST_ADD(g_mstore_ctx->context_list, backend_list);
+
+	retval = mapistore_prefetch_init(g_mstore_ctx, g_lp_ctx, &g_mstore_ctx->prefetch_ctx);
+	ck_assert_int_eq(retval, MAPISTORE_SUCCESS);
+	ck_assert(g_mstore_ctx->prefetch_ctx != NULL);
+
+	for (i = 0; i < PREFETCH_MIDS; i++) {
+		g_mids[i] = ((uint64_t)(0x100 + i) << 16) | 0x1;
+	}
+	g_preload_calls = 0;
+	g_preload_first = 0;
+	g_preload_count = 0;
+}
+
+static void prefetch_teardown(void)
+{
+	talloc_free(g_mem_ctx);
+}
+
+Suite *mapistore_prefetch_suite(void)
+{
+	Suite	*s;
+	TCase	*tc;
+
+	s = suite_create("libmapistore prefetch");
+
+	tc = tcase_create("prefetch engine");
+	tcase_add_checked_fixture(tc, prefetch_setup, prefetch_teardown);
+	tcase_add_test(tc, test_disabled);
+	tcase_add_test(tc, test_sanity);
+	tcase_add_test(tc, test_sequential_synchronous);
+	tcase_add_test(tc, test_random_miss);
+	tcase_add_test(tc, test_deferred);
+	tcase_add_test(tc, test_stream_limit);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,250 @@
+/*
+   EMSMDBP ROP latency accounting Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/servers/default/emsmdb/emsmdbp_stats.c"
+
+/* Global test variables */
+static TALLOC_CTX	*mem_ctx;
+static char		*stats_dir;
+
+/* Map the segment of the current process read-only, the way ocstat does */
+static const struct emsmdbp_stats_segment *stats_map(void)
+{
+	const struct emsmdbp_stats_segment	*segment;
+	char					*path;
+	int					fd;
+
+	path = talloc_asprintf(mem_ctx, "%s/%s%d", stats_dir, EMSMDBP_STATS_PREFIX, (int)getpid());
+	fd = open(path, O_RDONLY);
+	ck_assert_int_ne(fd, -1);
+	segment = mmap(NULL, sizeof (struct emsmdbp_stats_segment), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	ck_assert(segment != MAP_FAILED);
+	ck_assert_int_eq(segment->magic, EMSMDBP_STATS_MAGIC);
+	ck_assert_int_eq(segment->version, EMSMDBP_STATS_VERSION);
+	ck_assert_int_eq(segment->size, sizeof (struct emsmdbp_stats_segment));
+	ck_assert_int_eq(segment->pid, getpid());
+
+	return segment;
+}
+
+// v unit tests ---------------------------------------------------------------
+
+START_TEST (test_emsmdbp_stats_rop) {
+	const struct emsmdbp_stats_segment	*segment;
+	const struct emsmdbp_stats_counter	*counter;
+	uint32_t				i;
+	uint64_t				sum = 0;
+
+	emsmdbp_stats_rop(op_MAPI_OpenFolder, "OpenFolder", MAPI_E_SUCCESS, 0);
+	emsmdbp_stats_rop(op_MAPI_OpenFolder, "OpenFolder", MAPI_E_SUCCESS, 3);
+	emsmdbp_stats_rop(op_MAPI_OpenFolder, "OpenFolder", MAPI_E_NOT_FOUND, 1000);
+	emsmdbp_stats_rop(op_MAPI_OpenFolder, "OpenFolder", MAPI_E_SUCCESS, 0xffffffffULL);
+
+	segment = stats_map();
+	ck_assert_str_eq(segment->rops[op_MAPI_OpenFolder].name, "OpenFolder");
+	ck_assert_int_eq(segment->rops[op_MAPI_OpenMessage].counter.calls, 0);
+
+	counter = &segment->rops[op_MAPI_OpenFolder].counter;
+	ck_assert_int_eq(counter->calls, 4);
+	ck_assert_int_eq(counter->errors, 1);
+	ck_assert(counter->usec_total == 1003 + 0xffffffffULL);
+	ck_assert(counter->usec_max == 0xffffffffULL);
+
+	/* 0us, [2,4)us, [512,1024)us, overflow bucket */
+	ck_assert_int_eq(counter->histogram[0], 1);
+	ck_assert_int_eq(counter->histogram[2], 1);
+	ck_assert_int_eq(counter->histogram[10], 1);
+	ck_assert_int_eq(counter->histogram[EMSMDBP_STATS_BUCKETS - 1], 1);
+	for (i = 0; i < EMSMDBP_STATS_BUCKETS; i++) {
+		sum += counter->histogram[i];
+	}
+	ck_assert_int_eq(sum, counter->calls);
+
+	munmap((void *)segment, sizeof (struct emsmdbp_stats_segment));
+} END_TEST
+
+START_TEST (test_emsmdbp_stats_transaction) {
+	const struct emsmdbp_stats_segment	*segment;
+	struct emsmdbp_context			emsmdbp_ctx;
+	uint32_t				i;
+	uint32_t				found = 0;
+
+	memset(&emsmdbp_ctx, 0, sizeof (struct emsmdbp_context));
+
+	/* No username yet: only the global counter is updated */
+	emsmdbp_stats_transaction(&emsmdbp_ctx, MAPI_E_SUCCESS, 10);
+
+	emsmdbp_ctx.username = talloc_strdup(mem_ctx, "alice");
+	emsmdbp_stats_transaction(&emsmdbp_ctx, MAPI_E_SUCCESS, 20);
+	emsmdbp_stats_transaction(&emsmdbp_ctx, MAPI_E_CALL_FAILED, 30);
+	emsmdbp_ctx.username = talloc_strdup(mem_ctx, "bob");
+	emsmdbp_stats_transaction(&emsmdbp_ctx, MAPI_E_SUCCESS, 40);
+
+	segment = stats_map();
+	ck_assert_int_eq(segment->transactions.calls, 4);
+	ck_assert_int_eq(segment->transactions.errors, 1);
+	ck_assert_int_eq(segment->transactions.usec_total, 100);
+
+	for (i = 0; i < EMSMDBP_STATS_USERS; i++) {
+		if (!segment->users[i].hash) continue;
+		found++;
+		if (!strcmp(segment->users[i].username, "alice")) {
+			ck_assert_int_eq(segment->users[i].counter.calls, 2);
+			ck_assert_int_eq(segment->users[i].counter.errors, 1);
+			ck_assert_int_eq(segment->users[i].counter.usec_max, 30);
+		} else {
+			ck_assert_str_eq(segment->users[i].username, "bob");
+			ck_assert_int_eq(segment->users[i].counter.calls, 1);
+		}
+	}
+	ck_assert_int_eq(found, 2);
+
+	munmap((void *)segment, sizeof (struct emsmdbp_stats_segment));
+} END_TEST
+
+START_TEST (test_emsmdbp_stats_disabled) {
+	char	*path;
+
+	emsmdbp_stats_set(false, stats_dir);
+	emsmdbp_stats_rop(op_MAPI_OpenFolder, "OpenFolder", MAPI_E_SUCCESS, 1);
+
+	path = talloc_asprintf(mem_ctx, "%s/%s%d", stats_dir, EMSMDBP_STATS_PREFIX, (int)getpid());
+	ck_assert_int_eq(access(path, F_OK), -1);
+} END_TEST
+
+START_TEST (test_emsmdbp_stats_archive) {
+	const struct emsmdbp_stats_segment	*archive;
+	struct emsmdbp_context			emsmdbp_ctx;
+	char					*path;
+	char					*archive_path;
+	uint32_t				i;
+	uint32_t				found = 0;
+	int					fd;
+
+	memset(&emsmdbp_ctx, 0, sizeof (struct emsmdbp_context));
+	emsmdbp_ctx.username = talloc_strdup(mem_ctx, "alice");
+	path = talloc_asprintf(mem_ctx, "%s/%s%d", stats_dir, EMSMDBP_STATS_PREFIX, (int)getpid());
+	archive_path = talloc_asprintf(mem_ctx, "%s/%s", stats_dir, EMSMDBP_STATS_ARCHIVE);
+
+	emsmdbp_stats_rop(op_MAPI_OpenFolder, "OpenFolder", MAPI_E_SUCCESS, 10);
+	emsmdbp_stats_transaction(&emsmdbp_ctx, MAPI_E_SUCCESS, 20);
+	ck_assert_int_eq(access(path, F_OK), 0);
+
+	/* Releasing the segment archives its counters and removes it */
+	emsmdbp_stats_set(true, stats_dir);
+	ck_assert_int_eq(access(path, F_OK), -1);
+
+	emsmdbp_stats_rop(op_MAPI_OpenFolder, "OpenFolder", MAPI_E_NOT_FOUND, 30);
+	emsmdbp_stats_transaction(&emsmdbp_ctx, MAPI_E_SUCCESS, 40);
+	emsmdbp_stats_set(true, stats_dir);
+	ck_assert_int_eq(access(path, F_OK), -1);
+
+	fd = open(archive_path, O_RDONLY);
+	ck_assert_int_ne(fd, -1);
+	archive = mmap(NULL, sizeof (struct emsmdbp_stats_segment), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	ck_assert(archive != MAP_FAILED);
+	ck_assert_int_eq(archive->magic, EMSMDBP_STATS_MAGIC);
+	ck_assert_int_eq(archive->pid, 0);
+	ck_assert_str_eq(archive->rops[op_MAPI_OpenFolder].name, "OpenFolder");
+	ck_assert_int_eq(archive->rops[op_MAPI_OpenFolder].counter.calls, 2);
+	ck_assert_int_eq(archive->rops[op_MAPI_OpenFolder].counter.errors, 1);
+	ck_assert_int_eq(archive->rops[op_MAPI_OpenFolder].counter.usec_max, 30);
+	ck_assert_int_eq(archive->transactions.calls, 2);
+	ck_assert_int_eq(archive->transactions.usec_total, 60);
+	for (i = 0; i < EMSMDBP_STATS_USERS; i++) {
+		if (!archive->users[i].hash) continue;
+		ck_assert_str_eq(archive->users[i].username, "alice");
+		ck_assert_int_eq(archive->users[i].counter.calls, 2);
+		found++;
+	}
+	ck_assert_int_eq(found, 1);
+	munmap((void *)archive, sizeof (struct emsmdbp_stats_segment));
+} END_TEST
+
+START_TEST (test_emsmdbp_stats_symlink) {
+	struct stat	st;
+	char		*path;
+	char		*target;
+	int		fd;
+
+	/* A symlink planted at the predictable segment name is not followed */
+	path = talloc_asprintf(mem_ctx, "%s/%s%d", stats_dir, EMSMDBP_STATS_PREFIX, (int)getpid());
+	target = talloc_asprintf(mem_ctx, "%s/target", stats_dir);
+	fd = open(target, O_RDWR|O_CREAT|O_EXCL, 0600);
+	ck_assert_int_ne(fd, -1);
+	close(fd);
+	ck_assert_int_eq(symlink(target, path), 0);
+
+	emsmdbp_stats_rop(op_MAPI_OpenFolder, "OpenFolder", MAPI_E_SUCCESS, 1);
+
+	ck_assert_int_eq(stat(target, &st), 0);
+	ck_assert_int_eq(st.st_size, 0);
+	ck_assert_int_eq(lstat(path, &st), 0);
+	ck_assert(S_ISREG(st.st_mode));
+	ck_assert_int_eq(st.st_size, sizeof (struct emsmdbp_stats_segment));
+
+	unlink(target);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_emsmdbp_stats_setup(void)
+{
+	mem_ctx = talloc_new(talloc_autofree_context());
+	stats_dir = talloc_strdup(mem_ctx, "/tmp/oc_emsmdbp_stats_XXXXXX");
+	ck_assert(mkdtemp(stats_dir) != NULL);
+	emsmdbp_stats_set(true, stats_dir);
+}
+
+static void tc_emsmdbp_stats_teardown(void)
+{
+	char	*path;
+
+	/* Archives the segment of the test and removes it */
+	emsmdbp_stats_set(false, stats_dir);
+	path = talloc_asprintf(mem_ctx, "%s/%s", stats_dir, EMSMDBP_STATS_ARCHIVE);
+	unlink(path);
+	rmdir(stats_dir);
+	emsmdbp_stats_set(true, NULL);
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_stats_suite(void)
+{
+	Suite	*s = suite_create("mapiproxy emsmdbp stats");
+	TCase	*tc;
+
+	tc = tcase_create("emsmdbp_stats");
+	tcase_add_checked_fixture(tc, tc_emsmdbp_stats_setup, tc_emsmdbp_stats_teardown);
+	tcase_add_test(tc, test_emsmdbp_stats_rop);
+	tcase_add_test(tc, test_emsmdbp_stats_transaction);
+	tcase_add_test(tc, test_emsmdbp_stats_disabled);
+	tcase_add_test(tc, test_emsmdbp_stats_archive);
+	tcase_add_test(tc, test_emsmdbp_stats_symlink);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
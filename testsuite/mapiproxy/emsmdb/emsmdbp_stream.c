@@ -0,0 +1,259 @@
+/*
+   EMSMDBP stream buffers Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/servers/default/emsmdb/emsmdbp_stream.c"
+
+#define	WRITE_CHUNK_SIZE	(30 * 1024)
+#define	SPILL_THRESHOLD		(256 * 1024)
+
+/* Global test variables */
+static TALLOC_CTX	*mem_ctx;
+static uint8_t		*chunk_data;
+
+static void upload(TALLOC_CTX *ctx, struct emsmdbp_stream *stream, size_t size)
+{
+	DATA_BLOB	blob;
+	size_t		offset;
+
+	for (offset = 0; offset < size; offset += blob.length) {
+		blob.data = chunk_data;
+		blob.length = (size - offset < WRITE_CHUNK_SIZE) ? size - offset : WRITE_CHUNK_SIZE;
+		ck_assert_int_eq(emsmdbp_stream_write_buffer(ctx, stream, blob), MAPI_E_SUCCESS);
+	}
+}
+
+static void check_content(TALLOC_CTX *ctx, struct emsmdbp_stream *stream, size_t size)
+{
+	DATA_BLOB	blob;
+	size_t		offset;
+
+	ck_assert_int_eq(stream->buffer.length, size);
+	ck_assert_int_eq(emsmdbp_stream_map(ctx, stream, &blob), MAPI_E_SUCCESS);
+	ck_assert_int_eq(blob.length, size);
+	for (offset = 0; offset < size; offset += WRITE_CHUNK_SIZE) {
+		ck_assert(memcmp(blob.data + offset, chunk_data,
+				 (size - offset < WRITE_CHUNK_SIZE) ? size - offset : WRITE_CHUNK_SIZE) == 0);
+	}
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_emsmdbp_stream_write_read) {
+	struct emsmdbp_stream	stream;
+	TALLOC_CTX		*read_ctx;
+	DATA_BLOB		blob;
+	size_t			size = 5 * EMSMDBP_STREAM_CHUNK_MIN + 17;
+
+	memset(&stream, 0, sizeof(struct emsmdbp_stream));
+	upload(mem_ctx, &stream, size);
+	ck_assert(stream.rope != NULL);
+	ck_assert(stream.rope->fd == -1);
+	ck_assert(stream.rope->chunk_count > 1);
+	check_content(mem_ctx, &stream, size);
+
+	read_ctx = talloc_new(mem_ctx);
+	ck_assert(read_ctx != NULL);
+
+	/* Reads within a chunk are not copied */
+	stream.position = 10;
+	blob = emsmdbp_stream_read_buffer(read_ctx, &stream, 20);
+	ck_assert_int_eq(blob.length, 20);
+	ck_assert(blob.data == stream.rope->chunks[0].data + 10);
+
+	/* Reads crossing chunk boundaries are copied on the caller context */
+	stream.position = EMSMDBP_STREAM_CHUNK_MIN - 10;
+	blob = emsmdbp_stream_read_buffer(read_ctx, &stream, 20);
+	ck_assert_int_eq(blob.length, 20);
+	ck_assert(talloc_parent(blob.data) == read_ctx);
+	ck_assert(memcmp(blob.data, chunk_data + (EMSMDBP_STREAM_CHUNK_MIN - 10) % WRITE_CHUNK_SIZE, 20) == 0);
+	ck_assert_int_eq(stream.position, EMSMDBP_STREAM_CHUNK_MIN + 10);
+	talloc_free(read_ctx);
+
+	/* Short read at the end of the stream */
+	stream.position = size - 5;
+	blob = emsmdbp_stream_read_buffer(mem_ctx, &stream, 20);
+	ck_assert_int_eq(blob.length, 5);
+
+	/* Overwriting does not change the stream size */
+	stream.position = 0;
+	blob.data = (uint8_t *) "openchange";
+	blob.length = 10;
+	ck_assert_int_eq(emsmdbp_stream_write_buffer(mem_ctx, &stream, blob), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stream.buffer.length, size);
+	stream.position = 0;
+	blob = emsmdbp_stream_read_buffer(mem_ctx, &stream, 10);
+	ck_assert(memcmp(blob.data, "openchange", 10) == 0);
+
+	emsmdbp_stream_reset(&stream);
+	ck_assert(stream.rope == NULL);
+	ck_assert_int_eq(stream.buffer.length, 0);
+} END_TEST
+
+START_TEST (test_emsmdbp_stream_existing_buffer) {
+	struct emsmdbp_stream	stream;
+	DATA_BLOB		blob;
+
+	/* Stream opened on an existing property value */
+	memset(&stream, 0, sizeof(struct emsmdbp_stream));
+	stream.buffer.data = (uint8_t *) talloc_strdup(mem_ctx, "0123456789");
+	stream.buffer.length = 10;
+	stream.position = 5;
+
+	blob.data = (uint8_t *) "abcdefghij";
+	blob.length = 10;
+	ck_assert_int_eq(emsmdbp_stream_write_buffer(mem_ctx, &stream, blob), MAPI_E_SUCCESS);
+	ck_assert_int_eq(stream.buffer.length, 15);
+
+	ck_assert_int_eq(emsmdbp_stream_map(mem_ctx, &stream, &blob), MAPI_E_SUCCESS);
+	ck_assert_int_eq(blob.length, 15);
+	ck_assert(memcmp(blob.data, "01234abcdefghij", 15) == 0);
+} END_TEST
+
+START_TEST (test_emsmdbp_stream_spill) {
+	struct emsmdbp_stream	stream;
+	DATA_BLOB		blob;
+	size_t			size = 4 * SPILL_THRESHOLD + 123;
+
+	emsmdbp_stream_set_spill(SPILL_THRESHOLD, NULL);
+
+	memset(&stream, 0, sizeof(struct emsmdbp_stream));
+	upload(mem_ctx, &stream, SPILL_THRESHOLD);
+	ck_assert(stream.rope->fd == -1);
+	upload(mem_ctx, &stream, size - SPILL_THRESHOLD);
+	ck_assert(stream.rope->fd != -1);
+	ck_assert_int_eq(stream.rope->chunk_count, 0);
+
+	/* Rewrite the whole content to compare against a single pattern */
+	stream.position = 0;
+	upload(mem_ctx, &stream, size);
+	check_content(mem_ctx, &stream, size);
+
+	stream.position = WRITE_CHUNK_SIZE - 3;
+	blob = emsmdbp_stream_read_buffer(mem_ctx, &stream, 6);
+	ck_assert_int_eq(blob.length, 6);
+	ck_assert(memcmp(blob.data, chunk_data + WRITE_CHUNK_SIZE - 3, 3) == 0);
+	ck_assert(memcmp(blob.data + 3, chunk_data, 3) == 0);
+
+	emsmdbp_stream_reset(&stream);
+	emsmdbp_stream_set_spill(EMSMDBP_STREAM_SPILL_THRESHOLD, NULL);
+} END_TEST
+
+/* Content synchronization producer: each chunk replaces the previous
+ * one, which is released */
+static void produce(TALLOC_CTX *ctx, struct emsmdbp_stream *stream, size_t offset, size_t size)
+{
+	emsmdbp_stream_reset(stream);
+	stream->buffer.data = talloc_memdup(ctx, chunk_data + offset, size);
+	stream->buffer.length = size;
+}
+
+START_TEST (test_emsmdbp_stream_replay) {
+	struct emsmdbp_stream	chunk;
+	struct emsmdbp_stream	replay;
+	TALLOC_CTX		*chunk_ctx;
+	DATA_BLOB		blob;
+	uint8_t			dropped[1500];
+	size_t			saved;
+
+	memset(&chunk, 0, sizeof(struct emsmdbp_stream));
+	memset(&replay, 0, sizeof(struct emsmdbp_stream));
+
+	/* First response, accepted without recording */
+	chunk_ctx = talloc_new(mem_ctx);
+	produce(chunk_ctx, &chunk, 0, 1000);
+	blob = emsmdbp_stream_read_buffer(mem_ctx, &chunk, 600);
+	ck_assert_int_eq(blob.length, 600);
+
+	/* Chained response: rest of the chunk and the start of the next
+	 * one, recorded while the response is pending */
+	saved = replay.position;
+	blob = emsmdbp_stream_read_buffer(mem_ctx, &chunk, 400);
+	ck_assert_int_eq(emsmdbp_stream_replay_record(mem_ctx, &replay, blob), MAPI_E_SUCCESS);
+	memcpy(dropped, blob.data, 400);
+	talloc_free(chunk_ctx);
+
+	chunk_ctx = talloc_new(mem_ctx);
+	produce(chunk_ctx, &chunk, 1000, 2000);
+	blob = emsmdbp_stream_read_buffer(mem_ctx, &chunk, 1100);
+	ck_assert_int_eq(emsmdbp_stream_replay_record(mem_ctx, &replay, blob), MAPI_E_SUCCESS);
+	memcpy(dropped + 400, blob.data, 1100);
+	ck_assert_int_eq(replay.buffer.length, sizeof(dropped));
+
+	/* Recording is refused while recorded data is pending */
+	replay.position = saved;
+	ck_assert_int_eq(emsmdbp_stream_replay_record(mem_ctx, &replay, blob), MAPI_E_INVALID_PARAMETER);
+
+	/* The response is dropped: the next reads return the same bytes
+	 * before the producer resumes */
+	blob = emsmdbp_stream_read_buffer(mem_ctx, &replay, 1000);
+	ck_assert_int_eq(blob.length, 1000);
+	ck_assert(memcmp(blob.data, dropped, 1000) == 0);
+	blob = emsmdbp_stream_read_buffer(mem_ctx, &replay, 1000);
+	ck_assert_int_eq(blob.length, 500);
+	ck_assert(memcmp(blob.data, dropped + 1000, 500) == 0);
+	ck_assert(memcmp(dropped, chunk_data + 600, sizeof(dropped)) == 0);
+
+	blob = emsmdbp_stream_read_buffer(mem_ctx, &chunk, 1000);
+	ck_assert_int_eq(blob.length, 900);
+	ck_assert(memcmp(blob.data, chunk_data + 2100, 900) == 0);
+
+	emsmdbp_stream_reset(&replay);
+	emsmdbp_stream_reset(&chunk);
+	talloc_free(chunk_ctx);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_emsmdbp_stream_setup(void)
+{
+	uint32_t	i;
+
+	mem_ctx = talloc_new(talloc_autofree_context());
+	chunk_data = talloc_array(mem_ctx, uint8_t, WRITE_CHUNK_SIZE);
+	ck_assert(chunk_data != NULL);
+	for (i = 0; i < WRITE_CHUNK_SIZE; i++) {
+		chunk_data[i] = (uint8_t)(i * 31 + 7);
+	}
+}
+
+static void tc_emsmdbp_stream_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_stream_suite(void)
+{
+	Suite *s = suite_create("mapiproxy emsmdbp stream");
+	TCase *tc;
+
+	tc = tcase_create("emsmdbp_stream");
+	tcase_add_checked_fixture(tc, tc_emsmdbp_stream_setup, tc_emsmdbp_stream_teardown);
+	tcase_add_test(tc, test_emsmdbp_stream_write_read);
+	tcase_add_test(tc, test_emsmdbp_stream_existing_buffer);
+	tcase_add_test(tc, test_emsmdbp_stream_spill);
+	tcase_add_test(tc, test_emsmdbp_stream_replay);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,169 @@
+/*
+   EMSMDBP content synchronization snapshot Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/servers/default/emsmdb/emsmdbp_sync_snapshot.c"
+
+#define	FOLDER_MESSAGES		10
+#define	FOLDER_MAX_MESSAGES	32
+#define	PRELOAD_INTERVAL	4
+#define	MESSAGES_PER_BUFFER	3
+#define	INVALID_MID		0x7fffffffffffffffLL
+
+/* Message table of a folder, rows shift as messages come and go */
+struct fake_folder {
+	uint64_t	mids[FOLDER_MAX_MESSAGES];
+	uint32_t	count;
+	uint32_t	reads;
+};
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct fake_folder	folder;
+
+static enum MAPISTATUS fake_folder_read_row(void *private_data, uint32_t row, uint64_t *mid, uint64_t *cn)
+{
+	struct fake_folder	*fake = private_data;
+
+	fake->reads++;
+	if (row >= fake->count || fake->mids[row] == INVALID_MID) {
+		return MAPI_E_NOT_FOUND;
+	}
+	*mid = fake->mids[row];
+	*cn = (fake->mids[row] << 16) | 0x1;
+
+	return MAPI_E_SUCCESS;
+}
+
+static void fake_folder_create(uint64_t mid)
+{
+	ck_assert(folder.count < FOLDER_MAX_MESSAGES);
+	memmove(&folder.mids[1], &folder.mids[0], folder.count * sizeof (uint64_t));
+	folder.mids[0] = mid;
+	folder.count++;
+}
+
+static void fake_folder_delete(uint32_t row)
+{
+	ck_assert(row < folder.count);
+	memmove(&folder.mids[row], &folder.mids[row + 1], (folder.count - row - 1) * sizeof (uint64_t));
+	folder.count--;
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_emsmdbp_sync_snapshot_folder_changes) {
+	struct emsmdbp_sync_snapshot	snapshot;
+	struct UI8Array_r		window;
+	uint64_t			sent[FOLDER_MESSAGES];
+	uint32_t			sent_count = 0;
+	uint32_t			windows = 0;
+	uint32_t			reads;
+	uint32_t			buffer;
+	uint32_t			i;
+
+	ck_assert_int_eq(emsmdbp_sync_snapshot_fill(mem_ctx, &snapshot, folder.count,
+						    fake_folder_read_row, &folder), MAPI_E_SUCCESS);
+	ck_assert_int_eq(snapshot.count, FOLDER_MESSAGES);
+	reads = folder.reads;
+
+	/* Messages are created and deleted between GetBuffer calls */
+	for (buffer = 0; snapshot.next < snapshot.count; buffer++) {
+		for (i = 0; i < MESSAGES_PER_BUFFER && snapshot.next < snapshot.count; i++, snapshot.next++) {
+			if (emsmdbp_sync_snapshot_window(&snapshot, PRELOAD_INTERVAL, &window)) {
+				ck_assert_int_eq(window.lpui8[0], snapshot.mids[snapshot.next]);
+				ck_assert(window.cValues <= PRELOAD_INTERVAL);
+				windows++;
+			}
+			ck_assert(snapshot.next < snapshot.preloaded);
+			sent[sent_count++] = snapshot.mids[snapshot.next];
+		}
+		fake_folder_delete(0);
+		fake_folder_create(0x1000 + buffer);
+	}
+
+	/* Every message listed when the download started is sent once */
+	ck_assert_int_eq(sent_count, FOLDER_MESSAGES);
+	for (i = 0; i < FOLDER_MESSAGES; i++) {
+		ck_assert_int_eq(sent[i], i + 1);
+	}
+	ck_assert_int_eq(windows, (FOLDER_MESSAGES + PRELOAD_INTERVAL - 1) / PRELOAD_INTERVAL);
+	ck_assert_int_eq(folder.reads, reads);
+	ck_assert(!emsmdbp_sync_snapshot_window(&snapshot, PRELOAD_INTERVAL, &window));
+} END_TEST
+
+START_TEST (test_emsmdbp_sync_snapshot_unreadable_rows) {
+	struct emsmdbp_sync_snapshot	snapshot;
+	struct UI8Array_r		window;
+
+	folder.mids[3] = INVALID_MID;
+	folder.mids[7] = INVALID_MID;
+
+	ck_assert_int_eq(emsmdbp_sync_snapshot_fill(mem_ctx, &snapshot, folder.count,
+						    fake_folder_read_row, &folder), MAPI_E_SUCCESS);
+	ck_assert_int_eq(snapshot.count, FOLDER_MESSAGES - 2);
+	ck_assert_int_eq(snapshot.mids[3], 5);
+	ck_assert_int_eq(snapshot.cns[3], (5 << 16) | 0x1);
+
+	ck_assert(emsmdbp_sync_snapshot_window(&snapshot, FOLDER_MAX_MESSAGES, &window));
+	ck_assert_int_eq(window.cValues, FOLDER_MESSAGES - 2);
+
+	/* An empty table has nothing to send */
+	ck_assert_int_eq(emsmdbp_sync_snapshot_fill(mem_ctx, &snapshot, 0,
+						    fake_folder_read_row, &folder), MAPI_E_SUCCESS);
+	ck_assert_int_eq(snapshot.count, 0);
+	ck_assert(!emsmdbp_sync_snapshot_window(&snapshot, PRELOAD_INTERVAL, &window));
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_emsmdbp_sync_snapshot_setup(void)
+{
+	uint32_t	i;
+
+	mem_ctx = talloc_new(talloc_autofree_context());
+	memset(&folder, 0, sizeof (struct fake_folder));
+	for (i = 0; i < FOLDER_MESSAGES; i++) {
+		folder.mids[i] = i + 1;
+	}
+	folder.count = FOLDER_MESSAGES;
+}
+
+static void tc_emsmdbp_sync_snapshot_teardown(void)
+{
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsmdbp_sync_snapshot_suite(void)
+{
+	Suite *s = suite_create("mapiproxy emsmdbp sync snapshot");
+	TCase *tc;
+
+	tc = tcase_create("emsmdbp_sync_snapshot");
+	tcase_add_checked_fixture(tc, tc_emsmdbp_sync_snapshot_setup, tc_emsmdbp_sync_snapshot_teardown);
+	tcase_add_test(tc, test_emsmdbp_sync_snapshot_folder_changes);
+	tcase_add_test(tc, test_emsmdbp_sync_snapshot_unreadable_rows);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,260 @@
+/*
+   OpenChange Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "testsuite_common.h"
+#include "mapiproxy/servers/default/nspi/emsabp_snapshot.c"
+
+#include <inttypes.h>
+#include <unistd.h>
+
+#define	SNAPSHOT_LDB		RESOURCES_DIR "/emsabp_snapshot.ldb"
+#define	SNAPSHOT_BASEDN		"DC=example,DC=com"
+#define	SNAPSHOT_FILTER		"(&(objectClass=user)(!(isDeleted=TRUE)))"
+
+/* Global test variables */
+static TALLOC_CTX		*mem_ctx;
+static struct emsabp_context	*emsabp_ctx;
+static struct emsabp_snapshot	*snapshot;
+
+static void add_entry(uint8_t id, const char *object_class, const char *display_name, uint64_t usn)
+{
+	struct ldb_message	*msg;
+	uint8_t			guid[16];
+	DATA_BLOB		blob;
+
+	memset(guid, 0, sizeof (guid));
+	guid[0] = id;
+	blob.data = guid;
+	blob.length = sizeof (guid);
+
+	msg = ldb_msg_new(mem_ctx);
+	msg->dn = ldb_dn_new_fmt(msg, emsabp_ctx->samdb_ctx, "CN=entry%u,CN=Users," SNAPSHOT_BASEDN, id);
+	ldb_msg_add_string(msg, "objectClass", object_class);
+	ldb_msg_add_string(msg, "displayName", display_name);
+	ldb_msg_add_fmt(msg, "uSNChanged", "%"PRIu64, usn);
+	ldb_msg_add_value(msg, "objectGUID", &blob, NULL);
+	ck_assert_int_eq(ldb_add(emsabp_ctx->samdb_ctx, msg), LDB_SUCCESS);
+	talloc_free(msg);
+}
+
+static void modify_entry(uint8_t id, const char *attr, const char *value, uint64_t usn)
+{
+	struct ldb_message	*msg;
+
+	msg = ldb_msg_new(mem_ctx);
+	msg->dn = ldb_dn_new_fmt(msg, emsabp_ctx->samdb_ctx, "CN=entry%u,CN=Users," SNAPSHOT_BASEDN, id);
+	ldb_msg_add_empty(msg, attr, LDB_FLAG_MOD_REPLACE, NULL);
+	ldb_msg_add_string(msg, attr, value);
+	ldb_msg_add_empty(msg, "uSNChanged", LDB_FLAG_MOD_REPLACE, NULL);
+	ldb_msg_add_fmt(msg, "uSNChanged", "%"PRIu64, usn);
+	ck_assert_int_eq(ldb_modify(emsabp_ctx->samdb_ctx, msg), LDB_SUCCESS);
+	talloc_free(msg);
+}
+
+static void check_entries(const char **display_names, uint32_t count)
+{
+	uint32_t	i;
+
+	ck_assert_int_eq(snapshot->count, count);
+	for (i = 0; i < count; i++) {
+		ck_assert_str_eq(snapshot->entries[i].display_name, display_names[i]);
+	}
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_emsabp_snapshot_build) {
+	enum MAPISTATUS	retval;
+	const char	*expected[] = { "alice", "Bob", "Carol" };
+
+	add_entry(1, "user", "Carol", 1);
+	add_entry(2, "user", "alice", 2);
+	add_entry(3, "user", "Bob", 3);
+	add_entry(4, "group", "Administrators", 4);
+
+	retval = emsabp_snapshot_build(emsabp_ctx, snapshot);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(snapshot->generation, 1);
+	check_entries(expected, 3);
+	ck_assert_str_eq(snapshot->entries[0].dn, "CN=entry2,CN=Users," SNAPSHOT_BASEDN);
+	ck_assert_int_eq(snapshot->entries[0].guid.time_low, 2);
+} END_TEST
+
+START_TEST (test_emsabp_snapshot_seek) {
+	enum MAPISTATUS	retval;
+
+	add_entry(1, "user", "Carol", 1);
+	add_entry(2, "user", "alice", 2);
+	add_entry(3, "user", "Bob", 3);
+
+	retval = emsabp_snapshot_build(emsabp_ctx, snapshot);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, ""), 0);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "ALICE"), 0);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "b"), 1);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "bob"), 1);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "Bobby"), 2);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, "z"), 3);
+	ck_assert_int_eq(emsabp_snapshot_seek(NULL, "alice"), 0);
+	ck_assert_int_eq(emsabp_snapshot_seek(snapshot, NULL), 0);
+} END_TEST
+
+START_TEST (test_emsabp_snapshot_update) {
+	enum MAPISTATUS	retval;
+	const char	*expected[] = { "alice", "Dave", "Eve" };
+
+	add_entry(1, "user", "Carol", 1);
+	add_entry(2, "user", "alice", 2);
+	add_entry(3, "user", "Bob", 3);
+
+	retval = emsabp_snapshot_build(emsabp_ctx, snapshot);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	snapshot->usn = 3;
+
+	/* Nothing changed since the snapshot */
+	retval = emsabp_snapshot_update(emsabp_ctx, snapshot);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(snapshot->generation, 1);
+	ck_assert_int_eq(snapshot->count, 3);
+
+	/* Rename, delete and add */
+	modify_entry(3, "displayName", "Dave", 4);
+	modify_entry(1, "isDeleted", "TRUE", 5);
+	add_entry(5, "user", "Eve", 6);
+	add_entry(6, "group", "Everyone", 7);
+
+	retval = emsabp_snapshot_update(emsabp_ctx, snapshot);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(snapshot->generation, 2);
+	check_entries(expected, 3);
+	ck_assert_str_eq(snapshot->entries[1].dn, "CN=entry3,CN=Users," SNAPSHOT_BASEDN);
+} END_TEST
+
+START_TEST (test_emsabp_snapshot_view) {
+	enum MAPISTATUS			retval;
+	struct emsabp_snapshot_view	*view;
+	uint32_t			MId;
+	uint32_t			bob_MId;
+	char				*dn;
+	uint32_t			i;
+
+	add_entry(1, "user", "Carol", 1);
+	add_entry(2, "user", "alice", 2);
+	add_entry(3, "user", "Bob", 3);
+
+	retval = emsabp_snapshot_build(emsabp_ctx, snapshot);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	snapshot->usn = 3;
+
+	view = emsabp_snapshot_get_view(emsabp_ctx, snapshot);
+	ck_assert(view != NULL);
+	ck_assert_int_eq(view->generation, snapshot->generation);
+	ck_assert_int_eq(view->MIds.cValues, snapshot->count);
+	for (i = 0; i < view->MIds.cValues; i++) {
+		retval = emsabp_tdb_fetch_dn_from_MId(mem_ctx, emsabp_ctx->ttdb_ctx, view->MIds.aulPropTag[i], &dn);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+		ck_assert_str_eq(dn, snapshot->entries[i].dn);
+	}
+	bob_MId = view->MIds.aulPropTag[1];
+
+	/* Same generation, the session MIds are reused */
+	ck_assert(emsabp_snapshot_get_view(emsabp_ctx, snapshot) == view);
+
+	/* Entries kept across generations keep their MId */
+	add_entry(5, "user", "Aaron", 4);
+	retval = emsabp_snapshot_update(emsabp_ctx, snapshot);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+
+	view = emsabp_snapshot_get_view(emsabp_ctx, snapshot);
+	ck_assert(view != NULL);
+	ck_assert_int_eq(view->generation, snapshot->generation);
+	ck_assert_int_eq(view->MIds.cValues, 4);
+	ck_assert_int_eq(view->MIds.aulPropTag[2], bob_MId);
+
+	retval = emsabp_tdb_fetch_MId(emsabp_ctx->ttdb_ctx, snapshot->entries[0].dn, &MId);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+	ck_assert_int_eq(view->MIds.aulPropTag[0], MId);
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_emsabp_snapshot_setup(void)
+{
+	struct ldb_message	*msg;
+	struct ldb_dn		*basedn;
+	int			ret;
+
+	unlink(SNAPSHOT_LDB);
+
+	mem_ctx = talloc_new(talloc_autofree_context());
+	emsabp_ctx = talloc_zero(mem_ctx, struct emsabp_context);
+	ck_assert(emsabp_ctx != NULL);
+	emsabp_ctx->mem_ctx = mem_ctx;
+
+	emsabp_ctx->ttdb_ctx = emsabp_tdb_init_tmp(mem_ctx);
+	ck_assert(emsabp_ctx->ttdb_ctx != NULL);
+
+	emsabp_ctx->samdb_ctx = ldb_init(mem_ctx, NULL);
+	ck_assert(emsabp_ctx->samdb_ctx != NULL);
+	ret = ldb_connect(emsabp_ctx->samdb_ctx, SNAPSHOT_LDB, 0, 0);
+	ck_assert_int_eq(ret, LDB_SUCCESS);
+
+	basedn = ldb_dn_new(emsabp_ctx->samdb_ctx, emsabp_ctx->samdb_ctx, SNAPSHOT_BASEDN);
+	ldb_set_opaque(emsabp_ctx->samdb_ctx, "default_baseDN", basedn);
+
+	/* USN comparisons in the update filters are numeric */
+	msg = ldb_msg_new(mem_ctx);
+	msg->dn = ldb_dn_new(msg, emsabp_ctx->samdb_ctx, "@ATTRIBUTES");
+	ldb_msg_add_string(msg, "uSNChanged", "INTEGER");
+	ck_assert_int_eq(ldb_add(emsabp_ctx->samdb_ctx, msg), LDB_SUCCESS);
+	talloc_free(msg);
+
+	snapshot = talloc_zero(mem_ctx, struct emsabp_snapshot);
+	ck_assert(snapshot != NULL);
+	snapshot->filter = talloc_strdup(snapshot, SNAPSHOT_FILTER);
+}
+
+static void tc_emsabp_snapshot_teardown(void)
+{
+	tdb_close(emsabp_ctx->ttdb_ctx);
+	talloc_free(mem_ctx);
+	unlink(SNAPSHOT_LDB);
+}
+
+Suite *mapiproxy_emsabp_snapshot_suite(void)
+{
+	Suite *s = suite_create("mapiproxy emsabp snapshot");
+	TCase *tc;
+
+	tc = tcase_create("emsabp_snapshot");
+	tcase_add_checked_fixture(tc, tc_emsabp_snapshot_setup, tc_emsabp_snapshot_teardown);
+	tcase_add_test(tc, test_emsabp_snapshot_build);
+	tcase_add_test(tc, test_emsabp_snapshot_seek);
+	tcase_add_test(tc, test_emsabp_snapshot_update);
+	tcase_add_test(tc, test_emsabp_snapshot_view);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,122 @@
+/*
+   EMSABP TDB Unit Testing
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "testsuite.h"
+#include "mapiproxy/servers/default/nspi/emsabp_tdb.c"
+
+/* Global test variables */
+static TALLOC_CTX	*mem_ctx;
+static TDB_CONTEXT	*tdb_ctx;
+
+static char *directory_dn(uint32_t i)
+{
+	return talloc_asprintf(mem_ctx, "CN=user%u,CN=Users,DC=example,DC=com", i);
+}
+
+// v Unit test ----------------------------------------------------------------
+
+START_TEST (test_emsabp_tdb_MId_dn) {
+	enum MAPISTATUS	retval;
+	uint32_t	MId;
+	char		*dn;
+	char		*res;
+	uint32_t	i;
+
+	for (i = 0; i < 100; i++) {
+		dn = directory_dn(i);
+		retval = emsabp_tdb_insert(tdb_ctx, dn);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+		retval = emsabp_tdb_fetch_MId(tdb_ctx, dn, &MId);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+		ck_assert_int_eq(MId, EMSABP_TDB_TMP_MID_START + i + 1);
+
+		ck_assert(emsabp_tdb_lookup_MId(tdb_ctx, MId));
+		retval = emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, MId, &res);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+		ck_assert_str_eq(res, dn);
+	}
+
+	ck_assert(!emsabp_tdb_lookup_MId(tdb_ctx, 0x42));
+	retval = emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, 0x42, &res);
+	ck_assert_int_eq(retval, MAPI_E_NOT_FOUND);
+	ck_assert(res == NULL);
+} END_TEST
+
+START_TEST (test_emsabp_tdb_upgrade_index) {
+	enum MAPISTATUS	retval;
+	TDB_DATA	key;
+	TDB_DATA	dbuf;
+	char		*res;
+	uint32_t	i;
+
+	/* Records written without the reverse index */
+	for (i = 0; i < 10; i++) {
+		key.dptr = (unsigned char *) directory_dn(i);
+		key.dsize = strlen((const char *)key.dptr);
+		dbuf.dptr = (unsigned char *) talloc_asprintf(mem_ctx, "0x%x", 0x100 + i);
+		dbuf.dsize = strlen((const char *)dbuf.dptr);
+		ck_assert_int_eq(tdb_store(tdb_ctx, key, dbuf, TDB_INSERT), 0);
+	}
+	ck_assert(!emsabp_tdb_lookup_MId(tdb_ctx, 0x100));
+
+	retval = emsabp_tdb_upgrade_MId_dn_index(tdb_ctx);
+	ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+
+	for (i = 0; i < 10; i++) {
+		retval = emsabp_tdb_fetch_dn_from_MId(mem_ctx, tdb_ctx, 0x100 + i, &res);
+		ck_assert_int_eq(retval, MAPI_E_SUCCESS);
+		ck_assert_str_eq(res, directory_dn(i));
+	}
+
+	/* The data record is not indexed */
+	ck_assert(!emsabp_tdb_lookup_MId(tdb_ctx, EMSABP_TDB_TMP_MID_START));
+} END_TEST
+
+// ^ unit tests ---------------------------------------------------------------
+
+// v suite definition ---------------------------------------------------------
+
+static void tc_emsabp_tdb_setup(void)
+{
+	mem_ctx = talloc_new(talloc_autofree_context());
+	tdb_ctx = emsabp_tdb_init_tmp(mem_ctx);
+	ck_assert(tdb_ctx != NULL);
+}
+
+static void tc_emsabp_tdb_teardown(void)
+{
+	tdb_close(tdb_ctx);
+	talloc_free(mem_ctx);
+}
+
+Suite *mapiproxy_emsabp_tdb_suite(void)
+{
+	Suite *s = suite_create("mapiproxy emsabp tdb");
+	TCase *tc;
+
+	tc = tcase_create("emsabp_tdb");
+	tcase_add_checked_fixture(tc, tc_emsabp_tdb_setup, tc_emsabp_tdb_teardown);
+	tcase_add_test(tc, test_emsabp_tdb_MId_dn);
+	tcase_add_test(tc, test_emsabp_tdb_upgrade_index);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -244,6 +244,88 @@ START_TEST (test_create_schema) {
 
 } END_TEST
 
+START_TEST (test_prepared_statements) {
+	struct stmt_params	params;
+	struct stmt_k		key;
+	struct stmt_v		*entry, *cached;
+	const char		*row[3];
+	const char		*value;
+	uint64_t		n;
+	const char		*insert = "INSERT INTO stmt_test VALUES (?, ?, ?)";
+	const char		*select = "SELECT id, name, data FROM stmt_test WHERE id = ?";
+
+	ck_assert_int_eq(execute_query(conn, "CREATE TABLE IF NOT EXISTS stmt_test ("
+				       "id BIGINT UNSIGNED NOT NULL PRIMARY KEY,"
+				       "name VARCHAR(255) DEFAULT NULL,"
+				       "data BLOB)"), MYSQL_SUCCESS);
+
+	/* Quotes are bound as is, no escaping needed */
+	stmt_params_init(&params);
+	ck_assert(stmt_bind_u64(&params, 0xFFFFFFFFFFFFFFFEULL));
+	ck_assert(stmt_bind_string(&params, "it's"));
+	ck_assert(stmt_bind_blob(&params, "a\0b", 3));
+	ck_assert_int_eq(stmt_execute(conn, insert, &params), MYSQL_SUCCESS);
+
+	stmt_params_init(&params);
+	stmt_bind_u64(&params, 1);
+	stmt_bind_string(&params, NULL);
+	stmt_bind_blob(&params, "", 0);
+	ck_assert_int_eq(stmt_execute(conn, insert, &params), MYSQL_SUCCESS);
+
+	/* Duplicate key is an error but keeps the statement usable */
+	ck_assert_int_eq(stmt_execute(conn, insert, &params), MYSQL_ERROR);
+
+	stmt_params_init(&params);
+	stmt_bind_u64(&params, 0xFFFFFFFFFFFFFFFEULL);
+	ck_assert_int_eq(stmt_select_row(mem_ctx, conn, select, &params, 3, row), MYSQL_SUCCESS);
+	ck_assert_str_eq(row[0], "18446744073709551614");
+	ck_assert_str_eq(row[1], "it's");
+	ck_assert(memcmp(row[2], "a\0b", 3) == 0);
+
+	stmt_params_init(&params);
+	stmt_bind_u64(&params, 1);
+	ck_assert_int_eq(stmt_select_row(mem_ctx, conn, select, &params, 3, row), MYSQL_SUCCESS);
+	ck_assert(row[1] == NULL);
+	ck_assert_str_eq(row[2], "");
+
+	ck_assert_int_eq(stmt_select_first_uint(conn, select, &params, &n), MYSQL_SUCCESS);
+	ck_assert_int_eq(n, 1);
+
+	stmt_params_init(&params);
+	stmt_bind_u64(&params, 2);
+	ck_assert_int_eq(stmt_select_first_string(mem_ctx, conn, select, &params, &value), MYSQL_NOT_FOUND);
+
+	/* Wrong number of parameters */
+	stmt_params_init(&params);
+	ck_assert_int_eq(stmt_select_first_string(mem_ctx, conn, select, &params, &value), MYSQL_ERROR);
+
+	/* Statements are cached per connection and query template */
+	key.conn = conn;
+	key.query = select;
+	entry = htable_get(&stmt_ht, _stmt_hash(conn, select), _stmt_ht_cmp, &key);
+	ck_assert(entry != NULL);
+	stmt_bind_u64(&params, 1);
+	ck_assert_int_eq(stmt_select_first_uint(conn, select, &params, &n), MYSQL_SUCCESS);
+	cached = htable_get(&stmt_ht, _stmt_hash(conn, select), _stmt_ht_cmp, &key);
+	ck_assert(cached == entry);
+
+	/* and prepared again once the connection has been re-established */
+	entry->thread_id = 0;
+	ck_assert_int_eq(stmt_select_first_uint(conn, select, &params, &n), MYSQL_SUCCESS);
+	ck_assert_int_eq(n, 1);
+	cached = htable_get(&stmt_ht, _stmt_hash(conn, select), _stmt_ht_cmp, &key);
+	ck_assert(cached != NULL);
+	ck_assert_int_eq(cached->thread_id, mysql_thread_id(conn));
+
+	/* Binding is bounded */
+	stmt_params_init(&params);
+	for (n = 0; n < STMT_PARAMS_MAX; n++) {
+		ck_assert(stmt_bind_u64(&params, n));
+	}
+	ck_assert(!stmt_bind_u64(&params, n));
+	ck_assert(!stmt_bind_string(&params, "overflow"));
+} END_TEST
+
 // ^ unit tests ---------------------------------------------------------------
 
 // v suite definition ---------------------------------------------------------
@@ -285,6 +367,7 @@ Suite *mapiproxy_util_mysql_suite(void)
 	tcase_add_test(tc, test_parse_connection_string_fail);
 	tcase_add_test(tc, test_parse_connection_string_success);
 	tcase_add_test(tc, test_create_schema);
+	tcase_add_test(tc, test_prepared_statements);
 
 	suite_add_tcase(s, tc);
 
@@ -102,11 +102,17 @@ int main(int argc, const char *argv[])
 	/* libmapi */
 	srunner_add_suite(sr, libmapi_property_suite());
 	srunner_add_suite(sr, libmapi_idset_suite());
+	srunner_add_suite(sr, libmapi_obfuscate_suite());
+	srunner_add_suite(sr, libmapi_batch_suite());
 	/* libmapiproxy */
 	srunner_add_suite(sr, mapiproxy_openchangedb_mysql_suite());
 	srunner_add_suite(sr, mapiproxy_openchangedb_ldb_suite());
 	srunner_add_suite(sr, mapiproxy_openchangedb_multitenancy_mysql_suite());
 	srunner_add_suite(sr, mapiproxy_openchangedb_logger_suite());
+	srunner_add_suite(sr, mapiproxy_openchangedb_cache_suite());
+	srunner_add_suite(sr, mapiproxy_openchangedb_profiler_suite());
+	srunner_add_suite(sr, mapiproxy_mapi_handles_suite());
+	srunner_add_suite(sr, mapiproxy_mpm_session_suite());
 	/* libmapistore */
 	srunner_add_suite(sr, mapistore_namedprops_suite());
 	srunner_add_suite(sr, mapistore_namedprops_mysql_suite());
@@ -114,9 +120,16 @@ int main(int argc, const char *argv[])
 	srunner_add_suite(sr, mapistore_indexing_mysql_suite());
 	srunner_add_suite(sr, mapistore_indexing_tdb_suite());
 	srunner_add_suite(sr, mapistore_notification_suite());
+	srunner_add_suite(sr, mapistore_prefetch_suite());
+	srunner_add_suite(sr, mapistore_freebusy_suite());
 	/* mapiproxy */
 	srunner_add_suite(sr, mapiproxy_util_mysql_suite());
 	srunner_add_suite(sr, mapiproxy_util_schema_migration_suite());
+	srunner_add_suite(sr, mapiproxy_emsabp_tdb_suite());
+	srunner_add_suite(sr, mapiproxy_emsabp_snapshot_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_stream_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_sync_snapshot_suite());
+	srunner_add_suite(sr, mapiproxy_emsmdbp_stats_suite());
 
 	srunner_run_all(sr, CK_ENV);
 	nf = srunner_ntests_failed(sr);
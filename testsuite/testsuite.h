@@ -46,11 +46,17 @@ __BEGIN_DECLS
 /* libmapi */
 Suite *libmapi_property_suite(void);
 Suite *libmapi_idset_suite(void);
+Suite *libmapi_obfuscate_suite(void);
+Suite *libmapi_batch_suite(void);
 /* libmapiproxy */
 Suite *mapiproxy_openchangedb_mysql_suite(void);
 Suite *mapiproxy_openchangedb_ldb_suite(void);
 Suite *mapiproxy_openchangedb_multitenancy_mysql_suite(void);
 Suite *mapiproxy_openchangedb_logger_suite(void);
+Suite *mapiproxy_openchangedb_cache_suite(void);
+Suite *mapiproxy_openchangedb_profiler_suite(void);
+Suite *mapiproxy_mapi_handles_suite(void);
+Suite *mapiproxy_mpm_session_suite(void);
 /* libmapistore */
 Suite *mapistore_namedprops_suite(void);
 Suite *mapistore_namedprops_mysql_suite(void);
@@ -58,9 +64,16 @@ Suite *mapistore_namedprops_tdb_suite(void);
 Suite *mapistore_indexing_mysql_suite(void);
 Suite *mapistore_indexing_tdb_suite(void);
 Suite *mapistore_notification_suite(void);
+Suite *mapistore_prefetch_suite(void);
+Suite *mapistore_freebusy_suite(void);
 /* mapiproxy */
 Suite *mapiproxy_util_mysql_suite(void);
 Suite *mapiproxy_util_schema_migration_suite(void);
+Suite *mapiproxy_emsabp_tdb_suite(void);
+Suite *mapiproxy_emsabp_snapshot_suite(void);
+Suite *mapiproxy_emsmdbp_stream_suite(void);
+Suite *mapiproxy_emsmdbp_sync_snapshot_suite(void);
+Suite *mapiproxy_emsmdbp_stats_suite(void);
 
 __END_DECLS
 
@@ -0,0 +1,340 @@
+/*
+   Display ROP latency statistics of the OpenChange server
+
+   OpenChange Project
+
+   Copyright (C) OpenChange Project 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <popt.h>
+
+#include "mapiproxy/servers/default/emsmdb/emsmdbp_stats.h"
+
+struct ocstat_entry {
+	const char				*name;
+	uint32_t				opnum;
+	const struct emsmdbp_stats_counter	*counter;
+};
+
+/**
+   \details Add the counters of a segment to the aggregated ones
+ */
+static void ocstat_counter_add(struct emsmdbp_stats_counter *dst, const struct emsmdbp_stats_counter *src)
+{
+	uint32_t	i;
+
+	dst->calls += src->calls;
+	dst->errors += src->errors;
+	dst->usec_total += src->usec_total;
+	if (src->usec_max > dst->usec_max) {
+		dst->usec_max = src->usec_max;
+	}
+	for (i = 0; i < EMSMDBP_STATS_BUCKETS; i++) {
+		dst->histogram[i] += src->histogram[i];
+	}
+}
+
+/**
+   \details Add a process segment to the aggregated statistics
+
+   \param sum pointer to the aggregated statistics
+   \param segment pointer to the segment to add
+ */
+static void ocstat_segment_add(struct emsmdbp_stats_segment *sum, const struct emsmdbp_stats_segment *segment)
+{
+	const struct emsmdbp_stats_user	*user;
+	uint32_t			i;
+	uint32_t			j;
+
+	ocstat_counter_add(&sum->transactions, &segment->transactions);
+
+	for (i = 0; i < EMSMDBP_STATS_ROPS; i++) {
+		if (!sum->rops[i].name[0] && segment->rops[i].name[0]) {
+			memcpy(sum->rops[i].name, segment->rops[i].name, EMSMDBP_STATS_NAME_LEN - 1);
+		}
+		ocstat_counter_add(&sum->rops[i].counter, &segment->rops[i].counter);
+	}
+
+	/* A user may be served by several processes */
+	for (i = 0; i < EMSMDBP_STATS_USERS; i++) {
+		user = &segment->users[i];
+		if (!user->hash) continue;
+		for (j = 0; j < EMSMDBP_STATS_USERS; j++) {
+			if (!sum->users[j].hash) {
+				sum->users[j].hash = user->hash;
+				memcpy(sum->users[j].username, user->username, EMSMDBP_STATS_USERNAME_LEN - 1);
+				break;
+			}
+			if (!strncmp(sum->users[j].username, user->username, EMSMDBP_STATS_USERNAME_LEN)) {
+				break;
+			}
+		}
+		if (j < EMSMDBP_STATS_USERS) {
+			ocstat_counter_add(&sum->users[j].counter, &user->counter);
+		}
+	}
+}
+
+/**
+   \details Map a statistics segment read-only and check its format
+
+   \param path the path of the segment
+
+   \return pointer to the mapped segment, NULL on failure
+ */
+static const struct emsmdbp_stats_segment *ocstat_map(const char *path)
+{
+	const struct emsmdbp_stats_segment	*segment;
+	struct stat				st;
+	int					fd;
+
+	fd = open(path, O_RDONLY|O_NOFOLLOW);
+	if (fd == -1) return NULL;
+	if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof (struct emsmdbp_stats_segment)) {
+		close(fd);
+		return NULL;
+	}
+	segment = mmap(NULL, sizeof (struct emsmdbp_stats_segment), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (segment == MAP_FAILED) return NULL;
+
+	if (segment->magic != EMSMDBP_STATS_MAGIC || segment->version != EMSMDBP_STATS_VERSION ||
+	    segment->size != sizeof (struct emsmdbp_stats_segment)) {
+		fprintf(stderr, "Skipping %s: unknown segment format\n", path);
+		munmap((void *)segment, sizeof (struct emsmdbp_stats_segment));
+		return NULL;
+	}
+
+	return segment;
+}
+
+/**
+   \details Map and aggregate the statistics segments of the running
+   server processes found in a directory, and optionally the archive
+   of the processes that have exited
+
+   \param directory the statistics directory
+   \param pid the only process to report, 0 for all
+   \param all whether the archive of exited processes is included
+   \param sum pointer to the aggregated statistics
+   \param processes pointer on the number of segments found
+
+   \return 0 on success, otherwise -1
+ */
+static int ocstat_load(const char *directory, pid_t pid, bool all,
+		       struct emsmdbp_stats_segment *sum, uint32_t *processes)
+{
+	const struct emsmdbp_stats_segment	*segment;
+	struct dirent				*de;
+	DIR					*dir;
+	char					path[4096];
+	size_t					prefix_len = strlen(EMSMDBP_STATS_PREFIX);
+
+	dir = opendir(directory);
+	if (!dir) {
+		fprintf(stderr, "Unable to open %s: %s\n", directory, strerror(errno));
+		return -1;
+	}
+
+	while ((de = readdir(dir)) != NULL) {
+		if (strncmp(de->d_name, EMSMDBP_STATS_PREFIX, prefix_len)) continue;
+		if (pid && atoi(de->d_name + prefix_len) != pid) continue;
+
+		snprintf(path, sizeof (path), "%s/%s", directory, de->d_name);
+		segment = ocstat_map(path);
+		if (!segment) continue;
+
+		/* Segments of crashed processes were never archived */
+		if (!kill(segment->pid, 0) || errno == EPERM) {
+			ocstat_segment_add(sum, segment);
+			*processes += 1;
+		}
+		munmap((void *)segment, sizeof (struct emsmdbp_stats_segment));
+	}
+	closedir(dir);
+
+	if (all && !pid) {
+		snprintf(path, sizeof (path), "%s/%s", directory, EMSMDBP_STATS_ARCHIVE);
+		segment = ocstat_map(path);
+		if (segment) {
+			ocstat_segment_add(sum, segment);
+			munmap((void *)segment, sizeof (struct emsmdbp_stats_segment));
+		}
+	}
+
+	return 0;
+}
+
+/**
+   \details Return the upper bound of the histogram bucket holding a
+   given percentile of the calls, capped by the slowest call
+
+   \return the bound in microseconds
+ */
+static uint64_t ocstat_percentile(const struct emsmdbp_stats_counter *counter, uint32_t percent)
+{
+	uint64_t	rank;
+	uint64_t	seen = 0;
+	uint32_t	i;
+
+	if (!counter->calls) return 0;
+
+	rank = (counter->calls * percent + 99) / 100;
+	for (i = 0; i < EMSMDBP_STATS_BUCKETS - 1; i++) {
+		seen += counter->histogram[i];
+		if (seen >= rank) {
+			return ((uint64_t)1 << i) < counter->usec_max ? (uint64_t)1 << i : counter->usec_max;
+		}
+	}
+	return counter->usec_max;
+}
+
+static void ocstat_print_header(const char *title)
+{
+	printf("%-32s %10s %8s %10s %10s %10s %10s %10s\n", title, "calls", "errors",
+	       "avg(us)", "p50(us)", "p95(us)", "p99(us)", "max(us)");
+}
+
+static void ocstat_print(const char *name, const struct emsmdbp_stats_counter *counter)
+{
+	printf("%-32s %10"PRIu64" %8"PRIu64" %10"PRIu64" %10"PRIu64" %10"PRIu64" %10"PRIu64" %10"PRIu64"\n",
+	       name, counter->calls, counter->errors,
+	       counter->calls ? counter->usec_total / counter->calls : 0,
+	       ocstat_percentile(counter, 50), ocstat_percentile(counter, 95),
+	       ocstat_percentile(counter, 99), counter->usec_max);
+}
+
+/* Sort entries by decreasing total time */
+static int ocstat_entry_cmp(const void *a, const void *b)
+{
+	const struct ocstat_entry	*ea = a;
+	const struct ocstat_entry	*eb = b;
+
+	if (ea->counter->usec_total == eb->counter->usec_total) return 0;
+	return (ea->counter->usec_total < eb->counter->usec_total) ? 1 : -1;
+}
+
+int main(int argc, const char *argv[])
+{
+	poptContext			pc;
+	int				opt;
+	struct emsmdbp_stats_segment	*sum;
+	struct ocstat_entry		entries[EMSMDBP_STATS_ROPS > EMSMDBP_STATS_USERS ? EMSMDBP_STATS_ROPS : EMSMDBP_STATS_USERS];
+	char				name[EMSMDBP_STATS_NAME_LEN + 8];
+	const char			*opt_directory = EMSMDBP_STATS_DIRECTORY;
+	int				opt_pid = 0;
+	bool				opt_users = false;
+	bool				opt_all = false;
+	uint32_t			processes = 0;
+	uint32_t			count;
+	uint32_t			i;
+
+	enum { OPT_DIRECTORY=1000, OPT_PID, OPT_USERS, OPT_ALL };
+
+	struct poptOption long_options[] = {
+		POPT_AUTOHELP
+		{ "directory", 'D', POPT_ARG_STRING, NULL, OPT_DIRECTORY, "set the statistics directory", "PATH" },
+		{ "pid", 'p', POPT_ARG_INT, &opt_pid, OPT_PID, "only report the given server process", "PID" },
+		{ "users", 'u', POPT_ARG_NONE, NULL, OPT_USERS, "report per-user statistics", NULL },
+		{ "all", 'a', POPT_ARG_NONE, NULL, OPT_ALL, "include the archive of processes that have exited", NULL },
+		{ NULL, 0, 0, NULL, 0, NULL, NULL }
+	};
+
+	pc = poptGetContext("ocstat", argc, argv, long_options, 0);
+	while ((opt = poptGetNextOpt(pc)) != -1) {
+		switch (opt) {
+		case OPT_DIRECTORY:
+			opt_directory = poptGetOptArg(pc);
+			break;
+		case OPT_PID:
+			break;
+		case OPT_USERS:
+			opt_users = true;
+			break;
+		case OPT_ALL:
+			opt_all = true;
+			break;
+		}
+	}
+
+	sum = calloc(1, sizeof (struct emsmdbp_stats_segment));
+	if (!sum) {
+		fprintf(stderr, "No memory available\n");
+		exit (1);
+	}
+
+	if (ocstat_load(opt_directory, opt_pid, opt_all, sum, &processes) == -1) {
+		free(sum);
+		exit (1);
+	}
+	poptFreeContext(pc);
+
+	printf("%u server process(es)\n\n", processes);
+	ocstat_print_header("EcDoRpc");
+	ocstat_print("total", &sum->transactions);
+	printf("\n");
+
+	for (i = 0, count = 0; i < EMSMDBP_STATS_ROPS; i++) {
+		if (!sum->rops[i].counter.calls) continue;
+		entries[count].name = sum->rops[i].name;
+		entries[count].opnum = i;
+		entries[count].counter = &sum->rops[i].counter;
+		count++;
+	}
+	qsort(entries, count, sizeof (struct ocstat_entry), ocstat_entry_cmp);
+
+	ocstat_print_header("ROP");
+	for (i = 0; i < count; i++) {
+		snprintf(name, sizeof (name), "%s (0x%.2x)", entries[i].name[0] ? entries[i].name : "Unknown",
+			 entries[i].opnum);
+		ocstat_print(name, entries[i].counter);
+	}
+
+	if (opt_users) {
+		for (i = 0, count = 0; i < EMSMDBP_STATS_USERS; i++) {
+			if (!sum->users[i].hash) continue;
+			entries[count].name = sum->users[i].username;
+			entries[count].counter = &sum->users[i].counter;
+			count++;
+		}
+		qsort(entries, count, sizeof (struct ocstat_entry), ocstat_entry_cmp);
+
+		printf("\n");
+		ocstat_print_header("User");
+		for (i = 0; i < count; i++) {
+			ocstat_print(entries[i].name, entries[i].counter);
+		}
+	}
+
+	free(sum);
+
+	return 0;
+}
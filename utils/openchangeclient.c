@@ -383,7 +383,8 @@ static enum MAPISTATUS openchangeclient_fetchmail(mapi_object_t *obj_store,
 	TALLOC_CTX			*mem_ctx;
 	mapi_object_t			obj_tis;
 	mapi_object_t			obj_inbox;
-	mapi_object_t			obj_message;
+	mapi_object_t			*obj_message;
+	mapi_object_t			*obj_messages;
 	mapi_object_t			obj_table;
 	mapi_object_t			obj_tb_attach;
 	mapi_object_t			obj_attach;
@@ -397,6 +398,12 @@ static enum MAPISTATUS openchangeclient_fetchmail(mapi_object_t *obj_store,
 	const uint32_t			*attach_num;
 	const char			*attach_filename;
 	const uint32_t			*attach_size;
+	struct mapi_batch		*batch;
+	enum MAPISTATUS			*open_retval;
+	enum MAPISTATUS			*props_retval;
+	enum MAPISTATUS			fetch_retval = MAPI_E_SUCCESS;
+	struct SPropValue		**props;
+	uint32_t			*props_count;
 	
 	mem_ctx = talloc_named(NULL, 0, "openchangeclient_fetchmail");
 
@@ -444,37 +451,60 @@ static enum MAPISTATUS openchangeclient_fetchmail(mapi_object_t *obj_store,
 
 	while ((retval = QueryRows(&obj_table, count, TBL_ADVANCE, TBL_FORWARD_READ, &rowset)) != MAPI_E_NOT_FOUND && rowset.cRows) {
 		count -= rowset.cRows;
+		obj_messages = talloc_array(mem_ctx, mapi_object_t, rowset.cRows);
+		open_retval = talloc_array(mem_ctx, enum MAPISTATUS, rowset.cRows);
+		props_retval = talloc_array(mem_ctx, enum MAPISTATUS, rowset.cRows);
+		props = talloc_array(mem_ctx, struct SPropValue *, rowset.cRows);
+		props_count = talloc_array(mem_ctx, uint32_t, rowset.cRows);
+
+		/* Open the whole row set in as few round-trips as possible */
+		SPropTagArray = set_SPropTagArray(mem_ctx, 0x1, PR_HASATTACH);
+		retval = mapi_batch_begin(obj_store, &batch);
+		MAPI_RETVAL_IF(retval, retval, mem_ctx);
 		for (i = 0; i < rowset.cRows; i++) {
-			mapi_object_init(&obj_message);
-			retval = OpenMessage(obj_store,
-					     rowset.aRow[i].lpProps[0].value.d,
-					     rowset.aRow[i].lpProps[1].value.d,
-					     &obj_message, 0);
-			if (GetLastError() == MAPI_E_SUCCESS) {
+			mapi_object_init(&obj_messages[i]);
+			mapi_batch_OpenMessage(batch, obj_store,
+					       rowset.aRow[i].lpProps[0].value.d,
+					       rowset.aRow[i].lpProps[1].value.d,
+					       &obj_messages[i], 0, &open_retval[i]);
+			if (!oclient->summary) {
+				mapi_batch_GetProps(batch, &obj_messages[i], 0, SPropTagArray,
+						    &props[i], &props_count[i], &props_retval[i]);
+			}
+		}
+		retval = mapi_batch_commit(batch);
+		talloc_free(batch);
+		MAPIFreeBuffer(SPropTagArray);
+		MAPI_RETVAL_IF(retval, retval, mem_ctx);
+
+		for (i = 0; i < rowset.cRows && fetch_retval == MAPI_E_SUCCESS; i++) {
+			obj_message = &obj_messages[i];
+			if (open_retval[i] == MAPI_E_SUCCESS) {
 				if (oclient->summary) {
-					mapidump_message_summary(&obj_message);
+					mapidump_message_summary(obj_message);
 				} else {
 					struct SPropValue	*lpProps;
 					struct SRow		aRow;
 					
-					SPropTagArray = set_SPropTagArray(mem_ctx, 0x1, PR_HASATTACH);
-					lpProps = NULL;
-					retval = GetProps(&obj_message, 0, SPropTagArray, &lpProps, &count);
-					MAPIFreeBuffer(SPropTagArray);
-					if (retval != MAPI_E_SUCCESS) return retval;
+					/* Release the opened messages before failing */
+					if (props_retval[i] != MAPI_E_SUCCESS) {
+						fetch_retval = props_retval[i];
+						continue;
+					}
+					lpProps = props[i];
 					
 					aRow.ulAdrEntryPad = 0;
-					aRow.cValues = count;
+					aRow.cValues = props_count[i];
 					aRow.lpProps = lpProps;
 					
-					retval = octool_message(mem_ctx, &obj_message);
+					retval = octool_message(mem_ctx, obj_message);
 					
 					has_attach = (const uint8_t *) get_SPropValue_SRow_data(&aRow, PR_HASATTACH);
 					
 					/* If we have attachments, retrieve them */
 					if (has_attach && *has_attach) {
 						mapi_object_init(&obj_tb_attach);
-						retval = GetAttachmentTable(&obj_message, &obj_tb_attach);
+						retval = GetAttachmentTable(obj_message, &obj_tb_attach);
 						if (retval == MAPI_E_SUCCESS) {
 							SPropTagArray = set_SPropTagArray(mem_ctx, 0x1, PR_ATTACH_NUM);
 							retval = SetColumns(&obj_tb_attach, SPropTagArray);
@@ -486,7 +516,7 @@ static enum MAPISTATUS openchangeclient_fetchmail(mapi_object_t *obj_store,
 							
 							for (j = 0; j < rowset_attach.cRows; j++) {
 								attach_num = (const uint32_t *)find_SPropValue_data(&(rowset_attach.aRow[j]), PR_ATTACH_NUM);
-								retval = OpenAttach(&obj_message, *attach_num, &obj_attach);
+								retval = OpenAttach(obj_message, *attach_num, &obj_attach);
 								if (retval == MAPI_E_SUCCESS) {
 									struct SPropValue	*lpProps2;
 									uint32_t		count2;
@@ -529,8 +559,26 @@ static enum MAPISTATUS openchangeclient_fetchmail(mapi_object_t *obj_store,
 					}
 				}
 			}
-			mapi_object_release(&obj_message);
 		}
+
+		/* Release them the same way */
+		retval = mapi_batch_begin(obj_store, &batch);
+		MAPI_RETVAL_IF(retval, retval, mem_ctx);
+		for (i = 0; i < rowset.cRows; i++) {
+			if (open_retval[i] == MAPI_E_SUCCESS) {
+				mapi_batch_Release(batch, &obj_messages[i], NULL);
+			}
+		}
+		retval = mapi_batch_commit(batch);
+		talloc_free(batch);
+		MAPI_RETVAL_IF(retval, retval, mem_ctx);
+
+		talloc_free(obj_messages);
+		talloc_free(open_retval);
+		talloc_free(props_retval);
+		talloc_free(props);
+		talloc_free(props_count);
+		if (fetch_retval != MAPI_E_SUCCESS) break;
 	}
  end:
 	mapi_object_release(&obj_table);
@@ -540,7 +588,7 @@ static enum MAPISTATUS openchangeclient_fetchmail(mapi_object_t *obj_store,
 	talloc_free(mem_ctx);
 
 	errno = 0;
-	return MAPI_E_SUCCESS;
+	return fetch_retval;
 }
 
 /**
@@ -2845,6 +2893,7 @@ int main(int argc, const char *argv[])
 	bool			opt_deletemail = false;
 	bool			opt_mailbox = false;
 	bool			opt_dumpdata = false;
+	bool			opt_compress = false;
 	bool			opt_notifications = false;
 	bool			opt_mkdir = false;
 	bool			opt_rmdir = false;
@@ -2875,7 +2924,7 @@ int main(int argc, const char *argv[])
 	      OPT_FOLDER_NAME, OPT_FOLDER_COMMENT, OPT_USERLIST, OPT_MAPI_PRIVATE,
 	      OPT_UPDATE, OPT_DELETEITEMS, OPT_OCPF_FILE, OPT_OCPF_SYNTAX,
 	      OPT_OCPF_SENDER, OPT_OCPF_DUMP, OPT_FREEBUSY, OPT_FORCE, OPT_FETCHSUMMARY,
-	      OPT_USERNAME };
+	      OPT_USERNAME, OPT_COMPRESS };
 
 	struct poptOption long_options[] = {
 		POPT_AUTOHELP
@@ -2927,6 +2976,7 @@ int main(int argc, const char *argv[])
 		{"folder-comment", 0, POPT_ARG_STRING, NULL, OPT_FOLDER_COMMENT, "set the folder comment", NULL },
 		{"debuglevel", 'd', POPT_ARG_STRING, NULL, OPT_DEBUG, "set Debug Level", NULL },
 		{"dump-data", 0, POPT_ARG_NONE, NULL, OPT_DUMPDATA, "dump the hex data", NULL },
+		{"compress", 0, POPT_ARG_NONE, NULL, OPT_COMPRESS, "compress requests sent to the server", NULL },
 		{"private", 0, POPT_ARG_NONE, NULL, OPT_MAPI_PRIVATE, "set the private flag on messages", NULL },
 		{"ocpf-file", 0, POPT_ARG_STRING, NULL, OPT_OCPF_FILE, "set OCPF file", NULL },
 		{"ocpf-dump", 0, POPT_ARG_STRING, NULL, OPT_OCPF_DUMP, "dump message into OCPF file", NULL },
@@ -2956,6 +3006,9 @@ int main(int argc, const char *argv[])
 		case OPT_DUMPDATA:
 			opt_dumpdata = true;
 			break;
+		case OPT_COMPRESS:
+			opt_compress = true;
+			break;
 		case OPT_USERLIST:
 			opt_userlist = true;
 			break;
@@ -3237,6 +3290,7 @@ int main(int argc, const char *argv[])
 		mapi_errstr("MapiLogonEx", GetLastError());
 		exit (1);
 	}
+	emsmdb_set_request_compression(session, opt_compress);
 
 	/**
 	 * Open Default Message Store
@@ -251,12 +251,13 @@ int main(int argc, const char *argv[])
 	bool			opt_mkdir = false;
 	bool			opt_rmdir = false;
 	bool			opt_dumpdata = false;
+	bool			opt_compress = false;
 
 	enum {OPT_PROFILE_DB=1000, OPT_PROFILE, OPT_PASSWORD, OPT_IPM_LIST, 
 	      OPT_MKDIR, OPT_RMDIR, OPT_COMMENT, OPT_DIRCLASS, OPT_ACL, 
 	      OPT_ADDUSER, OPT_RMUSER, OPT_DEBUG, OPT_APASSWORD, OPT_ADESC, 
 	      OPT_ACOMMENT, OPT_AFULLNAME, OPT_ADDRIGHT, OPT_RMRIGHT, 
-	      OPT_MODRIGHT, OPT_USERNAME, OPT_FOLDER, OPT_DUMPDATA};
+	      OPT_MODRIGHT, OPT_USERNAME, OPT_FOLDER, OPT_DUMPDATA, OPT_COMPRESS};
 
 	struct poptOption long_options[] = {
 		POPT_AUTOHELP
@@ -279,6 +280,7 @@ int main(int argc, const char *argv[])
 		{"modright", 0, POPT_ARG_STRING, NULL, OPT_MODRIGHT, "modify MAPI permissions to PF folder", "RIGHT"},
 		{"debuglevel", 0, POPT_ARG_STRING, NULL, OPT_DEBUG, "set debug level", "LEVEL"},
 		{"dump-data", 0, POPT_ARG_NONE, NULL, OPT_DUMPDATA, "Dump the hex data", NULL},
+		{"compress", 0, POPT_ARG_NONE, NULL, OPT_COMPRESS, "Compress requests sent to the server", NULL},
 		{"folder", 0, POPT_ARG_STRING, NULL, OPT_FOLDER, "specify the Public Folder directory", "FOLDER"},
 		{"username", 0, POPT_ARG_STRING, NULL, OPT_USERNAME, "specify the username to use", "USERNAME"},
 		POPT_OPENCHANGE_VERSION
@@ -297,6 +299,9 @@ int main(int argc, const char *argv[])
 		case OPT_DUMPDATA:
 			opt_dumpdata = true;
 			break;
+		case OPT_COMPRESS:
+			opt_compress = true;
+			break;
 		case OPT_PROFILE_DB:
 			opt_profdb = poptGetOptArg(pc);
 			break;
@@ -420,6 +425,7 @@ int main(int argc, const char *argv[])
 		mapi_errstr("MapiLogonEx", GetLastError());
 		exit (1);
 	}
+	emsmdb_set_request_compression(session, opt_compress);
 
 	/**
 	 * User management operations